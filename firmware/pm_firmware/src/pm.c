@@ -14,9 +14,13 @@ Date:
 #include <string.h>
 #include "pm.h"
 #include "pm_adc.h"
+#include "pm_boot.h"
 #include "pm_clocks.h"
+#include "pm_dma.h"
+#include "pm_eeprom.h"
 #include "pm_gpio.h"
 #include "pm_i2c.h"
+#include "pm_logger.h"
 /*
 #include "pm_interrupt.h"
 */
@@ -28,8 +32,12 @@ Date:
 #include "pm_config_codes.h"
 #include "pm_mc3416.h"
 #include "pm_power.h"
+#include "pm_sequencer.h"
+#include "pm_settings.h"
+#include "pm_telemetry.h"
+#include "pm_timer.h"
 
-#define COMMAND_LENGTH 64
+#define COMMAND_LENGTH PM_USART_PC_LINE_LENGTH
 #define SPI_BUFFER_LENGTH 16
 
 
@@ -49,17 +57,30 @@ Local variable(s)
 static bool bSPIInitialized;
 static const uint8_t spi_command_length = 8;
 
+// Framed requests, see handle_frame()
+#define FRAME_MAX_COMMANDS 8
+
+static uint32_t frames = 0;
+static uint32_t frame_commands = 0;
+static uint32_t frames_rejected = 0;
+
 // Timer Variables
 struct tc_module tc_instance;
 volatile static bool timer_0_elapsed = false;
+static uint32_t timer_0_reload = 0xFFFAA22C;
 
 /****************************************************************************************
 Local function(s)
 *****************************************************************************************/
 
 static bool handle_command(char *);
+static bool run_command(char *);
+static void handle_frame(char *);
 static void handle_spi_command(char *, char *);
-static void initInternalHW(void);
+static void initInternalHW(bool);
+static bool set_rail(char *, const char *, uint16_t, bool);
+static bool set_wcm_relay(bool);
+static void wake_timer_reload(void);
 
 enum status_code read_mc3416(void);
 void tc_callback_to_sleep_mode(struct tc_module *const module_inst);
@@ -94,13 +115,29 @@ Local functions to configure TC for real time MC3416 measurements
 void tc_callback_to_sleep_mode(
 struct tc_module *const module_inst)
 {
-	tc_set_count_value(&tc_instance, 0xFFFAA22C);
+	tc_set_count_value(&tc_instance, timer_0_reload);
 	timer_0_elapsed = true;
 }
 
 
 
 
+/****************************************************************************************
+Local function to load the TC count for the WAKE_PERIOD setting and restart the awake
+window with it
+
+Desired Time/(prescaler/system clk frequency) = #cycles, 30s/(1024/12000000) = 351563
+cycles, subtracted from 2^32 since the counter counts up to its overflow.
+WAKE_PERIOD is at most a day (1012435200 cycles), so this does not wrap
+*****************************************************************************************/
+static void wake_timer_reload(void)
+{
+	timer_0_reload = 0u - pm_settings_get(SETTINGS_KEY_WAKE_PERIOD) * (12000000ul / 1024ul);
+	tc_set_count_value(&tc_instance, timer_0_reload);
+
+}	// End of wake_timer_reload
+
+
 /****************************************************************************************
 Local function to handle serial commands
 *****************************************************************************************/
@@ -113,6 +150,8 @@ static bool handle_command(char *command)
 	enum status_code status;
 	float v;
 	int i;
+	uint16_t power_bits;
+	uint16_t power_mask;
 
 	// Respond to valid commands
 	bValid = true;
@@ -247,276 +286,291 @@ static bool handle_command(char *command)
 	}	
 	else if (strstr(command, "read_power_bits"))
 	{
-		b = pm_gpio_3v3va_get();
-		sprintf(response, "+3V3VA_EN %d\r\n", (b) ? 1 : 0);
-		pm_usart_send_pc_message(response);
-
-		b = pm_gpio_battery_select_get();
-		sprintf(response, "BATT_SEL %d\r\n", (b) ? 1 : 0);
-		pm_usart_send_pc_message(response);
-
-/*
-		b = pm_gpio_battery_serial_power_get();
-		sprintf(response, "BATT_SER_PWR_EN %d\r\n", (b) ? 1 : 0);
-		pm_usart_send_pc_message(response);
-
-		b = pm_gpio_ctd_power_get();
-		sprintf(response, "CTD_PWR_EN %d\r\n", (b) ? 1 : 0);
-		pm_usart_send_pc_message(response);
-*/
-
-		b = pm_gpio_driver_get();
-		sprintf(response, "DRIVER_EN %d\r\n", (b) ? 1 : 0);
-		pm_usart_send_pc_message(response);
-
-		b = pm_gpio_Main_power_get();
-		sprintf(response, "Main_PWR_EN %d\r\n", (b) ? 1 : 0);
-		pm_usart_send_pc_message(response);
-
-		b = pm_gpio_vbs_power_get();
-		sprintf(response, "VBS_PWR_EN %d\r\n", (b) ? 1 : 0);
-		pm_usart_send_pc_message(response);
-
-		b = pm_gpio_vbs_serial_power_get();
-		sprintf(response, "VBS_SER_PWR_EN %d\r\n", (b) ? 1 : 0);
-		pm_usart_send_pc_message(response);
-
-		b = pm_gpio_wcm_diagnostics_enable_get();
-		sprintf(response, "WCM_DIAG_EN %d\r\n", (b) ? 1 : 0);
+		sprintf(response, "POWER 0x%03x\r\n", pm_gpio_power_bits_get());
 		pm_usart_send_pc_message(response);
+	}
+	else if (strstr(command, "set_power_bits"))
+	{
+		// set_power_bits <mask> <bits>, hex or decimal
+		token = strtok(command, " ");
+		token = strtok(NULL, " ");
+		if (token != NULL)
+		{
+			power_mask = (uint16_t)strtoul(token, NULL, 0);
+			token = strtok(NULL, " ");
+		}
+		if (token == NULL)
+		{
+			bValid = false;
+		}
+		else if (pm_sequencer_busy())
+		{
+			pm_usart_send_pc_message("handle_command: Power profile transition running!\r\n");
+			sprintf(command, "set_power_bits busy");
+			bValid = false;
+		}
+		else
+		{
+			power_bits = (uint16_t)strtoul(token, NULL, 0);
 
-		b = pm_gpio_wcm_power_get();
-		sprintf(response, "WCM_PWR_EN %d\r\n", (b) ? 1 : 0);
-		pm_usart_send_pc_message(response);
+			// Rails held by a sequencer interlock are left out of the echo
+			power_mask = pm_sequencer_set_rails(power_mask, power_bits);
 
-		b = pm_gpio_wcm_relay_get();
-		sprintf(response, "WCM_RLY %d\r\n", (b) ? 1 : 0);
-		pm_usart_send_pc_message(response);
+			sprintf(response, "POWER 0x%03x\r\n", pm_gpio_power_bits_get());
+			pm_usart_send_pc_message(response);
+			sprintf(command, "set_power_bits 0x%03x 0x%03x", power_mask, power_bits & power_mask);
+		}
 	}
 	else if (strstr(command, "read_status_bits"))
 	{
-		b = pm_gpio_accelerometer_interrupt_get();
-		sprintf(response, "/ACCEL_INT %d\r\n", (b) ? 1 : 0);
-		pm_usart_send_pc_message(response);
-
-		b = pm_gpio_ext_gpio1_get();
-		sprintf(response, "EXT_GPIO1 %d\r\n", (b) ? 1 : 0);
-		pm_usart_send_pc_message(response);
-
-		b = pm_gpio_ext_gpio2_get();
-		sprintf(response, "EXT_GPIO2 %d\r\n", (b) ? 1 : 0);
-		pm_usart_send_pc_message(response);
-
-		b = pm_gpio_lt8618_pg_get();
-		sprintf(response, "LT8618_PG %d\r\n", (b) ? 1 : 0);
-		pm_usart_send_pc_message(response);
-
-		b = pm_gpio_n_ltc2944_alcc_get();
-		sprintf(response, "/LTC2944_ALCC %d\r\n", (b) ? 1 : 0);
-		pm_usart_send_pc_message(response);
-
-		b = pm_gpio_wcm_fault_get();
-		sprintf(response, "/WCM_FAULT %d\r\n", (b) ? 1 : 0);
+		sprintf(response, "STATUS_BITS 0x%02x\r\n", pm_gpio_status_bits_get());
 		pm_usart_send_pc_message(response);
 	}
 	else if (strstr(command, "reinitialize"))
 	{
-		initInternalHW();
+		pm_boot_trace_start();
+		initInternalHW(false);
+		pm_boot_trace_mark("done");
 	}
-	else if (strstr(command, "+3V3VA_EN"))
+	else if (strstr(command, "read_boot_trace"))
+	{
+		pm_boot_trace_report();
+	}
+	else if (strstr(command, "read_spi_stats"))
+	{
+		pm_spi_report();
+	}
+	else if (strstr(command, "read_dma_stats"))
+	{
+		pm_dma_report();
+		pm_usart_report_queue();
+	}
+	else if (strstr(command, "read_link_stats"))
+	{
+		pm_usart_report_rx();
+		sprintf(response, "FRAMES %lu %lu %lu\r\n", (unsigned long)frames, (unsigned long)frame_commands,
+			(unsigned long)frames_rejected);
+		pm_usart_send_pc_message(response);
+	}
+	else if (strstr(command, "adc_capture"))
 	{
+		// adc_capture <results>, sent by pm_adc_capture_service() when recorded
 		token = strtok(command, " ");
 		token = strtok(NULL, " ");
-		i = atoi(token);
-		sprintf(command, "+3V3VA_EN %d", i);
-		if (i == 0)
+		if ((token == NULL) || (pm_adc_capture_start((uint16_t)strtoul(token, NULL, 0)) != STATUS_OK))
 		{
-			pm_gpio_3v3va_off();
-		}
-		else
-		{
-			pm_gpio_3v3va_on();
+			bValid = false;
 		}
 	}
-	else if (strstr(command, "BATT_SEL"))
+	else if (strstr(command, "log_dump"))
 	{
+		uint32_t first;
+		uint32_t last;
+
+		// log_dump <from> <to> or log_dump <from>..<to>, <to> defaults to the newest record
 		token = strtok(command, " ");
-		token = strtok(NULL, " ");
-		i = atoi(token);
-		sprintf(command, "BATT_SEL %d", i);
-		if (i == 0)
+		token = strtok(NULL, " .");
+		first = (token != NULL) ? strtoul(token, NULL, 0) : 0;
+		token = strtok(NULL, " .");
+		last = (token != NULL) ? strtoul(token, NULL, 0) : 0xfffffffful;
+
+		// The raw records would look like telemetry frames to the host
+		if (pm_telemetry_stream_enabled())
 		{
-			pm_gpio_battery_select_off();
+			bValid = false;
 		}
 		else
 		{
-			pm_gpio_battery_select_on();
+			pm_logger_dump(first, last);
 		}
 	}
-	else if (strstr(command, "BATT_SER_PWR_EN"))
+	else if (strstr(command, "log_info"))
+	{
+		pm_logger_report();
+	}
+	else if (strstr(command, "log_zdump"))
+	{
+		uint32_t first;
+		uint32_t last;
+
+		// Same arguments as log_dump
+		token = strtok(command, " ");
+		token = strtok(NULL, " .");
+		first = (token != NULL) ? strtoul(token, NULL, 0) : 0;
+		token = strtok(NULL, " .");
+		last = (token != NULL) ? strtoul(token, NULL, 0) : 0xfffffffful;
+		pm_telemetry_dump(first, last);
+	}
+	else if (strstr(command, "telemetry_stream"))
 	{
+		// telemetry_stream 1 sends each new log record as a compressed frame
 		token = strtok(command, " ");
 		token = strtok(NULL, " ");
-		i = atoi(token);
-		sprintf(command, "BATT_SER_PWR_EN %d", i);
-		if (i == 0)
-		{
-			pm_gpio_battery_serial_power_off();
-		}
-		else
-		{
-			pm_gpio_battery_serial_power_on();
-		}
+		pm_telemetry_stream_enable((token != NULL) && (strtoul(token, NULL, 0) != 0));
 	}
-	else if (strstr(command, "CTD_PWR_EN"))
+	else if (strstr(command, "telemetry_stats"))
+	{
+		pm_telemetry_report();
+	}
+	else if (strstr(command, "set_baud"))
 	{
+		// set_baud <rate>, see pm_usart.c for the handshake
 		token = strtok(command, " ");
 		token = strtok(NULL, " ");
-		i = atoi(token);
-		sprintf(command, "CTD_PWR_EN %d", i);
-		if (i == 0)
-		{
-			pm_gpio_ctd_power_off();
-		}
-		else
+		if ((token == NULL) || (pm_usart_set_pc_baud(strtoul(token, NULL, 0)) == false))
 		{
-			pm_gpio_ctd_power_on();
+			bValid = false;
 		}
 	}
-	else if (strstr(command, "DRIVER_EN"))
+	else if (strstr(command, "set_vbs_baud"))
 	{
+		unsigned long rate;
+
 		token = strtok(command, " ");
 		token = strtok(NULL, " ");
-		i = atoi(token);
-		sprintf(command, "DRIVER_EN %d", i);
-		if (i == 1)
+		rate = (token != NULL) ? strtoul(token, NULL, 0) : 0;
+		if (pm_usart_set_vbs_baud(rate) == STATUS_OK)
 		{
-			pm_gpio_driver_disable();
+			sprintf(response, "VBS_BAUD %lu\r\n", rate);
+			pm_usart_send_pc_message(response);
 		}
 		else
 		{
-			pm_gpio_driver_enable();
+			pm_usart_send_pc_message("handle_command: Unsupported baud rate!\r\n");
+			bValid = false;
 		}
 	}
-	else if (strstr(command, "Main_PWR_EN"))
+	else if (strstr(command, "read_baud"))
 	{
-		b = pm_gpio_driver_get();
-		if (b == 0)
-		{
-			token = strtok(command, " ");
-			token = strtok(NULL, " ");
-			i = atoi(token);
-
-			sprintf(command, "Main_PWR_EN %d", i);
-			if (i == 0)
-			{
-				pm_gpio_Main_power_off();
-				bSPIInitialized = false;
-	
-				pm_usart_send_pc_message("handle_command: pm_gpio_Main_power_off\r\n");
-			}
-			else
-			{
-				pm_gpio_Main_power_on();
-	
-				pm_usart_send_pc_message("handle_command: pm_gpio_Main_power_on\r\n");
-			}
-		}
-		else
-		{
-			b = pm_gpio_Main_power_get();
-			sprintf(response, "Main_PWR_EN %d\r\n", (b) ? 1 : 0);
-			pm_usart_send_pc_message(response);
-
-			sprintf(command, "Main_PWR_EN unchanged");
-		}
+		pm_usart_report_baud();
 	}
-	else if (strstr(command, "VBS_PWR_EN"))
+	else if (strstr(command, "set_profile"))
 	{
+		// set_profile <sleep|sensing|comms>, the steps are run by pm_sequencer_service()
 		token = strtok(command, " ");
 		token = strtok(NULL, " ");
-		i = atoi(token);
-		sprintf(command, "VBS_PWR_EN %d", i);
-		if (i == 0)
+		if ((token == NULL) || (pm_sequencer_start(token) != STATUS_OK))
 		{
-			pm_gpio_vbs_power_off();
+			bValid = false;
 		}
 		else
 		{
-			pm_gpio_vbs_power_on();
+			sprintf(response, "set_profile %s", token);
+			strcpy(command, response);
 		}
 	}
-	else if (strstr(command, "VBS_SER_PWR_EN"))
+	else if (strstr(command, "read_profile"))
 	{
+		pm_sequencer_report();
+	}
+	else if (strstr(command, "read_settings"))
+	{
+		pm_settings_report();
+	}
+	else if (strstr(command, "set_setting"))
+	{
+		char *name;
+		char *end;
+		unsigned long value;
+		enum status_code status;
+
 		token = strtok(command, " ");
+		name = strtok(NULL, " ");
 		token = strtok(NULL, " ");
-		i = atoi(token);
-		sprintf(command, "VBS_SER_PWR_EN %d", i);
-		if (i == 0)
+		value = (token != NULL) ? strtoul(token, &end, 0) : 0;
+		status = STATUS_ERR_INVALID_ARG;
+		if ((name != NULL) && (token != NULL))
 		{
-			pm_gpio_vbs_serial_power_off();
+			status = ((end != token) && (*end == '\0')) ? pm_settings_set_by_name(name, value) : STATUS_ERR_BAD_DATA;
 		}
-		else
+
+		if (status == STATUS_OK)
 		{
-			pm_gpio_vbs_serial_power_on();
+			sprintf(response, "SETTING %s %lu\r\n", name, value);
+			pm_usart_send_pc_message(response);
+
+			// Picks up a new LEAK_THRESHOLD
+			pm_adc_configure_leak_monitor();
+
+			// The awake window restarts with a new WAKE_PERIOD
+			if (strcmp(name, "WAKE_PERIOD") == 0)
+			{
+				wake_timer_reload();
+			}
 		}
-	}
-	else if (strstr(command, "WCM_DIAG_EN"))
-	{
-		token = strtok(command, " ");
-		token = strtok(NULL, " ");
-		i = atoi(token);
-		sprintf(command, "WCM_DIAG_EN %d", i);
-		if (i == 0)
+		else if (status == STATUS_ERR_BAD_DATA)
 		{
-			pm_gpio_wcm_diagnostics_enable_off();
+			pm_usart_send_pc_message("handle_command: Setting out of range!\r\n");
+			bValid = false;
 		}
 		else
 		{
-			pm_gpio_wcm_diagnostics_enable_on();
+			pm_usart_send_pc_message("handle_command: Unknown setting!\r\n");
+			bValid = false;
 		}
 	}
+	else if (strstr(command, "+3V3VA_EN"))
+	{
+		bValid = set_rail(command, "+3V3VA_EN", PM_POWER_BIT_3V3VA, false);
+	}
+	else if (strstr(command, "BATT_SEL"))
+	{
+		bValid = set_rail(command, "BATT_SEL", PM_POWER_BIT_BATT_SEL, false);
+	}
+	else if (strstr(command, "BATT_SER_PWR_EN"))
+	{
+		bValid = set_rail(command, "BATT_SER_PWR_EN", PM_POWER_BIT_BATT_SER_PWR, false);
+	}
+	else if (strstr(command, "CTD_PWR_EN"))
+	{
+		bValid = set_rail(command, "CTD_PWR_EN", PM_POWER_BIT_CTD_PWR, false);
+	}
+	else if (strstr(command, "DRIVER_EN"))
+	{
+		bValid = set_rail(command, "DRIVER_EN", PM_POWER_BIT_DRIVER, false);
+	}
+	else if (strstr(command, "Main_PWR_EN"))
+	{
+		bValid = set_rail(command, "Main_PWR_EN", PM_POWER_BIT_MAIN_PWR, false);
+	}
+	else if (strstr(command, "VBS_PWR_EN"))
+	{
+		bValid = set_rail(command, "VBS_PWR_EN", PM_POWER_BIT_VBS_PWR, false);
+	}
+	else if (strstr(command, "VBS_SER_PWR_EN"))
+	{
+		bValid = set_rail(command, "VBS_SER_PWR_EN", PM_POWER_BIT_VBS_SER_PWR, false);
+	}
+	else if (strstr(command, "WCM_DIAG_EN"))
+	{
+		bValid = set_rail(command, "WCM_DIAG_EN", PM_POWER_BIT_WCM_DIAG, false);
+	}
 	else if (strstr(command, "WCM_PWR_EN"))
+	{
+		bValid = set_rail(command, "WCM_PWR_EN", PM_POWER_BIT_WCM_PWR, false);
+	}
+	else if (strstr(command, "WCM_RLY"))
 	{
 		token = strtok(command, " ");
 		token = strtok(NULL, " ");
-		i = atoi(token);
-		sprintf(command, "WCM_PWR_EN %d", i);
-		if (i == 0)
+		i = (token != NULL) ? atoi(token) : 0;
+
+		if (token == NULL)
 		{
-			pm_gpio_wcm_power_off();
+			bValid = false;
 		}
-		else
+		else if (pm_sequencer_busy())
 		{
-			pm_gpio_wcm_power_on();
+			pm_usart_send_pc_message("handle_command: Power profile transition running!\r\n");
+			sprintf(command, "WCM_RLY busy");
+			bValid = false;
 		}
-	}
-	else if (strstr(command, "WCM_RLY"))
-	{
-		b = pm_gpio_driver_get();
-		if (b == 0)
+		else if (set_wcm_relay(i != 0))
 		{
-			token = strtok(command, " ");
-			token = strtok(NULL, " ");
-			i = atoi(token);
 			sprintf(command, "WCM_RLY %d", i);
-			if (i == 0)
-			{
-
-				pm_gpio_wcm_power_off();
-				pm_gpio_wcm_relay_off();
-				b = pm_gpio_wcm_power_get();
-				sprintf(response, "WCM_PWR_EN %d\r\n", (b) ? 1 : 0);
-				pm_usart_send_pc_message(response);
-			}
-			else
-			{
-				pm_gpio_wcm_relay_on();
-				pm_gpio_wcm_power_on();
-				b = pm_gpio_wcm_power_get();
-				sprintf(response, "WCM_PWR_EN %d\r\n", (b) ? 1 : 0);
-				pm_usart_send_pc_message(response);				
-			}
+			b = pm_gpio_wcm_power_get();
+			sprintf(response, "WCM_PWR_EN %d\r\n", (b) ? 1 : 0);
+			pm_usart_send_pc_message(response);
 		}
 		else
 		{
@@ -537,12 +591,126 @@ static bool handle_command(char *command)
 }	// End of handle_command
 
 
+/****************************************************************************************
+Local function to run a serial command and follow its response with "<command> VALID"
+or "<command> INVALID"
+*****************************************************************************************/
+static bool run_command(char *command)
+{
+	bool bValid;
+
+	bValid = handle_command(command);
+	pm_usart_send_pc_message(command);
+	pm_usart_send_pc_message(" ");
+	if (bValid)
+	{
+		pm_usart_send_pc_message("VALID\r\n");
+	}
+	else
+	{
+		pm_usart_send_pc_message("INVALID\r\n");
+	}
+
+	return (bValid);
+
+}	// End of run_command
+
+
+/****************************************************************************************
+Local function to handle a framed request, "#<sequence> <command>[;<command>...]"
+
+The sequence is 0 to 65535, chosen by the host. The commands are run in order and
+every line of their responses, including the VALID/INVALID after each, starts with
+"@<sequence> ". The response ends with "@<sequence> END <commands> <valid commands>",
+or is only "@<sequence> ERROR <EMPTY | TOO_MANY>" when nothing was run. A request
+whose sequence cannot be read gets "@- ERROR FRAME". Unframed commands are answered
+as before, and data sent later (log_dump, adc_capture samples) is not framed
+*****************************************************************************************/
+static void handle_frame(char *frame)
+{
+	char response[48];
+	char command[COMMAND_LENGTH];
+	char *commands[FRAME_MAX_COMMANDS];
+	char *end;
+	char *next;
+	unsigned long sequence;
+	uint8_t count;
+	uint8_t valid;
+	uint8_t i;
+
+	sequence = strtoul(&frame[1], &end, 10);
+	if ((end == &frame[1]) || (sequence > 65535ul) || ((*end != ' ') && (*end != '\0')))
+	{
+		frames_rejected++;
+		pm_usart_send_pc_message("@- ERROR FRAME\r\n");
+		return;
+	}
+
+	// Split the batch first, handle_command() may use strtok()
+	count = 0;
+	next = end;
+	while (next != NULL)
+	{
+		while ((*next == ' ') || (*next == ';'))
+		{
+			next++;
+		}
+		if (*next == '\0')
+		{
+			break;
+		}
+		if (count == FRAME_MAX_COMMANDS)
+		{
+			frames_rejected++;
+			sprintf(response, "@%lu ERROR TOO_MANY\r\n", sequence);
+			pm_usart_send_pc_message(response);
+			return;
+		}
+
+		commands[count++] = next;
+		next = strchr(next, ';');
+		if (next != NULL)
+		{
+			*next++ = '\0';
+		}
+	}
+
+	if (count == 0)
+	{
+		frames_rejected++;
+		sprintf(response, "@%lu ERROR EMPTY\r\n", sequence);
+		pm_usart_send_pc_message(response);
+		return;
+	}
+
+	frames++;
+	frame_commands += count;
+
+	pm_usart_frame_begin((uint16_t)sequence);
+	valid = 0;
+	for (i = 0; i < count; i++)
+	{
+		// handle_command() may rewrite its command with a longer one, so each
+		// gets a whole buffer of its own rather than running in the frame
+		strncpy(command, commands[i], COMMAND_LENGTH - 1);
+		command[COMMAND_LENGTH - 1] = '\0';
+		if (run_command(command))
+		{
+			valid++;
+		}
+	}
+	sprintf(response, "END %u %u\r\n", count, valid);
+	pm_usart_send_pc_message(response);
+	pm_usart_frame_end();
+
+}	// End of handle_frame
+
+
 /****************************************************************************************
 Local function to handle SPI commands
 *****************************************************************************************/
 static void handle_spi_command(char *command, char *response)
 {
-	bool b;
 	char *token;
 	enum status_code status;
 	int i;
@@ -552,27 +720,12 @@ static void handle_spi_command(char *command, char *response)
 	//Altimeter
 	double mc3416_angle;
 
-	// Power bits
-	bool en_3v3va;
-	static bool batt;
-	static bool driver;
-	static bool vbs;
-	static bool vbs_serial;
-	static bool wcm_d;
-	static bool wcm_p;
-	static bool wcm_r;
-
-	// Status bits
-	bool accel;
-	static bool alcc;
-	static bool fault;
-	static bool gpio1;
-	static bool gpio2;
-	static bool pg;
-
 	// LEAK
 	float v;
 
+	// POWER and STATUS
+	char bits[8];
+
 	// LTC2944
 	double voltage;
 	static double charge = 0.0;
@@ -681,30 +834,18 @@ static void handle_spi_command(char *command, char *response)
 	{
 		strcpy(last_command, command);
 
-		en_3v3va = pm_gpio_3v3va_get();
-		batt = pm_gpio_battery_select_get();
-		driver = pm_gpio_driver_get();
-		vbs = pm_gpio_vbs_power_get();
-		vbs_serial = pm_gpio_vbs_serial_power_get();
-		wcm_d = pm_gpio_wcm_diagnostics_enable_get();
-		wcm_p = pm_gpio_wcm_power_get();
-		wcm_r = pm_gpio_wcm_relay_get();
-
-		sprintf(response, "%*d",spi_command_length, (en_3v3va) ? 1 : 0);
+		// All the power bits in one page
+		sprintf(bits, "0x%03x", pm_gpio_power_bits_get());
+		sprintf(response, "%*s", spi_command_length, bits);
 		num_sent = 1;
 	}
 	else if (strstr(command, "STATUS"))
 	{
 		strcpy(last_command, command);
 
-		accel = pm_gpio_accelerometer_interrupt_get();
-		gpio1 = pm_gpio_ext_gpio1_get();
-		gpio2 = pm_gpio_ext_gpio2_get();
-		pg = pm_gpio_lt8618_pg_get();
-		alcc = pm_gpio_n_ltc2944_alcc_get();
-		fault = pm_gpio_wcm_fault_get();
-
-		sprintf(response, "%*d",spi_command_length, (accel) ? 1 : 0);
+		// All the status bits in one page
+		sprintf(bits, "0x%02x", pm_gpio_status_bits_get());
+		sprintf(response, "%*s", spi_command_length, bits);
 		num_sent = 1;
 	}
 	else if (strstr(command, "RESP"))
@@ -760,205 +901,50 @@ static void handle_spi_command(char *command, char *response)
 				sprintf(response, "--------");
 			}
 		}
-		else if (strstr(last_command, "POWER"))
+		else if (strstr(last_command, "POWER") || strstr(last_command, "STATUS"))
 		{
-			if (num_sent == 1)
-			{
-				sprintf(response, "%*d",spi_command_length, (batt) ? 1 : 0);
-				num_sent = 2;
-			}
-			else if (num_sent == 2)
-			{
-				sprintf(response, "%*d",spi_command_length, (driver) ? 1 : 0);
-				num_sent = 3;
-			}
-			else if (num_sent == 3)
-			{
-				sprintf(response, "%*d",spi_command_length, (vbs) ? 1 : 0);
-				num_sent = 4;
-			}
-			else if (num_sent == 4)
-			{
-				sprintf(response, "%*d",spi_command_length, (vbs_serial) ? 1 : 0);
-				num_sent = 5;
-			}
-			else if (num_sent == 5)
-			{
-				sprintf(response, "%*d",spi_command_length, (wcm_d) ? 1 : 0);
-				num_sent = 6;
-			}
-			else if (num_sent == 6)
-			{
-				sprintf(response, "%*d",spi_command_length, (wcm_p) ? 1 : 0);
-				num_sent = 7;
-			}
-			else if (num_sent == 7)
-			{
-				sprintf(response, "%*d",spi_command_length, (wcm_r) ? 1 : 0);
-				num_sent = 8;
-			}
-			else
-			{
-				sprintf(response, "--------");
-			}
-		}
-		else if (strstr(last_command, "STATUS"))
-		{
-			if (num_sent == 1)
-			{
-				sprintf(response, "%*d",spi_command_length, (gpio1) ? 1 : 0);
-				num_sent = 2;
-			}
-			else if (num_sent == 2)
-			{
-				sprintf(response, "%*d",spi_command_length, (gpio2) ? 1 : 0);
-				num_sent = 3;
-			}
-			else if (num_sent == 3)
-			{
-				sprintf(response, "%*d",spi_command_length, (pg) ? 1 : 0);
-				num_sent = 4;
-			}
-			else if (num_sent == 4)
-			{
-				sprintf(response, "%*d",spi_command_length, (alcc) ? 1 : 0);
-				num_sent = 5;
-			}
-			else if (num_sent == 5)
-			{
-				sprintf(response, "%*d",spi_command_length, (fault) ? 1 : 0);
-				num_sent = 6;
-			}
-			else
-			{
-				sprintf(response, "--------");
-			}
+			sprintf(response, "--------");
 		}
 	}
 	else if (strstr(command, "+3V3VA"))
 	{
-		token = strtok(command, " ");
-		token = strtok(NULL, " ");
-		i = atoi(token);
-		sprintf(command, "+3V3VA_EN %d", i);
-		if (i == 0)
-		{
-			pm_gpio_3v3va_off();
-		}
-		else
-		{
-			pm_gpio_3v3va_on();
-		}
+		set_rail(command, "+3V3VA_EN", PM_POWER_BIT_3V3VA, false);
 	}
 	else if (strstr(command, "BATT"))
 	{
-		token = strtok(command, " ");
-		token = strtok(NULL, " ");
-		i = atoi(token);
-		sprintf(command, "BATT_SEL %d", i);
-		if (i == 0)
-		{
-			pm_gpio_battery_select_off();
-		}
-		else
-		{
-			pm_gpio_battery_select_on();
-		}
+		set_rail(command, "BATT_SEL", PM_POWER_BIT_BATT_SEL, false);
 	}
 	else if (strstr(command, "DRIVER"))
 	{
-		token = strtok(command, " ");
-		token = strtok(NULL, " ");
-		i = atoi(token);
-		sprintf(command, "DRIVER_EN %d", i);
-		if (i == 0)
-		{
-			pm_gpio_driver_disable();
-		}
-		else
-		{
-			pm_gpio_driver_enable();
-		}
+		// DRIVER 1 enables the driver, the pin is low then
+		set_rail(command, "DRIVER_EN", PM_POWER_BIT_DRIVER, true);
 	}
 	else if (strstr(command, "VBS_P"))
 	{
-		token = strtok(command, " ");
-		token = strtok(NULL, " ");
-		i = atoi(token);
-		sprintf(command, "VBS_PWR_EN %d", i);
-		if (i == 0)
-		{
-			pm_gpio_vbs_power_off();
-		}
-		else
-		{
-			pm_gpio_vbs_power_on();
-		}
+		set_rail(command, "VBS_PWR_EN", PM_POWER_BIT_VBS_PWR, false);
 	}
 	else if (strstr(command, "VBS_S"))
 	{
-		token = strtok(command, " ");
-		token = strtok(NULL, " ");
-		i = atoi(token);
-		sprintf(command, "VBS_SER_PWR_EN %d", i);
-		if (i == 0)
-		{
-			pm_gpio_vbs_serial_power_off();
-		}
-		else
-		{
-			pm_gpio_vbs_serial_power_on();
-		}
+		set_rail(command, "VBS_SER_PWR_EN", PM_POWER_BIT_VBS_SER_PWR, false);
 	}
 	else if (strstr(command, "WCM_D"))
 	{
-		token = strtok(command, " ");
-		token = strtok(NULL, " ");
-		i = atoi(token);
-		sprintf(command, "WCM_DIAG_EN %d", i);
-		if (i == 0)
-		{
-			pm_gpio_wcm_diagnostics_enable_off();
-		}
-		else
-		{
-			pm_gpio_wcm_diagnostics_enable_on();
-		}
+		set_rail(command, "WCM_DIAG_EN", PM_POWER_BIT_WCM_DIAG, false);
 	}
 	else if (strstr(command, "WCM_P"))
 	{
-		token = strtok(command, " ");
-		token = strtok(NULL, " ");
-		i = atoi(token);
-		sprintf(command, "WCM_PWR_EN %d", i);
-		if (i == 0)
-		{
-			pm_gpio_wcm_power_off();
-		}
-		else
-		{
-			pm_gpio_wcm_power_on();
-		}
+		set_rail(command, "WCM_PWR_EN", PM_POWER_BIT_WCM_PWR, false);
 	}
 	else if (strstr(command, "WCM_EN")) //WCM_RLY Changed to enable for Main SPI Com.
 	{
-		b = pm_gpio_driver_get();
-		if (b == 1)
+		// Same interlock as WCM_RLY, the relay only switches while the driver is enabled
+		token = strtok(command, " ");
+		token = strtok(NULL, " ");
+		if ((token != NULL) && (pm_sequencer_busy() == false))
 		{
-			token = strtok(command, " ");
-			token = strtok(NULL, " ");
 			i = atoi(token);
 			sprintf(command, "WCM_EN %d", i);
-			if (i == 0)
-			{
-				pm_gpio_wcm_power_off();
-				pm_gpio_wcm_relay_off();
-			}
-			else
-			{
-				pm_gpio_wcm_relay_on();
-				pm_gpio_wcm_power_on();
-			}
+			set_wcm_relay(i != 0);
 		}
 	}
 	else
@@ -968,13 +954,112 @@ static void handle_spi_command(char *command, char *response)
 }	// End of handle_spi_command
 
 
+/****************************************************************************************
+Local function to handle a per-rail command, "<name> <0|1>", through the sequencer.
+With bInverted a 1 sets the pin low
+
+A rail held by a sequencer interlock is left as it is and its level is sent, the
+command is echoed as "<name> unchanged". While a power profile transition runs
+nothing is changed, the command is echoed as "<name> busy" and false is returned
+*****************************************************************************************/
+static bool set_rail(char *command, const char *name, uint16_t rail, bool bInverted)
+{
+	char response[48];
+	char *token;
+	int i;
+
+	token = strtok(command, " ");
+	token = strtok(NULL, " ");
+	if (token == NULL)
+	{
+		return (false);
+	}
+	i = atoi(token);
+
+	if (pm_sequencer_busy())
+	{
+		pm_usart_send_pc_message("set_rail: Power profile transition running!\r\n");
+		sprintf(command, "%s busy", name);
+		return (false);
+	}
+
+	if (pm_sequencer_set_rails(rail, ((i != 0) != bInverted) ? rail : 0) != 0)
+	{
+		sprintf(command, "%s %d", name, i);
+	}
+	else
+	{
+		i = ((pm_gpio_power_bits_get() & rail) != 0) != bInverted;
+		sprintf(response, "%s %d\r\n", name, i);
+		pm_usart_send_pc_message(response);
+
+		sprintf(command, "%s unchanged", name);
+	}
+
+	return (true);
+
+}	// End of set_rail
+
+
+/****************************************************************************************
+Local function to close or open the WCM relay, the WCM is powered after the relay
+closes and unpowered before it opens
+
+Returns false if a sequencer interlock holds the relay or the WCM power, nothing is
+changed then
+*****************************************************************************************/
+static bool set_wcm_relay(bool bClosed)
+{
+	// Checked as the two rails will end up, the steps below keep the WCM interlocks
+	if (pm_sequencer_interlocked(PM_POWER_BIT_WCM_RLY | PM_POWER_BIT_WCM_PWR,
+		(bClosed) ? (PM_POWER_BIT_WCM_RLY | PM_POWER_BIT_WCM_PWR) : 0) != 0)
+	{
+		return (false);
+	}
+
+	if (bClosed)
+	{
+		pm_sequencer_set_rails(PM_POWER_BIT_WCM_RLY, PM_POWER_BIT_WCM_RLY);
+		pm_sequencer_set_rails(PM_POWER_BIT_WCM_PWR, PM_POWER_BIT_WCM_PWR);
+	}
+	else
+	{
+		pm_sequencer_set_rails(PM_POWER_BIT_WCM_PWR, 0);
+		pm_sequencer_set_rails(PM_POWER_BIT_WCM_RLY, 0);
+	}
+
+	return (true);
+
+}	// End of set_wcm_relay
+
+
 /****************************************************************************************
 Local function to initialize the internal hardware
+
+The MS5637 reset sequence runs while the LTC2944 is initialized and the MC3416
+wakeup delay is left running after pm_mc3416_init() returns. With bUseCache the
+MS5637 PROM words come from the EEPROM emulator instead of the sensor
 *****************************************************************************************/
-static void initInternalHW(void)
+static void initInternalHW(bool bUseCache)
 {
 	enum status_code status;
 
+	eeprom_configure();
+	pm_boot_trace_mark("eeprom");
+
+	// Write any pending changes before the store is mounted again
+	pm_settings_flush();
+	pm_settings_configure();
+	pm_adc_configure_leak_monitor();
+	pm_boot_trace_mark("settings");
+
+	// Start the MS5637 reset, pm_ms5637_init() waits for whatever is left of it
+	status = pm_ms5637_reset();
+	if (status != STATUS_OK)
+	{
+		pm_usart_send_pc_message("initInternalHW: Could not reset MS5637!\r\n");
+	}
+
 	pm_gpio_ltc2944_i2c_en_on();
 	status = pm_ltc2944_init();
 	pm_gpio_ltc2944_i2c_en_off();
@@ -988,8 +1073,9 @@ static void initInternalHW(void)
 		pm_usart_send_pc_message("initInternalHW: Could not initialize LTC2944!\r\n");
 		pm_usart_send_vbs_command("initInternalHW: Could not initialize LTC2944!\r\n");
 	}
+	pm_boot_trace_mark("ltc2944");
 
- 	status = pm_ms5637_init();
+ 	status = pm_ms5637_init(bUseCache);
  	if (status == STATUS_OK)
  	{
  		pm_usart_send_pc_message("initInternalHW: pm_ms5637_init done\r\n");
@@ -1000,6 +1086,7 @@ static void initInternalHW(void)
  		pm_usart_send_pc_message("initInternalHW: Could not initialize MS5637!\r\n");
  		pm_usart_send_vbs_command("initInternalHW: Could not initialize MS5637!\r\n");
  	}
+	pm_boot_trace_mark("ms5637");
 	
 	status = pm_mc3416_init();
 	if (status == STATUS_OK)
@@ -1012,6 +1099,7 @@ static void initInternalHW(void)
 		pm_usart_send_pc_message("initInternalHW: Could not initialize MC3416!\r\n");
 		pm_usart_send_vbs_command("initInternalHW: Could not initialize MC3416!\r\n");
 	}
+	pm_boot_trace_mark("mc3416");
 	
 }	// End of initInternalHW
 
@@ -1021,8 +1109,11 @@ Function to initialize the Main PM board
 *****************************************************************************************/
 void pm_init(void)
 {
-	// Initialize the clocks, drivers, interfaces and interrupts
+	// Initialize the clocks, drivers, interfaces and interrupts. The DMA is used by the
+	// USART, SPI and ADC from their first configuration
+	pm_dma_init();
 	pm_power_normal_power_mode();
+	pm_boot_trace_start();
 //	pm_clocks_configure(); // Replace by normal_power_mode functions
 //	delay_init();
 	pm_adc_configure();	
@@ -1032,6 +1123,7 @@ void pm_init(void)
 	pm_interrupt_configure();
 */
 	pm_usart_configure();
+	pm_boot_trace_mark("interfaces");
 
 	// Turn on Main board and sensors
 	pm_gpio_3v3va_on();
@@ -1055,8 +1147,12 @@ void pm_init(void)
 	pm_gpio_wcm_diagnostics_enable_off();
 	pm_gpio_wcm_power_off();
 	pm_gpio_wcm_relay_off();
+	pm_boot_trace_mark("gpio");
 
-	initInternalHW();
+	initInternalHW(true);
+
+	pm_logger_configure();
+	pm_boot_trace_mark("logger");
 
 }	// End of pm_init
 
@@ -1073,14 +1169,10 @@ void pm_run(void)
 	config_tc.clock_source = GCLK_GENERATOR_0;
 	config_tc.clock_prescaler = TC_CLOCK_PRESCALER_DIV1024;
 		
-	//	Delay  = 30s
-	// 	Find number of cycles required to get given time delay
-	// 	Desired Time/(prescaler/system clk frequency) = #cycles.
-	//	30s/(1024/12000000) = 351563 cycles.
-	// 	Subtract from max value to get number of clk cycles to load in timer; 2^32 - 351700 ? 0xFFFAA22C
-	config_tc.counter_32_bit.value = 0xFFFAA22C;
+	//	Delay  = WAKE_PERIOD setting, 30s by default, see wake_timer_reload()
 	tc_init(&tc_instance, CONF_TC_MODULE, &config_tc);
 	tc_enable(&tc_instance);
+	wake_timer_reload();
 		
 	tc_register_callback(&tc_instance, tc_callback_to_sleep_mode,
 	TC_CALLBACK_OVERFLOW);
@@ -1088,18 +1180,21 @@ void pm_run(void)
 		
 	bool b;
 	bool bCommandReceived;
-	bool bValid;
+	bool bMainPowered;
 	char command[COMMAND_LENGTH];
+	uint32_t log_period_s;
 	enum status_code retval;
 	int i;
-	uint8_t spi_rx_buffer[SPI_BUFFER_LENGTH] = {0x00};
-	uint8_t spi_tx_buffer[SPI_BUFFER_LENGTH] = {0x00};
+	char spi_rx_buffer[SPI_BUFFER_LENGTH] = {0x00};
+	char spi_tx_buffer[SPI_BUFFER_LENGTH] = {0x00};
 
+	pm_boot_trace_mark("run");
 	pm_usart_send_pc_message("pm_run: started\r\n");
 	pm_usart_send_vbs_command("pm_run: started\r\n");
 	
 
 	bSPIInitialized = false;
+	bMainPowered = pm_gpio_Main_power_get();
 	i = 0;
 	
 	while (1)
@@ -1109,8 +1204,23 @@ void pm_run(void)
 		
 		timer_0_elapsed = false;
 		
-		while (timer_0_elapsed == false)		
+		// A power profile transition is finished before sleeping
+		while ((timer_0_elapsed == false) || pm_sequencer_busy())
 		{
+			// Write any settings changes, one NVM operation at a time
+			pm_settings_service();
+			pm_logger_service();
+			pm_adc_leak_service();
+			pm_adc_capture_service();
+			pm_sequencer_service();
+
+			// The SPI master goes down with main power, from a command or a profile
+			b = pm_gpio_Main_power_get();
+			if (bMainPowered && (b == false))
+			{
+				bSPIInitialized = false;
+			}
+			bMainPowered = b;
 					
 			if (bSPIInitialized == false)
 			{
@@ -1118,14 +1228,14 @@ void pm_run(void)
 				b = pm_gpio_spi_slave_select_get();
 				if (b == true)
 				{
-					for (i = 0; i < 8; i++)
+					for (i = 0; i < PM_SPI_FRAME_LENGTH; i++)
 					{
 						spi_tx_buffer[i] = '-';
 					}
 
 					pm_spi_configure(MODE_ENABLED);
 
-					retval = pm_spi_start_read(spi_tx_buffer, spi_rx_buffer, spi_command_length);
+					retval = pm_spi_start(spi_tx_buffer);
 					if (retval == STATUS_OK)
 					{
 						bSPIInitialized = true;
@@ -1134,7 +1244,7 @@ void pm_run(void)
 					}
 					else
 					{
-						pm_usart_send_pc_message("pm_run: pm_spi_start_read failed (1)!\r\n");
+						pm_usart_send_pc_message("pm_run: pm_spi_start failed!\r\n");
 					}
 				}
 			}
@@ -1168,22 +1278,11 @@ void pm_run(void)
 			// Check for an SPI command
 			if (bSPIInitialized == true)
 			{
-				if (pm_spi_transfer_complete())
+				// The next frame is already armed, the response goes out as soon as it is set
+				if (pm_spi_get_command(spi_rx_buffer))
 				{
-					delay_ms(10);
-
-					// Handle the SPI buffer data
-					spi_rx_buffer[spi_command_length] = '\0';
-					handle_spi_command((char *)spi_rx_buffer, (char *)spi_tx_buffer);
-
-					// Start another SPI read
-					retval = pm_spi_start_read(spi_tx_buffer, spi_rx_buffer, spi_command_length);
-					if (retval != STATUS_OK)
-					{
-						bSPIInitialized = false;
-
-						pm_usart_send_pc_message("pm_run: pm_spi_start_read failed (2)!\r\n");
-					}
+					handle_spi_command(spi_rx_buffer, spi_tx_buffer);
+					pm_spi_set_response(spi_tx_buffer);
 				}
 			}
 		
@@ -1191,19 +1290,17 @@ void pm_run(void)
 			retval = pm_usart_check_for_pc_command();
 			if (retval == STATUS_OK)
 			{
+				// Further requests wait in the receive ring, one is handled per pass
 				bCommandReceived = pm_usart_get_pc_command(command, COMMAND_LENGTH);
 				if (bCommandReceived)
 				{
-					bValid = handle_command(command);
-					pm_usart_send_pc_message(command);
-					pm_usart_send_pc_message(" ");
-					if (bValid)
+					if (command[0] == '#')
 					{
-						pm_usart_send_pc_message("VALID\r\n");
+						handle_frame(command);
 					}
 					else
 					{
-						pm_usart_send_pc_message("INVALID\r\n");
+						run_command(command);
 					}
 				}
 			}
@@ -1215,10 +1312,37 @@ void pm_run(void)
 // 			}
 			
 		}
+		pm_logger_sample();
+		pm_logger_flush();
+		pm_settings_flush();
 		pm_usart_send_pc_message("pm_run: entering sleep mode\r\n");
 		pm_power_configure_wakeup_en();
-		pm_power_low_power_mode();
-		pm_power_normal_power_mode();
+
+		// The RTC wakes the MCU every LOG_PERIOD seconds to take a sample, until a
+		// wakeup pin ends the sleep. The tick does not run in standby, the RTC time
+		// is added to it
+		log_period_s = pm_settings_get(SETTINGS_KEY_LOG_PERIOD);
+		if (log_period_s != 0)
+		{
+			pm_power_rtc_wakeup_enable(log_period_s);
+		}
+		while (1)
+		{
+			pm_power_low_power_mode();
+			pm_power_normal_power_mode();
+			if ((log_period_s == 0) || !pm_power_rtc_wakeup_occurred())
+			{
+				break;
+			}
+
+			pm_timer_add_ms(log_period_s * 1000ul);
+			pm_logger_sample();
+			pm_logger_flush();
+		}
+		if (log_period_s != 0)
+		{
+			pm_timer_add_ms(pm_power_rtc_wakeup_disable());
+		}
 		pm_usart_send_pc_message("pm_run: exiting sleep mode\r\n");
 	}
 }	// End of pm_run
@@ -2,17 +2,42 @@
 pm_adc.c:   power module (PM) ADC functions
 
 Written by:
-	Daayim Asim, B.Eng. 
+	Daayim Asim, B.Eng.
 	Computer Engineer Student
-	 
+
 
 Date:
 	February 2022
+
+Note(s):
+- The leak detector (AIN0) is converted continuously (free running) and each result is
+	the hardware average of 16 samples, so pm_adc_read() only reads the last result
+- The ADC is clocked from GCLK generator 2 (ULP32K / 64) which runs in standby, a
+	result takes about 0.4 s
+- The window monitor interrupt fires when the result crosses the LEAK_THRESHOLD
+	setting and wakes the MCU from standby. pm_adc_leak_service() then sends
+	"LEAK_EVENT <V>\r\n" and arms the window for the voltage falling back below the
+	threshold minus leak_hysteresis_mv, which sends "LEAK_CLEAR <V>\r\n". Nothing is
+	polled while the voltage stays on one side of the threshold
+- The ADC driver is in polled mode (ADC_CALLBACK_MODE=false), so the interrupt is
+	enabled and handled here through the registers
+- adc_capture <n> records the next n results (up to PM_ADC_CAPTURE_LENGTH) with the
+	DMA (PM_DMA_CHANNEL_ADC), which keeps running in standby, so the CPU is not woken
+	for each one. pm_adc_capture_service() then sends "ADC_CAPTURE <n> <mean V> <min
+	V> <max V>" and the results as "ADC_SAMPLES <first> <counts>..." lines of 16
 *****************************************************************************************/
 
 
 #include <adc.h>
+#include <clock.h>
+#include <gclk.h>
+#include <stdio.h>
+#include <system_interrupt.h>
 #include "pm_adc.h"
+#include "pm_dma.h"
+#include "pm_settings.h"
+#include "pm_timer.h"
+#include "pm_usart.h"
 
 
 /****************************************************************************************
@@ -21,6 +46,85 @@ Local variable(s)
 
 static struct adc_module adc_module_struct;
 
+// Conversion from a 12 bit result to volts
+static const float adc_full_scale = 3.3;
+
+// The leak clears once the voltage is this far below the threshold
+static const uint16_t leak_hysteresis_mv = 50;
+
+// Set by the window monitor interrupt
+static volatile bool bLeakInterrupt = false;
+static volatile uint16_t leak_interrupt_result = 0;
+
+// True between a LEAK_EVENT and a LEAK_CLEAR
+static bool bLeakActive = false;
+
+static bool bResultReady = false;
+
+// Results recorded by the DMA for adc_capture
+static uint16_t capture_results[PM_ADC_CAPTURE_LENGTH];
+static uint16_t capture_count = 0;
+static bool bCapturing = false;
+static volatile bool bCaptureDone = false;
+static volatile bool bCaptureError = false;
+
+
+/****************************************************************************************
+Local function(s)
+*****************************************************************************************/
+
+static uint16_t adc_mv_to_counts(uint32_t);
+static void adc_arm_leak_window(void);
+static void adc_capture_done(uint8_t, bool);
+
+
+/****************************************************************************************
+Local function to convert millivolts to a 12 bit result
+*****************************************************************************************/
+static uint16_t adc_mv_to_counts(uint32_t mv)
+{
+	uint32_t counts;
+
+	counts = (mv * 4095ul + 1650ul) / 3300ul;
+
+	return ((counts > 4095ul) ? 4095 : (uint16_t)counts);
+
+}	// End of adc_mv_to_counts
+
+
+/****************************************************************************************
+Local function to set the window for the next leak crossing and enable its interrupt
+*****************************************************************************************/
+static void adc_arm_leak_window(void)
+{
+	uint32_t threshold_mv;
+
+	adc_module_struct.hw->INTENCLR.reg = ADC_INTENCLR_WINMON;
+
+	threshold_mv = pm_settings_get(SETTINGS_KEY_LEAK_THRESHOLD);
+	if (threshold_mv == 0)
+	{
+		adc_set_window_mode(&adc_module_struct, ADC_WINDOW_MODE_DISABLE, 0, 0);
+		bLeakActive = false;
+		return;
+	}
+
+	if (bLeakActive)
+	{
+		// Wait for the voltage to fall back below the threshold
+		threshold_mv = (threshold_mv > leak_hysteresis_mv) ? threshold_mv - leak_hysteresis_mv : 0;
+		adc_set_window_mode(&adc_module_struct, ADC_WINDOW_MODE_BELOW_UPPER, 0, adc_mv_to_counts(threshold_mv));
+	}
+	else
+	{
+		adc_set_window_mode(&adc_module_struct, ADC_WINDOW_MODE_ABOVE_LOWER, adc_mv_to_counts(threshold_mv), 0);
+	}
+
+	adc_clear_status(&adc_module_struct, ADC_STATUS_WINDOW);
+	adc_module_struct.hw->INTENSET.reg = ADC_INTENSET_WINMON;
+
+}	// End of adc_arm_leak_window
+
 
 /****************************************************************************************
 Function to configure the Main PM ADC module
@@ -30,59 +134,257 @@ See https://asf.microchip.com/docs/latest/saml21/html/asfdoc_sam0_adc_basic_use_
 void pm_adc_configure(void)
 {
 	static bool bFirst = true;
-	
+
 	struct adc_config adc_config_struct;
-	
+	struct pm_dma_channel_config dma_config_struct;
+	struct system_gclk_gen_config gclk_gen_config_struct;
+
+	// GCLK generator 2 keeps the ADC running in standby
+	system_gclk_gen_get_config_defaults(&gclk_gen_config_struct);
+
+	gclk_gen_config_struct.source_clock   = SYSTEM_CLOCK_SOURCE_ULP32K;
+	gclk_gen_config_struct.division_factor = 1;
+	gclk_gen_config_struct.run_in_standby = true;
+
+	system_gclk_gen_set_config(GCLK_GENERATOR_2, &gclk_gen_config_struct);
+	system_gclk_gen_enable(GCLK_GENERATOR_2);
+
 	adc_get_config_defaults(&adc_config_struct);
-	
+
+	adc_config_struct.clock_source = GCLK_GENERATOR_2;
+	adc_config_struct.clock_prescaler = ADC_CLOCK_PRESCALER_DIV64;
 	adc_config_struct.positive_input = ADC_POSITIVE_INPUT_PIN0;
 	adc_config_struct.reference = ADC_REFERENCE_INTVCC2;
-	
+	adc_config_struct.resolution = ADC_RESOLUTION_CUSTOM;
+	adc_config_struct.accumulate_samples = ADC_ACCUMULATE_SAMPLES_16;
+	adc_config_struct.divide_result = ADC_DIVIDE_RESULT_16;
+	adc_config_struct.freerunning = true;
+	adc_config_struct.run_in_standby = true;
+	adc_config_struct.on_demand = false;
+
 	if (bFirst)
 	{
 		bFirst = false;
 	}
 	else
 	{
+		system_interrupt_disable(SYSTEM_INTERRUPT_MODULE_ADC);
 		adc_disable(&adc_module_struct);
 	}
-	
+
 	adc_init(&adc_module_struct, ADC, &adc_config_struct);
-	
+
 	adc_enable(&adc_module_struct);
-	
+
+	bResultReady = false;
+	bLeakInterrupt = false;
+	bLeakActive = false;
+
+	// A capture in progress is abandoned
+	dma_config_struct.trigger = ADC_DMAC_ID_RESRDY;
+	dma_config_struct.bHalfWord = true;
+	dma_config_struct.bSourceIncrement = false;
+	dma_config_struct.bDestinationIncrement = true;
+	dma_config_struct.bRunInStandby = true;
+	dma_config_struct.cpu_ns_per_beat = pm_dma_interrupt_ns();
+	dma_config_struct.done = adc_capture_done;
+	pm_dma_configure(PM_DMA_CHANNEL_ADC, &dma_config_struct);
+
+	bCapturing = false;
+	bCaptureDone = false;
+
+	// The first conversion is started by hand, later ones are free running
+	adc_start_conversion(&adc_module_struct);
+
+	adc_arm_leak_window();
+	system_interrupt_enable(SYSTEM_INTERRUPT_MODULE_ADC);
+
 }	// End of pm_adc_configure
 
 
 /****************************************************************************************
-Function to read an ADC value
+Function to rearm the leak monitor after the LEAK_THRESHOLD setting has changed
+*****************************************************************************************/
+void pm_adc_configure_leak_monitor(void)
+{
+	adc_arm_leak_window();
+
+}	// End of pm_adc_configure_leak_monitor
+
+
+/****************************************************************************************
+Function to read the last averaged ADC value
 *****************************************************************************************/
 enum status_code pm_adc_read(float *v)
 {
-	uint16_t result;
-	enum status_code status;
-	
-	adc_start_conversion(&adc_module_struct);
-	
-	while (1)
+	uint32_t start;
+
+	// Only the first result after configuring has to be waited for
+	if (bResultReady == false)
 	{
-		status = adc_read(&adc_module_struct, &result);
-		if (status == STATUS_BUSY)
-		{
-			continue;
-		}
-		else
+		start = pm_timer_get_ms();
+		while ((adc_get_status(&adc_module_struct) & ADC_STATUS_RESULT_READY) == 0)
 		{
-			if (status == STATUS_OK)
+			if (pm_timer_elapsed_ms(start) > 1000)
 			{
-				*v = 3.3 * (float)result / 4095.0;
+				return (STATUS_ERR_TIMEOUT);
 			}
-			break;
 		}
+		bResultReady = true;
 	}
-	
-	return (status);
-	
+
+	*v = adc_full_scale * (float)adc_module_struct.hw->RESULT.reg / 4095.0;
+
+	return (STATUS_OK);
+
 }	// End of pm_adc_read
 
 
+/****************************************************************************************
+Function to report a leak threshold crossing
+
+Only acts after the window monitor interrupt, call from the main loop
+*****************************************************************************************/
+void pm_adc_leak_service(void)
+{
+	char response[32];
+	float v;
+
+	if (bLeakInterrupt == false)
+	{
+		return;
+	}
+	bLeakInterrupt = false;
+
+	v = adc_full_scale * (float)leak_interrupt_result / 4095.0;
+
+	bLeakActive = !bLeakActive;
+	sprintf(response, "%s %.2f\r\n", bLeakActive ? "LEAK_EVENT" : "LEAK_CLEAR", v);
+	pm_usart_send_pc_message(response);
+
+	adc_arm_leak_window();
+
+}	// End of pm_adc_leak_service
+
+
+/****************************************************************************************
+Function to start recording the next results
+
+Returns STATUS_BUSY while the last capture is running
+*****************************************************************************************/
+enum status_code pm_adc_capture_start(uint16_t count)
+{
+	enum status_code status;
+
+	if ((count == 0) || (count > PM_ADC_CAPTURE_LENGTH))
+	{
+		return (STATUS_ERR_INVALID_ARG);
+	}
+	if (bCapturing)
+	{
+		return (STATUS_BUSY);
+	}
+
+	bCaptureDone = false;
+	status = pm_dma_start(PM_DMA_CHANNEL_ADC, &adc_module_struct.hw->RESULT.reg, capture_results, count);
+	if (status == STATUS_OK)
+	{
+		capture_count = count;
+		bCapturing = true;
+	}
+
+	return (status);
+
+}	// End of pm_adc_capture_start
+
+
+/****************************************************************************************
+Function to send a finished capture to the PC, call from the main loop
+*****************************************************************************************/
+void pm_adc_capture_service(void)
+{
+	char response[112];
+	uint16_t i;
+	uint16_t j;
+	uint16_t min;
+	uint16_t max;
+	uint32_t total;
+	int n;
+
+	if ((bCapturing == false) || (bCaptureDone == false))
+	{
+		return;
+	}
+	bCapturing = false;
+	bResultReady = true;
+
+	if (bCaptureError)
+	{
+		pm_usart_send_pc_message("ADC_CAPTURE ERROR\r\n");
+		return;
+	}
+
+	min = 0xffff;
+	max = 0;
+	total = 0;
+	for (i = 0; i < capture_count; i++)
+	{
+		min = (capture_results[i] < min) ? capture_results[i] : min;
+		max = (capture_results[i] > max) ? capture_results[i] : max;
+		total += capture_results[i];
+	}
+
+	sprintf(response, "ADC_CAPTURE %u %.3f %.3f %.3f\r\n", capture_count,
+		adc_full_scale * ((float)total / capture_count) / 4095.0,
+		adc_full_scale * (float)min / 4095.0, adc_full_scale * (float)max / 4095.0);
+	pm_usart_send_pc_message(response);
+
+	for (i = 0; i < capture_count; i += 16)
+	{
+		n = sprintf(response, "ADC_SAMPLES %u", i);
+		for (j = i; (j < i + 16) && (j < capture_count); j++)
+		{
+			n += sprintf(&response[n], " %u", capture_results[j]);
+		}
+		sprintf(&response[n], "\r\n");
+		pm_usart_send_pc_message(response);
+	}
+
+}	// End of pm_adc_capture_service
+
+
+/****************************************************************************************
+Local function called by the DMA after the last result of a capture
+*****************************************************************************************/
+static void adc_capture_done(uint8_t channel, bool bError)
+{
+	bCaptureError = bError;
+	bCaptureDone = true;
+
+}	// End of adc_capture_done
+
+
+/****************************************************************************************
+Function to return true while the leak detector is above the threshold
+*****************************************************************************************/
+bool pm_adc_leak_active(void)
+{
+	return (bLeakActive);
+
+}	// End of pm_adc_leak_active
+
+
+/****************************************************************************************
+ADC interrupt handler, only the window monitor interrupt is enabled
+*****************************************************************************************/
+void ADC_Handler(void)
+{
+	leak_interrupt_result = adc_module_struct.hw->RESULT.reg;
+
+	// Disabled until pm_adc_leak_service() arms the window for the other direction
+	adc_module_struct.hw->INTENCLR.reg = ADC_INTENCLR_WINMON;
+	adc_module_struct.hw->INTFLAG.reg = ADC_INTFLAG_WINMON;
+
+	bLeakInterrupt = true;
+
+}	// End of ADC_Handler
@@ -15,9 +15,24 @@ Date:
 #define PM_ADC_H
 
 
+#include <stdbool.h>
+#include <stdint.h>
+#include <status_codes.h>
+
+// Results recorded by adc_capture, one every 0.4 s
+#define PM_ADC_CAPTURE_LENGTH		64
+
+
 void pm_adc_configure(void);
+void pm_adc_configure_leak_monitor(void);
 enum status_code pm_adc_read(float *);
 
+void pm_adc_leak_service(void);
+bool pm_adc_leak_active(void);
+
+enum status_code pm_adc_capture_start(uint16_t);
+void pm_adc_capture_service(void);
+
 
 #endif	// PM_ADC_H
 
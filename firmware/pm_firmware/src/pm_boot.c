@@ -0,0 +1,83 @@
+/****************************************************************************************
+pm_boot.c:   power module (PM) boot trace functions
+
+Written by:
+	Daayim Asim, B.Eng.
+	Computer Engineer Student
+
+
+Date:
+	October 2022
+
+Note(s):
+- Records the pm_timer time at the end of each init stage so the time to first
+	response can be measured, reported with the read_boot_trace command
+- Stage names must be string literals, only the pointer is stored
+*****************************************************************************************/
+
+#include <stdio.h>
+#include <stdint.h>
+#include "pm_boot.h"
+#include "pm_timer.h"
+#include "pm_usart.h"
+
+#define BOOT_TRACE_LENGTH 12
+
+
+/****************************************************************************************
+Local variable(s)
+*****************************************************************************************/
+
+static const char *stage_names[BOOT_TRACE_LENGTH];
+static uint32_t stage_ms[BOOT_TRACE_LENGTH];
+static uint8_t stage_count = 0;
+static uint32_t start_ms = 0;
+
+
+/****************************************************************************************
+Function to start a new boot trace
+*****************************************************************************************/
+void pm_boot_trace_start(void)
+{
+	stage_count = 0;
+	start_ms = pm_timer_get_ms();
+
+}	// End of pm_boot_trace_start
+
+
+/****************************************************************************************
+Function to record the end of a boot stage
+
+Stages past BOOT_TRACE_LENGTH are dropped
+*****************************************************************************************/
+void pm_boot_trace_mark(const char *stage)
+{
+	if (stage_count >= BOOT_TRACE_LENGTH)
+	{
+		return;
+	}
+
+	stage_names[stage_count] = stage;
+	stage_ms[stage_count] = pm_timer_elapsed_ms(start_ms);
+	stage_count++;
+
+}	// End of pm_boot_trace_mark
+
+
+/****************************************************************************************
+Function to send the boot trace to the PC
+
+Each stage is sent as "BOOT <stage> <ms since the start of the trace>"
+*****************************************************************************************/
+void pm_boot_trace_report(void)
+{
+	char response[64];
+	uint8_t i;
+
+	for (i = 0; i < stage_count; i++)
+	{
+		sprintf(response, "BOOT %s %lu\r\n", stage_names[i], (unsigned long)stage_ms[i]);
+		pm_usart_send_pc_message(response);
+	}
+
+}	// End of pm_boot_trace_report
@@ -0,0 +1,23 @@
+/****************************************************************************************
+pm_boot.h: Include file for pm_boot.c
+
+Written by:
+	Daayim Asim, B.Eng.
+	Computer Engineer Student
+
+
+Date:
+	October 2022
+*****************************************************************************************/
+
+
+#ifndef PM_BOOT_H_
+#define PM_BOOT_H_
+
+
+void pm_boot_trace_start(void);
+void pm_boot_trace_mark(const char *);
+void pm_boot_trace_report(void);
+
+
+#endif /* PM_BOOT_H_ */
@@ -25,6 +25,9 @@ static const uint8_t lowpower_mode = 1;
 // External crystal frequency
 static const uint32_t crystal_frequency = 12000000ul;
 
+// Internal ultra low power oscillator frequency
+static const uint32_t ulp32k_frequency = 32768ul;
+
 
 /****************************************************************************************
 Function to configure the clocks
@@ -66,4 +69,21 @@ void pm_clocks_configure(uint8_t mode)
 	system_gclk_gen_set_config(GCLK_GENERATOR_0, &gclk_gen_config_struct);
 	system_gclk_gen_enable(GCLK_GENERATOR_0);
 
-}	// End of pm_clocks_configure
\ No newline at end of file
+}	// End of pm_clocks_configure
+
+
+/****************************************************************************************
+Function to return the GCLK generator 0 frequency of a clock mode
+
+Lets the peripheral drivers check a setting against both modes without switching
+*****************************************************************************************/
+uint32_t pm_clocks_get_hz(uint8_t mode)
+{
+	if (mode == MODE_LOWPOWER)
+	{
+		return (ulp32k_frequency);
+	}
+
+	return (crystal_frequency);
+
+}	// End of pm_clocks_get_hz
@@ -17,6 +17,7 @@ Date:
 
 void pm_clocks_configure(uint8_t);
 void pm_clocks_configure_lowpower(void);
+uint32_t pm_clocks_get_hz(uint8_t);
 
 
 #endif	// PM_CLOCKS_H
@@ -0,0 +1,76 @@
+/****************************************************************************************
+pm_crc.c:   power module (PM) CRC functions
+
+Written by:
+	Daayim Asim, B.Eng.
+	Computer Engineer Student
+
+
+Date:
+	October 2022
+*****************************************************************************************/
+
+#include "pm_crc.h"
+
+
+/****************************************************************************************
+Function to calculate the CRC-8 (polynomial 0x07, initial value 0x00) of a buffer
+*****************************************************************************************/
+uint8_t pm_crc8(const uint8_t *data, uint16_t length)
+{
+	uint8_t crc;
+	uint16_t i;
+	uint8_t j;
+
+	crc = 0x00;
+	for (i = 0; i < length; i++)
+	{
+		crc ^= data[i];
+		for (j = 0; j < 8; j++)
+		{
+			if (crc & 0x80)
+			{
+				crc = (crc << 1) ^ 0x07;
+			}
+			else
+			{
+				crc = crc << 1;
+			}
+		}
+	}
+
+	return (crc);
+
+}	// End of pm_crc8
+
+
+/****************************************************************************************
+Function to calculate the CRC-16 (CCITT, polynomial 0x1021, initial value 0xFFFF)
+of a buffer
+*****************************************************************************************/
+uint16_t pm_crc16(const uint8_t *data, uint16_t length)
+{
+	uint16_t crc;
+	uint16_t i;
+	uint8_t j;
+
+	crc = 0xffff;
+	for (i = 0; i < length; i++)
+	{
+		crc ^= (uint16_t)data[i] << 8;
+		for (j = 0; j < 8; j++)
+		{
+			if (crc & 0x8000)
+			{
+				crc = (crc << 1) ^ 0x1021;
+			}
+			else
+			{
+				crc = crc << 1;
+			}
+		}
+	}
+
+	return (crc);
+
+}	// End of pm_crc16
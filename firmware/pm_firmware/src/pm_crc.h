@@ -0,0 +1,22 @@
+/****************************************************************************************
+pm_crc.h: Include file for pm_crc.c
+
+Written by:
+	Daayim Asim, B.Eng.
+	Computer Engineer Student
+
+
+Date:
+	October 2022
+*****************************************************************************************/
+
+
+#ifndef PM_CRC_H_
+#define PM_CRC_H_
+
+#include <stdint.h>
+
+uint8_t pm_crc8(const uint8_t *, uint16_t);
+uint16_t pm_crc16(const uint8_t *, uint16_t);
+
+#endif /* PM_CRC_H_ */
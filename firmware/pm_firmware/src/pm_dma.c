@@ -0,0 +1,413 @@
+/****************************************************************************************
+pm_dma.c:   power module (PM) DMA controller functions
+
+Written by:
+	Daayim Asim, B.Eng.
+	Computer Engineer Student
+
+
+Date:
+	November 2022
+
+Note(s):
+- ASF 3 has no DMAC driver in this project, so the controller is driven through its
+	registers. Each channel has one descriptor (no linked lists) and moves one beat
+	per peripheral trigger, e.g. a SERCOM DATA empty or an ADC result ready
+- A channel is configured once by its owner (pm_usart.c, pm_spi.c, pm_adc.c) and
+	started for each block. The done function is called from DMAC_Handler() when the
+	block has been moved or on a transfer error. pm_dma_abort() only calls it for a
+	block that finished before the interrupt was taken
+- The descriptors are in the low power RAM (.lpram) as the DMAC expects on the L21
+- read_dma_stats sends "DMA <channel> <blocks> <beats> <errors> <aborts> <CPU ms
+	saved>" for each channel. The CPU time saved is each channel's estimate of the
+	time the CPU would have spent moving the same beats (busy waiting on the USART
+	or one interrupt per byte)
+*****************************************************************************************/
+
+
+#include <clock.h>
+#include <stdio.h>
+#include <string.h>
+#include <system_interrupt.h>
+#include "pm_dma.h"
+#include "pm_usart.h"
+
+
+struct dma_channel
+{
+	struct pm_dma_channel_config config;
+	volatile bool bBusy;
+	uint16_t beats_requested;
+
+	// Statistics
+	uint32_t blocks;
+	uint32_t beats;
+	uint32_t errors;
+	uint32_t aborts;
+	uint64_t saved_ns;
+};
+
+
+/****************************************************************************************
+Local variable(s)
+*****************************************************************************************/
+
+COMPILER_ALIGNED(16) static DmacDescriptor descriptors[PM_DMA_CHANNELS] SECTION_DMAC_DESCRIPTOR;
+COMPILER_ALIGNED(16) static DmacDescriptor write_back[PM_DMA_CHANNELS] SECTION_DMAC_DESCRIPTOR;
+
+static struct dma_channel channels[PM_DMA_CHANNELS];
+
+static bool bInitialized = false;
+
+static const char *const channel_names[PM_DMA_CHANNELS] = {"SPI_RX", "SPI_TX", "PC_TX", "ADC"};
+
+
+/****************************************************************************************
+Local function(s)
+*****************************************************************************************/
+
+static uint16_t dma_remaining(uint8_t);
+static void dma_account(struct dma_channel *, uint16_t);
+
+
+/****************************************************************************************
+Local function to return the beats a started channel has left to move, called with
+the interrupts disabled
+*****************************************************************************************/
+static uint16_t dma_remaining(uint8_t channel)
+{
+	uint32_t active;
+
+	// The write-back descriptor is only current while the channel is not moving a beat
+	active = DMAC->ACTIVE.reg;
+	if ((active & DMAC_ACTIVE_ABUSY) && (((active & DMAC_ACTIVE_ID_Msk) >> DMAC_ACTIVE_ID_Pos) == channel))
+	{
+		return ((uint16_t)((active & DMAC_ACTIVE_BTCNT_Msk) >> DMAC_ACTIVE_BTCNT_Pos));
+	}
+
+	return (write_back[channel].BTCNT.reg);
+
+}	// End of dma_remaining
+
+
+/****************************************************************************************
+Local function to add the beats moved by the last block to the statistics
+*****************************************************************************************/
+static void dma_account(struct dma_channel *dma, uint16_t beats)
+{
+	dma->beats += beats;
+	dma->saved_ns += (uint64_t)beats * dma->config.cpu_ns_per_beat;
+
+}	// End of dma_account
+
+
+/****************************************************************************************
+Function to reset and enable the DMA controller
+*****************************************************************************************/
+void pm_dma_init(void)
+{
+	memset(descriptors, 0, sizeof(descriptors));
+	memset(write_back, 0, sizeof(write_back));
+	memset(channels, 0, sizeof(channels));
+
+	system_ahb_clock_set_mask(MCLK_AHBMASK_DMAC);
+
+	DMAC->CTRL.reg &= ~DMAC_CTRL_DMAENABLE;
+	DMAC->CTRL.reg = DMAC_CTRL_SWRST;
+	while (DMAC->CTRL.reg & DMAC_CTRL_SWRST)
+	{
+	}
+
+	DMAC->BASEADDR.reg = (uint32_t)descriptors;
+	DMAC->WRBADDR.reg = (uint32_t)write_back;
+	DMAC->CTRL.reg = DMAC_CTRL_DMAENABLE | DMAC_CTRL_LVLEN(0x0f);
+
+	system_interrupt_enable(SYSTEM_INTERRUPT_MODULE_DMA);
+
+	bInitialized = true;
+
+}	// End of pm_dma_init
+
+
+/****************************************************************************************
+Function to reset a channel and set its trigger, beat size and addressing
+
+Returns STATUS_ERR_NOT_INITIALIZED before pm_dma_init(), the owner then moves the data
+itself
+*****************************************************************************************/
+enum status_code pm_dma_configure(uint8_t channel, const struct pm_dma_channel_config *config)
+{
+	if (channel >= PM_DMA_CHANNELS)
+	{
+		return (STATUS_ERR_INVALID_ARG);
+	}
+	if (bInitialized == false)
+	{
+		return (STATUS_ERR_NOT_INITIALIZED);
+	}
+
+	system_interrupt_enter_critical_section();
+
+	channels[channel].config = *config;
+	channels[channel].bBusy = false;
+
+	DMAC->CHID.reg = DMAC_CHID_ID(channel);
+	DMAC->CHCTRLA.reg &= ~DMAC_CHCTRLA_ENABLE;
+	DMAC->CHCTRLA.reg = DMAC_CHCTRLA_SWRST;
+	while (DMAC->CHCTRLA.reg & DMAC_CHCTRLA_SWRST)
+	{
+	}
+
+	DMAC->CHCTRLA.reg = (config->bRunInStandby) ? DMAC_CHCTRLA_RUNSTDBY : 0;
+	DMAC->CHCTRLB.reg = DMAC_CHCTRLB_LVL(0) | DMAC_CHCTRLB_TRIGSRC(config->trigger) | DMAC_CHCTRLB_TRIGACT_BEAT;
+	DMAC->CHINTENSET.reg = DMAC_CHINTENSET_TERR | DMAC_CHINTENSET_TCMPL;
+
+	system_interrupt_leave_critical_section();
+
+	return (STATUS_OK);
+
+}	// End of pm_dma_configure
+
+
+/****************************************************************************************
+Function to start moving a block of beats. An incrementing address is the first beat,
+the descriptor holds the address after the last one
+
+Returns STATUS_BUSY if the channel has not finished the last block
+*****************************************************************************************/
+enum status_code pm_dma_start(uint8_t channel, const volatile void *source, volatile void *destination, uint16_t beats)
+{
+	struct dma_channel *dma;
+	DmacDescriptor *descriptor;
+	uint16_t btctrl;
+	uint32_t length;
+
+	if ((channel >= PM_DMA_CHANNELS) || (beats == 0))
+	{
+		return (STATUS_ERR_INVALID_ARG);
+	}
+	if (bInitialized == false)
+	{
+		return (STATUS_ERR_NOT_INITIALIZED);
+	}
+
+	dma = &channels[channel];
+	descriptor = &descriptors[channel];
+
+	system_interrupt_enter_critical_section();
+
+	if (dma->bBusy)
+	{
+		system_interrupt_leave_critical_section();
+		return (STATUS_BUSY);
+	}
+
+	btctrl = DMAC_BTCTRL_VALID | DMAC_BTCTRL_BLOCKACT_INT;
+	btctrl |= (dma->config.bHalfWord) ? DMAC_BTCTRL_BEATSIZE_HWORD : DMAC_BTCTRL_BEATSIZE_BYTE;
+	length = (dma->config.bHalfWord) ? 2ul * beats : beats;
+
+	descriptor->SRCADDR.reg = (uint32_t)source;
+	if (dma->config.bSourceIncrement)
+	{
+		btctrl |= DMAC_BTCTRL_SRCINC;
+		descriptor->SRCADDR.reg += length;
+	}
+
+	descriptor->DSTADDR.reg = (uint32_t)destination;
+	if (dma->config.bDestinationIncrement)
+	{
+		btctrl |= DMAC_BTCTRL_DSTINC;
+		descriptor->DSTADDR.reg += length;
+	}
+
+	descriptor->BTCTRL.reg = btctrl;
+	descriptor->BTCNT.reg = beats;
+	descriptor->DESCADDR.reg = 0;
+
+	// Read by dma_remaining() until the first beat is moved
+	write_back[channel].BTCNT.reg = beats;
+
+	dma->beats_requested = beats;
+	dma->bBusy = true;
+
+	DMAC->CHID.reg = DMAC_CHID_ID(channel);
+	DMAC->CHINTFLAG.reg = DMAC_CHINTFLAG_MASK;
+	DMAC->CHCTRLA.reg |= DMAC_CHCTRLA_ENABLE;
+
+	system_interrupt_leave_critical_section();
+
+	return (STATUS_OK);
+
+}	// End of pm_dma_start
+
+
+/****************************************************************************************
+Function to stop a channel after the beat it is moving, the done function is not
+called unless the block had already finished
+*****************************************************************************************/
+void pm_dma_abort(uint8_t channel)
+{
+	struct dma_channel *dma;
+	uint8_t flags;
+
+	if ((channel >= PM_DMA_CHANNELS) || (bInitialized == false))
+	{
+		return;
+	}
+
+	dma = &channels[channel];
+
+	system_interrupt_enter_critical_section();
+
+	DMAC->CHID.reg = DMAC_CHID_ID(channel);
+	DMAC->CHCTRLA.reg &= ~DMAC_CHCTRLA_ENABLE;
+	while (DMAC->CHCTRLA.reg & DMAC_CHCTRLA_ENABLE)
+	{
+	}
+
+	if (dma->bBusy)
+	{
+		dma->bBusy = false;
+
+		flags = DMAC->CHINTFLAG.reg;
+		if (flags & DMAC_CHINTFLAG_TCMPL)
+		{
+			dma->blocks++;
+			dma_account(dma, dma->beats_requested);
+
+			if (dma->config.done != NULL)
+			{
+				dma->config.done(channel, false);
+			}
+		}
+		else
+		{
+			dma->aborts++;
+			dma_account(dma, dma->beats_requested - write_back[channel].BTCNT.reg);
+		}
+	}
+
+	DMAC->CHINTFLAG.reg = DMAC_CHINTFLAG_MASK;
+
+	system_interrupt_leave_critical_section();
+
+}	// End of pm_dma_abort
+
+
+/****************************************************************************************
+Function to return true while a channel is moving a block
+*****************************************************************************************/
+bool pm_dma_busy(uint8_t channel)
+{
+	return ((channel < PM_DMA_CHANNELS) && channels[channel].bBusy);
+
+}	// End of pm_dma_busy
+
+
+/****************************************************************************************
+Function to return the beats a channel has left to move, 0 when it is not busy
+*****************************************************************************************/
+uint16_t pm_dma_get_remaining(uint8_t channel)
+{
+	uint16_t remaining = 0;
+
+	if (pm_dma_busy(channel) == false)
+	{
+		return (0);
+	}
+
+	system_interrupt_enter_critical_section();
+	if (channels[channel].bBusy)
+	{
+		remaining = dma_remaining(channel);
+	}
+	system_interrupt_leave_critical_section();
+
+	return (remaining);
+
+}	// End of pm_dma_get_remaining
+
+
+/****************************************************************************************
+Function to return the CPU time of a one byte interrupt at the current clock, the
+cpu_ns_per_beat of a channel that replaces one interrupt per beat
+*****************************************************************************************/
+uint32_t pm_dma_interrupt_ns(void)
+{
+	uint32_t mhz;
+
+	mhz = system_cpu_clock_get_hz() / 1000000ul;
+
+	return ((mhz > 0) ? (PM_DMA_INTERRUPT_CYCLES * 1000ul) / mhz : 0);
+
+}	// End of pm_dma_interrupt_ns
+
+
+/****************************************************************************************
+Function to send the statistics of each channel to the PC
+*****************************************************************************************/
+void pm_dma_report(void)
+{
+	char response[80];
+	uint8_t channel;
+	struct dma_channel *dma;
+
+	for (channel = 0; channel < PM_DMA_CHANNELS; channel++)
+	{
+		dma = &channels[channel];
+
+		sprintf(response, "DMA %s %lu %lu %lu %lu %lu\r\n", channel_names[channel],
+			(unsigned long)dma->blocks, (unsigned long)dma->beats, (unsigned long)dma->errors,
+			(unsigned long)dma->aborts, (unsigned long)(dma->saved_ns / 1000000ull));
+		pm_usart_send_pc_message(response);
+	}
+
+}	// End of pm_dma_report
+
+
+/****************************************************************************************
+DMA controller interrupt handler, one channel transfer complete or error per call
+*****************************************************************************************/
+void DMAC_Handler(void)
+{
+	struct dma_channel *dma;
+	uint8_t channel;
+	uint8_t flags;
+	bool bError;
+
+	channel = DMAC->INTPEND.reg & DMAC_INTPEND_ID_Msk;
+
+	DMAC->CHID.reg = DMAC_CHID_ID(channel);
+	flags = DMAC->CHINTFLAG.reg & (DMAC_CHINTFLAG_TERR | DMAC_CHINTFLAG_TCMPL);
+	DMAC->CHINTFLAG.reg = flags;
+
+	if ((channel >= PM_DMA_CHANNELS) || (flags == 0))
+	{
+		return;
+	}
+
+	dma = &channels[channel];
+	if (dma->bBusy == false)
+	{
+		return;
+	}
+	dma->bBusy = false;
+
+	bError = (flags & DMAC_CHINTFLAG_TERR) != 0;
+	if (bError)
+	{
+		dma->errors++;
+		dma_account(dma, dma->beats_requested - write_back[channel].BTCNT.reg);
+	}
+	else
+	{
+		dma->blocks++;
+		dma_account(dma, dma->beats_requested);
+	}
+
+	if (dma->config.done != NULL)
+	{
+		dma->config.done(channel, bError);
+	}
+
+}	// End of DMAC_Handler
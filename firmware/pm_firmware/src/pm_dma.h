@@ -0,0 +1,54 @@
+/****************************************************************************************
+pm_dma.h: Include file for pm_dma.c
+
+Written by:
+	Daayim Asim, B.Eng.
+	Computer Engineer Student
+
+
+Date:
+	November 2022
+*****************************************************************************************/
+
+
+#ifndef PM_DMA_H_
+#define PM_DMA_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <status_codes.h>
+
+// Channels, a lower number wins when two are triggered together
+#define PM_DMA_CHANNEL_SPI_RX			0
+#define PM_DMA_CHANNEL_SPI_TX			1
+#define PM_DMA_CHANNEL_PC_TX			2
+#define PM_DMA_CHANNEL_ADC				3
+#define PM_DMA_CHANNELS					4
+
+// Cycles the CPU spends entering, running and leaving a one byte SERCOM or ADC
+// interrupt, used to estimate the CPU time a channel saves
+#define PM_DMA_INTERRUPT_CYCLES			120ul
+
+struct pm_dma_channel_config
+{
+	uint8_t trigger;				// xxx_DMAC_ID_xxx, one beat per trigger
+	bool bHalfWord;					// 16 bit beats, otherwise 8 bit
+	bool bSourceIncrement;
+	bool bDestinationIncrement;
+	bool bRunInStandby;
+	uint32_t cpu_ns_per_beat;		// CPU time per beat without the DMA, for pm_dma_report()
+	void (*done)(uint8_t, bool);	// Channel, true on a transfer error. Called from the interrupt
+};
+
+void pm_dma_init(void);
+enum status_code pm_dma_configure(uint8_t, const struct pm_dma_channel_config *);
+
+enum status_code pm_dma_start(uint8_t, const volatile void *, volatile void *, uint16_t);
+void pm_dma_abort(uint8_t);
+bool pm_dma_busy(uint8_t);
+uint16_t pm_dma_get_remaining(uint8_t);
+
+uint32_t pm_dma_interrupt_ns(void);
+void pm_dma_report(void);
+
+#endif /* PM_DMA_H_ */
@@ -30,6 +30,7 @@ EEPROM."
 #include "pm_usart.h"
 
 #define EEPROM_DATA_LENGTH 6
+#define EEPROM_PROM_LENGTH (2 * EEPROM_PROM_WORDS)
 
 
 
@@ -46,23 +47,24 @@ static const uint8_t x_coord_offset = 0;
 static const uint8_t y_coord_offset = 2;
 static const uint8_t z_coord_offset = 4;
 
+// MS5637 PROM cache location within the emulated EEPROM page
+static const uint8_t ms5637_prom_offset = 8;
+
 
 
 /***************************************************************************
 Function to configure the EEPROM emulator
+
+Called once at boot, before any of the sensor modules read their settings.
+A blank or corrupt emulator is erased and the settings reset to zero
 ****************************************************************************/
-void eeprom_configure(uint16_t *x_coord, uint16_t *y_coord, uint16_t *z_coord)
+void eeprom_configure(void)
 {
 	// Initialize the EEPROM emulator service
 	enum status_code retval = eeprom_emulator_init();
 	if (retval == STATUS_OK)
 	{
-		
 		pm_usart_send_pc_message("eeprom_configure: STATUS_OK\r\n");
-		pm_usart_send_pc_message("eeprom_configure: Have to read settings\r\n");
-
-		// EEPROM emulation service was successfully initialized
-		eeprom_read_settings(x_coord, y_coord, z_coord);
 	}
 	else if (retval == STATUS_ERR_NO_MEMORY)
 	{
@@ -88,7 +90,8 @@ void eeprom_configure(uint16_t *x_coord, uint16_t *y_coord, uint16_t *z_coord)
 			pm_usart_send_pc_message("eeprom_configure: STATUS_OK 2\r\n");
 			pm_usart_send_pc_message("eeprom_configure: Have to write settings\r\n");
 
-			eeprom_write_settings(*x_coord, *y_coord, *z_coord);
+			// An erased PROM cache reads back as all 0xFF and fails its CRC check
+			eeprom_write_settings(0, 0, 0);
 		}
 	}
 }	// End of eeprom_configure
@@ -161,3 +164,33 @@ void eeprom_write_settings(uint16_t x_coord, uint16_t y_coord, uint16_t z_coord)
 
 }	// End of eeprom_write_settings
 
+
+/***************************************************************************
+Function to read the cached MS5637 PROM words from the EEPROM emulator
+
+Only used to seed an empty settings store, which holds the cache now. The
+caller is responsible for validating the words with the PROM CRC
+****************************************************************************/
+enum status_code eeprom_read_ms5637_prom(uint16_t *prom)
+{
+	uint8_t prom_data[EEPROM_PROM_LENGTH];
+	uint8_t i;
+
+	enum status_code status = eeprom_emulator_read_buffer(ms5637_prom_offset, prom_data, EEPROM_PROM_LENGTH);
+
+	if (status == STATUS_OK)
+	{
+		for (i=0; i<EEPROM_PROM_WORDS; i++)
+		{
+			prom[i] = prom_data[2 * i];
+			prom[i]|= (uint16_t)(prom_data[(2 * i) + 1]) << 8;
+		}
+	}
+	else
+	{
+		pm_usart_send_pc_message("eeprom_read_ms5637_prom: STATUS_ERR_READ_EEPROM\r\n");
+	}
+
+	return (status);
+
+}	// End of eeprom_read_ms5637_prom
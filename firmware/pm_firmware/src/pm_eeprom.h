@@ -15,10 +15,15 @@ Date:
 #ifndef PM_EEPROM_H_
 #define PM_EEPROM_H_
 
-void eeprom_configure(uint16_t *, uint16_t *, uint16_t *);
+// Number of MS5637 PROM words cached in the EEPROM emulator
+#define EEPROM_PROM_WORDS 7
+
+void eeprom_configure(void);
 
 void eeprom_write_settings(uint16_t, uint16_t, uint16_t);
 
 void eeprom_read_settings(uint16_t *, uint16_t *, uint16_t *);
 
+enum status_code eeprom_read_ms5637_prom(uint16_t *);
+
 #endif /* PM_EEPROM_H_ */
\ No newline at end of file
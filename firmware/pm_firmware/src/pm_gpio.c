@@ -125,6 +125,53 @@ static const uint8_t wcm_diag_en = PIN_PB02;
 static const uint8_t wcm_pwr_en = PIN_PB00;
 static const uint8_t wcm_rly = PIN_PB31;
 
+/***************************
+Power and status bit pin(s)
+****************************/
+
+// The pins are pointers to the named pins above, a static const variable is not a
+// constant that another static initializer can use
+struct gpio_bit_pin
+{
+	const uint8_t *pin;
+	uint16_t bit;
+};
+
+#define POWER_BIT_PINS		11
+#define STATUS_BIT_PINS		6
+
+static const struct gpio_bit_pin power_bit_pins[POWER_BIT_PINS] =
+{
+	{&en_3v3va, PM_POWER_BIT_3V3VA},
+	{&batt_sel, PM_POWER_BIT_BATT_SEL},
+	{&batt_ser_pwr_en, PM_POWER_BIT_BATT_SER_PWR},
+	{&ctd_pwr_en, PM_POWER_BIT_CTD_PWR},
+	{&driver_en, PM_POWER_BIT_DRIVER},
+	{&Main_pwr_en, PM_POWER_BIT_MAIN_PWR},
+	{&vbs_pwr_en, PM_POWER_BIT_VBS_PWR},
+	{&vbs_ser_pwr_en, PM_POWER_BIT_VBS_SER_PWR},
+	{&wcm_diag_en, PM_POWER_BIT_WCM_DIAG},
+	{&wcm_pwr_en, PM_POWER_BIT_WCM_PWR},
+	{&wcm_rly, PM_POWER_BIT_WCM_RLY}
+};
+
+static const struct gpio_bit_pin status_bit_pins[STATUS_BIT_PINS] =
+{
+	{&n_accel_int, PM_STATUS_BIT_N_ACCEL_INT},
+	{&ext_gpio1, PM_STATUS_BIT_EXT_GPIO1},
+	{&ext_gpio2, PM_STATUS_BIT_EXT_GPIO2},
+	{&lt8618_pg, PM_STATUS_BIT_LT8618_PG},
+	{&n_ltc2944_alcc, PM_STATUS_BIT_N_LTC2944_ALCC},
+	{&n_wcm_fault, PM_STATUS_BIT_N_WCM_FAULT}
+};
+
+
+/****************************************************************************************
+Local function(s)
+*****************************************************************************************/
+
+static uint16_t gpio_bits_from_snapshot(const struct gpio_bit_pin *, uint8_t, const uint32_t *);
+
 
 
 /****************************************************************************************
@@ -691,3 +738,94 @@ void pm_gpio_wcm_relay_on(void)
 }	// End of pm_gpio_wcm_relay_on
 
 
+/****************************************************************************************
+Local function to collect the bits of a pin table from a PORT group A and B snapshot
+*****************************************************************************************/
+static uint16_t gpio_bits_from_snapshot(const struct gpio_bit_pin *table, uint8_t count, const uint32_t *snapshot)
+{
+	uint16_t bits = 0;
+	uint8_t i;
+
+	for (i = 0; i < count; i++)
+	{
+		if (snapshot[*table[i].pin / 32] & (1ul << (*table[i].pin % 32)))
+		{
+			bits |= table[i].bit;
+		}
+	}
+
+	return (bits);
+
+}	// End of gpio_bits_from_snapshot
+
+
+/****************************************************************************************
+Function to return all the power bits (PM_POWER_BIT_xxx) as one value
+
+The output latches are read once per PORT group, so all the bits are from the same
+instant
+*****************************************************************************************/
+uint16_t pm_gpio_power_bits_get(void)
+{
+	uint32_t snapshot[2];
+
+	snapshot[0] = PORT->Group[0].OUT.reg;
+	snapshot[1] = PORT->Group[1].OUT.reg;
+
+	return (gpio_bits_from_snapshot(power_bit_pins, POWER_BIT_PINS, snapshot));
+
+}	// End of pm_gpio_power_bits_get
+
+
+/****************************************************************************************
+Function to set the power bits selected by mask to the levels in bits
+
+The pins of each PORT group change together, with one OUTCLR and one OUTSET write.
+The bits are pin levels, so DRIVER is set to disable the driver
+*****************************************************************************************/
+void pm_gpio_power_bits_set(uint16_t mask, uint16_t bits)
+{
+	uint32_t set[2] = {0, 0};
+	uint32_t clear[2] = {0, 0};
+	uint8_t group;
+	uint8_t i;
+
+	for (i = 0; i < POWER_BIT_PINS; i++)
+	{
+		if (mask & power_bit_pins[i].bit)
+		{
+			if (bits & power_bit_pins[i].bit)
+			{
+				set[*power_bit_pins[i].pin / 32] |= 1ul << (*power_bit_pins[i].pin % 32);
+			}
+			else
+			{
+				clear[*power_bit_pins[i].pin / 32] |= 1ul << (*power_bit_pins[i].pin % 32);
+			}
+		}
+	}
+
+	for (group = 0; group < 2; group++)
+	{
+		PORT->Group[group].OUTCLR.reg = clear[group];
+		PORT->Group[group].OUTSET.reg = set[group];
+	}
+
+}	// End of pm_gpio_power_bits_set
+
+
+/****************************************************************************************
+Function to return all the status bits (PM_STATUS_BIT_xxx) as one value
+
+The input registers are read once per PORT group
+*****************************************************************************************/
+uint8_t pm_gpio_status_bits_get(void)
+{
+	uint32_t snapshot[2];
+
+	snapshot[0] = PORT->Group[0].IN.reg;
+	snapshot[1] = PORT->Group[1].IN.reg;
+
+	return ((uint8_t)gpio_bits_from_snapshot(status_bit_pins, STATUS_BIT_PINS, snapshot));
+
+}	// End of pm_gpio_status_bits_get
@@ -15,6 +15,28 @@ Date:
 #define PM_GPIO_H
 
 
+// Power bits (output pin levels), reported by read_power_bits as POWER 0x<bits>
+#define PM_POWER_BIT_3V3VA			(1u << 0)
+#define PM_POWER_BIT_BATT_SEL		(1u << 1)
+#define PM_POWER_BIT_BATT_SER_PWR	(1u << 2)
+#define PM_POWER_BIT_CTD_PWR		(1u << 3)
+#define PM_POWER_BIT_DRIVER			(1u << 4)
+#define PM_POWER_BIT_MAIN_PWR		(1u << 5)
+#define PM_POWER_BIT_VBS_PWR		(1u << 6)
+#define PM_POWER_BIT_VBS_SER_PWR	(1u << 7)
+#define PM_POWER_BIT_WCM_DIAG		(1u << 8)
+#define PM_POWER_BIT_WCM_PWR		(1u << 9)
+#define PM_POWER_BIT_WCM_RLY		(1u << 10)
+
+// Status bits (input pin levels), reported by read_status_bits as STATUS_BITS 0x<bits>
+#define PM_STATUS_BIT_N_ACCEL_INT	(1u << 0)
+#define PM_STATUS_BIT_EXT_GPIO1		(1u << 1)
+#define PM_STATUS_BIT_EXT_GPIO2		(1u << 2)
+#define PM_STATUS_BIT_LT8618_PG		(1u << 3)
+#define PM_STATUS_BIT_N_LTC2944_ALCC	(1u << 4)
+#define PM_STATUS_BIT_N_WCM_FAULT	(1u << 5)
+
+
 void pm_gpio_configure(void);
 void pm_gpio_configure_lowpower(void);
 
@@ -85,6 +107,10 @@ bool pm_gpio_wcm_relay_get(void);
 void pm_gpio_wcm_relay_off(void);
 void pm_gpio_wcm_relay_on(void);
 
+uint16_t pm_gpio_power_bits_get(void);
+void pm_gpio_power_bits_set(uint16_t, uint16_t);
+uint8_t pm_gpio_status_bits_get(void);
+
 
 #endif	// PM_GPIO_H
 
@@ -0,0 +1,625 @@
+/****************************************************************************************
+pm_logger.c:   power module (PM) sample logger functions
+
+Written by:
+	Daayim Asim, B.Eng.
+	Computer Engineer Student
+
+
+Date:
+	October 2022
+
+Note(s):
+- Circular log of 32 byte pm_log_record samples in the main flash rows between the
+	end of the firmware image and the EEPROM emulator, up to LOG_MAX_ROWS. The
+	layout is read from the NVM controller by pm_logger_configure()
+- Records are numbered by sequence, record n always lives in row
+	(n / LOG_RECORDS_PER_ROW) % log_rows, so the sequence is also the resumable
+	offset used by log_dump
+- Samples are staged in RAM and a row is written only once it is full. A full row
+	is copied aside and written by pm_logger_service() one NVM operation per call,
+	the row erase then one page at a time, once the settings store has no NVM
+	operation running. The row the next samples go to is erased ahead the same
+	way. The CPU stalls on main flash for each operation, main flash is not
+	read-while-write. Staged samples survive standby but not a reset
+- A sample is taken every LOG_PERIOD seconds (0 disables), while awake and while
+	asleep, when pm_run is woken by the RTC to take it. pm_logger_flush() finishes a
+	row write before going back to sleep
+- log_dump sends blocks of up to LOG_DUMP_BLOCK_RECORDS records, each
+	"LOG_DUMP <first> <count> <record size>\r\n" then count binary records, then
+	"LOG_END <next>\r\n". The first block header is always sent, even with no
+	records. Records that are erased or fail their CRC are skipped, the host
+	resumes from <next>. Each record is read from flash once. It is INVALID while
+	the telemetry stream is on, the records are not framed
+- log_zdump sends the same range delta/varint compressed, see pm_telemetry.c. When
+	the telemetry stream is on each new sample is also sent as a compressed frame
+*****************************************************************************************/
+
+#include <nvm.h>
+#include <stdio.h>
+#include <string.h>
+#include "pm_logger.h"
+#include "pm_adc.h"
+#include "pm_crc.h"
+#include "pm_gpio.h"
+#include "pm_ltc2944.h"
+#include "pm_mc3416.h"
+#include "pm_ms5637.h"
+#include "pm_settings.h"
+#include "pm_telemetry.h"
+#include "pm_timer.h"
+#include "pm_usart.h"
+
+// 48 kB at most
+#define LOG_MAX_ROWS 192
+#define LOG_ROW_SIZE (NVMCTRL_PAGE_SIZE * NVMCTRL_ROW_PAGES)
+#define LOG_RECORD_SIZE (sizeof(struct pm_log_record))
+#define LOG_RECORDS_PER_ROW (LOG_ROW_SIZE / LOG_RECORD_SIZE)
+#define LOG_NO_ROW UINT32_MAX
+
+// End of the firmware image, from the linker script
+extern uint32_t _etext;
+extern uint32_t _srelocate;
+extern uint32_t _erelocate;
+
+
+/****************************************************************************************
+Local variable(s)
+*****************************************************************************************/
+
+// Row being filled, sample n is in staging[n % LOG_RECORDS_PER_ROW]
+static struct pm_log_record staging[LOG_RECORDS_PER_ROW];
+
+// Next sequence number to assign, and the oldest one still in flash
+static uint32_t next_sequence = 0;
+static uint32_t oldest_sequence = 0;
+
+static uint32_t last_sample_ms = 0;
+
+// Log rows in flash, none if there is no room for the log
+static uint32_t log_start = 0;
+static uint16_t log_rows = 0;
+static uint32_t log_capacity = 0;
+
+// First sequence of the row already erased for the staged records
+static uint32_t erased_base = LOG_NO_ROW;
+static bool bEraseFailed = false;
+
+// Full row waiting to be written, and the next page of it to write
+static struct pm_log_record flushing[LOG_RECORDS_PER_ROW];
+static uint32_t flush_base = LOG_NO_ROW;
+static uint8_t flush_page = 0;
+
+
+/****************************************************************************************
+Local function(s)
+*****************************************************************************************/
+
+static uint32_t logger_row_address(uint32_t);
+static bool logger_nvm_done(void);
+static bool logger_erase_row(uint32_t);
+static void logger_flush_step(void);
+static int16_t logger_scale(double, double);
+
+
+/****************************************************************************************
+Local function to return the flash address of the row holding a sequence number
+*****************************************************************************************/
+static uint32_t logger_row_address(uint32_t sequence)
+{
+	return (log_start + ((sequence / LOG_RECORDS_PER_ROW) % log_rows) * LOG_ROW_SIZE);
+
+}	// End of logger_row_address
+
+
+/****************************************************************************************
+Local function to wait for the logger's NVM operation and check its result
+
+The error flags are read and cleared here, straight after the logger's own command
+Returns false if the operation failed
+*****************************************************************************************/
+static bool logger_nvm_done(void)
+{
+	while (!nvm_is_ready())
+	{
+	}
+
+	return (nvm_get_error() == NVM_ERROR_NONE);
+
+}	// End of logger_nvm_done
+
+
+/****************************************************************************************
+Function to read a record from flash or from the staging row
+Returns false if the record is erased, corrupt or has been overwritten
+*****************************************************************************************/
+bool pm_logger_read(uint32_t sequence, struct pm_log_record *record)
+{
+	uint8_t page_data[NVMCTRL_PAGE_SIZE];
+	uint32_t staged_base;
+	uint32_t offset;
+	uint32_t page_address;
+
+	staged_base = next_sequence - (next_sequence % LOG_RECORDS_PER_ROW);
+	if (sequence >= staged_base)
+	{
+		*record = staging[sequence % LOG_RECORDS_PER_ROW];
+
+		return (sequence < next_sequence);
+	}
+
+	if ((flush_base != LOG_NO_ROW) && ((sequence - flush_base) < LOG_RECORDS_PER_ROW))
+	{
+		*record = flushing[sequence - flush_base];
+
+		return (true);
+	}
+
+	if (log_rows == 0)
+	{
+		return (false);
+	}
+
+	// Pages hold a whole number of records and nvm_read_buffer() reads from the
+	// start of a page
+	offset = (sequence % LOG_RECORDS_PER_ROW) * LOG_RECORD_SIZE;
+	page_address = logger_row_address(sequence) + (offset & ~(NVMCTRL_PAGE_SIZE - 1));
+
+	// A read clears the error flags too, let the settings store take its result first
+	while (!pm_settings_nvm_release())
+	{
+	}
+	if (nvm_read_buffer(page_address, page_data, NVMCTRL_PAGE_SIZE) != STATUS_OK)
+	{
+		return (false);
+	}
+	memcpy(record, &page_data[offset & (NVMCTRL_PAGE_SIZE - 1)], LOG_RECORD_SIZE);
+
+	if (record->crc != pm_crc16((const uint8_t *)record, LOG_RECORD_SIZE - 2))
+	{
+		return (false);
+	}
+
+	return (record->sequence == sequence);
+
+}	// End of pm_logger_read
+
+
+/****************************************************************************************
+Local function to erase the row for the records starting at base
+
+The caller makes sure the settings store has no NVM operation running
+Returns false if the row could not be erased
+*****************************************************************************************/
+static bool logger_erase_row(uint32_t base)
+{
+	if ((nvm_erase_row(logger_row_address(base)) != STATUS_OK) || !logger_nvm_done())
+	{
+		pm_usart_send_pc_message("logger_erase_row: Could not erase row!\r\n");
+		return (false);
+	}
+
+	erased_base = base;
+
+	// The row held the oldest records once the log has wrapped
+	if ((base + LOG_RECORDS_PER_ROW) - oldest_sequence > log_capacity)
+	{
+		oldest_sequence = (base + LOG_RECORDS_PER_ROW) - log_capacity;
+	}
+
+	return (true);
+
+}	// End of logger_erase_row
+
+
+/****************************************************************************************
+Local function to take the next step writing the full row to flash, the row erase
+if pm_logger_service() has not erased it ahead, then one page
+
+The caller makes sure the settings store has no NVM operation running. A row that
+cannot be written is dropped
+*****************************************************************************************/
+static void logger_flush_step(void)
+{
+	enum status_code status;
+	uint32_t address;
+
+	if (erased_base != flush_base)
+	{
+		bEraseFailed = false;
+		if (!logger_erase_row(flush_base))
+		{
+			flush_base = LOG_NO_ROW;
+		}
+		return;
+	}
+
+	// Manual page write mode is set by pm_settings_configure()
+	address = logger_row_address(flush_base) + (uint32_t)flush_page * NVMCTRL_PAGE_SIZE;
+	do
+	{
+		status = nvm_write_buffer(address, (const uint8_t *)flushing + flush_page * NVMCTRL_PAGE_SIZE, NVMCTRL_PAGE_SIZE);
+	} while (status == STATUS_BUSY);
+
+	if (status == STATUS_OK)
+	{
+		do
+		{
+			status = nvm_execute_command(NVM_COMMAND_WRITE_PAGE, address, 0);
+		} while (status == STATUS_BUSY);
+	}
+
+	if ((status != STATUS_OK) || !logger_nvm_done())
+	{
+		pm_usart_send_pc_message("logger_flush_step: Could not write page!\r\n");
+		flush_base = LOG_NO_ROW;
+		return;
+	}
+
+	flush_page++;
+	if (flush_page >= NVMCTRL_ROW_PAGES)
+	{
+		flush_base = LOG_NO_ROW;
+	}
+
+}	// End of logger_flush_step
+
+
+/****************************************************************************************
+Local function to scale a value to a fixed point int16_t, clamped to its range
+*****************************************************************************************/
+static int16_t logger_scale(double value, double scale)
+{
+	value *= scale;
+
+	if (value > 32767.0)
+	{
+		return (32767);
+	}
+	if (value < -32768.0)
+	{
+		return (-32768);
+	}
+
+	return ((int16_t)((value < 0.0) ? value - 0.5 : value + 0.5));
+
+}	// End of logger_scale
+
+
+/****************************************************************************************
+Function to place the log in flash and find its end
+
+The log takes the rows between the end of the firmware image and the EEPROM emulator
+rows, up to LOG_MAX_ROWS. Only the first record of each row is checked, rows are
+always written whole
+*****************************************************************************************/
+void pm_logger_configure(void)
+{
+	struct nvm_parameters parameters;
+	struct pm_log_record record;
+	uint32_t image_end;
+	uint32_t log_end;
+	uint16_t row;
+	uint32_t sequence;
+	bool bFound;
+
+	bFound = false;
+	next_sequence = 0;
+	oldest_sequence = 0;
+	erased_base = LOG_NO_ROW;
+	bEraseFailed = false;
+	flush_base = LOG_NO_ROW;
+	last_sample_ms = pm_timer_get_ms();
+
+	nvm_get_parameters(&parameters);
+	log_end = ((uint32_t)parameters.nvm_number_of_pages - parameters.eeprom_number_of_pages) * parameters.page_size;
+	image_end = (uint32_t)&_etext + ((uint32_t)&_erelocate - (uint32_t)&_srelocate);
+	image_end = (image_end + LOG_ROW_SIZE - 1) & ~(LOG_ROW_SIZE - 1);
+
+	log_rows = (log_end > image_end) ? (log_end - image_end) / LOG_ROW_SIZE : 0;
+	if (log_rows > LOG_MAX_ROWS)
+	{
+		log_rows = LOG_MAX_ROWS;
+	}
+	log_start = log_end - (uint32_t)log_rows * LOG_ROW_SIZE;
+	log_capacity = (uint32_t)log_rows * LOG_RECORDS_PER_ROW;
+
+	if (log_rows == 0)
+	{
+		pm_usart_send_pc_message("pm_logger_configure: No flash left for the log!\r\n");
+		return;
+	}
+
+	while (!pm_settings_nvm_release())
+	{
+	}
+
+	for (row = 0; row < log_rows; row++)
+	{
+		if (nvm_read_buffer(log_start + (uint32_t)row * LOG_ROW_SIZE, (uint8_t *)&record, LOG_RECORD_SIZE) != STATUS_OK)
+		{
+			continue;
+		}
+
+		if (record.crc != pm_crc16((const uint8_t *)&record, LOG_RECORD_SIZE - 2))
+		{
+			continue;
+		}
+
+		sequence = record.sequence;
+		if (((sequence % LOG_RECORDS_PER_ROW) != 0) || (((sequence / LOG_RECORDS_PER_ROW) % log_rows) != row))
+		{
+			continue;
+		}
+
+		if ((bFound == false) || (sequence < oldest_sequence))
+		{
+			oldest_sequence = sequence;
+		}
+		if ((bFound == false) || (sequence + LOG_RECORDS_PER_ROW > next_sequence))
+		{
+			next_sequence = sequence + LOG_RECORDS_PER_ROW;
+		}
+		bFound = true;
+	}
+
+	if (bFound == false)
+	{
+		pm_usart_send_pc_message("pm_logger_configure: Log is empty\r\n");
+	}
+
+}	// End of pm_logger_configure
+
+
+/****************************************************************************************
+Function to take a sample when the LOG_PERIOD setting has elapsed
+
+Between samples, starts at most one NVM operation per call: the next step of
+writing a full row, or erasing the row the staged records will be written to
+*****************************************************************************************/
+void pm_logger_service(void)
+{
+	uint32_t period_ms;
+	uint32_t staged_base;
+
+	period_ms = pm_settings_get(SETTINGS_KEY_LOG_PERIOD) * 1000ul;
+	if ((period_ms != 0) && (pm_timer_elapsed_ms(last_sample_ms) >= period_ms))
+	{
+		pm_logger_sample();
+		return;
+	}
+
+	if ((log_rows == 0) || !pm_settings_nvm_release())
+	{
+		return;
+	}
+
+	if (flush_base != LOG_NO_ROW)
+	{
+		logger_flush_step();
+		return;
+	}
+
+	// Tried once per row, logger_flush_step() tries again
+	staged_base = next_sequence - (next_sequence % LOG_RECORDS_PER_ROW);
+	if ((erased_base != staged_base) && !bEraseFailed)
+	{
+		bEraseFailed = !logger_erase_row(staged_base);
+	}
+
+}	// End of pm_logger_service
+
+
+/****************************************************************************************
+Function to finish writing a full row, waiting for the NVM controller
+
+Used before entering low power mode
+*****************************************************************************************/
+void pm_logger_flush(void)
+{
+	while (flush_base != LOG_NO_ROW)
+	{
+		while (!pm_settings_nvm_release())
+		{
+		}
+		logger_flush_step();
+	}
+
+}	// End of pm_logger_flush
+
+
+/****************************************************************************************
+Function to read all the sensors and append a record to the log
+*****************************************************************************************/
+void pm_logger_sample(void)
+{
+	struct pm_log_record *record;
+	enum status_code status;
+	float leak;
+	double voltage;
+	double current;
+	double temperature;
+	double charge;
+	uint8_t status_value;
+	uint32_t d1;
+	uint32_t d2;
+	double pressure;
+	double angle;
+
+	last_sample_ms = pm_timer_get_ms();
+
+	record = &staging[next_sequence % LOG_RECORDS_PER_ROW];
+	memset(record, 0, LOG_RECORD_SIZE);
+	record->sequence = next_sequence;
+	record->timestamp_ms = last_sample_ms;
+
+	status = pm_adc_read(&leak);
+	if (status == STATUS_OK)
+	{
+		record->leak_mv = (uint16_t)(leak * 1000.0 + 0.5);
+	}
+	else
+	{
+		record->flags |= LOG_FLAG_LEAK_FAILED;
+	}
+
+	pm_gpio_ltc2944_i2c_en_on();
+	status = pm_ltc2944_read(&voltage, &current, &temperature, &charge, &status_value);
+	pm_gpio_ltc2944_i2c_en_off();
+	if (status == STATUS_OK)
+	{
+		record->battery_mv = (voltage > 0.0) ? (uint16_t)(voltage * 1000.0 + 0.5) : 0;
+		record->battery_ma = logger_scale(current, 1000.0);
+		record->ltc2944_temperature = logger_scale(temperature, 100.0);
+		record->charge_mah = (charge > 0.0) ? (uint16_t)(charge + 0.5) : 0;
+	}
+	else
+	{
+		record->flags |= LOG_FLAG_LTC2944_FAILED;
+	}
+
+	status = pm_ms5637_read(&d1, &pressure, &d2, &temperature);
+	if (status == STATUS_OK)
+	{
+		record->pressure = (pressure > 0.0) ? (uint16_t)(pressure * 10.0 + 0.5) : 0;
+		record->ms5637_temperature = logger_scale(temperature, 100.0);
+	}
+	else
+	{
+		record->flags |= LOG_FLAG_MS5637_FAILED;
+	}
+
+	status = pm_mc3416_read_tilt(&angle);
+	if (status == STATUS_OK)
+	{
+		record->tilt = logger_scale(angle, 100.0);
+	}
+	else
+	{
+		record->flags |= LOG_FLAG_MC3416_FAILED;
+	}
+
+	record->power_bits = pm_gpio_power_bits_get();
+	record->status_bits = pm_gpio_status_bits_get();
+	record->crc = pm_crc16((const uint8_t *)record, LOG_RECORD_SIZE - 2);
+
+	next_sequence++;
+
+	pm_telemetry_stream(record);
+
+	// The row is written by pm_logger_service(), a row still being written when the
+	// next one fills is finished first
+	if ((log_rows != 0) && ((next_sequence % LOG_RECORDS_PER_ROW) == 0))
+	{
+		pm_logger_flush();
+
+		memcpy(flushing, staging, sizeof(flushing));
+		flush_base = flushing[0].sequence;
+		flush_page = 0;
+	}
+
+}	// End of pm_logger_sample
+
+
+/****************************************************************************************
+Function to clip a first to last (inclusive) range to the records still in the log
+
+Returns the number of sequence numbers in the range, records in it can still be
+erased or corrupt
+*****************************************************************************************/
+uint32_t pm_logger_range(uint32_t *first, uint32_t *last)
+{
+	if (*first < oldest_sequence)
+	{
+		*first = oldest_sequence;
+	}
+	if ((next_sequence == 0) || (*last >= next_sequence))
+	{
+		*last = next_sequence - 1;
+	}
+
+	if ((next_sequence == 0) || (*first > *last))
+	{
+		return (0);
+	}
+
+	return (*last - *first + 1);
+
+}	// End of pm_logger_range
+
+
+/****************************************************************************************
+Function to read the valid records from *sequence up to end (exclusive), at most
+LOG_DUMP_BLOCK_RECORDS of them, and move *sequence past the ones looked at
+
+Returns the number of records read
+*****************************************************************************************/
+uint8_t pm_logger_read_block(uint32_t *sequence, uint32_t end, struct pm_log_record *records)
+{
+	uint8_t count = 0;
+
+	while ((count < LOG_DUMP_BLOCK_RECORDS) && (*sequence < end))
+	{
+		if (pm_logger_read(*sequence, &records[count]))
+		{
+			count++;
+		}
+		(*sequence)++;
+	}
+
+	return (count);
+
+}	// End of pm_logger_read_block
+
+
+/****************************************************************************************
+Function to send the records from first to last (inclusive) as binary blocks
+
+The range is clipped to the records still in the log
+*****************************************************************************************/
+void pm_logger_dump(uint32_t first, uint32_t last)
+{
+	struct pm_log_record records[LOG_DUMP_BLOCK_RECORDS];
+	char response[64];
+	uint32_t sequence;
+	uint32_t block_first;
+	uint32_t end;
+	uint8_t count;
+
+	end = (pm_logger_range(&first, &last) != 0) ? last + 1 : first;
+
+	sequence = first;
+	do
+	{
+		block_first = sequence;
+		count = pm_logger_read_block(&sequence, end, records);
+
+		if ((count != 0) || (block_first == first))
+		{
+			sprintf(response, "LOG_DUMP %lu %u %u\r\n", (unsigned long)block_first, (unsigned int)count,
+				(unsigned int)LOG_RECORD_SIZE);
+			pm_usart_send_pc_message(response);
+			if (count != 0)
+			{
+				pm_usart_send_pc_data((const uint8_t *)records, count * LOG_RECORD_SIZE);
+			}
+		}
+	} while (sequence < end);
+
+	sprintf(response, "LOG_END %lu\r\n", (unsigned long)end);
+	pm_usart_send_pc_message(response);
+
+}	// End of pm_logger_dump
+
+
+/****************************************************************************************
+Function to send the log range to the PC
+*****************************************************************************************/
+void pm_logger_report(void)
+{
+	char response[64];
+
+	sprintf(response, "LOG %lu %lu %lu\r\n", (unsigned long)oldest_sequence, (unsigned long)next_sequence, (unsigned long)log_capacity);
+	pm_usart_send_pc_message(response);
+
+}	// End of pm_logger_report
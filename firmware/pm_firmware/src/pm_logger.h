@@ -0,0 +1,61 @@
+/****************************************************************************************
+pm_logger.h: Include file for pm_logger.c
+
+Written by:
+	Daayim Asim, B.Eng.
+	Computer Engineer Student
+
+
+Date:
+	October 2022
+*****************************************************************************************/
+
+
+#ifndef PM_LOGGER_H_
+#define PM_LOGGER_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// pm_log_record.flags, set when a sensor could not be read
+#define LOG_FLAG_LEAK_FAILED		(1u << 0)
+#define LOG_FLAG_LTC2944_FAILED		(1u << 1)
+#define LOG_FLAG_MS5637_FAILED		(1u << 2)
+#define LOG_FLAG_MC3416_FAILED		(1u << 3)
+
+// log_dump and log_zdump send a header before each block of up to this many records
+#define LOG_DUMP_BLOCK_RECORDS		8
+
+// 32 byte record, sent as is (little endian) by log_dump
+struct pm_log_record
+{
+	uint32_t sequence;
+	uint32_t timestamp_ms;			// pm_timer time, standby time added on waking
+	uint16_t leak_mv;
+	uint16_t battery_mv;
+	int16_t battery_ma;
+	int16_t ltc2944_temperature;	// 0.01 C
+	uint16_t charge_mah;
+	uint16_t pressure;				// 0.1 mbar
+	int16_t ms5637_temperature;		// 0.01 C
+	int16_t tilt;					// 0.01 degree
+	uint16_t power_bits;			// PM_POWER_BIT_xxx
+	uint8_t status_bits;			// PM_STATUS_BIT_xxx
+	uint8_t flags;					// LOG_FLAG_xxx
+	uint16_t reserved;
+	uint16_t crc;					// CRC-16 (CCITT) of the first 30 bytes
+};
+
+void pm_logger_configure(void);
+void pm_logger_service(void);
+void pm_logger_flush(void);
+void pm_logger_sample(void);
+
+bool pm_logger_read(uint32_t, struct pm_log_record *);
+uint32_t pm_logger_range(uint32_t *, uint32_t *);
+uint8_t pm_logger_read_block(uint32_t *, uint32_t, struct pm_log_record *);
+
+void pm_logger_dump(uint32_t, uint32_t);
+void pm_logger_report(void);
+
+#endif /* PM_LOGGER_H_ */
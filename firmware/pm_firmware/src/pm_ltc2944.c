@@ -21,6 +21,7 @@ Note(s):
 #include <stdint.h>
 #include "pm_i2c.h"
 #include "pm_ltc2944.h"
+#include "pm_settings.h"
 #include "pm_usart.h"
 
 
@@ -50,7 +51,7 @@ static const double vfsv = 70.8;
 // Sense resistor
 static const double rsense = 15e-3;
 
-// Battery capacity in mAh
+// Battery capacity in mAh, from the settings store
 static double battery_capacity = 5200.0;
 
 
@@ -100,6 +101,7 @@ enum status_code pm_ltc2944_init(void)
 
 	// Assume full charge by writing the appropriate value to the accumulated charge registers
 	// My 12 V battery capacity is 5200 mAh
+	battery_capacity = (double)pm_settings_get(SETTINGS_KEY_BATTERY_CAPACITY);
 	// The LTC2944 accumulated charge registers maximum reading is 0xffff giving:
 	double max_charge = 1000.0 * (double)0xffff * qlsb_default * m * 50e-3 / (rsense * 4096.0);
 	uint16_t accumulated_charge_register_value = (uint16_t)((double)0xffff * battery_capacity / max_charge + 0.5);
@@ -21,7 +21,8 @@ Note(s):
  #include "pm_i2c.h"
  #include "pm_mc3416.h"
  #include "pm_usart.h"
- #include "pm_eeprom.h"
+ #include "pm_settings.h"
+ #include "pm_timer.h"
  #include "status_codes.h"
  #include "delay.h"
  
@@ -62,6 +63,10 @@ static const uint16_t y_ref_value = 16384;
 
 static const uint16_t mc3416_wakeup_delay_ms = 1000;
 
+// Time of the last WAKE command and whether the wakeup delay is still running
+static uint32_t wakeup_start_ms = 0;
+static bool bWakeupPending = false;
+
 /****************************************************************************************
  Local function(s)
 *****************************************************************************************/
@@ -74,6 +79,7 @@ enum status_code mc3416_validate_chip(void);
 enum status_code mc3416_read_axis(void);
 static void mc3416_convert_to_g(void);
 enum status_code mc3416_flash_read_offset(void);
+static bool mc3416_wakeup_done(void);
 
 
 
@@ -90,10 +96,16 @@ enum status_code mc3416_set_mode(uint8_t mode)
 	
 	status = pm_i2c_command_write_reg(mc3416_address, MC3416_REG_MODE, &b_mode, wr_length);
 	
+	// The wakeup delay is not waited for here, the axis registers are not read until
+	// mc3416_wakeup_done() finds it over on the millisecond tick
 	if((b_mode & MC3416_MODE_WAKE) ==  MC3416_MODE_WAKE)
 	{
-		delay_ms(mc3416_wakeup_delay_ms);
-		pm_usart_send_pc_message("wakeup delay finished!\r\n");
+		wakeup_start_ms = pm_timer_get_ms();
+		bWakeupPending = true;
+	}
+	else
+	{
+		bWakeupPending = false;
 	}
 	if(status != STATUS_OK)
 	{
@@ -102,6 +114,23 @@ enum status_code mc3416_set_mode(uint8_t mode)
 	return (status);
 }	//	End of mc3416_set_mode
 
+
+/****************************************************************************************
+Local function to check the MC3416 wakeup delay against the millisecond tick
+Returns true once the delay since the last WAKE command is over, never waits
+*****************************************************************************************/
+static bool mc3416_wakeup_done(void)
+{
+	if ((bWakeupPending == true) && (pm_timer_elapsed_ms(wakeup_start_ms) >= mc3416_wakeup_delay_ms))
+	{
+		bWakeupPending = false;
+		pm_usart_send_pc_message("wakeup delay finished!\r\n");
+	}
+
+	return (bWakeupPending == false);
+
+}	//	End of mc3416_wakeup_done
+
 /****************************************************************************************
 Local function to check the Mode (STANDBY or WAKE) of the MC3416 device
 Returns AWAKE(0) if in WAKE state, SLEEP(-1) if in STANDBY and ERROR (1) if read failed 
@@ -312,14 +341,16 @@ static void mc3416_convert_to_g(void)
 }	//	End of mc3416_convert_to_g
 
 /****************************************************************************************
-Local function to read the offset values from Flash memory
+Local function to read the offset values from the settings store
 Returns status code indicating success or failure 
 *****************************************************************************************/
 enum status_code mc3416_flash_read_offset(void)
 {
 	enum status_code status;
 	
-	eeprom_read_settings(&x_offset, &y_offset, &z_offset); //Pass address
+	x_offset = (uint16_t)pm_settings_get(SETTINGS_KEY_MC3416_X_OFFSET);
+	y_offset = (uint16_t)pm_settings_get(SETTINGS_KEY_MC3416_Y_OFFSET);
+	z_offset = (uint16_t)pm_settings_get(SETTINGS_KEY_MC3416_Z_OFFSET);
 	
 	status = STATUS_OK;
 	
@@ -328,13 +359,13 @@ enum status_code mc3416_flash_read_offset(void)
 /****************************************************************************************
 Function to initialize the MC3416 Accelerometer
 Returns status code indicating success or failure 
+The settings store must already be configured and the 1 s wakeup delay is left
+running, the reads return STATUS_BUSY until it is over
 *****************************************************************************************/
 enum status_code pm_mc3416_init(void)
 {
 	enum status_code status;
 	
-	eeprom_configure(&x_offset, &y_offset, &z_offset); //Correct configuration??
-	
 	status = mc3416_validate_chip();
 	if(status != STATUS_OK)
 	{
@@ -378,7 +409,8 @@ enum status_code pm_mc3416_init(void)
 
 /****************************************************************************************
 Function to read the MC3416 Accelerometer
-Returns status code indicating success or failure 
+Returns status code indicating success or failure, STATUS_BUSY while the wakeup
+delay is running
 *****************************************************************************************/
 enum status_code pm_mc3416_read_tilt(double *tilt_arg)
 {
@@ -400,6 +432,10 @@ enum status_code pm_mc3416_read_tilt(double *tilt_arg)
 			return (status);
 		}
 	}
+	if (mc3416_wakeup_done() == false)
+	{
+		return (STATUS_BUSY);
+	}
 	status = mc3416_read_axis();
 	if(status != STATUS_OK)
 	{
@@ -455,7 +491,8 @@ void pm_mc3416_get_g_values( double *xg_arg, double *yg_arg, double *zg_arg)
 
 /****************************************************************************************
 Function to read the MC3416 Accelerometer and save values for offset adjustment
-Returns status code indicating success or failure 
+Returns status code indicating success or failure, STATUS_BUSY while the wakeup
+delay is running
 *****************************************************************************************/
 enum status_code pm_mc3416_calibrate(void)
 {
@@ -475,6 +512,10 @@ enum status_code pm_mc3416_calibrate(void)
 			return (status);
 		}
 	}
+	if (mc3416_wakeup_done() == false)
+	{
+		return (STATUS_BUSY);
+	}
 	status = mc3416_read_axis();
 	if(status != STATUS_OK)
 	{
@@ -488,7 +529,9 @@ enum status_code pm_mc3416_calibrate(void)
 	y_offset = yout;
 	z_offset = zout;
 	
-	eeprom_write_settings(x_offset,  y_offset,  z_offset);
+	pm_settings_set(SETTINGS_KEY_MC3416_X_OFFSET, x_offset);
+	pm_settings_set(SETTINGS_KEY_MC3416_Y_OFFSET, y_offset);
+	pm_settings_set(SETTINGS_KEY_MC3416_Z_OFFSET, z_offset);
 	
 	return (status);
 }	//	End of vbs_mc3416_calibrate
@@ -506,7 +549,9 @@ enum status_code pm_mc3416_zero_offsets(void)
 	y_offset = 0;
 	z_offset = 0;
 	
-	eeprom_write_settings( x_offset,  y_offset,  z_offset);
+	pm_settings_set(SETTINGS_KEY_MC3416_X_OFFSET, x_offset);
+	pm_settings_set(SETTINGS_KEY_MC3416_Y_OFFSET, y_offset);
+	pm_settings_set(SETTINGS_KEY_MC3416_Z_OFFSET, z_offset);
 	
 	status = STATUS_OK;
 	
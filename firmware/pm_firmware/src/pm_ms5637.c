@@ -14,6 +14,9 @@ Note(s):
 - The Measurement Specialties Inc. (TE Connectivity) pressure / temperature sensor part
 	number is MS5637-02BA03
 - It's slave address is 1110110
+- The PROM words are cached in the settings store (two words per key) and validated
+	with the PROM CRC-4 (AN520) so the PROM read can be skipped at boot. A changed
+	cache is written later by pm_settings_service(), the init never waits for flash
 *****************************************************************************************/
 
 
@@ -23,6 +26,9 @@ Note(s):
 #include "pm_i2c.h"
 #include "pm_ms5637.h"
 #include "pm_usart.h"
+#include "pm_eeprom.h"
+#include "pm_settings.h"
+#include "pm_timer.h"
 
 #include "pm_gpio.h"
 
@@ -32,10 +38,16 @@ Local variable(s)
 *****************************************************************************************/
 
 static uint16_t c[7];
+static uint16_t prom[EEPROM_PROM_WORDS];
 static uint32_t d1;
 static uint32_t d2;
 static const uint16_t ms5637_address = 0x76;
 
+// Reset sequence time is 2.8 ms
+static const uint32_t ms5637_reset_time_ms = 3;
+static uint32_t reset_start_ms = 0;
+static bool bResetPending = false;
+
 
 /****************************************************************************************
 Local function(s)
@@ -44,9 +56,13 @@ Local function(s)
 static enum status_code ms5637_adc_read(uint32_t *);
 static enum status_code ms5637_convert_d1(void);
 static enum status_code ms5637_convert_d2(void);
+static uint8_t ms5637_prom_crc(const uint16_t *);
+static bool ms5637_prom_valid(const uint16_t *);
 static enum status_code ms5637_prom_read(void);
+static void ms5637_prom_load_cache(void);
+static void ms5637_prom_save_cache(void);
+static void ms5637_set_calibration_coefficients(void);
 static enum status_code ms5637_read_d1_d2(void);
-static enum status_code ms5637_reset(void);
 
 
 /****************************************************************************************
@@ -120,8 +136,99 @@ static enum status_code ms5637_convert_d2(void)
 }	// End of ms5637_convert_d2
 
 
+/****************************************************************************************
+Local function to calculate the MS5637 PROM CRC-4 (TE Connectivity AN520)
+
+The CRC is stored in the upper 4 bits of PROM word 0 and is excluded from the
+calculation
+*****************************************************************************************/
+static uint8_t ms5637_prom_crc(const uint16_t *words)
+{
+	int cnt;
+	uint8_t n_bit;
+	uint16_t n_rem;
+	uint16_t word;
+
+	n_rem = 0;
+
+	// 7 PROM words plus a subsidiary word of 0, one byte at a time
+	for (cnt = 0; cnt < 16; cnt++)
+	{
+		if ((cnt >> 1) == 0)
+		{
+			word = words[0] & 0x0fff;
+		}
+		else if ((cnt >> 1) < EEPROM_PROM_WORDS)
+		{
+			word = words[cnt >> 1];
+		}
+		else
+		{
+			word = 0;
+		}
+
+		if (cnt % 2 == 1)
+		{
+			n_rem ^= (word & 0x00ff);
+		}
+		else
+		{
+			n_rem ^= (word >> 8);
+		}
+
+		for (n_bit = 8; n_bit > 0; n_bit--)
+		{
+			if (n_rem & 0x8000)
+			{
+				n_rem = (n_rem << 1) ^ 0x3000;
+			}
+			else
+			{
+				n_rem = (n_rem << 1);
+			}
+		}
+	}
+
+	return ((n_rem >> 12) & 0x0f);
+
+}	// End of ms5637_prom_crc
+
+
+/****************************************************************************************
+Local function to check a set of PROM words
+
+Blank (all 0x0000 or all 0xFFFF) words are rejected since an all zero PROM passes
+the CRC check
+*****************************************************************************************/
+static bool ms5637_prom_valid(const uint16_t *words)
+{
+	int i;
+	bool bBlank;
+
+	bBlank = true;
+	for (i = 1; i < EEPROM_PROM_WORDS; i++)
+	{
+		if ((words[i] != 0x0000) && (words[i] != 0xffff))
+		{
+			bBlank = false;
+		}
+	}
+
+	if (bBlank)
+	{
+		return (false);
+	}
+
+	return (ms5637_prom_crc(words) == ((words[0] >> 12) & 0x0f));
+
+}	// End of ms5637_prom_valid
+
+
 /****************************************************************************************
 Local function to read the MS5637 pressure sensor PROM
+
+The PROM is readable as soon as the reset sequence is complete, there is no
+need to wait between words
 *****************************************************************************************/
 static enum status_code ms5637_prom_read(void)
 {
@@ -131,38 +238,34 @@ static enum status_code ms5637_prom_read(void)
 	uint8_t repeated_start;
 	uint32_t data;
 
-	// CRC
-	command = 0xa0;
 	repeated_start = 0;
-	status = pm_i2c_write_command_read_response(ms5637_address, &command, 1, &data, 2, repeated_start);
-	if (status != STATUS_OK)
-	{
-		pm_usart_send_pc_message("pm_ms5637_prom_read: Could not read CRC!\r\n");
-
-		return (status);
-	}
-	c[0] = (data >> 12) & 0x0f;
 
-	delay_ms(20);
-
-	// Calibration coefficients
-	for (i = 1; i <= 6; i++)
+	// CRC and calibration coefficients
+	for (i = 0; i < EEPROM_PROM_WORDS; i++)
 	{
 		command = 0xa0 + (i << 1);
 		status = pm_i2c_write_command_read_response(ms5637_address, &command, 1, &data, 2, repeated_start);
 		if (status != STATUS_OK)
 		{
-			pm_usart_send_pc_message("pm_ms5637_prom_read: Could not read calibration coefficient!\r\n");
+			if (i == 0)
+			{
+				pm_usart_send_pc_message("pm_ms5637_prom_read: Could not read CRC!\r\n");
+			}
+			else
+			{
+				pm_usart_send_pc_message("pm_ms5637_prom_read: Could not read calibration coefficient!\r\n");
+			}
 
 			return (status);
 		}
-		//else
-		//{
-			//pm_usart_send_pc_message("pm_ms5637_prom_read: Calibration coefficient read\r\n");
-		//}
-		c[i] = data;
+		prom[i] = data;
+	}
 
-		delay_ms(20);
+	if (ms5637_prom_valid(prom) == false)
+	{
+		pm_usart_send_pc_message("pm_ms5637_prom_read: CRC mismatch!\r\n");
+
+		return (STATUS_ERR_BAD_DATA);
 	}
 
 	return (status);
@@ -223,9 +326,63 @@ static enum status_code ms5637_read_d1_d2(void)
 
 
 /****************************************************************************************
-Local function to reset the MS5637 pressure sensor
+Local function to load the PROM words cached in the settings store
+*****************************************************************************************/
+static void ms5637_prom_load_cache(void)
+{
+	uint32_t value;
+
+	value = pm_settings_get(SETTINGS_KEY_MS5637_PROM_01);
+	prom[0] = (uint16_t)value;
+	prom[1] = (uint16_t)(value >> 16);
+	value = pm_settings_get(SETTINGS_KEY_MS5637_PROM_23);
+	prom[2] = (uint16_t)value;
+	prom[3] = (uint16_t)(value >> 16);
+	value = pm_settings_get(SETTINGS_KEY_MS5637_PROM_45);
+	prom[4] = (uint16_t)value;
+	prom[5] = (uint16_t)(value >> 16);
+	prom[6] = (uint16_t)pm_settings_get(SETTINGS_KEY_MS5637_PROM_6);
+
+}	// End of ms5637_prom_load_cache
+
+
+/****************************************************************************************
+Local function to cache the PROM words in the settings store
+
+Only keys that changed are written, so nothing is written after the first boot
 *****************************************************************************************/
-static enum status_code ms5637_reset(void)
+static void ms5637_prom_save_cache(void)
+{
+	pm_settings_set(SETTINGS_KEY_MS5637_PROM_01, prom[0] | ((uint32_t)prom[1] << 16));
+	pm_settings_set(SETTINGS_KEY_MS5637_PROM_23, prom[2] | ((uint32_t)prom[3] << 16));
+	pm_settings_set(SETTINGS_KEY_MS5637_PROM_45, prom[4] | ((uint32_t)prom[5] << 16));
+	pm_settings_set(SETTINGS_KEY_MS5637_PROM_6, prom[6]);
+
+}	// End of ms5637_prom_save_cache
+
+
+/****************************************************************************************
+Local function to copy the PROM words into the calibration coefficients
+*****************************************************************************************/
+static void ms5637_set_calibration_coefficients(void)
+{
+	int i;
+
+	c[0] = (prom[0] >> 12) & 0x0f;
+
+	for (i = 1; i < 7; i++)
+		c[i] = prom[i];
+
+}	// End of ms5637_set_calibration_coefficients
+
+
+/****************************************************************************************
+Function to start the MS5637 reset sequence
+
+Returns without waiting for the 2.8 ms reset sequence, pm_ms5637_init() waits for
+whatever is left of it
+*****************************************************************************************/
+enum status_code pm_ms5637_reset(void)
 {
 	enum status_code status;
 	uint8_t command;
@@ -236,9 +393,12 @@ static enum status_code ms5637_reset(void)
 
 	status = pm_i2c_write_command_packet(ms5637_address, &command, 1, repeated_start);
 
+	reset_start_ms = pm_timer_get_ms();
+	bResetPending = (status == STATUS_OK);
+
 	return (status);
 
-}	// End of ms5637_reset
+}	// End of pm_ms5637_reset
 
 
 /****************************************************************************************
@@ -256,20 +416,46 @@ void pm_ms5637_get_calibration_coefficients(uint16_t *cc)
 
 /****************************************************************************************
 Function to initialize the MS5637 pressure sensor
+
+If bUseCache is true the PROM words cached in the settings store are used when
+their CRC is valid, otherwise the PROM is read and the cache refreshed
 *****************************************************************************************/
-enum status_code pm_ms5637_init(void)
+enum status_code pm_ms5637_init(bool bUseCache)
 {
 	enum status_code status;
+	uint32_t elapsed;
 
-	// Reset the MS5637 once after power-on
-	status = ms5637_reset();
-	if (status != STATUS_OK)
+	// Reset the MS5637 once after power-on, unless the reset was already started
+	if (bResetPending == false)
 	{
-		pm_usart_send_pc_message("pm_ms5637_init: Could not reset!\r\n");
+		status = pm_ms5637_reset();
+		if (status != STATUS_OK)
+		{
+			pm_usart_send_pc_message("pm_ms5637_init: Could not reset!\r\n");
 
-		return (status);
+			return (status);
+		}
 	}
-	
+
+	elapsed = pm_timer_elapsed_ms(reset_start_ms);
+	if (elapsed < ms5637_reset_time_ms)
+	{
+		delay_ms(ms5637_reset_time_ms - elapsed);
+	}
+	bResetPending = false;
+
+	if (bUseCache)
+	{
+		ms5637_prom_load_cache();
+		if (ms5637_prom_valid(prom))
+		{
+			pm_usart_send_pc_message("pm_ms5637_init: PROM loaded from settings\r\n");
+			ms5637_set_calibration_coefficients();
+
+			return (STATUS_OK);
+		}
+	}
+
 	// Read the MS5637 PROM to get the CRC and calibration coefficients
 	status = ms5637_prom_read();
 	if (status != STATUS_OK)
@@ -277,6 +463,9 @@ enum status_code pm_ms5637_init(void)
 		return (status);
 	}
 
+	ms5637_set_calibration_coefficients();
+	ms5637_prom_save_cache();
+
 	return (status);
 
 }	// End of pm_ms5637_init
@@ -16,7 +16,8 @@ Date:
 
 
 void pm_ms5637_get_calibration_coefficients(uint16_t *);
-enum status_code pm_ms5637_init(void);
+enum status_code pm_ms5637_init(bool);
+enum status_code pm_ms5637_reset(void);
 enum status_code pm_ms5637_read(uint32_t *, double *, uint32_t *, double *);
 
 
@@ -11,6 +11,9 @@ Date:
 
 Note(s):
 - Based on net_sounder_power.cz
+- The RTC counts the 1.024 kHz output of the ultra low power 32 kHz oscillator,
+which runs in standby, and wakes the MCU every compare match to take a log sample.
+There is no ASF RTC driver in the project, the registers are set directly
 -----------------------------------------------------------------------------------------
 SAML21J18B
 Pin		I/O		PM board pin	Function			Notes:
@@ -31,6 +34,7 @@ Pin		I/O		PM board pin	Function			Notes:
 #include "pm_gpio.h"
 #include "pm_usart.h"
 #include "pm_spi.h"
+#include "pm_timer.h"
 #include "pm_config_codes.h"
 
 /***************************************************************************
@@ -44,6 +48,12 @@ static const uint8_t wakeup_en_pin = PIN_PA11;
 static const uint8_t vbs_wakeup_en_interrupt_channel = 7;
 static const uint8_t vbs_wakeup_en_pin = PIN_PA23;
 
+#define POWER_RTC_HZ 1024ul
+
+// Set by the interrupts that ended the last standby
+static volatile bool bRtcWakeup = false;
+static volatile bool bPinWakeup = false;
+
 
 /***************************************************************************
 // Local function(s)
@@ -51,6 +61,7 @@ static const uint8_t vbs_wakeup_en_pin = PIN_PA23;
 
 void power_interrupt_configure(void);
 void power_interrupt_disable(void);
+void power_pin_wakeup_callback(void);
 void power_normal(void);
 void power_sleep(void);
 void power_standby(void);
@@ -73,6 +84,7 @@ void power_interrupt_configure(void)
 	extint_chan_conf_struct.gpio_pin_pull = EXTINT_PULL_DOWN;
 	extint_chan_set_config(wakeup_en_interrupt_channel, &extint_chan_conf_struct);
 
+	extint_register_callback(power_pin_wakeup_callback, wakeup_en_interrupt_channel, EXTINT_CALLBACK_TYPE_DETECT);
 	extint_chan_enable_callback(wakeup_en_interrupt_channel, EXTINT_CALLBACK_TYPE_DETECT);
 
 	extint_chan_get_config_defaults(&extint_chan_conf_struct);
@@ -84,6 +96,7 @@ void power_interrupt_configure(void)
 	extint_chan_conf_struct.gpio_pin_pull = EXTINT_PULL_DOWN;
 	extint_chan_set_config(vbs_wakeup_en_interrupt_channel, &extint_chan_conf_struct);
 
+	extint_register_callback(power_pin_wakeup_callback, vbs_wakeup_en_interrupt_channel, EXTINT_CALLBACK_TYPE_DETECT);
 	extint_chan_enable_callback(vbs_wakeup_en_interrupt_channel, EXTINT_CALLBACK_TYPE_DETECT);
 
 	// Disable I/O retention
@@ -131,6 +144,101 @@ void power_interrupt_disable(void)
 }	// End of power_interrupt_disable
 
 
+/***************************************************************************
+Callback for the WAKEUP/EN and VBS_RX external interrupts
+****************************************************************************/
+void power_pin_wakeup_callback(void)
+{
+	bPinWakeup = true;
+
+}	// End of power_pin_wakeup_callback
+
+
+/***************************************************************************
+RTC compare match interrupt, the counter clears itself on the match
+****************************************************************************/
+void RTC_Handler(void)
+{
+	RTC->MODE0.INTFLAG.reg = RTC_MODE0_INTFLAG_CMP0;
+	bRtcWakeup = true;
+
+}	// End of RTC_Handler
+
+
+/***************************************************************************
+Function to start the RTC waking the MCU from standby every period_s seconds
+****************************************************************************/
+void pm_power_rtc_wakeup_enable(uint32_t period_s)
+{
+	MCLK->APBAMASK.reg |= MCLK_APBAMASK_RTC;
+	OSC32KCTRL->RTCCTRL.reg = OSC32KCTRL_RTCCTRL_RTCSEL_ULP1K;
+
+	RTC->MODE0.CTRLA.reg = RTC_MODE0_CTRLA_SWRST;
+	while (RTC->MODE0.SYNCBUSY.reg & RTC_MODE0_SYNCBUSY_SWRST)
+	{
+	}
+
+	RTC->MODE0.CTRLA.reg = RTC_MODE0_CTRLA_MODE_COUNT32 | RTC_MODE0_CTRLA_PRESCALER_DIV1 |
+		RTC_MODE0_CTRLA_MATCHCLR | RTC_MODE0_CTRLA_COUNTSYNC;
+	RTC->MODE0.COMP[0].reg = period_s * POWER_RTC_HZ - 1;
+	while (RTC->MODE0.SYNCBUSY.reg & RTC_MODE0_SYNCBUSY_COMP0)
+	{
+	}
+
+	RTC->MODE0.INTFLAG.reg = RTC_MODE0_INTFLAG_CMP0;
+	RTC->MODE0.INTENSET.reg = RTC_MODE0_INTENSET_CMP0;
+	system_interrupt_enable(SYSTEM_INTERRUPT_MODULE_RTC);
+
+	RTC->MODE0.CTRLA.reg |= RTC_MODE0_CTRLA_ENABLE;
+	while (RTC->MODE0.SYNCBUSY.reg & RTC_MODE0_SYNCBUSY_ENABLE)
+	{
+	}
+
+}	// End of pm_power_rtc_wakeup_enable
+
+
+/***************************************************************************
+Function to stop the RTC wakeup
+Returns the milliseconds counted since the last compare match
+****************************************************************************/
+uint32_t pm_power_rtc_wakeup_disable(void)
+{
+	uint32_t count;
+
+	while (RTC->MODE0.SYNCBUSY.reg & RTC_MODE0_SYNCBUSY_COUNT)
+	{
+	}
+	count = RTC->MODE0.COUNT.reg;
+
+	system_interrupt_disable(SYSTEM_INTERRUPT_MODULE_RTC);
+	RTC->MODE0.CTRLA.reg &= ~RTC_MODE0_CTRLA_ENABLE;
+	while (RTC->MODE0.SYNCBUSY.reg & RTC_MODE0_SYNCBUSY_ENABLE)
+	{
+	}
+	bRtcWakeup = false;
+
+	return ((uint32_t)(((uint64_t)count * 1000ull) / POWER_RTC_HZ));
+
+}	// End of pm_power_rtc_wakeup_disable
+
+
+/***************************************************************************
+Function to check if only the RTC ended the last standby, the MCU goes back
+to sleep after taking a sample
+****************************************************************************/
+bool pm_power_rtc_wakeup_occurred(void)
+{
+	bool bSample;
+
+	bSample = bRtcWakeup && (bPinWakeup == false);
+	bRtcWakeup = false;
+	bPinWakeup = false;
+
+	return (bSample);
+
+}	// End of pm_power_rtc_wakeup_occurred
+
+
 /***************************************************************************
 Function to switch to performance level 2
 ****************************************************************************/
@@ -191,6 +299,7 @@ void pm_power_normal_power_mode(void)
 	pm_usart_configure();
 	pm_spi_configure(MODE_NORMALPOWER);
 	delay_init();
+	pm_timer_configure();
 
 	
 }	// End of normal_power_mode
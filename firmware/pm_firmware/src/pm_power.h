@@ -14,10 +14,17 @@ Date:
 #ifndef ALTIMETER_POWER_H
 #define ALTIMETER_POWER_H
 
+#include <stdbool.h>
+#include <stdint.h>
+
 void pm_power_configure_wakeup_en(void);
 
 void pm_power_normal_power_mode(void);
 void pm_power_low_power_mode(void);
 
+void pm_power_rtc_wakeup_enable(uint32_t);
+uint32_t pm_power_rtc_wakeup_disable(void);
+bool pm_power_rtc_wakeup_occurred(void);
+
 
 #endif	// ALTIMETER_POWER_H
\ No newline at end of file
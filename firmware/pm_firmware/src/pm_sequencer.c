@@ -0,0 +1,296 @@
+/****************************************************************************************
+pm_sequencer.c:   power module (PM) power profile sequencer functions
+
+Written by:
+	Daayim Asim, B.Eng.
+	Computer Engineer Student
+
+
+Date:
+	October 2022
+
+Note(s):
+- A power profile is an ordered table of rail steps. Each step changes one or more
+	rails together (pm_gpio_power_bits_set), then waits its settle time before the
+	next step. A step whose precondition rails are not at the given levels stops the
+	transition, e.g. the WCM only powers up once its relay is closed
+- The interlocks table holds the rules every rail change follows, from a profile or
+	from a per-rail command (pm_sequencer_set_rails), e.g. the relays only switch
+	while the relay driver is enabled. They are checked against the levels the rails
+	will have after the change, so a change may enable the driver and switch a relay
+	together. A rule may hold only for one direction, e.g. the WCM is only powered
+	with its relay closed but can always be turned off
+- The per-rail commands are refused while a transition runs (pm_sequencer_busy), and
+	a change they make leaves no current profile
+- The steps are run by pm_sequencer_service() from the main loop using the pm_timer
+	millisecond time, so a transition never blocks command handling
+- Rail levels are pin levels as in PM_POWER_BIT_xxx, the relay driver is enabled
+	when DRIVER is low
+- set_profile <name> sends "SEQ_START <name>", one "SEQ_STEP <name> <step> <rails>
+	<levels> <ms>" per step, then "SEQ_DONE <name> <ms>" or "SEQ_FAIL <name> <step>
+	<power bits>". The times are from the start of the transition
+*****************************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include "pm_sequencer.h"
+#include "pm_gpio.h"
+#include "pm_timer.h"
+#include "pm_usart.h"
+
+
+/****************************************************************************************
+Local variable(s)
+*****************************************************************************************/
+
+// Rails that only change while other rails are at given levels, DRIVER low enables
+// the relay driver. The WCM is powered only with its relay closed, and the relay
+// opens only with the WCM off
+static const struct pm_sequencer_interlock interlocks[] =
+{
+	{PM_POWER_BIT_MAIN_PWR | PM_POWER_BIT_WCM_RLY, 0, 0, PM_POWER_BIT_DRIVER, 0},
+	{PM_POWER_BIT_WCM_PWR, PM_POWER_BIT_WCM_PWR, PM_POWER_BIT_WCM_PWR, PM_POWER_BIT_WCM_RLY, PM_POWER_BIT_WCM_RLY},
+	{PM_POWER_BIT_WCM_RLY, PM_POWER_BIT_WCM_RLY, 0, PM_POWER_BIT_WCM_PWR, 0}
+};
+
+#define SEQUENCER_INTERLOCKS		(uint8_t)(sizeof(interlocks) / sizeof(interlocks[0]))
+
+// Everything off except the relay driver, which is enabled first so the relays open
+static const struct pm_sequencer_step sleep_steps[] =
+{
+	{PM_POWER_BIT_DRIVER, 0, 5, 0, 0},
+	{PM_POWER_BIT_WCM_PWR, 0, 10, 0, 0},
+	{PM_POWER_BIT_WCM_RLY | PM_POWER_BIT_MAIN_PWR, 0, 20, 0, 0},
+	{PM_POWER_BIT_WCM_DIAG | PM_POWER_BIT_VBS_SER_PWR | PM_POWER_BIT_VBS_PWR | PM_POWER_BIT_CTD_PWR |
+		PM_POWER_BIT_BATT_SER_PWR | PM_POWER_BIT_BATT_SEL, 0, 0, 0, 0},
+	{PM_POWER_BIT_3V3VA, 0, 0, 0, 0}
+};
+
+// Sensors powered, WCM off
+static const struct pm_sequencer_step sensing_steps[] =
+{
+	{PM_POWER_BIT_3V3VA, PM_POWER_BIT_3V3VA, 10, 0, 0},
+	{PM_POWER_BIT_DRIVER, 0, 5, 0, 0},
+	{PM_POWER_BIT_WCM_PWR, 0, 10, 0, 0},
+	{PM_POWER_BIT_WCM_RLY, 0, 20, 0, 0}
+};
+
+// Sensors powered, WCM relay closed before the WCM is powered
+static const struct pm_sequencer_step comms_steps[] =
+{
+	{PM_POWER_BIT_3V3VA, PM_POWER_BIT_3V3VA, 10, 0, 0},
+	{PM_POWER_BIT_DRIVER, 0, 5, 0, 0},
+	{PM_POWER_BIT_WCM_RLY, PM_POWER_BIT_WCM_RLY, 50, 0, 0},
+	{PM_POWER_BIT_WCM_PWR, PM_POWER_BIT_WCM_PWR, 100, PM_POWER_BIT_WCM_RLY, PM_POWER_BIT_WCM_RLY}
+};
+
+#define SEQUENCER_STEPS(steps)		(uint8_t)(sizeof(steps) / sizeof(steps[0]))
+
+static const struct pm_sequencer_profile profiles[] =
+{
+	{"sleep", sleep_steps, SEQUENCER_STEPS(sleep_steps)},
+	{"sensing", sensing_steps, SEQUENCER_STEPS(sensing_steps)},
+	{"comms", comms_steps, SEQUENCER_STEPS(comms_steps)}
+};
+
+#define SEQUENCER_PROFILES			(uint8_t)(sizeof(profiles) / sizeof(profiles[0]))
+
+// Profile being run, NULL when idle
+static const struct pm_sequencer_profile *active_profile = NULL;
+
+// Last profile completed, NULL after a failed transition
+static const struct pm_sequencer_profile *current_profile = NULL;
+
+static uint8_t step_index = 0;
+static uint32_t step_start_ms = 0;
+static uint32_t transition_start_ms = 0;
+static uint32_t transition_ms = 0;
+
+
+/****************************************************************************************
+Function to return the rails that cannot change to levels, because an interlock would
+not be met with the rails at their new levels
+*****************************************************************************************/
+uint16_t pm_sequencer_interlocked(uint16_t rails, uint16_t levels)
+{
+	uint16_t applies;
+	uint16_t blocked;
+	uint16_t power_bits;
+	uint8_t i;
+
+	power_bits = (pm_gpio_power_bits_get() & ~rails) | (levels & rails);
+
+	blocked = 0;
+	for (i = 0; i < SEQUENCER_INTERLOCKS; i++)
+	{
+		// Only the rails of the rule that change to its levels
+		applies = rails & interlocks[i].rails & ~((levels ^ interlocks[i].levels) & interlocks[i].levels_mask);
+
+		if ((power_bits & interlocks[i].precondition_mask) != interlocks[i].precondition_levels)
+		{
+			blocked |= applies;
+		}
+	}
+
+	return (blocked);
+
+}	// End of pm_sequencer_interlocked
+
+
+/****************************************************************************************
+Function to change rails to levels outside a profile, for the per-rail commands. The
+rails held by an interlock are left as they are, and nothing changes while a
+transition is running
+
+Returns the rails changed
+*****************************************************************************************/
+uint16_t pm_sequencer_set_rails(uint16_t rails, uint16_t levels)
+{
+	uint16_t power_bits;
+
+	if (active_profile != NULL)
+	{
+		return (0);
+	}
+
+	rails &= ~pm_sequencer_interlocked(rails, levels);
+
+	power_bits = pm_gpio_power_bits_get();
+	pm_gpio_power_bits_set(rails, levels);
+
+	// The rails no longer follow the last profile
+	if (pm_gpio_power_bits_get() != power_bits)
+	{
+		current_profile = NULL;
+	}
+
+	return (rails);
+
+}	// End of pm_sequencer_set_rails
+
+
+/****************************************************************************************
+Function to start the transition to the named profile
+
+Returns STATUS_BUSY while another transition is running
+*****************************************************************************************/
+enum status_code pm_sequencer_start(const char *name)
+{
+	char response[64];
+	uint8_t i;
+
+	if (active_profile != NULL)
+	{
+		return (STATUS_BUSY);
+	}
+
+	for (i = 0; i < SEQUENCER_PROFILES; i++)
+	{
+		if (strcmp(name, profiles[i].name) == 0)
+		{
+			break;
+		}
+	}
+	if (i == SEQUENCER_PROFILES)
+	{
+		return (STATUS_ERR_INVALID_ARG);
+	}
+
+	active_profile = &profiles[i];
+	step_index = 0;
+	transition_start_ms = pm_timer_get_ms();
+
+	sprintf(response, "SEQ_START %s\r\n", active_profile->name);
+	pm_usart_send_pc_message(response);
+
+	pm_sequencer_service();
+
+	return (STATUS_OK);
+
+}	// End of pm_sequencer_start
+
+
+/****************************************************************************************
+Function to run the next step of a transition once the last one has settled
+
+Call from the main loop
+*****************************************************************************************/
+void pm_sequencer_service(void)
+{
+	const struct pm_sequencer_step *step;
+	char response[64];
+	uint16_t power_bits;
+
+	if (active_profile == NULL)
+	{
+		return;
+	}
+
+	if ((step_index > 0) && (pm_timer_elapsed_ms(step_start_ms) < active_profile->steps[step_index - 1].settle_ms))
+	{
+		return;
+	}
+
+	if (step_index == active_profile->step_count)
+	{
+		transition_ms = pm_timer_elapsed_ms(transition_start_ms);
+
+		sprintf(response, "SEQ_DONE %s %lu\r\n", active_profile->name, (unsigned long)transition_ms);
+		pm_usart_send_pc_message(response);
+
+		current_profile = active_profile;
+		active_profile = NULL;
+		return;
+	}
+
+	step = &active_profile->steps[step_index];
+
+	power_bits = pm_gpio_power_bits_get();
+	if (((power_bits & step->precondition_mask) != step->precondition_levels) ||
+		(pm_sequencer_interlocked(step->rails, step->levels) != 0))
+	{
+		transition_ms = pm_timer_elapsed_ms(transition_start_ms);
+
+		sprintf(response, "SEQ_FAIL %s %u 0x%03x\r\n", active_profile->name, step_index, power_bits);
+		pm_usart_send_pc_message(response);
+
+		// The rails are part way between two profiles
+		current_profile = NULL;
+		active_profile = NULL;
+		return;
+	}
+
+	pm_gpio_power_bits_set(step->rails, step->levels);
+	step_start_ms = pm_timer_get_ms();
+
+	sprintf(response, "SEQ_STEP %s %u 0x%03x 0x%03x %lu\r\n", active_profile->name, step_index,
+		step->rails, step->levels, (unsigned long)(step_start_ms - transition_start_ms));
+	pm_usart_send_pc_message(response);
+
+	step_index++;
+
+}	// End of pm_sequencer_service
+
+
+/****************************************************************************************
+Function to return true while a transition is running
+*****************************************************************************************/
+bool pm_sequencer_busy(void)
+{
+	return (active_profile != NULL);
+
+}	// End of pm_sequencer_busy
+
+
+/****************************************************************************************
+Function to send the current profile and the length of the last transition to the PC
+*****************************************************************************************/
+void pm_sequencer_report(void)
+{
+	char response[64];
+
+	sprintf(response, "PROFILE %s %s %lu\r\n", (current_profile != NULL) ? current_profile->name : "none",
+		(active_profile != NULL) ? active_profile->name : "idle", (unsigned long)transition_ms);
+	pm_usart_send_pc_message(response);
+
+}	// End of pm_sequencer_report
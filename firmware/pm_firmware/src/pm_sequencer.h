@@ -0,0 +1,57 @@
+/****************************************************************************************
+pm_sequencer.h: Include file for pm_sequencer.c
+
+Written by:
+	Daayim Asim, B.Eng.
+	Computer Engineer Student
+
+
+Date:
+	October 2022
+*****************************************************************************************/
+
+
+#ifndef PM_SEQUENCER_H_
+#define PM_SEQUENCER_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <status_codes.h>
+
+// One rail change of a power profile
+struct pm_sequencer_step
+{
+	uint16_t rails;					// PM_POWER_BIT_xxx, changed together
+	uint16_t levels;				// New levels of rails
+	uint16_t settle_ms;				// Wait before the next step
+	uint16_t precondition_mask;		// PM_POWER_BIT_xxx that must be at...
+	uint16_t precondition_levels;	// ...these levels before the step
+};
+
+// Rails that only change while other rails are at given levels
+struct pm_sequencer_interlock
+{
+	uint16_t rails;
+	uint16_t levels_mask;			// Rails the rule only holds back when...
+	uint16_t levels;				// ...they change to these levels
+	uint16_t precondition_mask;
+	uint16_t precondition_levels;
+};
+
+struct pm_sequencer_profile
+{
+	const char *name;
+	const struct pm_sequencer_step *steps;
+	uint8_t step_count;
+};
+
+enum status_code pm_sequencer_start(const char *);
+void pm_sequencer_service(void);
+bool pm_sequencer_busy(void);
+
+uint16_t pm_sequencer_interlocked(uint16_t, uint16_t);
+uint16_t pm_sequencer_set_rails(uint16_t, uint16_t);
+
+void pm_sequencer_report(void);
+
+#endif /* PM_SEQUENCER_H_ */
@@ -0,0 +1,711 @@
+/****************************************************************************************
+pm_settings.c:   power module (PM) settings store functions
+
+Written by:
+	Daayim Asim, B.Eng.
+	Computer Engineer Student
+
+
+Date:
+	October 2022
+
+Note(s):
+- Key / value settings store on the 8 kB RWW EEPROM section of the SAML21, the
+	RWW EEPROM emulator (rww_eeprom.c) must not be used at the same time
+- The section is split in two banks of 64 pages. Page 0 of a bank holds the
+	header record (schema version and generation), the other pages hold records
+	appended in order, the last valid record for a key wins
+- A record is 8 bytes: key, schema version, 32 bit value and CRC-16 (CCITT)
+- When the active bank is full, or was written under another schema version, the
+	other bank is erased, the current values are written to it and its header is
+	written last, so a reset part way through leaves the old bank active
+- Each key has a range. set_setting values outside it are refused, and a stored
+	value outside it (from an older schema) is replaced by the default
+- pm_settings_set() only updates RAM. Changes are batched for
+	SETTINGS_COMMIT_DELAY_MS and written one page or row at a time by
+	pm_settings_service(), which never waits for the NVM controller. RWW EEPROM
+	is a separate flash array so execution continues from main flash while a
+	page is programmed or a row erased
+- The NVM controller error flags are shared with the sample logger and cleared by
+	every NVM command. The result of a settings operation is checked by
+	pm_settings_nvm_release(), which the logger calls before its own operations,
+	and only when a settings operation was actually started
+*****************************************************************************************/
+
+#include <nvm.h>
+#include <stdio.h>
+#include <string.h>
+#include "pm_settings.h"
+#include "pm_crc.h"
+#include "pm_eeprom.h"
+#include "pm_timer.h"
+#include "pm_usart.h"
+
+#define SETTINGS_RECORD_SIZE 8
+#define SETTINGS_RECORDS_PER_PAGE (NVMCTRL_PAGE_SIZE / SETTINGS_RECORD_SIZE)
+#define SETTINGS_BANK_PAGES (NVMCTRL_RWWEE_PAGES / 2)
+#define SETTINGS_BANK_ROWS (SETTINGS_BANK_PAGES / NVMCTRL_ROW_PAGES)
+#define SETTINGS_ALL_KEYS ((1ul << SETTINGS_KEY_COUNT) - 1)
+
+#define SETTINGS_HEADER_KEY 0xf0
+#define SETTINGS_ERASED_KEY 0xff
+
+#define SETTINGS_COMMIT_DELAY_MS 2000
+
+
+/****************************************************************************************
+Local variable(s)
+*****************************************************************************************/
+
+enum settings_state
+{
+	SETTINGS_STATE_IDLE,
+	SETTINGS_STATE_ERASE,
+	SETTINGS_STATE_COMPACT
+};
+
+struct settings_entry
+{
+	const char *name;
+	uint32_t default_value;
+	uint32_t min_value;
+	uint32_t max_value;
+};
+
+// BATTERY_CAPACITY is limited by the LTC2944 charge register full scale, WAKE_PERIOD
+// and LOG_PERIOD to a day and LEAK_THRESHOLD to the 3.3 V ADC reference
+static const struct settings_entry settings_table[SETTINGS_KEY_COUNT] =
+{
+	{ "MC3416_X_OFFSET", 0, 0, 0xffff },
+	{ "MC3416_Y_OFFSET", 0, 0, 0xffff },
+	{ "MC3416_Z_OFFSET", 0, 0, 0xffff },
+	{ "BATTERY_CAPACITY", 5200, 1, 74000 },
+	{ "WAKE_PERIOD", 30, 1, 86400 },
+	{ "LOG_PERIOD", 60, 0, 86400 },
+	{ "LEAK_THRESHOLD", 1500, 0, 3300 },
+	{ "MS5637_PROM_01", 0, 0, 0xfffffffful },
+	{ "MS5637_PROM_23", 0, 0, 0xfffffffful },
+	{ "MS5637_PROM_45", 0, 0, 0xfffffffful },
+	{ "MS5637_PROM_6", 0, 0, 0xffff }
+};
+
+static uint32_t values[SETTINGS_KEY_COUNT];
+
+static enum settings_state state = SETTINGS_STATE_IDLE;
+static uint8_t active_bank = 0;
+static uint32_t generation = 0;
+static uint16_t free_page = SETTINGS_BANK_PAGES;
+static bool bCompactPending = false;
+static bool bFlush = false;
+
+// An NVM operation was started and its result has not been checked yet
+static bool bNvmPending = false;
+
+// Keys changed in RAM but not yet written
+static uint32_t dirty_mask = 0;
+static uint32_t dirty_start_ms = 0;
+
+// Compaction progress
+static uint8_t erase_row = 0;
+static uint16_t compact_page = 0;
+static uint32_t compact_mask = 0;
+
+
+/****************************************************************************************
+Local function(s)
+*****************************************************************************************/
+
+static uint32_t settings_address(uint8_t, uint16_t);
+static void settings_encode(uint8_t *, uint8_t, uint32_t);
+static bool settings_decode(const uint8_t *, uint8_t *, uint8_t *, uint32_t *);
+static bool settings_read_header(uint8_t, uint8_t *, uint32_t *);
+static void settings_load_bank(uint8_t);
+static void settings_nvm_erase_row(uint32_t);
+static void settings_nvm_write_page(uint32_t, const uint8_t *);
+static uint32_t settings_write_records(uint8_t, uint16_t, uint32_t);
+static void settings_write_header(uint8_t, uint32_t);
+static uint8_t settings_count(uint32_t);
+
+
+/****************************************************************************************
+Local function to return the RWW EEPROM address of a bank page
+*****************************************************************************************/
+static uint32_t settings_address(uint8_t bank, uint16_t page)
+{
+	return (NVMCTRL_RWW_EEPROM_ADDR + ((uint32_t)bank * SETTINGS_BANK_PAGES + page) * NVMCTRL_PAGE_SIZE);
+
+}	// End of settings_address
+
+
+/****************************************************************************************
+Local function to build a record
+*****************************************************************************************/
+static void settings_encode(uint8_t *record, uint8_t key, uint32_t value)
+{
+	uint16_t crc;
+
+	record[0] = key;
+	record[1] = SETTINGS_SCHEMA_VERSION;
+	record[2] = (uint8_t)value;
+	record[3] = (uint8_t)(value >> 8);
+	record[4] = (uint8_t)(value >> 16);
+	record[5] = (uint8_t)(value >> 24);
+
+	crc = pm_crc16(record, SETTINGS_RECORD_SIZE - 2);
+	record[6] = (uint8_t)crc;
+	record[7] = (uint8_t)(crc >> 8);
+
+}	// End of settings_encode
+
+
+/****************************************************************************************
+Local function to check and unpack a record
+Returns false for erased, torn or corrupt records
+*****************************************************************************************/
+static bool settings_decode(const uint8_t *record, uint8_t *key, uint8_t *version, uint32_t *value)
+{
+	uint16_t crc;
+
+	if (record[0] == SETTINGS_ERASED_KEY)
+	{
+		return (false);
+	}
+
+	crc = record[6];
+	crc|= (uint16_t)record[7] << 8;
+	if (crc != pm_crc16(record, SETTINGS_RECORD_SIZE - 2))
+	{
+		return (false);
+	}
+
+	*key = record[0];
+	*version = record[1];
+	*value = record[2];
+	*value|= (uint32_t)record[3] << 8;
+	*value|= (uint32_t)record[4] << 16;
+	*value|= (uint32_t)record[5] << 24;
+
+	return (true);
+
+}	// End of settings_decode
+
+
+/****************************************************************************************
+Local function to read the header record of a bank
+Returns false if the bank has no valid header
+*****************************************************************************************/
+static bool settings_read_header(uint8_t bank, uint8_t *version, uint32_t *gen)
+{
+	uint8_t record[SETTINGS_RECORD_SIZE];
+	uint8_t key;
+
+	if (nvm_read_buffer(settings_address(bank, 0), record, SETTINGS_RECORD_SIZE) != STATUS_OK)
+	{
+		return (false);
+	}
+
+	if (settings_decode(record, &key, version, gen) == false)
+	{
+		return (false);
+	}
+
+	return (key == SETTINGS_HEADER_KEY);
+
+}	// End of settings_read_header
+
+
+/****************************************************************************************
+Local function to replay the records of a bank into RAM and find its first free page
+*****************************************************************************************/
+static void settings_load_bank(uint8_t bank)
+{
+	uint8_t page_data[NVMCTRL_PAGE_SIZE];
+	uint16_t page;
+	uint8_t i;
+	uint8_t key;
+	uint8_t version;
+	uint32_t value;
+	bool bErased;
+
+	free_page = SETTINGS_BANK_PAGES;
+
+	for (page = 1; page < SETTINGS_BANK_PAGES; page++)
+	{
+		if (nvm_read_buffer(settings_address(bank, page), page_data, NVMCTRL_PAGE_SIZE) != STATUS_OK)
+		{
+			pm_usart_send_pc_message("settings_load_bank: STATUS_ERR_READ_NVM\r\n");
+			break;
+		}
+
+		bErased = true;
+		for (i = 0; i < NVMCTRL_PAGE_SIZE; i++)
+		{
+			if (page_data[i] != 0xff)
+			{
+				bErased = false;
+				break;
+			}
+		}
+
+		// Pages are written in order, the first erased page ends the log
+		if (bErased)
+		{
+			free_page = page;
+			break;
+		}
+
+		for (i = 0; i < SETTINGS_RECORDS_PER_PAGE; i++)
+		{
+			if (settings_decode(&page_data[i * SETTINGS_RECORD_SIZE], &key, &version, &value))
+			{
+				// Keys dropped from the schema are ignored and discarded by the next compaction
+				if ((key < SETTINGS_KEY_COUNT) && (value >= settings_table[key].min_value) &&
+					(value <= settings_table[key].max_value))
+				{
+					values[key] = value;
+				}
+			}
+		}
+	}
+
+}	// End of settings_load_bank
+
+
+/****************************************************************************************
+Local function to start erasing an RWW EEPROM row, does not wait for completion
+*****************************************************************************************/
+static void settings_nvm_erase_row(uint32_t address)
+{
+	Nvmctrl *const nvm_module = NVMCTRL;
+
+	nvm_module->STATUS.reg = NVMCTRL_STATUS_MASK;
+	nvm_module->ADDR.reg = address / 2;
+	nvm_module->CTRLA.reg = NVM_COMMAND_RWWEE_ERASE_ROW | NVMCTRL_CTRLA_CMDEX_KEY;
+	bNvmPending = true;
+
+}	// End of settings_nvm_erase_row
+
+
+/****************************************************************************************
+Local function to start programming an RWW EEPROM page, does not wait for completion
+*****************************************************************************************/
+static void settings_nvm_write_page(uint32_t address, const uint8_t *page_data)
+{
+	Nvmctrl *const nvm_module = NVMCTRL;
+	volatile uint16_t *page_buffer = (volatile uint16_t *)(uintptr_t)address;
+	uint8_t i;
+
+	// The page buffer clear only takes a few cycles
+	nvm_module->CTRLA.reg = NVM_COMMAND_PAGE_BUFFER_CLEAR | NVMCTRL_CTRLA_CMDEX_KEY;
+	while (!nvm_is_ready())
+	{
+	}
+
+	nvm_module->STATUS.reg = NVMCTRL_STATUS_MASK;
+
+	// NVM must be written as 16-bit words
+	for (i = 0; i < NVMCTRL_PAGE_SIZE / 2; i++)
+	{
+		page_buffer[i] = page_data[2 * i] | ((uint16_t)page_data[(2 * i) + 1] << 8);
+	}
+
+	nvm_module->ADDR.reg = address / 2;
+	nvm_module->CTRLA.reg = NVM_COMMAND_RWWEE_WRITE_PAGE | NVMCTRL_CTRLA_CMDEX_KEY;
+	bNvmPending = true;
+
+}	// End of settings_nvm_write_page
+
+
+/****************************************************************************************
+Local function to write up to one page of records for the keys in mask
+Returns the keys that were written
+*****************************************************************************************/
+static uint32_t settings_write_records(uint8_t bank, uint16_t page, uint32_t mask)
+{
+	uint8_t page_data[NVMCTRL_PAGE_SIZE];
+	uint8_t count;
+	uint8_t key;
+	uint32_t written;
+
+	memset(page_data, 0xff, NVMCTRL_PAGE_SIZE);
+
+	count = 0;
+	written = 0;
+	for (key = 0; (key < SETTINGS_KEY_COUNT) && (count < SETTINGS_RECORDS_PER_PAGE); key++)
+	{
+		if (mask & (1ul << key))
+		{
+			settings_encode(&page_data[count * SETTINGS_RECORD_SIZE], key, values[key]);
+			written |= (1ul << key);
+			count++;
+		}
+	}
+
+	settings_nvm_write_page(settings_address(bank, page), page_data);
+
+	return (written);
+
+}	// End of settings_write_records
+
+
+/****************************************************************************************
+Local function to write the header page of a bank
+*****************************************************************************************/
+static void settings_write_header(uint8_t bank, uint32_t gen)
+{
+	uint8_t page_data[NVMCTRL_PAGE_SIZE];
+
+	memset(page_data, 0xff, NVMCTRL_PAGE_SIZE);
+	settings_encode(page_data, SETTINGS_HEADER_KEY, gen);
+
+	settings_nvm_write_page(settings_address(bank, 0), page_data);
+
+}	// End of settings_write_header
+
+
+/****************************************************************************************
+Local function to count the keys in a mask
+*****************************************************************************************/
+static uint8_t settings_count(uint32_t mask)
+{
+	uint8_t count;
+
+	count = 0;
+	while (mask)
+	{
+		mask &= mask - 1;
+		count++;
+	}
+
+	return (count);
+
+}	// End of settings_count
+
+
+/****************************************************************************************
+Function to mount the settings store
+
+Reads are done here at boot, all writes are left to pm_settings_service(). An empty
+store is seeded with the MC3416 offsets from the EEPROM emulator, so the EEPROM
+emulator must be configured first
+*****************************************************************************************/
+void pm_settings_configure(void)
+{
+	struct nvm_config config;
+	enum status_code status;
+	uint8_t bank;
+	uint8_t key;
+	uint8_t version[2];
+	uint32_t gen[2];
+	bool bValid[2];
+	uint16_t x_offset;
+	uint16_t y_offset;
+	uint16_t z_offset;
+	uint16_t prom[EEPROM_PROM_WORDS];
+
+	// Manual page write, a page is only programmed by an explicit command
+	nvm_get_config_defaults(&config);
+	config.manual_page_write = true;
+	do
+	{
+		status = nvm_set_config(&config);
+	} while (status == STATUS_BUSY);
+
+	for (key = 0; key < SETTINGS_KEY_COUNT; key++)
+	{
+		values[key] = settings_table[key].default_value;
+	}
+
+	for (bank = 0; bank < 2; bank++)
+	{
+		bValid[bank] = settings_read_header(bank, &version[bank], &gen[bank]);
+	}
+
+	state = SETTINGS_STATE_IDLE;
+
+	if ((bValid[0] == false) && (bValid[1] == false))
+	{
+		pm_usart_send_pc_message("pm_settings_configure: Store is empty, have to format\r\n");
+
+		x_offset = 0;
+		y_offset = 0;
+		z_offset = 0;
+		eeprom_read_settings(&x_offset, &y_offset, &z_offset);
+		values[SETTINGS_KEY_MC3416_X_OFFSET] = x_offset;
+		values[SETTINGS_KEY_MC3416_Y_OFFSET] = y_offset;
+		values[SETTINGS_KEY_MC3416_Z_OFFSET] = z_offset;
+
+		// The MS5637 validates the PROM cache with its CRC
+		if (eeprom_read_ms5637_prom(prom) == STATUS_OK)
+		{
+			values[SETTINGS_KEY_MS5637_PROM_01] = prom[0] | ((uint32_t)prom[1] << 16);
+			values[SETTINGS_KEY_MS5637_PROM_23] = prom[2] | ((uint32_t)prom[3] << 16);
+			values[SETTINGS_KEY_MS5637_PROM_45] = prom[4] | ((uint32_t)prom[5] << 16);
+			values[SETTINGS_KEY_MS5637_PROM_6] = prom[6];
+		}
+
+		// Compact into bank 0
+		active_bank = 1;
+		generation = 0;
+		free_page = SETTINGS_BANK_PAGES;
+		bCompactPending = true;
+		dirty_mask = SETTINGS_ALL_KEYS;
+		dirty_start_ms = pm_timer_get_ms();
+
+		return;
+	}
+
+	if (bValid[0] && bValid[1])
+	{
+		active_bank = ((gen[1] - gen[0]) < 0x80000000ul) ? 1 : 0;
+	}
+	else
+	{
+		active_bank = (bValid[1]) ? 1 : 0;
+	}
+
+	generation = gen[active_bank];
+	settings_load_bank(active_bank);
+
+	dirty_mask = 0;
+	bCompactPending = false;
+	if (version[active_bank] != SETTINGS_SCHEMA_VERSION)
+	{
+		pm_usart_send_pc_message("pm_settings_configure: Schema version changed, have to compact\r\n");
+
+		bCompactPending = true;
+		dirty_mask = SETTINGS_ALL_KEYS;
+		dirty_start_ms = pm_timer_get_ms();
+	}
+
+}	// End of pm_settings_configure
+
+
+/****************************************************************************************
+Function to check the result of the last settings NVM operation once it is done
+
+Called before starting another NVM operation, which clears the error flags. Any
+failure rewrites everything
+Returns false while the NVM controller is still busy
+*****************************************************************************************/
+bool pm_settings_nvm_release(void)
+{
+	if (!nvm_is_ready())
+	{
+		return (false);
+	}
+
+	if (bNvmPending)
+	{
+		bNvmPending = false;
+
+		if (nvm_get_error() != NVM_ERROR_NONE)
+		{
+			pm_usart_send_pc_message("pm_settings_nvm_release: NVM error, have to compact\r\n");
+
+			state = SETTINGS_STATE_IDLE;
+			bCompactPending = true;
+			if (dirty_mask == 0)
+			{
+				dirty_start_ms = pm_timer_get_ms();
+			}
+			dirty_mask = SETTINGS_ALL_KEYS;
+		}
+	}
+
+	return (true);
+
+}	// End of pm_settings_nvm_release
+
+
+/****************************************************************************************
+Function to advance the settings store writes
+
+Called from the main loop. Starts at most one NVM operation per call and returns
+straight away if the NVM controller is still busy with the previous one
+*****************************************************************************************/
+void pm_settings_service(void)
+{
+	uint32_t written;
+
+	if (!pm_settings_nvm_release())
+	{
+		return;
+	}
+
+	switch (state)
+	{
+	case SETTINGS_STATE_IDLE:
+		if (dirty_mask == 0)
+		{
+			bFlush = false;
+			return;
+		}
+
+		// Batch changes made close together into one page
+		if ((bFlush == false) &&
+			(pm_timer_elapsed_ms(dirty_start_ms) < SETTINGS_COMMIT_DELAY_MS) &&
+			(settings_count(dirty_mask) < SETTINGS_RECORDS_PER_PAGE))
+		{
+			return;
+		}
+
+		if (bCompactPending || (free_page >= SETTINGS_BANK_PAGES))
+		{
+			erase_row = 0;
+			state = SETTINGS_STATE_ERASE;
+			return;
+		}
+
+		written = settings_write_records(active_bank, free_page, dirty_mask);
+		dirty_mask &= ~written;
+		free_page++;
+		break;
+
+	case SETTINGS_STATE_ERASE:
+		settings_nvm_erase_row(settings_address(active_bank ^ 1, erase_row * NVMCTRL_ROW_PAGES));
+
+		erase_row++;
+		if (erase_row >= SETTINGS_BANK_ROWS)
+		{
+			compact_page = 1;
+			compact_mask = SETTINGS_ALL_KEYS;
+			state = SETTINGS_STATE_COMPACT;
+		}
+		break;
+
+	case SETTINGS_STATE_COMPACT:
+		if (compact_mask)
+		{
+			// Keys changed after their page was written stay dirty for the new bank
+			written = settings_write_records(active_bank ^ 1, compact_page, compact_mask);
+			compact_mask &= ~written;
+			dirty_mask &= ~written;
+			compact_page++;
+		}
+		else
+		{
+			// Header last, the new bank only becomes valid once it is complete
+			generation++;
+			active_bank ^= 1;
+			settings_write_header(active_bank, generation);
+
+			free_page = compact_page;
+			bCompactPending = false;
+			state = SETTINGS_STATE_IDLE;
+		}
+		break;
+	}
+
+}	// End of pm_settings_service
+
+
+/****************************************************************************************
+Function to write all pending changes, waiting for the NVM controller
+
+Used before entering low power mode, the NVM clock changes with GCLK0
+*****************************************************************************************/
+void pm_settings_flush(void)
+{
+	bFlush = true;
+
+	while ((dirty_mask != 0) || (state != SETTINGS_STATE_IDLE))
+	{
+		pm_settings_service();
+	}
+
+	while (!nvm_is_ready())
+	{
+	}
+	pm_settings_service();
+
+}	// End of pm_settings_flush
+
+
+/****************************************************************************************
+Function to return a setting
+*****************************************************************************************/
+uint32_t pm_settings_get(enum settings_key key)
+{
+	if (key >= SETTINGS_KEY_COUNT)
+	{
+		return (0);
+	}
+
+	return (values[key]);
+
+}	// End of pm_settings_get
+
+
+/****************************************************************************************
+Function to change a setting
+
+Only RAM is updated, the record is written later by pm_settings_service()
+*****************************************************************************************/
+void pm_settings_set(enum settings_key key, uint32_t value)
+{
+	if (key >= SETTINGS_KEY_COUNT)
+	{
+		return;
+	}
+
+	if (values[key] == value)
+	{
+		return;
+	}
+
+	values[key] = value;
+
+	if (dirty_mask == 0)
+	{
+		dirty_start_ms = pm_timer_get_ms();
+	}
+	dirty_mask |= (1ul << key);
+
+}	// End of pm_settings_set
+
+
+/****************************************************************************************
+Function to change a setting by name
+Returns STATUS_ERR_INVALID_ARG for an unknown name and STATUS_ERR_BAD_DATA for a value
+outside the key's range
+*****************************************************************************************/
+enum status_code pm_settings_set_by_name(const char *name, uint32_t value)
+{
+	uint8_t key;
+
+	for (key = 0; key < SETTINGS_KEY_COUNT; key++)
+	{
+		if (strcmp(name, settings_table[key].name) == 0)
+		{
+			if ((value < settings_table[key].min_value) || (value > settings_table[key].max_value))
+			{
+				return (STATUS_ERR_BAD_DATA);
+			}
+
+			pm_settings_set((enum settings_key)key, value);
+
+			return (STATUS_OK);
+		}
+	}
+
+	return (STATUS_ERR_INVALID_ARG);
+
+}	// End of pm_settings_set_by_name
+
+
+/****************************************************************************************
+Function to send all the settings to the PC
+*****************************************************************************************/
+void pm_settings_report(void)
+{
+	char response[64];
+	uint8_t key;
+
+	for (key = 0; key < SETTINGS_KEY_COUNT; key++)
+	{
+		sprintf(response, "SETTING %s %lu\r\n", settings_table[key].name, (unsigned long)values[key]);
+		pm_usart_send_pc_message(response);
+	}
+
+}	// End of pm_settings_report
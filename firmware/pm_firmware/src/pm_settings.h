@@ -0,0 +1,52 @@
+/****************************************************************************************
+pm_settings.h: Include file for pm_settings.c
+
+Written by:
+	Daayim Asim, B.Eng.
+	Computer Engineer Student
+
+
+Date:
+	October 2022
+*****************************************************************************************/
+
+
+#ifndef PM_SETTINGS_H_
+#define PM_SETTINGS_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Bump when a key is added, removed or changes meaning, the store is rewritten
+// (compacted) under the new version the first time it is mounted
+#define SETTINGS_SCHEMA_VERSION 4
+
+// Keys are stored in flash, never renumber an existing key
+enum settings_key
+{
+	SETTINGS_KEY_MC3416_X_OFFSET = 0,
+	SETTINGS_KEY_MC3416_Y_OFFSET = 1,
+	SETTINGS_KEY_MC3416_Z_OFFSET = 2,
+	SETTINGS_KEY_BATTERY_CAPACITY = 3,	// mAh
+	SETTINGS_KEY_WAKE_PERIOD = 4,		// s
+	SETTINGS_KEY_LOG_PERIOD = 5,		// s, 0 disables the sample logger
+	SETTINGS_KEY_LEAK_THRESHOLD = 6,	// mV, 0 disables the leak monitor
+	SETTINGS_KEY_MS5637_PROM_01 = 7,	// PROM cache, word 1 in the upper half
+	SETTINGS_KEY_MS5637_PROM_23 = 8,
+	SETTINGS_KEY_MS5637_PROM_45 = 9,
+	SETTINGS_KEY_MS5637_PROM_6 = 10,
+	SETTINGS_KEY_COUNT
+};
+
+void pm_settings_configure(void);
+void pm_settings_service(void);
+void pm_settings_flush(void);
+bool pm_settings_nvm_release(void);
+
+uint32_t pm_settings_get(enum settings_key);
+void pm_settings_set(enum settings_key, uint32_t);
+enum status_code pm_settings_set_by_name(const char *, uint32_t);
+
+void pm_settings_report(void);
+
+#endif /* PM_SETTINGS_H_ */
@@ -11,6 +11,19 @@ Date:
 
 Note(s):
 - Main PM board is configured to be an SPI slave
+- Frames are PM_SPI_FRAME_LENGTH bytes, delimited by SPI1_SS0. The bytes are moved by
+	two DMA channels (PM_DMA_CHANNEL_SPI_RX and _TX), the next frame is armed from the
+	SERCOM interrupt at the end of each frame (slave select rising, TXC), so a master
+	that starts the next frame early is still received
+- Two receive frames are used in turn: one is armed while the main loop copies the
+	other (pm_spi_get_command). A frame that ends short is discarded and the slave
+	re-synchronizes on the next slave select
+- Two transmit frames are used in turn so the armed one is never written.
+	pm_spi_set_response() swaps in the new response if the armed frame has not
+	started (slave select low detect), otherwise it is sent one frame later and
+	counted as late
+- read_spi_stats sends "SPI_STATS <frames> <commands> <overruns> <resyncs> <late
+	responses> <frames/s> <max frames/s>", the rates are over one second windows
 
 ----------------------------------------------
 SAML21J18B
@@ -24,9 +37,14 @@ Pin		I/O		PM board pin	Function
 *****************************************************************************************/
 
 
+#include <sercom_interrupt.h>
 #include <spi.h>
-#include <spi_interrupt.h>
+#include <stdio.h>
+#include <string.h>
+#include <system_interrupt.h>
+#include "pm_dma.h"
 #include "pm_spi.h"
+#include "pm_timer.h"
 #include "pm_usart.h"
 #include "pm_config_codes.h"
 
@@ -35,28 +53,54 @@ Pin		I/O		PM board pin	Function
 Local variable(s)
 *****************************************************************************************/
 
-volatile bool transfer_complete = false;
 static struct spi_module spi_module_struct;
-	
+
+// Receive frames, rx_armed is being received
+static uint8_t rx_frames[2][PM_SPI_FRAME_LENGTH];
+static volatile bool bFrameReady[2] = {false, false};
+static volatile uint8_t rx_armed = 0;
+static volatile bool bFrameReceived = false;
+
+// Transmit frames, tx_latest is armed at the end of each frame
+static uint8_t tx_frames[2][PM_SPI_FRAME_LENGTH];
+static volatile uint8_t tx_latest = 0;
+static volatile uint8_t tx_armed = 0;
+
+// Started by pm_spi_start(), armed while the SERCOM is enabled
+static bool bStarted = false;
+static volatile bool bArmed = false;
+
+// Statistics
+static volatile uint32_t frames = 0;
+static volatile uint32_t overruns = 0;
+static volatile uint32_t resyncs = 0;
+static uint32_t commands = 0;
+static uint32_t late_responses = 0;
+static volatile uint32_t rate_start_ms = 0;
+static volatile uint32_t rate_frames = 0;
+static volatile uint32_t last_rate = 0;
+static volatile uint32_t max_rate = 0;
+
 
 /****************************************************************************************
 Local function(s)
 *****************************************************************************************/
 
-static void spi_slave_callback(struct spi_module *const);
+static enum status_code spi_arm(void);
+static void spi_restart(void);
+static void spi_frame_received(uint8_t, bool);
+static void spi_interrupt(uint8_t);
 
 
 /****************************************************************************************
-Function to configure the Main PM SPI
+Function to configure the Main PM SPI, frames are re-armed if they were started
 *****************************************************************************************/
 void pm_spi_configure(uint8_t mode)
 {
 	static bool bFirst = true;
 
-	//spi_slave_configure();
-	//spi_slave_callback_configure();
-
 	struct spi_config spi_config_struct;
+	struct pm_dma_channel_config dma_config_struct;
 
 	spi_get_config_defaults(&spi_config_struct);
 
@@ -64,6 +108,7 @@ void pm_spi_configure(uint8_t mode)
 	spi_config_struct.mode_specific.slave.preload_enable = true;
 	spi_config_struct.mode_specific.slave.frame_format = SPI_FRAME_FORMAT_SPI_FRAME;
 	spi_config_struct.mux_setting = SPI_SIGNAL_MUX_SETTING_E;
+	spi_config_struct.select_slave_low_detect_enable = true;
 
 	spi_config_struct.pinmux_pad0 = PINMUX_PB12C_SERCOM4_PAD0;
 	spi_config_struct.pinmux_pad1 = PINMUX_PB13C_SERCOM4_PAD1;
@@ -79,55 +124,295 @@ void pm_spi_configure(uint8_t mode)
 		spi_disable(&spi_module_struct);
 	}
 
+	bArmed = false;
+
+	// The DMA replaces one interrupt per byte
+	dma_config_struct.bHalfWord = false;
+	dma_config_struct.bRunInStandby = false;
+	dma_config_struct.cpu_ns_per_beat = pm_dma_interrupt_ns();
+
+	dma_config_struct.trigger = SERCOM4_DMAC_ID_RX;
+	dma_config_struct.bSourceIncrement = false;
+	dma_config_struct.bDestinationIncrement = true;
+	dma_config_struct.done = spi_frame_received;
+	pm_dma_configure(PM_DMA_CHANNEL_SPI_RX, &dma_config_struct);
+
+	dma_config_struct.trigger = SERCOM4_DMAC_ID_TX;
+	dma_config_struct.bSourceIncrement = true;
+	dma_config_struct.bDestinationIncrement = false;
+	dma_config_struct.done = NULL;
+	pm_dma_configure(PM_DMA_CHANNEL_SPI_TX, &dma_config_struct);
+
 	spi_init(&spi_module_struct, SERCOM4, &spi_config_struct);
 
-	spi_register_callback(&spi_module_struct, spi_slave_callback, SPI_CALLBACK_BUFFER_TRANSCEIVED);
-	spi_enable_callback(&spi_module_struct, SPI_CALLBACK_BUFFER_TRANSCEIVED);
+	// Only slave select rising (TXC) is handled here, not the ASF jobs
+	_sercom_set_handler(_sercom_get_sercom_inst_index(SERCOM4), spi_interrupt);
 
 	spi_enable(&spi_module_struct);
-	
+
 	if (mode == MODE_DISABLED){
 		pm_usart_send_pc_message("spi disabled!\r\n");
 		spi_disable(&spi_module_struct);
 	}
+	else if (bStarted)
+	{
+		// Re-arm with the last response after leaving low power
+		system_interrupt_enter_critical_section();
+		bArmed = (spi_arm() == STATUS_OK);
+		system_interrupt_leave_critical_section();
+	}
 
 }	// End of pm_spi_configure
 
 
 /****************************************************************************************
-Function to start an SPI read
+Function to arm the first frame, both transmit frames are set to response until the
+first pm_spi_set_response()
+*****************************************************************************************/
+enum status_code pm_spi_start(const char *response)
+{
+	enum status_code status;
+
+	memcpy(tx_frames[0], response, PM_SPI_FRAME_LENGTH);
+	memcpy(tx_frames[1], response, PM_SPI_FRAME_LENGTH);
+	tx_latest = 0;
+	bFrameReady[0] = false;
+	bFrameReady[1] = false;
+	rate_start_ms = pm_timer_get_ms();
+
+	system_interrupt_enter_critical_section();
+	status = spi_arm();
+	bStarted = (status == STATUS_OK);
+	bArmed = bStarted;
+	system_interrupt_leave_critical_section();
+
+	return (status);
+
+}	// End of pm_spi_start
+
+
+/****************************************************************************************
+Function to copy the oldest received frame, null terminated
+Returns false if there is none
+*****************************************************************************************/
+bool pm_spi_get_command(char *command)
+{
+	bool bReceived = false;
+	uint8_t frame;
+
+	system_interrupt_enter_critical_section();
+
+	// The frame not armed is the older one
+	frame = rx_armed ^ 1;
+	if (bFrameReady[frame] == false)
+	{
+		frame = rx_armed;
+	}
+
+	if (bFrameReady[frame])
+	{
+		memcpy(command, rx_frames[frame], PM_SPI_FRAME_LENGTH);
+		command[PM_SPI_FRAME_LENGTH] = '\0';
+		bFrameReady[frame] = false;
+		bReceived = true;
+		commands++;
+	}
+
+	system_interrupt_leave_critical_section();
+
+	return (bReceived);
+
+}	// End of pm_spi_get_command
+
+
+/****************************************************************************************
+Function to set the response sent in the next frame
+*****************************************************************************************/
+void pm_spi_set_response(const char *response)
+{
+	SercomSpi *const spi_hw = &(spi_module_struct.hw->SPI);
+	uint8_t frame;
+
+	system_interrupt_enter_critical_section();
+
+	frame = tx_armed ^ 1;
+	memcpy(tx_frames[frame], response, PM_SPI_FRAME_LENGTH);
+	tx_latest = frame;
+
+	if (bArmed)
+	{
+		if ((spi_hw->INTFLAG.reg & SPI_INTERRUPT_FLAG_SLAVE_SELECT_LOW) == 0)
+		{
+			spi_restart();
+		}
+		else
+		{
+			late_responses++;
+		}
+	}
+
+	system_interrupt_leave_critical_section();
+
+}	// End of pm_spi_set_response
+
+
+/****************************************************************************************
+Function to send the frame statistics to the PC
+*****************************************************************************************/
+void pm_spi_report(void)
+{
+	char response[96];
+	uint32_t rate;
+
+	// No frames for a whole window
+	rate = (pm_timer_elapsed_ms(rate_start_ms) < 2000ul) ? last_rate : 0;
+
+	sprintf(response, "SPI_STATS %lu %lu %lu %lu %lu %lu %lu\r\n",
+		(unsigned long)frames, (unsigned long)commands, (unsigned long)overruns, (unsigned long)resyncs,
+		(unsigned long)late_responses, (unsigned long)rate, (unsigned long)max_rate);
+	pm_usart_send_pc_message(response);
+
+}	// End of pm_spi_report
+
+
+/****************************************************************************************
+Local function to arm the next frame, called with the interrupts disabled and both
+channels stopped
 *****************************************************************************************/
-enum status_code pm_spi_start_read(uint8_t *tx_buffer, uint8_t *rx_buffer, int buffer_length)
+static enum status_code spi_arm(void)
 {
+	SercomSpi *const spi_hw = &(spi_module_struct.hw->SPI);
 	enum status_code status;
+	uint8_t frame;
+
+	// Use the frame not waiting for the main loop, or drop the older one
+	frame = rx_armed ^ 1;
+	if (bFrameReady[frame])
+	{
+		if (bFrameReady[rx_armed] == false)
+		{
+			frame = rx_armed;
+		}
+		else
+		{
+			bFrameReady[frame] = false;
+			overruns++;
+		}
+	}
 
-	transfer_complete = false;
+	rx_armed = frame;
+	tx_armed = tx_latest;
+	bFrameReceived = false;
 
-//	spi_read_buffer_job(&spi_module_struct, rx_buffer, buffer_length, 0x00);	
-	status = spi_transceive_buffer_job(&spi_module_struct, tx_buffer, rx_buffer, buffer_length);
+	// Bytes after the end of the last frame
+	while (spi_hw->INTFLAG.reg & SPI_INTERRUPT_FLAG_RX_COMPLETE)
+	{
+		(void)spi_hw->DATA.reg;
+	}
+	spi_hw->STATUS.reg = SERCOM_SPI_STATUS_BUFOVF;
+	spi_hw->INTFLAG.reg = SPI_INTERRUPT_FLAG_SLAVE_SELECT_LOW | SPI_INTERRUPT_FLAG_TX_COMPLETE | SPI_INTERRUPT_FLAG_COMBINED_ERROR;
+
+	status = pm_dma_start(PM_DMA_CHANNEL_SPI_RX, &spi_hw->DATA.reg, rx_frames[rx_armed], PM_SPI_FRAME_LENGTH);
+	if (status == STATUS_OK)
+	{
+		// Preloads the first bytes before slave select goes low
+		status = pm_dma_start(PM_DMA_CHANNEL_SPI_TX, tx_frames[tx_armed], &spi_hw->DATA.reg, PM_SPI_FRAME_LENGTH);
+	}
+
+	spi_hw->INTENSET.reg = SPI_INTERRUPT_FLAG_TX_COMPLETE;
 
 	return (status);
 
-}	// End of pm_spi_start_read
+}	// End of spi_arm
 
 
 /****************************************************************************************
-Function to return the transfer_complete variable
+Local function to stop the frame and arm it again. Re-enabling the SERCOM drops the
+bytes already preloaded by the transmit channel
 *****************************************************************************************/
-bool pm_spi_transfer_complete(void)
+static void spi_restart(void)
 {
-	return (transfer_complete);
-	
-}	// End of pm_spi_transfer_complete
+	pm_dma_abort(PM_DMA_CHANNEL_SPI_RX);
+	pm_dma_abort(PM_DMA_CHANNEL_SPI_TX);
+
+	spi_disable(&spi_module_struct);
+	spi_enable(&spi_module_struct);
+
+	spi_arm();
+
+}	// End of spi_restart
 
 
 /****************************************************************************************
-SPI slave callback function
+Local function called by the receive channel after the last byte of a frame
 *****************************************************************************************/
-static void spi_slave_callback(struct spi_module *const module)
+static void spi_frame_received(uint8_t channel, bool bError)
 {
-	transfer_complete = true;
+	uint32_t now_ms;
+	uint32_t window_ms;
+
+	// Only PM_DMA_CHANNEL_SPI_RX calls this
+	(void)channel;
 
-}	// End of spi_slave_callback
+	if (bError)
+	{
+		return;
+	}
+
+	bFrameReady[rx_armed] = true;
+	bFrameReceived = true;
+	frames++;
+
+	now_ms = pm_timer_get_ms();
+	window_ms = now_ms - rate_start_ms;
+	rate_frames++;
+	if (window_ms >= 1000ul)
+	{
+		last_rate = (rate_frames * 1000ul) / window_ms;
+		if (last_rate > max_rate)
+		{
+			max_rate = last_rate;
+		}
+		rate_frames = 0;
+		rate_start_ms = now_ms;
+	}
+
+}	// End of spi_frame_received
+
+
+/****************************************************************************************
+SERCOM4 interrupt handler for slave select going high, which arms the next frame
+*****************************************************************************************/
+static void spi_interrupt(uint8_t instance)
+{
+	SercomSpi *const spi_hw = &(spi_module_struct.hw->SPI);
+
+	// Only SERCOM4 is handled here
+	(void)instance;
+
+	if ((spi_hw->INTFLAG.reg & SPI_INTERRUPT_FLAG_TX_COMPLETE) == 0)
+	{
+		return;
+	}
+	spi_hw->INTFLAG.reg = SPI_INTERRUPT_FLAG_TX_COMPLETE;
+
+	if (bArmed == false)
+	{
+		return;
+	}
+
+	// Calls spi_frame_received() if the last byte came in with slave select
+	pm_dma_abort(PM_DMA_CHANNEL_SPI_RX);
+	pm_dma_abort(PM_DMA_CHANNEL_SPI_TX);
+
+	// Slave select went high part way through the frame
+	if (bFrameReceived == false)
+	{
+		resyncs++;
+		spi_disable(&spi_module_struct);
+		spi_enable(&spi_module_struct);
+	}
 
+	spi_arm();
 
+}	// End of spi_interrupt
@@ -15,9 +15,18 @@ Date:
 #define PM_SPI_H
 
 
+#include <stdbool.h>
+#include <stdint.h>
+#include <status_codes.h>
+
+// Bytes per command and per response, the master frames each with SPI1_SS0
+#define PM_SPI_FRAME_LENGTH			8
+
 void pm_spi_configure(uint8_t);
-enum status_code pm_spi_start_read(uint8_t *, uint8_t *, int);
-bool pm_spi_transfer_complete(void);
+enum status_code pm_spi_start(const char *);
+bool pm_spi_get_command(char *);
+void pm_spi_set_response(const char *);
+void pm_spi_report(void);
 
 
 #endif	// PM_SPI_H
@@ -0,0 +1,286 @@
+/****************************************************************************************
+pm_telemetry.c:   power module (PM) compressed telemetry functions
+
+Written by:
+	Daayim Asim, B.Eng.
+	Computer Engineer Student
+
+
+Date:
+	October 2022
+
+Note(s):
+- Log records are sent as frames of one zig-zag varint per field. A keyframe holds
+	the field values, a delta frame holds the difference from the previous record
+	sent, so slowly changing fields take one byte instead of two or four
+- Frame: 0xa5, 'K' or 'D', payload length, payload, CRC-8 (polynomial 0x07) of the
+	type, length and payload bytes. 0xa5 never appears in a text message, so the
+	host can find frames between lines and resynchronize on a bad CRC. The raw
+	records sent by log_dump can hold 0xa5, so log_dump is refused while the stream
+	is on, log_zdump is the dump for a host decoding frames
+- Every TELEMETRY_KEYFRAME_INTERVAL'th frame is a keyframe, so after a bad frame the
+	host drops deltas until the next keyframe
+- log_zdump sends blocks of up to LOG_DUMP_BLOCK_RECORDS records, each
+	"LOG_ZDUMP <first> <count> <bytes>\r\n" then the frames, then "LOG_END <next>\r\n".
+	A block is encoded into RAM before its header is sent, so each record is read
+	and encoded once. Deltas carry on across blocks
+- telemetry_stats reports the records, raw bytes, encoded bytes, compression ratio
+	and encode cycles per record for the last dump and for the live stream
+*****************************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include "pm_crc.h"
+#include "pm_logger.h"
+#include "pm_telemetry.h"
+#include "pm_timer.h"
+#include "pm_usart.h"
+
+
+/****************************************************************************************
+Local variable(s)
+*****************************************************************************************/
+
+static struct pm_telemetry_encoder dump_encoder;
+static struct pm_telemetry_encoder stream_encoder;
+
+static bool bStreamEnabled = false;
+
+
+/****************************************************************************************
+Local function(s)
+*****************************************************************************************/
+
+static void telemetry_reset(struct pm_telemetry_encoder *);
+static uint8_t telemetry_put_varint(uint8_t *, int32_t);
+static uint8_t telemetry_encode(struct pm_telemetry_encoder *, const struct pm_log_record *, uint8_t *);
+static void telemetry_report_encoder(const char *, const struct pm_telemetry_encoder *);
+
+
+/****************************************************************************************
+Local function to reset an encoder so the next frame is a keyframe
+*****************************************************************************************/
+static void telemetry_reset(struct pm_telemetry_encoder *encoder)
+{
+	memset(encoder, 0, sizeof(struct pm_telemetry_encoder));
+
+}	// End of telemetry_reset
+
+
+/****************************************************************************************
+Local function to write a zig-zag varint, 7 bits per byte, least significant first
+Returns the number of bytes written (1 to 5)
+*****************************************************************************************/
+static uint8_t telemetry_put_varint(uint8_t *buffer, int32_t value)
+{
+	uint32_t zigzag;
+	uint8_t length;
+
+	// Small negative numbers become small positive ones: 0, -1, 1, -2 -> 0, 1, 2, 3
+	zigzag = ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+
+	length = 0;
+	while (zigzag >= 0x80)
+	{
+		buffer[length++] = (uint8_t)(zigzag | 0x80);
+		zigzag >>= 7;
+	}
+	buffer[length++] = (uint8_t)zigzag;
+
+	return (length);
+
+}	// End of telemetry_put_varint
+
+
+/****************************************************************************************
+Local function to encode a record as a frame
+Returns the frame length, at most TELEMETRY_MAX_FRAME
+*****************************************************************************************/
+static uint8_t telemetry_encode(struct pm_telemetry_encoder *encoder, const struct pm_log_record *record, uint8_t *frame)
+{
+	uint32_t values[TELEMETRY_CHANNELS];
+	uint32_t start;
+	uint8_t length;
+	uint8_t channel;
+
+	start = pm_timer_get_cycles();
+
+	// Signed fields are sign extended so their deltas stay small
+	values[0] = record->sequence;
+	values[1] = record->timestamp_ms;
+	values[2] = record->leak_mv;
+	values[3] = record->battery_mv;
+	values[4] = (uint32_t)(int32_t)record->battery_ma;
+	values[5] = (uint32_t)(int32_t)record->ltc2944_temperature;
+	values[6] = record->charge_mah;
+	values[7] = record->pressure;
+	values[8] = (uint32_t)(int32_t)record->ms5637_temperature;
+	values[9] = (uint32_t)(int32_t)record->tilt;
+	values[10] = record->power_bits;
+	values[11] = record->status_bits;
+	values[12] = record->flags;
+
+	// A keyframe is a delta from zero
+	if (encoder->frame_count == 0)
+	{
+		memset(encoder->previous, 0, sizeof(encoder->previous));
+		frame[1] = TELEMETRY_TYPE_KEYFRAME;
+	}
+	else
+	{
+		frame[1] = TELEMETRY_TYPE_DELTA;
+	}
+	if (++encoder->frame_count >= TELEMETRY_KEYFRAME_INTERVAL)
+	{
+		encoder->frame_count = 0;
+	}
+
+	length = 3;
+	for (channel = 0; channel < TELEMETRY_CHANNELS; channel++)
+	{
+		length += telemetry_put_varint(&frame[length], (int32_t)(values[channel] - encoder->previous[channel]));
+		encoder->previous[channel] = values[channel];
+	}
+
+	frame[0] = TELEMETRY_SYNC;
+	frame[2] = length - 3;
+	frame[length] = pm_crc8(&frame[1], length - 1);
+	length++;
+
+	encoder->records++;
+	encoder->raw_bytes += sizeof(struct pm_log_record);
+	encoder->encoded_bytes += length;
+	encoder->cycles += pm_timer_get_cycles() - start;
+
+	return (length);
+
+}	// End of telemetry_encode
+
+
+/****************************************************************************************
+Local function to send the statistics of an encoder to the PC
+*****************************************************************************************/
+static void telemetry_report_encoder(const char *name, const struct pm_telemetry_encoder *encoder)
+{
+	char response[128];
+	uint32_t ratio;
+	uint32_t cycles;
+
+	// Ratio in hundredths, raw size over encoded size
+	ratio = 0;
+	cycles = 0;
+	if (encoder->records != 0)
+	{
+		ratio = (uint32_t)(((uint64_t)encoder->raw_bytes * 100ull) / encoder->encoded_bytes);
+		cycles = encoder->cycles / encoder->records;
+	}
+
+	sprintf(response, "TELEMETRY %s %lu %lu %lu %lu.%02lu %lu\r\n", name,
+		(unsigned long)encoder->records, (unsigned long)encoder->raw_bytes, (unsigned long)encoder->encoded_bytes,
+		(unsigned long)(ratio / 100), (unsigned long)(ratio % 100), (unsigned long)cycles);
+	pm_usart_send_pc_message(response);
+
+}	// End of telemetry_report_encoder
+
+
+/****************************************************************************************
+Function to send the records from first to last (inclusive) as compressed frames
+
+The range is clipped to the records still in the log
+*****************************************************************************************/
+void pm_telemetry_dump(uint32_t first, uint32_t last)
+{
+	struct pm_log_record records[LOG_DUMP_BLOCK_RECORDS];
+	uint8_t frames[LOG_DUMP_BLOCK_RECORDS * TELEMETRY_MAX_FRAME];
+	char response[64];
+	uint32_t sequence;
+	uint32_t block_first;
+	uint32_t end;
+	uint16_t bytes;
+	uint8_t count;
+	uint8_t i;
+
+	end = (pm_logger_range(&first, &last) != 0) ? last + 1 : first;
+
+	telemetry_reset(&dump_encoder);
+	sequence = first;
+	do
+	{
+		block_first = sequence;
+		count = pm_logger_read_block(&sequence, end, records);
+
+		bytes = 0;
+		for (i = 0; i < count; i++)
+		{
+			bytes += telemetry_encode(&dump_encoder, &records[i], &frames[bytes]);
+		}
+
+		if ((count != 0) || (block_first == first))
+		{
+			sprintf(response, "LOG_ZDUMP %lu %u %u\r\n", (unsigned long)block_first, (unsigned int)count,
+				(unsigned int)bytes);
+			pm_usart_send_pc_message(response);
+			if (bytes != 0)
+			{
+				pm_usart_send_pc_data(frames, bytes);
+			}
+		}
+	} while (sequence < end);
+
+	sprintf(response, "LOG_END %lu\r\n", (unsigned long)end);
+	pm_usart_send_pc_message(response);
+
+}	// End of pm_telemetry_dump
+
+
+/****************************************************************************************
+Function to turn the live telemetry stream on or off
+
+The stream restarts with a keyframe
+*****************************************************************************************/
+void pm_telemetry_stream_enable(bool bEnable)
+{
+	bStreamEnabled = bEnable;
+	telemetry_reset(&stream_encoder);
+
+}	// End of pm_telemetry_stream_enable
+
+
+/****************************************************************************************
+Function to return true while the live telemetry stream is on
+*****************************************************************************************/
+bool pm_telemetry_stream_enabled(void)
+{
+	return (bStreamEnabled);
+
+}	// End of pm_telemetry_stream_enabled
+
+
+/****************************************************************************************
+Function to send a new log record as a compressed frame when the stream is on
+*****************************************************************************************/
+void pm_telemetry_stream(const struct pm_log_record *record)
+{
+	uint8_t frame[TELEMETRY_MAX_FRAME];
+	uint8_t length;
+
+	if (bStreamEnabled == false)
+	{
+		return;
+	}
+
+	length = telemetry_encode(&stream_encoder, record, frame);
+	pm_usart_send_pc_data(frame, length);
+
+}	// End of pm_telemetry_stream
+
+
+/****************************************************************************************
+Function to send the compression statistics to the PC
+*****************************************************************************************/
+void pm_telemetry_report(void)
+{
+	telemetry_report_encoder("DUMP", &dump_encoder);
+	telemetry_report_encoder("STREAM", &stream_encoder);
+
+}	// End of pm_telemetry_report
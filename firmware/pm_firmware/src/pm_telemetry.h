@@ -0,0 +1,54 @@
+/****************************************************************************************
+pm_telemetry.h: Include file for pm_telemetry.c
+
+Written by:
+	Daayim Asim, B.Eng.
+	Computer Engineer Student
+
+
+Date:
+	October 2022
+*****************************************************************************************/
+
+
+#ifndef PM_TELEMETRY_H_
+#define PM_TELEMETRY_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "pm_logger.h"
+
+// Frame layout: sync, type, payload length, payload, CRC-8 of type, length and payload
+#define TELEMETRY_SYNC					0xa5
+#define TELEMETRY_TYPE_KEYFRAME			'K'
+#define TELEMETRY_TYPE_DELTA			'D'
+
+// One zig-zag varint per pm_log_record field, sequence to flags
+#define TELEMETRY_CHANNELS				13
+#define TELEMETRY_MAX_PAYLOAD			(TELEMETRY_CHANNELS * 5)
+#define TELEMETRY_MAX_FRAME				(TELEMETRY_MAX_PAYLOAD + 4)
+
+// A keyframe is sent every TELEMETRY_KEYFRAME_INTERVAL frames
+#define TELEMETRY_KEYFRAME_INTERVAL		16
+
+struct pm_telemetry_encoder
+{
+	uint32_t previous[TELEMETRY_CHANNELS];
+	uint8_t frame_count;
+
+	// Statistics since the last reset
+	uint32_t records;
+	uint32_t raw_bytes;
+	uint32_t encoded_bytes;
+	uint32_t cycles;
+};
+
+void pm_telemetry_dump(uint32_t, uint32_t);
+
+void pm_telemetry_stream_enable(bool);
+bool pm_telemetry_stream_enabled(void);
+void pm_telemetry_stream(const struct pm_log_record *);
+
+void pm_telemetry_report(void);
+
+#endif /* PM_TELEMETRY_H_ */
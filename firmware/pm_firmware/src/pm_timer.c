@@ -1,59 +1,161 @@
- /****************************************************************************************
-pm_mc3416.c:   power management (PM) Timer functions
+/****************************************************************************************
+pm_timer.c:   power management (PM) Timer functions
 
 Written by:
 	Daayim Asim, B.Eng.
 	Computer Engineer Student
-	 
+
 
 Date:
 	October 2022
 
 Note(s):
-- Timer usesd for pm_run wakeup length
+- TC2 provides a free running millisecond tick used to timestamp events and to
+	measure elapsed time without blocking (delay_ms() owns SysTick)
+- TC0 is still used by pm_run for the 30 s wakeup length
+- The tick is derived from GCLK generator 0, so it is only valid in normal power
+	mode and does not advance while the MCU is in standby. pm_run adds the time
+	spent in standby, measured by the RTC, with pm_timer_add_ms()
 *****************************************************************************************/
 
-#include "pm_timer.h"
+#include <clock.h>
+#include <system_interrupt.h>
 #include <tc.h>
 #include <tc_interrupt.h>
+#include "pm_timer.h"
+
+
+/****************************************************************************************
+Local variable(s)
+*****************************************************************************************/
+
+static struct tc_module timer_module_struct;
+
+// Milliseconds since the timer was first configured
+static volatile uint32_t milliseconds = 0;
+
+// CPU cycles per millisecond and per counter tick
+static uint32_t cycles_per_ms = 12000;
+static const uint32_t cycles_per_tick = 16;
+
+
+/****************************************************************************************
+Local function(s)
+*****************************************************************************************/
+
+static void timer_tick_callback(struct tc_module *const);
+
+
+/****************************************************************************************
+Function to configure the TC2 millisecond tick
+
+Must be called after the clocks are configured since the compare value is
+calculated from the GCLK generator 0 frequency
+*****************************************************************************************/
+void pm_timer_configure(void)
+{
+	static bool bFirst = true;
+
+	struct tc_config tc_config_struct;
+	uint32_t ticks_per_ms;
+
+	tc_get_config_defaults(&tc_config_struct);
+
+	// 12 MHz / 16 = 750 kHz, so the counter wraps at 750 counts every millisecond
+	ticks_per_ms = system_gclk_gen_get_hz(GCLK_GENERATOR_0) / 16ul / 1000ul;
+	if (ticks_per_ms == 0)
+	{
+		ticks_per_ms = 1;
+	}
+	cycles_per_ms = ticks_per_ms * cycles_per_tick;
+
+	tc_config_struct.counter_size = TC_COUNTER_SIZE_16BIT;
+	tc_config_struct.clock_source = GCLK_GENERATOR_0;
+	tc_config_struct.clock_prescaler = TC_CLOCK_PRESCALER_DIV16;
+	tc_config_struct.wave_generation = TC_WAVE_GENERATION_MATCH_FREQ;
+	tc_config_struct.counter_16_bit.compare_capture_channel[0] = (uint16_t)(ticks_per_ms - 1);
+
+	if (bFirst)
+	{
+		bFirst = false;
+	}
+	else
+	{
+		tc_disable(&timer_module_struct);
+	}
+
+	tc_init(&timer_module_struct, TC2, &tc_config_struct);
+	tc_enable(&timer_module_struct);
+
+	tc_register_callback(&timer_module_struct, timer_tick_callback, TC_CALLBACK_OVERFLOW);
+	tc_enable_callback(&timer_module_struct, TC_CALLBACK_OVERFLOW);
 
+}	// End of pm_timer_configure
 
-#define CONF_TC_MODULE TC0
-struct tc_module tc_instance;
-volatile static bool timer_0_elapsed = false;
 
-/***************************************************************************
-Local functions to configure TC for real time MC3416 measurements
-****************************************************************************/
+/****************************************************************************************
+Function to return the number of milliseconds since the timer was configured
+*****************************************************************************************/
+uint32_t pm_timer_get_ms(void)
+{
+	return (milliseconds);
+
+}	// End of pm_timer_get_ms
+
 
-void pm_timer_tc_callback_to_sleep(
-struct tc_module *const module_inst)
+/****************************************************************************************
+Function to return the number of milliseconds elapsed since a pm_timer_get_ms() value
+*****************************************************************************************/
+uint32_t pm_timer_elapsed_ms(uint32_t since)
 {
-	tc_set_count_value(&tc_instance, 0xFFFAA22C);
-	timer_0_elapsed = true;
-}
-
-
-void pm_timer_config(void){
-	
-	//Timer Configuration for MC3416
-	struct tc_config config_tc;
-	tc_get_config_defaults(&config_tc);
-	config_tc.counter_size = TC_COUNTER_SIZE_32BIT;
-	config_tc.clock_source = GCLK_GENERATOR_0;
-	config_tc.clock_prescaler = TC_CLOCK_PRESCALER_DIV1024;
-	
-	//	Delay  = 30s
-	// 	Find number of cycles required to get given time delay
-	// 	Desired Time/(prescaler/system clk frequency) = #cycles.
-	//	30s/(1024/12000000) = 351563 cycles.
-	// 	Subtract from max value to get number of clk cycles to load in timer; 2^32 - 351700 ? 0xFFFAA22C
-	config_tc.counter_32_bit.value = 0xFFFAA22C;
-	tc_init(&tc_instance, CONF_TC_MODULE, &config_tc);
-	tc_enable(&tc_instance);
-	
-	tc_register_callback(&tc_instance, tc_callback_to_read_mc3416,
-	TC_CALLBACK_OVERFLOW);
-	tc_enable_callback(&tc_instance, TC_CALLBACK_OVERFLOW);
-	
-}
\ No newline at end of file
+	return (milliseconds - since);
+
+}	// End of pm_timer_elapsed_ms
+
+
+/****************************************************************************************
+Function to move the millisecond count on by time the tick did not see
+*****************************************************************************************/
+void pm_timer_add_ms(uint32_t ms)
+{
+	// The tick interrupt also writes the count
+	system_interrupt_enter_critical_section();
+	milliseconds += ms;
+	system_interrupt_leave_critical_section();
+
+}	// End of pm_timer_add_ms
+
+
+/****************************************************************************************
+Function to return a cycle count with a resolution of 16 CPU cycles
+
+For measuring short code sections, wraps about every 6 minutes at 12 MHz
+*****************************************************************************************/
+uint32_t pm_timer_get_cycles(void)
+{
+	uint32_t ms;
+	uint32_t count;
+
+	// Read again if the tick interrupt ran in between
+	do
+	{
+		ms = milliseconds;
+		count = tc_get_count_value(&timer_module_struct);
+	} while (ms != milliseconds);
+
+	return (ms * cycles_per_ms + count * cycles_per_tick);
+
+}	// End of pm_timer_get_cycles
+
+
+/****************************************************************************************
+TC2 overflow callback function
+*****************************************************************************************/
+static void timer_tick_callback(struct tc_module *const module)
+{
+	// The ASF callback type has the module, there is only the one
+	(void)module;
+
+	milliseconds++;
+
+}	// End of timer_tick_callback
@@ -13,8 +13,13 @@ Date:
 #ifndef PM_TIMER_H_
 #define PM_TIMER_H_
 
-void pm_timer_config(void);
+#include <stdint.h>
 
-void pm_timer_tc_callback_to_sleep(struct tc_module *const module_inst);
+void pm_timer_configure(void);
 
-#endif /* PM_TIMER_H_ */
\ No newline at end of file
+uint32_t pm_timer_get_ms(void);
+uint32_t pm_timer_elapsed_ms(uint32_t);
+void pm_timer_add_ms(uint32_t);
+uint32_t pm_timer_get_cycles(void);
+
+#endif /* PM_TIMER_H_ */
@@ -20,13 +20,44 @@ Pin		I/O		PM board pin	Function
 41		PA20	BATT_RX			SERCOM5/PAD[2]
 43		PA22	USB_TX			SERCOM3/PAD[0]
 44		PA23	USB_RX			SERCOM3/PAD[1]
+
+- Both ports start at PM_USART_DEFAULT_BAUD. set_baud switches the PC port: the PM
+	answers "BAUD_ACK <rate>" (or "BAUD_NAK <rate>") at the old rate, switches, and
+	waits PM_USART_BAUD_TIMEOUT_MS for "baud_ping", answered with "BAUD_OK <rate>".
+	Without the ping it goes back to the old rate and sends "BAUD_FALLBACK <rate>"
+- A framing error on the PC port at another rate means the host has gone back to
+	the default rate (e.g. it was restarted), so the port returns to the default
+- A rate is supported if the SERCOM baud generator error at the normal mode clock is
+	within PM_USART_MAX_BAUD_ERROR_PPM. The USARTs are off in low power mode
+- Messages and data for the PC are copied into a PM_USART_PC_TX_QUEUE_LENGTH byte
+	queue and sent by the DMA (PM_DMA_CHANNEL_PC_TX), so the caller only waits when
+	the queue is full. The queue is emptied before the port is reconfigured or
+	disabled. From an interrupt, bytes that do not fit are dropped
+- The VBS port (SERCOM5) has no DMA trigger on the L21 and is still written byte by
+	byte. Without pm_dma_init() the PC port is too
+- read_dma_stats also sends "PC_TX_QUEUE <length> <peak bytes> <full waits> <dropped
+	bytes>"
+- The PC port receives into a PM_USART_PC_RX_BUFFER_LENGTH byte ring from the SERCOM3
+	interrupt, so the host can send the next requests while one is being handled.
+	pm_usart_get_pc_command() returns one complete line per call and never waits. A
+	line that is too long, or that lost bytes to a full ring, is dropped
+- Between pm_usart_frame_begin() and pm_usart_frame_end() every line sent with
+	pm_usart_send_pc_message() starts with "@<sequence> " (see pm.c). Binary data and
+	messages sent from an interrupt are not prefixed
+- read_link_stats sends "PC_RX <length> <peak bytes> <overflows> <dropped lines>"
 *****************************************************************************************/
 
 
+#include <sercom_interrupt.h>
+#include <stdio.h>
 #include <string.h>
+#include <system_interrupt.h>
 #include <usart.h>
 #include "pm_usart.h"
+#include "pm_clocks.h"
 #include "pm_config_codes.h"
+#include "pm_dma.h"
+#include "pm_timer.h"
 
 
 /****************************************************************************************
@@ -38,12 +69,60 @@ static struct usart_module vbs_usart_module_struct;
 
 static SercomUsart *pc_usart_hw;
 
+static uint32_t pc_baudrate = PM_USART_DEFAULT_BAUD;
+static uint32_t vbs_baudrate = PM_USART_DEFAULT_BAUD;
+
+// Rates offered by set_baud and set_vbs_baud
+static const uint32_t supported_baudrates[] = {9600, 19200, 38400, 57600, 115200, 230400, 460800};
+
+// PC transmit queue, the DMA sends pc_tx_sending bytes from pc_tx_tail
+static uint8_t pc_tx_queue[PM_USART_PC_TX_QUEUE_LENGTH];
+static volatile uint16_t pc_tx_head = 0;
+static volatile uint16_t pc_tx_tail = 0;
+static volatile uint16_t pc_tx_sending = 0;
+static bool bPcTxDma = false;
+
+static uint16_t pc_tx_peak = 0;
+static uint32_t pc_tx_full_waits = 0;
+static uint32_t pc_tx_dropped = 0;
+
+// PC receive ring, written by the SERCOM3 interrupt
+static volatile uint8_t pc_rx_buffer[PM_USART_PC_RX_BUFFER_LENGTH];
+static volatile uint16_t pc_rx_head = 0;
+static volatile uint16_t pc_rx_tail = 0;
+static volatile bool bPcRxOverflow = false;
+static volatile bool bPcRxFramingError = false;
+
+static volatile uint16_t pc_rx_peak = 0;
+static volatile uint32_t pc_rx_overflows = 0;
+static uint32_t pc_rx_dropped_lines = 0;
+
+// Line being put together by pm_usart_get_pc_command()
+static char pc_line[PM_USART_PC_LINE_LENGTH];
+static uint16_t pc_line_length = 0;
+static bool bPcLineTooLong = false;
+
+// Framed response, "@<sequence> " in front of each line
+static char pc_frame_prefix[8];
+static bool bPcFrame = false;
+static bool bPcFrameLineStart = true;
+
 /****************************************************************************************
 // Local function(s)
 *****************************************************************************************/
 
 static void pc_usart_configure(uint8_t mode);
 static void vbs_usart_configure(uint8_t mode);
+static int32_t usart_baud_error_ppm(uint32_t, uint32_t);
+static bool usart_baud_supported(uint32_t);
+static void usart_wait_for_pc_transmit(void);
+static bool usart_wait_for_pc_line(char *, int, uint32_t);
+static void usart_pc_tx_start(void);
+static void usart_pc_tx_done(uint8_t, bool);
+static void usart_pc_tx_write(const uint8_t *, uint16_t);
+static void usart_pc_tx_flush(void);
+static void usart_pc_rx_interrupt(uint8_t instance);
+static bool usart_pc_rx_read(uint8_t *);
 
 
 /****************************************************************************************
@@ -54,10 +133,11 @@ static void pc_usart_configure(uint8_t mode)
 	static bool bFirst = true;
 
 	struct usart_config usart_config_struct;
+	struct pm_dma_channel_config dma_config_struct;
 
 	usart_get_config_defaults(&usart_config_struct);
 
-	usart_config_struct.baudrate                               = 38400;
+	usart_config_struct.baudrate                               = pc_baudrate;
 	usart_config_struct.mux_setting                            = USART_RX_1_TX_0_XCK_1;
 	usart_config_struct.pinmux_pad0                            = PINMUX_PA22C_SERCOM3_PAD0;
 	usart_config_struct.pinmux_pad1                            = PINMUX_PA23C_SERCOM3_PAD1;
@@ -71,20 +151,46 @@ static void pc_usart_configure(uint8_t mode)
 	}
 	else
 	{
+		// Not after low power mode, the port is already off
+		if (bPcTxDma)
+		{
+			usart_wait_for_pc_transmit();
+		}
 		usart_disable(&pc_usart_module_struct);
 	}	
 	
 	
 	usart_init(&pc_usart_module_struct, SERCOM3, &usart_config_struct);
 	usart_enable(&pc_usart_module_struct);
+
+	// Get a pointer to the hardware module instance
+	pc_usart_hw = &((&pc_usart_module_struct)->hw->USART);
+
+	// Without the DMA the CPU waits about 10 bit times per byte
+	dma_config_struct.trigger = SERCOM3_DMAC_ID_TX;
+	dma_config_struct.bHalfWord = false;
+	dma_config_struct.bSourceIncrement = true;
+	dma_config_struct.bDestinationIncrement = false;
+	dma_config_struct.bRunInStandby = false;
+	dma_config_struct.cpu_ns_per_beat = (1000000000ul / pc_baudrate) * 10ul;
+	dma_config_struct.done = usart_pc_tx_done;
+
+	bPcTxDma = (pm_dma_configure(PM_DMA_CHANNEL_PC_TX, &dma_config_struct) == STATUS_OK);
 	
 	if (mode == MODE_DISABLED){
 		pm_usart_send_pc_message("pc usart disabled!\r\n");
+		usart_wait_for_pc_transmit();
+		bPcTxDma = false;
+		pc_usart_hw->INTENCLR.reg = SERCOM_USART_INTENCLR_RXC;
 		usart_disable(&pc_usart_module_struct);
 	}
-
-	// Get a pointer to the hardware module instance
-	pc_usart_hw = &((&pc_usart_module_struct)->hw->USART);
+	else
+	{
+		// Bytes already in the ring were received before the change and are kept
+		_sercom_set_handler(_sercom_get_sercom_inst_index(SERCOM3), usart_pc_rx_interrupt);
+		pc_usart_hw->INTENSET.reg = SERCOM_USART_INTENSET_RXC;
+		system_interrupt_enable(_sercom_get_interrupt_vector(SERCOM3));
+	}
 
 }	// End of pc_usart_configure
 
@@ -94,8 +200,8 @@ Function to check for a command from the control computer
 ****************************************************************************/
 enum status_code pm_usart_check_for_pc_command(void)
 {
-	// Check if USART has new data
-	if (pc_usart_hw->INTFLAG.reg & SERCOM_USART_INTFLAG_RXC)
+	// Check if the ring has new data
+	if ((pc_rx_head != pc_rx_tail) || bPcRxFramingError)
 	{
 		return STATUS_OK;
 	}
@@ -124,92 +230,72 @@ void pm_usart_disable(void)
 
 
 /***************************************************************************
-Function to wait for a command from the control computer
+Function to take the next command line from the receive ring, without the
+"\r\n". Returns false until a whole line has been received
 ****************************************************************************/
 bool pm_usart_get_pc_command(char *command, int command_length)
 {
-	enum status_code retval;
-	int i;
-	uint16_t received_data;
-	bool bCommandReceived;
+	uint8_t received_data;
 
-	i = 0;
-	received_data = 0;
-	bCommandReceived = false;
-	while (1)
+	// The host has gone back to the default rate
+	if (bPcRxFramingError)
 	{
-		retval = usart_read_wait(&pc_usart_module_struct, &received_data);
-		if (retval == STATUS_OK)
+		bPcRxFramingError = false;
+		pc_line_length = 0;
+		bPcLineTooLong = false;
+
+		if (pc_baudrate != PM_USART_DEFAULT_BAUD)
 		{
-			if (received_data == '\n')
-			{
-				if (bCommandReceived)
-				{
-					break;
-				}
-				else
-				{
-					continue;
-				}
-			}
+			pc_baudrate = PM_USART_DEFAULT_BAUD;
+			pc_usart_configure(MODE_ENABLED);
+		}
 
-			command[i++] = (char)received_data;
-			if (received_data == '\r')
-			{
-				command[i-1] = '\0';
-				bCommandReceived = true;
-				continue;
-			}
-			if (i == command_length)
-			{
-				// Null terminate the string
-				command[i-1] = '\0';
+		return (false);
+	}
 
-				bCommandReceived = false;
-				break;
-			}
-		}
-		else if (retval == STATUS_BUSY)
+	while (usart_pc_rx_read(&received_data))
+	{
+		if (received_data == '\r')
 		{
 			continue;
 		}
-		else
+
+		if (received_data != '\n')
 		{
-			if (retval == STATUS_ERR_BAD_FORMAT)
-			{
-				sprintf(command, "usart_read_wait STATUS_ERR_BAD_FORMAT!\r\n");
-			}
-			else if (retval == STATUS_ERR_OVERFLOW)
-			{
-				sprintf(command, "usart_read_wait STATUS_ERR_OVERFLOW!\r\n");
-			}
-			else if (retval == STATUS_ERR_BAD_DATA)
-			{
-				sprintf(command, "usart_read_wait STATUS_ERR_BAD_DATA!\r\n");
-			}
-			else if (retval == STATUS_ERR_DENIED)
+			if (pc_line_length < sizeof(pc_line) - 1)
 			{
-				sprintf(command, "usart_read_wait STATUS_ERR_DENIED!\r\n");
-			}
-			else if (retval == STATUS_ERR_PROTOCOL)
-			{
-				sprintf(command, "usart_read_wait STATUS_ERR_PROTOCOL!\r\n");
-			}
-			else if (retval == STATUS_ERR_PACKET_COLLISION)
-			{
-				sprintf(command, "usart_read_wait STATUS_ERR_PACKET_COLLISION!\r\n");
+				pc_line[pc_line_length++] = (char)received_data;
 			}
 			else
 			{
-				sprintf(command, "usart_read_wait UNKNOWN!\r\n");
+				bPcLineTooLong = true;
 			}
+			continue;
+		}
 
-			bCommandReceived = false;
-			break;
+		// A whole line, unless bytes were lost while it was received
+		if (bPcRxOverflow || bPcLineTooLong || (pc_line_length >= command_length))
+		{
+			bPcRxOverflow = false;
+			bPcLineTooLong = false;
+			pc_line_length = 0;
+			pc_rx_dropped_lines++;
+			continue;
 		}
+
+		if (pc_line_length == 0)
+		{
+			continue;
+		}
+
+		memcpy(command, pc_line, pc_line_length);
+		command[pc_line_length] = '\0';
+		pc_line_length = 0;
+
+		return (true);
 	}
 
-	return (bCommandReceived);
+	return (false);
 
 }	// End of pm_usart_get_pc_command
 
@@ -219,11 +305,74 @@ Function to send a message to the control computer
 ****************************************************************************/
 void pm_usart_send_pc_message(const char *message)
 {
-	usart_write_buffer_wait(&pc_usart_module_struct, (uint8_t *)message, strlen(message));
+	const char *end;
+	uint16_t length;
+
+	if ((bPcFrame == false) || (__get_IPSR() != 0))
+	{
+		usart_pc_tx_write((const uint8_t *)message, strlen(message));
+		return;
+	}
+
+	// A message may hold several lines, or end part way through one
+	while (*message != '\0')
+	{
+		if (bPcFrameLineStart)
+		{
+			usart_pc_tx_write((const uint8_t *)pc_frame_prefix, strlen(pc_frame_prefix));
+			bPcFrameLineStart = false;
+		}
+
+		end = strchr(message, '\n');
+		length = (end == NULL) ? strlen(message) : (uint16_t)(end - message + 1);
+		usart_pc_tx_write((const uint8_t *)message, length);
+
+		bPcFrameLineStart = (end != NULL);
+		message += length;
+	}
 
 }	// End of pm_usart_send_pc_message
 
 
+/***************************************************************************
+Function to start a framed response, each following line is sent with the
+sequence number of the request in front
+****************************************************************************/
+void pm_usart_frame_begin(uint16_t sequence)
+{
+	sprintf(pc_frame_prefix, "@%u ", sequence);
+	bPcFrame = true;
+	bPcFrameLineStart = true;
+
+}	// End of pm_usart_frame_begin
+
+
+/***************************************************************************
+Function to end a framed response, finishing a line left open
+****************************************************************************/
+void pm_usart_frame_end(void)
+{
+	if (bPcFrameLineStart == false)
+	{
+		usart_pc_tx_write((const uint8_t *)"\r\n", 2);
+	}
+
+	bPcFrame = false;
+	bPcFrameLineStart = true;
+
+}	// End of pm_usart_frame_end
+
+
+/***************************************************************************
+Function to send a block of binary data to the control computer
+****************************************************************************/
+void pm_usart_send_pc_data(const uint8_t *data, uint16_t length)
+{
+	usart_pc_tx_write(data, length);
+
+}	// End of pm_usart_send_pc_data
+
+
 /***************************************************************************
 Function to send a command to the VBS
 ****************************************************************************/
@@ -245,7 +394,7 @@ static void vbs_usart_configure(uint8_t mode)
 
 	usart_get_config_defaults(&usart_config_struct);
 
-	usart_config_struct.baudrate                               = 38400;
+	usart_config_struct.baudrate                               = vbs_baudrate;
 	usart_config_struct.mux_setting                            = USART_RX_2_TX_0_XCK_1;
 	usart_config_struct.pinmux_pad0                            = PINMUX_PB16C_SERCOM5_PAD0;
 	usart_config_struct.pinmux_pad1                            = PINMUX_UNUSED;
@@ -278,3 +427,446 @@ static void vbs_usart_configure(uint8_t mode)
 }	// End of vbs_usart_configure
 
 
+/****************************************************************************************
+Local function to calculate the baud rate error of the SERCOM baud generator in
+ppm, or -1 if the rate cannot be generated from the clock
+*****************************************************************************************/
+static int32_t usart_baud_error_ppm(uint32_t clock_hz, uint32_t baudrate)
+{
+	uint16_t baud_value;
+	uint64_t actual;
+	int64_t error;
+
+	// Same calculation as usart_init() with the default 16x oversampling
+	if (_sercom_get_async_baud_val(baudrate, clock_hz, &baud_value,
+		SERCOM_ASYNC_OPERATION_MODE_ARITHMETIC, SERCOM_ASYNC_SAMPLE_NUM_16) != STATUS_OK)
+	{
+		return (-1);
+	}
+
+	// f(baud) = f(ref) / 16 * (1 - BAUD / 65536)
+	actual = ((uint64_t)clock_hz * (65536ull - baud_value)) / (16ull * 65536ull);
+	error = ((int64_t)actual - (int64_t)baudrate) * 1000000ll / (int64_t)baudrate;
+
+	return ((int32_t)((error < 0) ? -error : error));
+
+}	// End of usart_baud_error_ppm
+
+
+/****************************************************************************************
+Local function to check that a rate is offered and accurate enough at the normal
+mode clock
+*****************************************************************************************/
+static bool usart_baud_supported(uint32_t baudrate)
+{
+	uint8_t i;
+	int32_t error;
+
+	for (i = 0; i < sizeof(supported_baudrates) / sizeof(supported_baudrates[0]); i++)
+	{
+		if (supported_baudrates[i] == baudrate)
+		{
+			error = usart_baud_error_ppm(pm_clocks_get_hz(MODE_NORMALPOWER), baudrate);
+
+			return ((error >= 0) && (error <= PM_USART_MAX_BAUD_ERROR_PPM));
+		}
+	}
+
+	return (false);
+
+}	// End of usart_baud_supported
+
+
+/****************************************************************************************
+Local function to wait until the queue is empty and the last byte sent to the control
+computer has left the shift register, so the port can be reconfigured
+*****************************************************************************************/
+static void usart_wait_for_pc_transmit(void)
+{
+	uint32_t start;
+
+	usart_pc_tx_flush();
+
+	start = pm_timer_get_ms();
+	while ((pc_usart_hw->INTFLAG.reg & SERCOM_USART_INTFLAG_TXC) == 0)
+	{
+		if (pm_timer_elapsed_ms(start) > 10)
+		{
+			break;
+		}
+	}
+
+}	// End of usart_wait_for_pc_transmit
+
+
+/****************************************************************************************
+Local function to read a line from the control computer, without the "\r\n"
+Returns false on a timeout or a receive error
+*****************************************************************************************/
+static bool usart_wait_for_pc_line(char *line, int line_length, uint32_t timeout_ms)
+{
+	uint32_t start;
+	uint8_t received_data;
+	int i;
+
+	i = 0;
+	start = pm_timer_get_ms();
+	while (pm_timer_elapsed_ms(start) < timeout_ms)
+	{
+		if (bPcRxFramingError)
+		{
+			bPcRxFramingError = false;
+			return (false);
+		}
+
+		if (usart_pc_rx_read(&received_data) == false)
+		{
+			continue;
+		}
+
+		if (received_data == '\n')
+		{
+			line[i] = '\0';
+			return (true);
+		}
+		if ((received_data != '\r') && (i < line_length - 1))
+		{
+			line[i++] = (char)received_data;
+		}
+	}
+
+	return (false);
+
+}	// End of usart_wait_for_pc_line
+
+
+/****************************************************************************************
+Local function to start the DMA on the queued bytes up to the end of the queue, called
+with the interrupts disabled
+*****************************************************************************************/
+static void usart_pc_tx_start(void)
+{
+	uint16_t head;
+	uint16_t tail;
+
+	head = pc_tx_head;
+	tail = pc_tx_tail;
+	if ((pc_tx_sending > 0) || (head == tail))
+	{
+		return;
+	}
+
+	pc_tx_sending = (head > tail) ? head - tail : PM_USART_PC_TX_QUEUE_LENGTH - tail;
+	if (pm_dma_start(PM_DMA_CHANNEL_PC_TX, &pc_tx_queue[tail], &pc_usart_hw->DATA.reg, pc_tx_sending) != STATUS_OK)
+	{
+		pc_tx_sending = 0;
+	}
+
+}	// End of usart_pc_tx_start
+
+
+/****************************************************************************************
+Local function called from the DMA interrupt when the bytes being sent have been
+written to the USART
+*****************************************************************************************/
+static void usart_pc_tx_done(uint8_t channel, bool bError)
+{
+	// Only PM_DMA_CHANNEL_PC_TX calls this, a block that failed is not sent again
+	(void)channel;
+	(void)bError;
+
+	pc_tx_tail = (pc_tx_tail + pc_tx_sending) % PM_USART_PC_TX_QUEUE_LENGTH;
+	pc_tx_sending = 0;
+
+	usart_pc_tx_start();
+
+}	// End of usart_pc_tx_done
+
+
+/****************************************************************************************
+Local function to copy bytes into the PC transmit queue, waiting while it is full
+*****************************************************************************************/
+static void usart_pc_tx_write(const uint8_t *data, uint16_t length)
+{
+	bool bInterrupt;
+	bool bWaited = false;
+	uint16_t head;
+	uint16_t used;
+	uint16_t space;
+	uint16_t n;
+
+	if (bPcTxDma == false)
+	{
+		usart_write_buffer_wait(&pc_usart_module_struct, data, length);
+		return;
+	}
+
+	// The DMA interrupt cannot empty the queue under another interrupt
+	bInterrupt = (__get_IPSR() != 0);
+
+	while (length > 0)
+	{
+		head = pc_tx_head;
+		used = (head + PM_USART_PC_TX_QUEUE_LENGTH - pc_tx_tail) % PM_USART_PC_TX_QUEUE_LENGTH;
+		space = PM_USART_PC_TX_QUEUE_LENGTH - 1 - used;
+		if (space == 0)
+		{
+			if (bInterrupt)
+			{
+				pc_tx_dropped += length;
+				return;
+			}
+			if (bWaited == false)
+			{
+				bWaited = true;
+				pc_tx_full_waits++;
+			}
+
+			system_interrupt_enter_critical_section();
+			usart_pc_tx_start();
+			system_interrupt_leave_critical_section();
+			continue;
+		}
+
+		// Only the bytes from head are written here, the DMA reads from tail
+		n = PM_USART_PC_TX_QUEUE_LENGTH - head;
+		n = (n < space) ? n : space;
+		n = (n < length) ? n : length;
+		memcpy(&pc_tx_queue[head], data, n);
+
+		if (used + n > pc_tx_peak)
+		{
+			pc_tx_peak = used + n;
+		}
+
+		system_interrupt_enter_critical_section();
+		pc_tx_head = (head + n) % PM_USART_PC_TX_QUEUE_LENGTH;
+		usart_pc_tx_start();
+		system_interrupt_leave_critical_section();
+
+		data += n;
+		length -= n;
+	}
+
+}	// End of usart_pc_tx_write
+
+
+/****************************************************************************************
+Local function to wait until the PC transmit queue is empty. A queue the DMA does not
+empty within its time at the current rate is dropped
+*****************************************************************************************/
+static void usart_pc_tx_flush(void)
+{
+	uint32_t start;
+	uint32_t timeout_ms;
+
+	if (bPcTxDma == false)
+	{
+		return;
+	}
+
+	timeout_ms = 10ul + (PM_USART_PC_TX_QUEUE_LENGTH * 10000ul) / pc_baudrate;
+	start = pm_timer_get_ms();
+	while (pc_tx_head != pc_tx_tail)
+	{
+		if (pm_timer_elapsed_ms(start) > timeout_ms)
+		{
+			system_interrupt_enter_critical_section();
+			pm_dma_abort(PM_DMA_CHANNEL_PC_TX);
+			pc_tx_dropped += (pc_tx_head + PM_USART_PC_TX_QUEUE_LENGTH - pc_tx_tail) % PM_USART_PC_TX_QUEUE_LENGTH;
+			pc_tx_tail = pc_tx_head;
+			pc_tx_sending = 0;
+			system_interrupt_leave_critical_section();
+			break;
+		}
+	}
+
+}	// End of usart_pc_tx_flush
+
+
+/****************************************************************************************
+Local function to handle the SERCOM3 (PC) receive interrupt, moving the received bytes
+into the ring. A framing error is left for the main loop to act on
+*****************************************************************************************/
+static void usart_pc_rx_interrupt(uint8_t instance)
+{
+	uint16_t next;
+	uint16_t used;
+	uint16_t status;
+	uint8_t data;
+
+	// Only SERCOM3 is handled here
+	(void)instance;
+
+	while (pc_usart_hw->INTFLAG.reg & SERCOM_USART_INTFLAG_RXC)
+	{
+		status = pc_usart_hw->STATUS.reg;
+		if (status & SERCOM_USART_STATUS_FERR)
+		{
+			bPcRxFramingError = true;
+		}
+		if (status & SERCOM_USART_STATUS_BUFOVF)
+		{
+			bPcRxOverflow = true;
+			pc_rx_overflows++;
+		}
+		pc_usart_hw->STATUS.reg = status & (SERCOM_USART_STATUS_FERR | SERCOM_USART_STATUS_BUFOVF |
+			SERCOM_USART_STATUS_PERR);
+
+		// Reading the data clears the interrupt flag
+		data = (uint8_t)pc_usart_hw->DATA.reg;
+
+		next = (pc_rx_head + 1) % PM_USART_PC_RX_BUFFER_LENGTH;
+		if (next == pc_rx_tail)
+		{
+			bPcRxOverflow = true;
+			pc_rx_overflows++;
+			continue;
+		}
+
+		pc_rx_buffer[pc_rx_head] = data;
+		pc_rx_head = next;
+
+		used = (next + PM_USART_PC_RX_BUFFER_LENGTH - pc_rx_tail) % PM_USART_PC_RX_BUFFER_LENGTH;
+		if (used > pc_rx_peak)
+		{
+			pc_rx_peak = used;
+		}
+	}
+
+}	// End of usart_pc_rx_interrupt
+
+
+/****************************************************************************************
+Local function to read the next byte from the PC receive ring
+Returns false if it is empty
+*****************************************************************************************/
+static bool usart_pc_rx_read(uint8_t *data)
+{
+	if (pc_rx_tail == pc_rx_head)
+	{
+		return (false);
+	}
+
+	*data = pc_rx_buffer[pc_rx_tail];
+	pc_rx_tail = (pc_rx_tail + 1) % PM_USART_PC_RX_BUFFER_LENGTH;
+
+	return (true);
+
+}	// End of usart_pc_rx_read
+
+
+/****************************************************************************************
+Function to switch the control computer port to a new baud rate
+
+Returns true if the control computer confirmed the new rate
+*****************************************************************************************/
+bool pm_usart_set_pc_baud(uint32_t baudrate)
+{
+	char response[64];
+	char line[16];
+	uint32_t previous_baudrate;
+
+	if (usart_baud_supported(baudrate) == false)
+	{
+		sprintf(response, "BAUD_NAK %lu\r\n", (unsigned long)baudrate);
+		pm_usart_send_pc_message(response);
+		return (false);
+	}
+
+	sprintf(response, "BAUD_ACK %lu\r\n", (unsigned long)baudrate);
+	pm_usart_send_pc_message(response);
+	usart_wait_for_pc_transmit();
+
+	previous_baudrate = pc_baudrate;
+	pc_baudrate = baudrate;
+	pc_usart_configure(MODE_ENABLED);
+
+	if (usart_wait_for_pc_line(line, sizeof(line), PM_USART_BAUD_TIMEOUT_MS) && (strcmp(line, "baud_ping") == 0))
+	{
+		sprintf(response, "BAUD_OK %lu\r\n", (unsigned long)baudrate);
+		pm_usart_send_pc_message(response);
+		return (true);
+	}
+
+	pc_baudrate = previous_baudrate;
+	pc_usart_configure(MODE_ENABLED);
+
+	sprintf(response, "BAUD_FALLBACK %lu\r\n", (unsigned long)pc_baudrate);
+	pm_usart_send_pc_message(response);
+
+	return (false);
+
+}	// End of pm_usart_set_pc_baud
+
+
+/****************************************************************************************
+Function to switch the VBS port to a new baud rate
+
+The VBS has no handshake, it must already be set to the new rate
+*****************************************************************************************/
+enum status_code pm_usart_set_vbs_baud(uint32_t baudrate)
+{
+	if (usart_baud_supported(baudrate) == false)
+	{
+		return (STATUS_ERR_BAUDRATE_UNAVAILABLE);
+	}
+
+	vbs_baudrate = baudrate;
+	vbs_usart_configure(MODE_ENABLED);
+
+	return (STATUS_OK);
+
+}	// End of pm_usart_set_vbs_baud
+
+
+/****************************************************************************************
+Function to send the port rates and the baud rate error of each offered rate in
+both clock modes to the control computer ("-1" if the rate cannot be generated)
+*****************************************************************************************/
+void pm_usart_report_baud(void)
+{
+	char response[96];
+	uint8_t i;
+
+	sprintf(response, "BAUD PC %lu VBS %lu\r\n", (unsigned long)pc_baudrate, (unsigned long)vbs_baudrate);
+	pm_usart_send_pc_message(response);
+
+	for (i = 0; i < sizeof(supported_baudrates) / sizeof(supported_baudrates[0]); i++)
+	{
+		sprintf(response, "BAUD_RATE %lu %ld %ld %s\r\n", (unsigned long)supported_baudrates[i],
+			(long)usart_baud_error_ppm(pm_clocks_get_hz(MODE_NORMALPOWER), supported_baudrates[i]),
+			(long)usart_baud_error_ppm(pm_clocks_get_hz(MODE_LOWPOWER), supported_baudrates[i]),
+			usart_baud_supported(supported_baudrates[i]) ? "OK" : "NO");
+		pm_usart_send_pc_message(response);
+	}
+
+}	// End of pm_usart_report_baud
+
+
+/****************************************************************************************
+Function to send the PC transmit queue statistics to the PC
+*****************************************************************************************/
+void pm_usart_report_queue(void)
+{
+	char response[64];
+
+	sprintf(response, "PC_TX_QUEUE %u %u %lu %lu\r\n", PM_USART_PC_TX_QUEUE_LENGTH, pc_tx_peak,
+		(unsigned long)pc_tx_full_waits, (unsigned long)pc_tx_dropped);
+	pm_usart_send_pc_message(response);
+
+}	// End of pm_usart_report_queue
+
+
+/****************************************************************************************
+Function to send the PC receive ring statistics to the PC
+*****************************************************************************************/
+void pm_usart_report_rx(void)
+{
+	char response[64];
+
+	sprintf(response, "PC_RX %u %u %lu %lu\r\n", PM_USART_PC_RX_BUFFER_LENGTH, pc_rx_peak,
+		(unsigned long)pc_rx_overflows, (unsigned long)pc_rx_dropped_lines);
+	pm_usart_send_pc_message(response);
+
+}	// End of pm_usart_report_rx
@@ -16,6 +16,28 @@ Date:
 
 
 #include <stdbool.h>
+#include <stdint.h>
+#include <status_codes.h>
+
+
+// Rate used at reset, and by the host before it negotiates
+#define PM_USART_DEFAULT_BAUD			38400ul
+
+// Time the PM waits for "baud_ping" at the new rate
+#define PM_USART_BAUD_TIMEOUT_MS		1000ul
+
+// Largest baud generator error accepted, the receiver tolerates a few percent in total
+#define PM_USART_MAX_BAUD_ERROR_PPM		10000l
+
+// Bytes waiting for the PC port, a log dump record or a telemetry frame fits many times
+#define PM_USART_PC_TX_QUEUE_LENGTH		512
+
+// Bytes received from the PC and not yet handled, the host keeps its outstanding
+// requests within this
+#define PM_USART_PC_RX_BUFFER_LENGTH	512
+
+// Longest command line, room for a batch of framed commands
+#define PM_USART_PC_LINE_LENGTH			256
 
 
 enum status_code pm_usart_check_for_pc_command(void);
@@ -25,9 +47,18 @@ void pm_usart_disable(void);
 
 bool pm_usart_get_pc_command(char *, int);
 
+void pm_usart_send_pc_data(const uint8_t *, uint16_t);
 void pm_usart_send_pc_message(const char *);
+void pm_usart_frame_begin(uint16_t);
+void pm_usart_frame_end(void);
 void pm_usart_send_vbs_command(const char *);
 
+void pm_usart_report_baud(void);
+void pm_usart_report_queue(void);
+void pm_usart_report_rx(void);
+bool pm_usart_set_pc_baud(uint32_t);
+enum status_code pm_usart_set_vbs_baud(uint32_t);
+
 
 #endif	// PM_USART_H
 
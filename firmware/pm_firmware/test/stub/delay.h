@@ -0,0 +1,30 @@
+/****************************************************************************************
+delay.h: Stand-in for the ASF delay header, for the host tests
+
+Written by:
+	Daayim Asim, B.Eng.
+	Computer Engineer Student
+
+
+Date:
+	November 2022
+*****************************************************************************************/
+
+
+#ifndef DELAY_H_INCLUDED
+#define DELAY_H_INCLUDED
+
+#include <stdint.h>
+
+static inline void delay_us(uint32_t us)
+{
+	(void)us;
+}
+
+static inline void delay_ms(uint32_t ms)
+{
+	(void)ms;
+}
+
+
+#endif	// DELAY_H_INCLUDED
@@ -0,0 +1,168 @@
+/****************************************************************************************
+port.h: Stand-in for the ASF PORT driver header, for the host tests
+
+Written by:
+	Daayim Asim, B.Eng.
+	Computer Engineer Student
+
+
+Date:
+	November 2022
+
+Note(s):
+- The PORT registers are a plain structure the test defines (fake_port), with the pin
+	numbers of a SAML21 (PA00 to PA31 are 0 to 31, PB00 to PB31 are 32 to 63)
+- Setting a pin level changes OUT, reading one reads OUT or IN. Writes to OUTSET and
+	OUTCLR are only stored, so the test can see what was written
+*****************************************************************************************/
+
+
+#ifndef PORT_H_INCLUDED
+#define PORT_H_INCLUDED
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define PIN_PA02	2
+#define PIN_PA10	10
+#define PIN_PA11	11
+#define PIN_PA12	12
+#define PIN_PA13	13
+#define PIN_PA18	18
+#define PIN_PA19	19
+#define PIN_PA21	21
+#define PIN_PA23	23
+#define PIN_PA24	24
+#define PIN_PA25	25
+#define PIN_PB00	32
+#define PIN_PB01	33
+#define PIN_PB02	34
+#define PIN_PB03	35
+#define PIN_PB10	42
+#define PIN_PB11	43
+#define PIN_PB13	45
+#define PIN_PB17	49
+#define PIN_PB22	54
+#define PIN_PB30	62
+#define PIN_PB31	63
+
+#define MUX_PA02B_ADC_AIN0	1
+
+struct port_register
+{
+	uint32_t reg;
+};
+
+typedef struct
+{
+	struct port_register IN;
+	struct port_register OUT;
+	struct port_register OUTCLR;
+	struct port_register OUTSET;
+} PortGroup;
+
+typedef struct
+{
+	PortGroup Group[2];
+} Port;
+
+extern Port fake_port;
+
+#define PORT	(&fake_port)
+
+enum port_pin_dir
+{
+	PORT_PIN_DIR_INPUT,
+	PORT_PIN_DIR_OUTPUT,
+	PORT_PIN_DIR_OUTPUT_WTH_READBACK
+};
+
+enum port_pin_pull
+{
+	PORT_PIN_PULL_NONE,
+	PORT_PIN_PULL_UP,
+	PORT_PIN_PULL_DOWN
+};
+
+struct port_config
+{
+	enum port_pin_dir direction;
+	enum port_pin_pull input_pull;
+	bool powersave;
+};
+
+enum system_pinmux_pin_dir
+{
+	SYSTEM_PINMUX_PIN_DIR_INPUT,
+	SYSTEM_PINMUX_PIN_DIR_OUTPUT,
+	SYSTEM_PINMUX_PIN_DIR_OUTPUT_WITH_READBACK
+};
+
+enum system_pinmux_pin_pull
+{
+	SYSTEM_PINMUX_PIN_PULL_NONE,
+	SYSTEM_PINMUX_PIN_PULL_UP,
+	SYSTEM_PINMUX_PIN_PULL_DOWN
+};
+
+#define SYSTEM_PINMUX_GPIO	(1 << 7)
+
+struct system_pinmux_config
+{
+	uint8_t mux_position;
+	enum system_pinmux_pin_dir direction;
+	enum system_pinmux_pin_pull input_pull;
+	bool powersave;
+};
+
+static inline void port_get_config_defaults(struct port_config *config)
+{
+	config->direction = PORT_PIN_DIR_INPUT;
+	config->input_pull = PORT_PIN_PULL_UP;
+	config->powersave = false;
+}
+
+static inline void port_pin_set_config(uint8_t pin, const struct port_config *config)
+{
+	(void)pin;
+	(void)config;
+}
+
+static inline bool port_pin_get_input_level(uint8_t pin)
+{
+	return ((fake_port.Group[pin / 32].IN.reg & (1ul << (pin % 32))) != 0);
+}
+
+static inline bool port_pin_get_output_level(uint8_t pin)
+{
+	return ((fake_port.Group[pin / 32].OUT.reg & (1ul << (pin % 32))) != 0);
+}
+
+static inline void port_pin_set_output_level(uint8_t pin, bool level)
+{
+	if (level)
+	{
+		fake_port.Group[pin / 32].OUT.reg |= 1ul << (pin % 32);
+	}
+	else
+	{
+		fake_port.Group[pin / 32].OUT.reg &= ~(1ul << (pin % 32));
+	}
+}
+
+static inline void system_pinmux_get_config_defaults(struct system_pinmux_config *config)
+{
+	config->mux_position = SYSTEM_PINMUX_GPIO;
+	config->direction = SYSTEM_PINMUX_PIN_DIR_INPUT;
+	config->input_pull = SYSTEM_PINMUX_PIN_PULL_UP;
+	config->powersave = false;
+}
+
+static inline void system_pinmux_pin_set_config(uint8_t pin, const struct system_pinmux_config *config)
+{
+	(void)pin;
+	(void)config;
+}
+
+
+#endif	// PORT_H_INCLUDED
@@ -0,0 +1,98 @@
+/****************************************************************************************
+sercom.h: Stand-in for the ASF SERCOM header and SERCOM registers, for the host tests
+
+Written by:
+	Daayim Asim, B.Eng.
+	Computer Engineer Student
+
+
+Date:
+	November 2022
+
+Note(s):
+- Sercom only has the SPI and USART registers the PM modules read and write, the
+	interrupt and status bits have their SAML21 bit positions
+- _sercom_get_async_baud_val is the ASF arithmetic mode calculation
+*****************************************************************************************/
+
+
+#ifndef SERCOM_H_INCLUDED
+#define SERCOM_H_INCLUDED
+
+#include <stdint.h>
+#include <status_codes.h>
+#include <system_interrupt.h>
+
+#define SERCOM_USART_INTFLAG_TXC		(1u << 1)
+#define SERCOM_USART_INTFLAG_RXC		(1u << 2)
+#define SERCOM_USART_INTENSET_RXC		(1u << 2)
+#define SERCOM_USART_INTENCLR_RXC		(1u << 2)
+#define SERCOM_USART_STATUS_PERR		(1u << 0)
+#define SERCOM_USART_STATUS_FERR		(1u << 1)
+#define SERCOM_USART_STATUS_BUFOVF		(1u << 2)
+
+struct sercom_register
+{
+	uint32_t reg;
+};
+
+typedef struct
+{
+	struct sercom_register INTENSET;
+	struct sercom_register INTFLAG;
+	struct sercom_register STATUS;
+	struct sercom_register DATA;
+} SercomSpi;
+
+typedef struct
+{
+	struct sercom_register INTENCLR;
+	struct sercom_register INTENSET;
+	struct sercom_register INTFLAG;
+	struct sercom_register STATUS;
+	struct sercom_register DATA;
+} SercomUsart;
+
+typedef union
+{
+	SercomSpi SPI;
+	SercomUsart USART;
+} Sercom;
+
+enum sercom_asynchronous_operation_mode
+{
+	SERCOM_ASYNC_OPERATION_MODE_ARITHMETIC = 0,
+	SERCOM_ASYNC_OPERATION_MODE_FRACTIONAL
+};
+
+enum sercom_asynchronous_sample_num
+{
+	SERCOM_ASYNC_SAMPLE_NUM_8 = 8,
+	SERCOM_ASYNC_SAMPLE_NUM_16 = 16
+};
+
+static inline enum system_interrupt_vector _sercom_get_interrupt_vector(Sercom *const sercom_instance)
+{
+	(void)sercom_instance;
+	return (SYSTEM_INTERRUPT_MODULE_SERCOM);
+}
+
+static inline enum status_code _sercom_get_async_baud_val(const uint32_t baudrate,
+	const uint32_t peripheral_clock, uint16_t *const baudval,
+	enum sercom_asynchronous_operation_mode mode, enum sercom_asynchronous_sample_num sample_num)
+{
+	uint64_t ratio;
+
+	(void)mode;
+	if (((uint64_t)baudrate * sample_num) > peripheral_clock)
+	{
+		return (STATUS_ERR_BAUDRATE_UNAVAILABLE);
+	}
+
+	ratio = (((uint64_t)sample_num * baudrate) << 32) / peripheral_clock;
+	*baudval = (uint16_t)((65536ull * ((1ull << 32) - ratio)) >> 32);
+	return (STATUS_OK);
+}
+
+
+#endif	// SERCOM_H_INCLUDED
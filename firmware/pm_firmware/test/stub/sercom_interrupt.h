@@ -0,0 +1,41 @@
+/****************************************************************************************
+sercom_interrupt.h: Stand-in for the ASF SERCOM interrupt header, for the host tests
+
+Written by:
+	Daayim Asim, B.Eng.
+	Computer Engineer Student
+
+
+Date:
+	November 2022
+
+Note(s):
+- The handler set for a SERCOM is kept in fake_sercom_handler, the test calls it as
+	the interrupt would
+*****************************************************************************************/
+
+
+#ifndef SERCOM_INTERRUPT_H_INCLUDED
+#define SERCOM_INTERRUPT_H_INCLUDED
+
+#include <sercom.h>
+#include <stdint.h>
+
+typedef void (*sercom_handler_t)(uint8_t);
+
+extern sercom_handler_t fake_sercom_handler;
+
+static inline uint8_t _sercom_get_sercom_inst_index(Sercom *const sercom_instance)
+{
+	(void)sercom_instance;
+	return (4);
+}
+
+static inline void _sercom_set_handler(const uint8_t instance, const sercom_handler_t interrupt_handler)
+{
+	(void)instance;
+	fake_sercom_handler = interrupt_handler;
+}
+
+
+#endif	// SERCOM_INTERRUPT_H_INCLUDED
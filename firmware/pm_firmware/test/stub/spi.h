@@ -0,0 +1,121 @@
+/****************************************************************************************
+spi.h: Stand-in for the ASF SERCOM SPI driver header, for the host tests
+
+Written by:
+	Daayim Asim, B.Eng.
+	Computer Engineer Student
+
+
+Date:
+	November 2022
+
+Note(s):
+- SERCOM4 is a plain structure the test defines (fake_sercom4), with the registers
+	from stub/sercom.h. The interrupt flags have their SAML21 bit positions
+- spi_init only records the SERCOM, spi_enable and spi_disable count the calls
+*****************************************************************************************/
+
+
+#ifndef SPI_H_INCLUDED
+#define SPI_H_INCLUDED
+
+#include <sercom.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <status_codes.h>
+
+#define SPI_INTERRUPT_FLAG_TX_COMPLETE			(1u << 1)
+#define SPI_INTERRUPT_FLAG_RX_COMPLETE			(1u << 2)
+#define SPI_INTERRUPT_FLAG_SLAVE_SELECT_LOW		(1u << 3)
+#define SPI_INTERRUPT_FLAG_COMBINED_ERROR		(1u << 7)
+
+#define SERCOM_SPI_STATUS_BUFOVF				(1u << 2)
+
+#define SERCOM4_DMAC_ID_RX		0x0f
+#define SERCOM4_DMAC_ID_TX		0x10
+
+#define PINMUX_PB12C_SERCOM4_PAD0	0x002c0002
+#define PINMUX_PB13C_SERCOM4_PAD1	0x002d0002
+#define PINMUX_PB14C_SERCOM4_PAD2	0x002e0002
+#define PINMUX_PB15C_SERCOM4_PAD3	0x002f0002
+
+extern Sercom fake_sercom4;
+extern int fake_spi_enables;
+extern int fake_spi_disables;
+
+#define SERCOM4	(&fake_sercom4)
+
+enum spi_mode
+{
+	SPI_MODE_MASTER,
+	SPI_MODE_SLAVE
+};
+
+enum spi_frame_format
+{
+	SPI_FRAME_FORMAT_SPI_FRAME,
+	SPI_FRAME_FORMAT_SPI_FRAME_ADDR
+};
+
+enum spi_signal_mux_setting
+{
+	SPI_SIGNAL_MUX_SETTING_A,
+	SPI_SIGNAL_MUX_SETTING_E = 4
+};
+
+struct spi_slave_config
+{
+	enum spi_frame_format frame_format;
+	bool preload_enable;
+};
+
+struct spi_config
+{
+	enum spi_mode mode;
+	enum spi_signal_mux_setting mux_setting;
+	bool select_slave_low_detect_enable;
+	union
+	{
+		struct spi_slave_config slave;
+	} mode_specific;
+	uint32_t pinmux_pad0;
+	uint32_t pinmux_pad1;
+	uint32_t pinmux_pad2;
+	uint32_t pinmux_pad3;
+};
+
+struct spi_module
+{
+	Sercom *hw;
+};
+
+static inline void spi_get_config_defaults(struct spi_config *config)
+{
+	config->mode = SPI_MODE_MASTER;
+	config->mux_setting = SPI_SIGNAL_MUX_SETTING_A;
+	config->select_slave_low_detect_enable = false;
+	config->mode_specific.slave.frame_format = SPI_FRAME_FORMAT_SPI_FRAME;
+	config->mode_specific.slave.preload_enable = false;
+}
+
+static inline enum status_code spi_init(struct spi_module *module, Sercom *hw, const struct spi_config *config)
+{
+	(void)config;
+	module->hw = hw;
+	return (STATUS_OK);
+}
+
+static inline void spi_enable(struct spi_module *module)
+{
+	(void)module;
+	fake_spi_enables++;
+}
+
+static inline void spi_disable(struct spi_module *module)
+{
+	(void)module;
+	fake_spi_disables++;
+}
+
+
+#endif	// SPI_H_INCLUDED
@@ -0,0 +1,58 @@
+/****************************************************************************************
+system_interrupt.h: Stand-in for the ASF system interrupt header, for the host tests
+
+Written by:
+	Daayim Asim, B.Eng.
+	Computer Engineer Student
+
+
+Date:
+	November 2022
+
+Note(s):
+- There are no interrupts on the PC, the test calls the handlers itself
+- Leaving a critical section calls fake_interrupt if the test has set it, as an
+	interrupt left pending while the interrupts were off would run then
+- __get_IPSR returns fake_ipsr, which the test sets to run code as if it were in an
+	interrupt
+*****************************************************************************************/
+
+
+#ifndef SYSTEM_INTERRUPT_H_INCLUDED
+#define SYSTEM_INTERRUPT_H_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+
+enum system_interrupt_vector
+{
+	SYSTEM_INTERRUPT_MODULE_SERCOM = 8
+};
+
+extern void (*fake_interrupt)(void);
+extern uint32_t fake_ipsr;
+
+static inline uint32_t __get_IPSR(void)
+{
+	return (fake_ipsr);
+}
+
+static inline void system_interrupt_enable(const enum system_interrupt_vector vector)
+{
+	(void)vector;
+}
+
+static inline void system_interrupt_enter_critical_section(void)
+{
+}
+
+static inline void system_interrupt_leave_critical_section(void)
+{
+	if (fake_interrupt != NULL)
+	{
+		fake_interrupt();
+	}
+}
+
+
+#endif	// SYSTEM_INTERRUPT_H_INCLUDED
@@ -0,0 +1,116 @@
+/****************************************************************************************
+usart.h: Stand-in for the ASF SERCOM USART driver header, for the host tests
+
+Written by:
+	Daayim Asim, B.Eng.
+	Computer Engineer Student
+
+
+Date:
+	November 2022
+
+Note(s):
+- SERCOM3 (PC) and SERCOM5 (VBS) are plain structures the test defines (fake_sercom3
+	and fake_sercom5), with the registers from stub/sercom.h
+- usart_write_buffer_wait appends the bytes written to the PC port to fake_pc_written,
+	usart_enable and usart_disable count the calls
+*****************************************************************************************/
+
+
+#ifndef USART_H_INCLUDED
+#define USART_H_INCLUDED
+
+#include <sercom.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <status_codes.h>
+
+#define SERCOM3_DMAC_ID_TX			0x08
+
+#define PINMUX_UNUSED				0xffffffff
+#define PINMUX_PA20C_SERCOM5_PAD2	0x00140002
+#define PINMUX_PA22C_SERCOM3_PAD0	0x00160002
+#define PINMUX_PA23C_SERCOM3_PAD1	0x00170002
+#define PINMUX_PB16C_SERCOM5_PAD0	0x00300002
+
+extern Sercom fake_sercom3;
+extern Sercom fake_sercom5;
+extern uint8_t fake_pc_written[];
+extern uint16_t fake_pc_written_length;
+extern int fake_usart_enables;
+extern int fake_usart_disables;
+
+#define SERCOM3	(&fake_sercom3)
+#define SERCOM5	(&fake_sercom5)
+
+enum usart_signal_mux_settings
+{
+	USART_RX_1_TX_0_XCK_1 = 0x00100000,
+	USART_RX_2_TX_0_XCK_1 = 0x00200000
+};
+
+enum usart_transfer_mode
+{
+	USART_TRANSFER_SYNCHRONOUSLY,
+	USART_TRANSFER_ASYNCHRONOUSLY
+};
+
+struct usart_config
+{
+	uint32_t baudrate;
+	enum usart_signal_mux_settings mux_setting;
+	uint32_t pinmux_pad0;
+	uint32_t pinmux_pad1;
+	uint32_t pinmux_pad2;
+	uint32_t pinmux_pad3;
+	enum usart_transfer_mode transfer_mode;
+};
+
+struct usart_module
+{
+	Sercom *hw;
+};
+
+static inline void usart_get_config_defaults(struct usart_config *config)
+{
+	config->baudrate = 9600;
+	config->mux_setting = USART_RX_1_TX_0_XCK_1;
+	config->pinmux_pad0 = PINMUX_UNUSED;
+	config->pinmux_pad1 = PINMUX_UNUSED;
+	config->pinmux_pad2 = PINMUX_UNUSED;
+	config->pinmux_pad3 = PINMUX_UNUSED;
+	config->transfer_mode = USART_TRANSFER_ASYNCHRONOUSLY;
+}
+
+static inline enum status_code usart_init(struct usart_module *module, Sercom *hw, const struct usart_config *config)
+{
+	(void)config;
+	module->hw = hw;
+	return (STATUS_OK);
+}
+
+static inline void usart_enable(const struct usart_module *module)
+{
+	(void)module;
+	fake_usart_enables++;
+}
+
+static inline void usart_disable(const struct usart_module *module)
+{
+	(void)module;
+	fake_usart_disables++;
+}
+
+static inline enum status_code usart_write_buffer_wait(struct usart_module *module, const uint8_t *tx_data, uint16_t length)
+{
+	if (module->hw == SERCOM3)
+	{
+		memcpy(&fake_pc_written[fake_pc_written_length], tx_data, length);
+		fake_pc_written_length += length;
+	}
+	return (STATUS_OK);
+}
+
+
+#endif	// USART_H_INCLUDED
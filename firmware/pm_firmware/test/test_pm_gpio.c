@@ -0,0 +1,294 @@
+/****************************************************************************************
+test_pm_gpio.c: Host test of the PM power and status bits against fake PORT registers
+
+Written by:
+	Daayim Asim, B.Eng.
+	Computer Engineer Student
+
+
+Date:
+	November 2022
+
+Note(s):
+- Builds pm_gpio.c on a PC with stub/port.h and stub/delay.h standing in for the ASF
+	headers. The PORT registers are fake_port here, the test sets IN and OUT and reads
+	back what was written to OUTSET and OUTCLR
+- The pins each bit must map to are written out again here from the pinout in the
+	pm_gpio.c header, so a bit moved to the wrong pin in the tables is caught
+- Run with "make" in this directory
+*****************************************************************************************/
+
+
+#include <port.h>
+#include <stdio.h>
+#include "pm_gpio.h"
+
+
+#define CHECK(condition)	check((condition), #condition, __LINE__)
+
+#define PA(n)	(n)
+#define PB(n)	(32 + (n))
+
+
+/****************************************************************************************
+Local variable(s)
+*****************************************************************************************/
+
+struct expected_pin
+{
+	uint16_t bit;
+	uint8_t pin;
+	bool (*get)(void);
+};
+
+static const struct expected_pin power_pins[] =
+{
+	{PM_POWER_BIT_3V3VA,			PA(19),	pm_gpio_3v3va_get},
+	{PM_POWER_BIT_BATT_SEL,			PA(12),	pm_gpio_battery_select_get},
+	{PM_POWER_BIT_BATT_SER_PWR,		PA(21),	pm_gpio_battery_serial_power_get},
+	{PM_POWER_BIT_CTD_PWR,			PA(25),	pm_gpio_ctd_power_get},
+	{PM_POWER_BIT_DRIVER,			PB(11),	pm_gpio_driver_get},
+	{PM_POWER_BIT_MAIN_PWR,			PB(10),	pm_gpio_Main_power_get},
+	{PM_POWER_BIT_VBS_PWR,			PB(3),	pm_gpio_vbs_power_get},
+	{PM_POWER_BIT_VBS_SER_PWR,		PB(30),	pm_gpio_vbs_serial_power_get},
+	{PM_POWER_BIT_WCM_DIAG,			PB(2),	pm_gpio_wcm_diagnostics_enable_get},
+	{PM_POWER_BIT_WCM_PWR,			PB(0),	pm_gpio_wcm_power_get},
+	{PM_POWER_BIT_WCM_RLY,			PB(31),	pm_gpio_wcm_relay_get}
+};
+
+static const struct expected_pin status_pins[] =
+{
+	{PM_STATUS_BIT_N_ACCEL_INT,		PA(18),	pm_gpio_accelerometer_interrupt_get},
+	{PM_STATUS_BIT_EXT_GPIO1,		PA(10),	pm_gpio_ext_gpio1_get},
+	{PM_STATUS_BIT_EXT_GPIO2,		PA(11),	pm_gpio_ext_gpio2_get},
+	{PM_STATUS_BIT_LT8618_PG,		PA(24),	pm_gpio_lt8618_pg_get},
+	{PM_STATUS_BIT_N_LTC2944_ALCC,	PA(13),	pm_gpio_n_ltc2944_alcc_get},
+	{PM_STATUS_BIT_N_WCM_FAULT,		PB(1),	pm_gpio_wcm_fault_get}
+};
+
+#define POWER_PINS		(sizeof(power_pins) / sizeof(power_pins[0]))
+#define STATUS_PINS		(sizeof(status_pins) / sizeof(status_pins[0]))
+
+// The fake PORT registers stub/port.h points PORT at
+Port fake_port;
+
+static int failures = 0;
+
+
+/****************************************************************************************
+Local function(s)
+*****************************************************************************************/
+static void check(bool, const char *, int);
+static void clear_port(void);
+static void set_pin(bool, uint8_t);
+static void test_power_bits_get(void);
+static void test_power_bits_set(void);
+static void test_status_bits_get(void);
+
+
+
+/****************************************************************************************
+Function to count and print a failed check
+*****************************************************************************************/
+static void check(bool bPassed, const char *condition, int line)
+{
+	if (!bPassed)
+	{
+		printf("test_pm_gpio.c:%d: FAILED %s\n", line, condition);
+		failures++;
+	}
+
+}	// End of check
+
+
+/****************************************************************************************
+Function to clear every fake PORT register
+*****************************************************************************************/
+static void clear_port(void)
+{
+	uint8_t group;
+
+	for (group = 0; group < 2; group++)
+	{
+		fake_port.Group[group].IN.reg = 0;
+		fake_port.Group[group].OUT.reg = 0;
+		fake_port.Group[group].OUTCLR.reg = 0;
+		fake_port.Group[group].OUTSET.reg = 0;
+	}
+
+}	// End of clear_port
+
+
+/****************************************************************************************
+Function to set one pin in the OUT register of its group, or in IN if bOutput is false
+*****************************************************************************************/
+static void set_pin(bool bOutput, uint8_t pin)
+{
+	if (bOutput)
+	{
+		fake_port.Group[pin / 32].OUT.reg |= 1ul << (pin % 32);
+	}
+	else
+	{
+		fake_port.Group[pin / 32].IN.reg |= 1ul << (pin % 32);
+	}
+
+}	// End of set_pin
+
+
+/****************************************************************************************
+Function to check that each power bit reads its own output pin, and nothing else
+*****************************************************************************************/
+static void test_power_bits_get(void)
+{
+	uint16_t all = 0;
+	size_t i;
+
+	for (i = 0; i < POWER_PINS; i++)
+	{
+		clear_port();
+		set_pin(true, power_pins[i].pin);
+
+		CHECK(pm_gpio_power_bits_get() == power_pins[i].bit);
+		CHECK(power_pins[i].get() == true);
+
+		all |= power_pins[i].bit;
+	}
+	CHECK(all == 0x07ff);
+
+	// Every output set, then every pin that is not a power pin
+	clear_port();
+	for (i = 0; i < POWER_PINS; i++)
+	{
+		set_pin(true, power_pins[i].pin);
+	}
+	CHECK(pm_gpio_power_bits_get() == 0x07ff);
+
+	fake_port.Group[0].OUT.reg = ~fake_port.Group[0].OUT.reg;
+	fake_port.Group[1].OUT.reg = ~fake_port.Group[1].OUT.reg;
+	CHECK(pm_gpio_power_bits_get() == 0);
+
+	// The inputs are not power bits
+	clear_port();
+	fake_port.Group[0].IN.reg = 0xffffffff;
+	fake_port.Group[1].IN.reg = 0xffffffff;
+	CHECK(pm_gpio_power_bits_get() == 0);
+
+}	// End of test_power_bits_get
+
+
+/****************************************************************************************
+Function to check that the power bits are written with one OUTCLR and one OUTSET per
+group, to the right pins, and only for the bits in the mask
+*****************************************************************************************/
+static void test_power_bits_set(void)
+{
+	uint32_t group_mask[2] = {0, 0};
+	size_t i;
+
+	for (i = 0; i < POWER_PINS; i++)
+	{
+		group_mask[power_pins[i].pin / 32] |= 1ul << (power_pins[i].pin % 32);
+	}
+
+	// One bit on, then off
+	for (i = 0; i < POWER_PINS; i++)
+	{
+		uint8_t group = power_pins[i].pin / 32;
+		uint32_t pin_mask = 1ul << (power_pins[i].pin % 32);
+
+		clear_port();
+		pm_gpio_power_bits_set(power_pins[i].bit, 0xffff);
+		CHECK(fake_port.Group[group].OUTSET.reg == pin_mask);
+		CHECK(fake_port.Group[group].OUTCLR.reg == 0);
+		CHECK(fake_port.Group[1 - group].OUTSET.reg == 0);
+		CHECK(fake_port.Group[1 - group].OUTCLR.reg == 0);
+
+		clear_port();
+		pm_gpio_power_bits_set(power_pins[i].bit, 0);
+		CHECK(fake_port.Group[group].OUTCLR.reg == pin_mask);
+		CHECK(fake_port.Group[group].OUTSET.reg == 0);
+		CHECK(fake_port.Group[1 - group].OUTCLR.reg == 0);
+	}
+
+	// Every bit at once
+	clear_port();
+	pm_gpio_power_bits_set(0xffff, 0xffff);
+	CHECK(fake_port.Group[0].OUTSET.reg == group_mask[0]);
+	CHECK(fake_port.Group[1].OUTSET.reg == group_mask[1]);
+	CHECK(fake_port.Group[0].OUTCLR.reg == 0);
+	CHECK(fake_port.Group[1].OUTCLR.reg == 0);
+
+	clear_port();
+	pm_gpio_power_bits_set(0x07ff, 0);
+	CHECK(fake_port.Group[0].OUTCLR.reg == group_mask[0]);
+	CHECK(fake_port.Group[1].OUTCLR.reg == group_mask[1]);
+
+	// Nothing outside the mask is touched
+	clear_port();
+	pm_gpio_power_bits_set(0, 0xffff);
+	CHECK(fake_port.Group[0].OUTSET.reg == 0 && fake_port.Group[1].OUTSET.reg == 0);
+	CHECK(fake_port.Group[0].OUTCLR.reg == 0 && fake_port.Group[1].OUTCLR.reg == 0);
+
+	// WCM_PWR on and WCM_RLY off together, both in group B
+	clear_port();
+	pm_gpio_power_bits_set(PM_POWER_BIT_WCM_PWR | PM_POWER_BIT_WCM_RLY, PM_POWER_BIT_WCM_PWR);
+	CHECK(fake_port.Group[1].OUTSET.reg == (1ul << 0));
+	CHECK(fake_port.Group[1].OUTCLR.reg == (1ul << 31));
+	CHECK(fake_port.Group[0].OUTSET.reg == 0 && fake_port.Group[0].OUTCLR.reg == 0);
+
+}	// End of test_power_bits_set
+
+
+/****************************************************************************************
+Function to check that each status bit reads its own input pin, and nothing else
+*****************************************************************************************/
+static void test_status_bits_get(void)
+{
+	uint8_t all = 0;
+	size_t i;
+
+	for (i = 0; i < STATUS_PINS; i++)
+	{
+		clear_port();
+		set_pin(false, status_pins[i].pin);
+
+		CHECK(pm_gpio_status_bits_get() == status_pins[i].bit);
+		CHECK(status_pins[i].get() == true);
+
+		all |= status_pins[i].bit;
+	}
+	CHECK(all == 0x3f);
+
+	clear_port();
+	fake_port.Group[0].IN.reg = 0xffffffff;
+	fake_port.Group[1].IN.reg = 0xffffffff;
+	CHECK(pm_gpio_status_bits_get() == 0x3f);
+
+	// Every pin that is not a status pin
+	for (i = 0; i < STATUS_PINS; i++)
+	{
+		fake_port.Group[status_pins[i].pin / 32].IN.reg &= ~(1ul << (status_pins[i].pin % 32));
+	}
+	CHECK(pm_gpio_status_bits_get() == 0);
+
+	// The outputs are not status bits
+	clear_port();
+	fake_port.Group[0].OUT.reg = 0xffffffff;
+	fake_port.Group[1].OUT.reg = 0xffffffff;
+	CHECK(pm_gpio_status_bits_get() == 0);
+
+}	// End of test_status_bits_get
+
+
+int main(void)
+{
+	test_power_bits_get();
+	test_power_bits_set();
+	test_status_bits_get();
+
+	printf("test_pm_gpio: %s\n", (failures == 0) ? "passed" : "FAILED");
+
+	return ((failures == 0) ? 0 : 1);
+
+}	// End of main
@@ -0,0 +1,282 @@
+/****************************************************************************************
+test_pm_spi.c: Host test of the PM SPI slave frame buffers against a fake SERCOM and DMA
+
+Written by:
+	Daayim Asim, B.Eng.
+	Computer Engineer Student
+
+
+Date:
+	November 2022
+
+Note(s):
+- Builds pm_spi.c on a PC with stub/spi.h, stub/sercom_interrupt.h and
+	stub/system_interrupt.h standing in for the ASF headers, and the pm_dma,
+	pm_timer and pm_usart functions it uses replaced by fakes
+- The fake DMA keeps the buffers each channel was started with. A frame from the
+	master is copied into the receive buffer and read from the transmit one, then
+	the receive channel's done function and the SERCOM handler (slave select high)
+	are called as the interrupts would
+- On the chip writing an INTFLAG bit clears it, here the test clears INTFLAG after
+	each call instead
+- Run with "make" in this directory
+*****************************************************************************************/
+
+
+#include <sercom_interrupt.h>
+#include <spi.h>
+#include <stdio.h>
+#include <string.h>
+#include "pm_config_codes.h"
+#include "pm_dma.h"
+#include "pm_spi.h"
+#include "pm_timer.h"
+#include "pm_usart.h"
+
+
+#define CHECK(condition)	check((condition), #condition, __LINE__)
+
+
+/****************************************************************************************
+Local variable(s)
+*****************************************************************************************/
+
+// Fake SERCOM4, see stub/spi.h and stub/sercom_interrupt.h
+Sercom fake_sercom4;
+int fake_spi_enables = 0;
+int fake_spi_disables = 0;
+sercom_handler_t fake_sercom_handler = NULL;
+
+// See stub/system_interrupt.h
+void (*fake_interrupt)(void) = NULL;
+uint32_t fake_ipsr = 0;
+
+// Fake DMA: the buffers and done function of each channel
+static const volatile void *dma_source[PM_DMA_CHANNELS];
+static volatile void *dma_destination[PM_DMA_CHANNELS];
+static void (*dma_done[PM_DMA_CHANNELS])(uint8_t, bool);
+
+// What the master read in the last frame
+static char master_read[PM_SPI_FRAME_LENGTH + 1];
+
+// Last message to the PC
+static char pc_message[128];
+
+static int failures = 0;
+
+
+/****************************************************************************************
+Local function(s)
+*****************************************************************************************/
+static void check(bool, const char *, int);
+static void master_frame(const char *, uint8_t);
+static void test_commands_in_order(void);
+static void test_overrun(void);
+static void test_report(void);
+static void test_response_swap(void);
+static void test_short_frame(void);
+
+
+/****************************************************************************************
+Fake pm_dma, pm_timer and pm_usart functions
+*****************************************************************************************/
+enum status_code pm_dma_configure(uint8_t channel, const struct pm_dma_channel_config *config)
+{
+	dma_done[channel] = config->done;
+	return (STATUS_OK);
+
+}	// End of pm_dma_configure
+
+
+enum status_code pm_dma_start(uint8_t channel, const volatile void *source, volatile void *destination, uint16_t length)
+{
+	CHECK(length == PM_SPI_FRAME_LENGTH);
+
+	dma_source[channel] = source;
+	dma_destination[channel] = destination;
+	return (STATUS_OK);
+
+}	// End of pm_dma_start
+
+
+void pm_dma_abort(uint8_t channel)
+{
+	(void)channel;
+
+}	// End of pm_dma_abort
+
+
+uint32_t pm_dma_interrupt_ns(void)
+{
+	return (10000ul);
+
+}	// End of pm_dma_interrupt_ns
+
+
+uint32_t pm_timer_get_ms(void)
+{
+	return (0);
+
+}	// End of pm_timer_get_ms
+
+
+uint32_t pm_timer_elapsed_ms(uint32_t since)
+{
+	return (0 - since);
+
+}	// End of pm_timer_elapsed_ms
+
+
+void pm_usart_send_pc_message(const char *message)
+{
+	strcpy(pc_message, message);
+
+}	// End of pm_usart_send_pc_message
+
+
+/****************************************************************************************
+Local function to count and print a failed check
+*****************************************************************************************/
+static void check(bool bPassed, const char *condition, int line)
+{
+	if (!bPassed)
+	{
+		printf("test_pm_spi.c:%d: FAILED %s\n", line, condition);
+		failures++;
+	}
+
+}	// End of check
+
+
+/****************************************************************************************
+Local function for the master to send the first length bytes of command in one slave
+select, a whole frame if length is PM_SPI_FRAME_LENGTH
+*****************************************************************************************/
+static void master_frame(const char *command, uint8_t length)
+{
+	memcpy(master_read, (const void *)dma_source[PM_DMA_CHANNEL_SPI_TX], PM_SPI_FRAME_LENGTH);
+	master_read[PM_SPI_FRAME_LENGTH] = '\0';
+
+	memcpy((void *)dma_destination[PM_DMA_CHANNEL_SPI_RX], command, length);
+	if (length == PM_SPI_FRAME_LENGTH)
+	{
+		dma_done[PM_DMA_CHANNEL_SPI_RX](PM_DMA_CHANNEL_SPI_RX, false);
+	}
+
+	// Slave select high
+	fake_sercom4.SPI.INTFLAG.reg = SPI_INTERRUPT_FLAG_TX_COMPLETE;
+	fake_sercom_handler(4);
+	fake_sercom4.SPI.INTFLAG.reg = 0;
+
+}	// End of master_frame
+
+
+/****************************************************************************************
+Tests
+*****************************************************************************************/
+static void test_commands_in_order(void)
+{
+	char command[PM_SPI_FRAME_LENGTH + 1];
+
+	pm_spi_configure(MODE_ENABLED);
+	CHECK(fake_sercom_handler != NULL);
+	CHECK(dma_done[PM_DMA_CHANNEL_SPI_RX] != NULL);
+
+	CHECK(pm_spi_start("RESP0000") == STATUS_OK);
+	fake_sercom4.SPI.INTFLAG.reg = 0;
+	CHECK(pm_spi_get_command(command) == false);
+
+	// Each frame is taken while the other buffer is armed
+	master_frame("CMD1____", PM_SPI_FRAME_LENGTH);
+	CHECK(strcmp(master_read, "RESP0000") == 0);
+	CHECK(pm_spi_get_command(command));
+	CHECK(strcmp(command, "CMD1____") == 0);
+
+	master_frame("CMD2____", PM_SPI_FRAME_LENGTH);
+	CHECK(strcmp(master_read, "RESP0000") == 0);
+	CHECK(pm_spi_get_command(command));
+	CHECK(strcmp(command, "CMD2____") == 0);
+	CHECK(pm_spi_get_command(command) == false);
+
+}	// End of test_commands_in_order
+
+
+static void test_overrun(void)
+{
+	char command[PM_SPI_FRAME_LENGTH + 1];
+
+	// A second frame before the main loop looks: one buffer must be armed for the
+	// next frame, so the older one is dropped
+	master_frame("CMD3____", PM_SPI_FRAME_LENGTH);
+	master_frame("CMD4____", PM_SPI_FRAME_LENGTH);
+
+	CHECK(pm_spi_get_command(command));
+	CHECK(strcmp(command, "CMD4____") == 0);
+	CHECK(pm_spi_get_command(command) == false);
+
+}	// End of test_overrun
+
+
+static void test_short_frame(void)
+{
+	char command[PM_SPI_FRAME_LENGTH + 1];
+	int disables = fake_spi_disables;
+
+	// Slave select high after 3 bytes, the SERCOM is restarted and nothing is kept
+	master_frame("CMD6____", 3);
+	CHECK(fake_spi_disables == disables + 1);
+	CHECK(pm_spi_get_command(command) == false);
+
+	master_frame("CMD7____", PM_SPI_FRAME_LENGTH);
+	CHECK(pm_spi_get_command(command));
+	CHECK(strcmp(command, "CMD7____") == 0);
+
+}	// End of test_short_frame
+
+
+static void test_response_swap(void)
+{
+	// Before slave select goes low the new response replaces the armed one
+	pm_spi_set_response("RESP1111");
+	fake_sercom4.SPI.INTFLAG.reg = 0;
+	master_frame("CMD8____", PM_SPI_FRAME_LENGTH);
+	CHECK(strcmp(master_read, "RESP1111") == 0);
+
+	// Once the frame has started it goes in the next one
+	fake_sercom4.SPI.INTFLAG.reg = SPI_INTERRUPT_FLAG_SLAVE_SELECT_LOW;
+	pm_spi_set_response("RESP2222");
+	master_frame("CMD9____", PM_SPI_FRAME_LENGTH);
+	CHECK(strcmp(master_read, "RESP1111") == 0);
+	master_frame("CMDA____", PM_SPI_FRAME_LENGTH);
+	CHECK(strcmp(master_read, "RESP2222") == 0);
+
+	// The armed frame was never written
+	master_frame("CMDB____", PM_SPI_FRAME_LENGTH);
+	CHECK(strcmp(master_read, "RESP2222") == 0);
+
+}	// End of test_response_swap
+
+
+static void test_report(void)
+{
+	// 9 frames, 4 commands taken, 4 overruns (3 in test_response_swap, which leaves its
+	// commands), 1 resync, 1 late response
+	pm_spi_report();
+	CHECK(strcmp(pc_message, "SPI_STATS 9 4 4 1 1 0 0\r\n") == 0);
+
+}	// End of test_report
+
+
+int main(void)
+{
+	test_commands_in_order();
+	test_overrun();
+	test_short_frame();
+	test_response_swap();
+	test_report();
+
+	printf("test_pm_spi: %s\n", (failures == 0) ? "passed" : "FAILED");
+
+	return ((failures == 0) ? 0 : 1);
+
+}	// End of main
@@ -0,0 +1,427 @@
+/****************************************************************************************
+test_pm_usart.c: Host test of the PM PC transmit queue against a fake SERCOM and DMA
+
+Written by:
+	Daayim Asim, B.Eng.
+	Computer Engineer Student
+
+
+Date:
+	November 2022
+
+Note(s):
+- Builds pm_usart.c on a PC with stub/usart.h, stub/sercom.h, stub/sercom_interrupt.h
+	and stub/system_interrupt.h standing in for the ASF headers, and the pm_clocks,
+	pm_dma and pm_timer functions it uses replaced by fakes
+- The fake DMA keeps the block the PC channel was started with. dma_finish() copies it
+	to dma_sent and calls the channel's done function as the interrupt would, which
+	starts the next block
+- The fake clock moves on 1 ms each time it is read, so the waits in pm_usart.c end
+- The transmit queue is not reset between the tests, each one starts where the last
+	one left head and tail
+- Run with "make" in this directory
+*****************************************************************************************/
+
+
+#include <sercom_interrupt.h>
+#include <stdio.h>
+#include <string.h>
+#include <system_interrupt.h>
+#include <usart.h>
+#include "pm_clocks.h"
+#include "pm_dma.h"
+#include "pm_timer.h"
+#include "pm_usart.h"
+
+
+#define CHECK(condition)	check((condition), #condition, __LINE__)
+
+
+/****************************************************************************************
+Local variable(s)
+*****************************************************************************************/
+
+// Fake SERCOM3 and SERCOM5, see stub/usart.h and stub/sercom_interrupt.h
+Sercom fake_sercom3;
+Sercom fake_sercom5;
+uint8_t fake_pc_written[256];
+uint16_t fake_pc_written_length = 0;
+int fake_usart_enables = 0;
+int fake_usart_disables = 0;
+sercom_handler_t fake_sercom_handler = NULL;
+
+// See stub/system_interrupt.h
+void (*fake_interrupt)(void) = NULL;
+uint32_t fake_ipsr = 0;
+
+// Fake DMA: the block being sent on the PC channel and everything sent so far
+static bool bDmaFails = false;
+static bool bDmaBusy = false;
+static const volatile uint8_t *dma_source;
+static uint16_t dma_length;
+static int dma_starts = 0;
+static int dma_aborts = 0;
+static void (*dma_done)(uint8_t, bool);
+static uint8_t dma_sent[2048];
+static uint16_t dma_sent_length = 0;
+
+static uint32_t fake_ms = 0;
+
+static int failures = 0;
+
+
+/****************************************************************************************
+Local function(s)
+*****************************************************************************************/
+static void check(bool, const char *, int);
+static void dma_drain(void);
+static void dma_finish(void);
+static void dma_sent_clear(void);
+static void fill(uint8_t *, uint16_t, uint8_t);
+static bool report_is(const char *);
+static void test_flush_timeout(void);
+static void test_frames(void);
+static void test_full_wait(void);
+static void test_interrupt_drop(void);
+static void test_no_dma(void);
+static void test_order(void);
+static void test_wrap(void);
+
+
+/****************************************************************************************
+Fake pm_clocks, pm_dma and pm_timer functions
+*****************************************************************************************/
+uint32_t pm_clocks_get_hz(uint8_t mode)
+{
+	(void)mode;
+	return (16000000ul);
+
+}	// End of pm_clocks_get_hz
+
+
+enum status_code pm_dma_configure(uint8_t channel, const struct pm_dma_channel_config *config)
+{
+	CHECK(channel == PM_DMA_CHANNEL_PC_TX);
+
+	if (bDmaFails)
+	{
+		return (STATUS_ERR_DENIED);
+	}
+
+	dma_done = config->done;
+	return (STATUS_OK);
+
+}	// End of pm_dma_configure
+
+
+enum status_code pm_dma_start(uint8_t channel, const volatile void *source, volatile void *destination, uint16_t length)
+{
+	CHECK(channel == PM_DMA_CHANNEL_PC_TX);
+	CHECK(destination == &fake_sercom3.USART.DATA.reg);
+	CHECK(bDmaBusy == false);
+	CHECK(length > 0);
+
+	bDmaBusy = true;
+	dma_source = source;
+	dma_length = length;
+	dma_starts++;
+	return (STATUS_OK);
+
+}	// End of pm_dma_start
+
+
+void pm_dma_abort(uint8_t channel)
+{
+	(void)channel;
+	bDmaBusy = false;
+	dma_aborts++;
+
+}	// End of pm_dma_abort
+
+
+uint32_t pm_timer_get_ms(void)
+{
+	return (fake_ms++);
+
+}	// End of pm_timer_get_ms
+
+
+uint32_t pm_timer_elapsed_ms(uint32_t since)
+{
+	return (fake_ms++ - since);
+
+}	// End of pm_timer_elapsed_ms
+
+
+/****************************************************************************************
+Local function to count and print a failed check
+*****************************************************************************************/
+static void check(bool bPassed, const char *condition, int line)
+{
+	if (!bPassed)
+	{
+		printf("test_pm_usart.c:%d: FAILED %s\n", line, condition);
+		failures++;
+	}
+
+}	// End of check
+
+
+/****************************************************************************************
+Local function to send the blocks left in the queue
+*****************************************************************************************/
+static void dma_drain(void)
+{
+	while (bDmaBusy)
+	{
+		dma_finish();
+	}
+
+}	// End of dma_drain
+
+
+/****************************************************************************************
+Local function to end the block being sent, as the DMA interrupt would
+*****************************************************************************************/
+static void dma_finish(void)
+{
+	if (bDmaBusy == false)
+	{
+		return;
+	}
+
+	memcpy(&dma_sent[dma_sent_length], (const void *)dma_source, dma_length);
+	dma_sent_length += dma_length;
+	bDmaBusy = false;
+
+	dma_done(PM_DMA_CHANNEL_PC_TX, false);
+
+}	// End of dma_finish
+
+
+/****************************************************************************************
+Local function to forget what the DMA has sent
+*****************************************************************************************/
+static void dma_sent_clear(void)
+{
+	dma_sent_length = 0;
+	memset(dma_sent, 0, sizeof(dma_sent));
+
+}	// End of dma_sent_clear
+
+
+/****************************************************************************************
+Local function to fill a block with a count from first, so a byte sent twice or out of
+order shows
+*****************************************************************************************/
+static void fill(uint8_t *data, uint16_t length, uint8_t first)
+{
+	uint16_t i;
+
+	for (i = 0; i < length; i++)
+	{
+		data[i] = (uint8_t)(first + i);
+	}
+
+}	// End of fill
+
+
+/****************************************************************************************
+Local function to check the PC_TX_QUEUE report, which goes through the queue itself
+*****************************************************************************************/
+static bool report_is(const char *expected)
+{
+	dma_drain();
+	dma_sent_clear();
+
+	pm_usart_report_queue();
+	dma_drain();
+
+	return ((dma_sent_length == strlen(expected)) && (memcmp(dma_sent, expected, dma_sent_length) == 0));
+
+}	// End of report_is
+
+
+/****************************************************************************************
+Tests
+*****************************************************************************************/
+static void test_order(void)
+{
+	fake_sercom3.USART.INTFLAG.reg = SERCOM_USART_INTFLAG_TXC;
+	pm_usart_configure();
+	CHECK(dma_done != NULL);
+	CHECK(fake_sercom_handler != NULL);
+
+	// The first message starts the DMA, the second waits in the queue behind it
+	pm_usart_send_pc_message("HELLO\r\n");
+	CHECK(dma_starts == 1);
+	CHECK(dma_length == 7);
+
+	pm_usart_send_pc_message("WORLD\r\n");
+	CHECK(dma_starts == 1);
+
+	dma_drain();
+	CHECK(dma_starts == 2);
+	CHECK(dma_sent_length == 14);
+	CHECK(memcmp(dma_sent, "HELLO\r\nWORLD\r\n", 14) == 0);
+
+}	// End of test_order
+
+
+static void test_wrap(void)
+{
+	uint8_t data[500];
+	int starts = dma_starts;
+
+	// From 14 bytes in, the block runs past the end of the queue: the DMA sends up to
+	// the end, then the 2 bytes written at the start
+	dma_sent_clear();
+	fill(data, sizeof(data), 0);
+	pm_usart_send_pc_data(data, sizeof(data));
+	CHECK(dma_starts == starts + 1);
+	CHECK(dma_length == PM_USART_PC_TX_QUEUE_LENGTH - 14);
+
+	dma_finish();
+	CHECK(dma_starts == starts + 2);
+	CHECK(dma_length == 2);
+
+	dma_drain();
+	CHECK(dma_sent_length == sizeof(data));
+	CHECK(memcmp(dma_sent, data, sizeof(data)) == 0);
+
+}	// End of test_wrap
+
+
+static void test_full_wait(void)
+{
+	uint8_t data[PM_USART_PC_TX_QUEUE_LENGTH - 1 + 100];
+
+	// One byte short of the queue length fills it while the DMA is still busy
+	dma_sent_clear();
+	fill(data, sizeof(data), 7);
+	pm_usart_send_pc_data(data, PM_USART_PC_TX_QUEUE_LENGTH - 1);
+	CHECK(bDmaBusy);
+
+	// The rest waits until the DMA interrupt, which runs when the critical section ends
+	fake_interrupt = dma_finish;
+	pm_usart_send_pc_data(&data[PM_USART_PC_TX_QUEUE_LENGTH - 1], 100);
+	fake_interrupt = NULL;
+
+	dma_drain();
+	CHECK(dma_sent_length == sizeof(data));
+	CHECK(memcmp(dma_sent, data, sizeof(data)) == 0);
+
+	CHECK(report_is("PC_TX_QUEUE 512 511 1 0\r\n"));
+
+}	// End of test_full_wait
+
+
+static void test_interrupt_drop(void)
+{
+	uint8_t data[PM_USART_PC_TX_QUEUE_LENGTH - 1];
+
+	dma_sent_clear();
+	fill(data, sizeof(data), 3);
+	pm_usart_send_pc_data(data, sizeof(data));
+
+	// An interrupt cannot wait for the DMA interrupt, its message is dropped
+	fake_ipsr = 3;
+	pm_usart_send_pc_message("EVENT\r\n");
+	fake_ipsr = 0;
+
+	dma_drain();
+	CHECK(dma_sent_length == sizeof(data));
+	CHECK(memcmp(dma_sent, data, sizeof(data)) == 0);
+
+	CHECK(report_is("PC_TX_QUEUE 512 511 1 7\r\n"));
+
+}	// End of test_interrupt_drop
+
+
+static void test_frames(void)
+{
+	const char *expected = "@42 OK 1\r\n@42 OK 2\r\nEVT\r\n@42 PART\r\nX\r\n";
+
+	dma_sent_clear();
+
+	// Each line is prefixed once, however the messages split it
+	pm_usart_frame_begin(42);
+	pm_usart_send_pc_message("OK 1\r\nOK");
+	pm_usart_send_pc_message(" 2\r\n");
+
+	// Not a message from an interrupt
+	fake_ipsr = 3;
+	pm_usart_send_pc_message("EVT\r\n");
+	fake_ipsr = 0;
+
+	// A line left open is finished by the end of the frame
+	pm_usart_send_pc_message("PART");
+	pm_usart_frame_end();
+	pm_usart_send_pc_message("X\r\n");
+
+	dma_drain();
+	CHECK(dma_sent_length == strlen(expected));
+	CHECK(memcmp(dma_sent, expected, strlen(expected)) == 0);
+
+}	// End of test_frames
+
+
+static void test_flush_timeout(void)
+{
+	int disables = fake_usart_disables;
+
+	// The DMA never finishes: reconfiguring the port waits its time for the queue, then
+	// drops what is left
+	pm_usart_send_pc_message("STUCK\r\n");
+	pm_usart_send_pc_message("LOST\r\n");
+	CHECK(bDmaBusy);
+
+	pm_usart_configure();
+	CHECK(fake_usart_disables == disables + 2);
+	CHECK(dma_aborts == 1);
+	CHECK(bDmaBusy == false);
+
+	// The port is usable again
+	dma_sent_clear();
+	pm_usart_send_pc_message("AGAIN\r\n");
+	dma_drain();
+	CHECK(dma_sent_length == 7);
+	CHECK(memcmp(dma_sent, "AGAIN\r\n", 7) == 0);
+
+	CHECK(report_is("PC_TX_QUEUE 512 511 1 20\r\n"));
+
+}	// End of test_flush_timeout
+
+
+static void test_no_dma(void)
+{
+	int starts;
+
+	// Without a DMA channel the bytes are written by the CPU
+	bDmaFails = true;
+	pm_usart_configure();
+	starts = dma_starts;
+
+	pm_usart_send_pc_message("PLAIN\r\n");
+	CHECK(dma_starts == starts);
+	CHECK(fake_pc_written_length == 7);
+	CHECK(memcmp(fake_pc_written, "PLAIN\r\n", 7) == 0);
+
+}	// End of test_no_dma
+
+
+int main(void)
+{
+	test_order();
+	test_wrap();
+	test_full_wait();
+	test_interrupt_drop();
+	test_frames();
+	test_flush_timeout();
+	test_no_dma();
+
+	printf("test_pm_usart: %s\n", (failures == 0) ? "passed" : "FAILED");
+
+	return ((failures == 0) ? 0 : 1);
+
+}	// End of main
@@ -14,12 +14,18 @@ Date:
 #include <string.h>
 #include "wcm.h"
 #include "wcm_adc.h"
+#include "wcm_at.h"
 #include "wcm_clocks.h"
+#include "wcm_dma.h"
 #include "wcm_gpio.h"
+#include "wcm_gps.h"
+#include "wcm_gps_manager.h"
 #include "wcm_i2c.h"
 
 #include "wcm_ms5637.h"
+#include "wcm_outbox.h"
 #include "wcm_spi.h"
+#include "wcm_timer.h"
 #include "wcm_usart.h"
 
 #include "wcm_mc3416.h"
@@ -57,6 +63,25 @@ Local function(s)
 static bool handle_command(char *);
 static void handle_spi_command(char *, char *);
 
+static void at_set_power(bool);
+static void at_unsolicited(const char *);
+static void at_command_done(const char *, enum wcm_at_result, const char *);
+
+// Iridium and cellular unsolicited result codes
+static const char *const at_urc_prefixes[] = {"SBDRING", "+SBDRING", "+CIEV:", "+AREG:", "RING", "+CMTI:", NULL};
+
+// SAT/CELL modem on COM_TX/COM_RX, powered by SAT_PWR_EN
+static const struct wcm_at_port at_port =
+{
+	wcm_usart_read_com_byte,
+	wcm_usart_send_com_command,
+	wcm_usart_send_com_data,
+	wcm_timer_get_ms,
+	at_set_power,
+	at_urc_prefixes,
+	at_unsolicited
+};
+
 static void initInternalHW(void);
 
 enum status_code read_mc3416(void);
@@ -97,6 +122,50 @@ struct tc_module *const module_inst)
 }
 
 
+/****************************************************************************************
+Local function to switch the SAT/CELL modem power for the AT engine
+*****************************************************************************************/
+static void at_set_power(bool bOn)
+{
+	if (bOn)
+	{
+		wcm_gpio_sat_pwr_en_on();
+	}
+	else
+	{
+		wcm_gpio_sat_pwr_en_off();
+	}
+
+}	// End of at_set_power
+
+
+/****************************************************************************************
+Local function to send an unsolicited modem line to the PC
+*****************************************************************************************/
+static void at_unsolicited(const char *line)
+{
+	char response[160];
+
+	sprintf(response, "AT_URC %s\r\n", line);
+	wcm_usart_send_pc_message(response);
+
+}	// End of at_unsolicited
+
+
+/****************************************************************************************
+Local function to send the result of a queued AT command to the PC
+*****************************************************************************************/
+static void at_command_done(const char *at_command, enum wcm_at_result result, const char *at_response)
+{
+	static const char *const result_names[] = {"OK", "ERROR", "TIMEOUT", "NO_MODEM"};
+	char response[200];
+
+	sprintf(response, "AT_RESULT %s %s %s\r\n", result_names[result], at_command, at_response);
+	wcm_usart_send_pc_message(response);
+
+}	// End of at_command_done
+
+
 /****************************************************************************************
 Local function to handle serial commands
 *****************************************************************************************/
@@ -104,18 +173,13 @@ static bool handle_command(char *command)
 {
 	bool b;
 	bool bValid;
-	bool data_received;
 	char response[128];
 	char *token;
 	enum status_code status;
 	float v;
 	float batt;
 	int i;
-	
-	bool satCommandReceived;
-//	bool satValid;
-	char satcommand[COMMAND_LENGTH];
-	enum status_code sat_status;
+	struct wcm_at_stats at_stats;
 
 	// Respond to valid commands
 	bValid = true;
@@ -146,47 +210,99 @@ static bool handle_command(char *command)
 			wcm_usart_send_pc_message("handle_command: Could not read battery detector!\r\n");
 		}
 	}
-	
-	// Check for a sat data
-	else if  (strstr(command, "read_coms"))
+	else if (strstr(command, "read_adc"))
 	{
-		wcm_gpio_sat_pwr_en_on();
-		sat_status = wcm_usart_check_for_com_data();
-		if (sat_status == STATUS_OK)
+		status = wcm_adc_read_channel(WCM_ADC_CHANNEL_TEMPERATURE, &v);
+		if (status == STATUS_OK)
 		{
-//			wcm_usart_send_com_command("AT&D0\r\n");
-			satCommandReceived = wcm_usart_get_com_data(satcommand, COMMAND_LENGTH);
-			if (satCommandReceived)
-			{
-				wcm_usart_send_pc_message(satcommand);
-				wcm_usart_send_pc_message(" ");					
-				wcm_usart_send_pc_message("VALID\r\n");
-					
-			}
-			else
-			{
-				wcm_usart_send_pc_message("INVALID\r\n");
-			}			
+			wcm_adc_read_channel(WCM_ADC_CHANNEL_BANDGAP, &batt);
+			sprintf(response, "ADC TEMPERATURE %.1lf VDD %.2lf SCANS %lu RESTARTS %lu\r\n", v, batt, (unsigned long)wcm_adc_get_scan_count(),
+				(unsigned long)wcm_adc_get_restart_count());
+			wcm_usart_send_pc_message(response);
 		}
-		wcm_gpio_sat_pwr_en_off();
-		
+		else
+		{
+			wcm_usart_send_pc_message("handle_command: Could not read ADC sequence!\r\n");
+		}
+	}
+	
+	// Modem commands are queued, the result is sent later as AT_RESULT
+	else if  (strstr(command, "read_coms"))
+	{
+		bValid = wcm_at_queue("AT+CSQ", NULL, 10000ul, at_command_done);
+	}
+	else if (strncmp(command, "at ", 3) == 0)
+	{
+		bValid = wcm_at_queue(&command[3], NULL, 10000ul, at_command_done);
+	}
+	else if (strstr(command, "read_at_stats"))
+	{
+		wcm_at_get_stats(&at_stats);
+		sprintf(response, "AT_STATS %lu %lu %lu %lu %lu %lu %lu %lu %u %lu %lu\r\n",
+			(unsigned long)at_stats.commands, (unsigned long)at_stats.ok, (unsigned long)at_stats.errors,
+			(unsigned long)at_stats.timeouts, (unsigned long)at_stats.no_modem, (unsigned long)at_stats.unsolicited,
+			(unsigned long)at_stats.power_ups, (unsigned long)at_stats.power_up_ms, wcm_at_get_power_state(),
+			(unsigned long)wcm_usart_get_com_overflows(), (unsigned long)(at_stats.power_on_ms / 1000ul));
+		wcm_usart_send_pc_message(response);
+	}
+	else if (strstr(command, "read_outbox"))
+	{
+		wcm_outbox_report();
+	}
+	else if (strstr(command, "send_outbox"))
+	{
+		wcm_outbox_send_now();
+	}
+	else if (strstr(command, "queue_summary"))
+	{
+		wcm_outbox_add_summary();
+	}
+	else if (strstr(command, "queue_fault"))
+	{
+		bValid = wcm_outbox_add_alarm(OUTBOX_RECORD_FAULT, 0);
+	}
+	else if (strstr(command, "read_spi_stats"))
+	{
+		wcm_spi_report();
+	}
+	else if (strstr(command, "read_dma_stats"))
+	{
+		wcm_dma_report();
+		wcm_usart_report_queues();
+	}
+	else if (strstr(command, "read_gps_manager"))
+	{
+		wcm_gps_manager_report();
+	}
+	else if (strstr(command, "set_gps_period"))
+	{
+		uint32_t period_s;
+		uint32_t budget_s;
+
+		token = strtok(command, " ");
+		token = strtok(NULL, " ");
+		period_s = (token != NULL) ? strtoul(token, NULL, 10) : 0;
+		token = strtok(NULL, " ");
+		budget_s = (token != NULL) ? strtoul(token, NULL, 10) : GPS_MANAGER_BUDGET_S;
+		token = strtok(NULL, " ");
+		i = (token != NULL) ? atoi(token) : GPS_IDLE_AUTO;
+
+		status = wcm_gps_manager_configure(period_s, budget_s, (enum wcm_gps_idle_mode)i);
+		bValid = (status == STATUS_OK);
+		sprintf(command, "set_gps_period %lu %lu %d", (unsigned long)period_s, (unsigned long)budget_s, i);
+	}
+	else if (strstr(command, "acquire_gps"))
+	{
+		wcm_gps_manager_request_fix();
+	}
+	else if (strstr(command, "read_gps_stats"))
+	{
+		wcm_gps_report_stats();
 	}
 	else if (strstr(command, "read_gps"))
 	{
-		if (wcm_gpio_gps_pwr_en_get())
-		{
-			status = wcm_usart_check_for_gps_data();
-			
-			if (status == STATUS_OK)
-			{			
-				data_received = wcm_usart_get_gps_data(command, COMMAND_LENGTH);
-				if (data_received)
-				{
-					wcm_usart_send_pc_message(command);
-					wcm_usart_send_pc_message(" ");
-				}
-			}
-		}
+		// Latest fix, never waits for the GPS
+		wcm_gps_report();
 	}
 	else if (strstr(command, "wcm_ping"))
 	{
@@ -414,7 +530,8 @@ static void handle_spi_command(char *command, char *response)
 	double mc3416_angle;
 	
 	// GPS
-	static bool data_received;
+	static struct wcm_gps_fix gps_fix;
+	uint32_t gps_age_ms;
 
 	// Power bits
 	bool en_3v3va;
@@ -452,19 +569,21 @@ static void handle_spi_command(char *command, char *response)
 	else if (strstr(command, "read_gps"))
 	{
 		strcpy(last_command, command);
-		status = STATUS_BUSY;
-		while (status == STATUS_BUSY){
-			status = wcm_usart_check_for_gps_data();
-		}
-		if (status == STATUS_OK)
-		{
-			data_received = wcm_usart_get_gps_data(command, COMMAND_LENGTH);
-			if (data_received)
-			{
-				sprintf(response, COMMAND_LENGTH, command);
-				num_sent = 1;
-			}
-		}
+
+		// Latitude, then longitude, satellites, HDOP and fix age (s) by RESP. The
+		// position is sent as whole 1e-4 degrees, -1800000 still fits in a frame
+		// where -180.0000 would not
+		wcm_gps_get_fix(&gps_fix);
+		sprintf(response, "%*ld", spi_command_length, (long)((gps_fix.latitude + ((gps_fix.latitude < 0) ? -50 : 50)) / 100));
+		num_sent = 1;
+	}
+	else if (strstr(command, "FAULT"))
+	{
+		strcpy(last_command, command);
+
+		// /WCM_FAULT seen by the PM, replies with the bytes waiting to be sent
+		wcm_outbox_fault_seen();
+		sprintf(response, "%*u", spi_command_length, wcm_outbox_get_length());
 	}
 	else if (strstr(command, "wcm_ping"))
 	{
@@ -540,10 +659,39 @@ static void handle_spi_command(char *command, char *response)
 	}
 	else if (strstr(command, "RESP"))
 	{
-		if (strstr(last_command, "LEAK"))
+		if (strstr(last_command, "LEAK") || strstr(last_command, "FAULT"))
 		{
 			sprintf(response, "--------");
 		}
+		else if (strstr(last_command, "read_gps"))
+		{
+			if (num_sent == 1)
+			{
+				sprintf(response, "%*ld", spi_command_length, (long)((gps_fix.longitude + ((gps_fix.longitude < 0) ? -50 : 50)) / 100));
+				num_sent = 2;
+			}
+			else if (num_sent == 2)
+			{
+				sprintf(response, "%*u", spi_command_length, gps_fix.satellites);
+				num_sent = 3;
+			}
+			else if (num_sent == 3)
+			{
+				sprintf(response, "%*.2f", spi_command_length, (double)gps_fix.hdop / 100.0);
+				num_sent = 4;
+			}
+			else if (num_sent == 4)
+			{
+				// -1 before the first fix
+				gps_age_ms = wcm_gps_get_fix_age_ms();
+				sprintf(response, "%*ld", spi_command_length, (gps_age_ms == UINT32_MAX) ? -1l : (long)(gps_age_ms / 1000ul));
+				num_sent = 5;
+			}
+			else
+			{
+				sprintf(response, "--------");
+			}
+		}
 		else if (strstr(last_command, "MS5637"))
 		{
 			if (num_sent == 1)
@@ -745,11 +893,12 @@ Function to initialize the MMD WCM board
 *****************************************************************************************/
 void wcm_init(void)
 {
-	// Initialize the clocks, drivers, interfaces and interrupts
+	// Initialize the clocks, drivers, interfaces and interrupts. The PC and COM USARTs
+	// take their DMA channels when they are configured
+	wcm_dma_init();
 	wcm_power_normal_power_mode();
 	
 	wcm_adc_configure();
-	wcm_bat_adc_configure();		
 	wcm_i2c_configure();
 /*
 	wcm_interrupt_configure();
@@ -773,8 +922,15 @@ void wcm_init(void)
 	wcm_gpio_sat_pwr_en_off();
 	wcm_lgt_off();
 
+	wcm_at_init(&at_port);
+
 	initInternalHW();
 
+	// After the MC3416 init, which starts the EEPROM emulator
+	wcm_outbox_init();
+
+	wcm_gps_manager_init();
+
 }	// End of wcm_init
 
 
@@ -810,8 +966,8 @@ void wcm_run(void)
 	enum status_code retval;
 	
 	int i;
-	uint8_t spi_rx_buffer[SPI_BUFFER_LENGTH] = {0x00};
-	uint8_t spi_tx_buffer[SPI_BUFFER_LENGTH] = {0x00};
+	char spi_rx_buffer[SPI_BUFFER_LENGTH] = {0x00};
+	char spi_tx_buffer[SPI_BUFFER_LENGTH] = {0x00};
 
 	wcm_usart_send_pc_message("wcm_run: started\r\n");
 	wcm_usart_send_gps_command("wcm_run: started\r\n");
@@ -826,20 +982,26 @@ void wcm_run(void)
 
 		while (timer_0_elapsed == false)		
 		{
+			wcm_adc_service();
+			wcm_gps_service();
+			wcm_gps_manager_service();
+			wcm_at_service();
+			wcm_outbox_service();
+
 			if (bSPIInitialized == false)
 			{
 				// Slave select is high when SPI master (MMD) is on
 				b = wcm_gpio_spi_slave_select_get();
 				if (b == true)
 				{
-					for (i = 0; i < 8; i++)
+					for (i = 0; i < WCM_SPI_FRAME_LENGTH; i++)
 					{
 						spi_tx_buffer[i] = '-';
 					}
 
 					wcm_spi_configure(MODE_ENABLED);
 
-					retval = wcm_spi_start_read(spi_tx_buffer, spi_rx_buffer, spi_command_length);
+					retval = wcm_spi_start(spi_tx_buffer);
 					if (retval == STATUS_OK)
 					{
 						bSPIInitialized = true;
@@ -848,29 +1010,18 @@ void wcm_run(void)
 					}
 					else
 					{
-						wcm_usart_send_pc_message("wcm_run: wcm_spi_start_read failed (1)!\r\n");
+						wcm_usart_send_pc_message("wcm_run: wcm_spi_start failed!\r\n");
 					}
 				}
 			}
 			// Check for an SPI command
 			if (bSPIInitialized == true)
 			{
-				if (wcm_spi_transfer_complete())
+				// Answered from the main loop, the MMD may already be clocking the next frame
+				if (wcm_spi_get_command(spi_rx_buffer))
 				{
-					delay_ms(10);
-
-					// Handle the SPI buffer data
-					spi_rx_buffer[spi_command_length] = '\0';
-					handle_spi_command((char *)spi_rx_buffer, (char *)spi_tx_buffer);
-
-					// Start another SPI read
-					retval = wcm_spi_start_read(spi_tx_buffer, spi_rx_buffer, spi_command_length);
-					if (retval != STATUS_OK)
-					{
-						bSPIInitialized = false;
-
-						wcm_usart_send_pc_message("wcm_run: wcm_spi_start_read failed (2)!\r\n");
-					}
+					handle_spi_command(spi_rx_buffer, spi_tx_buffer);
+					wcm_spi_set_response(spi_tx_buffer);
 				}
 			}
 		
@@ -8,11 +8,34 @@ Written by:
 
 Date:
 	November 2022
+
+Note(s):
+- The leak detector (AIN7), battery detector (AIN19), temperature sensor and bandgap
+	are converted as one sequence (SEQCTRL). Each result is the hardware average of 16
+	samples and is stored by the ADC interrupt, so the reads below never wait for a
+	conversion
+- wcm_adc_service() starts a sequence every WCM_ADC_SCAN_PERIOD_MS from the main loop.
+	Back to back sequences would keep the ADC and its interrupt busy all the time for
+	results that are read a few times a second at most
+- A sequence takes about 60 ms: a 46.9 kHz ADC clock (12 MHz / 256), 32 clocks of
+	sampling (SAMPLEN 63, in half clocks) for the battery divider and 12 of conversion,
+	for 16 samples of each of 4 channels
+- A sequence that is not complete WCM_ADC_SCAN_TIMEOUT_MS after it started has lost a
+	result ready interrupt, and would otherwise leave bScanRunning set and the cache
+	stale for good. wcm_adc_service() stops the ADC and starts the sequence again from
+	its first channel
+- The bandgap (1.0 V) result gives VDDANA, which is the reference, so the other
+	channels are scaled by the measured supply instead of an assumed 3.3 V
+- The ADC driver is in polled mode (ADC_CALLBACK_MODE=false), so the sequence and its
+	interrupt are set up here through the registers
 *****************************************************************************************/
 
 
 #include <adc.h>
+#include <delay.h>
+#include <system_interrupt.h>
 #include "wcm_adc.h"
+#include "wcm_timer.h"
 
 
 /****************************************************************************************
@@ -20,7 +43,110 @@ Local variable(s)
 *****************************************************************************************/
 
 static struct adc_module adc_module_struct;
-static struct adc_module battery_adc_module_struct;
+
+// Sequence order is ascending positive input, AIN7, AIN19, TEMP, BANDGAP
+static const uint32_t adc_sequence_mask = (1ul << ADC_POSITIVE_INPUT_PIN7) | (1ul << ADC_POSITIVE_INPUT_PIN19) |
+	(1ul << ADC_POSITIVE_INPUT_TEMP) | (1ul << ADC_POSITIVE_INPUT_BANDGAP);
+
+// Results of the sequence being converted
+static volatile uint16_t scan_buffer[WCM_ADC_CHANNELS];
+static volatile uint8_t scan_index = 0;
+
+// Results of the last complete sequence
+static volatile uint16_t scan_cache[WCM_ADC_CHANNELS];
+static volatile uint32_t scan_count = 0;
+
+// Sequence started and not yet complete
+static volatile bool bScanRunning = false;
+static uint32_t scan_start_ms = 0;
+
+// Sequences started again after a lost interrupt
+static uint32_t scan_restarts = 0;
+
+// Used when the bandgap has not been converted
+static const float adc_default_vdd = 3.3;
+
+// Bandgap reference voltage
+static const float adc_bandgap_v = 1.0;
+
+
+/****************************************************************************************
+Local function(s)
+*****************************************************************************************/
+
+static enum status_code adc_wait_for_scan(void);
+static float adc_get_vdd(void);
+static float adc_counts_to_volts(uint16_t);
+static void adc_restart_scan(void);
+
+
+/****************************************************************************************
+Local function to wait for the first sequence after configuring
+*****************************************************************************************/
+static enum status_code adc_wait_for_scan(void)
+{
+	uint8_t i;
+
+	for (i = 0; i < 100 && scan_count == 0; i++)
+	{
+		delay_ms(1);
+	}
+
+	return ((scan_count == 0) ? STATUS_ERR_TIMEOUT : STATUS_OK);
+
+}	// End of adc_wait_for_scan
+
+
+/****************************************************************************************
+Local function to return VDDANA from the last bandgap result
+*****************************************************************************************/
+static float adc_get_vdd(void)
+{
+	uint16_t bandgap;
+
+	bandgap = scan_cache[WCM_ADC_CHANNEL_BANDGAP];
+	if (bandgap == 0)
+	{
+		return (adc_default_vdd);
+	}
+
+	return (adc_bandgap_v * 4095.0 / (float)bandgap);
+
+}	// End of adc_get_vdd
+
+
+/****************************************************************************************
+Local function to convert a 12 bit result to volts
+*****************************************************************************************/
+static float adc_counts_to_volts(uint16_t counts)
+{
+	return (adc_get_vdd() * (float)counts / 4095.0);
+
+}	// End of adc_counts_to_volts
+
+
+/****************************************************************************************
+Local function to abandon the sequence being converted, the next start begins again
+from its first channel
+
+Note(s):
+- Disabling the ADC stops the sequence, SEQCTRL is kept. adc_enable() turns the
+	interrupts off, so the result ready interrupt is enabled again here
+*****************************************************************************************/
+static void adc_restart_scan(void)
+{
+	system_interrupt_disable(SYSTEM_INTERRUPT_MODULE_ADC);
+	adc_disable(&adc_module_struct);
+
+	scan_index = 0;
+	scan_restarts++;
+
+	adc_enable(&adc_module_struct);
+	adc_module_struct.hw->INTFLAG.reg = ADC_INTFLAG_RESRDY;
+	adc_module_struct.hw->INTENSET.reg = ADC_INTENSET_RESRDY;
+	system_interrupt_enable(SYSTEM_INTERRUPT_MODULE_ADC);
+
+}	// End of adc_restart_scan
 
 
 /****************************************************************************************
@@ -31,120 +157,209 @@ See https://asf.microchip.com/docs/latest/saml21/html/asfdoc_sam0_adc_basic_use_
 void wcm_adc_configure(void)
 {
 	static bool bFirst = true;
-	
+
 	struct adc_config adc_config_struct;
-	
+
 	adc_get_config_defaults(&adc_config_struct);
-	
+
+	// The battery divider has a high source impedance, give it a long sample time
+	adc_config_struct.clock_prescaler = ADC_CLOCK_PRESCALER_DIV256;
+	adc_config_struct.sample_length = 63;
+
 	adc_config_struct.positive_input = ADC_POSITIVE_INPUT_PIN7;
+	adc_config_struct.positive_input_sequence_mask_enable = adc_sequence_mask;
 	adc_config_struct.reference = ADC_REFERENCE_INTVCC2;
-	
+
+	// Hardware average of 16 samples per result, still 12 bits
+	adc_config_struct.resolution = ADC_RESOLUTION_CUSTOM;
+	adc_config_struct.accumulate_samples = ADC_ACCUMULATE_SAMPLES_16;
+	adc_config_struct.divide_result = ADC_DIVIDE_RESULT_16;
+
 	if (bFirst)
 	{
 		bFirst = false;
 	}
 	else
 	{
+		system_interrupt_disable(SYSTEM_INTERRUPT_MODULE_ADC);
 		adc_disable(&adc_module_struct);
 	}
-	
+
+	// Temperature sensor on
+	SUPC->VREF.reg |= SUPC_VREF_TSEN;
+
 	adc_init(&adc_module_struct, ADC, &adc_config_struct);
-	
+
+	// adc_init() only sets up the pins of the sequence
+	adc_module_struct.hw->SEQCTRL.reg = ADC_SEQCTRL_SEQEN(adc_sequence_mask);
+
 	adc_enable(&adc_module_struct);
-	
+
+	scan_index = 0;
+	scan_count = 0;
+
+	adc_module_struct.hw->INTFLAG.reg = ADC_INTFLAG_RESRDY;
+	adc_module_struct.hw->INTENSET.reg = ADC_INTENSET_RESRDY;
+	system_interrupt_enable(SYSTEM_INTERRUPT_MODULE_ADC);
+
+	bScanRunning = true;
+	scan_start_ms = wcm_timer_get_ms();
+	adc_start_conversion(&adc_module_struct);
+
 }	// End of wcm_adc_configure
 
+
 /****************************************************************************************
-Function to configure adc for bat
-*****************************************************************************************/
+Function to start the next sequence once WCM_ADC_SCAN_PERIOD_MS has elapsed, or again
+once a sequence has run for WCM_ADC_SCAN_TIMEOUT_MS
 
-void wcm_bat_adc_configure(void)
+Call from the main loop
+*****************************************************************************************/
+void wcm_adc_service(void)
 {
-	static bool bFirst = true;
-	
-	struct adc_config bat_adc_config_struct;
-	
-	adc_get_config_defaults(&bat_adc_config_struct);
-	bat_adc_config_struct.sample_length = 64;
-	bat_adc_config_struct.clock_prescaler = ADC_CLOCK_PRESCALER_DIV32;
-	
-	bat_adc_config_struct.positive_input = ADC_POSITIVE_INPUT_PIN19;
-	bat_adc_config_struct.reference = ADC_REFERENCE_INTVCC2;
-	
-	if (bFirst)
+	if (bScanRunning)
 	{
-		bFirst = false;
+		if (wcm_timer_elapsed_ms(scan_start_ms) < WCM_ADC_SCAN_TIMEOUT_MS)
+		{
+			return;
+		}
+		adc_restart_scan();
 	}
-	else
+	else if (wcm_timer_elapsed_ms(scan_start_ms) < WCM_ADC_SCAN_PERIOD_MS)
 	{
-		adc_disable(&battery_adc_module_struct);
+		return;
 	}
-	
-	adc_init(&battery_adc_module_struct, ADC, &bat_adc_config_struct);
-	
-	adc_enable(&battery_adc_module_struct);
-}
+
+	bScanRunning = true;
+	scan_start_ms = wcm_timer_get_ms();
+	adc_module_struct.hw->SWTRIG.reg = ADC_SWTRIG_START;
+
+}	// End of wcm_adc_service
+
 
 /****************************************************************************************
-Function to read an ADC value
+Function to read the leak detector voltage from the last sequence
 *****************************************************************************************/
 enum status_code wcm_adc_read(float *v)
 {
-	uint16_t result;
-	enum status_code status;
-	
-	adc_start_conversion(&adc_module_struct);
-	
-	while (1)
-	{
-		status = adc_read(&adc_module_struct, &result);
-		if (status == STATUS_BUSY)
-		{
-			continue;
-		}
-		else
-		{
-			if (status == STATUS_OK)
-			{
-				*v = 3.3 * (float)result / 4095.0;
-			}
-			break;
-		}
-	}
-	
-	return (status);
-	
+	return (wcm_adc_read_channel(WCM_ADC_CHANNEL_LEAK, v));
+
 }	// End of wcm_adc_read
 
+
 /****************************************************************************************
-Function to read an ADC value for battery detector
+Function to read the battery detector voltage from the last sequence
 *****************************************************************************************/
 enum status_code wcm_bat_adc_read(float *v)
 {
-	uint16_t result;
+	return (wcm_adc_read_channel(WCM_ADC_CHANNEL_BATTERY, v));
+
+}	// End of wcm_bat_adc_read
+
+
+/****************************************************************************************
+Function to read a channel of the last sequence
+
+The leak and battery channels are in volts, the temperature in degrees C and the
+bandgap channel returns VDDANA in volts
+*****************************************************************************************/
+enum status_code wcm_adc_read_channel(enum wcm_adc_channel channel, float *v)
+{
+	uint32_t temp_log[2];
+	float room_temperature;
+	float hot_temperature;
+	float room_v;
+	float hot_v;
 	enum status_code status;
-	
-	adc_start_conversion(&battery_adc_module_struct);
-	
-	while (1)
+
+	status = adc_wait_for_scan();
+	if (status != STATUS_OK)
 	{
-		status = adc_read(&battery_adc_module_struct, &result);
-		if (status == STATUS_BUSY)
-		{
-			continue;
-		}
-		else
-		{
-			if (status == STATUS_OK)
+		return (status);
+	}
+
+	switch (channel)
+	{
+		case WCM_ADC_CHANNEL_LEAK:
+		case WCM_ADC_CHANNEL_BATTERY:
+			*v = adc_counts_to_volts(scan_cache[channel]);
+			break;
+
+		case WCM_ADC_CHANNEL_TEMPERATURE:
+			// Factory calibration at room and hot temperature (NVM temperature log row)
+			temp_log[0] = ((const uint32_t *)NVMCTRL_TEMP_LOG)[0];
+			temp_log[1] = ((const uint32_t *)NVMCTRL_TEMP_LOG)[1];
+
+			room_temperature = (float)(temp_log[0] & 0xff) + (float)((temp_log[0] >> 8) & 0x0f) / 10.0;
+			hot_temperature = (float)((temp_log[0] >> 12) & 0xff) + (float)((temp_log[0] >> 20) & 0x0f) / 10.0;
+
+			// Sensor voltages, measured against the 1.0 V reference corrected by INT1V
+			room_v = (1.0 - (float)(int8_t)(temp_log[0] >> 24) / 1000.0) * (float)((temp_log[1] >> 8) & 0xfff) / 4095.0;
+			hot_v = (1.0 - (float)(int8_t)(temp_log[1] & 0xff) / 1000.0) * (float)((temp_log[1] >> 20) & 0xfff) / 4095.0;
+
+			if (hot_v == room_v)
 			{
-				*v = 3.3 * (float)result / 4095.0;
+				return (STATUS_ERR_BAD_DATA);
 			}
+
+			*v = room_temperature + (adc_counts_to_volts(scan_cache[channel]) - room_v) *
+				(hot_temperature - room_temperature) / (hot_v - room_v);
 			break;
-		}
+
+		case WCM_ADC_CHANNEL_BANDGAP:
+			*v = adc_get_vdd();
+			break;
+
+		default:
+			return (STATUS_ERR_INVALID_ARG);
 	}
-	
-	return (status);
-	
-}	// End of wcm_bat_adc_read
 
+	return (STATUS_OK);
+
+}	// End of wcm_adc_read_channel
+
+
+/****************************************************************************************
+Function to return the number of sequences converted since configuring
+*****************************************************************************************/
+uint32_t wcm_adc_get_scan_count(void)
+{
+	return (scan_count);
+
+}	// End of wcm_adc_get_scan_count
+
+
+/****************************************************************************************
+Function to return the number of sequences started again after a lost interrupt
+*****************************************************************************************/
+uint32_t wcm_adc_get_restart_count(void)
+{
+	return (scan_restarts);
+
+}	// End of wcm_adc_get_restart_count
+
+
+/****************************************************************************************
+ADC interrupt handler, one result ready interrupt per channel of the sequence
+*****************************************************************************************/
+void ADC_Handler(void)
+{
+	uint8_t channel;
+
+	// Reading the result clears the interrupt flag
+	scan_buffer[scan_index] = adc_module_struct.hw->RESULT.reg;
+
+	if (++scan_index < WCM_ADC_CHANNELS)
+	{
+		return;
+	}
+	scan_index = 0;
+
+	for (channel = 0; channel < WCM_ADC_CHANNELS; channel++)
+	{
+		scan_cache[channel] = scan_buffer[channel];
+	}
+	scan_count++;
+	bScanRunning = false;
 
+}	// End of ADC_Handler
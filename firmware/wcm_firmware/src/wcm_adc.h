@@ -14,13 +14,33 @@ Date:
 #ifndef WCM_ADC_H
 #define WCM_ADC_H
 
-void wcm_bat_adc_configure(void);
+#include <stdint.h>
+
+// Time between the starts of two sequences, a sequence takes about 60 ms
+#define WCM_ADC_SCAN_PERIOD_MS		100ul
+
+// A sequence not complete after this long has lost an interrupt and is started again
+#define WCM_ADC_SCAN_TIMEOUT_MS		250ul
+
+// Channels of the ADC sequence, in conversion order
+enum wcm_adc_channel
+{
+	WCM_ADC_CHANNEL_LEAK,
+	WCM_ADC_CHANNEL_BATTERY,
+	WCM_ADC_CHANNEL_TEMPERATURE,
+	WCM_ADC_CHANNEL_BANDGAP,
+	WCM_ADC_CHANNELS
+};
+
 void wcm_adc_configure(void);
+void wcm_adc_service(void);
 
 enum status_code wcm_adc_read(float *);
 enum status_code wcm_bat_adc_read(float *);
+enum status_code wcm_adc_read_channel(enum wcm_adc_channel, float *);
+uint32_t wcm_adc_get_scan_count(void);
+uint32_t wcm_adc_get_restart_count(void);
 
 
 #endif	// WCM_ADC_H
 
-
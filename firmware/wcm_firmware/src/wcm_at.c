@@ -0,0 +1,506 @@
+/****************************************************************************************
+wcm_at.c: Marine Mammal Detection (MMD) Wireless Communication Module (WCM) modem AT
+	command functions
+
+Written by:
+	Daayim Asim, B.Eng. Student
+	Computer Engineer Student
+	eSonar Inc.
+
+Date:
+	November 2022
+
+Note(s):
+- Commands are queued with the start of their expected response line (default "OK")
+	and a timeout, and are sent one at a time by wcm_at_service() from the main loop.
+	Lines received before the final result code, including the expected line, are
+	collected and passed to the callback
+- A command stays open until its final result code, so the OK after an expected line
+	such as "+SBDIX:" is never taken for the next command's. "OK" ends it with
+	AT_RESULT_OK if the expected line was seen, "ERROR", "+CME ERROR", "+CMS ERROR" or
+	an OK without the expected line end it with AT_RESULT_ERROR
+- After a timeout the next command is held back until the late final result code
+	arrives, and the lines until then are dropped. If none comes within AT_DRAIN_MS the
+	modem is turned off, so a late reply cannot be credited to another command
+- A command queued with data (wcm_at_queue_data) writes the data when the modem
+	answers AT_DATA_PROMPT, then waits for the final response as usual. The data is
+	not copied, it must be kept until the callback
+- Lines matching a port URC prefix, and any line received while no command is
+	waiting, are passed to the port unsolicited() function
+- The modem is powered when the queue has work: after AT_BOOT_MS "AT" is sent until
+	it answers OK (up to AT_PROBE_ATTEMPTS times), otherwise the queued commands end
+	with AT_RESULT_NO_MODEM. A command queued by one of their callbacks is kept for the
+	next power up. The modem is turned off AT_IDLE_OFF_MS after the queue
+	empties
+- Only the port functions touch the hardware, so the engine builds on a PC
+*****************************************************************************************/
+
+
+#include <string.h>
+#include "wcm_at.h"
+
+
+/****************************************************************************************
+Local variable(s)
+*****************************************************************************************/
+
+struct at_request
+{
+	char command[AT_COMMAND_LENGTH];
+	char expected[AT_EXPECTED_LENGTH];
+	uint32_t timeout_ms;
+	wcm_at_callback callback;
+	const uint8_t *data;
+	uint16_t data_length;
+};
+
+static const struct wcm_at_port *port = NULL;
+
+// Queue of commands, the one at queue_head is sent first
+static struct at_request queue[AT_QUEUE_LENGTH];
+static uint8_t queue_head = 0;
+static uint8_t queue_count = 0;
+
+static enum wcm_at_power_state power_state = AT_POWER_OFF;
+static bool bCommandSent = false;
+static bool bExpectedSeen = false;
+static bool bDraining = false;
+static uint8_t probe_attempts = 0;
+
+// Start of the boot wait, probe or command, of power on and of being idle
+static uint32_t state_start_ms = 0;
+static uint32_t power_on_ms = 0;
+static uint32_t idle_start_ms = 0;
+
+// Line being received and the lines received for the current command
+static char line[AT_RESPONSE_LENGTH];
+static uint8_t line_length = 0;
+static char response[AT_RESPONSE_LENGTH];
+
+static struct wcm_at_stats stats;
+
+
+/****************************************************************************************
+Local function(s)
+*****************************************************************************************/
+
+static bool at_is_error(const char *);
+static bool at_is_unsolicited(const char *);
+static void at_handle_line(void);
+static void at_complete(enum wcm_at_result);
+static void at_power_off(void);
+static void at_send_probe(void);
+
+
+/****************************************************************************************
+Local function to check for a final result code reporting an error
+*****************************************************************************************/
+static bool at_is_error(const char *text)
+{
+	return ((strcmp(text, "ERROR") == 0) || (strncmp(text, "+CME ERROR", 10) == 0) ||
+		(strncmp(text, "+CMS ERROR", 10) == 0));
+
+}	// End of at_is_error
+
+
+/****************************************************************************************
+Local function to check a line against the port URC prefixes
+*****************************************************************************************/
+static bool at_is_unsolicited(const char *text)
+{
+	const char *const *prefix;
+
+	if (port->urc_prefixes == NULL)
+	{
+		return (false);
+	}
+
+	for (prefix = port->urc_prefixes; *prefix != NULL; prefix++)
+	{
+		if (strncmp(text, *prefix, strlen(*prefix)) == 0)
+		{
+			return (true);
+		}
+	}
+
+	return (false);
+
+}	// End of at_is_unsolicited
+
+
+/****************************************************************************************
+Local function to handle a complete line from the modem
+*****************************************************************************************/
+static void at_handle_line(void)
+{
+	struct at_request *request;
+
+	if (at_is_unsolicited(line))
+	{
+		stats.unsolicited++;
+		port->unsolicited(line);
+		return;
+	}
+
+	if (power_state == AT_POWER_PROBING)
+	{
+		// Anything else (the echo, boot messages) is skipped
+		if (strcmp(line, "OK") == 0)
+		{
+			power_state = AT_POWER_READY;
+			stats.power_up_ms = port->get_ms() - power_on_ms;
+			idle_start_ms = port->get_ms();
+		}
+		return;
+	}
+
+	if (bDraining)
+	{
+		// The late reply of a command that timed out
+		if ((strcmp(line, "OK") == 0) || at_is_error(line))
+		{
+			bDraining = false;
+			idle_start_ms = port->get_ms();
+		}
+		return;
+	}
+
+	if ((power_state != AT_POWER_READY) || (bCommandSent == false))
+	{
+		// A stray final result code
+		if (strcmp(line, "OK") == 0)
+		{
+			return;
+		}
+
+		stats.unsolicited++;
+		port->unsolicited(line);
+		return;
+	}
+
+	request = &queue[queue_head];
+
+	// Command echo
+	if (strcmp(line, request->command) == 0)
+	{
+		return;
+	}
+
+	if ((request->data != NULL) && (strcmp(line, AT_DATA_PROMPT) == 0))
+	{
+		port->write_data(request->data, request->data_length);
+		return;
+	}
+
+	if (strcmp(line, "OK") == 0)
+	{
+		if (bExpectedSeen || (strcmp(request->expected, "OK") == 0))
+		{
+			at_complete(AT_RESULT_OK);
+		}
+		else
+		{
+			at_complete(AT_RESULT_ERROR);
+		}
+		return;
+	}
+
+	if ((bExpectedSeen == false) && (strncmp(line, request->expected, strlen(request->expected)) == 0))
+	{
+		bExpectedSeen = true;
+	}
+
+	if ((strlen(response) + strlen(line) + 2) <= sizeof(response))
+	{
+		if (response[0] != '\0')
+		{
+			strcat(response, " ");
+		}
+		strcat(response, line);
+	}
+
+	if (at_is_error(line))
+	{
+		at_complete(AT_RESULT_ERROR);
+	}
+
+}	// End of at_handle_line
+
+
+/****************************************************************************************
+Local function to remove the command at the head of the queue and report its result
+*****************************************************************************************/
+static void at_complete(enum wcm_at_result result)
+{
+	struct at_request request;
+
+	// Removed first so the callback can queue another command
+	request = queue[queue_head];
+	queue_head = (queue_head + 1) % AT_QUEUE_LENGTH;
+	queue_count--;
+	bCommandSent = false;
+	bExpectedSeen = false;
+	idle_start_ms = port->get_ms();
+
+	switch (result)
+	{
+		case AT_RESULT_OK:			stats.ok++;			break;
+		case AT_RESULT_ERROR:		stats.errors++;		break;
+		case AT_RESULT_TIMEOUT:		stats.timeouts++;	break;
+		case AT_RESULT_NO_MODEM:	stats.no_modem++;	break;
+	}
+
+	if (request.callback != NULL)
+	{
+		request.callback(request.command, result, response);
+	}
+	response[0] = '\0';
+
+}	// End of at_complete
+
+
+/****************************************************************************************
+Local function to turn the modem off
+*****************************************************************************************/
+static void at_power_off(void)
+{
+	if (power_state != AT_POWER_OFF)
+	{
+		stats.power_on_ms += port->get_ms() - power_on_ms;
+	}
+
+	port->set_power(false);
+	power_state = AT_POWER_OFF;
+	bCommandSent = false;
+	bExpectedSeen = false;
+	bDraining = false;
+	line_length = 0;
+
+}	// End of at_power_off
+
+
+/****************************************************************************************
+Local function to send "AT" to see if the modem has booted
+*****************************************************************************************/
+static void at_send_probe(void)
+{
+	probe_attempts++;
+	state_start_ms = port->get_ms();
+	port->write("AT\r");
+
+}	// End of at_send_probe
+
+
+/****************************************************************************************
+Function to set the hardware binding and reset the engine, the modem is turned off
+*****************************************************************************************/
+void wcm_at_init(const struct wcm_at_port *at_port)
+{
+	port = at_port;
+
+	power_state = AT_POWER_OFF;
+	queue_head = 0;
+	queue_count = 0;
+	response[0] = '\0';
+	memset(&stats, 0, sizeof(stats));
+
+	at_power_off();
+
+}	// End of wcm_at_init
+
+
+/****************************************************************************************
+Function to queue a command, without the trailing CR
+
+expected is the start of the final response line, NULL for "OK"
+Returns false if the queue is full or a string is too long
+*****************************************************************************************/
+bool wcm_at_queue(const char *command, const char *expected, uint32_t timeout_ms, wcm_at_callback callback)
+{
+	return (wcm_at_queue_data(command, NULL, 0, expected, timeout_ms, callback));
+
+}	// End of wcm_at_queue
+
+
+/****************************************************************************************
+Function to queue a command that writes data after AT_DATA_PROMPT, e.g. AT+SBDWB
+
+data is not copied and must not change until the callback
+*****************************************************************************************/
+bool wcm_at_queue_data(const char *command, const uint8_t *data, uint16_t data_length, const char *expected,
+	uint32_t timeout_ms, wcm_at_callback callback)
+{
+	struct at_request *request;
+
+	if (expected == NULL)
+	{
+		expected = "OK";
+	}
+
+	if ((port == NULL) || (queue_count == AT_QUEUE_LENGTH) ||
+		(strlen(command) >= AT_COMMAND_LENGTH) || (strlen(expected) >= AT_EXPECTED_LENGTH))
+	{
+		return (false);
+	}
+
+	request = &queue[(queue_head + queue_count) % AT_QUEUE_LENGTH];
+	strcpy(request->command, command);
+	strcpy(request->expected, expected);
+	request->timeout_ms = timeout_ms;
+	request->callback = callback;
+	request->data = data;
+	request->data_length = data_length;
+	queue_count++;
+
+	return (true);
+
+}	// End of wcm_at_queue_data
+
+
+/****************************************************************************************
+Function to handle the received lines, timeouts and modem power
+
+Call from the main loop, never waits
+*****************************************************************************************/
+void wcm_at_service(void)
+{
+	uint8_t data;
+	uint8_t failed;
+
+	if (port == NULL)
+	{
+		return;
+	}
+
+	while (port->read_byte(&data))
+	{
+		if ((data == '\r') || (data == '\n'))
+		{
+			if (line_length > 0)
+			{
+				line[line_length] = '\0';
+				line_length = 0;
+				at_handle_line();
+			}
+		}
+		else if (line_length < (sizeof(line) - 1))
+		{
+			line[line_length++] = (char)data;
+		}
+	}
+
+	switch (power_state)
+	{
+		case AT_POWER_OFF:
+			if (queue_count > 0)
+			{
+				port->set_power(true);
+				power_on_ms = port->get_ms();
+				state_start_ms = power_on_ms;
+				power_state = AT_POWER_BOOTING;
+				stats.power_ups++;
+			}
+			break;
+
+		case AT_POWER_BOOTING:
+			if ((port->get_ms() - state_start_ms) >= AT_BOOT_MS)
+			{
+				power_state = AT_POWER_PROBING;
+				probe_attempts = 0;
+				at_send_probe();
+			}
+			break;
+
+		case AT_POWER_PROBING:
+			if ((port->get_ms() - state_start_ms) >= AT_PROBE_TIMEOUT_MS)
+			{
+				if (probe_attempts < AT_PROBE_ATTEMPTS)
+				{
+					at_send_probe();
+				}
+				else
+				{
+					at_power_off();
+
+					// Only the commands queued now, one a callback queues waits for
+					// the next power up
+					failed = queue_count;
+					while (failed > 0)
+					{
+						at_complete(AT_RESULT_NO_MODEM);
+						failed--;
+					}
+				}
+			}
+			break;
+
+		case AT_POWER_READY:
+			if (bCommandSent)
+			{
+				if ((port->get_ms() - state_start_ms) >= queue[queue_head].timeout_ms)
+				{
+					at_complete(AT_RESULT_TIMEOUT);
+					bDraining = true;
+					state_start_ms = port->get_ms();
+				}
+			}
+			else if (bDraining)
+			{
+				if ((port->get_ms() - state_start_ms) >= AT_DRAIN_MS)
+				{
+					at_power_off();
+				}
+			}
+			else if (queue_count > 0)
+			{
+				response[0] = '\0';
+				port->write(queue[queue_head].command);
+				port->write("\r");
+				bCommandSent = true;
+				state_start_ms = port->get_ms();
+				stats.commands++;
+			}
+			else if ((port->get_ms() - idle_start_ms) >= AT_IDLE_OFF_MS)
+			{
+				at_power_off();
+			}
+			break;
+	}
+
+}	// End of wcm_at_service
+
+
+/****************************************************************************************
+Function to return true while commands are queued or the modem is on
+*****************************************************************************************/
+bool wcm_at_busy(void)
+{
+	return ((queue_count > 0) || (power_state != AT_POWER_OFF));
+
+}	// End of wcm_at_busy
+
+
+/****************************************************************************************
+Function to return the modem power state
+*****************************************************************************************/
+enum wcm_at_power_state wcm_at_get_power_state(void)
+{
+	return (power_state);
+
+}	// End of wcm_at_get_power_state
+
+
+/****************************************************************************************
+Function to copy the engine statistics, power_on_ms includes the time since the modem
+was turned on
+*****************************************************************************************/
+void wcm_at_get_stats(struct wcm_at_stats *at_stats)
+{
+	*at_stats = stats;
+
+	if (power_state != AT_POWER_OFF)
+	{
+		at_stats->power_on_ms += port->get_ms() - power_on_ms;
+	}
+
+}	// End of wcm_at_get_stats
@@ -0,0 +1,96 @@
+/****************************************************************************************
+wcm_at.h: Include file for wcm_at.c
+
+Written by:
+	Daayim Asim, B.Eng. Student
+	Computer Engineer Student
+	eSonar Inc.
+
+Date:
+	November 2022
+*****************************************************************************************/
+
+
+#ifndef WCM_AT_H
+#define WCM_AT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define AT_COMMAND_LENGTH			48
+#define AT_EXPECTED_LENGTH			16
+#define AT_RESPONSE_LENGTH			128
+#define AT_QUEUE_LENGTH				8
+
+// Modem power up: wait AT_BOOT_MS, then send "AT" until it answers OK
+#define AT_BOOT_MS					1000ul
+#define AT_PROBE_TIMEOUT_MS			1000ul
+#define AT_PROBE_ATTEMPTS			10
+
+// After a timeout, time to wait for the late final result code before turning the modem off
+#define AT_DRAIN_MS					5000ul
+
+// The modem is turned off after the queue has been empty this long
+#define AT_IDLE_OFF_MS				5000ul
+
+// Line after which the data of wcm_at_queue_data() is written, as for AT+SBDWB
+#define AT_DATA_PROMPT				"READY"
+
+enum wcm_at_result
+{
+	AT_RESULT_OK,
+	AT_RESULT_ERROR,
+	AT_RESULT_TIMEOUT,
+	AT_RESULT_NO_MODEM
+};
+
+enum wcm_at_power_state
+{
+	AT_POWER_OFF,
+	AT_POWER_BOOTING,
+	AT_POWER_PROBING,
+	AT_POWER_READY
+};
+
+// Called when a queued command finishes, response holds the lines before the result
+typedef void (*wcm_at_callback)(const char *command, enum wcm_at_result result, const char *response);
+
+// Hardware binding, so the engine can also run on a PC against a fake modem
+struct wcm_at_port
+{
+	bool (*read_byte)(uint8_t *);
+	void (*write)(const char *);
+	void (*write_data)(const uint8_t *, uint16_t);
+	uint32_t (*get_ms)(void);
+	void (*set_power)(bool);
+
+	// Lines starting with one of these (NULL terminated) are unsolicited result codes
+	const char *const *urc_prefixes;
+	void (*unsolicited)(const char *);
+};
+
+struct wcm_at_stats
+{
+	uint32_t commands;
+	uint32_t ok;
+	uint32_t errors;
+	uint32_t timeouts;
+	uint32_t no_modem;
+	uint32_t unsolicited;
+	uint32_t power_ups;
+	uint32_t power_up_ms;			// Last power on to ready time
+	uint32_t power_on_ms;			// Total time powered
+};
+
+void wcm_at_init(const struct wcm_at_port *);
+bool wcm_at_queue(const char *, const char *, uint32_t, wcm_at_callback);
+bool wcm_at_queue_data(const char *, const uint8_t *, uint16_t, const char *, uint32_t, wcm_at_callback);
+void wcm_at_service(void);
+
+bool wcm_at_busy(void);
+enum wcm_at_power_state wcm_at_get_power_state(void);
+void wcm_at_get_stats(struct wcm_at_stats *);
+
+
+#endif	// WCM_AT_H
+
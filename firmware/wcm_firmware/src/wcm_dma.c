@@ -0,0 +1,399 @@
+/****************************************************************************************
+wcm_dma.c: Marine Mammal Detection (MMD) Wireless Communication Module (WCM) DMA
+	controller functions
+
+Written by:
+	Daayim Asim, B.Eng. Student
+	Computer Engineer Student
+	eSonar Inc.
+
+Date:
+	November 2022
+
+Note(s):
+- ASF 3 has no DMAC driver in this project, so the controller is driven through its
+	registers. Each channel has one descriptor (no linked lists) and moves one beat
+	per peripheral trigger, here a SERCOM DATA empty
+- The channels send the PC and SAT/CELL transmit queues of wcm_usart.c. The SPI
+	(SERCOM5) has no DMA trigger on the L21 and the GPS only gets short commands
+- The done function is called from DMAC_Handler() when the block has been moved or
+	on a transfer error. wcm_dma_abort() only calls it for a block that finished
+	before the interrupt was taken
+- The descriptors are in the low power RAM (.lpram) as the DMAC expects on the L21
+- read_dma_stats sends "DMA <channel> <blocks> <beats> <errors> <aborts> <CPU ms
+	saved>" for each channel, the CPU time being the time usart_write_buffer_wait()
+	would have waited for the same bytes
+*****************************************************************************************/
+
+
+#include <clock.h>
+#include <stdio.h>
+#include <string.h>
+#include <system_interrupt.h>
+#include "wcm_dma.h"
+#include "wcm_usart.h"
+
+
+struct dma_channel
+{
+	struct wcm_dma_channel_config config;
+	volatile bool bBusy;
+	uint16_t beats_requested;
+
+	// Statistics
+	uint32_t blocks;
+	uint32_t beats;
+	uint32_t errors;
+	uint32_t aborts;
+	uint64_t saved_ns;
+};
+
+
+/****************************************************************************************
+Local variable(s)
+*****************************************************************************************/
+
+COMPILER_ALIGNED(16) static DmacDescriptor descriptors[WCM_DMA_CHANNELS] SECTION_DMAC_DESCRIPTOR;
+COMPILER_ALIGNED(16) static DmacDescriptor write_back[WCM_DMA_CHANNELS] SECTION_DMAC_DESCRIPTOR;
+
+static struct dma_channel channels[WCM_DMA_CHANNELS];
+
+static bool bInitialized = false;
+
+static const char *const channel_names[WCM_DMA_CHANNELS] = {"PC_TX", "COM_TX"};
+
+
+/****************************************************************************************
+Local function(s)
+*****************************************************************************************/
+
+static uint16_t dma_remaining(uint8_t);
+static void dma_account(struct dma_channel *, uint16_t);
+
+
+/****************************************************************************************
+Local function to return the beats a started channel has left to move, called with
+the interrupts disabled
+*****************************************************************************************/
+static uint16_t dma_remaining(uint8_t channel)
+{
+	uint32_t active;
+
+	// The write-back descriptor is only current while the channel is not moving a beat
+	active = DMAC->ACTIVE.reg;
+	if ((active & DMAC_ACTIVE_ABUSY) && (((active & DMAC_ACTIVE_ID_Msk) >> DMAC_ACTIVE_ID_Pos) == channel))
+	{
+		return ((uint16_t)((active & DMAC_ACTIVE_BTCNT_Msk) >> DMAC_ACTIVE_BTCNT_Pos));
+	}
+
+	return (write_back[channel].BTCNT.reg);
+
+}	// End of dma_remaining
+
+
+/****************************************************************************************
+Local function to add the beats moved by the last block to the statistics
+*****************************************************************************************/
+static void dma_account(struct dma_channel *dma, uint16_t beats)
+{
+	dma->beats += beats;
+	dma->saved_ns += (uint64_t)beats * dma->config.cpu_ns_per_beat;
+
+}	// End of dma_account
+
+
+/****************************************************************************************
+Function to reset and enable the DMA controller
+*****************************************************************************************/
+void wcm_dma_init(void)
+{
+	memset(descriptors, 0, sizeof(descriptors));
+	memset(write_back, 0, sizeof(write_back));
+	memset(channels, 0, sizeof(channels));
+
+	system_ahb_clock_set_mask(MCLK_AHBMASK_DMAC);
+
+	DMAC->CTRL.reg &= ~DMAC_CTRL_DMAENABLE;
+	DMAC->CTRL.reg = DMAC_CTRL_SWRST;
+	while (DMAC->CTRL.reg & DMAC_CTRL_SWRST)
+	{
+	}
+
+	DMAC->BASEADDR.reg = (uint32_t)descriptors;
+	DMAC->WRBADDR.reg = (uint32_t)write_back;
+	DMAC->CTRL.reg = DMAC_CTRL_DMAENABLE | DMAC_CTRL_LVLEN(0x0f);
+
+	system_interrupt_enable(SYSTEM_INTERRUPT_MODULE_DMA);
+
+	bInitialized = true;
+
+}	// End of wcm_dma_init
+
+
+/****************************************************************************************
+Function to reset a channel and set its trigger, beat size and addressing
+
+Returns STATUS_ERR_NOT_INITIALIZED before wcm_dma_init(), the owner then moves the data
+itself
+*****************************************************************************************/
+enum status_code wcm_dma_configure(uint8_t channel, const struct wcm_dma_channel_config *config)
+{
+	if (channel >= WCM_DMA_CHANNELS)
+	{
+		return (STATUS_ERR_INVALID_ARG);
+	}
+	if (bInitialized == false)
+	{
+		return (STATUS_ERR_NOT_INITIALIZED);
+	}
+
+	system_interrupt_enter_critical_section();
+
+	channels[channel].config = *config;
+	channels[channel].bBusy = false;
+
+	DMAC->CHID.reg = DMAC_CHID_ID(channel);
+	DMAC->CHCTRLA.reg &= ~DMAC_CHCTRLA_ENABLE;
+	DMAC->CHCTRLA.reg = DMAC_CHCTRLA_SWRST;
+	while (DMAC->CHCTRLA.reg & DMAC_CHCTRLA_SWRST)
+	{
+	}
+
+	DMAC->CHCTRLA.reg = (config->bRunInStandby) ? DMAC_CHCTRLA_RUNSTDBY : 0;
+	DMAC->CHCTRLB.reg = DMAC_CHCTRLB_LVL(0) | DMAC_CHCTRLB_TRIGSRC(config->trigger) | DMAC_CHCTRLB_TRIGACT_BEAT;
+	DMAC->CHINTENSET.reg = DMAC_CHINTENSET_TERR | DMAC_CHINTENSET_TCMPL;
+
+	system_interrupt_leave_critical_section();
+
+	return (STATUS_OK);
+
+}	// End of wcm_dma_configure
+
+
+/****************************************************************************************
+Function to start moving a block of beats. An incrementing address is the first beat,
+the descriptor holds the address after the last one
+
+Returns STATUS_BUSY if the channel has not finished the last block
+*****************************************************************************************/
+enum status_code wcm_dma_start(uint8_t channel, const volatile void *source, volatile void *destination, uint16_t beats)
+{
+	struct dma_channel *dma;
+	DmacDescriptor *descriptor;
+	uint16_t btctrl;
+	uint32_t length;
+
+	if ((channel >= WCM_DMA_CHANNELS) || (beats == 0))
+	{
+		return (STATUS_ERR_INVALID_ARG);
+	}
+	if (bInitialized == false)
+	{
+		return (STATUS_ERR_NOT_INITIALIZED);
+	}
+
+	dma = &channels[channel];
+	descriptor = &descriptors[channel];
+
+	system_interrupt_enter_critical_section();
+
+	if (dma->bBusy)
+	{
+		system_interrupt_leave_critical_section();
+		return (STATUS_BUSY);
+	}
+
+	btctrl = DMAC_BTCTRL_VALID | DMAC_BTCTRL_BLOCKACT_INT;
+	btctrl |= (dma->config.bHalfWord) ? DMAC_BTCTRL_BEATSIZE_HWORD : DMAC_BTCTRL_BEATSIZE_BYTE;
+	length = (dma->config.bHalfWord) ? 2ul * beats : beats;
+
+	descriptor->SRCADDR.reg = (uint32_t)source;
+	if (dma->config.bSourceIncrement)
+	{
+		btctrl |= DMAC_BTCTRL_SRCINC;
+		descriptor->SRCADDR.reg += length;
+	}
+
+	descriptor->DSTADDR.reg = (uint32_t)destination;
+	if (dma->config.bDestinationIncrement)
+	{
+		btctrl |= DMAC_BTCTRL_DSTINC;
+		descriptor->DSTADDR.reg += length;
+	}
+
+	descriptor->BTCTRL.reg = btctrl;
+	descriptor->BTCNT.reg = beats;
+	descriptor->DESCADDR.reg = 0;
+
+	// Read by dma_remaining() until the first beat is moved
+	write_back[channel].BTCNT.reg = beats;
+
+	dma->beats_requested = beats;
+	dma->bBusy = true;
+
+	DMAC->CHID.reg = DMAC_CHID_ID(channel);
+	DMAC->CHINTFLAG.reg = DMAC_CHINTFLAG_MASK;
+	DMAC->CHCTRLA.reg |= DMAC_CHCTRLA_ENABLE;
+
+	system_interrupt_leave_critical_section();
+
+	return (STATUS_OK);
+
+}	// End of wcm_dma_start
+
+
+/****************************************************************************************
+Function to stop a channel after the beat it is moving, the done function is not
+called unless the block had already finished
+*****************************************************************************************/
+void wcm_dma_abort(uint8_t channel)
+{
+	struct dma_channel *dma;
+	uint8_t flags;
+
+	if ((channel >= WCM_DMA_CHANNELS) || (bInitialized == false))
+	{
+		return;
+	}
+
+	dma = &channels[channel];
+
+	system_interrupt_enter_critical_section();
+
+	DMAC->CHID.reg = DMAC_CHID_ID(channel);
+	DMAC->CHCTRLA.reg &= ~DMAC_CHCTRLA_ENABLE;
+	while (DMAC->CHCTRLA.reg & DMAC_CHCTRLA_ENABLE)
+	{
+	}
+
+	if (dma->bBusy)
+	{
+		dma->bBusy = false;
+
+		flags = DMAC->CHINTFLAG.reg;
+		if (flags & DMAC_CHINTFLAG_TCMPL)
+		{
+			dma->blocks++;
+			dma_account(dma, dma->beats_requested);
+
+			if (dma->config.done != NULL)
+			{
+				dma->config.done(channel, false);
+			}
+		}
+		else
+		{
+			dma->aborts++;
+			dma_account(dma, dma->beats_requested - write_back[channel].BTCNT.reg);
+		}
+	}
+
+	DMAC->CHINTFLAG.reg = DMAC_CHINTFLAG_MASK;
+
+	system_interrupt_leave_critical_section();
+
+}	// End of wcm_dma_abort
+
+
+/****************************************************************************************
+Function to return true while a channel is moving a block
+*****************************************************************************************/
+bool wcm_dma_busy(uint8_t channel)
+{
+	return ((channel < WCM_DMA_CHANNELS) && channels[channel].bBusy);
+
+}	// End of wcm_dma_busy
+
+
+/****************************************************************************************
+Function to return the beats a channel has left to move, 0 when it is not busy
+*****************************************************************************************/
+uint16_t wcm_dma_get_remaining(uint8_t channel)
+{
+	uint16_t remaining = 0;
+
+	if (wcm_dma_busy(channel) == false)
+	{
+		return (0);
+	}
+
+	system_interrupt_enter_critical_section();
+	if (channels[channel].bBusy)
+	{
+		remaining = dma_remaining(channel);
+	}
+	system_interrupt_leave_critical_section();
+
+	return (remaining);
+
+}	// End of wcm_dma_get_remaining
+
+
+/****************************************************************************************
+Function to send the statistics of each channel to the PC
+*****************************************************************************************/
+void wcm_dma_report(void)
+{
+	char response[80];
+	uint8_t channel;
+	struct dma_channel *dma;
+
+	for (channel = 0; channel < WCM_DMA_CHANNELS; channel++)
+	{
+		dma = &channels[channel];
+
+		sprintf(response, "DMA %s %lu %lu %lu %lu %lu\r\n", channel_names[channel],
+			(unsigned long)dma->blocks, (unsigned long)dma->beats, (unsigned long)dma->errors,
+			(unsigned long)dma->aborts, (unsigned long)(dma->saved_ns / 1000000ull));
+		wcm_usart_send_pc_message(response);
+	}
+
+}	// End of wcm_dma_report
+
+
+/****************************************************************************************
+DMA controller interrupt handler, one channel transfer complete or error per call
+*****************************************************************************************/
+void DMAC_Handler(void)
+{
+	struct dma_channel *dma;
+	uint8_t channel;
+	uint8_t flags;
+	bool bError;
+
+	channel = DMAC->INTPEND.reg & DMAC_INTPEND_ID_Msk;
+
+	DMAC->CHID.reg = DMAC_CHID_ID(channel);
+	flags = DMAC->CHINTFLAG.reg & (DMAC_CHINTFLAG_TERR | DMAC_CHINTFLAG_TCMPL);
+	DMAC->CHINTFLAG.reg = flags;
+
+	if ((channel >= WCM_DMA_CHANNELS) || (flags == 0))
+	{
+		return;
+	}
+
+	dma = &channels[channel];
+	if (dma->bBusy == false)
+	{
+		return;
+	}
+	dma->bBusy = false;
+
+	bError = (flags & DMAC_CHINTFLAG_TERR) != 0;
+	if (bError)
+	{
+		dma->errors++;
+		dma_account(dma, dma->beats_requested - write_back[channel].BTCNT.reg);
+	}
+	else
+	{
+		dma->blocks++;
+		dma_account(dma, dma->beats_requested);
+	}
+
+	if (dma->config.done != NULL)
+	{
+		dma->config.done(channel, bError);
+	}
+
+}	// End of DMAC_Handler
@@ -0,0 +1,47 @@
+/****************************************************************************************
+wcm_dma.h: Include file for wcm_dma.c
+
+Written by:
+	Daayim Asim, B.Eng. Student
+	Computer Engineer Student
+	eSonar Inc.
+
+Date:
+	November 2022
+*****************************************************************************************/
+
+
+#ifndef WCM_DMA_H
+#define WCM_DMA_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <status_codes.h>
+
+#define WCM_DMA_CHANNEL_PC_TX			0
+#define WCM_DMA_CHANNEL_COM_TX			1
+#define WCM_DMA_CHANNELS				2
+
+struct wcm_dma_channel_config
+{
+	uint8_t trigger;				// xxx_DMAC_ID_xxx, one beat per trigger
+	bool bHalfWord;					// 16 bit beats, otherwise 8 bit
+	bool bSourceIncrement;
+	bool bDestinationIncrement;
+	bool bRunInStandby;
+	uint32_t cpu_ns_per_beat;		// CPU time per beat without the DMA, for wcm_dma_report()
+	void (*done)(uint8_t, bool);	// Channel, true on a transfer error. Called from the interrupt
+};
+
+void wcm_dma_init(void);
+enum status_code wcm_dma_configure(uint8_t, const struct wcm_dma_channel_config *);
+
+enum status_code wcm_dma_start(uint8_t, const volatile void *, volatile void *, uint16_t);
+void wcm_dma_abort(uint8_t);
+bool wcm_dma_busy(uint8_t);
+uint16_t wcm_dma_get_remaining(uint8_t);
+
+void wcm_dma_report(void);
+
+
+#endif	// WCM_DMA_H
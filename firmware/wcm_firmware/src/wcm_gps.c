@@ -0,0 +1,441 @@
+/****************************************************************************************
+wcm_gps.c: Marine Mammal Detection (MMD) Wireless Communication Module (WCM) GPS
+	functions
+
+Written by:
+	Daayim Asim, B.Eng. Student
+	Computer Engineer Student
+	eSonar Inc.
+
+Date:
+	November 2022
+
+Note(s):
+- The GPS bytes are buffered by the SERCOM1 receive interrupt (wcm_usart.c) and
+	wcm_gps_service() parses them a byte at a time from the main loop, so reading the
+	GPS never waits for a sentence
+- GGA, RMC and GSA sentences with a good checksum update the latest fix, other
+	sentences are counted and ignored. Any talker ID (GP, GN, GL...) is accepted
+- read_gps sends "GPS <hhmmss> <ddmmyy> <latitude> <longitude> <quality> <satellites>
+	<HDOP> <fix type> <age ms>", the age is -1 before the first fix
+- read_gps_stats sends "GPS_STATS <parsed> <dropped> <checksum errors> <ignored>
+	<receive overflows>". Dropped counts sentences that were cut short, too long or
+	had a bad or missing checksum
+*****************************************************************************************/
+
+
+#include <stdio.h>
+#include <string.h>
+#include "wcm_gps.h"
+#include "wcm_timer.h"
+#include "wcm_usart.h"
+
+
+/****************************************************************************************
+Local variable(s)
+*****************************************************************************************/
+
+// Sentence being received, without the '$'
+static char sentence[GPS_SENTENCE_LENGTH + 1];
+static uint8_t sentence_length = 0;
+static bool bInSentence = false;
+
+static struct wcm_gps_fix fix;
+static bool bHaveFix = false;
+
+// Statistics
+static uint32_t sentences_parsed = 0;
+static uint32_t sentences_dropped = 0;
+static uint32_t checksum_errors = 0;
+static uint32_t sentences_ignored = 0;
+
+
+/****************************************************************************************
+Local function(s)
+*****************************************************************************************/
+
+static void gps_receive(uint8_t);
+static void gps_parse_sentence(void);
+static const char *gps_field(uint8_t);
+static bool gps_parse_fixed(const char *, uint8_t, int32_t *);
+static bool gps_parse_coordinate(const char *, const char *, int32_t *);
+static void gps_parse_gga(void);
+static void gps_parse_rmc(void);
+static void gps_parse_gsa(void);
+
+
+/****************************************************************************************
+Local function to add a received byte to the sentence, parsing it at the end of line
+*****************************************************************************************/
+static void gps_receive(uint8_t data)
+{
+	if (data == '$')
+	{
+		// A new sentence before the end of the last one
+		if (bInSentence)
+		{
+			sentences_dropped++;
+		}
+		bInSentence = true;
+		sentence_length = 0;
+	}
+	else if (bInSentence == false)
+	{
+		return;
+	}
+	else if ((data == '\r') || (data == '\n'))
+	{
+		bInSentence = false;
+		sentence[sentence_length] = '\0';
+		gps_parse_sentence();
+	}
+	else if (sentence_length >= GPS_SENTENCE_LENGTH)
+	{
+		bInSentence = false;
+		sentences_dropped++;
+	}
+	else
+	{
+		sentence[sentence_length++] = (char)data;
+	}
+
+}	// End of gps_receive
+
+
+/****************************************************************************************
+Local function to check the checksum of a complete sentence and update the fix
+*****************************************************************************************/
+static void gps_parse_sentence(void)
+{
+	char *star;
+	char *p;
+	uint8_t checksum;
+	unsigned int received_checksum;
+
+	star = strchr(sentence, '*');
+	if ((star == NULL) || (strlen(star) < 3) || (sscanf(star + 1, "%2x", &received_checksum) != 1))
+	{
+		sentences_dropped++;
+		return;
+	}
+
+	checksum = 0;
+	for (p = sentence; p < star; p++)
+	{
+		checksum ^= (uint8_t)*p;
+	}
+	if (checksum != (uint8_t)received_checksum)
+	{
+		checksum_errors++;
+		sentences_dropped++;
+		return;
+	}
+	*star = '\0';
+
+	// Two character talker ID, then the sentence type
+	if ((star - sentence) < 6 || sentence[5] != ',')
+	{
+		sentences_ignored++;
+	}
+	else if (strncmp(&sentence[2], "GGA", 3) == 0)
+	{
+		gps_parse_gga();
+		sentences_parsed++;
+	}
+	else if (strncmp(&sentence[2], "RMC", 3) == 0)
+	{
+		gps_parse_rmc();
+		sentences_parsed++;
+	}
+	else if (strncmp(&sentence[2], "GSA", 3) == 0)
+	{
+		gps_parse_gsa();
+		sentences_parsed++;
+	}
+	else
+	{
+		sentences_ignored++;
+	}
+
+}	// End of gps_parse_sentence
+
+
+/****************************************************************************************
+Local function to return the start of a comma separated field, field 0 is the
+sentence type. Returns an empty string if there are not enough fields
+*****************************************************************************************/
+static const char *gps_field(uint8_t index)
+{
+	const char *p = sentence;
+
+	while (index > 0)
+	{
+		p = strchr(p, ',');
+		if (p == NULL)
+		{
+			return ("");
+		}
+		p++;
+		index--;
+	}
+
+	return (p);
+
+}	// End of gps_field
+
+
+/****************************************************************************************
+Local function to read a decimal field as an integer scaled by 10^decimals
+Extra decimal places are truncated. Returns false if the field is empty
+*****************************************************************************************/
+static bool gps_parse_fixed(const char *field, uint8_t decimals, int32_t *value)
+{
+	bool bNegative = false;
+	bool bFraction = false;
+	int32_t result = 0;
+
+	if (*field == '-')
+	{
+		bNegative = true;
+		field++;
+	}
+
+	if ((*field < '0' || *field > '9') && (*field != '.'))
+	{
+		return (false);
+	}
+
+	for ( ; *field != ',' && *field != '\0'; field++)
+	{
+		if (*field == '.')
+		{
+			bFraction = true;
+		}
+		else if (*field >= '0' && *field <= '9')
+		{
+			if (bFraction)
+			{
+				if (decimals == 0)
+				{
+					continue;
+				}
+				decimals--;
+			}
+			result = result * 10 + (*field - '0');
+		}
+		else
+		{
+			break;
+		}
+	}
+
+	// Pad missing decimal places
+	for ( ; decimals > 0; decimals--)
+	{
+		result *= 10;
+	}
+
+	*value = (bNegative) ? -result : result;
+
+	return (true);
+
+}	// End of gps_parse_fixed
+
+
+/****************************************************************************************
+Local function to convert a (d)ddmm.mmmm field and its N/S/E/W field to 1e-6 degree
+Returns false if either field is empty
+*****************************************************************************************/
+static bool gps_parse_coordinate(const char *field, const char *hemisphere, int32_t *value)
+{
+	int32_t minutes;
+	int32_t degrees;
+
+	// Minutes to 1e-5 (dddmmmmmmm), fits 32 bits up to 180 degrees
+	if ((gps_parse_fixed(field, 5, &minutes) == false) || (*hemisphere == ',') || (*hemisphere == '\0'))
+	{
+		return (false);
+	}
+
+	degrees = minutes / 10000000l;
+	minutes -= degrees * 10000000l;
+
+	// 1e-5 minute is 1e-6 / 6 degree
+	*value = degrees * 1000000l + (minutes + 3) / 6;
+	if ((*hemisphere == 'S') || (*hemisphere == 'W'))
+	{
+		*value = -*value;
+	}
+
+	return (true);
+
+}	// End of gps_parse_coordinate
+
+
+/****************************************************************************************
+Local function to handle a GGA (fix data) sentence
+*****************************************************************************************/
+static void gps_parse_gga(void)
+{
+	int32_t value;
+	int32_t latitude;
+	int32_t longitude;
+
+	if (gps_parse_fixed(gps_field(1), 0, &value))
+	{
+		fix.utc_time = (uint32_t)value;
+	}
+
+	fix.quality = (gps_parse_fixed(gps_field(6), 0, &value)) ? (uint8_t)value : 0;
+	fix.satellites = (gps_parse_fixed(gps_field(7), 0, &value)) ? (uint8_t)value : 0;
+	if (gps_parse_fixed(gps_field(8), 2, &value))
+	{
+		fix.hdop = (uint16_t)value;
+	}
+
+	if ((fix.quality != 0) &&
+		gps_parse_coordinate(gps_field(2), gps_field(3), &latitude) &&
+		gps_parse_coordinate(gps_field(4), gps_field(5), &longitude))
+	{
+		fix.latitude = latitude;
+		fix.longitude = longitude;
+		if (gps_parse_fixed(gps_field(9), 1, &value))
+		{
+			fix.altitude = value;
+		}
+		fix.fix_ms = wcm_timer_get_ms();
+		bHaveFix = true;
+	}
+
+}	// End of gps_parse_gga
+
+
+/****************************************************************************************
+Local function to handle an RMC (recommended minimum) sentence
+*****************************************************************************************/
+static void gps_parse_rmc(void)
+{
+	int32_t value;
+	int32_t latitude;
+	int32_t longitude;
+
+	if (gps_parse_fixed(gps_field(1), 0, &value))
+	{
+		fix.utc_time = (uint32_t)value;
+	}
+	if (gps_parse_fixed(gps_field(9), 0, &value))
+	{
+		fix.utc_date = (uint32_t)value;
+	}
+
+	fix.bValid = (*gps_field(2) == 'A');
+	if (fix.bValid &&
+		gps_parse_coordinate(gps_field(3), gps_field(4), &latitude) &&
+		gps_parse_coordinate(gps_field(5), gps_field(6), &longitude))
+	{
+		fix.latitude = latitude;
+		fix.longitude = longitude;
+	}
+
+}	// End of gps_parse_rmc
+
+
+/****************************************************************************************
+Local function to handle a GSA (DOP and active satellites) sentence
+*****************************************************************************************/
+static void gps_parse_gsa(void)
+{
+	int32_t value;
+
+	fix.fix_type = (gps_parse_fixed(gps_field(2), 0, &value)) ? (uint8_t)value : 1;
+	if (gps_parse_fixed(gps_field(16), 2, &value))
+	{
+		fix.hdop = (uint16_t)value;
+	}
+
+}	// End of gps_parse_gsa
+
+
+/****************************************************************************************
+Function to parse the GPS bytes received since the last call
+
+Call from the main loop
+*****************************************************************************************/
+void wcm_gps_service(void)
+{
+	uint8_t data;
+
+	while (wcm_usart_read_gps_byte(&data))
+	{
+		gps_receive(data);
+	}
+
+}	// End of wcm_gps_service
+
+
+/****************************************************************************************
+Function to copy the latest fix
+Returns true if the GPS has had a fix since it was powered
+*****************************************************************************************/
+bool wcm_gps_get_fix(struct wcm_gps_fix *latest)
+{
+	wcm_gps_service();
+
+	*latest = fix;
+
+	return (bHaveFix);
+
+}	// End of wcm_gps_get_fix
+
+
+/****************************************************************************************
+Function to return the milliseconds since the last fix, UINT32_MAX if there has not
+been one
+*****************************************************************************************/
+uint32_t wcm_gps_get_fix_age_ms(void)
+{
+	if (bHaveFix == false)
+	{
+		return (UINT32_MAX);
+	}
+
+	return (wcm_timer_elapsed_ms(fix.fix_ms));
+
+}	// End of wcm_gps_get_fix_age_ms
+
+
+/****************************************************************************************
+Function to send the latest fix to the PC
+*****************************************************************************************/
+void wcm_gps_report(void)
+{
+	char response[128];
+	struct wcm_gps_fix latest;
+	long age;
+
+	age = (wcm_gps_get_fix(&latest)) ? (long)wcm_gps_get_fix_age_ms() : -1l;
+
+	sprintf(response, "GPS %06lu %06lu %.6f %.6f %u %u %.2f %u %ld\r\n",
+		(unsigned long)latest.utc_time, (unsigned long)latest.utc_date,
+		(double)latest.latitude / 1000000.0, (double)latest.longitude / 1000000.0,
+		latest.quality, latest.satellites, (double)latest.hdop / 100.0, latest.fix_type, age);
+	wcm_usart_send_pc_message(response);
+
+}	// End of wcm_gps_report
+
+
+/****************************************************************************************
+Function to send the parser statistics to the PC
+*****************************************************************************************/
+void wcm_gps_report_stats(void)
+{
+	char response[96];
+
+	wcm_gps_service();
+
+	sprintf(response, "GPS_STATS %lu %lu %lu %lu %lu\r\n",
+		(unsigned long)sentences_parsed, (unsigned long)sentences_dropped, (unsigned long)checksum_errors,
+		(unsigned long)sentences_ignored, (unsigned long)wcm_usart_get_gps_overflows());
+	wcm_usart_send_pc_message(response);
+
+}	// End of wcm_gps_report_stats
@@ -0,0 +1,49 @@
+/****************************************************************************************
+wcm_gps.h: Include file for wcm_gps.c
+
+Written by:
+	Daayim Asim, B.Eng. Student
+	Computer Engineer Student
+	eSonar Inc.
+
+Date:
+	November 2022
+*****************************************************************************************/
+
+
+#ifndef WCM_GPS_H
+#define WCM_GPS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Longest NMEA 0183 sentence, '$' to the checksum, without CR LF
+#define GPS_SENTENCE_LENGTH		82
+
+// Latest fix, updated by GGA, RMC and GSA sentences
+struct wcm_gps_fix
+{
+	uint32_t utc_time;			// hhmmss
+	uint32_t utc_date;			// ddmmyy, from RMC
+	int32_t latitude;			// 1e-6 degree, north positive
+	int32_t longitude;			// 1e-6 degree, east positive
+	int32_t altitude;			// 0.1 m above mean sea level
+	uint16_t hdop;				// 0.01
+	uint8_t quality;			// GGA fix quality, 0 = no fix
+	uint8_t satellites;			// GGA satellites used
+	uint8_t fix_type;			// GSA 1 = no fix, 2 = 2D, 3 = 3D
+	bool bValid;				// RMC status A
+	uint32_t fix_ms;			// wcm_timer time of the last GGA with a fix
+};
+
+void wcm_gps_service(void);
+
+bool wcm_gps_get_fix(struct wcm_gps_fix *);
+uint32_t wcm_gps_get_fix_age_ms(void);
+
+void wcm_gps_report(void);
+void wcm_gps_report_stats(void);
+
+
+#endif	// WCM_GPS_H
+
@@ -0,0 +1,271 @@
+/****************************************************************************************
+wcm_gps_manager.c: Marine Mammal Detection (MMD) Wireless Communication Module (WCM) GPS
+	fix scheduling functions
+
+Written by:
+	Daayim Asim, B.Eng. Student
+	Computer Engineer Student
+	eSonar Inc.
+
+Date:
+	November 2022
+
+Note(s):
+- A fix is acquired every period. Between fixes the receiver is either turned off
+	(GPS_PWR_EN) or put in standby with GPS_STANDBY_SENTENCE, keeping its ephemeris so
+	the next fix is a hot start. GPS_IDLE_AUTO picks standby when the period is within
+	GPS_MANAGER_STANDBY_MAX_S
+- An acquisition ends at the first GGA fix received after it started (wcm_gps.c), the
+	receiver is then kept on for GPS_MANAGER_HOLD_MS. It is abandoned after the time to
+	fix budget
+- set_gps_period <period s> <budget s> <0 auto | 1 off | 2 standby>
+- Sends "GPS_FIX <time to fix ms> <OFF | STANDBY>" (what the receiver started from)
+	and "GPS_TIMEOUT <budget ms>"
+- read_gps_manager sends "GPS_MANAGER <state> <period s> <budget s> <mode> <attempts>
+	<fixes> <timeouts> <last time to fix ms> <average from off ms> <average from
+	standby ms> <on ms per fix>". The on time excludes standby, so on ms per fix tracks
+	the energy per fix when tuning the period
+*****************************************************************************************/
+
+
+#include <stdio.h>
+#include "wcm_gps_manager.h"
+#include "wcm_gpio.h"
+#include "wcm_gps.h"
+#include "wcm_timer.h"
+#include "wcm_usart.h"
+
+
+enum gps_manager_state
+{
+	GPS_STATE_OFF,
+	GPS_STATE_STANDBY,
+	GPS_STATE_ACQUIRING,
+	GPS_STATE_HOLD
+};
+
+// Index of the start statistics
+#define GPS_START_OFF					0
+#define GPS_START_STANDBY				1
+
+
+/****************************************************************************************
+Local variable(s)
+*****************************************************************************************/
+
+static uint32_t period_ms = GPS_MANAGER_PERIOD_S * 1000ul;
+static uint32_t budget_ms = GPS_MANAGER_BUDGET_S * 1000ul;
+static enum wcm_gps_idle_mode idle_mode = GPS_IDLE_AUTO;
+
+static enum gps_manager_state state = GPS_STATE_OFF;
+static uint32_t acquire_start_ms = 0;
+static uint32_t hold_start_ms = 0;
+static uint8_t start_type = GPS_START_OFF;
+static bool bRequest = false;
+
+// Statistics
+static uint32_t attempts = 0;
+static uint32_t fixes = 0;
+static uint32_t timeouts = 0;
+static uint32_t last_ttff_ms = 0;
+static uint32_t ttff_total_ms[2] = {0, 0};
+static uint32_t start_fixes[2] = {0, 0};
+static uint32_t on_ms = 0;
+
+static const char *const state_names[] = {"OFF", "STANDBY", "ACQUIRING", "HOLD"};
+
+
+/****************************************************************************************
+Local function(s)
+*****************************************************************************************/
+
+static void gps_manager_acquire(void);
+static void gps_manager_idle(void);
+
+
+/****************************************************************************************
+Local function to power or wake the receiver and start timing a fix
+
+A receiver left in standby may since have been turned off by a PC command, it is then
+powered as from off
+*****************************************************************************************/
+static void gps_manager_acquire(void)
+{
+	if ((state == GPS_STATE_STANDBY) && wcm_gpio_gps_pwr_en_get())
+	{
+		wcm_usart_send_gps_command(GPS_WAKE_SENTENCE);
+		start_type = GPS_START_STANDBY;
+	}
+	else
+	{
+		wcm_gpio_gps_pwr_en_on();
+		start_type = GPS_START_OFF;
+	}
+
+	state = GPS_STATE_ACQUIRING;
+	acquire_start_ms = wcm_timer_get_ms();
+	attempts++;
+	bRequest = false;
+
+}	// End of gps_manager_acquire
+
+
+/****************************************************************************************
+Local function to turn the receiver off or put it in standby until the next fix
+*****************************************************************************************/
+static void gps_manager_idle(void)
+{
+	on_ms += wcm_timer_elapsed_ms(acquire_start_ms);
+
+	if ((idle_mode == GPS_IDLE_STANDBY) ||
+		((idle_mode == GPS_IDLE_AUTO) && (period_ms <= GPS_MANAGER_STANDBY_MAX_S * 1000ul)))
+	{
+		wcm_usart_send_gps_command(GPS_STANDBY_SENTENCE);
+		state = GPS_STATE_STANDBY;
+	}
+	else
+	{
+		wcm_gpio_gps_pwr_en_off();
+		state = GPS_STATE_OFF;
+	}
+
+}	// End of gps_manager_idle
+
+
+/****************************************************************************************
+Function to start the first fix, the receiver is powered by wcm_init()
+*****************************************************************************************/
+void wcm_gps_manager_init(void)
+{
+	state = GPS_STATE_OFF;
+	gps_manager_acquire();
+
+}	// End of wcm_gps_manager_init
+
+
+/****************************************************************************************
+Function to start, time and end the fixes
+
+Call from the main loop after wcm_gps_service()
+*****************************************************************************************/
+void wcm_gps_manager_service(void)
+{
+	char response[48];
+	uint32_t elapsed_ms;
+	uint32_t age_ms;
+
+	switch (state)
+	{
+		case GPS_STATE_OFF:
+		case GPS_STATE_STANDBY:
+			if (bRequest || (wcm_timer_elapsed_ms(acquire_start_ms) >= period_ms))
+			{
+				gps_manager_acquire();
+			}
+			break;
+
+		case GPS_STATE_ACQUIRING:
+			elapsed_ms = wcm_timer_elapsed_ms(acquire_start_ms);
+			age_ms = wcm_gps_get_fix_age_ms();
+
+			// A fix older than the acquisition is the last one
+			if (age_ms <= elapsed_ms)
+			{
+				last_ttff_ms = elapsed_ms - age_ms;
+				fixes++;
+				start_fixes[start_type]++;
+				ttff_total_ms[start_type] += last_ttff_ms;
+
+				sprintf(response, "GPS_FIX %lu %s\r\n", (unsigned long)last_ttff_ms,
+					(start_type == GPS_START_STANDBY) ? "STANDBY" : "OFF");
+				wcm_usart_send_pc_message(response);
+
+				state = GPS_STATE_HOLD;
+				hold_start_ms = wcm_timer_get_ms();
+			}
+			else if (elapsed_ms >= budget_ms)
+			{
+				timeouts++;
+
+				sprintf(response, "GPS_TIMEOUT %lu\r\n", (unsigned long)budget_ms);
+				wcm_usart_send_pc_message(response);
+
+				gps_manager_idle();
+			}
+			break;
+
+		case GPS_STATE_HOLD:
+			if (wcm_timer_elapsed_ms(hold_start_ms) >= GPS_MANAGER_HOLD_MS)
+			{
+				gps_manager_idle();
+			}
+			break;
+	}
+
+}	// End of wcm_gps_manager_service
+
+
+/****************************************************************************************
+Function to set the fix period, time to fix budget and idle mode
+
+Returns STATUS_ERR_INVALID_ARG unless 0 < budget < period
+*****************************************************************************************/
+enum status_code wcm_gps_manager_configure(uint32_t period_s, uint32_t budget_s, enum wcm_gps_idle_mode mode)
+{
+	if ((budget_s == 0) || (budget_s >= period_s) || (period_s > 86400ul) || (mode > GPS_IDLE_STANDBY))
+	{
+		return (STATUS_ERR_INVALID_ARG);
+	}
+
+	period_ms = period_s * 1000ul;
+	budget_ms = budget_s * 1000ul;
+	idle_mode = mode;
+
+	return (STATUS_OK);
+
+}	// End of wcm_gps_manager_configure
+
+
+/****************************************************************************************
+Function to start a fix now rather than at the end of the period
+*****************************************************************************************/
+void wcm_gps_manager_request_fix(void)
+{
+	bRequest = true;
+
+}	// End of wcm_gps_manager_request_fix
+
+
+/****************************************************************************************
+Function to return true while the receiver is acquiring or holding a fix
+*****************************************************************************************/
+bool wcm_gps_manager_busy(void)
+{
+	return ((state == GPS_STATE_ACQUIRING) || (state == GPS_STATE_HOLD));
+
+}	// End of wcm_gps_manager_busy
+
+
+/****************************************************************************************
+Function to send the schedule and time to fix statistics to the PC
+*****************************************************************************************/
+void wcm_gps_manager_report(void)
+{
+	char response[160];
+	uint32_t total_on_ms;
+
+	total_on_ms = on_ms;
+	if (wcm_gps_manager_busy())
+	{
+		total_on_ms += wcm_timer_elapsed_ms(acquire_start_ms);
+	}
+
+	sprintf(response, "GPS_MANAGER %s %lu %lu %u %lu %lu %lu %lu %lu %lu %lu\r\n",
+		state_names[state], (unsigned long)(period_ms / 1000ul), (unsigned long)(budget_ms / 1000ul), idle_mode,
+		(unsigned long)attempts, (unsigned long)fixes, (unsigned long)timeouts, (unsigned long)last_ttff_ms,
+		(unsigned long)((start_fixes[GPS_START_OFF] > 0) ? ttff_total_ms[GPS_START_OFF] / start_fixes[GPS_START_OFF] : 0),
+		(unsigned long)((start_fixes[GPS_START_STANDBY] > 0) ? ttff_total_ms[GPS_START_STANDBY] / start_fixes[GPS_START_STANDBY] : 0),
+		(unsigned long)((fixes > 0) ? total_on_ms / fixes : 0));
+	wcm_usart_send_pc_message(response);
+
+}	// End of wcm_gps_manager_report
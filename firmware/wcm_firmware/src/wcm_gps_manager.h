@@ -0,0 +1,51 @@
+/****************************************************************************************
+wcm_gps_manager.h: Include file for wcm_gps_manager.c
+
+Written by:
+	Daayim Asim, B.Eng. Student
+	Computer Engineer Student
+	eSonar Inc.
+
+Date:
+	November 2022
+*****************************************************************************************/
+
+
+#ifndef WCM_GPS_MANAGER_H
+#define WCM_GPS_MANAGER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <status_codes.h>
+
+#define GPS_MANAGER_PERIOD_S			900ul		// Same as the outbox summaries
+#define GPS_MANAGER_BUDGET_S			120ul		// Time to fix before giving up
+#define GPS_MANAGER_HOLD_MS				2000ul		// Kept on after a fix for RMC and GSA
+
+// In GPS_IDLE_AUTO the receiver is kept in standby when the next fix is due within
+// the ephemeris lifetime, so it hot starts, and is turned off otherwise
+#define GPS_MANAGER_STANDBY_MAX_S		7200ul
+
+// MediaTek (PMTK) standby, any received byte wakes the receiver
+#define GPS_STANDBY_SENTENCE			"$PMTK161,0*28\r\n"
+#define GPS_WAKE_SENTENCE				"$PMTK000*32\r\n"
+
+enum wcm_gps_idle_mode
+{
+	GPS_IDLE_AUTO,
+	GPS_IDLE_OFF,
+	GPS_IDLE_STANDBY
+};
+
+void wcm_gps_manager_init(void);
+void wcm_gps_manager_service(void);
+
+enum status_code wcm_gps_manager_configure(uint32_t, uint32_t, enum wcm_gps_idle_mode);
+void wcm_gps_manager_request_fix(void);
+bool wcm_gps_manager_busy(void);
+
+void wcm_gps_manager_report(void);
+
+
+#endif	// WCM_GPS_MANAGER_H
+
@@ -0,0 +1,707 @@
+/****************************************************************************************
+wcm_outbox.c: Marine Mammal Detection (MMD) Wireless Communication Module (WCM)
+	store-and-forward telemetry functions
+
+Written by:
+	Daayim Asim, B.Eng. Student
+	Computer Engineer Student
+	eSonar Inc.
+
+Date:
+	November 2022
+
+Note(s):
+- Sensor summaries (every OUTBOX_SUMMARY_MS) and alarms (leak above
+	OUTBOX_LEAK_ALARM_V, WCM fault from the PM) are queued as binary records and sent
+	in batches as Iridium SBD messages (AT+SBDWB then AT+SBDIX), so the modem is
+	powered once per batch rather than once per reading
+- A transmission window opens when an alarm is queued, when another summary would
+	not fit in one message or when the oldest summary is OUTBOX_MAX_LATENCY_MS old.
+	Messages are sent back to back while that holds, so the modem is powered once for
+	the batch; the AT engine turns it off after the last one. A failed window is
+	retried after OUTBOX_RETRY_MS
+- A leak or fault alarm is queued once when it appears. The leak alarm is re-armed
+	below OUTBOX_LEAK_CLEAR_V, the fault alarm once the PM has stopped reporting the
+	fault (SPI FAULT) for OUTBOX_FAULT_CLEAR_MS
+- Each message is filled with alarms first, then the oldest summaries
+- Message: version (1), uptime s (4), then records. All values little endian
+	Summary: type 1, uptime s (4), latitude (4), longitude (4) in 1e-6 degree
+		(0x7FFFFFFF without a fix), leak mV (2), battery mV (2), temperature 0.1 C (2)
+	Alarm: type 2 (leak) or 3 (fault), uptime s (4), value (2)
+	A record saved before the last reset has bit 31 of its uptime set, the uptime is
+	from the boot it was queued in
+- When the summary queue is full the oldest summary not in the message being sent is
+	dropped
+- The outbox is saved in the emulated EEPROM after the MC3416 offsets page, as much
+	of it as fits: alarms when queued, otherwise hourly and after each message. The
+	EEPROM size is set by the NVMCTRL_FUSES_EEPROM_SIZE fuse
+- read_outbox sends "OUTBOX <alarm bytes> <summary bytes> <messages> <failed windows>
+	<last message bytes> <average message bytes> <dropped summaries> <modem on s/day>
+	<saved bytes>"
+*****************************************************************************************/
+
+
+#include <eeprom.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "wcm_outbox.h"
+#include "wcm_adc.h"
+#include "wcm_at.h"
+#include "wcm_gps.h"
+#include "wcm_timer.h"
+#include "wcm_usart.h"
+
+
+#define OUTBOX_VERSION				1
+#define OUTBOX_HEADER_LENGTH		5
+#define OUTBOX_SUMMARY_RECORD		19
+#define OUTBOX_ALARM_RECORD			7
+#define OUTBOX_NO_FIX				0x7FFFFFFFl
+#define OUTBOX_PREVIOUS_BOOT		0x80000000ul	// Record uptime flag
+
+// Saved outbox: magic (2), alarm bytes (2), summary bytes (2), then the records
+#define OUTBOX_EEPROM_MAGIC			0x0B0Cu
+#define OUTBOX_EEPROM_OFFSET		EEPROM_PAGE_SIZE
+#define OUTBOX_EEPROM_HEADER		6
+
+
+/****************************************************************************************
+Local variable(s)
+*****************************************************************************************/
+
+// Queued records, oldest first
+static uint8_t alarms[OUTBOX_ALARM_LENGTH];
+static uint16_t alarm_length = 0;
+static uint8_t summaries[OUTBOX_SUMMARY_LENGTH];
+static uint16_t summary_length = 0;
+static uint32_t oldest_summary_ms = 0;
+
+// Message being sent, with the two byte SBD checksum, and the records it holds
+static uint8_t message[OUTBOX_PAYLOAD_LENGTH + 2];
+static uint16_t message_length = 0;
+static uint16_t message_alarm_length = 0;
+static uint16_t message_summary_length = 0;
+
+static bool bWindowOpen = false;
+static bool bSending = false;
+static bool bRetryWait = false;
+static uint32_t retry_start_ms = 0;
+
+static uint32_t last_summary_ms = 0;
+static bool bLeakAlarm = false;
+static bool bFaultAlarm = false;
+static uint32_t last_fault_ms = 0;
+
+static bool bEEPROM = false;
+static uint16_t eeprom_capacity = 0;
+static uint16_t eeprom_saved_length = 0;
+static bool bDirty = false;
+static uint32_t last_persist_ms = 0;
+
+// Statistics
+static uint32_t messages_sent = 0;
+static uint32_t message_bytes_sent = 0;
+static uint16_t last_message_length = 0;
+static uint32_t windows_failed = 0;
+static uint32_t summaries_dropped = 0;
+
+
+/****************************************************************************************
+Local function(s)
+*****************************************************************************************/
+
+static uint8_t outbox_record_length(uint8_t);
+static uint16_t outbox_records_fit(const uint8_t *, uint16_t, uint16_t);
+static uint8_t *outbox_put(uint8_t *, uint32_t, uint8_t);
+static uint32_t outbox_get(const uint8_t *, uint8_t);
+static void outbox_mark_previous_boot(uint8_t *, uint16_t);
+static uint32_t outbox_uptime_s(void);
+static void outbox_persist(void);
+static void outbox_restore(void);
+static bool outbox_window_due(void);
+static void outbox_send_message(void);
+static void outbox_window_failed(void);
+static void outbox_write_done(const char *, enum wcm_at_result, const char *);
+static void outbox_session_done(const char *, enum wcm_at_result, const char *);
+
+
+/****************************************************************************************
+Local function to return the length of a record from its type
+*****************************************************************************************/
+static uint8_t outbox_record_length(uint8_t type)
+{
+	return ((type == OUTBOX_RECORD_SUMMARY) ? OUTBOX_SUMMARY_RECORD : OUTBOX_ALARM_RECORD);
+
+}	// End of outbox_record_length
+
+
+/****************************************************************************************
+Local function to return the length of the whole records at the start of a buffer
+that fit in limit bytes
+*****************************************************************************************/
+static uint16_t outbox_records_fit(const uint8_t *records, uint16_t length, uint16_t limit)
+{
+	uint16_t fit = 0;
+	uint8_t record_length;
+
+	while (fit < length)
+	{
+		record_length = outbox_record_length(records[fit]);
+		if ((fit + record_length) > limit)
+		{
+			break;
+		}
+		fit += record_length;
+	}
+
+	return (fit);
+
+}	// End of outbox_records_fit
+
+
+/****************************************************************************************
+Local function to store a little endian value of 1 to 4 bytes
+Returns the byte after it
+*****************************************************************************************/
+static uint8_t *outbox_put(uint8_t *p, uint32_t value, uint8_t bytes)
+{
+	for ( ; bytes > 0; bytes--)
+	{
+		*p++ = (uint8_t)value;
+		value >>= 8;
+	}
+
+	return (p);
+
+}	// End of outbox_put
+
+
+/****************************************************************************************
+Local function to return a little endian value of 1 to 4 bytes
+*****************************************************************************************/
+static uint32_t outbox_get(const uint8_t *p, uint8_t bytes)
+{
+	uint32_t value = 0;
+
+	while (bytes > 0)
+	{
+		bytes--;
+		value = (value << 8) | p[bytes];
+	}
+
+	return (value);
+
+}	// End of outbox_get
+
+
+/****************************************************************************************
+Local function to flag the uptime of each record as from before the last reset
+*****************************************************************************************/
+static void outbox_mark_previous_boot(uint8_t *records, uint16_t length)
+{
+	uint16_t i;
+
+	for (i = 0; i < length; i += outbox_record_length(records[i]))
+	{
+		outbox_put(&records[i + 1], outbox_get(&records[i + 1], 4) | OUTBOX_PREVIOUS_BOOT, 4);
+	}
+
+}	// End of outbox_mark_previous_boot
+
+
+/****************************************************************************************
+Local function to return the time since power on in seconds
+*****************************************************************************************/
+static uint32_t outbox_uptime_s(void)
+{
+	return (wcm_timer_get_ms() / 1000ul);
+
+}	// End of outbox_uptime_s
+
+
+/****************************************************************************************
+Local function to save the alarms and as many of the oldest summaries as fit
+*****************************************************************************************/
+static void outbox_persist(void)
+{
+	uint8_t header[OUTBOX_EEPROM_HEADER];
+	uint16_t saved_alarms;
+	uint16_t saved_summaries;
+	enum status_code status;
+
+	bDirty = false;
+	last_persist_ms = wcm_timer_get_ms();
+
+	if (bEEPROM == false)
+	{
+		return;
+	}
+
+	saved_alarms = outbox_records_fit(alarms, alarm_length, eeprom_capacity);
+	saved_summaries = outbox_records_fit(summaries, summary_length, eeprom_capacity - saved_alarms);
+
+	outbox_put(outbox_put(outbox_put(header, OUTBOX_EEPROM_MAGIC, 2), saved_alarms, 2), saved_summaries, 2);
+
+	status = eeprom_emulator_write_buffer(OUTBOX_EEPROM_OFFSET, header, OUTBOX_EEPROM_HEADER);
+	if ((status == STATUS_OK) && (saved_alarms > 0))
+	{
+		status = eeprom_emulator_write_buffer(OUTBOX_EEPROM_OFFSET + OUTBOX_EEPROM_HEADER, alarms, saved_alarms);
+	}
+	if ((status == STATUS_OK) && (saved_summaries > 0))
+	{
+		status = eeprom_emulator_write_buffer(OUTBOX_EEPROM_OFFSET + OUTBOX_EEPROM_HEADER + saved_alarms,
+			summaries, saved_summaries);
+	}
+	if (status == STATUS_OK)
+	{
+		status = eeprom_emulator_commit_page_buffer();
+	}
+
+	if (status == STATUS_OK)
+	{
+		eeprom_saved_length = saved_alarms + saved_summaries;
+	}
+	else
+	{
+		wcm_usart_send_pc_message("outbox_persist: Could not write EEPROM!\r\n");
+	}
+
+}	// End of outbox_persist
+
+
+/****************************************************************************************
+Local function to reload the outbox saved before a reset
+*****************************************************************************************/
+static void outbox_restore(void)
+{
+	uint8_t header[OUTBOX_EEPROM_HEADER];
+	uint16_t saved_alarms;
+	uint16_t saved_summaries;
+
+	if (eeprom_emulator_read_buffer(OUTBOX_EEPROM_OFFSET, header, OUTBOX_EEPROM_HEADER) != STATUS_OK)
+	{
+		return;
+	}
+
+	saved_alarms = header[2] | ((uint16_t)header[3] << 8);
+	saved_summaries = header[4] | ((uint16_t)header[5] << 8);
+
+	if (((header[0] | ((uint16_t)header[1] << 8)) != OUTBOX_EEPROM_MAGIC) ||
+		(saved_alarms > OUTBOX_ALARM_LENGTH) || (saved_summaries > OUTBOX_SUMMARY_LENGTH) ||
+		((saved_alarms + saved_summaries) > eeprom_capacity))
+	{
+		return;
+	}
+
+	if ((eeprom_emulator_read_buffer(OUTBOX_EEPROM_OFFSET + OUTBOX_EEPROM_HEADER, alarms, saved_alarms) != STATUS_OK) ||
+		(eeprom_emulator_read_buffer(OUTBOX_EEPROM_OFFSET + OUTBOX_EEPROM_HEADER + saved_alarms, summaries, saved_summaries) != STATUS_OK))
+	{
+		return;
+	}
+
+	// Uptime restarts at 0, so the restored records are flagged as such and sent with
+	// the next window
+	outbox_mark_previous_boot(alarms, saved_alarms);
+	outbox_mark_previous_boot(summaries, saved_summaries);
+	alarm_length = saved_alarms;
+	summary_length = saved_summaries;
+	eeprom_saved_length = saved_alarms + saved_summaries;
+	oldest_summary_ms = wcm_timer_get_ms() - OUTBOX_MAX_LATENCY_MS;
+
+}	// End of outbox_restore
+
+
+/****************************************************************************************
+Local function to check if a transmission window should start
+*****************************************************************************************/
+static bool outbox_window_due(void)
+{
+	if (bRetryWait)
+	{
+		if (wcm_timer_elapsed_ms(retry_start_ms) < OUTBOX_RETRY_MS)
+		{
+			return (false);
+		}
+		bRetryWait = false;
+	}
+
+	if (alarm_length > 0)
+	{
+		return (true);
+	}
+
+	if (summary_length == 0)
+	{
+		return (false);
+	}
+
+	return (((OUTBOX_HEADER_LENGTH + summary_length + OUTBOX_SUMMARY_RECORD) > OUTBOX_PAYLOAD_LENGTH) ||
+		(wcm_timer_elapsed_ms(oldest_summary_ms) >= OUTBOX_MAX_LATENCY_MS));
+
+}	// End of outbox_window_due
+
+
+/****************************************************************************************
+Local function to fill a message with the alarms, then the oldest summaries, and
+queue it to be written to the modem
+*****************************************************************************************/
+static void outbox_send_message(void)
+{
+	char command[24];
+	uint8_t *p;
+	uint16_t checksum;
+	uint16_t i;
+
+	p = outbox_put(message, OUTBOX_VERSION, 1);
+	p = outbox_put(p, outbox_uptime_s(), 4);
+
+	message_alarm_length = outbox_records_fit(alarms, alarm_length, OUTBOX_PAYLOAD_LENGTH - OUTBOX_HEADER_LENGTH);
+	memcpy(p, alarms, message_alarm_length);
+	p += message_alarm_length;
+
+	message_summary_length = outbox_records_fit(summaries, summary_length,
+		OUTBOX_PAYLOAD_LENGTH - OUTBOX_HEADER_LENGTH - message_alarm_length);
+	memcpy(p, summaries, message_summary_length);
+	p += message_summary_length;
+
+	message_length = (uint16_t)(p - message);
+
+	// SBD checksum: sum of the message bytes, high byte first
+	checksum = 0;
+	for (i = 0; i < message_length; i++)
+	{
+		checksum += message[i];
+	}
+	*p++ = (uint8_t)(checksum >> 8);
+	*p = (uint8_t)checksum;
+
+	sprintf(command, "AT+SBDWB=%u", message_length);
+	if (wcm_at_queue_data(command, message, message_length + 2, NULL, 5000ul, outbox_write_done))
+	{
+		bSending = true;
+	}
+	else
+	{
+		outbox_window_failed();
+	}
+
+}	// End of outbox_send_message
+
+
+/****************************************************************************************
+Local function to close a window that could not send, the records are kept
+*****************************************************************************************/
+static void outbox_window_failed(void)
+{
+	bSending = false;
+	bWindowOpen = false;
+	bRetryWait = true;
+	retry_start_ms = wcm_timer_get_ms();
+	windows_failed++;
+
+	wcm_usart_send_pc_message("OUTBOX_FAIL\r\n");
+
+}	// End of outbox_window_failed
+
+
+/****************************************************************************************
+Local AT callback for AT+SBDWB, the modem answers 0 when the message was loaded
+*****************************************************************************************/
+static void outbox_write_done(const char *at_command, enum wcm_at_result result, const char *at_response)
+{
+	(void)at_command;
+
+	if ((result != AT_RESULT_OK) || (at_response[0] != '0') ||
+		(wcm_at_queue("AT+SBDIX", NULL, 60000ul, outbox_session_done) == false))
+	{
+		outbox_window_failed();
+	}
+
+}	// End of outbox_write_done
+
+
+/****************************************************************************************
+Local AT callback for AT+SBDIX, a mobile originated status of 0 to 4 is a success
+*****************************************************************************************/
+static void outbox_session_done(const char *at_command, enum wcm_at_result result, const char *at_response)
+{
+	char response[48];
+	const char *status;
+	uint32_t uptime_s;
+
+	(void)at_command;
+
+	status = strstr(at_response, "+SBDIX:");
+	if ((result != AT_RESULT_OK) || (status == NULL) || (atoi(status + 7) > 4))
+	{
+		outbox_window_failed();
+		return;
+	}
+
+	// Remove the records that were sent
+	alarm_length -= message_alarm_length;
+	memmove(alarms, &alarms[message_alarm_length], alarm_length);
+	summary_length -= message_summary_length;
+	memmove(summaries, &summaries[message_summary_length], summary_length);
+	if ((message_summary_length > 0) && (summary_length > 0))
+	{
+		// Uptime of the oldest summary left, one from before a reset is due now
+		uptime_s = outbox_get(&summaries[1], 4);
+		oldest_summary_ms = (uptime_s & OUTBOX_PREVIOUS_BOOT) ?
+			(wcm_timer_get_ms() - OUTBOX_MAX_LATENCY_MS) : (1000ul * uptime_s);
+	}
+
+	bSending = false;
+	messages_sent++;
+	message_bytes_sent += message_length;
+	last_message_length = message_length;
+	bDirty = true;
+
+	sprintf(response, "OUTBOX_SENT %u\r\n", message_length);
+	wcm_usart_send_pc_message(response);
+
+	// Send the next message in the same window only if it is due, a part filled
+	// message waits for more summaries
+	bWindowOpen = outbox_window_due();
+	if (bWindowOpen == false)
+	{
+		outbox_persist();
+	}
+
+}	// End of outbox_session_done
+
+
+/****************************************************************************************
+Function to set up the outbox, reloading any records saved before a reset
+
+Call after the EEPROM emulator is initialized (MC3416 init)
+*****************************************************************************************/
+void wcm_outbox_init(void)
+{
+	struct eeprom_emulator_parameters parameters;
+	uint16_t eeprom_size;
+
+	last_summary_ms = wcm_timer_get_ms();
+	last_persist_ms = last_summary_ms;
+
+	bEEPROM = false;
+	if (eeprom_emulator_get_parameters(&parameters) == STATUS_OK)
+	{
+		eeprom_size = (uint16_t)parameters.page_size * parameters.eeprom_number_of_pages;
+		if (eeprom_size > (OUTBOX_EEPROM_OFFSET + OUTBOX_EEPROM_HEADER + OUTBOX_ALARM_RECORD))
+		{
+			eeprom_capacity = eeprom_size - OUTBOX_EEPROM_OFFSET - OUTBOX_EEPROM_HEADER;
+			bEEPROM = true;
+			outbox_restore();
+		}
+	}
+
+	if (bEEPROM == false)
+	{
+		wcm_usart_send_pc_message("wcm_outbox_init: No EEPROM, outbox not saved\r\n");
+	}
+
+}	// End of wcm_outbox_init
+
+
+/****************************************************************************************
+Function to queue summaries and alarms and run the transmission windows
+
+Call from the main loop
+*****************************************************************************************/
+void wcm_outbox_service(void)
+{
+	float v;
+
+	if (wcm_timer_elapsed_ms(last_summary_ms) >= OUTBOX_SUMMARY_MS)
+	{
+		last_summary_ms = wcm_timer_get_ms();
+		wcm_outbox_add_summary();
+	}
+
+	if (wcm_adc_read(&v) == STATUS_OK)
+	{
+		if ((bLeakAlarm == false) && (v > OUTBOX_LEAK_ALARM_V))
+		{
+			bLeakAlarm = true;
+			wcm_outbox_add_alarm(OUTBOX_RECORD_LEAK, (uint16_t)(v * 1000.0f));
+		}
+		else if (bLeakAlarm && (v < OUTBOX_LEAK_CLEAR_V))
+		{
+			bLeakAlarm = false;
+		}
+	}
+
+	if (bFaultAlarm && (wcm_timer_elapsed_ms(last_fault_ms) >= OUTBOX_FAULT_CLEAR_MS))
+	{
+		bFaultAlarm = false;
+	}
+
+	if (bDirty && (wcm_timer_elapsed_ms(last_persist_ms) >= OUTBOX_PERSIST_MS))
+	{
+		outbox_persist();
+	}
+
+	if (bSending)
+	{
+		return;
+	}
+
+	if ((bWindowOpen == false) && outbox_window_due())
+	{
+		bWindowOpen = true;
+	}
+
+	if (bWindowOpen)
+	{
+		outbox_send_message();
+	}
+
+}	// End of wcm_outbox_service
+
+
+/****************************************************************************************
+Function to queue a summary of the GPS fix, leak, battery and temperature
+Returns false if the oldest summary had to be dropped
+*****************************************************************************************/
+bool wcm_outbox_add_summary(void)
+{
+	struct wcm_gps_fix fix;
+	bool bHaveFix;
+	bool bRoom = true;
+	uint16_t drop;
+	float leak = 0.0f;
+	float battery = 0.0f;
+	float temperature = 0.0f;
+	uint8_t *p;
+
+	if ((summary_length + OUTBOX_SUMMARY_RECORD) > OUTBOX_SUMMARY_LENGTH)
+	{
+		// The summaries in the message being sent are removed when it goes, so the
+		// oldest one after them is dropped
+		drop = (bSending) ? message_summary_length : 0;
+		summary_length -= OUTBOX_SUMMARY_RECORD;
+		memmove(&summaries[drop], &summaries[drop + OUTBOX_SUMMARY_RECORD], summary_length - drop);
+		summaries_dropped++;
+		bRoom = false;
+	}
+
+	if (summary_length == 0)
+	{
+		oldest_summary_ms = wcm_timer_get_ms();
+	}
+
+	bHaveFix = wcm_gps_get_fix(&fix);
+	wcm_adc_read_channel(WCM_ADC_CHANNEL_LEAK, &leak);
+	wcm_adc_read_channel(WCM_ADC_CHANNEL_BATTERY, &battery);
+	wcm_adc_read_channel(WCM_ADC_CHANNEL_TEMPERATURE, &temperature);
+
+	p = outbox_put(&summaries[summary_length], OUTBOX_RECORD_SUMMARY, 1);
+	p = outbox_put(p, outbox_uptime_s(), 4);
+	p = outbox_put(p, (bHaveFix) ? (uint32_t)fix.latitude : OUTBOX_NO_FIX, 4);
+	p = outbox_put(p, (bHaveFix) ? (uint32_t)fix.longitude : OUTBOX_NO_FIX, 4);
+	p = outbox_put(p, (uint16_t)(leak * 1000.0f), 2);
+	p = outbox_put(p, (uint16_t)(battery * 1000.0f), 2);
+	outbox_put(p, (uint16_t)(int16_t)(temperature * 10.0f), 2);
+	summary_length += OUTBOX_SUMMARY_RECORD;
+
+	bDirty = true;
+
+	return (bRoom);
+
+}	// End of wcm_outbox_add_summary
+
+
+/****************************************************************************************
+Function to queue an alarm, it is saved at once and opens a transmission window
+Returns false if the alarm queue is full
+*****************************************************************************************/
+bool wcm_outbox_add_alarm(enum wcm_outbox_record_type type, uint16_t value)
+{
+	char response[32];
+	uint8_t *p;
+
+	if ((alarm_length + OUTBOX_ALARM_RECORD) > OUTBOX_ALARM_LENGTH)
+	{
+		return (false);
+	}
+
+	p = outbox_put(&alarms[alarm_length], type, 1);
+	p = outbox_put(p, outbox_uptime_s(), 4);
+	outbox_put(p, value, 2);
+	alarm_length += OUTBOX_ALARM_RECORD;
+
+	sprintf(response, "OUTBOX_ALARM %u %u\r\n", type, value);
+	wcm_usart_send_pc_message(response);
+
+	outbox_persist();
+
+	return (true);
+
+}	// End of wcm_outbox_add_alarm
+
+
+/****************************************************************************************
+Function to note a fault reported by the PM, the PM keeps polling FAULT while /WCM_FAULT
+is low so only the first report queues an alarm
+*****************************************************************************************/
+void wcm_outbox_fault_seen(void)
+{
+	last_fault_ms = wcm_timer_get_ms();
+
+	// Left unlatched if the alarm queue is full, so a later report tries again
+	if (bFaultAlarm == false)
+	{
+		bFaultAlarm = wcm_outbox_add_alarm(OUTBOX_RECORD_FAULT, 0);
+	}
+
+}	// End of wcm_outbox_fault_seen
+
+
+/****************************************************************************************
+Function to send a message with whatever is queued, without waiting for it to be due
+*****************************************************************************************/
+void wcm_outbox_send_now(void)
+{
+	if ((alarm_length > 0) || (summary_length > 0))
+	{
+		bRetryWait = false;
+		bWindowOpen = true;
+	}
+
+}	// End of wcm_outbox_send_now
+
+
+/****************************************************************************************
+Function to return the number of bytes waiting to be sent
+*****************************************************************************************/
+uint16_t wcm_outbox_get_length(void)
+{
+	return (alarm_length + summary_length);
+
+}	// End of wcm_outbox_get_length
+
+
+/****************************************************************************************
+Function to send the outbox state and transmission statistics to the PC
+*****************************************************************************************/
+void wcm_outbox_report(void)
+{
+	char response[128];
+	struct wcm_at_stats at_stats;
+	uint32_t uptime_ms;
+	uint32_t on_s_per_day;
+
+	// Modem on time scaled to a day, over the time since power on
+	wcm_at_get_stats(&at_stats);
+	uptime_ms = wcm_timer_get_ms();
+	on_s_per_day = (uptime_ms > 0) ? (uint32_t)(((uint64_t)at_stats.power_on_ms * 86400ull) / uptime_ms) : 0;
+
+	sprintf(response, "OUTBOX %u %u %lu %lu %u %lu %lu %lu %u\r\n",
+		alarm_length, summary_length, (unsigned long)messages_sent, (unsigned long)windows_failed,
+		last_message_length, (unsigned long)((messages_sent > 0) ? message_bytes_sent / messages_sent : 0),
+		(unsigned long)summaries_dropped, (unsigned long)on_s_per_day, eeprom_saved_length);
+	wcm_usart_send_pc_message(response);
+
+}	// End of wcm_outbox_report
@@ -0,0 +1,59 @@
+/****************************************************************************************
+wcm_outbox.h: Include file for wcm_outbox.c
+
+Written by:
+	Daayim Asim, B.Eng. Student
+	Computer Engineer Student
+	eSonar Inc.
+
+Date:
+	November 2022
+*****************************************************************************************/
+
+
+#ifndef WCM_OUTBOX_H
+#define WCM_OUTBOX_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Iridium SBD mobile originated message limit
+#define OUTBOX_PAYLOAD_LENGTH		340
+
+// Records waiting to be sent, the oldest summary is dropped when full
+#define OUTBOX_ALARM_LENGTH			70
+#define OUTBOX_SUMMARY_LENGTH		(2 * OUTBOX_PAYLOAD_LENGTH)
+
+#define OUTBOX_SUMMARY_MS			900000ul		// 15 minutes
+#define OUTBOX_MAX_LATENCY_MS		21600000ul		// 6 hours, oldest summary
+#define OUTBOX_RETRY_MS				600000ul		// 10 minutes after a failed window
+#define OUTBOX_PERSIST_MS			3600000ul		// Summaries saved to EEPROM hourly
+
+// Leak alarm, re-armed below the clear level
+#define OUTBOX_LEAK_ALARM_V			1.5
+#define OUTBOX_LEAK_CLEAR_V			1.45
+
+// Fault alarm, re-armed once the PM has not reported the fault for this long
+#define OUTBOX_FAULT_CLEAR_MS		60000ul
+
+enum wcm_outbox_record_type
+{
+	OUTBOX_RECORD_SUMMARY = 1,
+	OUTBOX_RECORD_LEAK = 2,
+	OUTBOX_RECORD_FAULT = 3
+};
+
+void wcm_outbox_init(void);
+void wcm_outbox_service(void);
+
+bool wcm_outbox_add_summary(void);
+bool wcm_outbox_add_alarm(enum wcm_outbox_record_type, uint16_t);
+void wcm_outbox_fault_seen(void);
+void wcm_outbox_send_now(void);
+
+uint16_t wcm_outbox_get_length(void);
+void wcm_outbox_report(void);
+
+
+#endif	// WCM_OUTBOX_H
+
@@ -29,6 +29,7 @@ Pin		I/O		WCM board pin	Function			Notes:
 #include "wcm_clocks.h"
 #include "wcm_gpio.h"
 #include "wcm_spi.h"
+#include "wcm_timer.h"
 #include "wcm_usart.h"
 #include "wcm_config_codes.h"
 
@@ -190,6 +191,7 @@ void wcm_power_normal_power_mode(void)
 	wcm_usart_configure();
 	wcm_spi_configure(MODE_NORMALPOWER);
 	delay_init();
+	wcm_timer_configure();
 
 }	// End of normal_power_mode
 
@@ -11,6 +11,18 @@ Date:
 
 Note(s):
 - MMD WCM board is configured to be an SPI slave
+- Frames are WCM_SPI_FRAME_LENGTH bytes, delimited by SPI_CS. The next frame is armed
+	from the interrupt at the end of each frame (slave select rising, TXC), so a
+	master that starts the next frame early is still received
+- Two receive frames are used in turn: one is armed while the main loop copies the
+	other (wcm_spi_get_command). A frame that ends short is discarded and the slave
+	re-synchronizes on the next slave select
+- Two transmit frames are used in turn so the armed one is never written.
+	wcm_spi_set_response() swaps in the new response if the armed frame has not
+	started (slave select low detect), otherwise it is sent one frame later and
+	counted as late
+- read_spi_stats sends "SPI_STATS <frames> <commands> <overruns> <resyncs> <late
+	responses> <frames/s> <max frames/s>", the rates are over one second windows
 
 ------------------------------------------------
 SAML21E17B
@@ -26,35 +38,64 @@ Pin		I/O		WCM board pin	Function
 
 #include <spi.h>
 #include <spi_interrupt.h>
+#include <stdio.h>
+#include <string.h>
+#include <system_interrupt.h>
 #include "wcm_spi.h"
+#include "wcm_timer.h"
 #include "wcm_usart.h"
 #include "wcm_config_codes.h"
 
+
 /****************************************************************************************
 Local variable(s)
 *****************************************************************************************/
 
-volatile bool transfer_complete = false;
 static struct spi_module spi_module_struct;
 
+// Receive frames, rx_armed is being received
+static uint8_t rx_frames[2][WCM_SPI_FRAME_LENGTH];
+static volatile bool bFrameReady[2] = {false, false};
+static volatile uint8_t rx_armed = 0;
+static volatile bool bFrameReceived = false;
+
+// Transmit frames, tx_latest is armed at the end of each frame
+static uint8_t tx_frames[2][WCM_SPI_FRAME_LENGTH];
+static volatile uint8_t tx_latest = 0;
+static volatile uint8_t tx_armed = 0;
+
+// Started by wcm_spi_start(), armed while the SERCOM is enabled
+static bool bStarted = false;
+static volatile bool bArmed = false;
+
+// Statistics
+static volatile uint32_t frames = 0;
+static volatile uint32_t overruns = 0;
+static volatile uint32_t resyncs = 0;
+static uint32_t commands = 0;
+static uint32_t late_responses = 0;
+static volatile uint32_t rate_start_ms = 0;
+static volatile uint32_t rate_frames = 0;
+static volatile uint32_t last_rate = 0;
+static volatile uint32_t max_rate = 0;
+
 
 /****************************************************************************************
 Local function(s)
 *****************************************************************************************/
 
-static void spi_slave_callback(struct spi_module *const);
+static enum status_code spi_arm(void);
+static void spi_frame_received_callback(struct spi_module *const);
+static void spi_frame_end_callback(struct spi_module *const);
 
 
 /****************************************************************************************
-Function to configure the MMD WCM SPI
+Function to configure the MMD WCM SPI, frames are re-armed if they were started
 *****************************************************************************************/
 void wcm_spi_configure(uint8_t mode)
 {
 	static bool bFirst = true;
 
-	//spi_slave_configure();
-	//spi_slave_callback_configure();
-
 	struct spi_config spi_config_struct;
 
 	spi_get_config_defaults(&spi_config_struct);
@@ -63,6 +104,7 @@ void wcm_spi_configure(uint8_t mode)
 	spi_config_struct.mode_specific.slave.preload_enable = true;
 	spi_config_struct.mode_specific.slave.frame_format = SPI_FRAME_FORMAT_SPI_FRAME;
 	spi_config_struct.mux_setting = SPI_SIGNAL_MUX_SETTING_D;
+	spi_config_struct.select_slave_low_detect_enable = true;
 
 	spi_config_struct.pinmux_pad0 = PINMUX_PA22D_SERCOM5_PAD0;
 	spi_config_struct.pinmux_pad1 = PINMUX_PA23D_SERCOM5_PAD1;
@@ -78,55 +120,224 @@ void wcm_spi_configure(uint8_t mode)
 		spi_disable(&spi_module_struct);
 	}
 
+	bArmed = false;
+
 	spi_init(&spi_module_struct, SERCOM5, &spi_config_struct);
 
-	spi_register_callback(&spi_module_struct, spi_slave_callback, SPI_CALLBACK_BUFFER_TRANSCEIVED);
+	spi_register_callback(&spi_module_struct, spi_frame_received_callback, SPI_CALLBACK_BUFFER_TRANSCEIVED);
 	spi_enable_callback(&spi_module_struct, SPI_CALLBACK_BUFFER_TRANSCEIVED);
+	spi_register_callback(&spi_module_struct, spi_frame_end_callback, SPI_CALLBACK_SLAVE_TRANSMISSION_COMPLETE);
+	spi_enable_callback(&spi_module_struct, SPI_CALLBACK_SLAVE_TRANSMISSION_COMPLETE);
 
 	spi_enable(&spi_module_struct);
-	
+
 	if (mode == MODE_DISABLED){
 		wcm_usart_send_pc_message("spi disabled!\r\n");
 		spi_disable(&spi_module_struct);
 	}
+	else if (bStarted)
+	{
+		// Re-arm with the last response after leaving low power
+		system_interrupt_enter_critical_section();
+		bArmed = (spi_arm() == STATUS_OK);
+		system_interrupt_leave_critical_section();
+	}
 
 }	// End of wcm_spi_configure
 
 
 /****************************************************************************************
-Function to start an SPI read
+Function to arm the first frame, both transmit frames are set to response until the
+first wcm_spi_set_response()
 *****************************************************************************************/
-enum status_code wcm_spi_start_read(uint8_t *tx_buffer, uint8_t *rx_buffer, int buffer_length)
+enum status_code wcm_spi_start(const char *response)
 {
 	enum status_code status;
 
-	transfer_complete = false;
+	memcpy(tx_frames[0], response, WCM_SPI_FRAME_LENGTH);
+	memcpy(tx_frames[1], response, WCM_SPI_FRAME_LENGTH);
+	tx_latest = 0;
+	bFrameReady[0] = false;
+	bFrameReady[1] = false;
+	rate_start_ms = wcm_timer_get_ms();
 
-//	spi_read_buffer_job(&spi_module_struct, rx_buffer, buffer_length, 0x00);	
-	status = spi_transceive_buffer_job(&spi_module_struct, tx_buffer, rx_buffer, buffer_length);
+	system_interrupt_enter_critical_section();
+	status = spi_arm();
+	bStarted = (status == STATUS_OK);
+	bArmed = bStarted;
+	system_interrupt_leave_critical_section();
 
 	return (status);
 
-}	// End of wcm_spi_start_read
+}	// End of wcm_spi_start
+
+
+/****************************************************************************************
+Function to copy the oldest received frame, null terminated
+Returns false if there is none
+*****************************************************************************************/
+bool wcm_spi_get_command(char *command)
+{
+	bool bReceived = false;
+	uint8_t frame;
+
+	system_interrupt_enter_critical_section();
+
+	// The frame not armed is the older one
+	frame = rx_armed ^ 1;
+	if (bFrameReady[frame] == false)
+	{
+		frame = rx_armed;
+	}
+
+	if (bFrameReady[frame])
+	{
+		memcpy(command, rx_frames[frame], WCM_SPI_FRAME_LENGTH);
+		command[WCM_SPI_FRAME_LENGTH] = '\0';
+		bFrameReady[frame] = false;
+		bReceived = true;
+		commands++;
+	}
+
+	system_interrupt_leave_critical_section();
+
+	return (bReceived);
+
+}	// End of wcm_spi_get_command
+
+
+/****************************************************************************************
+Function to set the response sent in the next frame
+*****************************************************************************************/
+void wcm_spi_set_response(const char *response)
+{
+	SercomSpi *const spi_hw = &(spi_module_struct.hw->SPI);
+	uint8_t frame;
+
+	system_interrupt_enter_critical_section();
+
+	frame = tx_armed ^ 1;
+	memcpy(tx_frames[frame], response, WCM_SPI_FRAME_LENGTH);
+	tx_latest = frame;
+
+	if (bArmed)
+	{
+		if ((spi_hw->INTFLAG.reg & SPI_INTERRUPT_FLAG_SLAVE_SELECT_LOW) == 0)
+		{
+			// Re-enabling the SERCOM drops the first byte already preloaded
+			spi_abort_job(&spi_module_struct);
+			spi_disable(&spi_module_struct);
+			spi_enable(&spi_module_struct);
+			spi_arm();
+		}
+		else
+		{
+			late_responses++;
+		}
+	}
+
+	system_interrupt_leave_critical_section();
+
+}	// End of wcm_spi_set_response
 
 
 /****************************************************************************************
-Function to return the transfer_complete variable
+Function to send the frame statistics to the PC
 *****************************************************************************************/
-bool wcm_spi_transfer_complete(void)
+void wcm_spi_report(void)
 {
-	return (transfer_complete);
-	
-}	// End of wcm_spi_transfer_complete
+	char response[96];
+	uint32_t rate;
+
+	// No frames for a whole window
+	rate = (wcm_timer_elapsed_ms(rate_start_ms) < 2000ul) ? last_rate : 0;
+
+	sprintf(response, "SPI_STATS %lu %lu %lu %lu %lu %lu %lu\r\n",
+		(unsigned long)frames, (unsigned long)commands, (unsigned long)overruns, (unsigned long)resyncs,
+		(unsigned long)late_responses, (unsigned long)rate, (unsigned long)max_rate);
+	wcm_usart_send_pc_message(response);
+
+}	// End of wcm_spi_report
 
 
 /****************************************************************************************
-SPI slave callback function
+Local function to arm the next frame, called with the SPI interrupt blocked
 *****************************************************************************************/
-static void spi_slave_callback(struct spi_module *const module)
+static enum status_code spi_arm(void)
 {
-	transfer_complete = true;
+	SercomSpi *const spi_hw = &(spi_module_struct.hw->SPI);
+	uint8_t frame;
+
+	// Use the frame not waiting for the main loop, or drop the older one
+	frame = rx_armed ^ 1;
+	if (bFrameReady[frame])
+	{
+		if (bFrameReady[rx_armed] == false)
+		{
+			frame = rx_armed;
+		}
+		else
+		{
+			bFrameReady[frame] = false;
+			overruns++;
+		}
+	}
+
+	rx_armed = frame;
+	tx_armed = tx_latest;
+	bFrameReceived = false;
+	spi_hw->INTFLAG.reg = SPI_INTERRUPT_FLAG_SLAVE_SELECT_LOW;
+
+	return (spi_transceive_buffer_job(&spi_module_struct, tx_frames[tx_armed], rx_frames[rx_armed], WCM_SPI_FRAME_LENGTH));
+
+}	// End of spi_arm
 
-}	// End of spi_slave_callback
 
+/****************************************************************************************
+SPI slave callback function for the last byte of a frame
+*****************************************************************************************/
+static void spi_frame_received_callback(struct spi_module *const module)
+{
+	uint32_t now_ms;
+	uint32_t window_ms;
+
+	bFrameReady[rx_armed] = true;
+	bFrameReceived = true;
+	frames++;
+
+	now_ms = wcm_timer_get_ms();
+	window_ms = now_ms - rate_start_ms;
+	rate_frames++;
+	if (window_ms >= 1000ul)
+	{
+		last_rate = (rate_frames * 1000ul) / window_ms;
+		if (last_rate > max_rate)
+		{
+			max_rate = last_rate;
+		}
+		rate_frames = 0;
+		rate_start_ms = now_ms;
+	}
+
+}	// End of spi_frame_received_callback
+
+
+/****************************************************************************************
+SPI slave callback function for slave select going high, which arms the next frame
+*****************************************************************************************/
+static void spi_frame_end_callback(struct spi_module *const module)
+{
+	if (bArmed == false)
+	{
+		return;
+	}
+
+	// Slave select went high part way through the frame
+	if (bFrameReceived == false)
+	{
+		resyncs++;
+	}
+
+	spi_arm();
 
+}	// End of spi_frame_end_callback
@@ -15,9 +15,18 @@ Date:
 #define WCM_SPI_H
 
 
+#include <stdbool.h>
+#include <stdint.h>
+#include <status_codes.h>
+
+// Bytes per command and per response, the MMD frames each with SPI_CS
+#define WCM_SPI_FRAME_LENGTH		8
+
 void wcm_spi_configure(uint8_t);
-enum status_code wcm_spi_start_read(uint8_t *, uint8_t *, int);
-bool wcm_spi_transfer_complete(void);
+enum status_code wcm_spi_start(const char *);
+bool wcm_spi_get_command(char *);
+void wcm_spi_set_response(const char *);
+void wcm_spi_report(void);
 
 
 #endif	// WCM_SPI_H
@@ -0,0 +1,116 @@
+/****************************************************************************************
+wcm_timer.c: Marine Mammal Detection (MMD) Wireless Communication Module (WCM) timer
+	functions
+
+Written by:
+	Daayim Asim, B.Eng. Student
+	Computer Engineer Student
+	eSonar Inc.
+
+Date:
+	November 2022
+
+Note(s):
+- TC4 provides a free running millisecond tick for timeouts and ages (delay_ms() owns
+	SysTick and TC0/TC1 are the 32 bit wcm_run timer)
+- The tick is derived from GCLK generator 0, so it is only valid in normal power mode
+*****************************************************************************************/
+
+
+#include <clock.h>
+#include <tc.h>
+#include <tc_interrupt.h>
+#include "wcm_timer.h"
+
+
+/****************************************************************************************
+Local variable(s)
+*****************************************************************************************/
+
+static struct tc_module timer_module_struct;
+
+// Milliseconds since the timer was first configured
+static volatile uint32_t milliseconds = 0;
+
+
+/****************************************************************************************
+Local function(s)
+*****************************************************************************************/
+
+static void timer_tick_callback(struct tc_module *const);
+
+
+/****************************************************************************************
+Function to configure the TC4 millisecond tick
+
+Must be called after the clocks are configured since the compare value is calculated
+from the GCLK generator 0 frequency
+*****************************************************************************************/
+void wcm_timer_configure(void)
+{
+	static bool bFirst = true;
+
+	struct tc_config tc_config_struct;
+	uint32_t ticks_per_ms;
+
+	tc_get_config_defaults(&tc_config_struct);
+
+	// 12 MHz / 16 = 750 kHz, so the counter wraps at 750 counts every millisecond
+	ticks_per_ms = system_gclk_gen_get_hz(GCLK_GENERATOR_0) / 16ul / 1000ul;
+	if (ticks_per_ms == 0)
+	{
+		ticks_per_ms = 1;
+	}
+
+	tc_config_struct.counter_size = TC_COUNTER_SIZE_16BIT;
+	tc_config_struct.clock_source = GCLK_GENERATOR_0;
+	tc_config_struct.clock_prescaler = TC_CLOCK_PRESCALER_DIV16;
+	tc_config_struct.wave_generation = TC_WAVE_GENERATION_MATCH_FREQ;
+	tc_config_struct.counter_16_bit.compare_capture_channel[0] = (uint16_t)(ticks_per_ms - 1);
+
+	if (bFirst)
+	{
+		bFirst = false;
+	}
+	else
+	{
+		tc_disable(&timer_module_struct);
+	}
+
+	tc_init(&timer_module_struct, TC4, &tc_config_struct);
+	tc_enable(&timer_module_struct);
+
+	tc_register_callback(&timer_module_struct, timer_tick_callback, TC_CALLBACK_OVERFLOW);
+	tc_enable_callback(&timer_module_struct, TC_CALLBACK_OVERFLOW);
+
+}	// End of wcm_timer_configure
+
+
+/****************************************************************************************
+Function to return the number of milliseconds since the timer was configured
+*****************************************************************************************/
+uint32_t wcm_timer_get_ms(void)
+{
+	return (milliseconds);
+
+}	// End of wcm_timer_get_ms
+
+
+/****************************************************************************************
+Function to return the number of milliseconds elapsed since a wcm_timer_get_ms() value
+*****************************************************************************************/
+uint32_t wcm_timer_elapsed_ms(uint32_t since)
+{
+	return (milliseconds - since);
+
+}	// End of wcm_timer_elapsed_ms
+
+
+/****************************************************************************************
+TC4 overflow callback function
+*****************************************************************************************/
+static void timer_tick_callback(struct tc_module *const module)
+{
+	milliseconds++;
+
+}	// End of timer_tick_callback
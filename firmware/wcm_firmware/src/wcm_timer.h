@@ -0,0 +1,26 @@
+/****************************************************************************************
+wcm_timer.h: Include file for wcm_timer.c
+
+Written by:
+	Daayim Asim, B.Eng. Student
+	Computer Engineer Student
+	eSonar Inc.
+
+Date:
+	November 2022
+*****************************************************************************************/
+
+
+#ifndef WCM_TIMER_H
+#define WCM_TIMER_H
+
+#include <stdint.h>
+
+void wcm_timer_configure(void);
+
+uint32_t wcm_timer_get_ms(void);
+uint32_t wcm_timer_elapsed_ms(uint32_t);
+
+
+#endif	// WCM_TIMER_H
+
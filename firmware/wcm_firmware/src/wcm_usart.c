@@ -24,13 +24,30 @@ Pin		I/O		WCM board pin	Function			Atmel Start
 -----------------------------------------------------------------
 
 - For now, using USB_TX and USB_RX for PC communications
+- GPS and SAT/CELL bytes are received by the SERCOM1 and SERCOM0 RXC interrupts into
+	ring buffers, read with wcm_usart_read_gps_byte() and wcm_usart_read_com_byte().
+	The USART driver is in polled mode (USART_CALLBACK_MODE=false), so the handlers
+	are set with _sercom_set_handler()
+- Bytes for the PC and the SAT/CELL are copied into TX_QUEUE_LENGTH byte queues and
+	sent by the DMA (WCM_DMA_CHANNEL_PC_TX and _COM_TX), so a whole SBD message is
+	written without the CPU waiting on the modem rate. The caller only waits when a
+	queue is full, from an interrupt the bytes that do not fit are dropped. A queue
+	is emptied before its port is reconfigured or disabled. Without wcm_dma_init()
+	the bytes are written by the CPU
+- read_dma_stats also sends "TX_QUEUE <PC | COM> <length> <peak bytes> <full waits>
+	<dropped bytes>"
 *****************************************************************************************/
 
 
+#include <sercom_interrupt.h>
+#include <stdio.h>
 #include <string.h>
+#include <system_interrupt.h>
 #include <usart.h>
 #include "wcm_usart.h"
 #include "wcm_config_codes.h"
+#include "wcm_dma.h"
+#include "wcm_timer.h"
 
 
 /****************************************************************************************
@@ -45,6 +62,42 @@ static SercomUsart *pc_usart_hw;
 static SercomUsart *gps_usart_hw;
 static SercomUsart *com_usart_hw;
 
+// Receive ring buffers, written by the SERCOM interrupts
+#define RX_BUFFER_LENGTH		256
+
+struct usart_rx_ring
+{
+	volatile uint8_t buffer[RX_BUFFER_LENGTH];
+	volatile uint16_t head;
+	volatile uint16_t tail;
+	volatile uint32_t overflows;
+};
+
+static struct usart_rx_ring gps_rx;
+static struct usart_rx_ring com_rx;
+
+// Transmit queues, the DMA sends sending bytes from tail
+#define TX_QUEUE_LENGTH			512
+
+struct usart_tx_queue
+{
+	uint8_t buffer[TX_QUEUE_LENGTH];
+	volatile uint16_t head;
+	volatile uint16_t tail;
+	volatile uint16_t sending;
+	uint8_t channel;
+	bool bDma;
+	struct usart_module *module;
+	uint32_t baudrate;
+
+	uint16_t peak;
+	uint32_t full_waits;
+	uint32_t dropped;
+};
+
+static struct usart_tx_queue pc_tx;
+static struct usart_tx_queue com_tx;
+
 
 /****************************************************************************************
 // Local function(s)
@@ -53,6 +106,16 @@ static SercomUsart *com_usart_hw;
 static void pc_usart_configure(uint8_t mode);
 static void gps_usart_configure(uint8_t mode);
 static void com_usart_configure(uint8_t mode);
+static void gps_usart_interrupt(uint8_t instance);
+static void com_usart_interrupt(uint8_t instance);
+static void usart_rx_ring_receive(SercomUsart *, struct usart_rx_ring *);
+static bool usart_rx_ring_read(struct usart_rx_ring *, uint8_t *);
+static void usart_tx_queue_configure(struct usart_tx_queue *, struct usart_module *, uint8_t, uint8_t, uint32_t);
+static void usart_tx_queue_start(struct usart_tx_queue *);
+static void usart_tx_queue_done(uint8_t, bool);
+static void usart_tx_queue_write(struct usart_tx_queue *, const uint8_t *, uint16_t);
+static void usart_tx_queue_flush(struct usart_tx_queue *);
+static void usart_tx_queue_report(const char *, const struct usart_tx_queue *);
 
 /****************************************************************************************
 Function to configure the usart ports for WCM 
@@ -92,41 +155,51 @@ enum status_code wcm_usart_check_for_pc_command(void)
 }	// End of wcm_usart_check_for_pc_command
 
 /***************************************************************************
-Function to check for a data from the gps
+Function to read the next byte received from the GPS
+Returns false if there is none
 ****************************************************************************/
-enum status_code wcm_usart_check_for_gps_data(void)
+bool wcm_usart_read_gps_byte(uint8_t *data)
 {
-	// Check if USART has new data
-	if (gps_usart_hw->INTFLAG.reg & SERCOM_USART_INTFLAG_RXC)
-	{
-		return STATUS_OK;
-	}
+	return (usart_rx_ring_read(&gps_rx, data));
 
-	return STATUS_BUSY;
+}	// End of wcm_usart_read_gps_byte
+
+/***************************************************************************
+Function to return the number of GPS bytes lost to a full buffer or a
+receiver overrun
+****************************************************************************/
+uint32_t wcm_usart_get_gps_overflows(void)
+{
+	return (gps_rx.overflows);
 
-}	// End of wcm_usart_check_for_gps_data
+}	// End of wcm_usart_get_gps_overflows
 
 /***************************************************************************
-Function to check for a command from the Iridium module 
+Function to read the next byte received from the SAT/CELL modem
+Returns false if there is none
 ****************************************************************************/
-enum status_code wcm_usart_check_for_com_data(void)
+bool wcm_usart_read_com_byte(uint8_t *data)
 {
-	// Check if USART has new data
-	if (com_usart_hw->INTFLAG.reg & SERCOM_USART_INTFLAG_RXC)
-	{
-		return STATUS_OK;
-	}
+	return (usart_rx_ring_read(&com_rx, data));
 
-	return STATUS_BUSY;
+}	// End of wcm_usart_read_com_byte
+
+/***************************************************************************
+Function to return the number of SAT/CELL bytes lost to a full buffer or a
+receiver overrun
+****************************************************************************/
+uint32_t wcm_usart_get_com_overflows(void)
+{
+	return (com_rx.overflows);
 
-}	// End of wcm_usart_check_for_com_data
+}	// End of wcm_usart_get_com_overflows
 
 /***************************************************************************
 Function to send a message to the control computer
 ****************************************************************************/
 void wcm_usart_send_pc_message(const char *message)
 {
-	usart_write_buffer_wait(&pc_usart_module_struct, (uint8_t *)message, strlen(message));
+	usart_tx_queue_write(&pc_tx, (const uint8_t *)message, strlen(message));
 
 }	// End of wcm_usart_send_pc_message
 
@@ -144,10 +217,19 @@ Function to send a command to the sat and cell
 ****************************************************************************/
 void wcm_usart_send_com_command(const char *command)
 {
-	usart_write_buffer_wait(&com_usart_module_struct, (uint8_t *)command, strlen(command));
+	usart_tx_queue_write(&com_tx, (const uint8_t *)command, strlen(command));
 
 }	// End of wcm_usart_com_send_com_command
 
+/***************************************************************************
+Function to send binary data to the sat and cell
+****************************************************************************/
+void wcm_usart_send_com_data(const uint8_t *data, uint16_t length)
+{
+	usart_tx_queue_write(&com_tx, data, length);
+
+}	// End of wcm_usart_send_com_data
+
 /****************************************************************************************
 Local function to configure the SERCOM2 USART for communication with the control computer
 *****************************************************************************************/
@@ -173,21 +255,27 @@ static void pc_usart_configure(uint8_t mode)
 	}
 	else
 	{
+		usart_tx_queue_flush(&pc_tx);
 		usart_disable(&pc_usart_module_struct);
 	}
 	
 	
 	usart_init(&pc_usart_module_struct, SERCOM2, &usart_config_struct);
 	usart_enable(&pc_usart_module_struct);
+
+	// Get a pointer to the hardware module instance
+	pc_usart_hw = &((&pc_usart_module_struct)->hw->USART);
+
+	usart_tx_queue_configure(&pc_tx, &pc_usart_module_struct, WCM_DMA_CHANNEL_PC_TX, SERCOM2_DMAC_ID_TX,
+		usart_config_struct.baudrate);
 	
 	if (mode == MODE_DISABLED){
 		wcm_usart_send_pc_message("pc usart disabled!\r\n");
+		usart_tx_queue_flush(&pc_tx);
+		pc_tx.bDma = false;
 		usart_disable(&pc_usart_module_struct);
 	}
 
-	// Get a pointer to the hardware module instance
-	pc_usart_hw = &((&pc_usart_module_struct)->hw->USART);
-
 }	// End of pc_usart_configure
 
 /****************************************************************************************
@@ -221,12 +309,22 @@ static void gps_usart_configure(uint8_t mode)
 	usart_init(&gps_usart_module_struct, SERCOM1, &usart_config_struct);
 	usart_enable(&gps_usart_module_struct);		
 	
+	gps_usart_hw = &((&gps_usart_module_struct)->hw->USART);
+
 	if (mode == MODE_DISABLED){
 		wcm_usart_send_pc_message("gps usart disabled!\r\n");
+		gps_usart_hw->INTENCLR.reg = SERCOM_USART_INTENCLR_RXC;
 		usart_disable(&gps_usart_module_struct);		
 	}
-	
-	gps_usart_hw = &((&gps_usart_module_struct)->hw->USART);
+	else
+	{
+		gps_rx.head = 0;
+		gps_rx.tail = 0;
+
+		_sercom_set_handler(_sercom_get_sercom_inst_index(SERCOM1), gps_usart_interrupt);
+		gps_usart_hw->INTENSET.reg = SERCOM_USART_INTENSET_RXC;
+		system_interrupt_enable(_sercom_get_interrupt_vector(SERCOM1));
+	}
 
 }	// End of gps_usart_configure
 
@@ -255,20 +353,35 @@ static void com_usart_configure(uint8_t mode)
 	}
 	else
 	{
+		usart_tx_queue_flush(&com_tx);
 		usart_disable(&com_usart_module_struct);
 	}
 	
 	
 	usart_init(&com_usart_module_struct, SERCOM0, &usart_config_struct);
 	usart_enable(&com_usart_module_struct);
-	
+
+	// Get a pointer to the hardware module instance
+	com_usart_hw = &((&com_usart_module_struct)->hw->USART);
+
+	usart_tx_queue_configure(&com_tx, &com_usart_module_struct, WCM_DMA_CHANNEL_COM_TX, SERCOM0_DMAC_ID_TX,
+		usart_config_struct.baudrate);
+
 	if (mode == MODE_DISABLED){
 		wcm_usart_send_pc_message("com usart disabled!\r\n");
+		com_tx.bDma = false;
+		com_usart_hw->INTENCLR.reg = SERCOM_USART_INTENCLR_RXC;
 		usart_disable(&com_usart_module_struct);
 	}
+	else
+	{
+		com_rx.head = 0;
+		com_rx.tail = 0;
 
-	// Get a pointer to the hardware module instance
-	com_usart_hw = &((&com_usart_module_struct)->hw->USART);
+		_sercom_set_handler(_sercom_get_sercom_inst_index(SERCOM0), com_usart_interrupt);
+		com_usart_hw->INTENSET.reg = SERCOM_USART_INTENSET_RXC;
+		system_interrupt_enable(_sercom_get_interrupt_vector(SERCOM0));
+	}
 
 }	// End of com_usart_configure
 
@@ -363,181 +476,283 @@ bool wcm_usart_get_pc_command(char *command, int command_length)
 }	// End of wcm_usart_get_pc_command
 
 /***************************************************************************
-Function to wait for a data from gps
+Local function to handle the SERCOM1 (GPS) receive interrupt
 ****************************************************************************/
-bool wcm_usart_get_gps_data(char *command, int command_length)
+static void gps_usart_interrupt(uint8_t instance)
 {
-	enum status_code retval;
-	int i;
-	uint16_t received_data;
-	bool bCommandReceived;
+	// Only the one SERCOM is handled here
+	(void)instance;
 
-	i = 0;
-	received_data = 0;
-	bCommandReceived = false;
-	while (1)
+	usart_rx_ring_receive(gps_usart_hw, &gps_rx);
+
+}	// End of gps_usart_interrupt
+
+/***************************************************************************
+Local function to handle the SERCOM0 (SAT/CELL) receive interrupt
+****************************************************************************/
+static void com_usart_interrupt(uint8_t instance)
+{
+	// Only the one SERCOM is handled here
+	(void)instance;
+
+	usart_rx_ring_receive(com_usart_hw, &com_rx);
+
+}	// End of com_usart_interrupt
+
+/***************************************************************************
+Local function to move the received bytes into a ring buffer, counting the
+bytes lost to a receiver overrun or a full buffer
+****************************************************************************/
+static void usart_rx_ring_receive(SercomUsart *usart_hw, struct usart_rx_ring *ring)
+{
+	uint16_t next;
+	uint8_t data;
+
+	while (usart_hw->INTFLAG.reg & SERCOM_USART_INTFLAG_RXC)
 	{
-		retval = usart_read_wait(&gps_usart_module_struct, &received_data);
-		if (retval == STATUS_OK)
+		if (usart_hw->STATUS.reg & SERCOM_USART_STATUS_BUFOVF)
 		{
-			if (received_data == '\n')
-			{
-				if (bCommandReceived)
-				{
-					break;
-				}
-				else
-				{
-					continue;
-				}
-			}
+			usart_hw->STATUS.reg = SERCOM_USART_STATUS_BUFOVF;
+			ring->overflows++;
+		}
 
-			command[i++] = (char)received_data;
-			if (received_data == '\r')
-			{
-				command[i-1] = '\0';
-				bCommandReceived = true;
-				continue;
-			}
-			if (i == command_length)
-			{
-				// Null terminate the string
-				command[i-1] = '\0';
+		// Reading the data clears the interrupt flag
+		data = (uint8_t)usart_hw->DATA.reg;
 
-				bCommandReceived = false;
-				break;
-			}
-		}
-		else if (retval == STATUS_BUSY)
+		next = (ring->head + 1) % RX_BUFFER_LENGTH;
+		if (next == ring->tail)
 		{
-			continue;
+			ring->overflows++;
 		}
 		else
 		{
-			if (retval == STATUS_ERR_BAD_FORMAT)
-			{
-				sprintf(command, "usart_read_wait STATUS_ERR_BAD_FORMAT!\r\n");
-			}
-			else if (retval == STATUS_ERR_OVERFLOW)
-			{
-				sprintf(command, "usart_read_wait STATUS_ERR_OVERFLOW!\r\n");
-			}
-			else if (retval == STATUS_ERR_BAD_DATA)
-			{
-				sprintf(command, "usart_read_wait STATUS_ERR_BAD_DATA!\r\n");
-			}
-			else if (retval == STATUS_ERR_DENIED)
-			{
-				sprintf(command, "usart_read_wait STATUS_ERR_DENIED!\r\n");
-			}
-			else if (retval == STATUS_ERR_PROTOCOL)
-			{
-				sprintf(command, "usart_read_wait STATUS_ERR_PROTOCOL!\r\n");
-			}
-			else if (retval == STATUS_ERR_PACKET_COLLISION)
-			{
-				sprintf(command, "usart_read_wait STATUS_ERR_PACKET_COLLISION!\r\n");
-			}
-			else
-			{
-				sprintf(command, "usart_read_wait UNKNOWN!\r\n");
-			}
-
-			bCommandReceived = false;
-			break;
+			ring->buffer[ring->head] = data;
+			ring->head = next;
 		}
 	}
 
-	return (bCommandReceived);
+}	// End of usart_rx_ring_receive
+
+/***************************************************************************
+Local function to read the next byte from a ring buffer
+Returns false if it is empty
+****************************************************************************/
+static bool usart_rx_ring_read(struct usart_rx_ring *ring, uint8_t *data)
+{
+	if (ring->tail == ring->head)
+	{
+		return (false);
+	}
+
+	*data = ring->buffer[ring->tail];
+	ring->tail = (ring->tail + 1) % RX_BUFFER_LENGTH;
 
-}	// End of wcm_usart_get_gps_data
+	return (true);
+
+}	// End of usart_rx_ring_read
 
 /***************************************************************************
-Function to wait for a data from Iridium Module
+Local function to set up the DMA channel of a transmit queue after its port
+is configured, an empty queue is left as it is
 ****************************************************************************/
-bool wcm_usart_get_com_data(char *command, int command_length)
+static void usart_tx_queue_configure(struct usart_tx_queue *queue, struct usart_module *module, uint8_t channel,
+	uint8_t trigger, uint32_t baudrate)
 {
-	enum status_code retval;
-	int i;
-	uint16_t received_data;
-	bool bCommandReceived;
+	struct wcm_dma_channel_config dma_config_struct;
 
-	i = 0;
-	received_data = 0;
-	bCommandReceived = false;
-	while (1)
+	queue->module = module;
+	queue->channel = channel;
+	queue->baudrate = baudrate;
+
+	// Without the DMA the CPU waits about 10 bit times per byte
+	dma_config_struct.trigger = trigger;
+	dma_config_struct.bHalfWord = false;
+	dma_config_struct.bSourceIncrement = true;
+	dma_config_struct.bDestinationIncrement = false;
+	dma_config_struct.bRunInStandby = false;
+	dma_config_struct.cpu_ns_per_beat = (1000000000ul / baudrate) * 10ul;
+	dma_config_struct.done = usart_tx_queue_done;
+
+	queue->bDma = (wcm_dma_configure(channel, &dma_config_struct) == STATUS_OK);
+
+}	// End of usart_tx_queue_configure
+
+/***************************************************************************
+Local function to start the DMA on the queued bytes up to the end of the
+queue, called with the interrupts disabled
+****************************************************************************/
+static void usart_tx_queue_start(struct usart_tx_queue *queue)
+{
+	uint16_t head;
+	uint16_t tail;
+
+	head = queue->head;
+	tail = queue->tail;
+	if ((queue->sending > 0) || (head == tail))
 	{
-		retval = usart_read_wait(&com_usart_module_struct, &received_data);
-		if (retval == STATUS_OK)
+		return;
+	}
+
+	queue->sending = (head > tail) ? head - tail : TX_QUEUE_LENGTH - tail;
+	if (wcm_dma_start(queue->channel, &queue->buffer[tail], &queue->module->hw->USART.DATA.reg,
+		queue->sending) != STATUS_OK)
+	{
+		queue->sending = 0;
+	}
+
+}	// End of usart_tx_queue_start
+
+/***************************************************************************
+Local function called from the DMA interrupt when the bytes being sent have
+been written to the USART
+****************************************************************************/
+static void usart_tx_queue_done(uint8_t channel, bool bError)
+{
+	struct usart_tx_queue *queue;
+
+	// A block that failed is not sent again
+	(void)bError;
+
+	queue = (channel == WCM_DMA_CHANNEL_PC_TX) ? &pc_tx : &com_tx;
+
+	queue->tail = (queue->tail + queue->sending) % TX_QUEUE_LENGTH;
+	queue->sending = 0;
+
+	usart_tx_queue_start(queue);
+
+}	// End of usart_tx_queue_done
+
+/***************************************************************************
+Local function to copy bytes into a transmit queue, waiting while it is full
+****************************************************************************/
+static void usart_tx_queue_write(struct usart_tx_queue *queue, const uint8_t *data, uint16_t length)
+{
+	bool bInterrupt;
+	bool bWaited = false;
+	uint16_t head;
+	uint16_t used;
+	uint16_t space;
+	uint16_t n;
+
+	if (queue->bDma == false)
+	{
+		usart_write_buffer_wait(queue->module, data, length);
+		return;
+	}
+
+	// The DMA interrupt cannot empty the queue under another interrupt
+	bInterrupt = (__get_IPSR() != 0);
+
+	while (length > 0)
+	{
+		head = queue->head;
+		used = (head + TX_QUEUE_LENGTH - queue->tail) % TX_QUEUE_LENGTH;
+		space = TX_QUEUE_LENGTH - 1 - used;
+		if (space == 0)
 		{
-			if (received_data == '\n')
+			if (bInterrupt)
 			{
-				if (bCommandReceived)
-				{
-					break;
-				}
-				else
-				{
-					continue;
-				}
+				queue->dropped += length;
+				return;
 			}
-
-			command[i++] = (char)received_data;
-			if (received_data == '\r')
+			if (bWaited == false)
 			{
-				command[i-1] = '\0';
-				bCommandReceived = true;
-				continue;
+				bWaited = true;
+				queue->full_waits++;
 			}
-			if (i == command_length)
-			{
-				// Null terminate the string
-				command[i-1] = '\0';
 
-				bCommandReceived = false;
-				break;
-			}
+			system_interrupt_enter_critical_section();
+			usart_tx_queue_start(queue);
+			system_interrupt_leave_critical_section();
+			continue;
 		}
-		else if (retval == STATUS_BUSY)
+
+		// Only the bytes from head are written here, the DMA reads from tail
+		n = TX_QUEUE_LENGTH - head;
+		n = (n < space) ? n : space;
+		n = (n < length) ? n : length;
+		memcpy(&queue->buffer[head], data, n);
+
+		if (used + n > queue->peak)
 		{
-			continue;
+			queue->peak = used + n;
 		}
-		else
+
+		system_interrupt_enter_critical_section();
+		queue->head = (head + n) % TX_QUEUE_LENGTH;
+		usart_tx_queue_start(queue);
+		system_interrupt_leave_critical_section();
+
+		data += n;
+		length -= n;
+	}
+
+}	// End of usart_tx_queue_write
+
+/***************************************************************************
+Local function to wait until a transmit queue is empty and its last byte has
+left the shift register. A queue the DMA does not empty within its time at
+the port rate is dropped
+****************************************************************************/
+static void usart_tx_queue_flush(struct usart_tx_queue *queue)
+{
+	SercomUsart *usart_hw;
+	uint32_t start;
+	uint32_t timeout_ms;
+
+	if (queue->bDma == false)
+	{
+		return;
+	}
+
+	usart_hw = &(queue->module->hw->USART);
+
+	timeout_ms = 10ul + (TX_QUEUE_LENGTH * 10000ul) / queue->baudrate;
+	start = wcm_timer_get_ms();
+	while (queue->head != queue->tail)
+	{
+		if (wcm_timer_elapsed_ms(start) > timeout_ms)
 		{
-			if (retval == STATUS_ERR_BAD_FORMAT)
-			{
-				sprintf(command, "usart_read_wait STATUS_ERR_BAD_FORMAT!\r\n");
-			}
-			else if (retval == STATUS_ERR_OVERFLOW)
-			{
-				sprintf(command, "usart_read_wait STATUS_ERR_OVERFLOW!\r\n");
-			}
-			else if (retval == STATUS_ERR_BAD_DATA)
-			{
-				sprintf(command, "usart_read_wait STATUS_ERR_BAD_DATA!\r\n");
-			}
-			else if (retval == STATUS_ERR_DENIED)
-			{
-				sprintf(command, "usart_read_wait STATUS_ERR_DENIED!\r\n");
-			}
-			else if (retval == STATUS_ERR_PROTOCOL)
-			{
-				sprintf(command, "usart_read_wait STATUS_ERR_PROTOCOL!\r\n");
-			}
-			else if (retval == STATUS_ERR_PACKET_COLLISION)
-			{
-				sprintf(command, "usart_read_wait STATUS_ERR_PACKET_COLLISION!\r\n");
-			}
-			else
-			{
-				sprintf(command, "usart_read_wait UNKNOWN!\r\n");
-			}
+			system_interrupt_enter_critical_section();
+			wcm_dma_abort(queue->channel);
+			queue->dropped += (queue->head + TX_QUEUE_LENGTH - queue->tail) % TX_QUEUE_LENGTH;
+			queue->tail = queue->head;
+			queue->sending = 0;
+			system_interrupt_leave_critical_section();
+			break;
+		}
+	}
 
-			bCommandReceived = false;
+	start = wcm_timer_get_ms();
+	while ((usart_hw->INTFLAG.reg & SERCOM_USART_INTFLAG_TXC) == 0)
+	{
+		if (wcm_timer_elapsed_ms(start) > 10)
+		{
 			break;
 		}
 	}
 
-	return (bCommandReceived);
+}	// End of usart_tx_queue_flush
+
+/***************************************************************************
+Local function to send the statistics of a transmit queue to the PC
+****************************************************************************/
+static void usart_tx_queue_report(const char *name, const struct usart_tx_queue *queue)
+{
+	char response[64];
+
+	sprintf(response, "TX_QUEUE %s %u %u %lu %lu\r\n", name, TX_QUEUE_LENGTH, queue->peak,
+		(unsigned long)queue->full_waits, (unsigned long)queue->dropped);
+	wcm_usart_send_pc_message(response);
+
+}	// End of usart_tx_queue_report
+
+/***************************************************************************
+Function to send the statistics of the transmit queues to the PC
+****************************************************************************/
+void wcm_usart_report_queues(void)
+{
+	usart_tx_queue_report("PC", &pc_tx);
+	usart_tx_queue_report("COM", &com_tx);
 
-}	// End of wcm_usart_get_com_command
\ No newline at end of file
+}	// End of wcm_usart_report_queues
@@ -16,23 +16,27 @@ Date:
 
 
 #include <stdbool.h>
+#include <stdint.h>
 
 
 enum status_code wcm_usart_check_for_pc_command(void);
-enum status_code wcm_usart_check_for_gps_data(void);
-enum status_code wcm_usart_check_for_com_data(void);
 
 
 void wcm_usart_configure(void);
 void wcm_usart_disable(void);
 
 bool wcm_usart_get_pc_command(char *, int);
-bool wcm_usart_get_gps_data(char *, int);
-bool wcm_usart_get_com_data(char *, int);
+bool wcm_usart_read_gps_byte(uint8_t *);
+uint32_t wcm_usart_get_gps_overflows(void);
+bool wcm_usart_read_com_byte(uint8_t *);
+uint32_t wcm_usart_get_com_overflows(void);
 
 void wcm_usart_send_pc_message(const char *);
 void wcm_usart_send_gps_command(const char *);
 void wcm_usart_send_com_command(const char *);
+void wcm_usart_send_com_data(const uint8_t *, uint16_t);
+
+void wcm_usart_report_queues(void);
 
 
 #endif	// WCM_USART_H
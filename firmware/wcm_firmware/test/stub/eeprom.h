@@ -0,0 +1,39 @@
+/****************************************************************************************
+eeprom.h: Stand-in for the ASF EEPROM emulator header, for the host tests
+
+Written by:
+	Daayim Asim, B.Eng. Student
+	Computer Engineer Student
+	eSonar Inc.
+
+Date:
+	November 2022
+
+Note(s):
+- The ASF header needs the device headers for NVMCTRL_PAGE_SIZE. This one declares
+	the same functions for a SAML21 (64 byte NVM pages), the test defines them
+*****************************************************************************************/
+
+
+#ifndef EEPROM_H_INCLUDED
+#define EEPROM_H_INCLUDED
+
+#include <stdint.h>
+#include <status_codes.h>
+
+#define EEPROM_HEADER_SIZE			4
+#define EEPROM_PAGE_SIZE			(64 - EEPROM_HEADER_SIZE)
+
+struct eeprom_emulator_parameters
+{
+	uint8_t page_size;
+	uint16_t eeprom_number_of_pages;
+};
+
+enum status_code eeprom_emulator_get_parameters(struct eeprom_emulator_parameters *const);
+enum status_code eeprom_emulator_commit_page_buffer(void);
+enum status_code eeprom_emulator_write_buffer(const uint16_t, const uint8_t *const, const uint16_t);
+enum status_code eeprom_emulator_read_buffer(const uint16_t, uint8_t *const, const uint16_t);
+
+
+#endif	// EEPROM_H_INCLUDED
@@ -0,0 +1,57 @@
+/****************************************************************************************
+sercom.h: Stand-in for the ASF SERCOM header and SERCOM registers, for the host tests
+
+Written by:
+	Daayim Asim, B.Eng. Student
+	Computer Engineer Student
+	eSonar Inc.
+
+Date:
+	November 2022
+
+Note(s):
+- Sercom only has the USART registers wcm_usart.c reads and writes, the interrupt and
+	status bits have their SAML21 bit positions
+*****************************************************************************************/
+
+
+#ifndef SERCOM_H_INCLUDED
+#define SERCOM_H_INCLUDED
+
+#include <stdint.h>
+#include <status_codes.h>
+#include <system_interrupt.h>
+
+#define SERCOM_USART_INTFLAG_TXC		(1u << 1)
+#define SERCOM_USART_INTFLAG_RXC		(1u << 2)
+#define SERCOM_USART_INTENSET_RXC		(1u << 2)
+#define SERCOM_USART_INTENCLR_RXC		(1u << 2)
+#define SERCOM_USART_STATUS_BUFOVF		(1u << 2)
+
+struct sercom_register
+{
+	uint32_t reg;
+};
+
+typedef struct
+{
+	struct sercom_register INTENCLR;
+	struct sercom_register INTENSET;
+	struct sercom_register INTFLAG;
+	struct sercom_register STATUS;
+	struct sercom_register DATA;
+} SercomUsart;
+
+typedef union
+{
+	SercomUsart USART;
+} Sercom;
+
+static inline enum system_interrupt_vector _sercom_get_interrupt_vector(Sercom *const sercom_instance)
+{
+	(void)sercom_instance;
+	return (SYSTEM_INTERRUPT_MODULE_SERCOM);
+}
+
+
+#endif	// SERCOM_H_INCLUDED
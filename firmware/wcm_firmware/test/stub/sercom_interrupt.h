@@ -0,0 +1,40 @@
+/****************************************************************************************
+sercom_interrupt.h: Stand-in for the ASF SERCOM interrupt header, for the host tests
+
+Written by:
+	Daayim Asim, B.Eng. Student
+	Computer Engineer Student
+	eSonar Inc.
+
+Date:
+	November 2022
+
+Note(s):
+- The handlers are kept in fake_sercom_handlers by SERCOM number, the test calls them
+	as the interrupts would
+*****************************************************************************************/
+
+
+#ifndef SERCOM_INTERRUPT_H_INCLUDED
+#define SERCOM_INTERRUPT_H_INCLUDED
+
+#include <sercom.h>
+#include <stdint.h>
+
+typedef void (*sercom_handler_t)(uint8_t);
+
+extern Sercom fake_sercom[];
+extern sercom_handler_t fake_sercom_handlers[];
+
+static inline uint8_t _sercom_get_sercom_inst_index(Sercom *const sercom_instance)
+{
+	return ((uint8_t)(sercom_instance - fake_sercom));
+}
+
+static inline void _sercom_set_handler(const uint8_t instance, const sercom_handler_t interrupt_handler)
+{
+	fake_sercom_handlers[instance] = interrupt_handler;
+}
+
+
+#endif	// SERCOM_INTERRUPT_H_INCLUDED
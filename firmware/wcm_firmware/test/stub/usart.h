@@ -0,0 +1,123 @@
+/****************************************************************************************
+usart.h: Stand-in for the ASF SERCOM USART driver header, for the host tests
+
+Written by:
+	Daayim Asim, B.Eng. Student
+	Computer Engineer Student
+	eSonar Inc.
+
+Date:
+	November 2022
+
+Note(s):
+- SERCOM0 to SERCOM2 are fake_sercom[0] to [2], which the test defines, with the
+	registers from stub/sercom.h
+- usart_write_buffer_wait appends the bytes to fake_written[] of the SERCOM,
+	usart_read_wait has nothing to read
+*****************************************************************************************/
+
+
+#ifndef USART_H_INCLUDED
+#define USART_H_INCLUDED
+
+#include <sercom.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <status_codes.h>
+
+#define SERCOM0_DMAC_ID_TX			0x02
+#define SERCOM2_DMAC_ID_TX			0x06
+
+#define PINMUX_UNUSED				0xffffffff
+#define PINMUX_PA00D_SERCOM1_PAD0	0x00000003
+#define PINMUX_PA01D_SERCOM1_PAD1	0x00010003
+#define PINMUX_PA04D_SERCOM0_PAD0	0x00040003
+#define PINMUX_PA05D_SERCOM0_PAD1	0x00050003
+#define PINMUX_PA09D_SERCOM2_PAD1	0x00090003
+#define PINMUX_PA10D_SERCOM2_PAD2	0x000a0003
+
+#define FAKE_WRITTEN_LENGTH			256
+
+extern Sercom fake_sercom[];
+extern uint8_t fake_written[][FAKE_WRITTEN_LENGTH];
+extern uint16_t fake_written_length[];
+
+#define SERCOM0	(&fake_sercom[0])
+#define SERCOM1	(&fake_sercom[1])
+#define SERCOM2	(&fake_sercom[2])
+
+enum usart_signal_mux_settings
+{
+	USART_RX_1_TX_0_XCK_1 = 0x00100000,
+	USART_RX_1_TX_2_XCK_3 = 0x00110000
+};
+
+enum usart_transfer_mode
+{
+	USART_TRANSFER_SYNCHRONOUSLY,
+	USART_TRANSFER_ASYNCHRONOUSLY
+};
+
+struct usart_config
+{
+	uint32_t baudrate;
+	enum usart_signal_mux_settings mux_setting;
+	uint32_t pinmux_pad0;
+	uint32_t pinmux_pad1;
+	uint32_t pinmux_pad2;
+	uint32_t pinmux_pad3;
+	enum usart_transfer_mode transfer_mode;
+};
+
+struct usart_module
+{
+	Sercom *hw;
+};
+
+static inline void usart_get_config_defaults(struct usart_config *config)
+{
+	config->baudrate = 9600;
+	config->mux_setting = USART_RX_1_TX_0_XCK_1;
+	config->pinmux_pad0 = PINMUX_UNUSED;
+	config->pinmux_pad1 = PINMUX_UNUSED;
+	config->pinmux_pad2 = PINMUX_UNUSED;
+	config->pinmux_pad3 = PINMUX_UNUSED;
+	config->transfer_mode = USART_TRANSFER_ASYNCHRONOUSLY;
+}
+
+static inline enum status_code usart_init(struct usart_module *module, Sercom *hw, const struct usart_config *config)
+{
+	(void)config;
+	module->hw = hw;
+	return (STATUS_OK);
+}
+
+static inline void usart_enable(const struct usart_module *module)
+{
+	(void)module;
+}
+
+static inline void usart_disable(const struct usart_module *module)
+{
+	(void)module;
+}
+
+static inline enum status_code usart_write_buffer_wait(struct usart_module *module, const uint8_t *tx_data, uint16_t length)
+{
+	uint8_t sercom = (uint8_t)(module->hw - fake_sercom);
+
+	memcpy(&fake_written[sercom][fake_written_length[sercom]], tx_data, length);
+	fake_written_length[sercom] += length;
+	return (STATUS_OK);
+}
+
+static inline enum status_code usart_read_wait(struct usart_module *module, uint16_t *rx_data)
+{
+	(void)module;
+	(void)rx_data;
+	return (STATUS_ERR_DENIED);
+}
+
+
+#endif	// USART_H_INCLUDED
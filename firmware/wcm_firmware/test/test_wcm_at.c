@@ -0,0 +1,454 @@
+/****************************************************************************************
+test_wcm_at.c: Host test of the WCM modem AT command engine against a scripted fake
+	modem
+
+Written by:
+	Daayim Asim, B.Eng. Student
+	Computer Engineer Student
+	eSonar Inc.
+
+Date:
+	November 2022
+
+Note(s):
+- Builds wcm_at.c on a PC with a struct wcm_at_port that records what is written and
+	plays back the modem's replies, with a clock the test moves by hand
+- Run with "make" in this directory
+*****************************************************************************************/
+
+
+#include <stdio.h>
+#include <string.h>
+#include "wcm_at.h"
+
+
+#define CHECK(condition)	check((condition), #condition, __LINE__)
+
+
+/****************************************************************************************
+Local variable(s)
+*****************************************************************************************/
+
+// Fake modem: bytes it will send, what it was sent and its power pin
+static char modem_reply[512];
+static size_t modem_reply_length = 0;
+static size_t modem_reply_read = 0;
+static char modem_written[512];
+static bool bModemPowered = false;
+static uint32_t now_ms = 0;
+
+// Completed commands and unsolicited lines
+static char last_command[AT_COMMAND_LENGTH];
+static char last_response[AT_RESPONSE_LENGTH];
+static enum wcm_at_result last_result;
+static int completions = 0;
+static char last_unsolicited[AT_RESPONSE_LENGTH];
+static int unsolicited_lines = 0;
+
+static int failures = 0;
+
+static const char *const urc_prefixes[] = {"SBDRING", "+CIEV:", NULL};
+
+
+/****************************************************************************************
+Local function(s)
+*****************************************************************************************/
+
+static void at_done(const char *, enum wcm_at_result, const char *);
+static void at_retry(const char *, enum wcm_at_result, const char *);
+static void check(bool, const char *, int);
+static uint32_t fake_get_ms(void);
+static bool fake_read_byte(uint8_t *);
+static void fake_set_power(bool);
+static void fake_unsolicited(const char *);
+static void fake_write(const char *);
+static void fake_write_data(const uint8_t *, uint16_t);
+static void modem_says(const char *);
+static void power_up(void);
+static void reset(void);
+static void run(void);
+static void test_dead_modem(void);
+static void test_dead_modem_retry(void);
+static void test_drain_expires(void);
+static void test_expected_line(void);
+static void test_late_reply(void);
+static void test_simple_command(void);
+static void test_unsolicited(void);
+
+
+/****************************************************************************************
+Fake port functions
+*****************************************************************************************/
+static bool fake_read_byte(uint8_t *data)
+{
+	if (modem_reply_read == modem_reply_length)
+	{
+		return (false);
+	}
+
+	*data = (uint8_t)modem_reply[modem_reply_read++];
+	return (true);
+
+}	// End of fake_read_byte
+
+
+static void fake_write(const char *text)
+{
+	strncat(modem_written, text, sizeof(modem_written) - strlen(modem_written) - 1);
+
+}	// End of fake_write
+
+
+static void fake_write_data(const uint8_t *data, uint16_t length)
+{
+	(void)data;
+	(void)length;
+	fake_write("<data>");
+
+}	// End of fake_write_data
+
+
+static uint32_t fake_get_ms(void)
+{
+	return (now_ms);
+
+}	// End of fake_get_ms
+
+
+static void fake_set_power(bool bOn)
+{
+	bModemPowered = bOn;
+
+}	// End of fake_set_power
+
+
+static void fake_unsolicited(const char *text)
+{
+	strcpy(last_unsolicited, text);
+	unsolicited_lines++;
+
+}	// End of fake_unsolicited
+
+
+static const struct wcm_at_port fake_port =
+{
+	fake_read_byte, fake_write, fake_write_data, fake_get_ms, fake_set_power,
+	urc_prefixes, fake_unsolicited
+};
+
+
+/****************************************************************************************
+Local function to record a completed command
+*****************************************************************************************/
+static void at_done(const char *command, enum wcm_at_result result, const char *response)
+{
+	strcpy(last_command, command);
+	strcpy(last_response, response);
+	last_result = result;
+	completions++;
+
+}	// End of at_done
+
+
+/****************************************************************************************
+Local function to record a completed command and queue it again, as a caller retrying
+until the modem answers would
+*****************************************************************************************/
+static void at_retry(const char *command, enum wcm_at_result result, const char *response)
+{
+	at_done(command, result, response);
+	CHECK(wcm_at_queue(command, NULL, 1000ul, at_retry));
+
+}	// End of at_retry
+
+
+/****************************************************************************************
+Local function to count a failed check
+*****************************************************************************************/
+static void check(bool bPassed, const char *condition, int line)
+{
+	if (!bPassed)
+	{
+		printf("test_wcm_at.c:%d: FAILED %s\n", line, condition);
+		failures++;
+	}
+
+}	// End of check
+
+
+/****************************************************************************************
+Local function to queue bytes for the modem to send
+*****************************************************************************************/
+static void modem_says(const char *text)
+{
+	size_t length = strlen(text);
+
+	memcpy(&modem_reply[modem_reply_length], text, length);
+	modem_reply_length += length;
+
+}	// End of modem_says
+
+
+/****************************************************************************************
+Local function to run the engine a few times, as the main loop would
+*****************************************************************************************/
+static void run(void)
+{
+	int i;
+
+	for (i = 0; i < 4; i++)
+	{
+		wcm_at_service();
+	}
+
+}	// End of run
+
+
+/****************************************************************************************
+Local function to reset the fake modem and the engine
+*****************************************************************************************/
+static void reset(void)
+{
+	modem_reply_length = 0;
+	modem_reply_read = 0;
+	modem_written[0] = '\0';
+	completions = 0;
+	unsolicited_lines = 0;
+	last_response[0] = '\0';
+	last_unsolicited[0] = '\0';
+	now_ms = 1000;
+
+	wcm_at_init(&fake_port);
+
+}	// End of reset
+
+
+/****************************************************************************************
+Local function to take the modem through boot and the AT probe, with a command queued
+*****************************************************************************************/
+static void power_up(void)
+{
+	run();
+	CHECK(bModemPowered);
+	CHECK(wcm_at_get_power_state() == AT_POWER_BOOTING);
+
+	now_ms += AT_BOOT_MS;
+	run();
+	CHECK(strcmp(modem_written, "AT\r") == 0);
+
+	modem_written[0] = '\0';
+	modem_says("AT\r\r\nOK\r\n");
+	run();
+	CHECK(wcm_at_get_power_state() == AT_POWER_READY);
+
+}	// End of power_up
+
+
+/****************************************************************************************
+Tests
+*****************************************************************************************/
+static void test_simple_command(void)
+{
+	reset();
+	CHECK(wcm_at_queue("AT+CSQ", NULL, 1000ul, at_done));
+	power_up();
+	CHECK(strcmp(modem_written, "AT+CSQ\r") == 0);
+
+	modem_says("AT+CSQ\r\r\n+CSQ:5\r\n\r\nOK\r\n");
+	run();
+	CHECK(completions == 1);
+	CHECK(last_result == AT_RESULT_OK);
+	CHECK(strcmp(last_response, "+CSQ:5") == 0);
+
+	// Idle power off
+	now_ms += AT_IDLE_OFF_MS;
+	run();
+	CHECK(!bModemPowered);
+
+}	// End of test_simple_command
+
+
+static void test_expected_line(void)
+{
+	reset();
+	CHECK(wcm_at_queue("AT+SBDIX", "+SBDIX:", 1000ul, at_done));
+	CHECK(wcm_at_queue("AT+CSQ", NULL, 1000ul, at_done));
+	power_up();
+	CHECK(strcmp(modem_written, "AT+SBDIX\r") == 0);
+
+	// The expected line does not end the command, its OK does
+	modem_written[0] = '\0';
+	modem_says("+SBDIX: 0, 1, 0, 0, 0, 0\r\n");
+	run();
+	CHECK(completions == 0);
+	CHECK(modem_written[0] == '\0');
+
+	modem_says("\r\nOK\r\n");
+	run();
+	CHECK(completions == 1);
+	CHECK(last_result == AT_RESULT_OK);
+	CHECK(strcmp(last_command, "AT+SBDIX") == 0);
+	CHECK(strcmp(last_response, "+SBDIX: 0, 1, 0, 0, 0, 0") == 0);
+	CHECK(strcmp(modem_written, "AT+CSQ\r") == 0);
+
+	modem_says("ERROR\r\n");
+	run();
+	CHECK(completions == 2);
+	CHECK(last_result == AT_RESULT_ERROR);
+	CHECK(strcmp(last_command, "AT+CSQ") == 0);
+
+	// OK without the expected line
+	CHECK(wcm_at_queue("AT+SBDIX", "+SBDIX:", 1000ul, at_done));
+	run();
+	modem_says("OK\r\n");
+	run();
+	CHECK(completions == 3);
+	CHECK(last_result == AT_RESULT_ERROR);
+
+}	// End of test_expected_line
+
+
+static void test_late_reply(void)
+{
+	reset();
+	CHECK(wcm_at_queue("AT+SBDIX", NULL, 100ul, at_done));
+	power_up();
+
+	now_ms += 100;
+	run();
+	CHECK(completions == 1);
+	CHECK(last_result == AT_RESULT_TIMEOUT);
+
+	// The next command waits for the late reply, which is dropped
+	modem_written[0] = '\0';
+	CHECK(wcm_at_queue("AT+CSQ", NULL, 1000ul, at_done));
+	run();
+	CHECK(modem_written[0] == '\0');
+
+	modem_says("+SBDIX: 32, 0, 2, 0, 0, 0\r\nOK\r\n");
+	run();
+	CHECK(completions == 1);
+	CHECK(strcmp(modem_written, "AT+CSQ\r") == 0);
+
+	modem_says("+CME ERROR: 4\r\n");
+	run();
+	CHECK(completions == 2);
+	CHECK(last_result == AT_RESULT_ERROR);
+	CHECK(strcmp(last_response, "+CME ERROR: 4") == 0);
+
+}	// End of test_late_reply
+
+
+static void test_drain_expires(void)
+{
+	reset();
+	CHECK(wcm_at_queue("AT+CSQ", NULL, 100ul, at_done));
+	power_up();
+
+	now_ms += 100;
+	run();
+	CHECK(last_result == AT_RESULT_TIMEOUT);
+
+	// No final result code, the modem is turned off and starts again for the next
+	CHECK(wcm_at_queue("AT+CSQ", NULL, 1000ul, at_done));
+	now_ms += AT_DRAIN_MS;
+	wcm_at_service();
+	CHECK(wcm_at_get_power_state() == AT_POWER_OFF);
+
+	modem_written[0] = '\0';
+	power_up();
+	CHECK(strcmp(modem_written, "AT+CSQ\r") == 0);
+
+}	// End of test_drain_expires
+
+
+static void test_unsolicited(void)
+{
+	reset();
+	CHECK(wcm_at_queue("AT+CSQ", NULL, 1000ul, at_done));
+	power_up();
+
+	modem_says("AT+CSQ\r\r\nSBDRING\r\n+CSQ:3\r\n+CIEV:0,4\r\nOK\r\n");
+	run();
+	CHECK(unsolicited_lines == 2);
+	CHECK(strcmp(last_unsolicited, "+CIEV:0,4") == 0);
+	CHECK(completions == 1);
+	CHECK(last_result == AT_RESULT_OK);
+	CHECK(strcmp(last_response, "+CSQ:3") == 0);
+
+	// Any line while no command is waiting
+	modem_says("RING\r\n");
+	run();
+	CHECK(unsolicited_lines == 3);
+
+}	// End of test_unsolicited
+
+
+static void test_dead_modem(void)
+{
+	int i;
+
+	reset();
+	CHECK(wcm_at_queue("AT+CSQ", NULL, 1000ul, at_done));
+	CHECK(wcm_at_queue("AT+CSQ", NULL, 1000ul, at_done));
+	run();
+
+	now_ms += AT_BOOT_MS;
+	run();
+	for (i = 0; i < AT_PROBE_ATTEMPTS; i++)
+	{
+		now_ms += AT_PROBE_TIMEOUT_MS;
+		run();
+	}
+	CHECK(completions == 2);
+	CHECK(last_result == AT_RESULT_NO_MODEM);
+	CHECK(!bModemPowered);
+	CHECK(!wcm_at_busy());
+
+}	// End of test_dead_modem
+
+
+static void test_dead_modem_retry(void)
+{
+	int i;
+
+	reset();
+	CHECK(wcm_at_queue("AT+CSQ", NULL, 1000ul, at_retry));
+	run();
+
+	now_ms += AT_BOOT_MS;
+	run();
+	for (i = 0; i < AT_PROBE_ATTEMPTS; i++)
+	{
+		now_ms += AT_PROBE_TIMEOUT_MS;
+		wcm_at_service();
+	}
+
+	// The command queued again is not failed with the first, it powers the modem again
+	CHECK(completions == 1);
+	CHECK(last_result == AT_RESULT_NO_MODEM);
+	CHECK(!bModemPowered);
+	CHECK(wcm_at_busy());
+
+	wcm_at_service();
+	CHECK(bModemPowered);
+	CHECK(completions == 1);
+
+}	// End of test_dead_modem_retry
+
+
+int main(void)
+{
+	test_simple_command();
+	test_expected_line();
+	test_late_reply();
+	test_drain_expires();
+	test_unsolicited();
+	test_dead_modem();
+	test_dead_modem_retry();
+
+	printf("test_wcm_at: %s\n", (failures == 0) ? "passed" : "FAILED");
+
+	return ((failures == 0) ? 0 : 1);
+
+}	// End of main
@@ -0,0 +1,431 @@
+/****************************************************************************************
+test_wcm_gps.c: Host test of the WCM NMEA parser and GPS fix scheduling, replaying
+	receiver captures
+
+Written by:
+	Daayim Asim, B.Eng. Student
+	Computer Engineer Student
+	eSonar Inc.
+
+Date:
+	November 2022
+
+Note(s):
+- Builds wcm_gps.c and wcm_gps_manager.c on a PC with the wcm_usart, wcm_timer and
+	wcm_gpio functions they use replaced by fakes, with a clock the test moves by hand
+- The captures in data/ are replayed a sentence at a time, running the GPS functions
+	after each as the main loop would. The clock moves 1 s at each RMC, the receiver
+	sends one every second
+	- cold_start.nmea: MediaTek boot, 34 s without a fix with a bad checksum and a
+		sentence cut short, then a fix
+	- hot_start.nmea: the reply to the wake sentence, 1 s without a fix, then a fix
+	- no_fix.nmea: 12 s without a fix
+- test_sentences feeds single sentences built here, for the hemispheres, three digit
+	longitudes and the fields the captures do not have
+- Run with "make" in this directory
+*****************************************************************************************/
+
+
+#include <stdio.h>
+#include <string.h>
+#include "wcm_gps.h"
+#include "wcm_gps_manager.h"
+#include "wcm_gpio.h"
+#include "wcm_timer.h"
+#include "wcm_usart.h"
+
+
+#define CHECK(condition)	check((condition), #condition, __LINE__)
+
+
+/****************************************************************************************
+Local variable(s)
+*****************************************************************************************/
+
+// Fake receiver: bytes it has sent, the last command it was sent and its power pin
+static char gps_bytes[GPS_SENTENCE_LENGTH + 3];
+static size_t gps_bytes_length = 0;
+static size_t gps_bytes_read = 0;
+static char gps_command[32];
+static bool bGpsPowered = false;
+static uint32_t now_ms = 0;
+
+// Last message to the PC
+static char pc_message[192];
+
+static int failures = 0;
+
+
+/****************************************************************************************
+Local function(s)
+*****************************************************************************************/
+
+static void check(bool, const char *, int);
+static void gps_says(const char *, bool);
+static void replay(const char *);
+static void run(void);
+static void test_cold_start(void);
+static void test_hot_start(void);
+static void test_no_fix(void);
+static void test_sentences(void);
+static void test_standby_powered_off(void);
+
+
+/****************************************************************************************
+Fake wcm_usart, wcm_timer and wcm_gpio functions
+*****************************************************************************************/
+bool wcm_usart_read_gps_byte(uint8_t *data)
+{
+	if (gps_bytes_read == gps_bytes_length)
+	{
+		return (false);
+	}
+
+	*data = (uint8_t)gps_bytes[gps_bytes_read++];
+	return (true);
+
+}	// End of wcm_usart_read_gps_byte
+
+
+uint32_t wcm_usart_get_gps_overflows(void)
+{
+	return (0);
+
+}	// End of wcm_usart_get_gps_overflows
+
+
+void wcm_usart_send_gps_command(const char *command)
+{
+	strcpy(gps_command, command);
+
+}	// End of wcm_usart_send_gps_command
+
+
+void wcm_usart_send_pc_message(const char *message)
+{
+	strcpy(pc_message, message);
+
+}	// End of wcm_usart_send_pc_message
+
+
+uint32_t wcm_timer_get_ms(void)
+{
+	return (now_ms);
+
+}	// End of wcm_timer_get_ms
+
+
+uint32_t wcm_timer_elapsed_ms(uint32_t since)
+{
+	return (now_ms - since);
+
+}	// End of wcm_timer_elapsed_ms
+
+
+bool wcm_gpio_gps_pwr_en_get(void)
+{
+	return (bGpsPowered);
+
+}	// End of wcm_gpio_gps_pwr_en_get
+
+
+void wcm_gpio_gps_pwr_en_on(void)
+{
+	bGpsPowered = true;
+
+}	// End of wcm_gpio_gps_pwr_en_on
+
+
+void wcm_gpio_gps_pwr_en_off(void)
+{
+	bGpsPowered = false;
+
+}	// End of wcm_gpio_gps_pwr_en_off
+
+
+/****************************************************************************************
+Local function to count a failed check
+*****************************************************************************************/
+static void check(bool bPassed, const char *condition, int line)
+{
+	if (!bPassed)
+	{
+		printf("test_wcm_gps.c:%d: FAILED %s\n", line, condition);
+		failures++;
+	}
+
+}	// End of check
+
+
+/****************************************************************************************
+Local function to have the receiver send one sentence, "$<body>*<checksum>", and parse
+it. The checksum is off by one if bGoodChecksum is false
+*****************************************************************************************/
+static void gps_says(const char *body, bool bGoodChecksum)
+{
+	uint8_t checksum = 0;
+	const char *p;
+
+	for (p = body; *p != '\0'; p++)
+	{
+		checksum ^= (uint8_t)*p;
+	}
+	if (!bGoodChecksum)
+	{
+		checksum ^= 0x01;
+	}
+
+	sprintf(gps_bytes, "$%s*%02X\r\n", body, checksum);
+	gps_bytes_length = strlen(gps_bytes);
+	gps_bytes_read = 0;
+	wcm_gps_service();
+
+}	// End of gps_says
+
+
+/****************************************************************************************
+Local function to run the GPS functions, as the main loop would
+*****************************************************************************************/
+static void run(void)
+{
+	wcm_gps_service();
+	wcm_gps_manager_service();
+
+}	// End of run
+
+
+/****************************************************************************************
+Local function to replay a capture a sentence at a time, moving the clock 1 s at each
+RMC after the first
+*****************************************************************************************/
+static void replay(const char *file_name)
+{
+	char line[GPS_SENTENCE_LENGTH + 3];
+	bool bFirst = true;
+	FILE *file;
+
+	file = fopen(file_name, "rb");
+	CHECK(file != NULL);
+	if (file == NULL)
+	{
+		return;
+	}
+
+	while (fgets(line, sizeof(line), file) != NULL)
+	{
+		if (strncmp(line, "$GPRMC,", 7) == 0)
+		{
+			if (!bFirst)
+			{
+				now_ms += 1000;
+			}
+			bFirst = false;
+		}
+
+		strcpy(gps_bytes, line);
+		gps_bytes_length = strlen(line);
+		gps_bytes_read = 0;
+		run();
+	}
+
+	fclose(file);
+
+}	// End of replay
+
+
+/****************************************************************************************
+Tests
+*****************************************************************************************/
+static void test_cold_start(void)
+{
+	struct wcm_gps_fix fix;
+
+	now_ms = 0;
+	wcm_gps_manager_init();
+	CHECK(bGpsPowered);
+	CHECK(!wcm_gps_get_fix(&fix));
+
+	replay("data/cold_start.nmea");
+	CHECK(wcm_gps_get_fix(&fix));
+	CHECK(fix.utc_time == 120039);
+	CHECK(fix.utc_date == 191022);
+	CHECK(fix.latitude == 44502057);
+	CHECK(fix.longitude == -63592797);
+	CHECK(fix.altitude == 123);
+	CHECK(fix.hdop == 95);
+	CHECK(fix.quality == 1);
+	CHECK(fix.satellites == 8);
+	CHECK(fix.fix_type == 3);
+	CHECK(fix.bValid);
+	CHECK(fix.fix_ms == 39000);
+
+	wcm_gps_report_stats();
+	CHECK(strcmp(pc_message, "GPS_STATS 118 2 1 66 0\r\n") == 0);
+
+	// Fix at 34 s, held for 2 s, then standby as the period is 15 minutes
+	CHECK(strcmp(gps_command, GPS_STANDBY_SENTENCE) == 0);
+	CHECK(bGpsPowered);
+	CHECK(!wcm_gps_manager_busy());
+
+}	// End of test_cold_start
+
+
+static void test_hot_start(void)
+{
+	struct wcm_gps_fix fix;
+
+	now_ms = GPS_MANAGER_PERIOD_S * 1000ul - 1;
+	run();
+	CHECK(!wcm_gps_manager_busy());
+
+	now_ms++;
+	run();
+	CHECK(wcm_gps_manager_busy());
+	CHECK(strcmp(gps_command, GPS_WAKE_SENTENCE) == 0);
+
+	// The old fix does not end the acquisition
+	pc_message[0] = '\0';
+	replay("data/hot_start.nmea");
+	CHECK(wcm_gps_get_fix(&fix));
+	CHECK(fix.latitude == 44502167);
+	CHECK(fix.longitude == -63592667);
+	CHECK(strcmp(gps_command, GPS_STANDBY_SENTENCE) == 0);
+
+	wcm_gps_manager_report();
+	CHECK(strcmp(pc_message, "GPS_MANAGER STANDBY 900 120 0 2 2 0 1000 34000 1000 19500\r\n") == 0);
+
+}	// End of test_hot_start
+
+
+static void test_no_fix(void)
+{
+	struct wcm_gps_fix fix;
+
+	CHECK(wcm_gps_manager_configure(60, 60, GPS_IDLE_OFF) == STATUS_ERR_INVALID_ARG);
+	CHECK(wcm_gps_manager_configure(60, 5, GPS_IDLE_OFF) == STATUS_OK);
+
+	now_ms += 10000;
+	wcm_gps_manager_request_fix();
+	run();
+	CHECK(wcm_gps_manager_busy());
+	CHECK(strcmp(gps_command, GPS_WAKE_SENTENCE) == 0);
+
+	replay("data/no_fix.nmea");
+	CHECK(strcmp(pc_message, "GPS_TIMEOUT 5000\r\n") == 0);
+	CHECK(!bGpsPowered);
+	CHECK(!wcm_gps_manager_busy());
+
+	// The last fix is kept, the RMC status is not
+	CHECK(wcm_gps_get_fix(&fix));
+	CHECK(fix.latitude == 44502167);
+	CHECK(!fix.bValid);
+	CHECK(fix.quality == 0);
+
+	wcm_gps_manager_report();
+	CHECK(strcmp(pc_message, "GPS_MANAGER OFF 60 5 1 3 2 1 1000 34000 1000 22000\r\n") == 0);
+
+}	// End of test_no_fix
+
+
+static void test_standby_powered_off(void)
+{
+	CHECK(wcm_gps_manager_configure(60, 30, GPS_IDLE_STANDBY) == STATUS_OK);
+
+	now_ms += 10000;
+	wcm_gps_manager_request_fix();
+	run();
+	CHECK(bGpsPowered);
+	replay("data/hot_start.nmea");
+	CHECK(strcmp(gps_command, GPS_STANDBY_SENTENCE) == 0);
+	CHECK(!wcm_gps_manager_busy());
+
+	// Turned off by a PC command while in standby, waking it would not power it
+	wcm_gpio_gps_pwr_en_off();
+	gps_command[0] = '\0';
+
+	now_ms += 10000;
+	wcm_gps_manager_request_fix();
+	run();
+	CHECK(wcm_gps_manager_busy());
+	CHECK(bGpsPowered);
+	CHECK(gps_command[0] == '\0');
+
+	// Timed as a start from off
+	pc_message[0] = '\0';
+	replay("data/hot_start.nmea");
+	CHECK(strncmp(pc_message, "GPS_FIX ", 8) == 0);
+	CHECK(strstr(pc_message, " OFF\r\n") != NULL);
+	CHECK(!wcm_gps_manager_busy());
+
+}	// End of test_standby_powered_off
+
+
+static void test_sentences(void)
+{
+	struct wcm_gps_fix fix;
+
+	// South and east
+	gps_says("GPGGA,123519,4807.038,S,01131.000,E,1,08,0.9,545.4,M,46.9,M,,", true);
+	CHECK(wcm_gps_get_fix(&fix));
+	CHECK(fix.utc_time == 123519);
+	CHECK(fix.latitude == -48117300);
+	CHECK(fix.longitude == 11516667);
+	CHECK(fix.altitude == 5454);
+	CHECK(fix.hdop == 90);
+	CHECK(fix.satellites == 8);
+
+	// A three digit longitude, minutes rounded to the nearest 1e-6 degree
+	gps_says("GPGGA,123520,4430.1234,N,12327.4020,W,2,10,1.2,10.0,M,,M,,", true);
+	wcm_gps_get_fix(&fix);
+	CHECK(fix.latitude == 44502057);
+	CHECK(fix.longitude == -123456700);
+	CHECK(fix.quality == 2);
+
+	// No fix, or a bad checksum, keeps the last position
+	gps_says("GPGGA,123521,,,,,0,00,99.99,,M,,M,,", true);
+	wcm_gps_get_fix(&fix);
+	CHECK(fix.quality == 0);
+	CHECK(fix.hdop == 9999);
+	CHECK(fix.latitude == 44502057);
+	CHECK(fix.longitude == -123456700);
+
+	gps_says("GPGGA,123522,3352.1200,S,15112.6000,E,1,08,0.9,5.0,M,,M,,", false);
+	wcm_gps_get_fix(&fix);
+	CHECK(fix.utc_time == 123521);
+	CHECK(fix.latitude == 44502057);
+
+	// RMC moves the position only while its status is A
+	gps_says("GPRMC,123523,V,3352.1200,S,15112.6000,E,0.0,0.0,201022,,,N", true);
+	wcm_gps_get_fix(&fix);
+	CHECK(!fix.bValid);
+	CHECK(fix.utc_date == 201022);
+	CHECK(fix.latitude == 44502057);
+
+	gps_says("GPRMC,123524,A,3352.1200,S,15112.6000,E,0.0,0.0,201022,,,A", true);
+	wcm_gps_get_fix(&fix);
+	CHECK(fix.bValid);
+	CHECK(fix.latitude == -33868667);
+	CHECK(fix.longitude == 151210000);
+
+	// GSA, a 2D fix
+	gps_says("GPGSA,A,2,04,05,09,12,,,,,,,,,2.5,1.3,2.1", true);
+	wcm_gps_get_fix(&fix);
+	CHECK(fix.fix_type == 2);
+	CHECK(fix.hdop == 130);
+
+}	// End of test_sentences
+
+
+int main(void)
+{
+	test_cold_start();
+	test_hot_start();
+	test_no_fix();
+	test_standby_powered_off();
+	test_sentences();
+
+	printf("test_wcm_gps: %s\n", (failures == 0) ? "passed" : "FAILED");
+
+	return ((failures == 0) ? 0 : 1);
+
+}	// End of main
@@ -0,0 +1,598 @@
+/****************************************************************************************
+test_wcm_outbox.c: Host test of the WCM store-and-forward outbox against a fake modem
+	and a fake emulated EEPROM
+
+Written by:
+	Daayim Asim, B.Eng. Student
+	Computer Engineer Student
+	eSonar Inc.
+
+Date:
+	November 2022
+
+Note(s):
+- Builds wcm_outbox.c on a PC with the wcm_at, wcm_adc, wcm_gps, wcm_timer and
+	wcm_usart functions it uses replaced by fakes, with a clock the test moves by hand.
+	stub/eeprom.h stands in for the ASF header, the EEPROM functions here keep 8 pages
+	in RAM and only what was committed survives a reset
+- The fake AT engine keeps the last command queued and its callback, the test answers
+	for the modem by calling it
+- Run with "make" in this directory
+*****************************************************************************************/
+
+
+#include <eeprom.h>
+#include <stdio.h>
+#include <string.h>
+#include "wcm_outbox.h"
+#include "wcm_adc.h"
+#include "wcm_at.h"
+#include "wcm_gps.h"
+#include "wcm_timer.h"
+#include "wcm_usart.h"
+
+
+#define CHECK(condition)	check((condition), #condition, __LINE__)
+
+#define EEPROM_PAGES		8
+#define OUTBOX_OFFSET		EEPROM_PAGE_SIZE
+
+
+/****************************************************************************************
+Local variable(s)
+*****************************************************************************************/
+
+// Fake EEPROM: the page buffer written to and what was last committed
+static uint8_t eeprom_buffer[EEPROM_PAGES * EEPROM_PAGE_SIZE];
+static uint8_t eeprom_committed[EEPROM_PAGES * EEPROM_PAGE_SIZE];
+static bool bEepromPresent = false;
+static int eeprom_commits = 0;
+
+// Fake AT engine: the last command queued, its data and callback
+static char at_command[32];
+static uint8_t at_data[OUTBOX_PAYLOAD_LENGTH + 2];
+static uint16_t at_data_length = 0;
+static wcm_at_callback at_callback = NULL;
+static bool bAtAccepts = true;
+
+// Sensors
+static float leak_v = 0.25f;
+static uint32_t now_ms = 0;
+
+// Last message to the PC
+static char pc_message[192];
+
+static int failures = 0;
+
+
+/****************************************************************************************
+Local function(s)
+*****************************************************************************************/
+
+static void check(bool, const char *, int);
+static uint32_t get_le(const uint8_t *, int);
+static void modem_answers(enum wcm_at_result, const char *);
+static void reset_eeprom(void);
+static void run(void);
+static void test_alarms(void);
+static void test_batching(void);
+static void test_drop_while_sending(void);
+static void test_restore(void);
+
+
+/****************************************************************************************
+Fake EEPROM emulator functions
+*****************************************************************************************/
+enum status_code eeprom_emulator_get_parameters(struct eeprom_emulator_parameters *const parameters)
+{
+	if (bEepromPresent == false)
+	{
+		return (STATUS_ERR_NOT_INITIALIZED);
+	}
+
+	parameters->page_size = EEPROM_PAGE_SIZE;
+	parameters->eeprom_number_of_pages = EEPROM_PAGES;
+	return (STATUS_OK);
+
+}	// End of eeprom_emulator_get_parameters
+
+
+enum status_code eeprom_emulator_commit_page_buffer(void)
+{
+	memcpy(eeprom_committed, eeprom_buffer, sizeof(eeprom_committed));
+	eeprom_commits++;
+	return (STATUS_OK);
+
+}	// End of eeprom_emulator_commit_page_buffer
+
+
+enum status_code eeprom_emulator_write_buffer(const uint16_t offset, const uint8_t *const data, const uint16_t length)
+{
+	if ((offset + length) > sizeof(eeprom_buffer))
+	{
+		return (STATUS_ERR_BAD_ADDRESS);
+	}
+
+	memcpy(&eeprom_buffer[offset], data, length);
+	return (STATUS_OK);
+
+}	// End of eeprom_emulator_write_buffer
+
+
+enum status_code eeprom_emulator_read_buffer(const uint16_t offset, uint8_t *const data, const uint16_t length)
+{
+	if ((offset + length) > sizeof(eeprom_buffer))
+	{
+		return (STATUS_ERR_BAD_ADDRESS);
+	}
+
+	memcpy(data, &eeprom_buffer[offset], length);
+	return (STATUS_OK);
+
+}	// End of eeprom_emulator_read_buffer
+
+
+/****************************************************************************************
+Fake wcm_at, wcm_adc, wcm_gps, wcm_timer and wcm_usart functions
+*****************************************************************************************/
+bool wcm_at_queue(const char *command, const char *expected, uint32_t timeout_ms, wcm_at_callback callback)
+{
+	(void)expected;
+	(void)timeout_ms;
+
+	if (bAtAccepts == false)
+	{
+		return (false);
+	}
+
+	strcpy(at_command, command);
+	at_data_length = 0;
+	at_callback = callback;
+	return (true);
+
+}	// End of wcm_at_queue
+
+
+bool wcm_at_queue_data(const char *command, const uint8_t *data, uint16_t length, const char *expected,
+	uint32_t timeout_ms, wcm_at_callback callback)
+{
+	if (wcm_at_queue(command, expected, timeout_ms, callback) == false)
+	{
+		return (false);
+	}
+
+	memcpy(at_data, data, length);
+	at_data_length = length;
+	return (true);
+
+}	// End of wcm_at_queue_data
+
+
+void wcm_at_get_stats(struct wcm_at_stats *stats)
+{
+	memset(stats, 0, sizeof(*stats));
+	stats->power_on_ms = 60000;
+
+}	// End of wcm_at_get_stats
+
+
+enum status_code wcm_adc_read(float *v)
+{
+	*v = leak_v;
+	return (STATUS_OK);
+
+}	// End of wcm_adc_read
+
+
+enum status_code wcm_adc_read_channel(enum wcm_adc_channel channel, float *v)
+{
+	switch (channel)
+	{
+		case WCM_ADC_CHANNEL_LEAK:
+			*v = leak_v;
+			break;
+
+		case WCM_ADC_CHANNEL_BATTERY:
+			*v = 3.5f;
+			break;
+
+		case WCM_ADC_CHANNEL_TEMPERATURE:
+			*v = -1.5f;
+			break;
+
+		default:
+			return (STATUS_ERR_INVALID_ARG);
+	}
+
+	return (STATUS_OK);
+
+}	// End of wcm_adc_read_channel
+
+
+bool wcm_gps_get_fix(struct wcm_gps_fix *fix)
+{
+	memset(fix, 0, sizeof(*fix));
+	fix->latitude = 44502167;
+	fix->longitude = -63592667;
+	return (true);
+
+}	// End of wcm_gps_get_fix
+
+
+uint32_t wcm_timer_get_ms(void)
+{
+	return (now_ms);
+
+}	// End of wcm_timer_get_ms
+
+
+uint32_t wcm_timer_elapsed_ms(uint32_t since)
+{
+	return (now_ms - since);
+
+}	// End of wcm_timer_elapsed_ms
+
+
+void wcm_usart_send_pc_message(const char *message)
+{
+	strcpy(pc_message, message);
+
+}	// End of wcm_usart_send_pc_message
+
+
+/****************************************************************************************
+Local function to count a failed check
+*****************************************************************************************/
+static void check(bool bPassed, const char *condition, int line)
+{
+	if (!bPassed)
+	{
+		printf("test_wcm_outbox.c:%d: FAILED %s\n", line, condition);
+		failures++;
+	}
+
+}	// End of check
+
+
+/****************************************************************************************
+Local function to read a little endian value of 1 to 4 bytes
+*****************************************************************************************/
+static uint32_t get_le(const uint8_t *p, int bytes)
+{
+	uint32_t value = 0;
+
+	while (bytes-- > 0)
+	{
+		value = (value << 8) | p[bytes];
+	}
+
+	return (value);
+
+}	// End of get_le
+
+
+/****************************************************************************************
+Local function to complete the last command queued, as the AT engine would
+*****************************************************************************************/
+static void modem_answers(enum wcm_at_result result, const char *response)
+{
+	char command[sizeof(at_command)];
+	wcm_at_callback callback = at_callback;
+
+	strcpy(command, at_command);
+	at_command[0] = '\0';
+	at_callback = NULL;
+
+	CHECK(callback != NULL);
+	if (callback != NULL)
+	{
+		callback(command, result, response);
+	}
+
+}	// End of modem_answers
+
+
+/****************************************************************************************
+Local function to lose what was written to the EEPROM but not committed, as a reset would
+*****************************************************************************************/
+static void reset_eeprom(void)
+{
+	memcpy(eeprom_buffer, eeprom_committed, sizeof(eeprom_buffer));
+
+}	// End of reset_eeprom
+
+
+/****************************************************************************************
+Local function to run the outbox, as the main loop would
+*****************************************************************************************/
+static void run(void)
+{
+	wcm_outbox_service();
+
+}	// End of run
+
+
+/****************************************************************************************
+Tests
+*****************************************************************************************/
+static void test_batching(void)
+{
+	uint16_t checksum = 0;
+	int i;
+
+	now_ms = 0;
+	wcm_outbox_init();
+	CHECK(strcmp(pc_message, "wcm_outbox_init: No EEPROM, outbox not saved\r\n") == 0);
+
+	bEepromPresent = true;
+	wcm_outbox_init();
+	CHECK(wcm_outbox_get_length() == 0);
+
+	// A summary every 15 minutes, no message until another would not fit
+	for (i = 1; i <= 16; i++)
+	{
+		now_ms = i * OUTBOX_SUMMARY_MS;
+		run();
+	}
+	CHECK(wcm_outbox_get_length() == 16 * 19);
+	CHECK(at_command[0] == '\0');
+
+	now_ms = 17 * OUTBOX_SUMMARY_MS;
+	run();
+	CHECK(strcmp(at_command, "AT+SBDWB=328") == 0);
+	CHECK(at_data_length == 330);
+
+	// Header, then the first summary
+	CHECK(at_data[0] == 1);
+	CHECK(get_le(&at_data[1], 4) == 17 * 900);
+	CHECK(at_data[5] == OUTBOX_RECORD_SUMMARY);
+	CHECK(get_le(&at_data[6], 4) == 900);
+	CHECK((int32_t)get_le(&at_data[10], 4) == 44502167);
+	CHECK((int32_t)get_le(&at_data[14], 4) == -63592667);
+	CHECK(get_le(&at_data[18], 2) == 250);
+	CHECK(get_le(&at_data[20], 2) == 3500);
+	CHECK((int16_t)get_le(&at_data[22], 2) == -15);
+	CHECK(get_le(&at_data[5 + 16 * 19 + 1], 4) == 17 * 900);
+
+	for (i = 0; i < 328; i++)
+	{
+		checksum += at_data[i];
+	}
+	CHECK(at_data[328] == (uint8_t)(checksum >> 8));
+	CHECK(at_data[329] == (uint8_t)checksum);
+
+	// Nothing more is queued while the message is being sent
+	strcpy(at_command, "");
+	run();
+	CHECK(at_command[0] == '\0');
+	strcpy(at_command, "AT+SBDWB=328");
+
+	modem_answers(AT_RESULT_OK, "0");
+	CHECK(strcmp(at_command, "AT+SBDIX") == 0);
+	modem_answers(AT_RESULT_OK, "+SBDIX: 0, 1, 0, 0, 0, 0");
+	CHECK(strcmp(pc_message, "OUTBOX_SENT 328\r\n") == 0);
+	CHECK(wcm_outbox_get_length() == 0);
+
+	// Saved empty after the window
+	reset_eeprom();
+	CHECK(get_le(&eeprom_buffer[OUTBOX_OFFSET], 2) == 0x0B0C);
+	CHECK(get_le(&eeprom_buffer[OUTBOX_OFFSET + 2], 2) == 0);
+	CHECK(get_le(&eeprom_buffer[OUTBOX_OFFSET + 4], 2) == 0);
+
+	run();
+	CHECK(at_command[0] == '\0');
+
+	// 60 s of modem on time in 4.25 hours
+	wcm_outbox_report();
+	CHECK(strcmp(pc_message, "OUTBOX 0 0 1 0 328 328 0 338 0\r\n") == 0);
+
+}	// End of test_batching
+
+
+static void test_alarms(void)
+{
+	int commits;
+
+	// A leak alarm is saved at once and sent without waiting
+	commits = eeprom_commits;
+	now_ms += 1000;
+	leak_v = 1.6f;
+	run();
+	CHECK(strcmp(pc_message, "OUTBOX_ALARM 2 1600\r\n") == 0);
+	CHECK(eeprom_commits == commits + 1);
+	CHECK(get_le(&eeprom_committed[OUTBOX_OFFSET + 2], 2) == 7);
+	CHECK(strcmp(at_command, "AT+SBDWB=12") == 0);
+	CHECK(at_data[5] == OUTBOX_RECORD_LEAK);
+	CHECK(get_le(&at_data[10], 2) == 1600);
+
+	// Queued once while the leak lasts, and once per fault
+	now_ms += 1000;
+	run();
+	wcm_outbox_fault_seen();
+	wcm_outbox_fault_seen();
+	CHECK(wcm_outbox_get_length() == 14);
+
+	modem_answers(AT_RESULT_OK, "0");
+	modem_answers(AT_RESULT_OK, "+SBDIX: 1, 2, 0, 0, 0, 0");
+	CHECK(wcm_outbox_get_length() == 7);
+
+	// The fault alarm follows in the same window
+	run();
+	CHECK(strcmp(at_command, "AT+SBDWB=12") == 0);
+	CHECK(at_data[5] == OUTBOX_RECORD_FAULT);
+
+	// A failed window keeps the alarm and waits before trying again
+	modem_answers(AT_RESULT_ERROR, "");
+	CHECK(strcmp(pc_message, "OUTBOX_FAIL\r\n") == 0);
+	CHECK(wcm_outbox_get_length() == 7);
+
+	now_ms += OUTBOX_RETRY_MS - 1;
+	run();
+	CHECK(at_command[0] == '\0');
+
+	now_ms++;
+	run();
+	CHECK(strcmp(at_command, "AT+SBDWB=12") == 0);
+	modem_answers(AT_RESULT_OK, "0");
+
+	// A mobile originated status above 4 is a failure
+	modem_answers(AT_RESULT_OK, "+SBDIX: 32, 3, 0, 0, 0, 0");
+	CHECK(strcmp(pc_message, "OUTBOX_FAIL\r\n") == 0);
+	CHECK(wcm_outbox_get_length() == 7);
+
+	wcm_outbox_send_now();
+	run();
+	modem_answers(AT_RESULT_OK, "0");
+	modem_answers(AT_RESULT_OK, "+SBDIX: 0, 4, 0, 0, 0, 0");
+	CHECK(wcm_outbox_get_length() == 0);
+
+	// The leak alarm is re-armed below the clear level
+	leak_v = 1.4f;
+	run();
+	CHECK(at_command[0] == '\0');
+	leak_v = 1.6f;
+	run();
+	CHECK(strcmp(pc_message, "OUTBOX_ALARM 2 1600\r\n") == 0);
+	modem_answers(AT_RESULT_OK, "0");
+	modem_answers(AT_RESULT_OK, "+SBDIX: 0, 5, 0, 0, 0, 0");
+	CHECK(wcm_outbox_get_length() == 0);
+
+	leak_v = 0.25f;
+	run();
+
+}	// End of test_alarms
+
+
+static void test_restore(void)
+{
+	int i;
+
+	// The modem cannot take a message, so the summaries build up past what the
+	// EEPROM holds (8 pages less the MC3416 page and the header, 414 bytes)
+	bAtAccepts = false;
+	for (i = 0; i < 25; i++)
+	{
+		CHECK(wcm_outbox_add_summary());
+	}
+	CHECK(wcm_outbox_get_length() == 25 * 19);
+
+	// Saved hourly, before this window fails
+	now_ms += OUTBOX_PERSIST_MS;
+	run();
+	CHECK(strcmp(pc_message, "OUTBOX_FAIL\r\n") == 0);
+	CHECK(wcm_outbox_get_length() == 26 * 19);
+	CHECK(get_le(&eeprom_committed[OUTBOX_OFFSET + 2], 2) == 0);
+	CHECK(get_le(&eeprom_committed[OUTBOX_OFFSET + 4], 2) == 21 * 19);
+
+	// Only what was saved comes back after a reset
+	reset_eeprom();
+	wcm_outbox_init();
+	CHECK(wcm_outbox_get_length() == 21 * 19);
+
+	bAtAccepts = true;
+	now_ms += OUTBOX_RETRY_MS;
+	run();
+	CHECK(strcmp(at_command, "AT+SBDWB=328") == 0);
+	CHECK((get_le(&at_data[1], 4) & 0x80000000ul) == 0);
+	CHECK((get_le(&at_data[6], 4) & 0x80000000ul) != 0);
+	CHECK((get_le(&at_data[5 + 16 * 19 + 1], 4) & 0x80000000ul) != 0);
+	modem_answers(AT_RESULT_OK, "0");
+	modem_answers(AT_RESULT_OK, "+SBDIX: 0, 6, 0, 0, 0, 0");
+	CHECK(wcm_outbox_get_length() == 4 * 19);
+
+	// The oldest summary is dropped when the outbox is full
+	for (i = 4; i < OUTBOX_SUMMARY_LENGTH / 19; i++)
+	{
+		CHECK(wcm_outbox_add_summary());
+	}
+	CHECK(!wcm_outbox_add_summary());
+	CHECK(wcm_outbox_get_length() == (OUTBOX_SUMMARY_LENGTH / 19) * 19);
+
+}	// End of test_restore
+
+
+static void test_drop_while_sending(void)
+{
+	uint32_t first_s;
+	unsigned int dropped_before;
+	unsigned int dropped_after;
+	int i;
+
+	// Empty the outbox
+	while (wcm_outbox_get_length() > 0)
+	{
+		wcm_outbox_send_now();
+		run();
+		modem_answers(AT_RESULT_OK, "0");
+		modem_answers(AT_RESULT_OK, "+SBDIX: 0, 7, 0, 0, 0, 0");
+	}
+	wcm_outbox_report();
+	CHECK(sscanf(pc_message, "OUTBOX %*u %*u %*u %*u %*u %*u %u", &dropped_before) == 1);
+
+	// Fill it with a summary a second, then start sending the oldest 17
+	for (i = 0; i < OUTBOX_SUMMARY_LENGTH / 19; i++)
+	{
+		now_ms += 1000;
+		CHECK(wcm_outbox_add_summary());
+	}
+	run();
+	CHECK(strcmp(at_command, "AT+SBDWB=328") == 0);
+	first_s = get_le(&at_data[6], 4);
+
+	// Two more summaries while the message is in flight drop the two oldest that are
+	// not in it, so the 17 sent are the ones removed
+	now_ms += 1000;
+	CHECK(!wcm_outbox_add_summary());
+	now_ms += 1000;
+	CHECK(!wcm_outbox_add_summary());
+	modem_answers(AT_RESULT_OK, "0");
+	modem_answers(AT_RESULT_OK, "+SBDIX: 0, 8, 0, 0, 0, 0");
+	CHECK(wcm_outbox_get_length() == (OUTBOX_SUMMARY_LENGTH / 19 - 17) * 19);
+
+	run();
+	CHECK(strcmp(at_command, "AT+SBDWB=328") == 0);
+	CHECK(get_le(&at_data[6], 4) == first_s + 19);
+	modem_answers(AT_RESULT_OK, "0");
+	modem_answers(AT_RESULT_OK, "+SBDIX: 0, 9, 0, 0, 0, 0");
+
+	// The summaries of a message that failed are sent again, the drops while it was in
+	// flight came after them
+	for (i = 0; i < 17; i++)
+	{
+		now_ms += 1000;
+		CHECK(wcm_outbox_add_summary());
+	}
+	wcm_outbox_send_now();
+	run();
+	CHECK(strcmp(at_command, "AT+SBDWB=328") == 0);
+	first_s = get_le(&at_data[6], 4);
+	for (i = 0; i < 20; i++)
+	{
+		now_ms += 1000;
+		wcm_outbox_add_summary();
+	}
+	modem_answers(AT_RESULT_ERROR, "");
+	CHECK(strcmp(pc_message, "OUTBOX_FAIL\r\n") == 0);
+	wcm_outbox_send_now();
+	run();
+	CHECK(get_le(&at_data[6], 4) == first_s);
+
+	wcm_outbox_report();
+	CHECK(sscanf(pc_message, "OUTBOX %*u %*u %*u %*u %*u %*u %u", &dropped_after) == 1);
+	CHECK(dropped_after > dropped_before + 2);
+
+}	// End of test_drop_while_sending
+
+
+int main(void)
+{
+	test_batching();
+	test_alarms();
+	test_restore();
+	test_drop_while_sending();
+
+	printf("test_wcm_outbox: %s\n", (failures == 0) ? "passed" : "FAILED");
+
+	return ((failures == 0) ? 0 : 1);
+
+}	// End of main
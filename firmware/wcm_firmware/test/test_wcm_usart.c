@@ -0,0 +1,422 @@
+/****************************************************************************************
+test_wcm_usart.c: Host test of the WCM PC and SAT/CELL transmit queues against fake
+	SERCOMs and a fake DMA
+
+Written by:
+	Daayim Asim, B.Eng. Student
+	Computer Engineer Student
+	eSonar Inc.
+
+Date:
+	November 2022
+
+Note(s):
+- Builds wcm_usart.c on a PC with stub/usart.h, stub/sercom.h, stub/sercom_interrupt.h
+	and stub/system_interrupt.h standing in for the ASF headers, and the wcm_dma and
+	wcm_timer functions it uses replaced by fakes
+- The fake DMA keeps the block each channel was started with. dma_finish() copies it
+	to dma_sent[] of the channel and calls the done function as the interrupt would,
+	which starts the next block of the same queue
+- The fake clock moves on 1 ms each time it is read, so the waits in wcm_usart.c end
+- The queues are not reset between the tests, each one starts where the last one
+	left them
+- Run with "make" in this directory
+*****************************************************************************************/
+
+
+#include <sercom_interrupt.h>
+#include <stdio.h>
+#include <string.h>
+#include <system_interrupt.h>
+#include <usart.h>
+#include "wcm_dma.h"
+#include "wcm_timer.h"
+#include "wcm_usart.h"
+
+
+#define CHECK(condition)	check((condition), #condition, __LINE__)
+
+#define PC		WCM_DMA_CHANNEL_PC_TX
+#define COM		WCM_DMA_CHANNEL_COM_TX
+
+#define QUEUE_LENGTH	512
+
+
+/****************************************************************************************
+Local variable(s)
+*****************************************************************************************/
+
+// Fake SERCOM0 to SERCOM2, see stub/usart.h and stub/sercom_interrupt.h
+Sercom fake_sercom[3];
+sercom_handler_t fake_sercom_handlers[3];
+uint8_t fake_written[3][FAKE_WRITTEN_LENGTH];
+uint16_t fake_written_length[3];
+
+// See stub/system_interrupt.h
+void (*fake_interrupt)(void) = NULL;
+uint32_t fake_ipsr = 0;
+
+// Fake DMA: the block being sent on each channel and everything sent so far
+static bool bDmaFails = false;
+static bool bDmaBusy[WCM_DMA_CHANNELS];
+static const volatile uint8_t *dma_source[WCM_DMA_CHANNELS];
+static volatile void *dma_destination[WCM_DMA_CHANNELS];
+static uint16_t dma_length[WCM_DMA_CHANNELS];
+static int dma_starts[WCM_DMA_CHANNELS];
+static int dma_aborts[WCM_DMA_CHANNELS];
+static void (*dma_done[WCM_DMA_CHANNELS])(uint8_t, bool);
+static uint8_t dma_sent[WCM_DMA_CHANNELS][2048];
+static uint16_t dma_sent_length[WCM_DMA_CHANNELS];
+
+static uint32_t fake_ms = 0;
+
+static int failures = 0;
+
+
+/****************************************************************************************
+Local function(s)
+*****************************************************************************************/
+
+static void check(bool, const char *, int);
+static void dma_drain(void);
+static void dma_finish(uint8_t);
+static void dma_finish_com(void);
+static void dma_sent_clear(void);
+static void fill(uint8_t *, uint16_t, uint8_t);
+static bool report_is(const char *);
+static bool sent_is(uint8_t, const void *, uint16_t);
+static void test_flush_timeout(void);
+static void test_full_wait(void);
+static void test_interrupt_drop(void);
+static void test_no_dma(void);
+static void test_two_queues(void);
+static void test_wrap(void);
+
+
+/****************************************************************************************
+Fake wcm_dma and wcm_timer functions
+*****************************************************************************************/
+enum status_code wcm_dma_configure(uint8_t channel, const struct wcm_dma_channel_config *config)
+{
+	if (bDmaFails)
+	{
+		return (STATUS_ERR_DENIED);
+	}
+
+	dma_done[channel] = config->done;
+	return (STATUS_OK);
+
+}	// End of wcm_dma_configure
+
+
+enum status_code wcm_dma_start(uint8_t channel, const volatile void *source, volatile void *destination, uint16_t length)
+{
+	CHECK(bDmaBusy[channel] == false);
+	CHECK(length > 0);
+
+	bDmaBusy[channel] = true;
+	dma_source[channel] = source;
+	dma_destination[channel] = destination;
+	dma_length[channel] = length;
+	dma_starts[channel]++;
+	return (STATUS_OK);
+
+}	// End of wcm_dma_start
+
+
+void wcm_dma_abort(uint8_t channel)
+{
+	bDmaBusy[channel] = false;
+	dma_aborts[channel]++;
+
+}	// End of wcm_dma_abort
+
+
+uint32_t wcm_timer_get_ms(void)
+{
+	return (fake_ms++);
+
+}	// End of wcm_timer_get_ms
+
+
+uint32_t wcm_timer_elapsed_ms(uint32_t since)
+{
+	return (fake_ms++ - since);
+
+}	// End of wcm_timer_elapsed_ms
+
+
+/****************************************************************************************
+Local function to count and print a failed check
+*****************************************************************************************/
+static void check(bool bPassed, const char *condition, int line)
+{
+	if (!bPassed)
+	{
+		printf("test_wcm_usart.c:%d: FAILED %s\n", line, condition);
+		failures++;
+	}
+
+}	// End of check
+
+
+/****************************************************************************************
+Local function to send the blocks left in both queues
+*****************************************************************************************/
+static void dma_drain(void)
+{
+	while (bDmaBusy[PC] || bDmaBusy[COM])
+	{
+		dma_finish(PC);
+		dma_finish(COM);
+	}
+
+}	// End of dma_drain
+
+
+/****************************************************************************************
+Local function to end the block being sent on a channel, as the DMA interrupt would
+*****************************************************************************************/
+static void dma_finish(uint8_t channel)
+{
+	if (bDmaBusy[channel] == false)
+	{
+		return;
+	}
+
+	memcpy(&dma_sent[channel][dma_sent_length[channel]], (const void *)dma_source[channel], dma_length[channel]);
+	dma_sent_length[channel] += dma_length[channel];
+	bDmaBusy[channel] = false;
+
+	dma_done[channel](channel, false);
+
+}	// End of dma_finish
+
+
+/****************************************************************************************
+Local function to end the SAT/CELL block, for fake_interrupt
+*****************************************************************************************/
+static void dma_finish_com(void)
+{
+	dma_finish(COM);
+
+}	// End of dma_finish_com
+
+
+/****************************************************************************************
+Local function to forget what the DMA has sent
+*****************************************************************************************/
+static void dma_sent_clear(void)
+{
+	memset(dma_sent, 0, sizeof(dma_sent));
+	memset(dma_sent_length, 0, sizeof(dma_sent_length));
+
+}	// End of dma_sent_clear
+
+
+/****************************************************************************************
+Local function to fill a block with a count from first, so a byte sent twice or out of
+order shows
+*****************************************************************************************/
+static void fill(uint8_t *data, uint16_t length, uint8_t first)
+{
+	uint16_t i;
+
+	for (i = 0; i < length; i++)
+	{
+		data[i] = (uint8_t)(first + i);
+	}
+
+}	// End of fill
+
+
+/****************************************************************************************
+Local function to check the TX_QUEUE report, which goes through the PC queue itself
+*****************************************************************************************/
+static bool report_is(const char *expected)
+{
+	dma_drain();
+	dma_sent_clear();
+
+	wcm_usart_report_queues();
+	dma_drain();
+
+	return (sent_is(PC, expected, strlen(expected)));
+
+}	// End of report_is
+
+
+/****************************************************************************************
+Local function to check what the DMA has sent on a channel
+*****************************************************************************************/
+static bool sent_is(uint8_t channel, const void *expected, uint16_t length)
+{
+	return ((dma_sent_length[channel] == length) && (memcmp(dma_sent[channel], expected, length) == 0));
+
+}	// End of sent_is
+
+
+/****************************************************************************************
+Tests
+*****************************************************************************************/
+static void test_two_queues(void)
+{
+	fake_sercom[0].USART.INTFLAG.reg = SERCOM_USART_INTFLAG_TXC;
+	fake_sercom[2].USART.INTFLAG.reg = SERCOM_USART_INTFLAG_TXC;
+	wcm_usart_configure();
+	CHECK(dma_done[PC] != NULL);
+	CHECK(dma_done[COM] != NULL);
+
+	// Each queue starts its own channel, on its own port
+	wcm_usart_send_pc_message("PC1\r\n");
+	wcm_usart_send_com_command("AT\r");
+	CHECK(dma_starts[PC] == 1);
+	CHECK(dma_starts[COM] == 1);
+	CHECK(dma_destination[PC] == &fake_sercom[2].USART.DATA.reg);
+	CHECK(dma_destination[COM] == &fake_sercom[0].USART.DATA.reg);
+
+	wcm_usart_send_pc_message("PC2\r\n");
+	wcm_usart_send_com_data((const uint8_t *)"\x01\x02", 2);
+
+	// The SAT/CELL block ending starts the next SAT/CELL block, the PC one is still busy
+	dma_finish(COM);
+	CHECK(dma_starts[COM] == 2);
+	CHECK(dma_length[COM] == 2);
+	CHECK(dma_starts[PC] == 1);
+	CHECK(bDmaBusy[PC]);
+
+	dma_drain();
+	CHECK(sent_is(PC, "PC1\r\nPC2\r\n", 10));
+	CHECK(sent_is(COM, "AT\r\x01\x02", 5));
+
+}	// End of test_two_queues
+
+
+static void test_wrap(void)
+{
+	uint8_t data[510];
+	int starts = dma_starts[COM];
+
+	// From 5 bytes in, the block runs past the end of the queue: the DMA sends up to
+	// the end, then the 3 bytes written at the start
+	dma_sent_clear();
+	fill(data, sizeof(data), 0);
+	wcm_usart_send_com_data(data, sizeof(data));
+	CHECK(dma_starts[COM] == starts + 1);
+	CHECK(dma_length[COM] == QUEUE_LENGTH - 5);
+
+	dma_finish(COM);
+	CHECK(dma_starts[COM] == starts + 2);
+	CHECK(dma_length[COM] == 3);
+
+	dma_drain();
+	CHECK(sent_is(COM, data, sizeof(data)));
+
+}	// End of test_wrap
+
+
+static void test_full_wait(void)
+{
+	uint8_t data[QUEUE_LENGTH - 1 + 100];
+
+	// One byte short of the queue length fills it while the DMA is still busy
+	dma_sent_clear();
+	fill(data, sizeof(data), 7);
+	wcm_usart_send_com_data(data, QUEUE_LENGTH - 1);
+	CHECK(bDmaBusy[COM]);
+
+	// The rest waits until the DMA interrupt, which runs when the critical section ends
+	fake_interrupt = dma_finish_com;
+	wcm_usart_send_com_data(&data[QUEUE_LENGTH - 1], 100);
+	fake_interrupt = NULL;
+
+	dma_drain();
+	CHECK(sent_is(COM, data, sizeof(data)));
+
+	CHECK(report_is("TX_QUEUE PC 512 10 0 0\r\nTX_QUEUE COM 512 511 1 0\r\n"));
+
+}	// End of test_full_wait
+
+
+static void test_interrupt_drop(void)
+{
+	char message[QUEUE_LENGTH - 1];
+
+	// A message one byte short of filling the queue, and the byte that fills it
+	dma_sent_clear();
+	memset(message, 'A', sizeof(message) - 1);
+	message[sizeof(message) - 1] = '\0';
+	wcm_usart_send_pc_message(message);
+	wcm_usart_send_pc_message("!");
+
+	// An interrupt cannot wait for the DMA interrupt, its message is dropped
+	fake_ipsr = 3;
+	wcm_usart_send_pc_message("EVENT\r\n");
+	fake_ipsr = 0;
+
+	dma_drain();
+	CHECK(dma_sent_length[PC] == sizeof(message));
+	CHECK(memcmp(dma_sent[PC], message, sizeof(message) - 1) == 0);
+	CHECK(dma_sent[PC][sizeof(message) - 1] == '!');
+
+	CHECK(report_is("TX_QUEUE PC 512 511 0 7\r\nTX_QUEUE COM 512 511 1 0\r\n"));
+
+}	// End of test_interrupt_drop
+
+
+static void test_flush_timeout(void)
+{
+	// The SAT/CELL DMA never finishes: reconfiguring the port waits its time for the
+	// queue, then drops what is left
+	wcm_usart_send_com_command("AT+SBDIX\r");
+	wcm_usart_send_com_command("AT\r");
+	CHECK(bDmaBusy[COM]);
+
+	wcm_usart_configure();
+	CHECK(dma_aborts[COM] == 1);
+	CHECK(dma_aborts[PC] == 0);
+	CHECK(bDmaBusy[COM] == false);
+
+	// The port is usable again
+	dma_sent_clear();
+	wcm_usart_send_com_command("AT\r");
+	dma_drain();
+	CHECK(sent_is(COM, "AT\r", 3));
+
+	CHECK(report_is("TX_QUEUE PC 512 511 0 7\r\nTX_QUEUE COM 512 511 1 12\r\n"));
+
+}	// End of test_flush_timeout
+
+
+static void test_no_dma(void)
+{
+	// Without the DMA channels the bytes are written by the CPU
+	bDmaFails = true;
+	wcm_usart_configure();
+	dma_sent_clear();
+
+	wcm_usart_send_pc_message("PLAIN\r\n");
+	wcm_usart_send_com_command("AT\r");
+	CHECK(dma_sent_length[PC] == 0 && dma_sent_length[COM] == 0);
+	CHECK(fake_written_length[2] == 7);
+	CHECK(memcmp(fake_written[2], "PLAIN\r\n", 7) == 0);
+	CHECK(fake_written_length[0] == 3);
+	CHECK(memcmp(fake_written[0], "AT\r", 3) == 0);
+
+}	// End of test_no_dma
+
+
+int main(void)
+{
+	test_two_queues();
+	test_wrap();
+	test_full_wait();
+	test_interrupt_drop();
+	test_flush_timeout();
+	test_no_dma();
+
+	printf("test_wcm_usart: %s\n", (failures == 0) ? "passed" : "FAILED");
+
+	return ((failures == 0) ? 0 : 1);
+
+}	// End of main
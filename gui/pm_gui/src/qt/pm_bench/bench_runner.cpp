@@ -0,0 +1,466 @@
+/***************************************************************************
+bench_runner.cpp:  Command protocol benchmark class functions
+
+Written by:
+    Sandra Mercer, P.Eng.
+    Engineer / Software Developer
+    eSonar Inc.
+
+Date:
+    November 2022
+
+Note(s):
+- Sends a mix of commands through the same SerialWorker, CommandQueue and
+ResponseStream as the GUI, one outstanding at a time, the next as soon as
+the last one ends. The latency of a command is the CommandQueue round
+trip, from writing the request to its END or ERROR line, so it includes
+the wire time both ways and the power module's handling
+- The mix is a list of commands with weights, sent in smooth weighted
+round robin order rather than at random, so two runs send the same
+sequence. "toggle" alternates "<togglePin> 1" and "<togglePin> 0", and
+the pin is set back to 0 after the run, unmeasured
+- The first warmup commands are not measured. The run lasts for count
+measured commands, or durationS seconds when it is set. Commands per
+second and bytes per second are over the measured commands only
+- A timeout is counted and left out of the latency percentiles. An ERROR
+answer, or an END showing the command was INVALID, is counted as an error
+and kept in them
+****************************************************************************/
+
+
+#include <algorithm>
+#include <cmath>
+#include <QDebug>
+#include <QFile>
+#include <QJsonArray>
+#include <QSerialPort>
+#include <QTextStream>
+#include <QThread>
+#include "bench_runner.h"
+#include "command_queue.h"
+#include "response_stream.h"
+#include "serial_worker.h"
+
+
+// Local function(s)
+static QJsonObject summarize(QVector<double> &);
+
+
+/***************************************************************************
+Local function to return the count, mean and percentiles of latencies in
+ms, sorting them. The percentiles are nearest rank
+****************************************************************************/
+static QJsonObject summarize(QVector<double> &latencies)
+{
+    QJsonObject summary;
+    const double percentiles[] = {50.0, 90.0, 99.0, 99.9};
+    const char *const names[] = {"p50", "p90", "p99", "p999"};
+
+    summary["count"] = latencies.size();
+    if (latencies.isEmpty())
+        return (summary);
+
+    std::sort(latencies.begin(), latencies.end());
+
+    double sum = 0.0;
+    for (double latency : latencies)
+        sum += latency;
+
+    summary["min"] = latencies.first();
+    summary["mean"] = sum / latencies.size();
+    for (int i = 0; i < 4; i++)
+    {
+        int rank = int(std::ceil(percentiles[i] / 100.0 * latencies.size()));
+        summary[names[i]] = latencies.at(qBound(1, rank, latencies.size()) - 1);
+    }
+    summary["max"] = latencies.last();
+
+    return (summary);
+
+}   // End of summarize
+
+
+/***************************************************************************
+BenchRunner constructor
+****************************************************************************/
+BenchRunner::BenchRunner(const Config &config, QObject *parent)
+    : QObject(parent), config(config)
+{
+    bOpen = false;
+    bRunning = false;
+    bRestoring = false;
+    bToggleHigh = false;
+    sent = 0;
+    activeEntry = 0;
+    lastTimeouts = 0;
+    lastErrors = 0;
+    runNs = 0;
+    txBytes = 0;
+    rxBytes = 0;
+
+    totalWeight = 0;
+    current.fill(0, config.mix.size());
+    for (const MixEntry &entry : config.mix)
+        totalWeight += entry.weight;
+
+    // The worker has no parent so it can be moved, it is deleted with the thread
+    workerThread = new QThread(this);
+    worker = new SerialWorker;
+    worker->moveToThread(workerThread);
+    connect(workerThread, SIGNAL(finished()), worker, SLOT(deleteLater()));
+    workerThread->start();
+
+    commandQueue = new CommandQueue(this);
+    responseStream = new ResponseStream(commandQueue, &responseParser);
+
+    // Connect the signals and slots
+    connect(worker, SIGNAL(signalError(int)), this, SLOT(slotError(int)));
+    connect(worker, SIGNAL(signalReceived()), this, SLOT(slotReceived()));
+    connect(commandQueue, SIGNAL(signalIdle()), this, SLOT(slotIdle()));
+    connect(commandQueue, SIGNAL(signalWrite(QString)), this, SLOT(slotWrite(QString)));
+
+}   // End of BenchRunner::BenchRunner
+
+
+/***************************************************************************
+BenchRunner destructor
+****************************************************************************/
+BenchRunner::~BenchRunner()
+{
+    if (bOpen)
+        QMetaObject::invokeMethod(worker, "slotClose", Qt::BlockingQueuedConnection);
+
+    workerThread->quit();
+    workerThread->wait();
+
+    delete responseStream;
+
+}   // End of BenchRunner::~BenchRunner
+
+
+/***************************************************************************
+Function to end the run, reason is empty unless it was cut short
+****************************************************************************/
+void BenchRunner::finish(const QString &reason)
+{
+    if (!bRunning)
+        return;
+
+    if (runNs == 0 && runClock.isValid())
+        runNs = runClock.nsecsElapsed();
+
+    abortReason = reason;
+    bRunning = false;
+    commandQueue->clear();
+
+    emit signalFinished();
+
+}   // End of BenchRunner::finish
+
+
+/***************************************************************************
+Function to return the results, for the JSON report
+****************************************************************************/
+QJsonObject BenchRunner::results(void) const
+{
+    QJsonObject root;
+    double seconds = runNs / 1e9;
+    int errors = 0;
+    int timeouts = 0;
+    QVector<double> latencies;
+    QVector<QVector<double>> entryLatencies(config.mix.size());
+    QVector<int> entryErrors(config.mix.size(), 0);
+    QVector<int> entryTimeouts(config.mix.size(), 0);
+    QVector<int> entryCommands(config.mix.size(), 0);
+
+    for (const Sample &sample : samples)
+    {
+        entryCommands[sample.entry]++;
+        if (sample.result == RESULT_TIMEOUT)
+        {
+            timeouts++;
+            entryTimeouts[sample.entry]++;
+            continue;
+        }
+        if (sample.result == RESULT_ERROR)
+        {
+            errors++;
+            entryErrors[sample.entry]++;
+        }
+        latencies.append(sample.latencyMs);
+        entryLatencies[sample.entry].append(sample.latencyMs);
+    }
+
+    root["port"] = config.portName;
+    root["baud_rate"] = config.baudRate;
+    root["timeout_ms"] = config.timeoutMs;
+    root["warmup"] = config.warmup;
+    if (!abortReason.isEmpty())
+        root["aborted"] = abortReason;
+
+    root["duration_s"] = seconds;
+    root["commands"] = samples.size();
+    root["errors"] = errors;
+    root["timeouts"] = timeouts;
+    root["commands_per_s"] = (seconds > 0.0) ? samples.size() / seconds : 0.0;
+    root["tx_bytes"] = txBytes;
+    root["rx_bytes"] = rxBytes;
+    root["tx_bytes_per_s"] = (seconds > 0.0) ? txBytes / seconds : 0.0;
+    root["rx_bytes_per_s"] = (seconds > 0.0) ? rxBytes / seconds : 0.0;
+    root["latency_ms"] = summarize(latencies);
+
+    QJsonArray byCommand;
+    for (int i = 0; i < config.mix.size(); i++)
+    {
+        const MixEntry &entry = config.mix.at(i);
+        QJsonObject command;
+
+        command["command"] = (entry.command == "toggle") ? QString("toggle %1").arg(config.togglePin) : entry.command;
+        command["weight"] = entry.weight;
+        command["commands"] = entryCommands.at(i);
+        command["errors"] = entryErrors.at(i);
+        command["timeouts"] = entryTimeouts.at(i);
+        command["latency_ms"] = summarize(entryLatencies[i]);
+        byCommand.append(command);
+    }
+    root["by_command"] = byCommand;
+
+    return (root);
+
+}   // End of BenchRunner::results
+
+
+/***************************************************************************
+Function to send the next command of the mix
+****************************************************************************/
+void BenchRunner::sendNext(void)
+{
+    // The entry furthest behind its share goes next
+    int next = 0;
+    for (int i = 0; i < config.mix.size(); i++)
+    {
+        current[i] += config.mix.at(i).weight;
+        if (current.at(i) > current.at(next))
+            next = i;
+    }
+    current[next] -= totalWeight;
+
+    QString command = config.mix.at(next).command;
+    if (command == "toggle")
+    {
+        bToggleHigh = !bToggleHigh;
+        command = QString("%1 %2").arg(config.togglePin).arg(bToggleHigh ? 1 : 0);
+    }
+
+    // Measuring starts with the first command after the warmup
+    if (sent == config.warmup)
+    {
+        runClock.start();
+        txBytes = 0;
+        rxBytes = 0;
+    }
+
+    activeEntry = next;
+    lastTimeouts = commandQueue->timeouts();
+    lastErrors = commandQueue->errors();
+    sent++;
+
+    commandQueue->enqueue(command, CommandQueue::PRIORITY_USER, config.timeoutMs);
+
+}   // End of BenchRunner::sendNext
+
+
+/***************************************************************************
+Function to open the port and send the first command
+
+Returns an empty string, or the error
+****************************************************************************/
+QString BenchRunner::start(void)
+{
+    if (totalWeight <= 0)
+        return (QString("The mix is empty"));
+
+    QString error;
+    QMetaObject::invokeMethod(worker, "slotOpen", Qt::BlockingQueuedConnection, Q_RETURN_ARG(QString, error),
+                              Q_ARG(QString, config.portName), Q_ARG(qint32, config.baudRate),
+                              Q_ARG(int, QSerialPort::Data8), Q_ARG(int, QSerialPort::NoParity),
+                              Q_ARG(int, QSerialPort::OneStop), Q_ARG(int, QSerialPort::NoFlowControl));
+    if (!error.isEmpty())
+        return (error);
+
+    bOpen = true;
+    bRunning = true;
+    sendNext();
+
+    return (QString());
+
+}   // End of BenchRunner::start
+
+
+/***************************************************************************
+Function to return a one line progress report for the console
+****************************************************************************/
+QString BenchRunner::status(void) const
+{
+    return (QString("%1: %2 sent, %3 measured, %4 timeouts, %5 errors, rtt %6 ms")
+            .arg(config.portName).arg(sent).arg(samples.size())
+            .arg(commandQueue->timeouts()).arg(commandQueue->errors())
+            .arg(commandQueue->averageRttMs(), 0, 'f', 2));
+
+}   // End of BenchRunner::status
+
+
+/***************************************************************************
+Function to cut the run short, when interrupted
+****************************************************************************/
+void BenchRunner::stop(void)
+{
+    finish(QString("Interrupted"));
+
+}   // End of BenchRunner::stop
+
+
+/***************************************************************************
+Function to write every measured command to a CSV file
+
+Returns an empty string, or the error
+****************************************************************************/
+QString BenchRunner::writeSamples(const QString &fileName) const
+{
+    const char *const results[] = {"ok", "error", "timeout"};
+    QFile file(fileName);
+
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text))
+        return (QString("Could not create %1: %2").arg(fileName).arg(file.errorString()));
+
+    QTextStream stream(&file);
+    stream << "index,command,latency_ms,result\n";
+    for (int i = 0; i < samples.size(); i++)
+    {
+        const Sample &sample = samples.at(i);
+        stream << i << ',' << config.mix.at(sample.entry).command << ','
+               << QString::number(sample.latencyMs, 'f', 3) << ',' << results[sample.result] << '\n';
+    }
+
+    return (QString());
+
+}   // End of BenchRunner::writeSamples
+
+
+/***************************************************************************
+Slot to end the run on a port error, errors that leave the port usable are
+only logged
+****************************************************************************/
+void BenchRunner::slotError(int error)
+{
+    switch (error)
+    {
+    case QSerialPort::NoError:
+        return;
+    case QSerialPort::FramingError:
+    case QSerialPort::ParityError:
+    case QSerialPort::TimeoutError:
+    case QSerialPort::UnsupportedOperationError:
+        qDebug() << "BenchRunner::slotError:" << config.portName << error;
+        return;
+    default:
+        break;
+    }
+
+    finish(QString("Port error %1").arg(error));
+
+}   // End of BenchRunner::slotError
+
+
+/***************************************************************************
+Slot to measure the command that has just ended and send the next one
+****************************************************************************/
+void BenchRunner::slotIdle(void)
+{
+    if (!bRunning)
+        return;
+
+    if (bRestoring)
+    {
+        finish(QString());
+        return;
+    }
+
+    bool bMeasured = (sent > config.warmup);
+    if (bMeasured)
+    {
+        Sample sample;
+        sample.entry = activeEntry;
+        sample.latencyMs = commandQueue->lastRttMs();
+        sample.result = RESULT_OK;
+        if (commandQueue->timeouts() > lastTimeouts)
+        {
+            sample.latencyMs = config.timeoutMs;
+            sample.result = RESULT_TIMEOUT;
+        }
+        else if (commandQueue->errors() > lastErrors)
+            sample.result = RESULT_ERROR;
+        samples.append(sample);
+    }
+
+    bool bDone;
+    if (config.durationS > 0)
+        bDone = bMeasured && runClock.elapsed() >= qint64(config.durationS) * 1000;
+    else
+        bDone = (samples.size() >= config.count);
+
+    if (!bDone)
+    {
+        sendNext();
+        return;
+    }
+
+    runNs = runClock.nsecsElapsed();
+
+    // Leave the toggled pin as it was found, assuming it was off
+    if (bToggleHigh)
+    {
+        bRestoring = true;
+        commandQueue->enqueue(QString("%1 0").arg(config.togglePin), CommandQueue::PRIORITY_USER, config.timeoutMs);
+        return;
+    }
+
+    finish(QString());
+
+}   // End of BenchRunner::slotIdle
+
+
+/***************************************************************************
+Slot to take the received chunks from the worker
+****************************************************************************/
+void BenchRunner::slotReceived(void)
+{
+    SerialWorker::Chunk chunk;
+
+    // Acknowledged first, so a chunk queued while draining signals again
+    worker->acknowledge();
+    while (worker->takeChunk(chunk))
+    {
+        if (!bRunning)
+            continue;
+
+        if (runClock.isValid() && !bRestoring)
+            rxBytes += chunk.data.size();
+        responseStream->append(chunk.data);
+    }
+
+}   // End of BenchRunner::slotReceived
+
+
+/***************************************************************************
+Slot to pass a request from the command queue to the worker
+****************************************************************************/
+void BenchRunner::slotWrite(QString command)
+{
+    QByteArray data = command.toLatin1();
+
+    if (runClock.isValid() && !bRestoring)
+        txBytes += data.size();
+    QMetaObject::invokeMethod(worker, "slotWrite", Qt::QueuedConnection, Q_ARG(QByteArray, data));
+
+}   // End of BenchRunner::slotWrite
@@ -0,0 +1,124 @@
+/***************************************************************************
+bench_runner.h: Include file for bench_runner.cpp
+
+Written by:
+    Sandra Mercer, P.Eng.
+    Engineer / Software Developer
+    eSonar Inc.
+
+Date:
+    November 2022
+****************************************************************************/
+
+
+#ifndef BENCH_RUNNER_H
+#define BENCH_RUNNER_H
+
+
+#include <QElapsedTimer>
+#include <QJsonObject>
+#include <QList>
+#include <QObject>
+#include <QString>
+#include <QVector>
+#include "response_parser.h"
+
+
+class CommandQueue;
+class QThread;
+class ResponseStream;
+class SerialWorker;
+
+
+class BenchRunner : public QObject
+{
+    Q_OBJECT
+
+public:
+
+    // A command of the mix and its share, "toggle" switches togglePin
+    struct MixEntry
+    {
+        QString command;
+        int weight;
+    };
+
+    struct Config
+    {
+        QString portName;
+        qint32 baudRate;
+        QList<MixEntry> mix;
+        QString togglePin;
+        int count;                  // Measured commands, unless durationS is set
+        int durationS;
+        int warmup;                 // Commands sent first and not measured
+        int timeoutMs;
+    };
+
+    explicit BenchRunner(const Config &, QObject *parent = nullptr);
+    ~BenchRunner();
+
+    QString start(void);
+    QJsonObject results(void) const;
+    QString status(void) const;
+    void stop(void);
+    QString writeSamples(const QString &) const;
+
+signals:
+
+    void signalFinished(void);
+
+private slots:
+
+    void slotError(int);
+    void slotIdle(void);
+    void slotReceived(void);
+    void slotWrite(QString);
+
+private:
+
+    enum resultEnum {RESULT_OK, RESULT_ERROR, RESULT_TIMEOUT};
+
+    // One measured command
+    struct Sample
+    {
+        int entry;
+        double latencyMs;
+        resultEnum result;
+    };
+
+    void finish(const QString &);
+    void sendNext(void);
+
+    Config config;
+    bool bOpen;
+    bool bRunning;
+    bool bRestoring;
+    QString abortReason;
+
+    QThread *workerThread;
+    SerialWorker *worker;
+    CommandQueue *commandQueue;
+    ResponseParser responseParser;
+    ResponseStream *responseStream;
+
+    // Smooth weighted round robin over the mix, so a run is repeatable
+    QVector<int> current;
+    int totalWeight;
+    bool bToggleHigh;
+
+    int sent;
+    int activeEntry;
+    int lastTimeouts;
+    int lastErrors;
+
+    QVector<Sample> samples;
+    QElapsedTimer runClock;
+    qint64 runNs;
+    qint64 txBytes;
+    qint64 rxBytes;
+
+};
+
+
+#endif // BENCH_RUNNER_H
@@ -0,0 +1,236 @@
+/***************************************************************************
+main.cpp:  Marine Mammal Detection Power Module command benchmark main
+function
+
+Written by:
+    Sandra Mercer, P.Eng.
+    Engineer / Software Developer
+    eSonar Inc.
+
+Date:
+    November 2022
+
+Note(s):
+- pm_bench [options] <port>
+- Runs a mix of commands against a power module (see BenchRunner) and
+writes the results as JSON, to stdout unless --output is given, so runs on
+different firmware or baud rates can be compared by a script. --label is
+copied into the results for that
+- The port may be a COM port, a device path such as a pseudo terminal fed
+by a simulator, or a pm_broker endpoint. Through the broker the latency
+includes the broker's hop, and other clients share the port
+- Exits with 1 if the run was cut short, the results so far are still
+written
+****************************************************************************/
+
+
+#include <csignal>
+#include <cstdio>
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QFile>
+#include <QJsonDocument>
+#include <QTimer>
+#include "bench_runner.h"
+
+
+// Local variable(s)
+static bool bVerbose = false;
+
+
+// Local function(s)
+static void messageHandler(QtMsgType, const QMessageLogContext &, const QString &);
+static bool parseMix(const QString &, QList<BenchRunner::MixEntry> &);
+static void signalHandler(int);
+
+
+/***************************************************************************
+Local function to print the Qt messages on stderr, out of the way of the
+results, with the qDebug() traces only with --verbose
+****************************************************************************/
+static void messageHandler(QtMsgType type, const QMessageLogContext &, const QString &message)
+{
+    if (type == QtDebugMsg && !bVerbose)
+        return;
+
+    fprintf(stderr, "%s %s\n", qPrintable(QDateTime::currentDateTime().toString(Qt::ISODate)), qPrintable(message));
+    fflush(stderr);
+
+}   // End of messageHandler
+
+
+/***************************************************************************
+Local function to parse a mix, <command>[:<weight>],... with a weight of 1
+by default
+
+Returns false if the mix is not valid
+****************************************************************************/
+static bool parseMix(const QString &text, QList<BenchRunner::MixEntry> &mix)
+{
+    for (const QString &item : text.split(',', Qt::SkipEmptyParts))
+    {
+        QStringList fields = item.trimmed().split(':');
+        BenchRunner::MixEntry entry;
+        bool bOk = true;
+
+        entry.command = fields.at(0).trimmed();
+        entry.weight = (fields.size() > 1) ? fields.at(1).toInt(&bOk) : 1;
+        if (!bOk || fields.size() > 2 || entry.command.isEmpty() || entry.weight < 0)
+            return (false);
+        if (entry.weight > 0)
+            mix.append(entry);
+    }
+
+    return (!mix.isEmpty());
+
+}   // End of parseMix
+
+
+/***************************************************************************
+Local function to end the run on Ctrl+C, the results so far are written
+****************************************************************************/
+static void signalHandler(int)
+{
+    QCoreApplication::quit();
+
+}   // End of signalHandler
+
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QCoreApplication::setApplicationName("pm_bench");
+    QCoreApplication::setApplicationVersion(PM_VERSION);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Measures the command latency and throughput of a power module");
+    parser.addHelpOption();
+    parser.addVersionOption();
+
+    QCommandLineOption baudOption(QStringList() << "b" << "baud", "Baud rate.", "baud", "38400");
+    QCommandLineOption mixOption(QStringList() << "m" << "mix", "Commands and weights, <command>[:<weight>],..., "
+                                 "toggle switches the --toggle-pin output.", "mix",
+                                 "read_ltc2944:1,read_ms5637:1,read_mc3416:1,read_power_bits:1,toggle:1");
+    QCommandLineOption pinOption("toggle-pin", "Output switched by toggle, set back to 0 at the end.", "pin", "WCM_DIAG_EN");
+    QCommandLineOption countOption(QStringList() << "n" << "count", "Commands to measure.", "count", "1000");
+    QCommandLineOption durationOption(QStringList() << "d" << "duration", "Seconds to measure for instead of --count, "
+                                      "0 for none.", "seconds", "0");
+    QCommandLineOption warmupOption(QStringList() << "w" << "warmup", "Commands sent first and not measured.", "count", "20");
+    QCommandLineOption timeoutOption("timeout", "Command timeout in ms.", "ms", "1000");
+    QCommandLineOption outputOption(QStringList() << "o" << "output", "JSON results file, stdout by default.", "file");
+    QCommandLineOption samplesOption("samples", "CSV file of every measured command.", "file");
+    QCommandLineOption labelOption(QStringList() << "l" << "label", "Label for the run, such as the firmware version.", "label");
+    QCommandLineOption statusOption("status", "Seconds between progress reports, 0 for none.", "seconds", "5");
+    QCommandLineOption verboseOption(QStringList() << "v" << "verbose", "Print the protocol traces.");
+    parser.addOption(baudOption);
+    parser.addOption(mixOption);
+    parser.addOption(pinOption);
+    parser.addOption(countOption);
+    parser.addOption(durationOption);
+    parser.addOption(warmupOption);
+    parser.addOption(timeoutOption);
+    parser.addOption(outputOption);
+    parser.addOption(samplesOption);
+    parser.addOption(labelOption);
+    parser.addOption(statusOption);
+    parser.addOption(verboseOption);
+    parser.addPositionalArgument("port", "Serial port or pm_broker endpoint.", "<port>");
+    parser.process(a);
+
+    bVerbose = parser.isSet(verboseOption);
+    qInstallMessageHandler(messageHandler);
+
+    if (parser.positionalArguments().size() != 1)
+        parser.showHelp(1);
+
+    BenchRunner::Config config;
+    bool bOk[6];
+
+    config.portName = parser.positionalArguments().at(0);
+    config.togglePin = parser.value(pinOption);
+    config.baudRate = parser.value(baudOption).toInt(&bOk[0]);
+    config.count = parser.value(countOption).toInt(&bOk[1]);
+    config.durationS = parser.value(durationOption).toInt(&bOk[2]);
+    config.warmup = parser.value(warmupOption).toInt(&bOk[3]);
+    config.timeoutMs = parser.value(timeoutOption).toInt(&bOk[4]);
+    bOk[5] = parseMix(parser.value(mixOption), config.mix);
+    if (!bOk[0] || !bOk[1] || !bOk[2] || !bOk[3] || !bOk[4] || config.baudRate <= 0 || config.count <= 0 ||
+        config.durationS < 0 || config.warmup < 0 || config.timeoutMs <= 0)
+    {
+        qCritical() << "Bad option value";
+        return (1);
+    }
+    if (!bOk[5])
+    {
+        qCritical() << "Bad mix" << parser.value(mixOption);
+        return (1);
+    }
+
+    BenchRunner runner(config);
+    QObject::connect(&runner, SIGNAL(signalFinished()), &a, SLOT(quit()));
+
+    QString started = QDateTime::currentDateTime().toString(Qt::ISODate);
+    QString error = runner.start();
+    if (!error.isEmpty())
+    {
+        qCritical().noquote() << error;
+        return (1);
+    }
+
+    QTimer statusTimer;
+    int statusSeconds = parser.value(statusOption).toInt();
+    if (statusSeconds > 0)
+    {
+        QObject::connect(&statusTimer, &QTimer::timeout, [&runner]() {
+            qWarning().noquote() << runner.status();
+        });
+        statusTimer.start(statusSeconds * 1000);
+    }
+
+    std::signal(SIGINT, signalHandler);
+    std::signal(SIGTERM, signalHandler);
+
+    a.exec();
+    runner.stop();
+
+    QJsonObject results = runner.results();
+    results["tool"] = QString("pm_bench %1").arg(PM_VERSION);
+    results["started"] = started;
+    if (parser.isSet(labelOption))
+        results["label"] = parser.value(labelOption);
+    results["mix"] = parser.value(mixOption);
+
+    bool bAborted = results.contains("aborted");
+
+    QByteArray json = QJsonDocument(results).toJson(QJsonDocument::Indented);
+    if (parser.isSet(outputOption))
+    {
+        QFile file(parser.value(outputOption));
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(json) != json.size())
+        {
+            qCritical().noquote() << "Could not write" << file.fileName() << file.errorString();
+            return (1);
+        }
+    }
+    else
+    {
+        fwrite(json.constData(), 1, size_t(json.size()), stdout);
+        fflush(stdout);
+    }
+
+    if (parser.isSet(samplesOption))
+    {
+        error = runner.writeSamples(parser.value(samplesOption));
+        if (!error.isEmpty())
+        {
+            qCritical().noquote() << error;
+            return (1);
+        }
+    }
+
+    qWarning().noquote() << runner.status();
+
+    return (bAborted ? 1 : 0);
+
+}   // End of main
@@ -0,0 +1,16 @@
+QT       += core
+QT       -= gui
+
+CONFIG += c++11 console
+CONFIG -= app_bundle
+
+TARGET = pm_bench
+
+SOURCES += \
+    bench_runner.cpp \
+    main.cpp
+
+HEADERS += \
+    bench_runner.h
+
+include(../pm_core/pm_core.pri)
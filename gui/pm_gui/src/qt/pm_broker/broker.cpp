@@ -0,0 +1,485 @@
+/***************************************************************************
+broker.cpp:  Power module serial port broker class functions
+
+Written by:
+    Sandra Mercer, P.Eng.
+    Engineer / Software Developer
+    eSonar Inc.
+
+Date:
+    November 2022
+
+Note(s):
+- The broker keeps the serial port open, through a SerialWorker in a
+thread of its own, and lets any number of local clients share it over TCP
+(127.0.0.1 only) or a local socket (a named pipe on Windows)
+- A client talks to the broker as it would to the port: one command, or a
+';' separated batch, per line with or without a "#<seq> " prefix. The
+queue, the sequences and the routing of what the power module sends are
+in BrokerRouter, the broker only moves the bytes and times the requests
+- A request is answered with "ERROR TIMEOUT" when the power module sends
+nothing for RequestTimeoutMs. set_baud and baud_ping are refused with
+"ERROR BROKER": the port rate is the broker's, and changing it would cut
+off every other client
+- The port is reopened every ReopenIntervalMs after it fails, the clients
+stay connected
+****************************************************************************/
+
+
+#include <QDebug>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QSerialPort>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QThread>
+#include <QTimer>
+#include "broker.h"
+#include "serial_worker.h"
+
+
+/***************************************************************************
+Broker constructor, the port is opened by start()
+****************************************************************************/
+Broker::Broker(const QString &portName, qint32 baudRate, QObject *parent)
+    : QObject(parent), portName(portName), baudRate(baudRate)
+{
+    nextClientId = 1;
+
+    // The worker has no parent so it can be moved, it is deleted with the thread
+    workerThread = new QThread(this);
+    worker = new SerialWorker;
+    worker->moveToThread(workerThread);
+    connect(workerThread, SIGNAL(finished()), worker, SLOT(deleteLater()));
+    workerThread->start();
+
+    tcpServer = new QTcpServer(this);
+    localServer = new QLocalServer(this);
+
+    reopenTimer = new QTimer(this);
+    reopenTimer->setSingleShot(true);
+
+    timeoutTimer = new QTimer(this);
+    timeoutTimer->setSingleShot(true);
+    timeoutTimer->setInterval(RequestTimeoutMs);
+
+    // Connect the signals and slots
+    connect(worker, SIGNAL(signalError(int)), this, SLOT(slotError(int)));
+    connect(worker, SIGNAL(signalReceived()), this, SLOT(slotReceived()));
+    connect(tcpServer, SIGNAL(newConnection()), this, SLOT(slotNewTcpConnection()));
+    connect(localServer, SIGNAL(newConnection()), this, SLOT(slotNewLocalConnection()));
+    connect(reopenTimer, SIGNAL(timeout()), this, SLOT(slotReopen()));
+    connect(timeoutTimer, SIGNAL(timeout()), this, SLOT(slotTimeout()));
+
+}   // End of Broker::Broker
+
+
+/***************************************************************************
+Broker destructor
+****************************************************************************/
+Broker::~Broker()
+{
+    close();
+
+    workerThread->quit();
+    workerThread->wait();
+
+    qDeleteAll(clients);
+
+}   // End of Broker::~Broker
+
+
+/***************************************************************************
+Function to start serving a client
+****************************************************************************/
+void Broker::addClient(QIODevice *socket)
+{
+    Client *client = new Client;
+    client->id = nextClientId++;
+    client->socket = socket;
+    client->requests = 0;
+    clients.append(client);
+
+    // QTcpSocket and QLocalSocket both have disconnected(), QIODevice does not
+    connect(socket, SIGNAL(readyRead()), this, SLOT(slotClientReadyRead()));
+    connect(socket, SIGNAL(disconnected()), this, SLOT(slotClientDisconnected()));
+
+    qWarning().noquote() << "Client" << client->id << "connected," << clients.size() << "connected";
+
+}   // End of Broker::addClient
+
+
+/***************************************************************************
+Function to send data to every client. A client that has stopped reading
+is dropped rather than letting its backlog grow
+****************************************************************************/
+void Broker::broadcast(const QByteArray &data)
+{
+    // A copy, aborting a socket removes its client from the list
+    QList<Client *> targets = clients;
+
+    for (Client *client : targets)
+    {
+        if (client->socket->bytesToWrite() > MaxClientBacklog)
+        {
+            qWarning().noquote() << "Client" << client->id << "is not reading, disconnecting";
+
+            // close() would wait for the backlog to be sent
+            if (QTcpSocket *tcpSocket = qobject_cast<QTcpSocket *>(client->socket))
+                tcpSocket->abort();
+            else if (QLocalSocket *localSocket = qobject_cast<QLocalSocket *>(client->socket))
+                localSocket->abort();
+            continue;
+        }
+        client->socket->write(data);
+    }
+
+}   // End of Broker::broadcast
+
+
+/***************************************************************************
+Function to close the port, the waiting requests are failed
+****************************************************************************/
+void Broker::close(void)
+{
+    if (!router.isOpen())
+        return;
+
+    QMetaObject::invokeMethod(worker, "slotClose", Qt::BlockingQueuedConnection);
+    SerialWorker::Chunk chunk;
+    worker->acknowledge();
+    while (worker->takeChunk(chunk))
+        ;
+
+    router.close();
+    deliver();
+    timeoutTimer->stop();
+
+}   // End of Broker::close
+
+
+/***************************************************************************
+Function to write what the router has for the clients
+****************************************************************************/
+void Broker::deliver(void)
+{
+    for (const BrokerRouter::Output &output : router.takeOutputs())
+    {
+        if (output.clientId == BrokerRouter::Broadcast)
+            broadcast(output.data);
+        else if (Client *client = findClient(output.clientId))
+            client->socket->write(output.data);
+    }
+
+}   // End of Broker::deliver
+
+
+/***************************************************************************
+Function to return the client using a socket, or nullptr
+****************************************************************************/
+Broker::Client *Broker::findClient(QObject *socket) const
+{
+    for (Client *client : clients)
+    {
+        if (client->socket == socket)
+            return (client);
+    }
+
+    return (nullptr);
+
+}   // End of Broker::findClient
+
+
+/***************************************************************************
+Function to return the client with an id, or nullptr
+****************************************************************************/
+Broker::Client *Broker::findClient(int id) const
+{
+    for (Client *client : clients)
+    {
+        if (client->id == id)
+            return (client);
+    }
+
+    return (nullptr);
+
+}   // End of Broker::findClient
+
+
+/***************************************************************************
+Function to accept clients on a local socket, a named pipe on Windows
+
+Returns an empty string, or the error
+****************************************************************************/
+QString Broker::listenLocal(const QString &name)
+{
+    // A socket file left behind by a broker that did not exit cleanly
+    QLocalServer::removeServer(name);
+
+    if (!localServer->listen(name))
+        return (QString("Could not listen on %1: %2").arg(name).arg(localServer->errorString()));
+
+    return (QString());
+
+}   // End of Broker::listenLocal
+
+
+/***************************************************************************
+Function to accept clients on a TCP port of this computer only
+
+Returns an empty string, or the error
+****************************************************************************/
+QString Broker::listenTcp(quint16 port)
+{
+    if (!tcpServer->listen(QHostAddress::LocalHost, port))
+        return (QString("Could not listen on port %1: %2").arg(port).arg(tcpServer->errorString()));
+
+    return (QString());
+
+}   // End of Broker::listenTcp
+
+
+/***************************************************************************
+Function to open the port
+
+Returns an empty string, or the error
+****************************************************************************/
+QString Broker::open(void)
+{
+    QString error;
+    QMetaObject::invokeMethod(worker, "slotOpen", Qt::BlockingQueuedConnection, Q_RETURN_ARG(QString, error),
+                              Q_ARG(QString, portName), Q_ARG(qint32, baudRate),
+                              Q_ARG(int, QSerialPort::Data8), Q_ARG(int, QSerialPort::NoParity),
+                              Q_ARG(int, QSerialPort::OneStop), Q_ARG(int, QSerialPort::NoFlowControl));
+    if (!error.isEmpty())
+        return (error);
+
+    qDebug() << "Broker::open:" << portName << baudRate;
+
+    router.open();
+
+    return (QString());
+
+}   // End of Broker::open
+
+
+/***************************************************************************
+Function to send the oldest waiting request to the power module
+****************************************************************************/
+void Broker::sendNext(void)
+{
+    QByteArray data;
+    if (!router.next(data))
+        return;
+
+    QMetaObject::invokeMethod(worker, "slotWrite", Qt::QueuedConnection, Q_ARG(QByteArray, data));
+    timeoutTimer->start();
+
+}   // End of Broker::sendNext
+
+
+/***************************************************************************
+Function to open the port, retrying until it can be opened
+****************************************************************************/
+void Broker::start(void)
+{
+    QString error = open();
+    if (!error.isEmpty())
+    {
+        qWarning().noquote() << portName << error << "- retrying";
+        reopenTimer->start(ReopenIntervalMs);
+    }
+
+}   // End of Broker::start
+
+
+/***************************************************************************
+Function to return a one line summary for the console
+****************************************************************************/
+QString Broker::status(void) const
+{
+    return (QString("%1 %2: %3 clients, %4 requests, %5 queued, %6 rejected, %7 timeouts, %8 events, %9 frames")
+            .arg(portName).arg(router.isOpen() ? "open" : "closed").arg(clients.size())
+            .arg(router.requests()).arg(router.queued()).arg(router.rejected()).arg(router.timeouts())
+            .arg(router.events()).arg(router.frames()));
+
+}   // End of Broker::status
+
+
+/***************************************************************************
+Slot to forget a client, its queued requests are dropped and the answer to
+its outstanding one is discarded
+****************************************************************************/
+void Broker::slotClientDisconnected(void)
+{
+    Client *client = findClient(sender());
+    if (client == nullptr)
+        return;
+
+    router.removeClient(client->id);
+
+    clients.removeOne(client);
+    client->socket->deleteLater();
+
+    qWarning().noquote() << "Client" << client->id << "disconnected after" << client->requests << "requests,"
+                         << clients.size() << "connected";
+    delete client;
+
+}   // End of Broker::slotClientDisconnected
+
+
+/***************************************************************************
+Slot to take the complete lines a client has sent
+****************************************************************************/
+void Broker::slotClientReadyRead(void)
+{
+    Client *client = findClient(sender());
+    if (client == nullptr)
+        return;
+
+    client->buffer.append(client->socket->readAll());
+
+    int start = 0;
+    int index;
+    while ((index = client->buffer.indexOf('\n', start)) != -1)
+    {
+        if (router.addRequest(client->id, client->buffer.mid(start, index - start)))
+            client->requests++;
+        start = index + 1;
+    }
+    client->buffer.remove(0, start);
+
+    deliver();
+    sendNext();
+
+    if (client->buffer.size() > MaxLineLength)
+    {
+        qDebug() << "Broker::slotClientReadyRead: client" << client->id << "line too long";
+        client->buffer.clear();
+    }
+
+}   // End of Broker::slotClientReadyRead
+
+
+/***************************************************************************
+Slot to handle a port error, as in AcquisitionDevice only errors that leave
+the port unusable close it
+****************************************************************************/
+void Broker::slotError(int error)
+{
+    switch (error)
+    {
+    case QSerialPort::NoError:
+        return;
+    case QSerialPort::FramingError:
+    case QSerialPort::ParityError:
+    case QSerialPort::TimeoutError:
+    case QSerialPort::UnsupportedOperationError:
+        qDebug() << "Broker::slotError:" << portName << error;
+        return;
+    default:
+        break;
+    }
+
+    qWarning().noquote() << portName << "port error" << error << "- reopening";
+
+    close();
+    reopenTimer->start(ReopenIntervalMs);
+
+}   // End of Broker::slotError
+
+
+/***************************************************************************
+Slot to accept the clients waiting on the local socket
+****************************************************************************/
+void Broker::slotNewLocalConnection(void)
+{
+    while (localServer->hasPendingConnections())
+        addClient(localServer->nextPendingConnection());
+
+}   // End of Broker::slotNewLocalConnection
+
+
+/***************************************************************************
+Slot to accept the clients waiting on the TCP port
+****************************************************************************/
+void Broker::slotNewTcpConnection(void)
+{
+    while (tcpServer->hasPendingConnections())
+    {
+        QTcpSocket *socket = tcpServer->nextPendingConnection();
+
+        // Answers are short, send each one now rather than coalescing
+        socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+        addClient(socket);
+    }
+
+}   // End of Broker::slotNewTcpConnection
+
+
+/***************************************************************************
+Slot to take the received chunks from the worker
+****************************************************************************/
+void Broker::slotReceived(void)
+{
+    SerialWorker::Chunk chunk;
+    bool bReceived = false;
+
+    // Acknowledged first, so a chunk queued while draining signals again
+    worker->acknowledge();
+    while (worker->takeChunk(chunk))
+    {
+        if (router.isOpen())
+        {
+            router.received(chunk.data);
+            bReceived = true;
+        }
+    }
+
+    if (!bReceived)
+        return;
+
+    deliver();
+
+    // A long answer, such as a log dump, is timed from its last byte
+    if (router.isActive())
+        timeoutTimer->start();
+    else
+    {
+        timeoutTimer->stop();
+        sendNext();
+    }
+
+}   // End of Broker::slotReceived
+
+
+/***************************************************************************
+Slot to try the port again
+****************************************************************************/
+void Broker::slotReopen(void)
+{
+    QString error = open();
+    if (!error.isEmpty())
+    {
+        qDebug() << "Broker::slotReopen:" << portName << error;
+        reopenTimer->start(ReopenIntervalMs);
+    }
+    else
+        qWarning().noquote() << portName << "reopened";
+
+}   // End of Broker::slotReopen
+
+
+/***************************************************************************
+Slot to give up on the outstanding request
+****************************************************************************/
+void Broker::slotTimeout(void)
+{
+    if (!router.isActive())
+        return;
+
+    router.timeout();
+    deliver();
+    sendNext();
+
+}   // End of Broker::slotTimeout
@@ -0,0 +1,101 @@
+/***************************************************************************
+broker.h: Include file for broker.cpp
+
+Written by:
+    Sandra Mercer, P.Eng.
+    Engineer / Software Developer
+    eSonar Inc.
+
+Date:
+    November 2022
+****************************************************************************/
+
+
+#ifndef BROKER_H
+#define BROKER_H
+
+
+#include <QByteArray>
+#include <QList>
+#include <QObject>
+#include <QString>
+#include "broker_router.h"
+
+
+class QIODevice;
+class QLocalServer;
+class QTcpServer;
+class QThread;
+class QTimer;
+class SerialWorker;
+
+
+class Broker : public QObject
+{
+    Q_OBJECT
+
+public:
+
+    static const int ReopenIntervalMs = 5000;
+    static const int RequestTimeoutMs = 5000;       // Without a byte from the power module
+    static const int MaxLineLength = 1024;
+    static const int MaxClientBacklog = 1 << 20;    // Unsent bytes before a client is dropped
+
+    explicit Broker(const QString &portName, qint32 baudRate, QObject *parent = nullptr);
+    ~Broker();
+
+    QString listenLocal(const QString &);
+    QString listenTcp(quint16);
+    void start(void);
+    QString status(void) const;
+
+private slots:
+
+    void slotClientDisconnected(void);
+    void slotClientReadyRead(void);
+    void slotError(int);
+    void slotNewLocalConnection(void);
+    void slotNewTcpConnection(void);
+    void slotReceived(void);
+    void slotReopen(void);
+    void slotTimeout(void);
+
+private:
+
+    struct Client
+    {
+        int id;
+        QIODevice *socket;
+        QByteArray buffer;          // Partly received request
+        quint32 requests;
+    };
+
+    void addClient(QIODevice *);
+    void broadcast(const QByteArray &);
+    void close(void);
+    void deliver(void);
+    Client *findClient(QObject *) const;
+    Client *findClient(int) const;
+    QString open(void);
+    void sendNext(void);
+
+    QString portName;
+    qint32 baudRate;
+
+    QThread *workerThread;
+    SerialWorker *worker;
+    QTcpServer *tcpServer;
+    QLocalServer *localServer;
+    QTimer *reopenTimer;
+    QTimer *timeoutTimer;
+
+    QList<Client *> clients;
+    int nextClientId;
+
+    // The requests, and the lines and frames from the power module
+    BrokerRouter router;
+
+};
+
+
+#endif // BROKER_H
@@ -0,0 +1,443 @@
+/***************************************************************************
+broker_router.cpp:  Power module broker request and answer routing class
+functions
+
+Written by:
+    Sandra Mercer, P.Eng.
+    Engineer / Software Developer
+    eSonar Inc.
+
+Date:
+    November 2022
+
+Note(s):
+- The part of the Broker that does not need a socket or the port: clients
+are only ids, the requests come in as lines and the bytes from the power
+module as chunks, and what is to be sent to the clients is collected as
+Outputs for the Broker to write
+- A request is given to the power module with the router's own sequence,
+one at a time. The "@<seq>" lines answering it go back to its client with
+the client's sequence, or with none if it sent none (the END line is then
+dropped). "@-" answers a frame the power module could not read, which can
+only be the outstanding one
+- Lines without a sequence are events and go to every client, as do the
+telemetry stream frames, except while a request with a log_zdump is
+outstanding: its frames go to the client that asked for the dump
+- A request is refused with "ERROR BROKER" when any of its ';' separated
+commands is set_baud or baud_ping, "ERROR CLOSED" while the port is closed
+and "ERROR BUSY" when the queue is full
+****************************************************************************/
+
+
+#include <QDebug>
+#include "broker_router.h"
+
+
+/***************************************************************************
+BrokerRouter constructor, the port starts closed
+****************************************************************************/
+BrokerRouter::BrokerRouter()
+{
+    bOpen = false;
+    bActive = false;
+    active.clientId = 0;
+    active.bDump = false;
+    sequence = 0;
+
+    requestCount = 0;
+    rejectedCount = 0;
+    timeoutCount = 0;
+    eventCount = 0;
+    frameCount = 0;
+
+}   // End of BrokerRouter::BrokerRouter
+
+
+/***************************************************************************
+Function to queue one line from a client, without its line ending
+
+Returns false if the line was not a request and was ignored
+****************************************************************************/
+bool BrokerRouter::addRequest(int clientId, QByteArray line)
+{
+    line = line.trimmed();
+    if (line.isEmpty())
+        return (false);
+
+    Request request;
+    request.clientId = clientId;
+    request.bDump = false;
+
+    // "#<seq> <command>"
+    if (line.startsWith('#'))
+    {
+        int space = line.indexOf(' ');
+        if (space < 2)
+            return (false);
+        request.clientSequence = line.mid(1, space - 1);
+        request.command = line.mid(space + 1).trimmed();
+    }
+    else
+        request.command = line;
+
+    // The power module runs every command of a "a;b;c" batch
+    bool bBaud = false;
+    for (const QByteArray &part : request.command.split(';'))
+    {
+        QByteArray command = part.trimmed();
+        if (command.startsWith("set_baud") || command.startsWith("baud_ping"))
+            bBaud = true;
+        else if (command.startsWith("log_zdump"))
+            request.bDump = true;
+    }
+
+    const char *reason = nullptr;
+    if (bBaud)
+        reason = "BROKER";
+    else if (!bOpen)
+        reason = "CLOSED";
+    else if (pending.size() >= MaxQueuedRequests)
+        reason = "BUSY";
+
+    if (reason != nullptr)
+    {
+        rejectedCount++;
+        reject(request, reason);
+        return (true);
+    }
+
+    pending.append(request);
+    return (true);
+
+}   // End of BrokerRouter::addRequest
+
+
+/***************************************************************************
+Function to note that the port has closed, the waiting requests are failed
+****************************************************************************/
+void BrokerRouter::close(void)
+{
+    if (!bOpen)
+        return;
+
+    bOpen = false;
+    buffer.clear();
+
+    if (bActive)
+        reject(active, "CLOSED");
+    bActive = false;
+    active.clientId = 0;
+
+    while (!pending.isEmpty())
+        reject(pending.takeFirst(), "CLOSED");
+
+}   // End of BrokerRouter::close
+
+
+/***************************************************************************
+Function to return the number of lines broadcast as events
+****************************************************************************/
+quint32 BrokerRouter::events(void) const
+{
+    return (eventCount);
+
+}   // End of BrokerRouter::events
+
+
+/***************************************************************************
+Function to end the outstanding request
+****************************************************************************/
+void BrokerRouter::finishRequest(void)
+{
+    bActive = false;
+    active.clientId = 0;
+
+}   // End of BrokerRouter::finishRequest
+
+
+/***************************************************************************
+Function to return the number of telemetry frames passed on
+****************************************************************************/
+quint32 BrokerRouter::frames(void) const
+{
+    return (frameCount);
+
+}   // End of BrokerRouter::frames
+
+
+/***************************************************************************
+Function to route one line from the power module, without its "\r\n"
+****************************************************************************/
+void BrokerRouter::handleLine(const char *line, int length)
+{
+    QByteArray data(line, length);
+
+    if (length == 0 || line[0] != '@')
+    {
+        eventCount++;
+        reply(Broadcast, data + "\r\n");
+        return;
+    }
+
+    int space = data.indexOf(' ');
+    if (space < 2)
+        return;
+
+    QByteArray tag = data.mid(1, space - 1);
+    bool bOk = false;
+    bool bOurs = bActive && (tag == "-" || (tag.toUInt(&bOk) == sequence && bOk));
+    if (!bOurs)
+    {
+        qDebug() << "BrokerRouter::handleLine: stale" << data;
+        return;
+    }
+
+    QByteArray payload = data.mid(space + 1);
+    bool bEnd = payload.startsWith("END");
+
+    if (!active.clientSequence.isEmpty())
+        reply(active.clientId, "@" + active.clientSequence + " " + payload + "\r\n");
+    else if (!bEnd)
+        reply(active.clientId, payload + "\r\n");
+
+    if (bEnd || payload.startsWith("ERROR"))
+        finishRequest();
+
+}   // End of BrokerRouter::handleLine
+
+
+/***************************************************************************
+Function to return true while a request is waiting for its answer
+****************************************************************************/
+bool BrokerRouter::isActive(void) const
+{
+    return (bActive);
+
+}   // End of BrokerRouter::isActive
+
+
+/***************************************************************************
+Function to return true while the port is open
+****************************************************************************/
+bool BrokerRouter::isOpen(void) const
+{
+    return (bOpen);
+
+}   // End of BrokerRouter::isOpen
+
+
+/***************************************************************************
+Function to take the oldest waiting request, when none is outstanding
+
+Returns false if there is nothing to send, or the line to write to the port
+in data
+****************************************************************************/
+bool BrokerRouter::next(QByteArray &data)
+{
+    if (bActive || pending.isEmpty() || !bOpen)
+        return (false);
+
+    active = pending.takeFirst();
+    bActive = true;
+    sequence++;
+    requestCount++;
+
+    data = "#" + QByteArray::number(sequence) + " " + active.command + "\r\n";
+    return (true);
+
+}   // End of BrokerRouter::next
+
+
+/***************************************************************************
+Function to note that the port has opened
+****************************************************************************/
+void BrokerRouter::open(void)
+{
+    bOpen = true;
+    buffer.clear();
+    framer.reset();
+
+}   // End of BrokerRouter::open
+
+
+/***************************************************************************
+Function to return the number of requests waiting to be sent
+****************************************************************************/
+int BrokerRouter::queued(void) const
+{
+    return (pending.size());
+
+}   // End of BrokerRouter::queued
+
+
+/***************************************************************************
+Function to split the bytes received from the power module into lines and
+telemetry frames, and route them
+****************************************************************************/
+void BrokerRouter::received(const QByteArray &data)
+{
+    int index;
+    int sync;
+    int start = 0;
+
+    if (!bOpen)
+        return;
+
+    buffer.append(data);
+
+    // Searched for again only once the lines have passed it
+    sync = buffer.indexOf(TelemetryDecoder::Sync);
+
+    while (1)
+    {
+        index = buffer.indexOf("\r\n", start);
+
+        if (sync != -1 && sync < start)
+            sync = buffer.indexOf(TelemetryDecoder::Sync, start);
+
+        // As in ResponseStream, anything before a sync byte that is not a
+        // complete line is left over from a bad frame
+        if (sync != -1 && (index == -1 || sync < index))
+        {
+            TelemetryRecord record;
+
+            // The decoder moves start past the frame, which is passed on as
+            // received. A bad frame only loses its sync byte
+            start = sync;
+            TelemetryDecoder::resultEnum result = framer.decode(buffer, start, record);
+            if (result == TelemetryDecoder::INCOMPLETE)
+                break;
+            if (result == TelemetryDecoder::INVALID)
+                continue;
+
+            frameCount++;
+            if (bActive && active.bDump)
+                reply(active.clientId, buffer.mid(sync, start - sync));
+            else
+                reply(Broadcast, buffer.mid(sync, start - sync));
+            continue;
+        }
+
+        if (index == -1)
+            break;
+
+        handleLine(buffer.constData() + start, index - start);
+        start = index + 2;
+    }
+
+    buffer.remove(0, start);
+
+}   // End of BrokerRouter::received
+
+
+/***************************************************************************
+Function to answer a request with "ERROR <reason>" without sending it
+****************************************************************************/
+void BrokerRouter::reject(const Request &request, const char *reason)
+{
+    if (request.clientSequence.isEmpty())
+        reply(request.clientId, QByteArray("ERROR ") + reason + "\r\n");
+    else
+        reply(request.clientId, "@" + request.clientSequence + " ERROR " + reason + "\r\n");
+
+}   // End of BrokerRouter::reject
+
+
+/***************************************************************************
+Function to return the number of requests refused
+****************************************************************************/
+quint32 BrokerRouter::rejected(void) const
+{
+    return (rejectedCount);
+
+}   // End of BrokerRouter::rejected
+
+
+/***************************************************************************
+Function to forget a client, its queued requests are dropped and the answer
+to its outstanding one is discarded
+****************************************************************************/
+void BrokerRouter::removeClient(int clientId)
+{
+    for (int i = pending.size() - 1; i >= 0; i--)
+    {
+        if (pending.at(i).clientId == clientId)
+            pending.removeAt(i);
+    }
+    if (active.clientId == clientId)
+        active.clientId = 0;
+
+    for (int i = outputs.size() - 1; i >= 0; i--)
+    {
+        if (outputs.at(i).clientId == clientId)
+            outputs.removeAt(i);
+    }
+
+}   // End of BrokerRouter::removeClient
+
+
+/***************************************************************************
+Function to queue data for a client, nothing is queued for a client that
+has gone
+****************************************************************************/
+void BrokerRouter::reply(int clientId, const QByteArray &data)
+{
+    if (clientId == 0)
+        return;
+
+    Output output;
+    output.clientId = clientId;
+    output.data = data;
+    outputs.append(output);
+
+}   // End of BrokerRouter::reply
+
+
+/***************************************************************************
+Function to return the number of requests sent to the power module
+****************************************************************************/
+quint32 BrokerRouter::requests(void) const
+{
+    return (requestCount);
+
+}   // End of BrokerRouter::requests
+
+
+/***************************************************************************
+Function to return the data for the clients, in the order it is to be sent
+****************************************************************************/
+QList<BrokerRouter::Output> BrokerRouter::takeOutputs(void)
+{
+    QList<Output> taken;
+    taken.swap(outputs);
+
+    return (taken);
+
+}   // End of BrokerRouter::takeOutputs
+
+
+/***************************************************************************
+Function to give up on the outstanding request
+****************************************************************************/
+void BrokerRouter::timeout(void)
+{
+    if (!bActive)
+        return;
+
+    qDebug() << "BrokerRouter::timeout:" << active.command;
+
+    timeoutCount++;
+    reject(active, "TIMEOUT");
+    finishRequest();
+
+}   // End of BrokerRouter::timeout
+
+
+/***************************************************************************
+Function to return the number of requests the power module did not answer
+****************************************************************************/
+quint32 BrokerRouter::timeouts(void) const
+{
+    return (timeoutCount);
+
+}   // End of BrokerRouter::timeouts
@@ -0,0 +1,100 @@
+/***************************************************************************
+broker_router.h: Include file for broker_router.cpp
+
+Written by:
+    Sandra Mercer, P.Eng.
+    Engineer / Software Developer
+    eSonar Inc.
+
+Date:
+    November 2022
+****************************************************************************/
+
+
+#ifndef BROKER_ROUTER_H
+#define BROKER_ROUTER_H
+
+
+#include <QByteArray>
+#include <QList>
+#include "telemetry_decoder.h"
+
+
+class BrokerRouter
+{
+
+public:
+
+    static const int Broadcast = -1;                // Output client id for every client
+    static const int MaxQueuedRequests = 256;
+
+    // Data for one client, or for every client when clientId is Broadcast
+    struct Output
+    {
+        int clientId;
+        QByteArray data;
+    };
+
+    BrokerRouter();
+
+    bool addRequest(int, QByteArray);
+    void close(void);
+    bool next(QByteArray &);
+    void open(void);
+    void received(const QByteArray &);
+    void removeClient(int);
+    void timeout(void);
+    QList<Output> takeOutputs(void);
+
+    bool isActive(void) const;
+    bool isOpen(void) const;
+    int queued(void) const;
+
+    quint32 events(void) const;
+    quint32 frames(void) const;
+    quint32 rejected(void) const;
+    quint32 requests(void) const;
+    quint32 timeouts(void) const;
+
+private:
+
+    // A client request, clientSequence is empty when it was sent without
+    // "#<seq>" and clientId is 0 once the client has gone
+    struct Request
+    {
+        int clientId;
+        QByteArray clientSequence;
+        QByteArray command;
+        bool bDump;                 // Has a log_zdump, its frames go to the client
+    };
+
+    void finishRequest(void);
+    void handleLine(const char *, int);
+    void reject(const Request &, const char *);
+    void reply(int, const QByteArray &);
+
+    bool bOpen;
+
+    // One request to the power module at a time, in the order received
+    QList<Request> pending;
+    Request active;
+    bool bActive;
+    quint32 sequence;
+
+    // Received from the power module, frames are found with a decoder of
+    // their own and passed on undecoded
+    QByteArray buffer;
+    TelemetryDecoder framer;
+
+    QList<Output> outputs;
+
+    quint32 requestCount;
+    quint32 rejectedCount;
+    quint32 timeoutCount;
+    quint32 eventCount;
+    quint32 frameCount;
+
+};
+
+
+#endif // BROKER_ROUTER_H
@@ -0,0 +1,161 @@
+/***************************************************************************
+main.cpp:  Marine Mammal Detection Power Module serial port broker main
+function
+
+Written by:
+    Sandra Mercer, P.Eng.
+    Engineer / Software Developer
+    eSonar Inc.
+
+Date:
+    November 2022
+
+Note(s):
+- pm_broker [options] <port>
+- Opens the port once and shares it with the GUI, pm_daemon and scripts,
+which connect to tcp://127.0.0.1:<port> or local:<name> instead (see
+Broker). By default only TCP port 5760 is served
+****************************************************************************/
+
+
+#include <csignal>
+#include <cstdio>
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QTimer>
+#include "broker.h"
+#include "serial_worker.h"
+
+
+// Local variable(s)
+static bool bVerbose = false;
+
+
+// Local function(s)
+static void messageHandler(QtMsgType, const QMessageLogContext &, const QString &);
+static void signalHandler(int);
+
+
+/***************************************************************************
+Local function to timestamp the Qt messages, dropping the qDebug() traces
+unless --verbose was given
+****************************************************************************/
+static void messageHandler(QtMsgType type, const QMessageLogContext &, const QString &message)
+{
+    if (type == QtDebugMsg && !bVerbose)
+        return;
+
+    fprintf(stderr, "%s %s\n", qPrintable(QDateTime::currentDateTime().toString(Qt::ISODate)), qPrintable(message));
+    fflush(stderr);
+
+}   // End of messageHandler
+
+
+/***************************************************************************
+Local function to leave the event loop on Ctrl+C, so the local socket file
+is removed
+****************************************************************************/
+static void signalHandler(int)
+{
+    QCoreApplication::quit();
+
+}   // End of signalHandler
+
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QCoreApplication::setApplicationName("pm_broker");
+    QCoreApplication::setApplicationVersion(PM_VERSION);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Shares one power module serial port between several local clients");
+    parser.addHelpOption();
+    parser.addVersionOption();
+
+    QCommandLineOption baudOption(QStringList() << "b" << "baud", "Baud rate.", "baud", "38400");
+    QCommandLineOption tcpOption(QStringList() << "t" << "tcp", "TCP port on 127.0.0.1, 0 for none.", "port",
+                                 QString::number(SerialWorker::DefaultBrokerPort));
+    QCommandLineOption localOption(QStringList() << "l" << "local", "Local socket or named pipe name.", "name");
+    QCommandLineOption statusOption("status", "Seconds between summaries, 0 for none.", "seconds", "60");
+    QCommandLineOption verboseOption(QStringList() << "v" << "verbose", "Print the protocol traces.");
+    parser.addOption(baudOption);
+    parser.addOption(tcpOption);
+    parser.addOption(localOption);
+    parser.addOption(statusOption);
+    parser.addOption(verboseOption);
+    parser.addPositionalArgument("port", "Serial port.", "<port>");
+    parser.process(a);
+
+    bVerbose = parser.isSet(verboseOption);
+    qInstallMessageHandler(messageHandler);
+
+    if (parser.positionalArguments().size() != 1)
+        parser.showHelp(1);
+
+    bool bOk = false;
+    qint32 baudRate = parser.value(baudOption).toInt(&bOk);
+    if (!bOk || baudRate <= 0)
+    {
+        qCritical() << "Bad baud rate" << parser.value(baudOption);
+        return (1);
+    }
+
+    quint16 tcpPort = parser.value(tcpOption).toUShort(&bOk);
+    if (!bOk)
+    {
+        qCritical() << "Bad TCP port" << parser.value(tcpOption);
+        return (1);
+    }
+
+    QString localName = parser.value(localOption);
+    if (tcpPort == 0 && localName.isEmpty())
+    {
+        qCritical() << "Nothing to listen on";
+        return (1);
+    }
+
+    Broker broker(parser.positionalArguments().at(0), baudRate);
+    QString error;
+
+    if (tcpPort != 0)
+    {
+        error = broker.listenTcp(tcpPort);
+        if (error.isEmpty())
+            qWarning().noquote() << "Listening on tcp://127.0.0.1:" + QString::number(tcpPort);
+    }
+    if (error.isEmpty() && !localName.isEmpty())
+    {
+        error = broker.listenLocal(localName);
+        if (error.isEmpty())
+            qWarning().noquote() << "Listening on local:" + localName;
+    }
+    if (!error.isEmpty())
+    {
+        qCritical().noquote() << error;
+        return (1);
+    }
+
+    broker.start();
+
+    QTimer statusTimer;
+    int statusSeconds = parser.value(statusOption).toInt();
+    if (statusSeconds > 0)
+    {
+        QObject::connect(&statusTimer, &QTimer::timeout, [&broker]() {
+            qWarning().noquote() << broker.status();
+        });
+        statusTimer.start(statusSeconds * 1000);
+    }
+
+    std::signal(SIGINT, signalHandler);
+    std::signal(SIGTERM, signalHandler);
+
+    int result = a.exec();
+
+    qWarning().noquote() << broker.status();
+
+    return (result);
+
+}   // End of main
@@ -0,0 +1,18 @@
+QT       += core network
+QT       -= gui
+
+CONFIG += c++11 console
+CONFIG -= app_bundle
+
+TARGET = pm_broker
+
+SOURCES += \
+    broker.cpp \
+    broker_router.cpp \
+    main.cpp
+
+HEADERS += \
+    broker.h \
+    broker_router.h
+
+include(../pm_core/pm_core.pri)
@@ -0,0 +1,275 @@
+/***************************************************************************
+command_queue.cpp:  Power module command queue class functions
+
+Written by:
+    Sandra Mercer, P.Eng.
+    Engineer / Software Developer
+    eSonar Inc.
+
+Date:
+    November 2022
+
+Note(s):
+- One request is outstanding at a time. It is sent as a framed request,
+"#<sequence> <command>", and the next one is sent as soon as the power
+module answers "@<sequence> END ..." or "@<sequence> ERROR ...", or when
+the request times out (see handle_frame() in pm.c)
+- The "@<sequence> " in front of the response lines is removed before the
+lines are parsed, so the widget sees the same responses as before. A line
+from a request that has already timed out is still passed on
+- A refresh that is already waiting is not queued again, so a slow power
+module does not build up a backlog of refreshes. Control and user commands
+are always queued, in order, so toggling an output twice before the first
+is sent still leaves it where the user put it
+- The round trip time is from writing the request to its END line, the
+average is smoothed over about eight requests
+- A request is counted as an error when it is answered with ERROR, or when
+its "END <commands> <valid commands>" shows that the power module rejected
+any of its commands (answered "<command> INVALID")
+- Requests are written through signalWrite, so the queue works with the
+Serial widget or with a port of its own (see pm_daemon). signalIdle is
+emitted when the last request has been answered or has timed out
+****************************************************************************/
+
+
+#include <cstdio>
+#include <cstring>
+#include <QDebug>
+#include <QTimer>
+#include "command_queue.h"
+
+
+/***************************************************************************
+CommandQueue constructor
+****************************************************************************/
+CommandQueue::CommandQueue(QObject *parent) : QObject(parent)
+{
+    bActive = false;
+    sequence = 0;
+
+    lastRtt = 0.0;
+    averageRtt = 0.0;
+    completedCount = 0;
+    timeoutCount = 0;
+    errorCount = 0;
+
+    timeoutTimer = new QTimer(this);
+    timeoutTimer->setSingleShot(true);
+
+    connect(timeoutTimer, SIGNAL(timeout()), this, SLOT(slotTimeout()));
+
+}   // End of CommandQueue::CommandQueue
+
+
+/***************************************************************************
+Function to drop the waiting and outstanding requests, e.g. when the port
+is closed
+****************************************************************************/
+void CommandQueue::clear(void)
+{
+    qDebug() << "CommandQueue::clear";
+
+    for (int i = 0; i < PRIORITIES; i++)
+        pending[i].clear();
+
+    bActive = false;
+    timeoutTimer->stop();
+
+    emit signalStatisticsChanged();
+
+}   // End of CommandQueue::clear
+
+
+/***************************************************************************
+Function to queue a command, without the "\r\n", and send it if nothing is
+outstanding
+****************************************************************************/
+void CommandQueue::enqueue(const QString &command, priorityEnum priority, int timeoutMs)
+{
+    if (priority == PRIORITY_REFRESH)
+    {
+        for (const Request &request : pending[PRIORITY_REFRESH])
+        {
+            if (request.command == command)
+                return;
+        }
+    }
+
+    Request request;
+    request.command = command;
+    request.timeoutMs = timeoutMs;
+    pending[priority].append(request);
+
+    if (!bActive)
+        sendNext();
+
+    emit signalStatisticsChanged();
+
+}   // End of CommandQueue::enqueue
+
+
+/***************************************************************************
+Function to end the outstanding request and send the next one
+****************************************************************************/
+void CommandQueue::finishRequest(void)
+{
+    bActive = false;
+    timeoutTimer->stop();
+
+    sendNext();
+
+    emit signalStatisticsChanged();
+
+    if (!bActive)
+        emit signalIdle();
+
+}   // End of CommandQueue::finishRequest
+
+
+/***************************************************************************
+Function to check a response line for the sequence of the outstanding
+request. The line is read in place, without its "\r\n"
+
+Returns the offset of the response after its "@<sequence> ", or -1 for the
+line that ends a request
+****************************************************************************/
+int CommandQueue::processLine(const char *line, int length)
+{
+    if (length == 0 || line[0] != '@')
+        return (0);
+
+    const char *space = static_cast<const char *>(memchr(line, ' ', size_t(length)));
+    if (space == nullptr)
+        return (0);
+
+    // "@-" answers a request the power module could not read, which can only
+    // be the outstanding one
+    bool bOurs = false;
+    if (bActive)
+    {
+        if (space - line == 2 && line[1] == '-')
+            bOurs = true;
+        else if (space - line > 1)
+        {
+            quint32 lineSequence = 0;
+            const char *p;
+            for (p = line + 1; p < space && *p >= '0' && *p <= '9'; p++)
+                lineSequence = lineSequence * 10 + quint32(*p - '0');
+            bOurs = (p == space) && (lineSequence == sequence);
+        }
+    }
+
+    int offset = int(space - line) + 1;
+    const char *payload = line + offset;
+    int payloadLength = length - offset;
+    bool bEnd = (payloadLength >= 3 && memcmp(payload, "END", 3) == 0);
+    bool bError = (payloadLength >= 5 && memcmp(payload, "ERROR", 5) == 0);
+    if (bEnd || bError)
+    {
+        if (bOurs)
+        {
+            lastRtt = rttTimer.nsecsElapsed() / 1000000.0;
+            averageRtt = (completedCount == 0) ? lastRtt : averageRtt + (lastRtt - averageRtt) / 8.0;
+            completedCount++;
+
+            // "END <commands> <valid commands>", an END without the counts is
+            // taken as valid
+            int count;
+            int valid;
+            if (bEnd && sscanf(QByteArray(payload, payloadLength).constData(), "END %d %d", &count, &valid) == 2)
+                bError = (valid < count);
+
+            if (bError)
+            {
+                qDebug() << "CommandQueue::processLine:" << active.command << QByteArray(payload, payloadLength);
+                errorCount++;
+            }
+
+            finishRequest();
+        }
+        return (-1);
+    }
+
+    return (offset);
+
+}   // End of CommandQueue::processLine
+
+
+/***************************************************************************
+Function to send the first request of the highest priority waiting
+****************************************************************************/
+void CommandQueue::sendNext(void)
+{
+    for (int i = 0; i < PRIORITIES; i++)
+    {
+        if (pending[i].isEmpty())
+            continue;
+
+        active = pending[i].takeFirst();
+        bActive = true;
+        sequence++;
+
+        emit signalWrite(QString("#%1 %2\r\n").arg(sequence).arg(active.command));
+
+        rttTimer.start();
+        timeoutTimer->start(active.timeoutMs);
+        return;
+    }
+
+}   // End of CommandQueue::sendNext
+
+
+/***************************************************************************
+Slot to give up on the outstanding request
+****************************************************************************/
+void CommandQueue::slotTimeout(void)
+{
+    qDebug() << "CommandQueue::slotTimeout:" << active.command;
+
+    timeoutCount++;
+    finishRequest();
+
+}   // End of CommandQueue::slotTimeout
+
+
+/***************************************************************************
+Functions to return the queue statistics
+****************************************************************************/
+int CommandQueue::depth(void) const
+{
+    int n = bActive ? 1 : 0;
+
+    for (int i = 0; i < PRIORITIES; i++)
+        n += pending[i].size();
+
+    return (n);
+
+}   // End of CommandQueue::depth
+
+
+double CommandQueue::lastRttMs(void) const
+{
+    return (lastRtt);
+
+}   // End of CommandQueue::lastRttMs
+
+
+double CommandQueue::averageRttMs(void) const
+{
+    return (averageRtt);
+
+}   // End of CommandQueue::averageRttMs
+
+
+int CommandQueue::timeouts(void) const
+{
+    return (timeoutCount);
+
+}   // End of CommandQueue::timeouts
+
+
+int CommandQueue::errors(void) const
+{
+    return (errorCount);
+
+}   // End of CommandQueue::errors
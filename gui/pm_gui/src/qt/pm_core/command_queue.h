@@ -0,0 +1,88 @@
+/***************************************************************************
+command_queue.h: Include file for command_queue.cpp
+
+Written by:
+    Sandra Mercer, P.Eng.
+    Engineer / Software Developer
+    eSonar Inc.
+
+Date:
+    November 2022
+****************************************************************************/
+
+
+#ifndef COMMAND_QUEUE_H
+#define COMMAND_QUEUE_H
+
+
+#include <QElapsedTimer>
+#include <QList>
+#include <QObject>
+#include <QString>
+
+
+class QTimer;
+
+
+class CommandQueue : public QObject
+{
+    Q_OBJECT
+
+public:
+
+    // Requests of a higher priority are sent first, in order within a priority
+    enum priorityEnum {PRIORITY_CONTROL, PRIORITY_USER, PRIORITY_REFRESH, PRIORITIES};
+
+    static const int DefaultTimeoutMs = 1000;
+
+    explicit CommandQueue(QObject *parent = nullptr);
+
+    void enqueue(const QString &, priorityEnum = PRIORITY_USER, int = DefaultTimeoutMs);
+    int processLine(const char *, int);
+    void clear(void);
+
+    int depth(void) const;
+    double lastRttMs(void) const;
+    double averageRttMs(void) const;
+    int timeouts(void) const;
+    int errors(void) const;
+
+signals:
+
+    void signalIdle(void);
+    void signalStatisticsChanged(void);
+    void signalWrite(QString);
+
+private slots:
+
+    void slotTimeout(void);
+
+private:
+
+    struct Request
+    {
+        QString command;
+        int timeoutMs;
+    };
+
+    void finishRequest(void);
+    void sendNext(void);
+
+    QList<Request> pending[PRIORITIES];
+    Request active;
+    bool bActive;
+    quint16 sequence;
+
+    QElapsedTimer rttTimer;
+    QTimer *timeoutTimer;
+
+    double lastRtt;
+    double averageRtt;
+    int completedCount;
+    int timeoutCount;
+    int errorCount;
+
+};
+
+
+#endif // COMMAND_QUEUE_H
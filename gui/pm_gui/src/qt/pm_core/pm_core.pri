@@ -0,0 +1,59 @@
+# Power module protocol core, shared by pm_gui, pm_daemon, pm_bench, pm_broker and the tests
+#
+# Serial port and broker I/O, command queue, response parsing, telemetry decoding and
+# session capture, and the time series store. Nothing here uses QtWidgets. The project
+# settings every program repeated, the deprecation warnings, PM_VERSION and the install
+# path, are here too.
+
+QT += network serialport
+
+CONFIG += c++11
+
+# The following define makes your compiler emit warnings if you use
+# any Qt feature that has been marked deprecated (the exact warnings
+# depend on your compiler). Please consult the documentation of the
+# deprecated API in order to know how to port your code away from it.
+DEFINES += QT_DEPRECATED_WARNINGS
+
+# You can also make your code fail to compile if it uses deprecated APIs.
+# In order to do so, uncomment the following line.
+# You can also select to disable deprecated APIs only up to a certain version of Qt.
+#DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
+
+# The version shown by the applications and tools
+PM_VERSION = 0.1
+VERSTR = '\\"$${PM_VERSION}\\"'
+DEFINES += PM_VERSION=\"$${VERSTR}\"
+
+# Default rules for deployment, the tests are not installed
+!testcase {
+    qnx: target.path = /tmp/$${TARGET}/bin
+    else: unix:!android: target.path = /opt/$${TARGET}/bin
+    !isEmpty(target.path): INSTALLS += target
+}
+
+INCLUDEPATH += $$PWD
+DEPENDPATH += $$PWD
+
+SOURCES += \
+    $$PWD/command_queue.cpp \
+    $$PWD/response_parser.cpp \
+    $$PWD/response_stream.cpp \
+    $$PWD/serial_worker.cpp \
+    $$PWD/series_reader.cpp \
+    $$PWD/series_writer.cpp \
+    $$PWD/session_recorder.cpp \
+    $$PWD/session_replay.cpp \
+    $$PWD/telemetry_decoder.cpp
+
+HEADERS += \
+    $$PWD/command_queue.h \
+    $$PWD/response_parser.h \
+    $$PWD/response_stream.h \
+    $$PWD/serial_worker.h \
+    $$PWD/series_reader.h \
+    $$PWD/series_writer.h \
+    $$PWD/session_recorder.h \
+    $$PWD/session_replay.h \
+    $$PWD/spsc_queue.h \
+    $$PWD/telemetry_decoder.h
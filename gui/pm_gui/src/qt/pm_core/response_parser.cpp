@@ -0,0 +1,179 @@
+/***************************************************************************
+response_parser.cpp:  Power module response parser class functions
+
+Written by:
+    Sandra Mercer, P.Eng.
+    Engineer / Software Developer
+    eSonar Inc.
+
+Date:
+    November 2022
+
+Note(s):
+- A response line is split into tokens in place, the spaces are replaced
+by '\0', and its first token is looked up in a hash of handlers. The key
+must match exactly, so "C1" no longer matches inside other responses and
+"TEMPERATURE" and "LTC2944 TEMPERATURE" do not depend on the test order
+- The lookup key wraps the buffer with QByteArray::fromRawData(), and the
+numbers are read straight from the buffer, so a line makes no temporary
+strings unless a handler asks for one with text()
+- A line is split into at most MaxTokens tokens, one with more is counted
+in truncated() and not handled. No power module response has more than 8
+- The power module prints numbers with sprintf() and a '.', so toDouble()
+does not follow the locale (strtod() would)
+****************************************************************************/
+
+
+#include <cstdlib>
+#include <cstring>
+#include <QDebug>
+#include "response_parser.h"
+
+
+/***************************************************************************
+Function to set the handler of the responses starting with key
+****************************************************************************/
+void ResponseParser::addHandler(const char *key, Handler handler)
+{
+    handlers.insert(QByteArray(key), handler);
+
+}   // End of ResponseParser::addHandler
+
+
+/***************************************************************************
+Function to split a response line, without its "\r\n", and call the
+handler of its first token. line[length] must be writable
+
+Returns false if the line has no handler or more than MaxTokens tokens
+****************************************************************************/
+bool ResponseParser::dispatch(char *line, int length)
+{
+    Tokens tokens;
+    int i = 0;
+
+    tokens.n = 0;
+    while (i < length && tokens.n < Tokens::MaxTokens)
+    {
+        while (i < length && line[i] == ' ')
+            line[i++] = '\0';
+        if (i == length)
+            break;
+
+        tokens.token[tokens.n++] = &line[i];
+        while (i < length && line[i] != ' ')
+            i++;
+    }
+
+    // A line with more tokens than there is room for is refused rather than
+    // handled without its last ones
+    int rest = i;
+    while (rest < length && line[rest] == ' ')
+        rest++;
+    if (rest < length)
+    {
+        truncatedLines++;
+        qWarning() << "ResponseParser::dispatch: more than" << int(Tokens::MaxTokens) << "tokens in"
+                   << QByteArray(line, length);
+        return (false);
+    }
+    line[i] = '\0';
+
+    if (tokens.n == 0)
+        return (false);
+
+    // fromRawData() does not copy, the hash only reads the bytes
+    QByteArray key = QByteArray::fromRawData(tokens.token[0], int(strlen(tokens.token[0])));
+    QHash<QByteArray, Handler>::const_iterator handler = handlers.constFind(key);
+    if (handler == handlers.constEnd())
+    {
+        unhandledLines++;
+        return (false);
+    }
+
+    handler.value()(tokens);
+
+    return (true);
+
+}   // End of ResponseParser::dispatch
+
+
+/***************************************************************************
+Function to check whether token i is text
+****************************************************************************/
+bool ResponseParser::Tokens::is(int i, const char *text) const
+{
+    return (i < n && strcmp(token[i], text) == 0);
+
+}   // End of ResponseParser::Tokens::is
+
+
+/***************************************************************************
+Function to return token i as a QString, or an empty one
+****************************************************************************/
+QString ResponseParser::Tokens::text(int i) const
+{
+    return ((i < n) ? QString::fromLatin1(token[i]) : QString());
+
+}   // End of ResponseParser::Tokens::text
+
+
+/***************************************************************************
+Function to read token i as a decimal number, "-12.345"
+
+Returns false if the token is missing or is not a decimal number
+****************************************************************************/
+bool ResponseParser::Tokens::toDouble(int i, double &value) const
+{
+    if (i >= n)
+        return (false);
+
+    const char *p = token[i];
+    bool bNegative = false;
+    bool bDigits = false;
+    double scale = 1.0;
+
+    if (*p == '-' || *p == '+')
+        bNegative = (*p++ == '-');
+
+    value = 0.0;
+    while (*p >= '0' && *p <= '9')
+    {
+        value = value * 10.0 + (*p++ - '0');
+        bDigits = true;
+    }
+
+    if (*p == '.')
+    {
+        p++;
+        while (*p >= '0' && *p <= '9')
+        {
+            scale /= 10.0;
+            value += (*p++ - '0') * scale;
+            bDigits = true;
+        }
+    }
+
+    if (bNegative)
+        value = -value;
+
+    return (bDigits && *p == '\0');
+
+}   // End of ResponseParser::Tokens::toDouble
+
+
+/***************************************************************************
+Function to read token i as a decimal or 0x hexadecimal integer
+
+Returns false if the token is missing or is not a whole number
+****************************************************************************/
+bool ResponseParser::Tokens::toInt(int i, int &value) const
+{
+    if (i >= n)
+        return (false);
+
+    char *end;
+    value = int(strtol(token[i], &end, 0));
+
+    return (end != token[i] && *end == '\0');
+
+}   // End of ResponseParser::Tokens::toInt
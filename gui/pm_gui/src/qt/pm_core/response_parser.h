@@ -0,0 +1,70 @@
+/***************************************************************************
+response_parser.h: Include file for response_parser.cpp
+
+Written by:
+    Sandra Mercer, P.Eng.
+    Engineer / Software Developer
+    eSonar Inc.
+
+Date:
+    November 2022
+****************************************************************************/
+
+
+#ifndef RESPONSE_PARSER_H
+#define RESPONSE_PARSER_H
+
+
+#include <functional>
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+
+
+class ResponseParser
+{
+
+public:
+
+    // The tokens of one response line, pointing into the receive buffer
+    class Tokens
+    {
+
+    public:
+
+        enum {MaxTokens = 12};
+
+        int count(void) const {return (n);}
+        const char *at(int i) const {return (token[i]);}
+        bool is(int, const char *) const;
+        QString text(int) const;
+        bool toDouble(int, double &) const;
+        bool toInt(int, int &) const;
+
+    private:
+
+        friend class ResponseParser;
+
+        const char *token[MaxTokens];
+        int n;
+
+    };
+
+    typedef std::function<void(const Tokens &)> Handler;
+
+    void addHandler(const char *, Handler);
+    bool dispatch(char *, int);
+
+    int truncated(void) const {return (truncatedLines);}
+    int unhandled(void) const {return (unhandledLines);}
+
+private:
+
+    QHash<QByteArray, Handler> handlers;
+    int truncatedLines = 0;
+    int unhandledLines = 0;
+
+};
+
+
+#endif // RESPONSE_PARSER_H
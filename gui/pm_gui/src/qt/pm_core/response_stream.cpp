@@ -0,0 +1,126 @@
+/***************************************************************************
+response_stream.cpp:  Power module receive stream class functions
+
+Written by:
+    Sandra Mercer, P.Eng.
+    Engineer / Software Developer
+    eSonar Inc.
+
+Date:
+    November 2022
+
+Note(s):
+- Splits the bytes received from the power module into compressed
+telemetry frames, passed to the record handler, and response lines, which
+have their "@<sequence> " checked by the CommandQueue and are then
+dispatched by the ResponseParser
+- The responses and frames are taken in place from the buffer, which is
+only shortened once for each block appended rather than once for each
+response or frame
+****************************************************************************/
+
+
+#include "command_queue.h"
+#include "response_parser.h"
+#include "response_stream.h"
+
+
+/***************************************************************************
+ResponseStream constructor
+****************************************************************************/
+ResponseStream::ResponseStream(CommandQueue *commandQueue, ResponseParser *parser)
+    : commandQueue(commandQueue), parser(parser)
+{
+
+}   // End of ResponseStream::ResponseStream
+
+
+/***************************************************************************
+Function to add received bytes and handle the complete responses and
+frames
+****************************************************************************/
+void ResponseStream::append(const QByteArray &data)
+{
+    int index;
+    int start = 0;
+
+    buffer.append(data);
+
+    // Searched for again only once the responses have passed it
+    int sync = buffer.indexOf(TelemetryDecoder::Sync);
+
+    while (1)
+    {
+        index = buffer.indexOf("\r\n", start);
+
+        if (sync != -1 && sync < start)
+            sync = buffer.indexOf(TelemetryDecoder::Sync, start);
+
+        // Compressed telemetry frames arrive between responses, anything before
+        // a sync byte that is not a complete response is left over from a bad frame
+        if (sync != -1 && (index == -1 || sync < index))
+        {
+            TelemetryRecord record;
+
+            // The decoder moves start past the frame, or past the sync byte of a
+            // bad one, and leaves it at the sync byte of an incomplete one
+            start = sync;
+            TelemetryDecoder::resultEnum result = telemetryDecoder.decode(buffer, start, record);
+            if (result == TelemetryDecoder::INCOMPLETE)
+                break;
+
+            if (result == TelemetryDecoder::DECODED && recordHandler)
+                recordHandler(record);
+            continue;
+        }
+
+        if (index == -1)
+            break;
+
+        // The response is [start, index), the "\r\n" is overwritten by the parser
+        char *response = buffer.data() + start;
+        int length = index - start;
+        start = index + 2;
+
+        // Without its sequence, the line that ends a request has nothing to show
+        int offset = commandQueue->processLine(response, length);
+        if (offset < 0)
+            continue;
+
+        parser->dispatch(response + offset, length - offset);
+    }
+
+    buffer.remove(0, start);
+
+}   // End of ResponseStream::append
+
+
+/***************************************************************************
+Function to discard a partly received response or frame
+****************************************************************************/
+void ResponseStream::clear(void)
+{
+    buffer.clear();
+
+}   // End of ResponseStream::clear
+
+
+/***************************************************************************
+Function to set the handler of the decoded telemetry records
+****************************************************************************/
+void ResponseStream::setRecordHandler(RecordHandler handler)
+{
+    recordHandler = handler;
+
+}   // End of ResponseStream::setRecordHandler
+
+
+/***************************************************************************
+Function to return the telemetry decoder, for its statistics and to reset
+it before a download or a stream
+****************************************************************************/
+TelemetryDecoder &ResponseStream::decoder(void)
+{
+    return (telemetryDecoder);
+
+}   // End of ResponseStream::decoder
@@ -0,0 +1,53 @@
+/***************************************************************************
+response_stream.h: Include file for response_stream.cpp
+
+Written by:
+    Sandra Mercer, P.Eng.
+    Engineer / Software Developer
+    eSonar Inc.
+
+Date:
+    November 2022
+****************************************************************************/
+
+
+#ifndef RESPONSE_STREAM_H
+#define RESPONSE_STREAM_H
+
+
+#include <functional>
+#include <QByteArray>
+#include "telemetry_decoder.h"
+
+
+class CommandQueue;
+class ResponseParser;
+
+
+class ResponseStream
+{
+
+public:
+
+    typedef std::function<void(const TelemetryRecord &)> RecordHandler;
+
+    ResponseStream(CommandQueue *, ResponseParser *);
+
+    void append(const QByteArray &);
+    void clear(void);
+    void setRecordHandler(RecordHandler);
+
+    TelemetryDecoder &decoder(void);
+
+private:
+
+    QByteArray buffer;
+    CommandQueue *commandQueue;
+    ResponseParser *parser;
+    RecordHandler recordHandler;
+    TelemetryDecoder telemetryDecoder;
+
+};
+
+
+#endif // RESPONSE_STREAM_H
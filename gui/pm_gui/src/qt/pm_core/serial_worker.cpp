@@ -0,0 +1,406 @@
+/***************************************************************************
+serial_worker.cpp:  Serial port worker class functions
+
+Written by:
+    Sandra Mercer, P.Eng.
+    Engineer / Software Developer
+    eSonar Inc.
+
+Date:
+    November 2022
+
+Note(s):
+- The worker and its QSerialPort live in their own QThread (see Serial), so
+reading and writing never wait on the GUI. The GUI thread calls the slots
+with QMetaObject::invokeMethod(), blocking only to open the port, to change
+the baud rate and to close the port
+- Received bytes are handed to the GUI thread through a SpscQueue of chunks.
+signalReceived is emitted for the first chunk after acknowledge(), so a
+burst costs the GUI one queued event rather than one per read
+- When the queue is full the bytes are kept in pending and retried, nothing
+received is dropped
+- While recording, each read and each write is captured here, as it goes
+over the wire, rather than after it has been queued or drained. Records
+left buffered by the recorder are written through FlushIntervalMs later by
+slotFlushRecording(), even if nothing else arrives
+- slotOpen() also accepts a pm_broker endpoint. The broker owns the port, so
+there is no DTR, clear or baud rate to set, and losing the connection is
+reported as a QSerialPort::ResourceError like an unplugged port
+****************************************************************************/
+
+
+#include <QDebug>
+#include <QTimer>
+#include "serial_worker.h"
+
+
+/***************************************************************************
+SerialWorker constructor, the port is created by slotOpen() in the worker
+thread
+****************************************************************************/
+SerialWorker::SerialWorker(QObject *parent) : QObject(parent)
+{
+    serialPort = nullptr;
+    tcpSocket = nullptr;
+    localSocket = nullptr;
+    device = nullptr;
+    pendingTimeUs = 0;
+    bRetrying = false;
+    bNotified = false;
+    bFlushScheduled = false;
+
+}   // End of SerialWorker::SerialWorker
+
+
+/***************************************************************************
+Function to ask for signalReceived on the next chunk, called by the GUI
+thread before it takes the queued chunks
+****************************************************************************/
+void SerialWorker::acknowledge(void)
+{
+    bNotified.store(false);
+
+}   // End of SerialWorker::acknowledge
+
+
+/***************************************************************************
+Function to return true if the name is a broker endpoint rather than a
+serial port
+****************************************************************************/
+bool SerialWorker::isBrokerEndpoint(const QString &name)
+{
+    return (name.startsWith("tcp://") || name.startsWith("local:"));
+
+}   // End of SerialWorker::isBrokerEndpoint
+
+
+/***************************************************************************
+Function to connect to a broker, waiting up to 3 s
+
+Returns an empty string, or the reason it could not connect
+****************************************************************************/
+QString SerialWorker::openBroker(const QString &endpoint)
+{
+    if (endpoint.startsWith("local:"))
+    {
+        if (localSocket == nullptr)
+        {
+            localSocket = new QLocalSocket(this);
+
+            connect(localSocket, SIGNAL(disconnected()), this, SLOT(slotBrokerDisconnected()));
+            connect(localSocket, SIGNAL(readyRead()), this, SLOT(slotReadyRead()));
+        }
+
+        localSocket->connectToServer(endpoint.mid(6));
+        if (!localSocket->waitForConnected(3000))
+            return (localSocket->errorString());
+
+        device = localSocket;
+    }
+    else
+    {
+        QString address = endpoint.mid(6);
+        int colon = address.lastIndexOf(':');
+        bool bOk = false;
+        quint16 port = (colon > 0) ? address.mid(colon + 1).toUShort(&bOk) : 0;
+
+        if (!bOk || port == 0)
+            return (QString("Expected tcp://<host>:<port>, got %1").arg(endpoint));
+
+        if (tcpSocket == nullptr)
+        {
+            tcpSocket = new QTcpSocket(this);
+
+            connect(tcpSocket, SIGNAL(disconnected()), this, SLOT(slotBrokerDisconnected()));
+            connect(tcpSocket, SIGNAL(readyRead()), this, SLOT(slotReadyRead()));
+        }
+
+        tcpSocket->connectToHost(address.left(colon), port);
+        if (!tcpSocket->waitForConnected(3000))
+        {
+            QString error = tcpSocket->errorString();
+            tcpSocket->abort();
+            return (error);
+        }
+
+        // Commands are a few bytes, send them now rather than coalescing
+        tcpSocket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+        device = tcpSocket;
+    }
+
+    pending.clear();
+    clock.start();
+
+    return (QString());
+
+}   // End of SerialWorker::openBroker
+
+
+/***************************************************************************
+Function to queue received bytes for the GUI thread
+****************************************************************************/
+void SerialWorker::push(const QByteArray &data)
+{
+    if (pending.isEmpty())
+        pendingTimeUs = clock.nsecsElapsed() / 1000;
+    pending.append(data);
+
+    if (!bRetrying)
+        slotPushPending();
+
+}   // End of SerialWorker::push
+
+
+/***************************************************************************
+Function to capture a chunk and make sure it is written through within
+SessionRecorder::FlushIntervalMs
+****************************************************************************/
+void SerialWorker::record(SessionCapture::directionEnum direction, const QByteArray &data)
+{
+    recorder.record(direction, data);
+
+    if (recorder.isBuffered() && !bFlushScheduled)
+    {
+        bFlushScheduled = true;
+        QTimer::singleShot(SessionRecorder::FlushIntervalMs, this, SLOT(slotFlushRecording()));
+    }
+
+}   // End of SerialWorker::record
+
+
+/***************************************************************************
+Function to return the number of chunks waiting for the GUI thread
+****************************************************************************/
+int SerialWorker::queued(void) const
+{
+    return (queue.size());
+
+}   // End of SerialWorker::queued
+
+
+/***************************************************************************
+Slot to discard the bytes waiting in the port buffers
+****************************************************************************/
+void SerialWorker::slotClear(void)
+{
+    if (device != nullptr && device == serialPort)
+        serialPort->clear();
+
+}   // End of SerialWorker::slotClear
+
+
+/***************************************************************************
+Slot to close the port
+****************************************************************************/
+void SerialWorker::slotClose(void)
+{
+    qDebug() << "SerialWorker::slotClose";
+
+    QIODevice *closing = device;
+
+    // Cleared first so the disconnected() from a socket is not an error
+    device = nullptr;
+    if (closing == tcpSocket && tcpSocket != nullptr)
+        tcpSocket->disconnectFromHost();
+    else if (closing == localSocket && localSocket != nullptr)
+        localSocket->disconnectFromServer();
+    else if (closing != nullptr && closing->isOpen())
+        closing->close();
+    pending.clear();
+
+}   // End of SerialWorker::slotClose
+
+
+/***************************************************************************
+Slot to report the broker going away as the port being lost
+****************************************************************************/
+void SerialWorker::slotBrokerDisconnected(void)
+{
+    if (device == nullptr)
+        return;
+
+    qDebug() << "SerialWorker::slotBrokerDisconnected";
+    device = nullptr;
+    emit signalError(int(QSerialPort::ResourceError));
+
+}   // End of SerialWorker::slotBrokerDisconnected
+
+
+/***************************************************************************
+Slot to pass on a port error to the GUI thread
+****************************************************************************/
+void SerialWorker::slotErrorOccurred(QSerialPort::SerialPortError error)
+{
+    if (error != QSerialPort::NoError)
+        emit signalError(int(error));
+
+}   // End of SerialWorker::slotErrorOccurred
+
+
+/***************************************************************************
+Slot to write through the records the recorder is still holding
+****************************************************************************/
+void SerialWorker::slotFlushRecording(void)
+{
+    bFlushScheduled = false;
+    recorder.flush();
+
+}   // End of SerialWorker::slotFlushRecording
+
+
+/***************************************************************************
+Slot to open the port, or connect to the broker named by portName
+
+Returns an empty string, or the reason the port could not be set up
+****************************************************************************/
+QString SerialWorker::slotOpen(QString portName, qint32 baudRate, int dataBits, int parity, int stopBits, int flowControl)
+{
+    qDebug() << "SerialWorker::slotOpen:" << portName << baudRate;
+
+    if (isBrokerEndpoint(portName))
+        return (openBroker(portName));
+
+    if (serialPort == nullptr)
+    {
+        serialPort = new QSerialPort(this);
+
+        connect(serialPort, SIGNAL(errorOccurred(QSerialPort::SerialPortError)), this, SLOT(slotErrorOccurred(QSerialPort::SerialPortError)));
+        connect(serialPort, SIGNAL(readyRead()), this, SLOT(slotReadyRead()));
+    }
+
+    serialPort->setPortName(portName);
+    if (!serialPort->setBaudRate(baudRate) ||
+        !serialPort->setDataBits(static_cast<QSerialPort::DataBits>(dataBits)) ||
+        !serialPort->setParity(static_cast<QSerialPort::Parity>(parity)) ||
+        !serialPort->setStopBits(static_cast<QSerialPort::StopBits>(stopBits)) ||
+        !serialPort->setFlowControl(static_cast<QSerialPort::FlowControl>(flowControl)))
+    {
+        return (serialPort->errorString());
+    }
+
+    if (!serialPort->open(QIODevice::ReadWrite))
+        return (serialPort->errorString());
+
+    // Atmel-42096-Microcontrollers-Embedded-Debugger_User-Guide.pdf
+    // Note that the UART pins of the EDBG are tri-stated when no terminal program is connected to the Virtual
+    // COM Port on the computer. This mechanism relies on the terminal program sending a DTR signal.
+    serialPort->setDataTerminalReady(true);
+
+    serialPort->clear();
+    device = serialPort;
+    pending.clear();
+    clock.start();
+
+    return (QString());
+
+}   // End of SerialWorker::slotOpen
+
+
+/***************************************************************************
+Slot to move the pending bytes into the queue, retried shortly if it is
+still full
+****************************************************************************/
+void SerialWorker::slotPushPending(void)
+{
+    bRetrying = false;
+    if (pending.isEmpty())
+        return;
+
+    Chunk chunk;
+    chunk.timeUs = pendingTimeUs;
+    chunk.data = pending;
+
+    if (!queue.push(chunk))
+    {
+        bRetrying = true;
+        QTimer::singleShot(10, this, SLOT(slotPushPending()));
+        return;
+    }
+    pending.clear();
+
+    if (!bNotified.exchange(true))
+        emit signalReceived();
+
+}   // End of SerialWorker::slotPushPending
+
+
+/***************************************************************************
+Slot to read data from the connected device
+****************************************************************************/
+void SerialWorker::slotReadyRead(void)
+{
+    if (device == nullptr)
+        return;
+
+    QByteArray data = device->readAll();
+
+    record(SessionCapture::RECEIVED, data);
+    push(data);
+
+}   // End of SerialWorker::slotReadyRead
+
+
+/***************************************************************************
+Slot to change the baud rate of the open port, always false through a
+broker
+****************************************************************************/
+bool SerialWorker::slotSetBaudRate(qint32 baudRate)
+{
+    if (device == nullptr || device != serialPort || !serialPort->setBaudRate(baudRate))
+    {
+        qDebug() << "SerialWorker::slotSetBaudRate: setBaudRate failed," << ((serialPort != nullptr) ? serialPort->errorString() : QString());
+        return (false);
+    }
+
+    return (true);
+
+}   // End of SerialWorker::slotSetBaudRate
+
+
+/***************************************************************************
+Slot to start capturing the traffic to a file, replacing any capture in
+progress
+
+Returns an empty string, or the error
+****************************************************************************/
+QString SerialWorker::slotStartRecording(QString fileName)
+{
+    return (recorder.open(fileName));
+
+}   // End of SerialWorker::slotStartRecording
+
+
+/***************************************************************************
+Slot to end the capture
+****************************************************************************/
+void SerialWorker::slotStopRecording(void)
+{
+    recorder.close();
+
+}   // End of SerialWorker::slotStopRecording
+
+
+/***************************************************************************
+Slot to write to the port or broker, the data is sent from the worker
+thread's event loop
+****************************************************************************/
+void SerialWorker::slotWrite(QByteArray data)
+{
+    if (device != nullptr && device->isOpen())
+    {
+        record(SessionCapture::SENT, data);
+        device->write(data);
+    }
+
+}   // End of SerialWorker::slotWrite
+
+
+/***************************************************************************
+Function to take the oldest queued chunk, called by the GUI thread
+Returns false if there is none
+****************************************************************************/
+bool SerialWorker::takeChunk(Chunk &chunk)
+{
+    return (queue.pop(chunk));
+
+}   // End of SerialWorker::takeChunk
@@ -0,0 +1,105 @@
+/***************************************************************************
+serial_worker.h: Include file for serial_worker.cpp
+
+Written by:
+    Sandra Mercer, P.Eng.
+    Engineer / Software Developer
+    eSonar Inc.
+
+Date:
+    November 2022
+****************************************************************************/
+
+
+#ifndef SERIAL_WORKER_H
+#define SERIAL_WORKER_H
+
+
+#include <atomic>
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QLocalSocket>
+#include <QObject>
+#include <QSerialPort>
+#include <QString>
+#include <QTcpSocket>
+#include "session_recorder.h"
+#include "spsc_queue.h"
+
+
+class SerialWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+
+    // Bytes from one read, timed from when the port was opened
+    struct Chunk
+    {
+        qint64 timeUs;
+        QByteArray data;
+    };
+
+    enum {QueueLength = 1024};
+    enum {DefaultBrokerPort = 5760};
+
+    explicit SerialWorker(QObject *parent = nullptr);
+
+    // "tcp://<host>:<port>" or "local:<name>" rather than a port name
+    static bool isBrokerEndpoint(const QString &);
+
+    // GUI thread
+    void acknowledge(void);
+    int queued(void) const;
+    bool takeChunk(Chunk &);
+
+public slots:
+
+    void slotClear(void);
+    void slotClose(void);
+    QString slotOpen(QString, qint32, int, int, int, int);
+    bool slotSetBaudRate(qint32);
+    QString slotStartRecording(QString);
+    void slotStopRecording(void);
+    void slotWrite(QByteArray);
+
+signals:
+
+    void signalError(int);
+    void signalReceived(void);
+
+private slots:
+
+    void slotBrokerDisconnected(void);
+    void slotErrorOccurred(QSerialPort::SerialPortError);
+    void slotFlushRecording(void);
+    void slotPushPending(void);
+    void slotReadyRead(void);
+
+private:
+
+    QString openBroker(const QString &);
+    void push(const QByteArray &);
+    void record(SessionCapture::directionEnum, const QByteArray &);
+
+    QSerialPort *serialPort;
+    QTcpSocket *tcpSocket;
+    QLocalSocket *localSocket;
+    QIODevice *device;              // Whichever of the above is open
+    QElapsedTimer clock;
+
+    // Bytes the full queue could not take, retried until it can
+    QByteArray pending;
+    qint64 pendingTimeUs;
+    bool bRetrying;
+
+    SessionRecorder recorder;
+    bool bFlushScheduled;
+
+    SpscQueue<Chunk, QueueLength> queue;
+    std::atomic<bool> bNotified;
+
+};
+
+
+#endif // SERIAL_WORKER_H
@@ -0,0 +1,506 @@
+/***************************************************************************
+series_reader.cpp:  Time series store reader class functions
+
+Written by:
+    Sandra Mercer, P.Eng.
+    Engineer / Software Developer
+    eSonar Inc.
+
+Date:
+    November 2022
+
+Note(s):
+- Reads the store written by SeriesWriter (see SeriesFile). Opening only
+maps the files, nothing is read until it is queried, so a month of data
+opens as fast as a minute. refresh() maps what a writer has added since
+- A query picks the finest level with no more points than asked for: the
+samples themselves, the block index or one of the rollups, found by
+binary search. Only the blocks overlapping the range are decoded, and only
+when their samples fit. When even the coarsest rollup has too many, its
+points are merged down to the number asked for
+- Rollup entries with the same time, left by a writer that was restarted
+within a bucket, are merged
+****************************************************************************/
+
+
+#include <cstring>
+#include <QDebug>
+#include <QDir>
+#include <QtEndian>
+#include "series_reader.h"
+
+
+// The min, max, sum and count behind a point, so points can be merged
+struct Summary
+{
+    qint64 timeMs;
+    float min;
+    float max;
+    double sum;
+    quint32 count;
+};
+
+
+// Local function(s)
+static qint64 lowerBound(const uchar *, qint64, int, int, qint64);
+static void merge(QVector<Summary> &, const Summary &);
+static bool readVarint(const uchar *&, const uchar *, quint32 &);
+
+
+/***************************************************************************
+Local function to return the first of entries entries of entryLength bytes
+whose qint64 at offset is at least value, or entries if there is none.
+The field must not decrease from one entry to the next
+****************************************************************************/
+static qint64 lowerBound(const uchar *base, qint64 entries, int entryLength, int offset, qint64 value)
+{
+    qint64 low = 0;
+    qint64 high = entries;
+
+    while (low < high)
+    {
+        qint64 middle = low + (high - low) / 2;
+        if (qFromLittleEndian<qint64>(base + middle * entryLength + offset) < value)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    return (low);
+
+}   // End of lowerBound
+
+
+/***************************************************************************
+Local function to append a summary, or merge it into the last one when it
+has the same time
+****************************************************************************/
+static void merge(QVector<Summary> &summaries, const Summary &summary)
+{
+    if (!summaries.isEmpty() && summaries.last().timeMs == summary.timeMs)
+    {
+        Summary &last = summaries.last();
+        last.min = qMin(last.min, summary.min);
+        last.max = qMax(last.max, summary.max);
+        last.sum += summary.sum;
+        last.count += summary.count;
+    }
+    else
+        summaries.append(summary);
+
+}   // End of merge
+
+
+/***************************************************************************
+Local function to read a varint written by SeriesWriter, stopping before
+end. Returns false if it runs past end or is longer than 5 bytes
+****************************************************************************/
+static bool readVarint(const uchar *&p, const uchar *end, quint32 &value)
+{
+    value = 0;
+
+    for (int shift = 0; shift < 35 && p < end; shift += 7)
+    {
+        uchar byte = *p++;
+        value |= quint32(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+            return (true);
+    }
+
+    return (false);
+
+}   // End of readVarint
+
+
+/***************************************************************************
+SeriesReader destructor
+****************************************************************************/
+SeriesReader::~SeriesReader()
+{
+    close();
+
+}   // End of SeriesReader::~SeriesReader
+
+
+/***************************************************************************
+Function to return the channel names
+****************************************************************************/
+QStringList SeriesReader::channels(void) const
+{
+    QStringList names;
+
+    for (const Channel *channel : channelList)
+        names.append(channel->name);
+
+    return (names);
+
+}   // End of SeriesReader::channels
+
+
+/***************************************************************************
+Function to unmap and close every file
+****************************************************************************/
+void SeriesReader::close(void)
+{
+    qDeleteAll(channelList);
+    channelList.clear();
+    path.clear();
+
+}   // End of SeriesReader::close
+
+
+/***************************************************************************
+Function to decode the blocks [first, end) and add their samples from
+startMs up to endMs as points
+****************************************************************************/
+void SeriesReader::decodeBlocks(const Channel *channel, qint64 first, qint64 end, qint64 startMs, qint64 endMs,
+                                QVector<Point> &points)
+{
+    for (qint64 block = first; block < end; block++)
+    {
+        const uchar *entry = channel->index.data + SeriesFile::HeaderLength + block * SeriesFile::IndexLength;
+        qint64 timeMs = qFromLittleEndian<qint64>(entry);
+        quint64 offset = qFromLittleEndian<quint64>(entry + 16);
+        quint32 length = qFromLittleEndian<quint32>(entry + 24);
+        quint32 count = qFromLittleEndian<quint32>(entry + 28);
+
+        // The data file is mapped after the index, but may have been cut off
+        if (offset + length > quint64(channel->data.size) || length < 4)
+            break;
+
+        const uchar *p = channel->data.data + offset;
+        const uchar *blockEnd = p + length;
+        quint32 timesLength = qFromLittleEndian<quint32>(p);
+        p += 4;
+        if (timesLength > length - 4)
+            break;
+
+        const uchar *times = p;
+        const uchar *timesEnd = p + timesLength;
+        const uchar *values = timesEnd;
+
+        qint64 delta = 0;
+        quint32 bits = 0;
+        quint32 encoded;
+        decodedCount++;
+
+        for (quint32 i = 0; i < count; i++)
+        {
+            if (!readVarint(times, timesEnd, encoded))
+                break;
+            delta += qint32((encoded >> 1) ^ (~(encoded & 1) + 1));
+            timeMs += delta;
+
+            if (!readVarint(values, blockEnd, encoded))
+                break;
+            bits ^= encoded;
+
+            if (timeMs < startMs)
+                continue;
+            if (timeMs >= endMs)
+                return;
+
+            Point point;
+            point.timeMs = timeMs;
+            memcpy(&point.min, &bits, sizeof(bits));
+            point.max = point.min;
+            point.mean = point.min;
+            points.append(point);
+        }
+    }
+
+}   // End of SeriesReader::decodeBlocks
+
+
+/***************************************************************************
+Function to return the channel with a name, or nullptr
+****************************************************************************/
+SeriesReader::Channel *SeriesReader::find(const QString &name) const
+{
+    for (Channel *channel : channelList)
+    {
+        if (channel->name == name)
+            return (channel);
+    }
+
+    return (nullptr);
+
+}   // End of SeriesReader::find
+
+
+/***************************************************************************
+Function to map a file up to its last whole entry, entryLength is 0 for
+the data file
+****************************************************************************/
+void SeriesReader::map(Mapped &mapped, int entryLength)
+{
+    if (mapped.data != nullptr)
+        mapped.file.unmap(const_cast<uchar *>(mapped.data));
+    mapped.data = nullptr;
+    mapped.size = 0;
+    mapped.entries = 0;
+
+    qint64 size = mapped.file.size();
+    if (entryLength > 0)
+    {
+        mapped.entries = qMax(qint64(0), (size - SeriesFile::HeaderLength) / entryLength);
+        size = SeriesFile::HeaderLength + mapped.entries * entryLength;
+    }
+    if (size <= SeriesFile::HeaderLength)
+    {
+        mapped.entries = 0;
+        return;
+    }
+
+    mapped.data = mapped.file.map(0, size);
+    if (mapped.data == nullptr)
+    {
+        qDebug() << "SeriesReader::map:" << mapped.file.fileName() << mapped.file.errorString();
+        mapped.entries = 0;
+        return;
+    }
+    mapped.size = size;
+
+}   // End of SeriesReader::map
+
+
+/***************************************************************************
+Function to open a store directory and map the files of every channel
+
+Returns an empty string, or the error
+****************************************************************************/
+QString SeriesReader::open(const QString &directory)
+{
+    close();
+
+    QDir dir(directory);
+    if (!dir.exists())
+        return (QString("%1 does not exist").arg(directory));
+
+    for (const QString &fileName : dir.entryList(QStringList() << "*.pmsi", QDir::Files, QDir::Name))
+    {
+        Channel *channel = new Channel;
+        channel->name = fileName.left(fileName.size() - 5);
+        channel->data.file.setFileName(dir.filePath(channel->name + ".pmsd"));
+        channel->index.file.setFileName(dir.filePath(fileName));
+        for (int tier = 0; tier < SeriesFile::Tiers; tier++)
+            channel->rollup[tier].file.setFileName(dir.filePath(QString("%1_%2.pmsr").arg(channel->name).arg(SeriesFile::RollupMs[tier])));
+
+        // Only the headers are read here
+        QVector<QFile *> files;
+        QVector<const char *> magic;
+        files << &channel->index.file << &channel->data.file;
+        magic << SeriesFile::IndexMagic << SeriesFile::DataMagic;
+        for (int tier = 0; tier < SeriesFile::Tiers; tier++)
+        {
+            files << &channel->rollup[tier].file;
+            magic << SeriesFile::RollupMagic;
+        }
+
+        bool bOk = true;
+        for (int i = 0; i < files.size() && bOk; i++)
+        {
+            uchar header[SeriesFile::HeaderLength];
+
+            // A missing rollup only makes the queries slower
+            if (!files[i]->open(QIODevice::ReadOnly))
+            {
+                bOk = (i >= 2);
+                continue;
+            }
+            bOk = files[i]->read(reinterpret_cast<char *>(header), sizeof(header)) == sizeof(header) &&
+                  memcmp(header, magic[i], 8) == 0 &&
+                  qFromLittleEndian<quint32>(header + 8) == SeriesFile::Version;
+        }
+        if (!bOk)
+        {
+            qDebug() << "SeriesReader::open: skipping" << channel->name;
+            delete channel;
+            continue;
+        }
+
+        channelList.append(channel);
+    }
+
+    if (channelList.isEmpty())
+        return (QString("%1 has no version %2 series").arg(directory).arg(SeriesFile::Version));
+
+    path = directory;
+    refresh();
+
+    return (QString());
+
+}   // End of SeriesReader::open
+
+
+/***************************************************************************
+Function to return the points of a channel from startMs up to endMs, at
+most maxPoints of them. Returns false if there is no such channel
+****************************************************************************/
+bool SeriesReader::query(const QString &name, qint64 startMs, qint64 endMs, int maxPoints, QVector<Point> &points)
+{
+    points.clear();
+
+    Channel *channel = find(name);
+    if (channel == nullptr)
+        return (false);
+    if (channel->index.entries == 0 || maxPoints <= 0 || endMs <= startMs)
+        return (true);
+
+    const uchar *index = channel->index.data + SeriesFile::HeaderLength;
+    qint64 firstBlock = lowerBound(index, channel->index.entries, SeriesFile::IndexLength, 8, startMs);
+    qint64 endBlock = lowerBound(index, channel->index.entries, SeriesFile::IndexLength, 0, endMs);
+    qint64 blocks = endBlock - firstBlock;
+    if (blocks <= 0)
+        return (true);
+
+    // The samples themselves, if they fit. The blocks at the ends of the
+    // range are counted by how much of their time is in it
+    if (blocks <= maxPoints)
+    {
+        double samples = 0.0;
+        for (qint64 block = firstBlock; block < endBlock && samples <= maxPoints; block++)
+        {
+            const uchar *entry = index + block * SeriesFile::IndexLength;
+            qint64 first = qFromLittleEndian<qint64>(entry);
+            qint64 last = qFromLittleEndian<qint64>(entry + 8);
+            quint32 count = qFromLittleEndian<quint32>(entry + 28);
+
+            if (last > first)
+                samples += count * double(qMin(last, endMs) - qMax(first, startMs)) / (last - first);
+            else
+                samples += count;
+        }
+
+        if (samples <= maxPoints)
+        {
+            decodeBlocks(channel, firstBlock, endBlock, startMs, endMs, points);
+            if (points.size() <= maxPoints)
+                return (true);
+            points.clear();
+        }
+    }
+
+    // Otherwise the level with the most points that fit, the block index is
+    // level -1, or the coarsest if none fit
+    int level = -1;
+    qint64 levelFirst = firstBlock;
+    qint64 levelCount = blocks;
+    for (int tier = 0; tier < SeriesFile::Tiers; tier++)
+    {
+        const Mapped &rollup = channel->rollup[tier];
+        if (rollup.entries == 0)
+            continue;
+
+        const uchar *base = rollup.data + SeriesFile::HeaderLength;
+        qint64 first = lowerBound(base, rollup.entries, SeriesFile::RollupLength, 0, startMs - SeriesFile::RollupMs[tier] + 1);
+        qint64 count = lowerBound(base, rollup.entries, SeriesFile::RollupLength, 0, endMs) - first;
+
+        bool bBetter = (count <= maxPoints) ? (levelCount > maxPoints || count > levelCount) : (count < levelCount);
+        if (count > 0 && bBetter)
+        {
+            level = tier;
+            levelFirst = first;
+            levelCount = count;
+        }
+    }
+
+    QVector<Summary> summaries;
+    summaries.reserve(int(qMin(levelCount, qint64(maxPoints) * 2)));
+
+    // Merged down to maxPoints equal spans when there are too many
+    qint64 spanMs = (levelCount > maxPoints) ? (endMs - startMs + maxPoints - 1) / maxPoints : 0;
+
+    for (qint64 i = levelFirst; i < levelFirst + levelCount; i++)
+    {
+        Summary summary;
+
+        if (level < 0)
+        {
+            const uchar *entry = index + i * SeriesFile::IndexLength;
+            summary.timeMs = qFromLittleEndian<qint64>(entry);
+            summary.count = qFromLittleEndian<quint32>(entry + 28);
+            summary.min = qFromLittleEndian<float>(entry + 32);
+            summary.max = qFromLittleEndian<float>(entry + 36);
+            summary.sum = qFromLittleEndian<double>(entry + 40);
+        }
+        else
+        {
+            const uchar *entry = channel->rollup[level].data + SeriesFile::HeaderLength + i * SeriesFile::RollupLength;
+            summary.timeMs = qFromLittleEndian<qint64>(entry);
+            summary.min = qFromLittleEndian<float>(entry + 8);
+            summary.max = qFromLittleEndian<float>(entry + 12);
+            summary.sum = qFromLittleEndian<double>(entry + 16);
+            summary.count = qFromLittleEndian<quint32>(entry + 24);
+        }
+
+        if (spanMs > 0)
+            summary.timeMs = startMs + qBound(qint64(0), (summary.timeMs - startMs) / spanMs, qint64(maxPoints - 1)) * spanMs;
+
+        merge(summaries, summary);
+    }
+
+    points.resize(summaries.size());
+    for (int i = 0; i < summaries.size(); i++)
+    {
+        const Summary &summary = summaries.at(i);
+        points[i].timeMs = summary.timeMs;
+        points[i].min = summary.min;
+        points[i].max = summary.max;
+        points[i].mean = (summary.count > 0) ? float(summary.sum / summary.count) : summary.min;
+    }
+
+    return (true);
+
+}   // End of SeriesReader::query
+
+
+/***************************************************************************
+Function to return the time of the first and last sample of a channel.
+Returns false if it has none
+****************************************************************************/
+bool SeriesReader::range(const QString &name, qint64 &firstMs, qint64 &lastMs) const
+{
+    const Channel *channel = find(name);
+    if (channel == nullptr || channel->index.entries == 0)
+        return (false);
+
+    const uchar *index = channel->index.data + SeriesFile::HeaderLength;
+    firstMs = qFromLittleEndian<qint64>(index);
+    lastMs = qFromLittleEndian<qint64>(index + (channel->index.entries - 1) * SeriesFile::IndexLength + 8);
+
+    return (true);
+
+}   // End of SeriesReader::range
+
+
+/***************************************************************************
+Function to map whatever a writer has added since the files were mapped.
+The index is mapped first, so every block it holds is in the data mapped
+****************************************************************************/
+void SeriesReader::refresh(void)
+{
+    for (Channel *channel : channelList)
+    {
+        if (channel->index.file.size() != channel->index.size)
+            map(channel->index, SeriesFile::IndexLength);
+        if (channel->data.file.size() != channel->data.size)
+            map(channel->data, 0);
+        for (int tier = 0; tier < SeriesFile::Tiers; tier++)
+        {
+            if (channel->rollup[tier].file.isOpen() && channel->rollup[tier].file.size() != channel->rollup[tier].size)
+                map(channel->rollup[tier], SeriesFile::RollupLength);
+        }
+    }
+
+}   // End of SeriesReader::refresh
+
+
+/***************************************************************************
+Function to return the number of blocks decoded by the queries so far
+****************************************************************************/
+qint64 SeriesReader::blocksDecoded(void) const
+{
+    return (decodedCount);
+
+}   // End of SeriesReader::blocksDecoded
@@ -0,0 +1,81 @@
+/***************************************************************************
+series_reader.h: Include file for series_reader.cpp
+
+Written by:
+    Sandra Mercer, P.Eng.
+    Engineer / Software Developer
+    eSonar Inc.
+
+Date:
+    November 2022
+****************************************************************************/
+
+
+#ifndef SERIES_READER_H
+#define SERIES_READER_H
+
+
+#include <QFile>
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include "series_writer.h"
+
+
+class SeriesReader
+{
+
+public:
+
+    // A sample, or the summary of the samples from timeMs up to the next point
+    struct Point
+    {
+        qint64 timeMs;
+        float min;
+        float max;
+        float mean;
+    };
+
+    ~SeriesReader();
+
+    QString open(const QString &);
+    void close(void);
+    void refresh(void);
+
+    QStringList channels(void) const;
+    bool range(const QString &, qint64 &, qint64 &) const;
+    bool query(const QString &, qint64, qint64, int, QVector<Point> &);
+    qint64 blocksDecoded(void) const;
+
+private:
+
+    // A file mapped up to its last whole entry
+    struct Mapped
+    {
+        QFile file;
+        const uchar *data = nullptr;
+        qint64 size = 0;
+        qint64 entries = 0;
+    };
+
+    struct Channel
+    {
+        QString name;
+        Mapped data;
+        Mapped index;
+        Mapped rollup[SeriesFile::Tiers];
+    };
+
+    Channel *find(const QString &) const;
+    void map(Mapped &, int);
+    void decodeBlocks(const Channel *, qint64, qint64, qint64, qint64, QVector<Point> &);
+
+    QString path;
+    QList<Channel *> channelList;
+    qint64 decodedCount = 0;
+
+};
+
+
+#endif // SERIES_READER_H
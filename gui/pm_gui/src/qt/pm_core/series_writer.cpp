@@ -0,0 +1,387 @@
+/***************************************************************************
+series_writer.cpp:  Time series store writer class functions
+
+Written by:
+    Sandra Mercer, P.Eng.
+    Engineer / Software Developer
+    eSonar Inc.
+
+Date:
+    November 2022
+
+Note(s):
+- Writes the columnar store read by SeriesReader (see SeriesFile), for
+logs too long to keep in memory. Each channel has its own files, so a
+query for one channel reads nothing of the others
+- Samples at a steady rate take about one byte for the time, and a value
+that repeats or changes only in its low bits takes one to three bytes
+- The rollups are kept as the samples arrive, a bucket is written when the
+first sample of the next one comes. The block index is the finest rollup,
+with a min, max and sum per block
+- An existing store is appended to. A partly written entry left by a crash
+is cut off, and a bucket that was still open is started again, so it may
+be written twice with the same time (SeriesReader merges them). Samples
+older than the last one of their channel are dropped and counted
+- The files are written through about once a second, after a crash the
+block and the buckets being filled are lost
+****************************************************************************/
+
+
+#include <cstring>
+#include <QDebug>
+#include <QDir>
+#include <QtEndian>
+#include "series_writer.h"
+
+
+// Local function(s)
+static void appendVarint(QByteArray &, quint32);
+
+
+/***************************************************************************
+Local function to append a value 7 bits at a time, low bits first, with
+the top bit set on all but the last byte
+****************************************************************************/
+static void appendVarint(QByteArray &data, quint32 value)
+{
+    while (value >= 0x80)
+    {
+        data.append(char((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    data.append(char(value));
+
+}   // End of appendVarint
+
+
+/***************************************************************************
+SeriesWriter destructor
+****************************************************************************/
+SeriesWriter::~SeriesWriter()
+{
+    close();
+
+}   // End of SeriesWriter::~SeriesWriter
+
+
+/***************************************************************************
+Function to add a channel, numbered in the order added, creating its files
+or opening them to be appended to
+
+Returns an empty string, or the error
+****************************************************************************/
+QString SeriesWriter::addChannel(const QString &name)
+{
+    if (path.isEmpty())
+        return (QString("No store is open"));
+
+    QDir dir(path);
+    Channel *channel = new Channel;
+    QString error;
+
+    channel->name = name;
+    channel->data.setFileName(dir.filePath(name + ".pmsd"));
+    channel->index.setFileName(dir.filePath(name + ".pmsi"));
+    for (int tier = 0; tier < SeriesFile::Tiers; tier++)
+    {
+        channel->rollup[tier].setFileName(dir.filePath(QString("%1_%2.pmsr").arg(name).arg(SeriesFile::RollupMs[tier])));
+        channel->bucket[tier].count = 0;
+    }
+
+    error = openFile(channel->index, SeriesFile::IndexMagic, SeriesFile::IndexLength, SeriesFile::IndexLength);
+    if (error.isEmpty())
+        error = openFile(channel->data, SeriesFile::DataMagic, 0, 0);
+    for (int tier = 0; tier < SeriesFile::Tiers && error.isEmpty(); tier++)
+        error = openFile(channel->rollup[tier], SeriesFile::RollupMagic, quint32(SeriesFile::RollupMs[tier]), SeriesFile::RollupLength);
+    if (!error.isEmpty())
+    {
+        delete channel;
+        return (error);
+    }
+
+    // Carry on after the last indexed block, anything in the data file
+    // beyond it was not indexed before a crash
+    channel->count = 0;
+    channel->lastMs = 0;
+    qint64 dataEnd = SeriesFile::HeaderLength;
+    if (channel->index.size() > SeriesFile::HeaderLength)
+    {
+        uchar entry[SeriesFile::IndexLength];
+        channel->index.seek(channel->index.size() - SeriesFile::IndexLength);
+        channel->index.read(reinterpret_cast<char *>(entry), sizeof(entry));
+
+        channel->lastMs = qFromLittleEndian<qint64>(entry + 8);
+        dataEnd = qint64(qFromLittleEndian<quint64>(entry + 16)) + qFromLittleEndian<quint32>(entry + 24);
+    }
+    if (channel->data.size() > dataEnd)
+        channel->data.resize(dataEnd);
+
+    channel->index.seek(channel->index.size());
+    channel->data.seek(channel->data.size());
+    for (int tier = 0; tier < SeriesFile::Tiers; tier++)
+        channel->rollup[tier].seek(channel->rollup[tier].size());
+
+    channels.append(channel);
+
+    return (QString());
+
+}   // End of SeriesWriter::addChannel
+
+
+/***************************************************************************
+Function to add a sample to a channel
+****************************************************************************/
+void SeriesWriter::append(int number, qint64 timeMs, float value)
+{
+    if (number < 0 || number >= channels.size())
+        return;
+
+    Channel *channel = channels.at(number);
+
+    if (timeMs < channel->lastMs)
+    {
+        droppedCount++;
+        return;
+    }
+
+    if (channel->count > 0 && (channel->count >= quint32(BlockSamples) || timeMs - channel->firstMs >= BlockSpanMs))
+        writeBlock(channel);
+
+    if (channel->count == 0)
+    {
+        channel->firstMs = timeMs;
+        channel->lastMs = timeMs;
+        channel->previousDelta = 0;
+        channel->previousBits = 0;
+        channel->min = value;
+        channel->max = value;
+        channel->sum = 0.0;
+    }
+
+    // Delta of delta times, zig-zag so a small step back costs one byte too
+    qint64 delta = timeMs - channel->lastMs;
+    qint32 deltaOfDelta = qint32(delta - channel->previousDelta);
+    appendVarint(channel->times, (quint32(deltaOfDelta) << 1) ^ quint32(deltaOfDelta >> 31));
+    channel->previousDelta = delta;
+    channel->lastMs = timeMs;
+
+    // Close values share their sign, exponent and high mantissa bits
+    quint32 bits;
+    memcpy(&bits, &value, sizeof(bits));
+    appendVarint(channel->values, bits ^ channel->previousBits);
+    channel->previousBits = bits;
+
+    channel->min = qMin(channel->min, value);
+    channel->max = qMax(channel->max, value);
+    channel->sum += value;
+    channel->count++;
+
+    for (int tier = 0; tier < SeriesFile::Tiers; tier++)
+    {
+        Bucket &bucket = channel->bucket[tier];
+        qint64 bucketMs = timeMs - timeMs % SeriesFile::RollupMs[tier];
+
+        if (bucket.count > 0 && bucket.timeMs != bucketMs)
+            writeBucket(channel, tier);
+
+        if (bucket.count == 0)
+        {
+            bucket.timeMs = bucketMs;
+            bucket.min = value;
+            bucket.max = value;
+            bucket.sum = 0.0;
+        }
+        bucket.min = qMin(bucket.min, value);
+        bucket.max = qMax(bucket.max, value);
+        bucket.sum += value;
+        bucket.count++;
+    }
+
+    sampleCount++;
+
+    if (flushElapsed.elapsed() >= FlushIntervalMs)
+    {
+        for (Channel *each : channels)
+        {
+            each->data.flush();
+            each->index.flush();
+            for (int tier = 0; tier < SeriesFile::Tiers; tier++)
+                each->rollup[tier].flush();
+        }
+        flushElapsed.restart();
+    }
+
+}   // End of SeriesWriter::append
+
+
+/***************************************************************************
+Function to write the blocks and buckets being filled and close the files
+****************************************************************************/
+void SeriesWriter::close(void)
+{
+    if (path.isEmpty())
+        return;
+
+    qDebug() << "SeriesWriter::close:" << path << sampleCount << "samples," << droppedCount << "dropped";
+
+    for (Channel *channel : channels)
+    {
+        if (channel->count > 0)
+            writeBlock(channel);
+        for (int tier = 0; tier < SeriesFile::Tiers; tier++)
+        {
+            if (channel->bucket[tier].count > 0)
+                writeBucket(channel, tier);
+        }
+    }
+
+    qDeleteAll(channels);
+    channels.clear();
+    path.clear();
+
+}   // End of SeriesWriter::close
+
+
+/***************************************************************************
+Function to open a store directory, creating it if needed. The channels
+are added with addChannel()
+
+Returns an empty string, or the error
+****************************************************************************/
+QString SeriesWriter::open(const QString &directory)
+{
+    close();
+
+    if (!QDir(directory).mkpath("."))
+        return (QString("Could not create %1").arg(directory));
+
+    path = directory;
+    sampleCount = 0;
+    droppedCount = 0;
+    flushElapsed.start();
+
+    return (QString());
+
+}   // End of SeriesWriter::open
+
+
+/***************************************************************************
+Function to open one file of a channel, writing the header of a new file
+or checking the header of an existing one, and cutting off a partly
+written entry
+
+Returns an empty string, or the error
+****************************************************************************/
+QString SeriesWriter::openFile(QFile &file, const char *magic, quint32 value, int entryLength)
+{
+    if (!file.open(QIODevice::ReadWrite))
+        return (QString("Could not open %1: %2").arg(file.fileName()).arg(file.errorString()));
+
+    uchar header[SeriesFile::HeaderLength];
+
+    if (file.size() < SeriesFile::HeaderLength)
+    {
+        memcpy(header, magic, 8);
+        qToLittleEndian<quint32>(SeriesFile::Version, header + 8);
+        qToLittleEndian<quint32>(value, header + 12);
+
+        file.resize(0);
+        file.write(reinterpret_cast<const char *>(header), sizeof(header));
+        return (QString());
+    }
+
+    if (file.read(reinterpret_cast<char *>(header), sizeof(header)) != sizeof(header) ||
+        memcmp(header, magic, 8) != 0 ||
+        qFromLittleEndian<quint32>(header + 8) != SeriesFile::Version ||
+        qFromLittleEndian<quint32>(header + 12) != value)
+    {
+        file.close();
+        return (QString("%1 is not a version %2 store file of this kind").arg(file.fileName()).arg(SeriesFile::Version));
+    }
+
+    if (entryLength > 0)
+    {
+        qint64 entries = (file.size() - SeriesFile::HeaderLength) / entryLength;
+        file.resize(SeriesFile::HeaderLength + entries * entryLength);
+    }
+
+    return (QString());
+
+}   // End of SeriesWriter::openFile
+
+
+/***************************************************************************
+Function to write the block being filled and its index entry
+****************************************************************************/
+void SeriesWriter::writeBlock(Channel *channel)
+{
+    uchar length[4];
+    quint64 offset = quint64(channel->data.pos());
+
+    qToLittleEndian<quint32>(quint32(channel->times.size()), length);
+    channel->data.write(reinterpret_cast<const char *>(length), sizeof(length));
+    channel->data.write(channel->times);
+    channel->data.write(channel->values);
+
+    uchar entry[SeriesFile::IndexLength];
+    qToLittleEndian<qint64>(channel->firstMs, entry);
+    qToLittleEndian<qint64>(channel->lastMs, entry + 8);
+    qToLittleEndian<quint64>(offset, entry + 16);
+    qToLittleEndian<quint32>(quint32(sizeof(length) + channel->times.size() + channel->values.size()), entry + 24);
+    qToLittleEndian<quint32>(channel->count, entry + 28);
+    qToLittleEndian<float>(channel->min, entry + 32);
+    qToLittleEndian<float>(channel->max, entry + 36);
+    qToLittleEndian<double>(channel->sum, entry + 40);
+    channel->index.write(reinterpret_cast<const char *>(entry), sizeof(entry));
+
+    channel->times.clear();
+    channel->values.clear();
+    channel->count = 0;
+
+}   // End of SeriesWriter::writeBlock
+
+
+/***************************************************************************
+Function to write a channel's bucket for one rollup tier
+****************************************************************************/
+void SeriesWriter::writeBucket(Channel *channel, int tier)
+{
+    const Bucket &bucket = channel->bucket[tier];
+    uchar entry[SeriesFile::RollupLength];
+
+    qToLittleEndian<qint64>(bucket.timeMs, entry);
+    qToLittleEndian<float>(bucket.min, entry + 8);
+    qToLittleEndian<float>(bucket.max, entry + 12);
+    qToLittleEndian<double>(bucket.sum, entry + 16);
+    qToLittleEndian<quint32>(bucket.count, entry + 24);
+    qToLittleEndian<quint32>(0, entry + 28);
+    channel->rollup[tier].write(reinterpret_cast<const char *>(entry), sizeof(entry));
+
+    channel->bucket[tier].count = 0;
+
+}   // End of SeriesWriter::writeBucket
+
+
+/***************************************************************************
+Functions to return the store directory, the number of samples written and
+the number dropped for being out of order
+****************************************************************************/
+QString SeriesWriter::directory(void) const
+{
+    return (path);
+
+}   // End of SeriesWriter::directory
+
+
+qint64 SeriesWriter::samples(void) const
+{
+    return (sampleCount);
+
+}   // End of SeriesWriter::samples
+
+
+qint64 SeriesWriter::dropped(void) const
+{
+    return (droppedCount);
+
+}   // End of SeriesWriter::dropped
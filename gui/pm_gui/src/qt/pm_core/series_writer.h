@@ -0,0 +1,130 @@
+/***************************************************************************
+series_writer.h: Include file for series_writer.cpp
+
+Written by:
+    Sandra Mercer, P.Eng.
+    Engineer / Software Developer
+    eSonar Inc.
+
+Date:
+    November 2022
+****************************************************************************/
+
+
+#ifndef SERIES_WRITER_H
+#define SERIES_WRITER_H
+
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QList>
+#include <QString>
+
+
+// Time series store layout, a directory with these files per channel, all
+// fields little endian. Every file starts with char magic[8], quint32
+// version and a quint32 given below
+//
+//   <channel>.pmsd        Data, the entry length is 0. Blocks of up to
+//                         BlockSamples samples, back to back: quint32 length
+//                         of the time column, the time column (zig-zag
+//                         varint delta of delta ms, starting from the
+//                         block's first time and a delta of 0), the value
+//                         column (varint of each float's bits XOR the
+//                         previous float's, starting from 0)
+//   <channel>.pmsi        Block index, one IndexLength entry per block:
+//                         qint64 first ms, qint64 last ms, quint64 offset in
+//                         the data file, quint32 length, quint32 samples,
+//                         float min, float max, double sum
+//   <channel>_<ms>.pmsr   Rollup at each of RollupMs, one RollupLength entry
+//                         per bucket with samples: qint64 bucket start ms,
+//                         float min, float max, double sum, quint32 samples,
+//                         quint32 reserved. The header quint32 is the
+//                         bucket length in ms
+//
+// Times are ms since the epoch, UTC, and never decrease within a channel
+namespace SeriesFile
+{
+    const char DataMagic[8] = {'P', 'M', 'S', 'E', 'R', 'D', 'A', 'T'};
+    const char IndexMagic[8] = {'P', 'M', 'S', 'E', 'R', 'I', 'D', 'X'};
+    const char RollupMagic[8] = {'P', 'M', 'S', 'E', 'R', 'R', 'U', 'P'};
+    const quint32 Version = 1;
+    const int HeaderLength = 16;
+    const int IndexLength = 48;
+    const int RollupLength = 32;
+
+    const int Tiers = 3;
+    const qint64 RollupMs[Tiers] = {10000, 300000, 3600000};
+}
+
+
+class SeriesWriter
+{
+
+public:
+
+    // A block is written when it has BlockSamples samples or spans
+    // BlockSpanMs, which bounds what a crash can lose
+    static const int BlockSamples = 1024;
+    static const qint64 BlockSpanMs = 60000;
+    static const int FlushIntervalMs = 1000;
+
+    ~SeriesWriter();
+
+    QString open(const QString &);
+    void close(void);
+    QString addChannel(const QString &);
+    void append(int, qint64, float);
+
+    QString directory(void) const;
+    qint64 samples(void) const;
+    qint64 dropped(void) const;
+
+private:
+
+    struct Bucket
+    {
+        qint64 timeMs;
+        float min;
+        float max;
+        double sum;
+        quint32 count;
+    };
+
+    struct Channel
+    {
+        QString name;
+        QFile data;
+        QFile index;
+        QFile rollup[SeriesFile::Tiers];
+
+        // The block being filled, the columns are joined when it is written
+        QByteArray times;
+        QByteArray values;
+        qint64 firstMs;
+        qint64 lastMs;
+        qint64 previousDelta;
+        quint32 previousBits;
+        quint32 count;
+        float min;
+        float max;
+        double sum;
+
+        Bucket bucket[SeriesFile::Tiers];
+    };
+
+    QString openFile(QFile &, const char *, quint32, int);
+    void writeBlock(Channel *);
+    void writeBucket(Channel *, int);
+
+    QString path;
+    QList<Channel *> channels;
+    qint64 sampleCount = 0;
+    qint64 droppedCount = 0;
+    QElapsedTimer flushElapsed;
+
+};
+
+
+#endif // SERIES_WRITER_H
@@ -0,0 +1,152 @@
+/***************************************************************************
+session_recorder.cpp:  Serial session capture class functions
+
+Written by:
+    Sandra Mercer, P.Eng.
+    Engineer / Software Developer
+    eSonar Inc.
+
+Date:
+    November 2022
+
+Note(s):
+- Every chunk read from or written to the port is appended to the capture
+as one record, exactly as it went over the wire. The capture is only ever
+appended to, so a file cut short by a crash is still readable up to its
+last whole record
+- The record times are from a QElapsedTimer started with the capture, so
+they are monotonic and do not jump with the wall clock. The header keeps
+the wall clock time the capture started
+- The recorder belongs to the SerialWorker and is only used in its thread
+(see Serial)
+****************************************************************************/
+
+
+#include <cstring>
+#include <QDateTime>
+#include <QDebug>
+#include <QtEndian>
+#include "session_recorder.h"
+
+
+/***************************************************************************
+SessionRecorder destructor
+****************************************************************************/
+SessionRecorder::~SessionRecorder()
+{
+    close();
+
+}   // End of SessionRecorder::~SessionRecorder
+
+
+/***************************************************************************
+Function to create a capture file and write its header
+
+Returns an empty string, or the error
+****************************************************************************/
+QString SessionRecorder::open(const QString &fileName)
+{
+    qDebug() << "SessionRecorder::open:" << fileName;
+
+    close();
+
+    file.setFileName(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return (QString("Could not create %1: %2").arg(fileName).arg(file.errorString()));
+
+    uchar header[SessionCapture::HeaderLength];
+    memcpy(header, SessionCapture::Magic, sizeof(SessionCapture::Magic));
+    qToLittleEndian<quint32>(SessionCapture::Version, header + 8);
+    qToLittleEndian<quint32>(0, header + 12);
+    qToLittleEndian<qint64>(QDateTime::currentMSecsSinceEpoch(), header + 16);
+
+    if (file.write(reinterpret_cast<const char *>(header), sizeof(header)) != qint64(sizeof(header)))
+    {
+        QString error = file.errorString();
+        file.close();
+        return (QString("Could not write %1: %2").arg(fileName).arg(error));
+    }
+
+    clock.start();
+    flushElapsed.start();
+
+    return (QString());
+
+}   // End of SessionRecorder::open
+
+
+/***************************************************************************
+Function to write out the buffered records and close the capture
+****************************************************************************/
+void SessionRecorder::close(void)
+{
+    if (!file.isOpen())
+        return;
+
+    bBuffered = false;
+
+    qDebug() << "SessionRecorder::close:" << file.fileName() << file.size() << "bytes";
+
+    file.close();
+
+}   // End of SessionRecorder::close
+
+
+/***************************************************************************
+Function to return true while capturing
+****************************************************************************/
+bool SessionRecorder::isOpen(void) const
+{
+    return (file.isOpen());
+
+}   // End of SessionRecorder::isOpen
+
+
+/***************************************************************************
+Function to append a chunk to the capture
+****************************************************************************/
+void SessionRecorder::record(SessionCapture::directionEnum direction, const QByteArray &data)
+{
+    if (!file.isOpen() || data.isEmpty())
+        return;
+
+    uchar header[SessionCapture::RecordHeaderLength] = {0};
+    qToLittleEndian<quint64>(quint64(clock.nsecsElapsed() / 1000), header);
+    qToLittleEndian<quint32>(quint32(data.size()), header + 8);
+    header[12] = uchar(direction);
+
+    file.write(reinterpret_cast<const char *>(header), sizeof(header));
+    file.write(data);
+    bBuffered = true;
+
+    // Written through in small batches rather than one system call per chunk
+    if (flushElapsed.elapsed() >= FlushIntervalMs)
+        flush();
+
+}   // End of SessionRecorder::record
+
+
+/***************************************************************************
+Function to write the buffered records through to the file
+****************************************************************************/
+void SessionRecorder::flush(void)
+{
+    if (!bBuffered)
+        return;
+
+    file.flush();
+    flushElapsed.restart();
+    bBuffered = false;
+
+}   // End of SessionRecorder::flush
+
+
+/***************************************************************************
+Function to return true while records are buffered and not yet written
+through
+****************************************************************************/
+bool SessionRecorder::isBuffered(void) const
+{
+    return (bBuffered);
+
+}   // End of SessionRecorder::isBuffered
@@ -0,0 +1,72 @@
+/***************************************************************************
+session_recorder.h: Include file for session_recorder.cpp
+
+Written by:
+    Sandra Mercer, P.Eng.
+    Engineer / Software Developer
+    eSonar Inc.
+
+Date:
+    November 2022
+****************************************************************************/
+
+
+#ifndef SESSION_RECORDER_H
+#define SESSION_RECORDER_H
+
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QString>
+
+
+// Capture file layout, all fields little endian
+//
+//   Header:  char magic[8] "PMCAPTUR", quint32 version, quint32 reserved,
+//            qint64 start time (ms since the epoch, UTC)
+//   Record:  quint64 time (us since the start), quint32 length,
+//            quint8 direction, quint8 reserved[3], then length bytes
+namespace SessionCapture
+{
+    const char Magic[8] = {'P', 'M', 'C', 'A', 'P', 'T', 'U', 'R'};
+    const quint32 Version = 1;
+    const int HeaderLength = 24;
+    const int RecordHeaderLength = 16;
+
+    enum directionEnum {RECEIVED = 0, SENT = 1};
+}
+
+
+class SessionRecorder
+{
+
+public:
+
+    // A record more than this long after the last write through is written
+    // through with everything buffered before it. The owner calls flush()
+    // this long after a record is left buffered, so a quiet port still
+    // reaches the file
+    static const int FlushIntervalMs = 100;
+
+    ~SessionRecorder();
+
+    QString open(const QString &);
+    void close(void);
+    bool isOpen(void) const;
+
+    void record(SessionCapture::directionEnum, const QByteArray &);
+    void flush(void);
+    bool isBuffered(void) const;
+
+private:
+
+    QFile file;
+    QElapsedTimer clock;
+    QElapsedTimer flushElapsed;
+    bool bBuffered = false;
+
+};
+
+
+#endif // SESSION_RECORDER_H
@@ -0,0 +1,252 @@
+/***************************************************************************
+session_replay.cpp:  Serial session replay class functions
+
+Written by:
+    Sandra Mercer, P.Eng.
+    Engineer / Software Developer
+    eSonar Inc.
+
+Date:
+    November 2022
+
+Note(s):
+- A capture written by SessionRecorder is memory mapped and read in place,
+a received record is passed on with QByteArray::fromRawData(), so a
+capture of any size is replayed without being loaded or copied
+- At 1x the records are passed on at their recorded times. As fast as
+possible they are passed on in slices of SliceMs, so the GUI stays
+responsive, and the throughput is reported at the end
+- The replay ends at the last whole record, a capture cut short by a crash
+is replayed up to where it stops
+****************************************************************************/
+
+
+#include <cstring>
+#include <QDebug>
+#include <QTimer>
+#include <QtEndian>
+#include "session_recorder.h"
+#include "session_replay.h"
+
+
+/***************************************************************************
+SessionReplay constructor
+****************************************************************************/
+SessionReplay::SessionReplay(QObject *parent) : QObject(parent)
+{
+    capture = nullptr;
+    captureLength = 0;
+    position = 0;
+    bRealTime = true;
+    bActive = false;
+    firstTimeUs = -1;
+    records = 0;
+    bytesReceived = 0;
+    bytesSent = 0;
+
+    timer = new QTimer(this);
+    timer->setSingleShot(true);
+    connect(timer, SIGNAL(timeout()), this, SLOT(slotNext()));
+
+}   // End of SessionReplay::SessionReplay
+
+
+/***************************************************************************
+SessionReplay destructor
+****************************************************************************/
+SessionReplay::~SessionReplay()
+{
+    stop();
+
+}   // End of SessionReplay::~SessionReplay
+
+
+/***************************************************************************
+Function to map a capture and check its header
+
+Returns an empty string, or the error
+****************************************************************************/
+QString SessionReplay::open(const QString &fileName)
+{
+    qDebug() << "SessionReplay::open:" << fileName;
+
+    stop();
+
+    file.setFileName(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return (QString("Could not open %1: %2").arg(fileName).arg(file.errorString()));
+
+    captureLength = file.size();
+    capture = (captureLength >= SessionCapture::HeaderLength) ? file.map(0, captureLength) : nullptr;
+    if (capture == nullptr)
+    {
+        file.close();
+        return (QString("Could not map %1").arg(fileName));
+    }
+
+    if (memcmp(capture, SessionCapture::Magic, sizeof(SessionCapture::Magic)) != 0 ||
+            qFromLittleEndian<quint32>(capture + 8) != SessionCapture::Version)
+    {
+        stop();
+        return (QString("%1 is not a power module capture").arg(fileName));
+    }
+
+    position = SessionCapture::HeaderLength;
+
+    return (QString());
+
+}   // End of SessionReplay::open
+
+
+/***************************************************************************
+Function to start passing on the records, at their recorded times or as
+fast as possible
+****************************************************************************/
+void SessionReplay::start(bool bRealTime)
+{
+    if (capture == nullptr)
+        return;
+
+    this->bRealTime = bRealTime;
+    bActive = true;
+    firstTimeUs = -1;
+    records = 0;
+    bytesReceived = 0;
+    bytesSent = 0;
+
+    clock.start();
+    timer->start(0);
+
+}   // End of SessionReplay::start
+
+
+/***************************************************************************
+Function to end the replay and unmap the capture
+****************************************************************************/
+void SessionReplay::stop(void)
+{
+    timer->stop();
+    bActive = false;
+
+    if (capture != nullptr)
+        file.unmap(const_cast<uchar *>(capture));
+    capture = nullptr;
+    captureLength = 0;
+
+    if (file.isOpen())
+        file.close();
+
+}   // End of SessionReplay::stop
+
+
+/***************************************************************************
+Function to return true while replaying
+****************************************************************************/
+bool SessionReplay::isActive(void) const
+{
+    return (bActive);
+
+}   // End of SessionReplay::isActive
+
+
+/***************************************************************************
+Function to pass on the next record, unless it is not due before nowUs
+
+Returns false if the record is not due yet
+****************************************************************************/
+bool SessionReplay::emitRecord(qint64 nowUs)
+{
+    const uchar *header = capture + position;
+    qint64 timeUs = qint64(qFromLittleEndian<quint64>(header));
+    quint32 length = qFromLittleEndian<quint32>(header + 8);
+
+    if (firstTimeUs < 0)
+        firstTimeUs = timeUs;
+    if (nowUs >= 0 && timeUs - firstTimeUs > nowUs)
+        return (false);
+
+    QByteArray data = QByteArray::fromRawData(reinterpret_cast<const char *>(header + SessionCapture::RecordHeaderLength),
+                                              int(length));
+    position += SessionCapture::RecordHeaderLength + length;
+    records++;
+
+    if (header[12] == SessionCapture::SENT)
+    {
+        bytesSent += length;
+        emit signalSent(data);
+    }
+    else
+    {
+        bytesReceived += length;
+        emit signalReceived(data);
+    }
+
+    return (true);
+
+}   // End of SessionReplay::emitRecord
+
+
+/***************************************************************************
+Function to end the replay and report it
+****************************************************************************/
+void SessionReplay::finish(const QString &reason)
+{
+    double seconds = clock.nsecsElapsed() / 1.0e9;
+
+    QString summary = QString("%1: %2 records, %3 bytes received, %4 bytes sent in %5 s")
+            .arg(reason).arg(records).arg(bytesReceived).arg(bytesSent).arg(seconds, 0, 'f', 3);
+    if (!bRealTime && seconds > 0.0)
+        summary += QString(" (%1 MB/s)").arg((bytesReceived + bytesSent) / seconds / 1.0e6, 0, 'f', 1);
+
+    qDebug() << "SessionReplay::finish:" << summary;
+
+    stop();
+    emit signalFinished(summary);
+
+}   // End of SessionReplay::finish
+
+
+/***************************************************************************
+Slot to pass on the records that are due and wait for the next one
+****************************************************************************/
+void SessionReplay::slotNext(void)
+{
+    qint64 sliceEndNs = clock.nsecsElapsed() + SliceMs * 1000000ll;
+
+    while (bActive)
+    {
+        if (captureLength - position < SessionCapture::RecordHeaderLength)
+        {
+            finish("Replay finished");
+            return;
+        }
+
+        quint32 length = qFromLittleEndian<quint32>(capture + position + 8);
+        if (captureLength - position - SessionCapture::RecordHeaderLength < qint64(length))
+        {
+            finish("Replay finished, the capture ends part way through a record");
+            return;
+        }
+
+        if (bRealTime)
+        {
+            qint64 nowUs = clock.nsecsElapsed() / 1000;
+            if (!emitRecord(nowUs))
+            {
+                qint64 dueUs = qint64(qFromLittleEndian<quint64>(capture + position)) - firstTimeUs;
+                timer->start(int(qMin<qint64>((dueUs - nowUs) / 1000, 1000)));
+                return;
+            }
+        }
+        else
+        {
+            emitRecord(-1);
+            if (clock.nsecsElapsed() >= sliceEndNs)
+            {
+                timer->start(0);
+                return;
+            }
+        }
+    }
+
+}   // End of SessionReplay::slotNext
@@ -0,0 +1,81 @@
+/***************************************************************************
+session_replay.h: Include file for session_replay.cpp
+
+Written by:
+    Sandra Mercer, P.Eng.
+    Engineer / Software Developer
+    eSonar Inc.
+
+Date:
+    November 2022
+****************************************************************************/
+
+
+#ifndef SESSION_REPLAY_H
+#define SESSION_REPLAY_H
+
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QObject>
+#include <QString>
+
+
+class QTimer;
+
+
+class SessionReplay : public QObject
+{
+    Q_OBJECT
+
+public:
+
+    // As fast as possible, the event loop runs at least this often
+    static const int SliceMs = 10;
+
+    explicit SessionReplay(QObject *parent = nullptr);
+    ~SessionReplay();
+
+    QString open(const QString &);
+    void start(bool);
+    void stop(void);
+    bool isActive(void) const;
+
+signals:
+
+    // The data points into the mapped capture and is only valid during the
+    // signal, copy it to keep it
+    void signalReceived(QByteArray);
+    void signalSent(QByteArray);
+
+    void signalFinished(QString);
+
+private slots:
+
+    void slotNext(void);
+
+private:
+
+    bool emitRecord(qint64);
+    void finish(const QString &);
+
+    QFile file;
+    const uchar *capture;
+    qint64 captureLength;
+    qint64 position;
+
+    bool bRealTime;
+    bool bActive;
+    qint64 firstTimeUs;
+    QElapsedTimer clock;
+    QTimer *timer;
+
+    int records;
+    qint64 bytesReceived;
+    qint64 bytesSent;
+
+};
+
+
+#endif // SESSION_REPLAY_H
@@ -0,0 +1,89 @@
+/***************************************************************************
+spsc_queue.h: Single producer, single consumer lock-free queue
+
+Written by:
+    Sandra Mercer, P.Eng.
+    Engineer / Software Developer
+    eSonar Inc.
+
+Date:
+    November 2022
+
+Note(s):
+- One thread may only push and one other thread may only pop. The item is
+written before head is published (release) and read after head is seen
+(acquire), and the same the other way for tail, so no lock is needed
+- Capacity - 1 items fit, push() returns false rather than waiting when the
+queue is full
+- A popped slot is reset so a QByteArray does not hold its memory until the
+slot is used again
+****************************************************************************/
+
+
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+
+#include <atomic>
+#include <utility>
+
+
+template <typename T, int Capacity>
+class SpscQueue
+{
+
+public:
+
+    SpscQueue() : head(0), tail(0) {}
+
+    // Producer thread only
+    bool push(const T &item)
+    {
+        int h = head.load(std::memory_order_relaxed);
+        int next = (h + 1) % Capacity;
+
+        if (next == tail.load(std::memory_order_acquire))
+            return (false);
+
+        items[h] = item;
+        head.store(next, std::memory_order_release);
+
+        return (true);
+    }
+
+    // Consumer thread only
+    bool pop(T &item)
+    {
+        int t = tail.load(std::memory_order_relaxed);
+
+        if (t == head.load(std::memory_order_acquire))
+            return (false);
+
+        item = std::move(items[t]);
+        items[t] = T();
+        tail.store((t + 1) % Capacity, std::memory_order_release);
+
+        return (true);
+    }
+
+    // Either thread, only a snapshot
+    int size(void) const
+    {
+        int h = head.load(std::memory_order_acquire);
+        int t = tail.load(std::memory_order_acquire);
+
+        return ((h - t + Capacity) % Capacity);
+    }
+
+private:
+
+    T items[Capacity];
+
+    // Kept on separate cache lines so the two threads do not share one
+    alignas(64) std::atomic<int> head;
+    alignas(64) std::atomic<int> tail;
+
+};
+
+
+#endif // SPSC_QUEUE_H
@@ -0,0 +1,255 @@
+/***************************************************************************
+telemetry_decoder.cpp:  Power module compressed telemetry decoder class
+functions
+
+Written by:
+    Sandra Mercer, P.Eng.
+    Engineer / Software Developer
+    eSonar Inc.
+
+Date:
+    October 2022
+
+Note(s):
+- Decodes the frames sent by the power module log_zdump command and the
+telemetry stream (see pm_telemetry.c): 0xa5, 'K' or 'D', payload length,
+one zig-zag varint per record field, CRC-8 (polynomial 0x07)
+- A frame with a bad CRC, or a length that is not the size of its fields,
+is dropped one byte at a time until the next 0xa5, and delta frames are skipped until the next keyframe since the
+values they are relative to were lost
+****************************************************************************/
+
+
+#include "telemetry_decoder.h"
+
+
+/***************************************************************************
+TelemetryDecoder constructor
+****************************************************************************/
+TelemetryDecoder::TelemetryDecoder()
+{
+    reset();
+
+}   // End of TelemetryDecoder::TelemetryDecoder
+
+
+/***************************************************************************
+Function to calculate the CRC-8 of length bytes of data starting at start
+****************************************************************************/
+quint8 TelemetryDecoder::crc8(const QByteArray &data, int start, int length)
+{
+    quint8 crc = 0x00;
+
+    for (int i = start; i < start + length; i++)
+    {
+        crc ^= quint8(data.at(i));
+        for (int j = 0; j < 8; j++)
+            crc = (crc & 0x80) ? quint8((crc << 1) ^ 0x07) : quint8(crc << 1);
+    }
+
+    return (crc);
+
+}   // End of TelemetryDecoder::crc8
+
+
+/***************************************************************************
+Function to read a zig-zag varint at index, stopping before end
+Returns false if the varint runs past end or is longer than 5 bytes
+****************************************************************************/
+bool TelemetryDecoder::getVarint(const QByteArray &data, int &index, int end, qint32 &value)
+{
+    quint32 zigzag = 0;
+    int shift = 0;
+
+    while (index < end && shift < 35)
+    {
+        quint8 byte = quint8(data.at(index++));
+
+        zigzag |= quint32(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0)
+        {
+            value = qint32(zigzag >> 1) ^ -qint32(zigzag & 1);
+            return (true);
+        }
+        shift += 7;
+    }
+
+    return (false);
+
+}   // End of TelemetryDecoder::getVarint
+
+
+/***************************************************************************
+Function to decode the frame at the start of data, which must start with
+Sync. The frame (or the sync byte of an invalid frame) is removed from data
+****************************************************************************/
+TelemetryDecoder::resultEnum TelemetryDecoder::decode(QByteArray &data, TelemetryRecord &record)
+{
+    int index = 0;
+    resultEnum result = decode(data, index, record);
+
+    data.remove(0, index);
+
+    return (result);
+
+}   // End of TelemetryDecoder::decode
+
+
+/***************************************************************************
+Function to decode the frame at data[index], which must be Sync. index is
+moved past the frame (or the sync byte of an invalid frame), and is left
+as it is while the frame is incomplete
+****************************************************************************/
+TelemetryDecoder::resultEnum TelemetryDecoder::decode(const QByteArray &data, int &index, TelemetryRecord &record)
+{
+    qint32 delta;
+    quint32 values[Channels];
+
+    if (data.size() - index < 3)
+        return (INCOMPLETE);
+
+    char type = data.at(index + 1);
+    int length = quint8(data.at(index + 2));
+
+    if ((type != 'K' && type != 'D') || length > MaxPayload)
+    {
+        index++;
+        invalidFrameCount++;
+        bHaveKeyframe = false;
+        return (INVALID);
+    }
+
+    if (data.size() - index < length + 4)
+        return (INCOMPLETE);
+
+    if (crc8(data, index + 1, length + 2) != quint8(data.at(index + length + 3)))
+    {
+        index++;
+        invalidFrameCount++;
+        bHaveKeyframe = false;
+        return (INVALID);
+    }
+
+    // A keyframe is a delta from zero
+    if (type == 'K')
+    {
+        for (int channel = 0; channel < Channels; channel++)
+            previous[channel] = 0;
+    }
+    else if (!bHaveKeyframe)
+    {
+        index += length + 4;
+        skippedFrameCount++;
+        return (SKIPPED);
+    }
+
+    int field = index + 3;
+    int end = index + length + 3;
+    for (int channel = 0; channel < Channels; channel++)
+    {
+        if (!getVarint(data, field, end, delta))
+        {
+            index++;
+            invalidFrameCount++;
+            bHaveKeyframe = false;
+            return (INVALID);
+        }
+        values[channel] = previous[channel] + quint32(delta);
+    }
+
+    // The fields must use the whole payload, a frame with bytes left over is
+    // not one the power module sent
+    if (field != end)
+    {
+        index++;
+        invalidFrameCount++;
+        bHaveKeyframe = false;
+        return (INVALID);
+    }
+
+    for (int channel = 0; channel < Channels; channel++)
+        previous[channel] = values[channel];
+    bHaveKeyframe = true;
+
+    record.sequence = values[0];
+    record.timestampMs = values[1];
+    record.leakMv = quint16(values[2]);
+    record.batteryMv = quint16(values[3]);
+    record.batteryMa = qint16(values[4]);
+    record.ltc2944Temperature = qint16(values[5]);
+    record.chargeMah = quint16(values[6]);
+    record.pressure = quint16(values[7]);
+    record.ms5637Temperature = qint16(values[8]);
+    record.tilt = qint16(values[9]);
+    record.powerBits = quint16(values[10]);
+    record.statusBits = quint8(values[11]);
+    record.flags = quint8(values[12]);
+
+    index += length + 4;
+    decodedRecords++;
+    encodedBytes += length + 4;
+
+    return (DECODED);
+
+}   // End of TelemetryDecoder::decode
+
+
+/***************************************************************************
+Function to wait for a keyframe and clear the statistics
+****************************************************************************/
+void TelemetryDecoder::reset(void)
+{
+    bHaveKeyframe = false;
+    for (int channel = 0; channel < Channels; channel++)
+        previous[channel] = 0;
+
+    decodedRecords = 0;
+    invalidFrameCount = 0;
+    skippedFrameCount = 0;
+    encodedBytes = 0;
+
+}   // End of TelemetryDecoder::reset
+
+
+/***************************************************************************
+Function to return the raw record size over the received frame size
+****************************************************************************/
+double TelemetryDecoder::compressionRatio(void) const
+{
+    if (encodedBytes == 0)
+        return (0.0);
+
+    return (double(decodedRecords) * RawRecordSize / double(encodedBytes));
+
+}   // End of TelemetryDecoder::compressionRatio
+
+
+/***************************************************************************
+Function to return the number of frames dropped for a bad length or CRC
+****************************************************************************/
+int TelemetryDecoder::invalidFrames(void) const
+{
+    return (invalidFrameCount);
+
+}   // End of TelemetryDecoder::invalidFrames
+
+
+/***************************************************************************
+Function to return the number of records decoded
+****************************************************************************/
+int TelemetryDecoder::records(void) const
+{
+    return (decodedRecords);
+
+}   // End of TelemetryDecoder::records
+
+
+/***************************************************************************
+Function to return the number of delta frames skipped while waiting for a
+keyframe
+****************************************************************************/
+int TelemetryDecoder::skippedFrames(void) const
+{
+    return (skippedFrameCount);
+
+}   // End of TelemetryDecoder::skippedFrames
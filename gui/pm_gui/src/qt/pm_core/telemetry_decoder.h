@@ -0,0 +1,78 @@
+/***************************************************************************
+telemetry_decoder.h: Include file for telemetry_decoder.cpp
+
+Written by:
+    Sandra Mercer, P.Eng.
+    Engineer / Software Developer
+    eSonar Inc.
+
+Date:
+    October 2022
+****************************************************************************/
+
+
+#ifndef TELEMETRY_DECODER_H
+#define TELEMETRY_DECODER_H
+
+
+#include <QByteArray>
+#include <QtGlobal>
+
+
+// One power module log record (pm_log_record in pm_logger.h)
+struct TelemetryRecord
+{
+    quint32 sequence;
+    quint32 timestampMs;
+    quint16 leakMv;
+    quint16 batteryMv;
+    qint16 batteryMa;
+    qint16 ltc2944Temperature;
+    quint16 chargeMah;
+    quint16 pressure;
+    qint16 ms5637Temperature;
+    qint16 tilt;
+    quint16 powerBits;
+    quint8 statusBits;
+    quint8 flags;
+};
+
+
+class TelemetryDecoder
+{
+
+public:
+
+    enum resultEnum {INCOMPLETE, INVALID, SKIPPED, DECODED};
+
+    static const char Sync = char(0xa5);
+
+    TelemetryDecoder();
+    resultEnum decode(QByteArray &, TelemetryRecord &);
+    resultEnum decode(const QByteArray &, int &, TelemetryRecord &);
+    void reset(void);
+
+    double compressionRatio(void) const;
+    int invalidFrames(void) const;
+    int records(void) const;
+    int skippedFrames(void) const;
+
+private:
+
+    enum {Channels = 13, MaxPayload = Channels * 5, RawRecordSize = 32};
+
+    static quint8 crc8(const QByteArray &, int, int);
+    static bool getVarint(const QByteArray &, int &, int, qint32 &);
+
+    bool bHaveKeyframe;
+    quint32 previous[Channels];
+
+    int decodedRecords;
+    int invalidFrameCount;
+    int skippedFrameCount;
+    qint64 encodedBytes;
+
+};
+
+
+#endif // TELEMETRY_DECODER_H
@@ -0,0 +1,405 @@
+/***************************************************************************
+acquisition_device.cpp:  Headless power module acquisition class functions
+
+Written by:
+    Sandra Mercer, P.Eng.
+    Engineer / Software Developer
+    eSonar Inc.
+
+Date:
+    November 2022
+
+Note(s):
+- One AcquisitionDevice per serial port. The port is owned by a
+SerialWorker in a thread of its own, as in the GUI, while the command
+queue, the parsing and the file writing for every device share the main
+event loop
+- Every pollMs the sensors are read through the CommandQueue. The answers
+fill one record, written when the queue is idle again. A record whose
+sensor did not answer keeps its FLAG_xxx_FAILED bit. A poll that comes
+while the previous one is still outstanding is skipped and counted as an
+overrun
+- With bStream set, "telemetry_stream 1" is sent after opening and each
+streamed record is written as it is decoded
+- The port is connected at a fixed baud rate. When it cannot be opened, or
+fails, it is closed and reopened every ReopenIntervalMs, so a board that
+is unplugged and plugged back in is picked up again
+****************************************************************************/
+
+
+#include <cstring>
+#include <QDateTime>
+#include <QDebug>
+#include <QSerialPort>
+#include <QThread>
+#include <QTimer>
+#include "acquisition_device.h"
+#include "command_queue.h"
+#include "response_stream.h"
+#include "serial_worker.h"
+
+
+/***************************************************************************
+AcquisitionDevice constructor
+****************************************************************************/
+AcquisitionDevice::AcquisitionDevice(const Config &config, QObject *parent)
+    : QObject(parent), config(config)
+{
+    bOpen = false;
+    bPolling = false;
+    polls = 0;
+    overruns = 0;
+    streamed = 0;
+    memset(&current, 0, sizeof(current));
+
+    // The worker has no parent so it can be moved, it is deleted with the thread
+    workerThread = new QThread(this);
+    worker = new SerialWorker;
+    worker->moveToThread(workerThread);
+    connect(workerThread, SIGNAL(finished()), worker, SLOT(deleteLater()));
+    workerThread->start();
+
+    commandQueue = new CommandQueue(this);
+    responseStream = new ResponseStream(commandQueue, &responseParser);
+    responseStream->setRecordHandler([this](const TelemetryRecord &record) {
+        writer.write(QDateTime::currentMSecsSinceEpoch(), record);
+        this->streamed++;
+    });
+    addResponseHandlers();
+
+    pollTimer = new QTimer(this);
+    pollTimer->setInterval(config.pollMs);
+
+    reopenTimer = new QTimer(this);
+    reopenTimer->setSingleShot(true);
+
+    clock.start();
+
+    // Connect the signals and slots
+    connect(worker, SIGNAL(signalError(int)), this, SLOT(slotError(int)));
+    connect(worker, SIGNAL(signalReceived()), this, SLOT(slotReceived()));
+    connect(commandQueue, SIGNAL(signalIdle()), this, SLOT(slotIdle()));
+    connect(commandQueue, SIGNAL(signalWrite(QString)), this, SLOT(slotWrite(QString)));
+    connect(pollTimer, SIGNAL(timeout()), this, SLOT(slotPoll()));
+    connect(reopenTimer, SIGNAL(timeout()), this, SLOT(slotReopen()));
+
+}   // End of AcquisitionDevice::AcquisitionDevice
+
+
+/***************************************************************************
+AcquisitionDevice destructor
+****************************************************************************/
+AcquisitionDevice::~AcquisitionDevice()
+{
+    close();
+
+    workerThread->quit();
+    workerThread->wait();
+
+    delete responseStream;
+
+}   // End of AcquisitionDevice::~AcquisitionDevice
+
+
+/***************************************************************************
+Function to register the handlers that fill the polled record, the values
+are scaled as in pm_log_record
+****************************************************************************/
+void AcquisitionDevice::addResponseHandlers(void)
+{
+    typedef ResponseParser::Tokens Tokens;
+
+    responseParser.addHandler("LEAK", [this](const Tokens &tokens) {
+        double value;
+        if (tokens.toDouble(1, value))
+        {
+            current.leakMv = quint16(qRound(value * 1000.0));
+            current.flags &= ~FLAG_LEAK_FAILED;
+        }
+    });
+
+    responseParser.addHandler("VOLTAGE", [this](const Tokens &tokens) {
+        double value;
+        if (tokens.toDouble(1, value))
+        {
+            current.batteryMv = quint16(qRound(value * 1000.0));
+            current.flags &= ~FLAG_LTC2944_FAILED;
+        }
+    });
+
+    responseParser.addHandler("CURRENT", [this](const Tokens &tokens) {
+        double value;
+        if (tokens.toDouble(1, value))
+            current.batteryMa = qint16(qRound(value * 1000.0));
+    });
+
+    responseParser.addHandler("CHARGE", [this](const Tokens &tokens) {
+        double value;
+        if (tokens.toDouble(1, value))
+            current.chargeMah = quint16(qRound(value));
+    });
+
+    // LTC2944 TEMPERATURE <value>
+    responseParser.addHandler("LTC2944", [this](const Tokens &tokens) {
+        double value;
+        if (tokens.is(1, "TEMPERATURE") && tokens.toDouble(2, value))
+            current.ltc2944Temperature = qint16(qRound(value * 100.0));
+    });
+
+    responseParser.addHandler("PRESSURE", [this](const Tokens &tokens) {
+        double value;
+        if (tokens.toDouble(1, value))
+        {
+            current.pressure = quint16(qRound(value * 10.0));
+            current.flags &= ~FLAG_MS5637_FAILED;
+        }
+    });
+
+    // MS5637
+    responseParser.addHandler("TEMPERATURE", [this](const Tokens &tokens) {
+        double value;
+        if (tokens.toDouble(1, value))
+            current.ms5637Temperature = qint16(qRound(value * 100.0));
+    });
+
+    // ACCEL TILT ANGLE <value>
+    responseParser.addHandler("ACCEL", [this](const Tokens &tokens) {
+        double value;
+        if (tokens.is(1, "TILT") && tokens.is(2, "ANGLE") && tokens.toDouble(3, value))
+        {
+            current.tilt = qint16(qRound(value * 100.0));
+            current.flags &= ~FLAG_MC3416_FAILED;
+        }
+    });
+
+    responseParser.addHandler("POWER", [this](const Tokens &tokens) {
+        int bits;
+        if (tokens.toInt(1, bits))
+            current.powerBits = quint16(bits);
+    });
+
+    responseParser.addHandler("STATUS_BITS", [this](const Tokens &tokens) {
+        int bits;
+        if (tokens.toInt(1, bits))
+            current.statusBits = quint8(bits);
+    });
+
+    responseParser.addHandler("LEAK_EVENT", [this](const Tokens &tokens) {
+        qWarning().noquote() << config.portName << "leak detected" << tokens.text(1) << "V";
+    });
+
+}   // End of AcquisitionDevice::addResponseHandlers
+
+
+/***************************************************************************
+Function to close the port, anything still queued or received is dropped
+****************************************************************************/
+void AcquisitionDevice::close(void)
+{
+    pollTimer->stop();
+
+    if (!bOpen)
+        return;
+
+    QMetaObject::invokeMethod(worker, "slotClose", Qt::BlockingQueuedConnection);
+    SerialWorker::Chunk chunk;
+    worker->acknowledge();
+    while (worker->takeChunk(chunk))
+        ;
+
+    commandQueue->clear();
+    responseStream->clear();
+    bOpen = false;
+    bPolling = false;
+
+}   // End of AcquisitionDevice::close
+
+
+/***************************************************************************
+Function to open the port and start polling
+
+Returns an empty string, or the error
+****************************************************************************/
+QString AcquisitionDevice::open(void)
+{
+    QString error;
+    QMetaObject::invokeMethod(worker, "slotOpen", Qt::BlockingQueuedConnection, Q_RETURN_ARG(QString, error),
+                              Q_ARG(QString, config.portName), Q_ARG(qint32, config.baudRate),
+                              Q_ARG(int, QSerialPort::Data8), Q_ARG(int, QSerialPort::NoParity),
+                              Q_ARG(int, QSerialPort::OneStop), Q_ARG(int, QSerialPort::NoFlowControl));
+    if (!error.isEmpty())
+        return (error);
+
+    qDebug() << "AcquisitionDevice::open:" << config.portName << config.baudRate;
+
+    bOpen = true;
+    bPolling = false;
+    responseStream->clear();
+
+    if (config.bStream)
+    {
+        responseStream->decoder().reset();
+        commandQueue->enqueue("telemetry_stream 1", CommandQueue::PRIORITY_CONTROL);
+    }
+
+    pollTimer->start();
+    slotPoll();
+
+    return (QString());
+
+}   // End of AcquisitionDevice::open
+
+
+/***************************************************************************
+Function to create the record file and open the port. A port that cannot
+be opened yet is retried, only a file error is returned
+
+Returns an empty string, or the error
+****************************************************************************/
+QString AcquisitionDevice::start(void)
+{
+    QString error = writer.open(config.fileName, config.format);
+    if (!error.isEmpty())
+        return (error);
+
+    error = open();
+    if (!error.isEmpty())
+    {
+        qWarning().noquote() << config.portName << error << "- retrying";
+        reopenTimer->start(ReopenIntervalMs);
+    }
+
+    return (QString());
+
+}   // End of AcquisitionDevice::start
+
+
+/***************************************************************************
+Function to return a one line summary for the console
+****************************************************************************/
+QString AcquisitionDevice::status(void) const
+{
+    return (QString("%1 %2: %3 polls, %4 overruns, %5 streamed, %6 records, %7 timeouts, rtt %8 ms")
+            .arg(config.portName).arg(bOpen ? "open" : "closed")
+            .arg(polls).arg(overruns).arg(streamed).arg(writer.records())
+            .arg(commandQueue->timeouts()).arg(commandQueue->averageRttMs(), 0, 'f', 1));
+
+}   // End of AcquisitionDevice::status
+
+
+/***************************************************************************
+Slot to handle a port error. Errors that leave the port usable are only
+logged, a pseudo terminal cannot set DTR for one
+****************************************************************************/
+void AcquisitionDevice::slotError(int error)
+{
+    switch (error)
+    {
+    case QSerialPort::NoError:
+        return;
+    case QSerialPort::FramingError:
+    case QSerialPort::ParityError:
+    case QSerialPort::TimeoutError:
+    case QSerialPort::UnsupportedOperationError:
+        qDebug() << "AcquisitionDevice::slotError:" << config.portName << error;
+        return;
+    default:
+        break;
+    }
+
+    qWarning().noquote() << config.portName << "port error" << error << "- reopening";
+
+    close();
+    reopenTimer->start(ReopenIntervalMs);
+
+}   // End of AcquisitionDevice::slotError
+
+
+/***************************************************************************
+Slot to write the polled record once every read has been answered
+****************************************************************************/
+void AcquisitionDevice::slotIdle(void)
+{
+    if (!bPolling)
+        return;
+
+    bPolling = false;
+    writer.write(QDateTime::currentMSecsSinceEpoch(), current);
+
+}   // End of AcquisitionDevice::slotIdle
+
+
+/***************************************************************************
+Slot to start reading the sensors, unless the last poll is outstanding
+****************************************************************************/
+void AcquisitionDevice::slotPoll(void)
+{
+    if (!bOpen)
+        return;
+
+    if (bPolling)
+    {
+        overruns++;
+        return;
+    }
+
+    memset(&current, 0, sizeof(current));
+    current.sequence = polls++;
+    current.timestampMs = quint32(clock.elapsed());
+    current.flags = FLAG_ALL_FAILED;
+    bPolling = true;
+
+    commandQueue->enqueue("read_leak", CommandQueue::PRIORITY_REFRESH);
+    commandQueue->enqueue("read_ltc2944", CommandQueue::PRIORITY_REFRESH);
+    commandQueue->enqueue("read_ms5637", CommandQueue::PRIORITY_REFRESH);
+    commandQueue->enqueue("read_power_bits", CommandQueue::PRIORITY_REFRESH);
+    commandQueue->enqueue("read_status_bits", CommandQueue::PRIORITY_REFRESH);
+    commandQueue->enqueue("read_mc3416", CommandQueue::PRIORITY_REFRESH);
+
+}   // End of AcquisitionDevice::slotPoll
+
+
+/***************************************************************************
+Slot to take the received chunks from the worker
+****************************************************************************/
+void AcquisitionDevice::slotReceived(void)
+{
+    SerialWorker::Chunk chunk;
+
+    // Acknowledged first, so a chunk queued while draining signals again
+    worker->acknowledge();
+    while (worker->takeChunk(chunk))
+    {
+        if (bOpen)
+            responseStream->append(chunk.data);
+    }
+
+}   // End of AcquisitionDevice::slotReceived
+
+
+/***************************************************************************
+Slot to try the port again
+****************************************************************************/
+void AcquisitionDevice::slotReopen(void)
+{
+    QString error = open();
+    if (!error.isEmpty())
+    {
+        qDebug() << "AcquisitionDevice::slotReopen:" << config.portName << error;
+        reopenTimer->start(ReopenIntervalMs);
+    }
+    else
+        qWarning().noquote() << config.portName << "reopened";
+
+}   // End of AcquisitionDevice::slotReopen
+
+
+/***************************************************************************
+Slot to pass a request from the command queue to the worker
+****************************************************************************/
+void AcquisitionDevice::slotWrite(QString command)
+{
+    if (bOpen)
+        QMetaObject::invokeMethod(worker, "slotWrite", Qt::QueuedConnection, Q_ARG(QByteArray, command.toLatin1()));
+
+}   // End of AcquisitionDevice::slotWrite
@@ -0,0 +1,100 @@
+/***************************************************************************
+acquisition_device.h: Include file for acquisition_device.cpp
+
+Written by:
+    Sandra Mercer, P.Eng.
+    Engineer / Software Developer
+    eSonar Inc.
+
+Date:
+    November 2022
+****************************************************************************/
+
+
+#ifndef ACQUISITION_DEVICE_H
+#define ACQUISITION_DEVICE_H
+
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QString>
+#include "record_writer.h"
+#include "response_parser.h"
+#include "telemetry_decoder.h"
+
+
+class CommandQueue;
+class QThread;
+class QTimer;
+class ResponseStream;
+class SerialWorker;
+
+
+class AcquisitionDevice : public QObject
+{
+    Q_OBJECT
+
+public:
+
+    struct Config
+    {
+        QString portName;
+        qint32 baudRate;
+        int pollMs;
+        bool bStream;
+        QString fileName;
+        RecordWriter::formatEnum format;
+    };
+
+    static const int ReopenIntervalMs = 5000;
+
+    explicit AcquisitionDevice(const Config &, QObject *parent = nullptr);
+    ~AcquisitionDevice();
+
+    QString start(void);
+    QString status(void) const;
+
+private slots:
+
+    void slotError(int);
+    void slotIdle(void);
+    void slotPoll(void);
+    void slotReceived(void);
+    void slotReopen(void);
+    void slotWrite(QString);
+
+private:
+
+    // pm_log_record.flags bits, set until the sensor has answered
+    enum flagEnum {FLAG_LEAK_FAILED = 0x01, FLAG_LTC2944_FAILED = 0x02,
+                   FLAG_MS5637_FAILED = 0x04, FLAG_MC3416_FAILED = 0x08,
+                   FLAG_ALL_FAILED = 0x0f};
+
+    void addResponseHandlers(void);
+    void close(void);
+    QString open(void);
+
+    Config config;
+    bool bOpen;
+    bool bPolling;
+
+    QThread *workerThread;
+    SerialWorker *worker;
+    CommandQueue *commandQueue;
+    ResponseParser responseParser;
+    ResponseStream *responseStream;
+    RecordWriter writer;
+
+    QTimer *pollTimer;
+    QTimer *reopenTimer;
+
+    QElapsedTimer clock;
+    TelemetryRecord current;
+    quint32 polls;
+    quint32 overruns;
+    quint32 streamed;
+
+};
+
+
+#endif // ACQUISITION_DEVICE_H
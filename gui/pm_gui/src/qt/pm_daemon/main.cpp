@@ -0,0 +1,195 @@
+/***************************************************************************
+main.cpp:  Marine Mammal Detection Power Module acquisition daemon main
+function
+
+Written by:
+    Sandra Mercer, P.Eng.
+    Engineer / Software Developer
+    eSonar Inc.
+
+Date:
+    November 2022
+
+Note(s):
+- pm_daemon [options] <port>[:<baud>[:<poll ms>]] ...
+- Each port gets its own AcquisitionDevice and record file in the output
+directory, <port>_<yyyyMMdd_hhmmss>.csv or .pmrec, or a .pmstore series
+store directory. A port may be a COM
+port or a device path, such as a pseudo terminal, or a pm_broker endpoint
+(tcp://<host>:<port> or local:<name>), which takes the default baud rate
+and poll period
+- A summary of every device is printed every --status seconds. The daemon
+runs until it is interrupted, or for --duration seconds
+****************************************************************************/
+
+
+#include <csignal>
+#include <cstdio>
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDir>
+#include <QTimer>
+#include "acquisition_device.h"
+#include "serial_worker.h"
+
+
+// Local variable(s)
+static bool bVerbose = false;
+
+
+// Local function(s)
+static void messageHandler(QtMsgType, const QMessageLogContext &, const QString &);
+static void signalHandler(int);
+
+
+/***************************************************************************
+Local function to print the Qt messages, the qDebug() traces of the core
+only with --verbose
+****************************************************************************/
+static void messageHandler(QtMsgType type, const QMessageLogContext &, const QString &message)
+{
+    if (type == QtDebugMsg && !bVerbose)
+        return;
+
+    fprintf(stderr, "%s %s\n", qPrintable(QDateTime::currentDateTime().toString(Qt::ISODate)), qPrintable(message));
+    fflush(stderr);
+
+}   // End of messageHandler
+
+
+/***************************************************************************
+Local function to stop the event loop on Ctrl+C, so the record files are
+closed properly
+****************************************************************************/
+static void signalHandler(int)
+{
+    QCoreApplication::quit();
+
+}   // End of signalHandler
+
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QCoreApplication::setApplicationName("pm_daemon");
+    QCoreApplication::setApplicationVersion(PM_VERSION);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Polls power modules on several serial ports and records their readings");
+    parser.addHelpOption();
+    parser.addVersionOption();
+
+    QCommandLineOption outputOption(QStringList() << "o" << "output", "Directory for the record files.", "directory", ".");
+    QCommandLineOption formatOption(QStringList() << "f" << "format", "Record file format, csv, binary or store.", "format", "csv");
+    QCommandLineOption baudOption(QStringList() << "b" << "baud", "Default baud rate.", "baud", "38400");
+    QCommandLineOption pollOption(QStringList() << "p" << "poll", "Default poll period in ms.", "ms", "1000");
+    QCommandLineOption streamOption(QStringList() << "s" << "stream", "Also record the streamed telemetry.");
+    QCommandLineOption statusOption("status", "Seconds between summaries, 0 for none.", "seconds", "10");
+    QCommandLineOption durationOption("duration", "Seconds to run, 0 to run until interrupted.", "seconds", "0");
+    QCommandLineOption verboseOption(QStringList() << "v" << "verbose", "Print the protocol traces.");
+    parser.addOption(outputOption);
+    parser.addOption(formatOption);
+    parser.addOption(baudOption);
+    parser.addOption(pollOption);
+    parser.addOption(streamOption);
+    parser.addOption(statusOption);
+    parser.addOption(durationOption);
+    parser.addOption(verboseOption);
+    parser.addPositionalArgument("ports", "Serial ports, <port>[:<baud>[:<poll ms>]].", "<port> ...");
+    parser.process(a);
+
+    bVerbose = parser.isSet(verboseOption);
+    qInstallMessageHandler(messageHandler);
+
+    if (parser.positionalArguments().isEmpty())
+        parser.showHelp(1);
+
+    QString format = parser.value(formatOption).toLower();
+    if (format != "csv" && format != "binary" && format != "store")
+    {
+        qCritical() << "Unknown format" << format;
+        return (1);
+    }
+
+    QDir outputDir(parser.value(outputOption));
+    if (!outputDir.mkpath("."))
+    {
+        qCritical() << "Could not create" << outputDir.path();
+        return (1);
+    }
+
+    QString started = QDateTime::currentDateTime().toString("yyyyMMdd_hhmmss");
+    QList<AcquisitionDevice *> devices;
+
+    for (const QString &argument : parser.positionalArguments())
+    {
+        QStringList fields = SerialWorker::isBrokerEndpoint(argument) ? QStringList(argument) : argument.split(':');
+        AcquisitionDevice::Config config;
+        bool bOk = true;
+
+        config.portName = fields.at(0);
+        config.baudRate = (fields.size() > 1 && !fields.at(1).isEmpty()) ? fields.at(1).toInt(&bOk)
+                                                                        : parser.value(baudOption).toInt(&bOk);
+        if (bOk)
+            config.pollMs = (fields.size() > 2) ? fields.at(2).toInt(&bOk) : parser.value(pollOption).toInt(&bOk);
+        if (!bOk || config.portName.isEmpty() || config.baudRate <= 0 || config.pollMs <= 0)
+        {
+            qCritical() << "Bad port" << argument;
+            return (1);
+        }
+
+        config.bStream = parser.isSet(streamOption);
+        config.format = (format == "csv") ? RecordWriter::CSV : (format == "binary") ? RecordWriter::BINARY : RecordWriter::STORE;
+
+        // /dev/pts/3 -> pts_3, tcp://127.0.0.1:5760 -> tcp_127.0.0.1_5760
+        QString name = config.portName;
+        if (name.startsWith("/dev/"))
+            name.remove(0, 5);
+        name.replace("://", "_");
+        name.replace('/', '_');
+        name.replace(':', '_');
+        config.fileName = outputDir.filePath(QString("%1_%2.%3").arg(name).arg(started)
+                                             .arg((format == "csv") ? "csv" : (format == "binary") ? "pmrec" : "pmstore"));
+
+        AcquisitionDevice *device = new AcquisitionDevice(config);
+        QString error = device->start();
+        if (!error.isEmpty())
+        {
+            qCritical().noquote() << error;
+            delete device;
+            qDeleteAll(devices);
+            return (1);
+        }
+        devices.append(device);
+
+        qWarning().noquote() << "Recording" << config.portName << "to" << config.fileName;
+    }
+
+    QTimer statusTimer;
+    int statusSeconds = parser.value(statusOption).toInt();
+    if (statusSeconds > 0)
+    {
+        QObject::connect(&statusTimer, &QTimer::timeout, [&devices]() {
+            for (const AcquisitionDevice *device : devices)
+                qWarning().noquote() << device->status();
+        });
+        statusTimer.start(statusSeconds * 1000);
+    }
+
+    int durationSeconds = parser.value(durationOption).toInt();
+    if (durationSeconds > 0)
+        QTimer::singleShot(durationSeconds * 1000, &a, SLOT(quit()));
+
+    std::signal(SIGINT, signalHandler);
+    std::signal(SIGTERM, signalHandler);
+
+    int result = a.exec();
+
+    for (const AcquisitionDevice *device : devices)
+        qWarning().noquote() << device->status();
+    qDeleteAll(devices);
+
+    return (result);
+
+}   // End of main
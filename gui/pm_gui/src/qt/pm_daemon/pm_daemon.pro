@@ -0,0 +1,18 @@
+QT       += core
+QT       -= gui
+
+CONFIG += c++11 console
+CONFIG -= app_bundle
+
+TARGET = pm_daemon
+
+SOURCES += \
+    acquisition_device.cpp \
+    main.cpp \
+    record_writer.cpp
+
+HEADERS += \
+    acquisition_device.h \
+    record_writer.h
+
+include(../pm_core/pm_core.pri)
@@ -0,0 +1,206 @@
+/***************************************************************************
+record_writer.cpp:  Acquisition record file class functions
+
+Written by:
+    Sandra Mercer, P.Eng.
+    Engineer / Software Developer
+    eSonar Inc.
+
+Date:
+    November 2022
+
+Note(s):
+- One file per device. A CSV file has the columns of the GUI's log
+download with the host time in front, a binary file has fixed length
+records (see RecordFile) for long runs
+- STORE writes a SeriesWriter store directory instead, one series per
+reading named after its CSV column, which the GUI can browse by time
+without loading it. A reading whose sensor failed is left out rather than
+stored as 0
+- The files are only appended to and written through about once a second,
+so a daemon that is killed loses at most the last second
+****************************************************************************/
+
+
+#include <cstring>
+#include <QDateTime>
+#include <QDebug>
+#include <QtEndian>
+#include "record_writer.h"
+
+
+// Store series, in the order of the values in RecordWriter::write()
+static const char *const storeChannels[] = {"leak_v", "battery_v", "battery_a", "ltc2944_temperature",
+                                            "charge_mah", "pressure_mbar", "ms5637_temperature", "tilt"};
+static const int StoreChannels = int(sizeof(storeChannels) / sizeof(storeChannels[0]));
+
+
+/***************************************************************************
+RecordWriter destructor
+****************************************************************************/
+RecordWriter::~RecordWriter()
+{
+    close();
+
+}   // End of RecordWriter::~RecordWriter
+
+
+/***************************************************************************
+Function to create a record file and write its header
+
+Returns an empty string, or the error
+****************************************************************************/
+QString RecordWriter::open(const QString &fileName, formatEnum format)
+{
+    close();
+
+    this->format = format;
+    recordCount = 0;
+
+    if (format == STORE)
+    {
+        QString error = store.open(fileName);
+        for (int i = 0; i < StoreChannels && error.isEmpty(); i++)
+            error = store.addChannel(storeChannels[i]);
+        if (!error.isEmpty())
+            store.close();
+        return (error);
+    }
+
+    file.setFileName(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return (QString("Could not create %1: %2").arg(fileName).arg(file.errorString()));
+
+    if (format == CSV)
+    {
+        file.write("host_time,sequence,timestamp_ms,leak_v,battery_v,battery_a,ltc2944_temperature,charge_mah,"
+                   "pressure_mbar,ms5637_temperature,tilt,power_bits,status_bits,flags\n");
+    }
+    else
+    {
+        uchar header[RecordFile::HeaderLength];
+        memcpy(header, RecordFile::Magic, sizeof(RecordFile::Magic));
+        qToLittleEndian<quint32>(RecordFile::Version, header + 8);
+        qToLittleEndian<quint32>(0, header + 12);
+        file.write(reinterpret_cast<const char *>(header), sizeof(header));
+    }
+
+    file.flush();
+    flushElapsed.start();
+
+    return (QString());
+
+}   // End of RecordWriter::open
+
+
+/***************************************************************************
+Function to write out the buffered records and close the file
+****************************************************************************/
+void RecordWriter::close(void)
+{
+    store.close();
+
+    if (!file.isOpen())
+        return;
+
+    qDebug() << "RecordWriter::close:" << file.fileName() << recordCount << "records";
+
+    file.close();
+
+}   // End of RecordWriter::close
+
+
+/***************************************************************************
+Function to append a record, timed by the host
+****************************************************************************/
+void RecordWriter::write(qint64 hostTimeMs, const TelemetryRecord &record)
+{
+    if (format == STORE)
+    {
+        float values[StoreChannels] = {record.leakMv / 1000.0f, record.batteryMv / 1000.0f, record.batteryMa / 1000.0f,
+                                       record.ltc2944Temperature / 100.0f, float(record.chargeMah),
+                                       record.pressure / 10.0f, record.ms5637Temperature / 100.0f, record.tilt / 100.0f};
+
+        // LOG_FLAG_xxx_FAILED in pm_logger.h: leak, LTC2944, MS5637, MC3416
+        quint8 failed[StoreChannels] = {0x01, 0x02, 0x02, 0x02, 0x02, 0x04, 0x04, 0x08};
+
+        if (store.directory().isEmpty())
+            return;
+        for (int i = 0; i < StoreChannels; i++)
+        {
+            if (!(record.flags & failed[i]))
+                store.append(i, hostTimeMs, values[i]);
+        }
+        recordCount++;
+        return;
+    }
+
+    if (!file.isOpen())
+        return;
+
+    if (format == CSV)
+    {
+        QString line = QString("%1,%2,%3,%4,%5,%6,%7,%8,%9,%10,%11,%12,%13,%14\n")
+                .arg(QDateTime::fromMSecsSinceEpoch(hostTimeMs, Qt::UTC).toString(Qt::ISODateWithMs))
+                .arg(record.sequence)
+                .arg(record.timestampMs)
+                .arg(record.leakMv / 1000.0, 0, 'f', 3)
+                .arg(record.batteryMv / 1000.0, 0, 'f', 3)
+                .arg(record.batteryMa / 1000.0, 0, 'f', 3)
+                .arg(record.ltc2944Temperature / 100.0, 0, 'f', 2)
+                .arg(record.chargeMah)
+                .arg(record.pressure / 10.0, 0, 'f', 1)
+                .arg(record.ms5637Temperature / 100.0, 0, 'f', 2)
+                .arg(record.tilt / 100.0, 0, 'f', 2)
+                .arg(QString("0x%1").arg(record.powerBits, 3, 16, QChar('0')))
+                .arg(QString("0x%1").arg(record.statusBits, 2, 16, QChar('0')))
+                .arg(record.flags);
+        file.write(line.toLatin1());
+    }
+    else
+    {
+        uchar buffer[RecordFile::RecordLength];
+        qToLittleEndian<qint64>(hostTimeMs, buffer);
+        qToLittleEndian<quint32>(record.sequence, buffer + 8);
+        qToLittleEndian<quint32>(record.timestampMs, buffer + 12);
+        qToLittleEndian<quint16>(record.leakMv, buffer + 16);
+        qToLittleEndian<quint16>(record.batteryMv, buffer + 18);
+        qToLittleEndian<qint16>(record.batteryMa, buffer + 20);
+        qToLittleEndian<qint16>(record.ltc2944Temperature, buffer + 22);
+        qToLittleEndian<quint16>(record.chargeMah, buffer + 24);
+        qToLittleEndian<quint16>(record.pressure, buffer + 26);
+        qToLittleEndian<qint16>(record.ms5637Temperature, buffer + 28);
+        qToLittleEndian<qint16>(record.tilt, buffer + 30);
+        qToLittleEndian<quint16>(record.powerBits, buffer + 32);
+        buffer[34] = record.statusBits;
+        buffer[35] = record.flags;
+        qToLittleEndian<quint32>(0, buffer + 36);
+        file.write(reinterpret_cast<const char *>(buffer), sizeof(buffer));
+    }
+
+    recordCount++;
+
+    if (flushElapsed.elapsed() >= FlushIntervalMs)
+    {
+        file.flush();
+        flushElapsed.restart();
+    }
+
+}   // End of RecordWriter::write
+
+
+/***************************************************************************
+Functions to return the file name and the number of records written
+****************************************************************************/
+QString RecordWriter::fileName(void) const
+{
+    return ((format == STORE) ? store.directory() : file.fileName());
+
+}   // End of RecordWriter::fileName
+
+
+qint64 RecordWriter::records(void) const
+{
+    return (recordCount);
+
+}   // End of RecordWriter::records
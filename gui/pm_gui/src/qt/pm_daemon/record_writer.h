@@ -0,0 +1,70 @@
+/***************************************************************************
+record_writer.h: Include file for record_writer.cpp
+
+Written by:
+    Sandra Mercer, P.Eng.
+    Engineer / Software Developer
+    eSonar Inc.
+
+Date:
+    November 2022
+****************************************************************************/
+
+
+#ifndef RECORD_WRITER_H
+#define RECORD_WRITER_H
+
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QString>
+#include "series_writer.h"
+#include "telemetry_decoder.h"
+
+
+// Binary record file layout, all fields little endian
+//
+//   Header:  char magic[8] "PMRECORD", quint32 version, quint32 reserved
+//   Record:  qint64 host time (ms since the epoch, UTC), then the
+//            TelemetryRecord fields in order, 40 bytes in all
+namespace RecordFile
+{
+    const char Magic[8] = {'P', 'M', 'R', 'E', 'C', 'O', 'R', 'D'};
+    const quint32 Version = 1;
+    const int HeaderLength = 16;
+    const int RecordLength = 40;
+}
+
+
+class RecordWriter
+{
+
+public:
+
+    enum formatEnum {CSV, BINARY, STORE};
+
+    // A record more than this long after the last write through is written
+    // through with everything buffered before it
+    static const int FlushIntervalMs = 1000;
+
+    ~RecordWriter();
+
+    QString open(const QString &, formatEnum);
+    void close(void);
+    void write(qint64, const TelemetryRecord &);
+
+    QString fileName(void) const;
+    qint64 records(void) const;
+
+private:
+
+    QFile file;
+    SeriesWriter store;
+    formatEnum format = CSV;
+    qint64 recordCount = 0;
+    QElapsedTimer flushElapsed;
+
+};
+
+
+#endif // RECORD_WRITER_H
@@ -12,12 +12,22 @@ Date:
 Note(s):
 - The Marine Mammal Detection Power Module GUI Widget is the main widget for
 the application.
+- Commands go through the CommandQueue, one outstanding at a time. Power and
+telemetry controls are sent ahead of the Read Settings refresh
+- Received data is split by the ResponseStream (pm_core). Responses are
+dispatched on their first word by the ResponseParser, the handlers are
+registered in addResponseHandlers()
+- Readings and streamed telemetry records are also added to the trend
+chart, log downloads are not. Open Store shows a pm_daemon series store
+in the chart instead, until Live
 ****************************************************************************/
 
 
 #include <QBoxLayout>
+#include <QCheckBox>
 #include <QDebug>
 #include <QFile>
+#include <QFileDialog>
 #include <QGroupBox>
 #include <QLabel>
 #include <QLineEdit>
@@ -25,11 +35,14 @@ the application.
 #include <QMenuBar>
 #include <QMessageBox>
 #include <QPushButton>
+#include <QTextStream>
 #include <QTimer>
+#include "command_queue.h"
 #include "digital_input.h"
 #include "digital_output.h"
 #include "pm_gui.h"
 #include "serial.h"
+#include "trend_chart.h"
 
 
 // Local function(s)
@@ -51,6 +64,208 @@ QString getDegreeSymbol(void)
 }   // End of getDegreeSymbol()
 
 
+/***************************************************************************
+Function to register the handlers of the power module responses, keyed on
+the first word of the response
+****************************************************************************/
+void Widget::addResponseHandlers(void)
+{
+    typedef ResponseParser::Tokens Tokens;
+
+    // Output echoes, "<pin> <0|1> VALID". An output held by an interlock
+    // answers "unchanged" after a line with its level, and one changed during
+    // a power profile transition "busy"
+    struct {const char *key; DigitalOutput *output;} outputs[] =
+    {
+        {"+3V3VA_EN", en_3v3va}, {"BATT_SEL", batt_sel}, {"DRIVER_EN", driver_en},
+        {"Main_PWR_EN", mmd_pwr_en}, {"MMD_PWR_EN", mmd_pwr_en}, {"VBS_PWR_EN", vbs_pwr_en},
+        {"VBS_SER_PWR_EN", vbs_ser_pwr_en}, {"WCM_DIAG_EN", wcm_diag_en},
+        {"WCM_PWR_EN", wcm_pwr_en}, {"WCM_RLY", wcm_rly}
+    };
+    for (const auto &entry : outputs)
+    {
+        DigitalOutput *output = entry.output;
+        responseParser.addHandler(entry.key, [output](const Tokens &tokens) {
+            int bit_val;
+            if (tokens.toInt(1, bit_val))
+                output->setChecked((bit_val == 1) ? true : false);
+        });
+    }
+
+    // Input reports from firmware older than STATUS_BITS
+    struct {const char *key; DigitalInput *input;} inputs[] =
+    {
+        {"/ACCEL_INT", n_accel_int}, {"EXT_GPIO1", ext_gpio1}, {"EXT_GPIO2", ext_gpio2},
+        {"LT8618_PG", lt8618_pg}, {"/LTC2944_ALCC", n_ltc2944_alcc}, {"/WCM_FAULT", n_wcm_fault}
+    };
+    for (const auto &entry : inputs)
+    {
+        DigitalInput *input = entry.input;
+        responseParser.addHandler(entry.key, [input](const Tokens &tokens) {
+            int bit_val;
+            if (tokens.toInt(1, bit_val))
+                input->setColor(QString((bit_val == 1) ? "True" : "False"));
+        });
+    }
+
+    // Readings shown with a fixed number of decimals, "<key> <value>", and
+    // the trend they are added to, if any
+    struct {const char *key; QLineEdit *lineEdit; int decimals; int trend;} readings[] =
+    {
+        {"LEAK", leakVoltageLineEdit, 3, TREND_LEAK}, {"VOLTAGE", voltageLineEdit, 3, TREND_VOLTAGE},
+        {"CURRENT", currentLineEdit, 3, TREND_CURRENT}, {"CHARGE", chargeLineEdit, 2, -1},
+        {"TEMPERATURE", ms5637TemperatureLineEdit, 2, -1}
+    };
+    for (const auto &entry : readings)
+    {
+        QLineEdit *lineEdit = entry.lineEdit;
+        int decimals = entry.decimals;
+        int trend = entry.trend;
+        responseParser.addHandler(entry.key, [this, lineEdit, decimals, trend](const Tokens &tokens) {
+            double value;
+            if (tokens.toDouble(1, value))
+            {
+                lineEdit->setText(QString::number(value, 'f', decimals));
+                trendChart->addSample(trend, value);
+            }
+        });
+    }
+
+    // MS5637 PROM and conversions, "<key> <integer>"
+    struct {const char *key; QLineEdit *lineEdit;} integers[] =
+    {
+        {"CRC", cLineEditList.at(0)}, {"C1", cLineEditList.at(1)}, {"C2", cLineEditList.at(2)},
+        {"C3", cLineEditList.at(3)}, {"C4", cLineEditList.at(4)}, {"C5", cLineEditList.at(5)},
+        {"C6", cLineEditList.at(6)}, {"D1", d1LineEdit}, {"D2", d2LineEdit}
+    };
+    for (const auto &entry : integers)
+    {
+        QLineEdit *lineEdit = entry.lineEdit;
+        responseParser.addHandler(entry.key, [lineEdit](const Tokens &tokens) {
+            int value;
+            if (tokens.toInt(1, value))
+                lineEdit->setText(QString::number(value));
+        });
+    }
+
+    responseParser.addHandler("PRESSURE", [this](const Tokens &tokens) {
+        double value;
+        if (tokens.toDouble(1, value))
+        {
+            ms5637pressureLineEdit->setText(QString("%1").arg(value));
+            trendChart->addSample(TREND_PRESSURE, value);
+        }
+    });
+
+    responseParser.addHandler("STATUS", [this](const Tokens &tokens) {
+        if (tokens.count() > 1)
+            statusLineEdit->setText(tokens.text(1));
+    });
+
+    // LTC2944 TEMPERATURE <value>
+    responseParser.addHandler("LTC2944", [this](const Tokens &tokens) {
+        double value;
+        if (tokens.is(1, "TEMPERATURE") && tokens.toDouble(2, value))
+            ltc2944TemperatureLineEdit->setText(QString::number(value, 'f', 2));
+    });
+
+    // ACCEL TILT ANGLE <value>
+    responseParser.addHandler("ACCEL", [this](const Tokens &tokens) {
+        double value;
+        if (tokens.is(1, "TILT") && tokens.is(2, "ANGLE") && tokens.toDouble(3, value))
+        {
+            mc3416AngleLineEdit->setText(QString::number(value, 'f', 2));
+            trendChart->addSample(TREND_ANGLE, value);
+        }
+    });
+
+    // POWER 0x<PM_POWER_BIT_xxx>
+    responseParser.addHandler("POWER", [this](const Tokens &tokens) {
+        int power_bits;
+        if (tokens.toInt(1, power_bits))
+            setPowerBits(power_bits);
+    });
+
+    // STATUS_BITS 0x<PM_STATUS_BIT_xxx>
+    responseParser.addHandler("STATUS_BITS", [this](const Tokens &tokens) {
+        int status_bits;
+        if (tokens.toInt(1, status_bits))
+            setStatusBits(status_bits);
+    });
+
+    // Unsolicited, sent when the leak detector crosses its threshold
+    responseParser.addHandler("LEAK_EVENT", [this](const Tokens &tokens) {
+        double value;
+        if (!tokens.toDouble(1, value))
+            return;
+
+        leakVoltageLineEdit->setText(QString::number(value, 'f', 3));
+        leakVoltageLineEdit->setStyleSheet("background-color: red");
+
+        // Not modal, more data may arrive while it is shown
+        QMessageBox *messageBox = new QMessageBox(QMessageBox::Warning, "MMD Power Module",
+                                                  QString("Leak detected (%1 V)").arg(tokens.text(1)), QMessageBox::Ok, this);
+        messageBox->setAttribute(Qt::WA_DeleteOnClose);
+        messageBox->show();
+    });
+
+    responseParser.addHandler("LEAK_CLEAR", [this](const Tokens &tokens) {
+        double value;
+        if (tokens.toDouble(1, value))
+        {
+            leakVoltageLineEdit->setText(QString::number(value, 'f', 3));
+            leakVoltageLineEdit->setStyleSheet("");
+        }
+    });
+
+    // LOG_ZDUMP <first> <count> <bytes>, before each block of frames up to LOG_END.
+    // The deltas carry on from one block to the next
+    responseParser.addHandler("LOG_ZDUMP", [this](const Tokens &tokens) {
+        int count;
+        if (tokens.count() > 3 && tokens.toInt(2, count))
+        {
+            if (!bDownloadingLog)
+            {
+                logRecords.clear();
+                logRecordsExpected = 0;
+                responseStream->decoder().reset();
+                bDownloadingLog = true;
+            }
+            logRecordsExpected += count;
+        }
+    });
+
+    // LOG_END <next>
+    responseParser.addHandler("LOG_END", [this](const Tokens &) {
+        if (!bDownloadingLog)
+            return;
+
+        bDownloadingLog = false;
+
+        QString message = QString("Downloaded %1 of %2 records, compression ratio %3:1")
+                .arg(logRecords.size()).arg(logRecordsExpected)
+                .arg(responseStream->decoder().compressionRatio(), 0, 'f', 2);
+        if (responseStream->decoder().invalidFrames() != 0 || responseStream->decoder().skippedFrames() != 0)
+            message += QString("\n%1 bad frames, %2 frames skipped waiting for a keyframe")
+                    .arg(responseStream->decoder().invalidFrames()).arg(responseStream->decoder().skippedFrames());
+        qDebug() << "Widget::slotDataRead:" << message;
+        QMessageBox::information(this, "MMD Power Module", message);
+
+        if (!logRecords.isEmpty())
+            saveLogRecords();
+    });
+
+    // TELEMETRY <DUMP|STREAM> <records> <raw> <encoded> <ratio> <cycles/record>
+    responseParser.addHandler("TELEMETRY", [](const Tokens &tokens) {
+        QStringList list;
+        for (int i = 1; i < tokens.count(); i++)
+            list.append(tokens.text(i));
+        qDebug() << "Widget::slotDataRead: telemetry statistics" << list.join(' ');
+    });
+
+}   // End of Widget::addResponseHandlers
+
+
 /***************************************************************************
 Function to create the GUI controls required to control the power digital
 outputs
@@ -346,6 +561,48 @@ QGroupBox *Widget::createStatusGroupBox(void)
 }   // End of Widget::createStatusGroupBox
 
 
+/***************************************************************************
+Function to create the trend chart of the sensor readings
+****************************************************************************/
+QGroupBox *Widget::createTrendGroupBox(void)
+{
+    qDebug() << "Widget::createTrendGroupBox";
+
+    // Create the GUI controls
+    QGroupBox *groupBox = new QGroupBox("Trends");
+
+    // Added in trendEnum order
+    trendChart = new TrendChart;
+    trendChart->addChannel("Leak Detector", "V", QColor(0, 114, 189), 3);
+    trendChart->addChannel("Battery Voltage", "V", QColor(217, 83, 25), 3);
+    trendChart->addChannel("Battery Current", "A", QColor(237, 177, 32), 3);
+    trendChart->addChannel("Pressure", "mbar", QColor(126, 47, 142), 1);
+    trendChart->addChannel("Angle", "rad", QColor(119, 172, 48), 2);
+
+    QPushButton *openStoreButton = new QPushButton("Open Store...");
+    liveTrendsButton = new QPushButton("Live");
+    liveTrendsButton->setEnabled(false);
+
+    // Create the layout
+    QHBoxLayout *buttonLayout = new QHBoxLayout;
+    buttonLayout->addWidget(openStoreButton);
+    buttonLayout->addWidget(liveTrendsButton);
+    buttonLayout->addStretch();
+
+    QVBoxLayout *layout = new QVBoxLayout;
+    layout->addWidget(trendChart);
+    layout->addLayout(buttonLayout);
+    groupBox->setLayout(layout);
+
+    // Connect the signals and slots
+    connect(openStoreButton, SIGNAL(clicked()), this, SLOT(slotOpenStore()));
+    connect(liveTrendsButton, SIGNAL(clicked()), this, SLOT(slotShowLiveTrends()));
+
+    return (groupBox);
+
+}   // End of Widget::createTrendGroupBox
+
+
 /***************************************************************************
 Function to get the power module settings
 ****************************************************************************/
@@ -388,70 +645,144 @@ void Widget::setConnectedState(connectedEnum state)
     n_wcm_fault->setColor(bState);
 
     readSettingsButton->setEnabled(bState);
+    downloadLogButton->setEnabled(bState);
+    telemetryStreamCheckBox->setEnabled(bState);
+    if (!bState)
+    {
+        // The port is closed, so uncheck without sending telemetry_stream 0
+        telemetryStreamCheckBox->blockSignals(true);
+        telemetryStreamCheckBox->setChecked(false);
+        telemetryStreamCheckBox->blockSignals(false);
+    }
 
 }   // End of Widget::setConnectedState
 
 
+/***************************************************************************
+Function to save the downloaded log records to a CSV file
+****************************************************************************/
+void Widget::saveLogRecords(void)
+{
+    qDebug() << "Widget::saveLogRecords";
+
+    QString fileName = QFileDialog::getSaveFileName(this, "Save Power Module Log", "pm_log.csv", "CSV Files (*.csv)");
+    if (fileName.isEmpty())
+        return;
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
+    {
+        QMessageBox::warning(this, "MMD Power Module", QString("Could not open %1").arg(fileName));
+        return;
+    }
+
+    QTextStream stream(&file);
+    stream << "sequence,timestamp_ms,leak_v,battery_v,battery_a,ltc2944_temperature,charge_mah,"
+              "pressure_mbar,ms5637_temperature,tilt,power_bits,status_bits,flags\n";
+
+    for (const TelemetryRecord &record : logRecords)
+    {
+        stream << record.sequence << ","
+               << record.timestampMs << ","
+               << QString::number(record.leakMv / 1000.0, 'f', 3) << ","
+               << QString::number(record.batteryMv / 1000.0, 'f', 3) << ","
+               << QString::number(record.batteryMa / 1000.0, 'f', 3) << ","
+               << QString::number(record.ltc2944Temperature / 100.0, 'f', 2) << ","
+               << record.chargeMah << ","
+               << QString::number(record.pressure / 10.0, 'f', 1) << ","
+               << QString::number(record.ms5637Temperature / 100.0, 'f', 2) << ","
+               << QString::number(record.tilt / 100.0, 'f', 2) << ","
+               << QString("0x%1").arg(record.powerBits, 3, 16, QChar('0')) << ","
+               << QString("0x%1").arg(record.statusBits, 2, 16, QChar('0')) << ","
+               << record.flags << "\n";
+    }
+
+}   // End of Widget::saveLogRecords
+
+
 /***************************************************************************
 Function to set the power radio buttons according to the power bits
 ****************************************************************************/
 void Widget::setPowerBits(int power_bits)
 {
-    qDebug() << "Widget::setPowerBits: power_bits = " << power_bits;
-
-    // Make sure these offsets match the firmware
-//    int en_5v_offset = 0;
-//    int en_9v_offset = 1;
-//    int dds_pwr_offset = 2;
-//    int led1_offset = 3;
-//    int led2_offset = 4;
-//    int tclamp_offset = 5;
-//    int gpio0_offset = 6;
-//    int wakeup_en_offset = 7;
-
-//    if (dio & 1 << en_5v_offset)
-//        en5VRadioButtonOn->setChecked(true);
-//    else
-//        en5VRadioButtonOff->setChecked(true);
-
-//    if (dio & 1 << en_9v_offset)
-//        en9VRadioButtonOn->setChecked(true);
-//    else
-//        en9VRadioButtonOff->setChecked(true);
-
-//    if (dio & 1 << dds_pwr_offset)
-//        ddsPwrRadioButtonOn->setChecked(true);
-//    else
-//        ddsPwrRadioButtonOff->setChecked(true);
-
-//    if (dio & 1 << led1_offset)
-//        led1RadioButtonOn->setChecked(true);
-//    else
-//        led1RadioButtonOff->setChecked(true);
-
-//    if (dio & 1 << led2_offset)
-//        led2RadioButtonOn->setChecked(true);
-//    else
-//        led2RadioButtonOff->setChecked(true);
-
-//    if (dio & 1 << tclamp_offset)
-//        tclampRadioButtonOn->setChecked(true);
-//    else
-//        tclampRadioButtonOff->setChecked(true);
-
-//    if (dio & 1 << gpio0_offset)
-//        gpio0StatusLineEdit->setText("ON");
-//    else
-//        gpio0StatusLineEdit->setText("OFF");
-
-//    if (dio & 1 << wakeup_en_offset)
-//        wakeupEnStatusLineEdit->setText("ON");
-//    else
-//        wakeupEnStatusLineEdit->setText("OFF");
+    qDebug() << "Widget::setPowerBits: power_bits =" << QString("0x%1").arg(power_bits, 3, 16, QChar('0'));
+
+    en_3v3va->setChecked((power_bits & POWER_3V3VA) ? true : false);
+    batt_sel->setChecked((power_bits & POWER_BATT_SEL) ? true : false);
+    driver_en->setChecked((power_bits & POWER_DRIVER) ? true : false);
+    mmd_pwr_en->setChecked((power_bits & POWER_MAIN_PWR) ? true : false);
+    vbs_pwr_en->setChecked((power_bits & POWER_VBS_PWR) ? true : false);
+    vbs_ser_pwr_en->setChecked((power_bits & POWER_VBS_SER_PWR) ? true : false);
+    wcm_diag_en->setChecked((power_bits & POWER_WCM_DIAG) ? true : false);
+    wcm_pwr_en->setChecked((power_bits & POWER_WCM_PWR) ? true : false);
+    wcm_rly->setChecked((power_bits & POWER_WCM_RLY) ? true : false);
 
 }   // End of Widget::setPowerBits
 
 
+/***************************************************************************
+Function to set the status indicators according to the status bits
+****************************************************************************/
+void Widget::setStatusBits(int status_bits)
+{
+    qDebug() << "Widget::setStatusBits: status_bits =" << QString("0x%1").arg(status_bits, 2, 16, QChar('0'));
+
+    n_accel_int->setColor(QString((status_bits & STATUS_N_ACCEL_INT) ? "True" : "False"));
+    ext_gpio1->setColor(QString((status_bits & STATUS_EXT_GPIO1) ? "True" : "False"));
+    ext_gpio2->setColor(QString((status_bits & STATUS_EXT_GPIO2) ? "True" : "False"));
+    lt8618_pg->setColor(QString((status_bits & STATUS_LT8618_PG) ? "True" : "False"));
+    n_ltc2944_alcc->setColor(QString((status_bits & STATUS_N_LTC2944_ALCC) ? "True" : "False"));
+    n_wcm_fault->setColor(QString((status_bits & STATUS_N_WCM_FAULT) ? "True" : "False"));
+
+}   // End of Widget::setStatusBits
+
+
+/***************************************************************************
+Function to show a streamed log record in the sensor controls
+****************************************************************************/
+void Widget::showTelemetryRecord(const TelemetryRecord &record)
+{
+    // pm_log_record.flags bits
+    const int LEAK_FAILED = 0x01;
+    const int LTC2944_FAILED = 0x02;
+    const int MS5637_FAILED = 0x04;
+    const int MC3416_FAILED = 0x08;
+
+    if (!(record.flags & LEAK_FAILED))
+    {
+        leakVoltageLineEdit->setText(QString("%1").arg(record.leakMv / 1000.0, 0, 'f', 3));
+        trendChart->addSample(TREND_LEAK, record.leakMv / 1000.0);
+    }
+
+    if (!(record.flags & LTC2944_FAILED))
+    {
+        voltageLineEdit->setText(QString("%1").arg(record.batteryMv / 1000.0, 0, 'f', 3));
+        currentLineEdit->setText(QString("%1").arg(record.batteryMa / 1000.0, 0, 'f', 3));
+        trendChart->addSample(TREND_VOLTAGE, record.batteryMv / 1000.0);
+        trendChart->addSample(TREND_CURRENT, record.batteryMa / 1000.0);
+        ltc2944TemperatureLineEdit->setText(QString("%1").arg(record.ltc2944Temperature / 100.0, 0, 'f', 2));
+        chargeLineEdit->setText(QString("%1").arg(double(record.chargeMah), 0, 'f', 2));
+    }
+
+    if (!(record.flags & MS5637_FAILED))
+    {
+        ms5637pressureLineEdit->setText(QString("%1").arg(record.pressure / 10.0));
+        trendChart->addSample(TREND_PRESSURE, record.pressure / 10.0);
+        ms5637TemperatureLineEdit->setText(QString("%1").arg(record.ms5637Temperature / 100.0, 0, 'f', 2));
+    }
+
+    if (!(record.flags & MC3416_FAILED))
+    {
+        mc3416AngleLineEdit->setText(QString("%1").arg(record.tilt / 100.0, 0, 'f', 2));
+        trendChart->addSample(TREND_ANGLE, record.tilt / 100.0);
+    }
+
+    setPowerBits(record.powerBits);
+    setStatusBits(record.statusBits);
+
+}   // End of Widget::showTelemetryRecord
+
+
 /***************************************************************************
 Slot to display information about the software when the user clicks the
 Help->About menu item
@@ -485,7 +816,7 @@ void Widget::slotConnected(void)
 {
     qDebug() << "Widget::slotConnected";
 
-    serialData.clear();
+    responseStream->clear();
     setConnectedState(CONNECTED);
 
     slotReadSettings();
@@ -498,215 +829,10 @@ Slot to respond when data is read from a serial device
 ****************************************************************************/
 void Widget::slotDataRead(QByteArray data)
 {
-    int bit_val;
-    int index;
-    QString bit_string;
-
-    serialData.append(data);
+//    qDebug() << "Widget::slotDataRead: data = " << data;
 
-//    qDebug() << "Widget::slotDataRead: serialData = " << serialData;
+    responseStream->append(data);
 
-    while (1)
-    {
-        index = serialData.indexOf("\r\n");
-        if (index == -1)
-            break;
-        else
-        {
-            // Extract the response
-            QByteArray response = serialData.left(index);
-
-            qDebug() << "Widget::slotDataRead: response = " << response;
-
-            // Remove the response
-            serialData.remove(0, index+2);
-
-            QStringList list = QString(response).split(" ");
-            if (list.length() > 1)
-            {
-                if (response.contains("+3V3VA_EN"))
-                {
-                    bit_val = list.at(1).toInt();
-                    en_3v3va->setChecked((bit_val == 1) ? true : false);
-                }
-                else if (response.contains("BATT_SEL"))
-                {
-                    bit_val = list.at(1).toInt();
-                    batt_sel->setChecked((bit_val == 1) ? true : false);
-                }
-/*
-                else if (response.contains("BATT_SER_PWR_EN"))
-                {
-                    bit_val = list.at(1).toInt();
-                    batt_ser_pwr_en->setChecked((bit_val == 1) ? true : false);
-                }
-                else if (response.contains("CTD_PWR_EN"))
-                {
-                    bit_val = list.at(1).toInt();
-                    ctd_pwr_en->setChecked((bit_val == 1) ? true : false);
-                }
-*/
-                else if (response.contains("DRIVER_EN"))
-                {
-                    bit_val = list.at(1).toInt();
-                    driver_en->setChecked((bit_val == 1) ? true : false);
-                }
-                else if (response.contains("MMD_PWR_EN"))
-                {
-                    if (list.at(1) != "unchanged")
-                    {
-                        bit_val = list.at(1).toInt();
-                        mmd_pwr_en->setChecked((bit_val == 1) ? true : false);
-                    }
-                }
-                else if (response.contains("VBS_PWR_EN"))
-                {
-                    bit_val = list.at(1).toInt();
-                    vbs_pwr_en->setChecked((bit_val == 1) ? true : false);
-                }
-                else if (response.contains("VBS_SER_PWR_EN"))
-                {
-                    bit_val = list.at(1).toInt();
-                    vbs_ser_pwr_en->setChecked((bit_val == 1) ? true : false);
-                }
-                else if (response.contains("WCM_DIAG_EN"))
-                {
-                    bit_val = list.at(1).toInt();
-                    wcm_diag_en->setChecked((bit_val == 1) ? true : false);
-                }
-                else if (response.contains("WCM_PWR_EN"))
-                {
-                    bit_val = list.at(1).toInt();
-                    wcm_pwr_en->setChecked((bit_val == 1) ? true : false);
-                }
-                else if (response.contains("WCM_RLY"))
-                {
-                    if (list.at(1) != "unchanged")
-                    {
-                        bit_val = list.at(1).toInt();
-                        wcm_rly->setChecked((bit_val == 1) ? true : false);
-                    }
-                }
-                else if (response.contains("/ACCEL_INT"))
-                {
-                    bit_val = list.at(1).toInt();
-                    bit_string = (bit_val == 1) ? "True" : "False";
-                    n_accel_int->setColor(bit_string);
-                }
-                else if (response.contains("EXT_GPIO1"))
-                {
-                    bit_val = list.at(1).toInt();
-                    bit_string = (bit_val == 1) ? "True" : "False";
-                    ext_gpio1->setColor(bit_string);
-                }
-                else if (response.contains("EXT_GPIO2"))
-                {
-                    bit_val = list.at(1).toInt();
-                    bit_string = (bit_val == 1) ? "True" : "False";
-                    ext_gpio2->setColor(bit_string);
-                }
-                else if (response.contains("LT8618_PG"))
-                {
-                    bit_val = list.at(1).toInt();
-                    bit_string = (bit_val == 1) ? "True" : "False";
-                    lt8618_pg->setColor(bit_string);
-                }
-                else if (response.contains("/LTC2944_ALCC"))
-                {
-                    bit_val = list.at(1).toInt();
-                    bit_string = (bit_val == 1) ? "True" : "False";
-                    n_ltc2944_alcc->setColor(bit_string);
-                }
-                else if (response.contains("/WCM_FAULT"))
-                {
-                    bit_val = list.at(1).toInt();
-                    bit_string = (bit_val == 1) ? "True" : "False";
-                    n_wcm_fault->setColor(bit_string);
-                }
-                else if (response.contains("LEAK"))
-                {
-                    leakVoltageLineEdit->setText(QString("%1").arg(list.at(1).toDouble(), 0, 'f', 3));
-                }
-                else if (response.contains("VOLTAGE"))
-                {
-                    voltageLineEdit->setText(QString("%1").arg(list.at(1).toDouble(), 0, 'f', 3));
-                }
-                else if (response.contains("CURRENT"))
-                {
-                    currentLineEdit->setText(QString("%1").arg(list.at(1).toDouble(), 0, 'f', 3));
-                }
-                else if (response.contains("LTC2944 TEMPERATURE"))
-                {
-                    ltc2944TemperatureLineEdit->setText(QString("%1").arg(list.at(2).toDouble(), 0, 'f', 2));
-                }
-                else if (response.contains("CHARGE"))
-                {
-                    chargeLineEdit->setText(QString("%1").arg(list.at(1).toDouble(), 0, 'f', 2));
-                }
-                else if (response.contains("STATUS"))
-                {
-                    statusLineEdit->setText(list.at(1));
-                }
-
-
-                else if (response.contains("ACCEL TILT ANGLE"))
-                {
-                    mc3416AngleLineEdit->setText(QString("%1").arg(list.at(3).toDouble(), 0, 'f', 2));
-                }
-
-
-
-                else if (response.contains("CRC"))
-                {
-                    cLineEditList.at(0)->setText(QString("%1").arg(list.at(1).toInt()));
-                }
-                else if (response.contains("C1"))
-                {
-                    cLineEditList.at(1)->setText(QString("%1").arg(list.at(1).toInt()));
-                }
-                else if (response.contains("C2 "))
-                {
-                    cLineEditList.at(2)->setText(QString("%1").arg(list.at(1).toInt()));
-                }
-                else if (response.contains("C3"))
-                {
-                    cLineEditList.at(3)->setText(QString("%1").arg(list.at(1).toInt()));
-                }
-                else if (response.contains("C4"))
-                {
-                    cLineEditList.at(4)->setText(QString("%1").arg(list.at(1).toInt()));
-                }
-                else if (response.contains("C5"))
-                {
-                    cLineEditList.at(5)->setText(QString("%1").arg(list.at(1).toInt()));
-                }
-                else if (response.contains("C6"))
-                {
-                    cLineEditList.at(6)->setText(QString("%1").arg(list.at(1).toInt()));
-                }
-                else if (response.contains("D1"))
-                {
-                    d1LineEdit->setText(QString("%1").arg(list.at(1).toInt()));
-                }
-                else if (response.contains("D2"))
-                {
-                    d2LineEdit->setText(QString("%1").arg(list.at(1).toInt()));
-                }
-                else if (response.contains("PRESSURE"))
-                {
-                    ms5637pressureLineEdit->setText(QString("%1").arg(list.at(1).toDouble()));
-                }
-                else if (response.contains("TEMPERATURE"))
-                {
-                    ms5637TemperatureLineEdit->setText(QString("%1").arg(list.at(1).toDouble(), 0, 'f', 2));
-                }
-//                else
-//                {
-//                    QMessageBox::information(this, "MMD Power Module", QString("PM returned \"%1\"").arg(response.data()));
-//                }
-            }
-        }
-    }
 }   // End of Widget::slotDataRead
 
 
@@ -717,12 +843,66 @@ void Widget::slotDisconnected(void)
 {
     qDebug() << "Widget::slotDisconnected";
 
-    serialData.clear();
+    responseStream->clear();
+    bDownloadingLog = false;
+    commandQueue->clear();
     setConnectedState(DISCONNECTED);
 
 }   // End of Widget::slotDisconnected
 
 
+/***************************************************************************
+Slot to download the power module log as compressed frames
+****************************************************************************/
+void Widget::slotDownloadLog(void)
+{
+    qDebug() << "Widget::slotDownloadLog";
+
+    commandQueue->enqueue("log_zdump 0", CommandQueue::PRIORITY_USER, 120000);
+
+}   // End of Widget::slotDownloadLog
+
+
+/***************************************************************************
+Slot to show a series store written by pm_daemon in the trend chart
+****************************************************************************/
+void Widget::slotOpenStore(void)
+{
+    qDebug() << "Widget::slotOpenStore";
+
+    QString directory = QFileDialog::getExistingDirectory(this, "Open Store");
+    if (directory.isEmpty())
+        return;
+
+    QString error = seriesReader.open(directory);
+    if (!error.isEmpty())
+    {
+        QMessageBox::warning(this, "Open Store", error);
+        return;
+    }
+
+    // The RecordWriter series of each trendEnum channel
+    trendChart->showHistory(&seriesReader, QStringList() << "leak_v" << "battery_v" << "battery_a"
+                                                         << "pressure_mbar" << "tilt");
+    liveTrendsButton->setEnabled(true);
+
+}   // End of Widget::slotOpenStore
+
+
+/***************************************************************************
+Slot to show the command queue depth and round trip time
+****************************************************************************/
+void Widget::slotQueueStatisticsChanged(void)
+{
+    queueStatusLabel->setText(QString("Queue %1   RTT %2 ms (average %3 ms)   Timeouts %4")
+                              .arg(commandQueue->depth())
+                              .arg(commandQueue->lastRttMs(), 0, 'f', 1)
+                              .arg(commandQueue->averageRttMs(), 0, 'f', 1)
+                              .arg(commandQueue->timeouts()));
+
+}   // End of Widget::slotQueueStatisticsChanged
+
+
 /***************************************************************************
 Slot to read the leak detector voltage
 ****************************************************************************/
@@ -730,7 +910,7 @@ void Widget::slotReadLeakDetector(void)
 {
     qDebug() << "Widget::slotReadLeakDetector";
 
-    serial->write("read_leak\r\n");
+    commandQueue->enqueue("read_leak", CommandQueue::PRIORITY_REFRESH);
 
 }   // End of Widget::slotReadLeakDetector
 
@@ -742,7 +922,7 @@ void Widget::slotReadLTC2944(void)
 {
     qDebug() << "Widget::slotReadLTC2944";
 
-    serial->write("read_ltc2944\r\n");
+    commandQueue->enqueue("read_ltc2944", CommandQueue::PRIORITY_REFRESH);
 
 }   // End of Widget::slotReadLTC2944
 
@@ -754,7 +934,7 @@ void Widget::slotReadMC3416(void)
 {
     qDebug() << "Widget::slotReadMC3416";
 
-    serial->write("read_mc3416\r\n");
+    commandQueue->enqueue("read_mc3416", CommandQueue::PRIORITY_REFRESH);
 
 }   // End of Widget::slotReadLTC2944
 
@@ -765,7 +945,7 @@ void Widget::slotReadMS5637(void)
 {
     qDebug() << "Widget::slotReadMS5637";
 
-    serial->write("read_ms5637\r\n");
+    commandQueue->enqueue("read_ms5637", CommandQueue::PRIORITY_REFRESH);
 
 }   // End of Widget::slotReadMS5637
 
@@ -777,7 +957,7 @@ void Widget::slotReadPowerBits(void)
 {
     qDebug() << "Widget::slotReadPowerBits";
 
-    serial->write("read_power_bits\r\n");
+    commandQueue->enqueue("read_power_bits", CommandQueue::PRIORITY_REFRESH);
 
 }   // End of Widget::slotReadPowerBits
 
@@ -789,28 +969,13 @@ void Widget::slotReadSettings(void)
 {
     qDebug() << "Widget::slotReadSettings";
 
-//    getPowerModuleSettings();
-
-    int ms = 0;
-    int dms = 500;
-
-    QTimer::singleShot(ms, this, SLOT(slotReadLeakDetector()));
-    ms += dms;
-
-    QTimer::singleShot(ms, this, SLOT(slotReadLTC2944()));
-    ms += dms;
-
-    QTimer::singleShot(ms, this, SLOT(slotReadMS5637()));
-    ms += dms;
-
-    QTimer::singleShot(ms, this, SLOT(slotReadPowerBits()));
-    ms += dms;
-
-    QTimer::singleShot(ms, this, SLOT(slotReadStatusBits()));
-    ms += dms;
-
-    QTimer::singleShot(ms, this, SLOT(slotReadMC3416()));
-    ms += dms;
+    // Each read is sent when the previous one has been answered
+    slotReadLeakDetector();
+    slotReadLTC2944();
+    slotReadMS5637();
+    slotReadPowerBits();
+    slotReadStatusBits();
+    slotReadMC3416();
 
 }   // End of Widget::slotReadSettings
 
@@ -822,7 +987,7 @@ void Widget::slotReadStatusBits(void)
 {
     qDebug() << "Widget::slotReadStatusBits";
 
-    serial->write("read_status_bits\r\n");
+    commandQueue->enqueue("read_status_bits", CommandQueue::PRIORITY_REFRESH);
 
 }   // End of Widget::slotReadStatusBits
 
@@ -833,7 +998,7 @@ void Widget::slotPingReceived(void)
 {
     qDebug() << "Widget::slotPingReceived";
 
-    serial->write("pm_ping\r\n");
+    commandQueue->enqueue("pm_ping", CommandQueue::PRIORITY_USER);
 
 }   // End of Widget::slotPingReceived
 /***************************************************************************
@@ -843,7 +1008,7 @@ void Widget::slotReinitialize(void)
 {
     qDebug() << "Widget::slotReinitialize";
 
-    serial->write("reinitialize\r\n");
+    commandQueue->enqueue("reinitialize", CommandQueue::PRIORITY_USER, 5000);
 
 }   // End of Widget::slotReinitialize
 
@@ -855,7 +1020,7 @@ void Widget::slotCalibrateMC3416(void)
 {
     qDebug() << "Widget::slotCalibrateMC3416";
 
-    serial->write("calibrate_mc3416\r\n");
+    commandQueue->enqueue("calibrate_mc3416", CommandQueue::PRIORITY_USER, 5000);
 
 }   // End of Widget::slotCalibrateMC3416
 
@@ -866,7 +1031,7 @@ void Widget::slotZeroMC3416(void)
 {
     qDebug() << "Widget::slotZeroMC3416";
 
-    serial->write("zero_mc3416\r\n");
+    commandQueue->enqueue("zero_mc3416", CommandQueue::PRIORITY_USER);
 
 }   // End of Widget::slotZeroMC3416
 
@@ -881,69 +1046,69 @@ void Widget::slotSetPower(int level)
     {
         qDebug() << QString("Widget::slotSetPower: Setting +3V3VA_EN to %1").arg(level);
 
-        command = QString("+3V3VA_EN %1\r\n").arg(level);
+        command = QString("+3V3VA_EN %1").arg(level);
     }
     else if (sender() == batt_sel)
     {
         qDebug() << QString("Widget::slotSetPower: Setting BATT_SEL to %1").arg(level);
 
-        command = QString("BATT_SEL %1\r\n").arg(level);
+        command = QString("BATT_SEL %1").arg(level);
     }
 /*
     else if (sender() == batt_ser_pwr_en)
     {
         qDebug() << QString("Widget::slotSetPower: Setting BATT_SER_PWR_EN to %1").arg(level);
 
-        command = QString("BATT_SER_PWR_EN %1\r\n").arg(level);
+        command = QString("BATT_SER_PWR_EN %1").arg(level);
     }
     else if (sender() == ctd_pwr_en)
     {
         qDebug() << QString("Widget::slotSetPower: Setting CTD_PWR_EN to %1").arg(level);
 
-        command = QString("CTD_PWR_EN %1\r\n").arg(level);
+        command = QString("CTD_PWR_EN %1").arg(level);
     }
 */
     else if (sender() == driver_en)
     {
         qDebug() << QString("Widget::slotSetPower: Setting DRIVER_EN to %1").arg(level);
 
-        command = QString("DRIVER_EN %1\r\n").arg(level);
+        command = QString("DRIVER_EN %1").arg(level);
     }
     else if (sender() == mmd_pwr_en)
     {
         qDebug() << QString("Widget::slotSetPower: Setting MMD_PWR_EN to %1").arg(level);
 
-        command = QString("MMD_PWR_EN %1\r\n").arg(level);
+        command = QString("MMD_PWR_EN %1").arg(level);
     }
     else if (sender() == vbs_pwr_en)
     {
         qDebug() << QString("Widget::slotSetPower: Setting VBS_PWR_EN to %1").arg(level);
 
-        command = QString("VBS_PWR_EN %1\r\n").arg(level);
+        command = QString("VBS_PWR_EN %1").arg(level);
     }
     else if (sender() == vbs_ser_pwr_en)
     {
         qDebug() << QString("Widget::slotSetPower: Setting VBS_SER_PWR_EN to %1").arg(level);
 
-        command = QString("VBS_SER_PWR_EN %1\r\n").arg(level);
+        command = QString("VBS_SER_PWR_EN %1").arg(level);
     }
     else if (sender() == wcm_diag_en)
     {
         qDebug() << QString("Widget::slotSetPower: Setting WCM_DIAG_EN to %1").arg(level);
 
-        command = QString("WCM_DIAG_EN %1\r\n").arg(level);
+        command = QString("WCM_DIAG_EN %1").arg(level);
     }
     else if (sender() == wcm_pwr_en)
     {
         qDebug() << QString("Widget::slotSetPower: Setting WCM_PWR_EN to %1").arg(level);
 
-        command = QString("WCM_PWR_EN %1\r\n").arg(level);
+        command = QString("WCM_PWR_EN %1").arg(level);
     }
     else if (sender() == wcm_rly)
     {
         qDebug() << QString("Widget::slotSetPower: Setting WCM_RLY to %1").arg(level);
 
-        command = QString("WCM_RLY %1\r\n").arg(level);
+        command = QString("WCM_RLY %1").arg(level);
     }
     else
     {
@@ -951,11 +1116,43 @@ void Widget::slotSetPower(int level)
         return;
     }
 
-    serial->write(command);
+    commandQueue->enqueue(command, CommandQueue::PRIORITY_CONTROL);
 
 }   // End of Widget::slotSetPower
 
 
+/***************************************************************************
+Slot to turn the power module live telemetry stream on or off
+****************************************************************************/
+void Widget::slotSetTelemetryStream(int state)
+{
+    qDebug() << "Widget::slotSetTelemetryStream: state = " << state;
+
+    if (state == Qt::Checked)
+    {
+        responseStream->decoder().reset();
+        commandQueue->enqueue("telemetry_stream 1", CommandQueue::PRIORITY_CONTROL);
+    }
+    else
+        commandQueue->enqueue("telemetry_stream 0", CommandQueue::PRIORITY_CONTROL);
+
+}   // End of Widget::slotSetTelemetryStream
+
+
+/***************************************************************************
+Slot to go back to the live trends and close the store
+****************************************************************************/
+void Widget::slotShowLiveTrends(void)
+{
+    qDebug() << "Widget::slotShowLiveTrends";
+
+    trendChart->showLive();
+    seriesReader.close();
+    liveTrendsButton->setEnabled(false);
+
+}   // End of Widget::slotShowLiveTrends
+
+
 /***************************************************************************
 Widget constructor
 ****************************************************************************/
@@ -978,10 +1175,19 @@ Widget::Widget(QWidget *parent)
     menuBar->addMenu(helpMenu);
 
     serial = new Serial;
+    commandQueue = new CommandQueue(this);
+    responseStream = new ResponseStream(commandQueue, &responseParser);
     powerGroupBox = createPowerGroupBox();
     sensorsGroupBox = createSensorsGroupBox();
     statusGroupBox = createStatusGroupBox();
+    trendGroupBox = createTrendGroupBox();
     readSettingsButton = new QPushButton("Read Settings");
+    downloadLogButton = new QPushButton("Download Log");
+    telemetryStreamCheckBox = new QCheckBox("Live Telemetry");
+    queueStatusLabel = new QLabel;
+
+    bDownloadingLog = false;
+    logRecordsExpected = 0;
 
     // Create the layout
     QGridLayout *layout = new QGridLayout(this);
@@ -991,18 +1197,34 @@ Widget::Widget(QWidget *parent)
     layout->addWidget(powerGroupBox, 1, 0);
     layout->addWidget(sensorsGroupBox, 0, 1, 3, 1);
     layout->addWidget(statusGroupBox, 2, 0);
-    layout->addWidget(readSettingsButton, 3, 0, 1, 2);
+    layout->addWidget(readSettingsButton, 3, 0);
+    layout->addWidget(downloadLogButton, 3, 1);
+    layout->addWidget(queueStatusLabel, 4, 0);
+    layout->addWidget(telemetryStreamCheckBox, 4, 1);
+    layout->addWidget(trendGroupBox, 5, 0, 1, 2);
 
     // Initialize the controls
     setConnectedState(DISCONNECTED);
+    slotQueueStatisticsChanged();
+    addResponseHandlers();
+    responseStream->setRecordHandler([this](const TelemetryRecord &record) {
+        if (bDownloadingLog)
+            logRecords.append(record);
+        else
+            showTelemetryRecord(record);
+    });
 
     // Connect the signals and slots
     connect(aboutAction, SIGNAL(triggered()), this, SLOT(slotAbout()));
     connect(exitAction, SIGNAL(triggered()), this, SLOT(close()));
     connect(readSettingsButton, SIGNAL(clicked()), this, SLOT(slotReadSettings()));
+    connect(downloadLogButton, SIGNAL(clicked()), this, SLOT(slotDownloadLog()));
+    connect(telemetryStreamCheckBox, SIGNAL(stateChanged(int)), this, SLOT(slotSetTelemetryStream(int)));
     connect(serial, SIGNAL(signalConnected()), this, SLOT(slotConnected()));
     connect(serial, SIGNAL(signalDataRead(QByteArray)), this, SLOT(slotDataRead(QByteArray)));
     connect(serial, SIGNAL(signalDisconnected()), this, SLOT(slotDisconnected()));
+    connect(commandQueue, SIGNAL(signalStatisticsChanged()), this, SLOT(slotQueueStatisticsChanged()));
+    connect(commandQueue, SIGNAL(signalWrite(QString)), serial, SLOT(write(QString)));
 
 }   // End of Widget::Widget
 
@@ -1014,6 +1236,8 @@ Widget::~Widget()
 {
     qDebug() << "Widget::~Widget";
 
+    delete responseStream;
+
 }   // End of Widget::~Widget
 
 
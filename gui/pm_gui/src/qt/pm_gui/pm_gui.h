@@ -15,15 +15,24 @@ Date:
 #define WIDGET_H
 
 
+#include <QList>
 #include <QWidget>
+#include "response_parser.h"
+#include "response_stream.h"
+#include "series_reader.h"
+#include "telemetry_decoder.h"
 
 
+class CommandQueue;
 class DigitalInput;
 class DigitalOutput;
+class QCheckBox;
 class QGroupBox;
+class QLabel;
 class QLineEdit;
 class QPushButton;
 class Serial;
+class TrendChart;
 
 
 class Widget : public QWidget
@@ -41,6 +50,9 @@ private slots:
     void slotConnected(void);
     void slotDataRead(QByteArray);
     void slotDisconnected(void);
+    void slotDownloadLog(void);
+    void slotOpenStore(void);
+    void slotQueueStatisticsChanged(void);
     void slotReadLeakDetector(void);
     void slotReadLTC2944(void);
     void slotReadMS5637(void);
@@ -55,17 +67,35 @@ private slots:
     void slotPingReceived(void);
 
     void slotSetPower(int);
+    void slotSetTelemetryStream(int);
+    void slotShowLiveTrends(void);
 
 private:
 
     enum connectedEnum {DISCONNECTED, CONNECTED};
 
+    // Make sure these match PM_POWER_BIT_xxx and PM_STATUS_BIT_xxx in pm_gpio.h
+    enum powerBitEnum {POWER_3V3VA = 0x001, POWER_BATT_SEL = 0x002, POWER_BATT_SER_PWR = 0x004,
+                       POWER_CTD_PWR = 0x008, POWER_DRIVER = 0x010, POWER_MAIN_PWR = 0x020,
+                       POWER_VBS_PWR = 0x040, POWER_VBS_SER_PWR = 0x080, POWER_WCM_DIAG = 0x100,
+                       POWER_WCM_PWR = 0x200, POWER_WCM_RLY = 0x400};
+    enum statusBitEnum {STATUS_N_ACCEL_INT = 0x01, STATUS_EXT_GPIO1 = 0x02, STATUS_EXT_GPIO2 = 0x04,
+                        STATUS_LT8618_PG = 0x08, STATUS_N_LTC2944_ALCC = 0x10, STATUS_N_WCM_FAULT = 0x20};
+
+    // Trend chart channels
+    enum trendEnum {TREND_LEAK, TREND_VOLTAGE, TREND_CURRENT, TREND_PRESSURE, TREND_ANGLE};
+
+    void addResponseHandlers(void);
     QGroupBox *createPowerGroupBox(void);
     QGroupBox *createSensorsGroupBox(void);
     QGroupBox *createStatusGroupBox(void);
+    QGroupBox *createTrendGroupBox(void);
 //    void getPowerModuleSettings(void);
     void setConnectedState(connectedEnum state);
+    void saveLogRecords(void);
     void setPowerBits(int);
+    void setStatusBits(int);
+    void showTelemetryRecord(const TelemetryRecord &);
 
     DigitalInput *n_accel_int;
     DigitalInput *n_ltc2944_alcc;
@@ -88,10 +118,15 @@ private:
     DigitalOutput *wcm_pwr_en;
     DigitalOutput *wcm_rly;
 
-    QByteArray serialData;
+    bool bDownloadingLog;
+    CommandQueue *commandQueue;
+    int logRecordsExpected;
+    QCheckBox *telemetryStreamCheckBox;
     QGroupBox *powerGroupBox;
     QGroupBox *sensorsGroupBox;
     QGroupBox *statusGroupBox;
+    QGroupBox *trendGroupBox;
+    QLabel *queueStatusLabel;
     QLineEdit *chargeLineEdit;
     QLineEdit *currentLineEdit;
     QLineEdit *d1LineEdit;
@@ -104,16 +139,23 @@ private:
     QLineEdit *statusLineEdit;
     QLineEdit *voltageLineEdit;
     QList<QLineEdit *> cLineEditList;
+    QList<TelemetryRecord> logRecords;
 //    QPushButton *readLTC2944Button;
 //    QPushButton *readMS5637Button;
 //    QPushButton *readMC3416Button;
+    QPushButton *downloadLogButton;
     QPushButton *readSettingsButton;
     QPushButton *reInitializeButton;
     QPushButton *CalibrateButton;
     QPushButton *ZeroOffsetButton;
     QPushButton *PingButton;
+    QPushButton *liveTrendsButton;
 
+    ResponseParser responseParser;
+    ResponseStream *responseStream;
     Serial *serial;
+    SeriesReader seriesReader;
+    TrendChart *trendChart;
 
 };
 
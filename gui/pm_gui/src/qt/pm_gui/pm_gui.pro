@@ -4,44 +4,26 @@ greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
 CONFIG += c++11
 
-# The following define makes your compiler emit warnings if you use
-# any Qt feature that has been marked deprecated (the exact warnings
-# depend on your compiler). Please consult the documentation of the
-# deprecated API in order to know how to port your code away from it.
-DEFINES += QT_DEPRECATED_WARNINGS
-
-# You can also make your code fail to compile if it uses deprecated APIs.
-# In order to do so, uncomment the following line.
-# You can also select to disable deprecated APIs only up to a certain version of Qt.
-#DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
-
 SOURCES += \
     digital_input.cpp \
     digital_output.cpp \
     main.cpp \
     pm_gui.cpp \
-    serial.cpp
+    sample_buffer.cpp \
+    serial.cpp \
+    trend_chart.cpp
 
 HEADERS += \
     digital_input.h \
     digital_output.h \
     pm_gui.h \
-    serial.h
+    sample_buffer.h \
+    serial.h \
+    trend_chart.h
 
-# Default rules for deployment.
-qnx: target.path = /tmp/$${TARGET}/bin
-else: unix:!android: target.path = /opt/$${TARGET}/bin
-!isEmpty(target.path): INSTALLS += target
+include(../pm_core/pm_core.pri)
 
 RESOURCES += \
     pm_gui.qrc
 
-PM_VERSION = 0.1
-VERSTR = '\\"$${PM_VERSION}\\"'
-DEFINES += PM_VERSION=\"$${VERSTR}\"
-
-QT += serialport
-
 RC_ICONS += eSonar.ico
-
-
@@ -0,0 +1,243 @@
+/***************************************************************************
+sample_buffer.cpp:  Fixed capacity sample history class functions
+
+Written by:
+    Sandra Mercer, P.Eng.
+    Engineer / Software Developer
+    eSonar Inc.
+
+Date:
+    November 2022
+
+Note(s):
+- The samples are kept in a ring, the oldest one is overwritten once the
+buffer is full. Sample n, counted from the first one appended, is stored at
+n % capacity
+- The minimum and maximum of every block of 16 samples, and of every 256
+samples, are kept up to date as the samples arrive. The capacity is a
+multiple of 256, so a block is always overwritten as a whole
+- decimate() reduces a time range to one minimum and maximum per pixel
+column. It reads the coarsest level whose blocks still fit within one
+column, going a level down for a block that crosses a column edge, so a
+view costs at most about 16 reads per column per level whatever its
+length, and the peaks are never lost the way they are when every nth sample
+is drawn
+- The times must not go backwards, the range is found with a binary search
+****************************************************************************/
+
+
+#include <algorithm>
+#include "sample_buffer.h"
+
+
+/***************************************************************************
+SampleBuffer constructor
+****************************************************************************/
+SampleBuffer::SampleBuffer(int capacity)
+{
+    int largest = 1;
+    for (int level = 1; level < Levels; level++)
+        largest *= Fanout;
+
+    // Whole superblocks only
+    this->capacity = std::max(largest, (capacity + largest - 1) / largest * largest);
+
+    times.resize(this->capacity);
+    values.resize(this->capacity);
+
+    int blockSize = 1;
+    for (int level = 1; level < Levels; level++)
+    {
+        blockSize *= Fanout;
+        blockMin[level].resize(this->capacity / blockSize);
+        blockMax[level].resize(this->capacity / blockSize);
+    }
+
+    total = 0;
+
+}   // End of SampleBuffer::SampleBuffer
+
+
+/***************************************************************************
+Function to add a sample, overwriting the oldest one when full
+****************************************************************************/
+void SampleBuffer::append(qint64 timeMs, float value)
+{
+    int index = int(total % capacity);
+
+    times[index] = timeMs;
+    values[index] = value;
+
+    qint64 blockSize = 1;
+    for (int level = 1; level < Levels; level++)
+    {
+        blockSize *= Fanout;
+
+        int block = int((total / blockSize) % (capacity / blockSize));
+        if (total % blockSize == 0)
+        {
+            blockMin[level][block] = value;
+            blockMax[level][block] = value;
+        }
+        else
+        {
+            blockMin[level][block] = std::min(blockMin[level][block], value);
+            blockMax[level][block] = std::max(blockMax[level][block], value);
+        }
+    }
+
+    total++;
+
+}   // End of SampleBuffer::append
+
+
+/***************************************************************************
+Function to discard the samples
+****************************************************************************/
+void SampleBuffer::clear(void)
+{
+    total = 0;
+
+}   // End of SampleBuffer::clear
+
+
+/***************************************************************************
+Function to reduce the samples from startMs up to endMs to one range for
+each entry of columns. A column without samples is not valid
+****************************************************************************/
+void SampleBuffer::decimate(qint64 startMs, qint64 endMs, QVector<Column> &columns) const
+{
+    int width = columns.size();
+
+    for (Column &column : columns)
+        column.bValid = false;
+
+    if (width == 0 || endMs <= startMs)
+        return;
+
+    qint64 first = lowerBound(startMs);
+    qint64 last = lowerBound(endMs);
+    if (first >= last)
+        return;
+
+    // The coarsest level with no more than one block per column
+    int level = 0;
+    qint64 blockSize = 1;
+    while (level + 1 < Levels && blockSize * Fanout <= (last - first) / width)
+    {
+        blockSize *= Fanout;
+        level++;
+    }
+
+    qint64 span = endMs - startMs;
+    qint64 n = first;
+    while (n < last)
+    {
+        float min;
+        float max;
+        int x = int((times[int(n % capacity)] - startMs) * width / span);
+
+        // The largest block starting here that ends in the same column.
+        // Blocks cut by the ends of the range or by a column edge are read
+        // a level down, down to sample by sample
+        int blockLevel = level;
+        qint64 size = blockSize;
+        while (blockLevel > 0 &&
+               (n % size != 0 || n + size > last ||
+                int((times[int((n + size - 1) % capacity)] - startMs) * width / span) != x))
+        {
+            size /= Fanout;
+            blockLevel--;
+        }
+
+        if (blockLevel > 0)
+        {
+            int block = int((n / size) % (capacity / size));
+            min = blockMin[blockLevel][block];
+            max = blockMax[blockLevel][block];
+            n += size;
+        }
+        else
+        {
+            min = max = values[int(n % capacity)];
+            n++;
+        }
+
+        Column &column = columns[std::min(std::max(x, 0), width - 1)];
+        if (column.bValid)
+        {
+            column.min = std::min(column.min, min);
+            column.max = std::max(column.max, max);
+        }
+        else
+        {
+            column.min = min;
+            column.max = max;
+            column.bValid = true;
+        }
+    }
+
+}   // End of SampleBuffer::decimate
+
+
+/***************************************************************************
+Functions to return the number of samples kept and the ends of the history
+****************************************************************************/
+qint64 SampleBuffer::size(void) const
+{
+    return (total - oldest());
+
+}   // End of SampleBuffer::size
+
+
+qint64 SampleBuffer::firstTimeMs(void) const
+{
+    return ((total == 0) ? 0 : times[int(oldest() % capacity)]);
+
+}   // End of SampleBuffer::firstTimeMs
+
+
+qint64 SampleBuffer::lastTimeMs(void) const
+{
+    return ((total == 0) ? 0 : times[int((total - 1) % capacity)]);
+
+}   // End of SampleBuffer::lastTimeMs
+
+
+float SampleBuffer::lastValue(void) const
+{
+    return ((total == 0) ? 0.0f : values[int((total - 1) % capacity)]);
+
+}   // End of SampleBuffer::lastValue
+
+
+/***************************************************************************
+Function to return the first sample at or after timeMs, or the end
+****************************************************************************/
+qint64 SampleBuffer::lowerBound(qint64 timeMs) const
+{
+    qint64 low = oldest();
+    qint64 high = total;
+
+    while (low < high)
+    {
+        qint64 middle = low + (high - low) / 2;
+        if (times[int(middle % capacity)] < timeMs)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    return (low);
+
+}   // End of SampleBuffer::lowerBound
+
+
+/***************************************************************************
+Function to return the number of the oldest sample kept
+****************************************************************************/
+qint64 SampleBuffer::oldest(void) const
+{
+    return ((total > capacity) ? total - capacity : 0);
+
+}   // End of SampleBuffer::oldest
@@ -0,0 +1,68 @@
+/***************************************************************************
+sample_buffer.h: Include file for sample_buffer.cpp
+
+Written by:
+    Sandra Mercer, P.Eng.
+    Engineer / Software Developer
+    eSonar Inc.
+
+Date:
+    November 2022
+****************************************************************************/
+
+
+#ifndef SAMPLE_BUFFER_H
+#define SAMPLE_BUFFER_H
+
+
+#include <QVector>
+
+
+class SampleBuffer
+{
+
+public:
+
+    // The range of the samples drawn in one pixel column
+    struct Column
+    {
+        float min;
+        float max;
+        bool bValid;
+    };
+
+    static const int DefaultCapacity = 1 << 18;     // About 7 hours at 10 Hz
+    static const int Fanout = 16;                   // Samples per block, blocks per superblock
+    static const int Levels = 3;                    // Samples, blocks and superblocks
+
+    explicit SampleBuffer(int capacity = DefaultCapacity);
+
+    void append(qint64, float);
+    void clear(void);
+    void decimate(qint64, qint64, QVector<Column> &) const;
+
+    qint64 size(void) const;
+    qint64 firstTimeMs(void) const;
+    qint64 lastTimeMs(void) const;
+    float lastValue(void) const;
+
+private:
+
+    qint64 lowerBound(qint64) const;
+    qint64 oldest(void) const;
+
+    int capacity;
+    qint64 total;
+
+    QVector<qint64> times;
+    QVector<float> values;
+
+    // The minimum and maximum of each block of Fanout^level samples, level 0
+    // is the samples themselves and is not stored here
+    QVector<float> blockMin[Levels];
+    QVector<float> blockMax[Levels];
+
+};
+
+
+#endif // SAMPLE_BUFFER_H
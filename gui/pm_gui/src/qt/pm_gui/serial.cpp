@@ -8,12 +8,35 @@ Written by:
 
 Date:
     November 2021
+
+Note(s):
+- After connecting at the selected baud rate the power module is asked to
+switch to the fast baud rate: "set_baud <rate>" is answered with BAUD_ACK,
+both sides switch, and "baud_ping" must be answered with BAUD_OK. On a
+BAUD_NAK or a timeout both sides stay at (or go back to) the old rate.
+The "set_baud <rate> VALID" (or INVALID) line the power module sends after
+BAUD_OK or BAUD_NAK is part of the negotiation and is not passed on.
+signalConnected is emitted once the negotiation has finished
+- The power module goes back to its default rate when it sees framing errors,
+so the proposal is sent twice before giving up
+- The port is owned by a SerialWorker in workerThread. Writes are queued to
+it without waiting. Received chunks are taken from its queue at most every
+DrainIntervalMs, so a fast stream updates the console and the widget about
+30 times a second, while a lone response is passed on as soon as it arrives
+- Record captures every chunk read and written to a file (see
+SessionRecorder). Replay passes a capture back through signalDataRead, the
+same path as the port, at 1x or as fast as possible. As fast as possible
+skips the console, so the time is spent parsing rather than drawing text
+- The port list ends with the local pm_broker endpoint, and another endpoint
+can be typed in. Through a broker the port is already open at its rate, so
+there is no DTR or baud rate negotiation and connecting is immediate
 ****************************************************************************/
 
 
 #include <QBoxLayout>
 #include <QComboBox>
 #include <QDebug>
+#include <QFileDialog>
 #include <QGroupBox>
 #include <QLabel>
 #include <QLineEdit>
@@ -21,11 +44,14 @@ Date:
 #include <QPlainTextEdit>
 #include <QPushButton>
 #include <QSerialPortInfo>
+#include <QThread>
 #include <QTimer>
 #include <windows.h>
 #include <initguid.h>
 #include <dbt.h>
 #include "serial.h"
+#include "serial_worker.h"
+#include "session_replay.h"
 
 
 EXTERN_C const GUID GUID_DEVINTERFACE_USB_DEVICE;
@@ -63,10 +89,16 @@ void Serial::addSerialPorts(void)
 
         serialPortComboBox->addItem(list.first(), list);
     }
+    serialPortComboBox->addItem(QString("tcp://127.0.0.1:%1").arg(SerialWorker::DefaultBrokerPort));
 
     if (bConnected)
     {
         int i = serialPortComboBox->findText(portName);
+        if (i == -1 && SerialWorker::isBrokerEndpoint(portName))
+        {
+            serialPortComboBox->addItem(portName);
+            i = serialPortComboBox->count() - 1;
+        }
         if (i != -1)
         {
             serialPortComboBox->setCurrentIndex(i);
@@ -89,6 +121,14 @@ void Serial::addSerialPortSetup(void)
     baudRateComboBox->addItem(QString("115200"), QSerialPort::Baud115200);
     baudRateComboBox->setCurrentIndex(3);
 
+    // Add the rates the power module can switch to after connecting
+    fastBaudRateComboBox->clear();
+    fastBaudRateComboBox->addItem(QString(tr("Off")), 0);
+    fastBaudRateComboBox->addItem(QString("115200"), 115200);
+    fastBaudRateComboBox->addItem(QString("230400"), 230400);
+    fastBaudRateComboBox->addItem(QString("460800"), 460800);
+    fastBaudRateComboBox->setCurrentIndex(3);
+
     // Add the data bits
     dataBitsComboBox->addItem(QString("5"), QSerialPort::Data5);
     dataBitsComboBox->addItem(QString("6"), QSerialPort::Data6);
@@ -128,6 +168,9 @@ QGroupBox *Serial::createSerialPortGroupBox(void)
 
     QLabel *serialPortLabel = new QLabel("Serial Port");
     serialPortComboBox = new QComboBox();
+    serialPortComboBox->setEditable(true);
+    serialPortComboBox->setInsertPolicy(QComboBox::NoInsert);
+    serialPortComboBox->setToolTip("A serial port, or a pm_broker as tcp://<host>:<port> or local:<name>");
 
     refreshButton = new QPushButton("Refresh");
 
@@ -149,12 +192,22 @@ QGroupBox *Serial::createSerialPortGroupBox(void)
     QLabel *flowControlLabel = new QLabel("Flow Control");
     flowControlComboBox = new QComboBox();
 
+    QLabel *fastBaudRateLabel = new QLabel("Fast Baud Rate");
+    fastBaudRateComboBox = new QComboBox();
+
     serialPortDataPlainTextEdit = new QPlainTextEdit();
 
     connectButton = new QPushButton("Connect");
     disconnectButton = new QPushButton("Disconnect");
     clearButton = new QPushButton("Clear Messages");
 
+    recordButton = new QPushButton("Record");
+    recordButton->setCheckable(true);
+
+    QLabel *replaySpeedLabel = new QLabel("Replay Speed");
+    replaySpeedComboBox = new QComboBox();
+    replayButton = new QPushButton("Replay");
+
     // Create the layout
     QHBoxLayout *portLayout = new QHBoxLayout;
     portLayout->addWidget(serialPortLabel);
@@ -178,7 +231,7 @@ QGroupBox *Serial::createSerialPortGroupBox(void)
     gLayout->addWidget(dataBitsComboBox, row, 2);
 
     row++;
-    gLayout->addWidget(serialPortDataPlainTextEdit, row, 0, 6, 1);
+    gLayout->addWidget(serialPortDataPlainTextEdit, row, 0, 10, 1);
     gLayout->addWidget(parityLabel, row, 1);
     gLayout->addWidget(parityComboBox, row, 2);
 
@@ -190,6 +243,10 @@ QGroupBox *Serial::createSerialPortGroupBox(void)
     gLayout->addWidget(flowControlLabel, row, 1);
     gLayout->addWidget(flowControlComboBox, row, 2);
 
+    row++;
+    gLayout->addWidget(fastBaudRateLabel, row, 1);
+    gLayout->addWidget(fastBaudRateComboBox, row, 2);
+
     row++;
     gLayout->addWidget(connectButton, row, 1, 1, 2);
 
@@ -199,12 +256,25 @@ QGroupBox *Serial::createSerialPortGroupBox(void)
     row++;
     gLayout->addWidget(clearButton, row, 1, 1, 2);
 
+    row++;
+    gLayout->addWidget(recordButton, row, 1, 1, 2);
+
+    row++;
+    gLayout->addWidget(replaySpeedLabel, row, 1);
+    gLayout->addWidget(replaySpeedComboBox, row, 2);
+
+    row++;
+    gLayout->addWidget(replayButton, row, 1, 1, 2);
+
     serialPortGroupBox->setLayout(gLayout);
 
     // Initialize the controls
     serialPortDataPlainTextEdit->setReadOnly(true);
     serialPortDataPlainTextEdit->setMaximumBlockCount(100);
 
+    replaySpeedComboBox->addItem(QString("1x"), true);
+    replaySpeedComboBox->addItem(QString(tr("Fastest")), false);
+
     // Add the ports
     addSerialPorts();
 
@@ -220,12 +290,95 @@ QGroupBox *Serial::createSerialPortGroupBox(void)
     connect(connectButton, SIGNAL(clicked()), this, SLOT(slotConnectSerialPort()));
     connect(disconnectButton, SIGNAL(clicked()), this, SLOT(slotDisconnectSerialPort()));
     connect(refreshButton, SIGNAL(clicked()), this, SLOT(slotRefreshSerialPorts()));
+    connect(recordButton, SIGNAL(toggled(bool)), this, SLOT(slotRecord(bool)));
+    connect(replayButton, SIGNAL(clicked()), this, SLOT(slotReplay()));
 
     return(serialPortGroupBox);
 
 }   // End of Serial::createSerialPortGroupBox
 
 
+/***************************************************************************
+Function to end the baud rate negotiation and report the connection
+****************************************************************************/
+void Serial::finishBaudNegotiation(bool bSwitched)
+{
+    qDebug() << "Serial::finishBaudNegotiation: bSwitched = " << bSwitched;
+
+    // What came after the last negotiation line is not part of it
+    QByteArray rest = baudData;
+
+    baudTimer->stop();
+    baudState = BAUD_IDLE;
+    baudData.clear();
+
+    serialPortStatusLineEdit->setText(QString("Connected (%1)").arg(baudRate));
+    emit signalConnected();
+
+    if (!rest.isEmpty())
+        emit signalDataRead(rest);
+
+}   // End of Serial::finishBaudNegotiation
+
+
+/***************************************************************************
+Function to handle the power module responses during the baud rate
+negotiation
+****************************************************************************/
+void Serial::handleBaudResponse(const QByteArray &data)
+{
+    int index;
+
+    baudData.append(data);
+
+    while ((index = baudData.indexOf("\r\n")) != -1)
+    {
+        QByteArray response = baudData.left(index);
+        baudData.remove(0, index + 2);
+
+        qDebug() << "Serial::handleBaudResponse: response = " << response;
+
+        if (baudState == BAUD_WAIT_ACK && response == QString("BAUD_ACK %1").arg(proposedBaudRate).toLatin1())
+        {
+            // The power module has already switched
+            bool bSet = false;
+            QMetaObject::invokeMethod(worker, "slotSetBaudRate", Qt::BlockingQueuedConnection,
+                                      Q_RETURN_ARG(bool, bSet), Q_ARG(qint32, proposedBaudRate));
+            if (!bSet)
+            {
+                baudData.clear();
+                finishBaudNegotiation(false);
+                return;
+            }
+            baudRate = proposedBaudRate;
+            baudData.clear();
+            baudState = BAUD_WAIT_OK;
+            baudTimer->start(1500);
+            write("baud_ping\r\n");
+            return;
+        }
+        else if (baudState == BAUD_WAIT_ACK && response.startsWith("BAUD_NAK"))
+        {
+            bBaudSwitched = false;
+            baudState = BAUD_WAIT_ECHO;
+            baudTimer->start(500);
+        }
+        else if (baudState == BAUD_WAIT_OK && response == QString("BAUD_OK %1").arg(proposedBaudRate).toLatin1())
+        {
+            bBaudSwitched = true;
+            baudState = BAUD_WAIT_ECHO;
+            baudTimer->start(500);
+        }
+        else if (baudState == BAUD_WAIT_ECHO && response.startsWith("set_baud "))
+        {
+            finishBaudNegotiation(bBaudSwitched);
+            return;
+        }
+    }
+
+}   // End of Serial::handleBaudResponse
+
+
 /***************************************************************************
 Function to override the nativeEvent virtual function in order to intercept
 the device change event and thereby handle cable insertion and removal
@@ -282,6 +435,30 @@ bool Serial::nativeEvent(const QByteArray &, void *messageIn, long *)
 }   // End of Serial::nativeEvent
 
 
+/***************************************************************************
+Function to show received data and pass it on, from the port or a replay
+****************************************************************************/
+void Serial::passReceived(const QByteArray &data, bool bDisplay)
+{
+    if (bDisplay)
+    {
+        QByteArray dataToDisplay = data;
+        dataToDisplay.replace('\r', "");
+        serialPortDataPlainTextEdit->moveCursor(QTextCursor::End);
+        serialPortDataPlainTextEdit->insertPlainText(dataToDisplay.data());
+    }
+
+    if (baudState != BAUD_IDLE)
+    {
+        handleBaudResponse(data);
+        return;
+    }
+
+    emit signalDataRead(data);
+
+}   // End of Serial::passReceived
+
+
 /***************************************************************************
 Serial constructor
 ****************************************************************************/
@@ -289,9 +466,29 @@ Serial::Serial(QWidget *parent) : QWidget(parent)
 {
     qDebug() << "Serial::Serial";
 
+    bBaudSwitched = false;
     bConnected = false;
+    baudState = BAUD_IDLE;
+    baudAttempts = 0;
+    baudRate = 0;
+    previousBaudRate = 0;
+    proposedBaudRate = 0;
+
+    // The worker has no parent so it can be moved, it is deleted with the thread
+    workerThread = new QThread(this);
+    worker = new SerialWorker;
+    worker->moveToThread(workerThread);
+    connect(workerThread, SIGNAL(finished()), worker, SLOT(deleteLater()));
+    workerThread->start();
+
+    baudTimer = new QTimer(this);
+    baudTimer->setSingleShot(true);
 
-    serialPort = new QSerialPort(this);
+    drainTimer = new QTimer(this);
+    drainTimer->setSingleShot(true);
+    drainElapsed.start();
+
+    replay = new SessionReplay(this);
 
     setUpDeviceNotifications();
 
@@ -307,14 +504,33 @@ Serial::Serial(QWidget *parent) : QWidget(parent)
     setConnectedState(DISCONNECTED);
 
     // Connect the signals and slots
-    connect(serialPort, SIGNAL(error(QSerialPort::SerialPortError)), this, SLOT(slotHandleSerialPortError(QSerialPort::SerialPortError)));
-    connect(serialPort, SIGNAL(readyRead()), this, SLOT(slotReadyRead()));
+    connect(worker, SIGNAL(signalError(int)), this, SLOT(slotHandleSerialPortError(int)));
+    connect(worker, SIGNAL(signalReceived()), this, SLOT(slotReceived()));
+    connect(baudTimer, SIGNAL(timeout()), this, SLOT(slotBaudTimeout()));
+    connect(drainTimer, SIGNAL(timeout()), this, SLOT(slotDrainReceived()));
+    connect(replay, SIGNAL(signalReceived(QByteArray)), this, SLOT(slotReplayReceived(QByteArray)));
+    connect(replay, SIGNAL(signalSent(QByteArray)), this, SLOT(slotReplaySent(QByteArray)));
+    connect(replay, SIGNAL(signalFinished(QString)), this, SLOT(slotReplayFinished(QString)));
     connect(this, SIGNAL(signalDeviceArrival()), this, SLOT(slotDeviceArrival()));
     connect(this, SIGNAL(signalDeviceRemoveComplete()), this, SLOT(slotDeviceRemoveComplete()));
 
 }   // End of Serial::Serial
 
 
+/***************************************************************************
+Serial destructor
+****************************************************************************/
+Serial::~Serial()
+{
+    qDebug() << "Serial::~Serial";
+
+    QMetaObject::invokeMethod(worker, "slotClose", Qt::BlockingQueuedConnection);
+    workerThread->quit();
+    workerThread->wait();
+
+}   // End of Serial::~Serial
+
+
 /***************************************************************************
 Function to disable/enable the GUI controls when not connected
 ****************************************************************************/
@@ -333,9 +549,12 @@ void Serial::setConnectedState(connectedEnum state)
     connectButton->setEnabled(!bState);
     disconnectButton->setEnabled(bState);
     refreshButton->setEnabled(!bState);
+    replayButton->setEnabled(!bState);
+    replaySpeedComboBox->setEnabled(!bState);
 
     baudRateComboBox->setEnabled(!bState);
     dataBitsComboBox->setEnabled(!bState);
+    fastBaudRateComboBox->setEnabled(!bState);
     flowControlComboBox->setEnabled(!bState);
     parityComboBox->setEnabled(!bState);
     serialPortComboBox->setEnabled(!bState);
@@ -364,6 +583,57 @@ void Serial::setUpDeviceNotifications(void)
 }   // End of Serial::setUpDeviceNotifications
 
 
+/***************************************************************************
+Function to ask the power module to switch to the fast baud rate
+****************************************************************************/
+void Serial::startBaudNegotiation(void)
+{
+    qDebug() << QString("Serial::startBaudNegotiation: %1 -> %2 (attempt %3)")
+                .arg(previousBaudRate).arg(proposedBaudRate).arg(baudAttempts + 1);
+
+    baudAttempts++;
+    baudData.clear();
+    baudState = BAUD_WAIT_ACK;
+    baudTimer->start(1000);
+    write(QString("set_baud %1\r\n").arg(proposedBaudRate));
+
+}   // End of Serial::startBaudNegotiation
+
+
+/***************************************************************************
+Slot to handle a baud rate negotiation timeout
+****************************************************************************/
+void Serial::slotBaudTimeout(void)
+{
+    qDebug() << "Serial::slotBaudTimeout: baudState = " << baudState;
+
+    if (baudState == BAUD_WAIT_ACK)
+    {
+        // The first proposal may only have put the power module back to its
+        // default rate
+        if (baudAttempts < 2)
+            startBaudNegotiation();
+        else
+            finishBaudNegotiation(false);
+    }
+    else if (baudState == BAUD_WAIT_OK)
+    {
+        // The power module goes back to the old rate on its own
+        QMetaObject::invokeMethod(worker, "slotSetBaudRate", Qt::QueuedConnection, Q_ARG(qint32, previousBaudRate));
+        QMetaObject::invokeMethod(worker, "slotClear", Qt::QueuedConnection);
+        baudRate = previousBaudRate;
+        baudData.clear();
+        finishBaudNegotiation(false);
+    }
+    else if (baudState == BAUD_WAIT_ECHO)
+    {
+        // The rate is settled, only the echo is missing
+        finishBaudNegotiation(bBaudSwitched);
+    }
+
+}   // End of Serial::slotBaudTimeout
+
+
 /***************************************************************************
 Slot to clear the messages from the serial port QPlainTextEdit display
 ****************************************************************************/
@@ -383,50 +653,26 @@ void Serial::slotConnectSerialPort(void)
 {
     qDebug() << "Serial::slotConnectSerialPort";
 
+    QString name = serialPortComboBox->currentText().trimmed();
+    bool bBroker = SerialWorker::isBrokerEndpoint(name);
+
     // If there is no serial device connected, don't try to connect
-    if (serialPortComboBox->currentText() == "")
+    if (name == "")
     {
         QMessageBox::information(this, "Serial", tr("There is no serial device connected."));
         return;
     }
 
-    qint32 baudRate = static_cast<QSerialPort::BaudRate>(baudRateComboBox->itemData(baudRateComboBox->currentIndex()).toInt());
+    qint32 selectedBaudRate = static_cast<QSerialPort::BaudRate>(baudRateComboBox->itemData(baudRateComboBox->currentIndex()).toInt());
     QSerialPort::DataBits dataBits = static_cast<QSerialPort::DataBits>(dataBitsComboBox->itemData(dataBitsComboBox->currentIndex()).toInt());
     QSerialPort::Parity parity = static_cast<QSerialPort::Parity>(parityComboBox->itemData(parityComboBox->currentIndex()).toInt());
     QSerialPort::StopBits stopBits = static_cast<QSerialPort::StopBits>(stopBitsComboBox->itemData(stopBitsComboBox->currentIndex()).toInt());
     QSerialPort::FlowControl flowControl = static_cast<QSerialPort::FlowControl>(flowControlComboBox->itemData(flowControlComboBox->currentIndex()).toInt());
 
-    serialPort->setPortName(serialPortComboBox->currentText());
-    if (!serialPort->setBaudRate(baudRate))
-    {
-        QMessageBox::warning(this, "Serial", serialPort->errorString());
-        return;
-    }
-    if (!serialPort->setDataBits(dataBits))
-    {
-        QMessageBox::warning(this, "Serial", serialPort->errorString());
-        return;
-    }
-    if (!serialPort->setParity(parity))
-    {
-        QMessageBox::warning(this, "Serial", serialPort->errorString());
-        return;
-    }
-    if (!serialPort->setStopBits(stopBits))
-    {
-        QMessageBox::warning(this, "Serial", serialPort->errorString());
-        return;
-    }
-    if (!serialPort->setFlowControl(flowControl))
-    {
-        QMessageBox::warning(this, "Serial", serialPort->errorString());
-        return;
-    }
-
     qDebug() << QString("Serial::slotConnectSerialPort:  Connecting to serial device on %1:  %2 (%3), %4 (%5), %6 (%7), %8 (%9), %10 (%11) ...")
-                .arg(serialPortComboBox->currentText())
+                .arg(name)
                 .arg(baudRateComboBox->currentText())
-                .arg(baudRate)
+                .arg(selectedBaudRate)
                 .arg(dataBitsComboBox->currentText())
                 .arg(dataBits)
                 .arg(parityComboBox->currentText())
@@ -436,23 +682,36 @@ void Serial::slotConnectSerialPort(void)
                 .arg(flowControlComboBox->currentText())
                 .arg(flowControl);
 
-    if (serialPort->open(QIODevice::ReadWrite))
-    {
-        // Atmel-42096-Microcontrollers-Embedded-Debugger_User-Guide.pdf
-        // Note that the UART pins of the EDBG are tri-stated when no terminal program is connected to the Virtual
-        // COM Port on the computer. This mechanism relies on the terminal program sending a DTR signal.
-        serialPort->setDataTerminalReady(true);
+    // The worker sets DTR and clears the port once it is open
+    QString error;
+    QMetaObject::invokeMethod(worker, "slotOpen", Qt::BlockingQueuedConnection, Q_RETURN_ARG(QString, error),
+                              Q_ARG(QString, name), Q_ARG(qint32, selectedBaudRate),
+                              Q_ARG(int, dataBits), Q_ARG(int, parity), Q_ARG(int, stopBits), Q_ARG(int, flowControl));
 
-        serialPort->clear();
+    if (error.isEmpty())
+    {
+        baudRate = selectedBaudRate;
         serialPortStatusLineEdit->setText("Connected");
         setConnectedState(CONNECTED);
         bConnected = true;
-        portName = serialPortComboBox->currentText();
-        emit signalConnected();
+        portName = name;
+
+        // Switch to the fast baud rate before reporting the connection, the
+        // broker keeps the rate it opened the port at
+        previousBaudRate = baudRate;
+        proposedBaudRate = fastBaudRateComboBox->itemData(fastBaudRateComboBox->currentIndex()).toInt();
+        baudAttempts = 0;
+        if (!bBroker && proposedBaudRate != 0 && proposedBaudRate != baudRate)
+        {
+            serialPortStatusLineEdit->setText("Negotiating");
+            startBaudNegotiation();
+        }
+        else
+            emit signalConnected();
     }
     else
     {
-        QMessageBox::warning(this, "Serial", serialPort->errorString());
+        QMessageBox::warning(this, "Serial", error);
     }
 }   // End of Serial::slotConnectSerialPort
 
@@ -490,8 +749,17 @@ void Serial::slotDisconnectSerialPort(void)
 {
     qDebug() << "Serial::slotDisconnectSerialPort";
 
-    if (serialPort->isOpen())
-        serialPort->close();
+    baudTimer->stop();
+    baudState = BAUD_IDLE;
+
+    // Nothing received before the port closed is passed on
+    QMetaObject::invokeMethod(worker, "slotClose", Qt::BlockingQueuedConnection);
+    drainTimer->stop();
+    SerialWorker::Chunk chunk;
+    worker->acknowledge();
+    while (worker->takeChunk(chunk))
+        ;
+
     serialPortStatusLineEdit->setText("Disconnected");
     slotRefreshSerialPorts();
     setConnectedState(DISCONNECTED);
@@ -504,7 +772,7 @@ void Serial::slotDisconnectSerialPort(void)
 /***************************************************************************
 Slot to display an serial device connection error
 ****************************************************************************/
-void Serial::slotHandleSerialPortError(QSerialPort::SerialPortError error)
+void Serial::slotHandleSerialPortError(int error)
 {
     bool bError = true;
 
@@ -563,23 +831,86 @@ void Serial::slotHandleSerialPortError(QSerialPort::SerialPortError error)
 
 
 /***************************************************************************
-Slot to read data from the connected device
+Slot to take the received chunks from the worker, show them and pass them
+on as one block
 ****************************************************************************/
-void Serial::slotReadyRead(void)
+void Serial::slotDrainReceived(void)
 {
-    QByteArray data = serialPort->readAll();
+    SerialWorker::Chunk chunk;
+    QByteArray data;
 
-//    qDebug() << "Serial::slotReadyRead: data =" << data;
+    drainTimer->stop();
+    drainElapsed.restart();
 
-    QByteArray dataToDisplay = data;
-    dataToDisplay.replace('\r', "");
-//    serialPortDataPlainTextEdit->appendPlainText(data.data());
-    serialPortDataPlainTextEdit->moveCursor(QTextCursor::End);
-    serialPortDataPlainTextEdit->insertPlainText(dataToDisplay.data());
+    // Acknowledged first, so a chunk queued while draining signals again
+    worker->acknowledge();
+    while (worker->takeChunk(chunk))
+        data.append(chunk.data);
 
-    emit signalDataRead(data);
+    if (data.isEmpty() || !bConnected)
+        return;
+
+//    qDebug() << "Serial::slotDrainReceived: data =" << data;
+
+    passReceived(data, true);
 
-}   // End of Serial::slotReadyRead
+}   // End of Serial::slotDrainReceived
+
+
+/***************************************************************************
+Slot to respond when the worker has queued data, which is taken now unless
+the last block was taken less than DrainIntervalMs ago
+****************************************************************************/
+void Serial::slotReceived(void)
+{
+    if (drainTimer->isActive())
+        return;
+
+    qint64 elapsed = drainElapsed.elapsed();
+    if (elapsed >= DrainIntervalMs)
+        slotDrainReceived();
+    else
+        drainTimer->start(DrainIntervalMs - int(elapsed));
+
+}   // End of Serial::slotReceived
+
+
+/***************************************************************************
+Slot to start or end capturing the traffic to a file
+****************************************************************************/
+void Serial::slotRecord(bool bChecked)
+{
+    qDebug() << "Serial::slotRecord: bChecked =" << bChecked;
+
+    if (!bChecked)
+    {
+        QMetaObject::invokeMethod(worker, "slotStopRecording", Qt::BlockingQueuedConnection);
+        recordButton->setText("Record");
+        return;
+    }
+
+    QString fileName = QFileDialog::getSaveFileName(this, "Record Serial Session", "pm_session.pmcap",
+                                                    "Capture Files (*.pmcap)");
+    QString error = "No file selected";
+    if (!fileName.isEmpty())
+        QMetaObject::invokeMethod(worker, "slotStartRecording", Qt::BlockingQueuedConnection,
+                                  Q_RETURN_ARG(QString, error), Q_ARG(QString, fileName));
+
+    if (!error.isEmpty())
+    {
+        if (!fileName.isEmpty())
+            QMessageBox::warning(this, "Serial", error);
+
+        // Unchecked without stopping a capture that never started
+        recordButton->blockSignals(true);
+        recordButton->setChecked(false);
+        recordButton->blockSignals(false);
+        return;
+    }
+
+    recordButton->setText("Stop Recording");
+
+}   // End of Serial::slotRecord
 
 
 /***************************************************************************
@@ -594,13 +925,94 @@ void Serial::slotRefreshSerialPorts(void)
 }   // End of Serial::slotRefreshSerialPorts()
 
 
+/***************************************************************************
+Slot to start replaying a capture, or to end the replay
+****************************************************************************/
+void Serial::slotReplay(void)
+{
+    qDebug() << "Serial::slotReplay";
+
+    if (replay->isActive())
+    {
+        replay->stop();
+        slotReplayFinished("Replay stopped");
+        return;
+    }
+
+    QString fileName = QFileDialog::getOpenFileName(this, "Replay Serial Session", QString(),
+                                                    "Capture Files (*.pmcap);;All Files (*)");
+    if (fileName.isEmpty())
+        return;
+
+    QString error = replay->open(fileName);
+    if (!error.isEmpty())
+    {
+        QMessageBox::warning(this, "Serial", error);
+        return;
+    }
+
+    bool bRealTime = replaySpeedComboBox->itemData(replaySpeedComboBox->currentIndex()).toBool();
+
+    connectButton->setEnabled(false);
+    replaySpeedComboBox->setEnabled(false);
+    replayButton->setText("Stop Replay");
+    serialPortStatusLineEdit->setText("Replaying");
+
+    replay->start(bRealTime);
+
+}   // End of Serial::slotReplay
+
+
+/***************************************************************************
+Slot to report the end of a replay
+****************************************************************************/
+void Serial::slotReplayFinished(QString summary)
+{
+    qDebug() << "Serial::slotReplayFinished:" << summary;
+
+    serialPortDataPlainTextEdit->moveCursor(QTextCursor::End);
+    serialPortDataPlainTextEdit->insertPlainText(QString("\n%1\n").arg(summary));
+
+    connectButton->setEnabled(true);
+    replaySpeedComboBox->setEnabled(true);
+    replayButton->setText("Replay");
+    serialPortStatusLineEdit->setText("Disconnected");
+
+}   // End of Serial::slotReplayFinished
+
+
+/***************************************************************************
+Slot to pass on a replayed chunk as if it had been read from the port
+****************************************************************************/
+void Serial::slotReplayReceived(QByteArray data)
+{
+    passReceived(data, replaySpeedComboBox->itemData(replaySpeedComboBox->currentIndex()).toBool());
+
+}   // End of Serial::slotReplayReceived
+
+
+/***************************************************************************
+Slot to show a replayed command in the console, at 1x only
+****************************************************************************/
+void Serial::slotReplaySent(QByteArray data)
+{
+    if (!replaySpeedComboBox->itemData(replaySpeedComboBox->currentIndex()).toBool())
+        return;
+
+    QByteArray dataToDisplay = data;
+    dataToDisplay.replace('\r', "");
+    serialPortDataPlainTextEdit->moveCursor(QTextCursor::End);
+    serialPortDataPlainTextEdit->insertPlainText(QString("> %1").arg(QString::fromLatin1(dataToDisplay)));
+
+}   // End of Serial::slotReplaySent
+
+
 /***************************************************************************
 Function to send a command via the serial port
 ****************************************************************************/
 void Serial::write(QString command)
 {
-    serialPort->write(command.toLatin1());
-    serialPort->flush();
+    QMetaObject::invokeMethod(worker, "slotWrite", Qt::QueuedConnection, Q_ARG(QByteArray, command.toLatin1()));
 
 }   // End of Serial::write
 
@@ -15,6 +15,7 @@ Date:
 #define SERIAL_H
 
 
+#include <QElapsedTimer>
 #include <QSerialPort>
 #include <QWidget>
 
@@ -24,6 +25,10 @@ class QGroupBox;
 class QLineEdit;
 class QPlainTextEdit;
 class QPushButton;
+class QThread;
+class QTimer;
+class SerialWorker;
+class SessionReplay;
 
 
 class Serial : public QWidget
@@ -33,6 +38,10 @@ class Serial : public QWidget
 public:
 
     explicit Serial(QWidget *parent = nullptr);
+    ~Serial();
+
+public slots:
+
     void write(QString);
 
 signals:
@@ -49,30 +58,54 @@ protected:
 
 private slots:
 
+    void slotBaudTimeout(void);
     void slotClearMessages(void);
     void slotConnectSerialPort(void);
     void slotDeviceArrival(void);
     void slotDeviceRemoveComplete(void);
     void slotDisconnectSerialPort(void);
-    void slotHandleSerialPortError(QSerialPort::SerialPortError);
-    void slotReadyRead(void);
+    void slotDrainReceived(void);
+    void slotHandleSerialPortError(int);
+    void slotReceived(void);
+    void slotRecord(bool);
     void slotRefreshSerialPorts(void);
+    void slotReplay(void);
+    void slotReplayFinished(QString);
+    void slotReplayReceived(QByteArray);
+    void slotReplaySent(QByteArray);
 
 private:
 
     enum connectedEnum {DISCONNECTED, CONNECTED};
+    enum baudStateEnum {BAUD_IDLE, BAUD_WAIT_ACK, BAUD_WAIT_OK, BAUD_WAIT_ECHO};
+
+    // Received data is shown and passed on at most this often (about 30 Hz)
+    static const int DrainIntervalMs = 33;
 
     void addSerialPorts(void);
     void addSerialPortSetup(void);
     QGroupBox *createSerialPortGroupBox(void);
+    void finishBaudNegotiation(bool);
+    void handleBaudResponse(const QByteArray &);
+    void passReceived(const QByteArray &, bool);
     void setConnectedState(connectedEnum state);
     void setUpDeviceNotifications(void);
+    void startBaudNegotiation(void);
 
+    bool bBaudSwitched;
     bool bConnected;
+    baudStateEnum baudState;
+    int baudAttempts;
+    qint32 baudRate;
+    qint32 previousBaudRate;
+    qint32 proposedBaudRate;
+    QByteArray baudData;
     QComboBox *baudRateComboBox;
     QComboBox *dataBitsComboBox;
+    QComboBox *fastBaudRateComboBox;
     QComboBox *flowControlComboBox;
     QComboBox *parityComboBox;
+    QComboBox *replaySpeedComboBox;
     QComboBox *serialPortComboBox;
     QComboBox *stopBitsComboBox;
     QLineEdit *serialPortStatusLineEdit;
@@ -80,9 +113,16 @@ private:
     QPushButton *clearButton;
     QPushButton *connectButton;
     QPushButton *disconnectButton;
+    QPushButton *recordButton;
     QPushButton *refreshButton;
-    QSerialPort *serialPort;
+    QPushButton *replayButton;
+    QElapsedTimer drainElapsed;
     QString portName;
+    QThread *workerThread;
+    QTimer *baudTimer;
+    QTimer *drainTimer;
+    SerialWorker *worker;
+    SessionReplay *replay;
 
 };
 
@@ -0,0 +1,489 @@
+/***************************************************************************
+trend_chart.cpp:  Sensor trend chart class functions
+
+Written by:
+    Sandra Mercer, P.Eng.
+    Engineer / Software Developer
+    eSonar Inc.
+
+Date:
+    November 2022
+
+Note(s):
+- Each channel is drawn in its own lane, scaled to the samples in view.
+The samples are kept in a SampleBuffer and reduced to one minimum and
+maximum per pixel column before drawing, so a frame takes about the same
+time for a minute or for hours of history
+- Samples are timed by the chart when they are added
+- Drag to pan and use the wheel to zoom about the cursor. The view follows
+the newest samples until it is panned back, a double click returns to the
+newest samples at the default span
+- The chart is redrawn at most every RefreshIntervalMs, and only when it
+has new samples, has been moved, or is following the newest samples
+- showHistory() draws a SeriesReader store instead, with one series name
+per channel. Each frame queries only the span in view at one point per
+pixel column, so the store can be far larger than memory. A double click
+maps anything added to the store since and shows all of it again
+****************************************************************************/
+
+
+#include <QDateTime>
+#include <QMouseEvent>
+#include <QPainter>
+#include <QPolygonF>
+#include <QTimer>
+#include <QWheelEvent>
+#include "trend_chart.h"
+
+
+// Local function(s)
+static QString formatSpan(qint64);
+
+
+/***************************************************************************
+Local function to return a time span as text, in the largest sensible unit
+****************************************************************************/
+static QString formatSpan(qint64 ms)
+{
+    if (ms < 120000)
+        return (QString("%1 s").arg(ms / 1000.0, 0, 'f', (ms < 10000) ? 1 : 0));
+    else if (ms < 2 * 3600000)
+        return (QString("%1 min").arg(ms / 60000.0, 0, 'f', 1));
+    else if (ms < 2 * 86400000ll)
+        return (QString("%1 h").arg(ms / 3600000.0, 0, 'f', 1));
+    else
+        return (QString("%1 d").arg(ms / 86400000.0, 0, 'f', 1));
+
+}   // End of formatSpan
+
+
+/***************************************************************************
+TrendChart constructor
+****************************************************************************/
+TrendChart::TrendChart(QWidget *parent) : QWidget(parent)
+{
+    bDirty = false;
+    bFollow = true;
+    spanMs = DefaultSpanMs;
+    endMs = 0;
+    pressX = 0;
+    pressEndMs = 0;
+    reader = nullptr;
+
+    setToolTip("Drag to pan, wheel to zoom, double click to follow the newest samples");
+    setMinimumHeight(160);
+
+    clock.start();
+
+    refreshTimer = new QTimer(this);
+    connect(refreshTimer, SIGNAL(timeout()), this, SLOT(slotRefresh()));
+    refreshTimer->start(RefreshIntervalMs);
+
+}   // End of TrendChart::TrendChart
+
+
+/***************************************************************************
+Function to add a channel, returns its number for addSample()
+****************************************************************************/
+int TrendChart::addChannel(const QString &name, const QString &unit, const QColor &color, int decimals)
+{
+    Channel channel;
+
+    channel.name = name;
+    channel.unit = unit;
+    channel.color = color;
+    channel.decimals = decimals;
+    channels.append(channel);
+
+    return (channels.size() - 1);
+
+}   // End of TrendChart::addChannel
+
+
+/***************************************************************************
+Function to add a sample to a channel, timed now
+****************************************************************************/
+void TrendChart::addSample(int channel, double value)
+{
+    if (channel < 0 || channel >= channels.size())
+        return;
+
+    channels[channel].samples.append(clock.elapsed(), float(value));
+    bDirty = true;
+
+}   // End of TrendChart::addSample
+
+
+/***************************************************************************
+Function to discard the samples of every channel
+****************************************************************************/
+void TrendChart::clear(void)
+{
+    for (Channel &channel : channels)
+        channel.samples.clear();
+
+    bDirty = true;
+
+}   // End of TrendChart::clear
+
+
+/***************************************************************************
+Function to reduce a channel's samples, or its series in the store, from
+start up to end to one range per column
+****************************************************************************/
+void TrendChart::fillColumns(int channel, qint64 start, qint64 end)
+{
+    if (reader == nullptr)
+    {
+        channels.at(channel).samples.decimate(start, end, columns);
+        return;
+    }
+
+    for (SampleBuffer::Column &column : columns)
+        column.bValid = false;
+
+    if (channel >= seriesNames.size() || end <= start ||
+        !reader->query(seriesNames.at(channel), start, end, columns.size(), points))
+        return;
+
+    for (const SeriesReader::Point &point : points)
+    {
+        int x = int((point.timeMs - start) * columns.size() / (end - start));
+        if (x < 0 || x >= columns.size())
+            continue;
+
+        SampleBuffer::Column &column = columns[x];
+        column.min = column.bValid ? qMin(column.min, point.min) : point.min;
+        column.max = column.bValid ? qMax(column.max, point.max) : point.max;
+        column.bValid = true;
+    }
+
+}   // End of TrendChart::fillColumns
+
+
+/***************************************************************************
+Function to return the widest span the view can be zoomed out to
+****************************************************************************/
+qint64 TrendChart::maximumSpanMs(void) const
+{
+    qint64 first;
+    qint64 last;
+    qint64 span = MaximumSpanMs;
+
+    if (reader != nullptr)
+    {
+        for (const QString &name : seriesNames)
+        {
+            if (reader->range(name, first, last))
+                span = qMax(span, last - first + 1);
+        }
+    }
+
+    return (span);
+
+}   // End of TrendChart::maximumSpanMs
+
+
+/***************************************************************************
+Function to draw a store instead of the samples, name i is the series of
+channel i
+****************************************************************************/
+void TrendChart::showHistory(SeriesReader *reader, const QStringList &names)
+{
+    this->reader = reader;
+    seriesNames = names;
+
+    showWholeHistory();
+
+}   // End of TrendChart::showHistory
+
+
+/***************************************************************************
+Function to go back to drawing the samples, following the newest
+****************************************************************************/
+void TrendChart::showLive(void)
+{
+    reader = nullptr;
+    seriesNames.clear();
+    points.clear();
+
+    bFollow = true;
+    spanMs = DefaultSpanMs;
+    bDirty = true;
+
+}   // End of TrendChart::showLive
+
+
+/***************************************************************************
+Function to fit the whole store in the view
+****************************************************************************/
+void TrendChart::showWholeHistory(void)
+{
+    qint64 first;
+    qint64 last;
+    bool bAny = false;
+    qint64 start = 0;
+    qint64 end = 0;
+
+    reader->refresh();
+    for (const QString &name : seriesNames)
+    {
+        if (!reader->range(name, first, last))
+            continue;
+
+        start = bAny ? qMin(start, first) : first;
+        end = bAny ? qMax(end, last + 1) : last + 1;
+        bAny = true;
+    }
+
+    bFollow = false;
+    endMs = bAny ? end : QDateTime::currentMSecsSinceEpoch();
+    spanMs = bAny ? qMax(qint64(MinimumSpanMs), end - start) : DefaultSpanMs;
+    bDirty = true;
+
+}   // End of TrendChart::showWholeHistory
+
+
+/***************************************************************************
+Function to return the preferred size of the chart
+****************************************************************************/
+QSize TrendChart::sizeHint(void) const
+{
+    return (QSize(640, 80 * qMax(channels.size(), 1)));
+
+}   // End of TrendChart::sizeHint
+
+
+/***************************************************************************
+Event handler to return to the newest samples at the default span
+****************************************************************************/
+void TrendChart::mouseDoubleClickEvent(QMouseEvent *event)
+{
+    if (reader != nullptr)
+        showWholeHistory();
+    else
+    {
+        bFollow = true;
+        spanMs = DefaultSpanMs;
+        bDirty = true;
+    }
+
+    event->accept();
+
+}   // End of TrendChart::mouseDoubleClickEvent
+
+
+/***************************************************************************
+Event handler to pan the view while the left button is held
+****************************************************************************/
+void TrendChart::mouseMoveEvent(QMouseEvent *event)
+{
+    if (!(event->buttons() & Qt::LeftButton) || width() <= 0)
+        return;
+
+    qint64 end = pressEndMs - qint64(event->x() - pressX) * spanMs / width();
+
+    // Dragged up to the newest samples, follow them again
+    bFollow = (reader == nullptr) && (end >= clock.elapsed());
+    endMs = end;
+    bDirty = true;
+
+    event->accept();
+
+}   // End of TrendChart::mouseMoveEvent
+
+
+/***************************************************************************
+Event handler to start panning the view
+****************************************************************************/
+void TrendChart::mousePressEvent(QMouseEvent *event)
+{
+    pressX = event->x();
+    pressEndMs = viewEndMs();
+
+    event->accept();
+
+}   // End of TrendChart::mousePressEvent
+
+
+/***************************************************************************
+Event handler to draw the channels
+****************************************************************************/
+void TrendChart::paintEvent(QPaintEvent *)
+{
+    QPainter painter(this);
+    const int margin = 4;
+    int labelHeight = fontMetrics().height();
+
+    painter.fillRect(rect(), palette().base());
+
+    QRect plot = rect().adjusted(margin, margin, -margin, -(margin + labelHeight));
+    if (channels.isEmpty() || plot.width() <= 0 || plot.height() < channels.size())
+        return;
+
+    qint64 end = viewEndMs();
+    qint64 start = end - spanMs;
+    int laneHeight = plot.height() / channels.size();
+
+    columns.resize(plot.width());
+
+    QPolygonF trace;
+    trace.reserve(2 * plot.width());
+
+    for (int i = 0; i < channels.size(); i++)
+    {
+        const Channel &channel = channels.at(i);
+        QRect lane(plot.left(), plot.top() + i * laneHeight, plot.width(), laneHeight);
+
+        painter.setPen(palette().mid().color());
+        painter.drawRect(lane.adjusted(0, 0, -1, -1));
+
+        fillColumns(i, start, end);
+
+        // Scale the lane to the samples in view
+        bool bAny = false;
+        float low = 0.0f;
+        float high = 0.0f;
+        for (const SampleBuffer::Column &column : columns)
+        {
+            if (!column.bValid)
+                continue;
+
+            low = bAny ? qMin(low, column.min) : column.min;
+            high = bAny ? qMax(high, column.max) : column.max;
+            bAny = true;
+        }
+
+        if (bAny)
+        {
+            if (high - low < 1e-6f)
+            {
+                low -= 0.5f;
+                high += 0.5f;
+            }
+            float pad = (high - low) * 0.05f;
+            low -= pad;
+            high += pad;
+
+            double scale = (lane.height() - 1) / double(high - low);
+            double bottom = lane.top() + lane.height() - 1;
+
+            // Two points per column, ordered so the trace does not cross itself
+            trace.clear();
+            for (int x = 0; x < columns.size(); x++)
+            {
+                const SampleBuffer::Column &column = columns.at(x);
+                if (!column.bValid)
+                    continue;
+
+                double yMin = bottom - (column.min - low) * scale;
+                double yMax = bottom - (column.max - low) * scale;
+                double px = lane.left() + x;
+
+                if (trace.isEmpty() || qAbs(trace.last().y() - yMin) <= qAbs(trace.last().y() - yMax))
+                {
+                    trace.append(QPointF(px, yMin));
+                    trace.append(QPointF(px, yMax));
+                }
+                else
+                {
+                    trace.append(QPointF(px, yMax));
+                    trace.append(QPointF(px, yMin));
+                }
+            }
+
+            painter.setPen(channel.color);
+            painter.drawPolyline(trace);
+
+            painter.setPen(palette().text().color());
+            painter.drawText(lane.adjusted(4, 2, -4, -2), Qt::AlignRight | Qt::AlignTop,
+                             QString::number(high, 'f', channel.decimals));
+            painter.drawText(lane.adjusted(4, 2, -4, -2), Qt::AlignRight | Qt::AlignBottom,
+                             QString::number(low, 'f', channel.decimals));
+        }
+
+        QString label = QString("%1 (%2)").arg(channel.name).arg(channel.unit);
+        if (reader == nullptr && channel.samples.size() > 0)
+            label += QString("  %1").arg(channel.samples.lastValue(), 0, 'f', channel.decimals);
+
+        painter.setPen(palette().text().color());
+        painter.drawText(lane.adjusted(4, 2, -4, -2), Qt::AlignLeft | Qt::AlignTop, label);
+    }
+
+    // Time axis, relative to now, or the dates of the history in view
+    QRect axis(plot.left(), plot.bottom() + 1, plot.width(), labelHeight);
+    painter.setPen(palette().text().color());
+    if (reader != nullptr)
+    {
+        const QString format("yyyy-MM-dd hh:mm:ss");
+        painter.drawText(axis, Qt::AlignLeft | Qt::AlignVCenter, QDateTime::fromMSecsSinceEpoch(start).toString(format));
+        painter.drawText(axis, Qt::AlignHCenter | Qt::AlignVCenter, formatSpan(spanMs));
+        painter.drawText(axis, Qt::AlignRight | Qt::AlignVCenter, QDateTime::fromMSecsSinceEpoch(end).toString(format));
+        return;
+    }
+    painter.drawText(axis, Qt::AlignLeft | Qt::AlignVCenter,
+                     QString("-%1").arg(formatSpan(clock.elapsed() - start)));
+    painter.drawText(axis, Qt::AlignRight | Qt::AlignVCenter,
+                     bFollow ? QString("now") : QString("-%1").arg(formatSpan(clock.elapsed() - end)));
+
+}   // End of TrendChart::paintEvent
+
+
+/***************************************************************************
+Event handler to zoom about the cursor
+****************************************************************************/
+void TrendChart::wheelEvent(QWheelEvent *event)
+{
+    if (event->angleDelta().y() == 0 || width() <= 0)
+        return;
+
+    double factor = (event->angleDelta().y() > 0) ? 0.8 : 1.25;
+    qint64 span = qBound(qint64(MinimumSpanMs), qint64(spanMs * factor), maximumSpanMs());
+
+    // Keep the time under the cursor in place, following keeps the newest
+    // samples at the right instead
+    if (!bFollow)
+    {
+        double fraction = qBound(0.0, event->position().x() / width(), 1.0);
+        qint64 anchor = endMs - spanMs + qint64(fraction * spanMs);
+        endMs = anchor + qint64((1.0 - fraction) * span);
+    }
+
+    spanMs = span;
+    bDirty = true;
+
+    event->accept();
+
+}   // End of TrendChart::wheelEvent
+
+
+/***************************************************************************
+Slot to redraw the chart when it has changed
+****************************************************************************/
+void TrendChart::slotRefresh(void)
+{
+    if (!isVisible())
+        return;
+
+    bool bData = false;
+    for (const Channel &channel : channels)
+        bData = bData || (channel.samples.size() > 0);
+
+    // Following moves the time axis even without new samples
+    if (bDirty || (bFollow && bData))
+    {
+        bDirty = false;
+        update();
+    }
+
+}   // End of TrendChart::slotRefresh
+
+
+/***************************************************************************
+Function to return the time at the right of the view
+****************************************************************************/
+qint64 TrendChart::viewEndMs(void) const
+{
+    return (bFollow ? clock.elapsed() : endMs);
+
+}   // End of TrendChart::viewEndMs
@@ -0,0 +1,105 @@
+/***************************************************************************
+trend_chart.h: Include file for trend_chart.cpp
+
+Written by:
+    Sandra Mercer, P.Eng.
+    Engineer / Software Developer
+    eSonar Inc.
+
+Date:
+    November 2022
+****************************************************************************/
+
+
+#ifndef TREND_CHART_H
+#define TREND_CHART_H
+
+
+#include <QColor>
+#include <QElapsedTimer>
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include <QWidget>
+#include "sample_buffer.h"
+#include "series_reader.h"
+
+
+class QTimer;
+
+
+class TrendChart : public QWidget
+{
+    Q_OBJECT
+
+public:
+
+    static const int RefreshIntervalMs = 16;        // About 60 frames per second
+    static const qint64 DefaultSpanMs = 60000;
+    static const qint64 MinimumSpanMs = 1000;
+    static const qint64 MaximumSpanMs = 24 * 3600 * 1000;
+
+    explicit TrendChart(QWidget *parent = nullptr);
+
+    int addChannel(const QString &, const QString &, const QColor &, int);
+    void addSample(int, double);
+    void clear(void);
+
+    void showHistory(SeriesReader *, const QStringList &);
+    void showLive(void);
+
+    virtual QSize sizeHint(void) const;
+
+protected:
+
+    virtual void mouseDoubleClickEvent(QMouseEvent *);
+    virtual void mouseMoveEvent(QMouseEvent *);
+    virtual void mousePressEvent(QMouseEvent *);
+    virtual void paintEvent(QPaintEvent *);
+    virtual void wheelEvent(QWheelEvent *);
+
+private slots:
+
+    void slotRefresh(void);
+
+private:
+
+    struct Channel
+    {
+        QString name;
+        QString unit;
+        QColor color;
+        int decimals;
+        SampleBuffer samples;
+    };
+
+    void fillColumns(int, qint64, qint64);
+    qint64 maximumSpanMs(void) const;
+    void showWholeHistory(void);
+    qint64 viewEndMs(void) const;
+
+    QList<Channel> channels;
+    QVector<SampleBuffer::Column> columns;
+
+    QElapsedTimer clock;
+    QTimer *refreshTimer;
+    bool bDirty;
+
+    // The view follows the newest samples until it is panned
+    bool bFollow;
+    qint64 spanMs;
+    qint64 endMs;
+
+    int pressX;
+    qint64 pressEndMs;
+
+    // History is read from a store rather than the samples, times are then
+    // ms since the epoch
+    SeriesReader *reader;
+    QStringList seriesNames;
+    QVector<SeriesReader::Point> points;
+
+};
+
+
+#endif // TREND_CHART_H
@@ -0,0 +1,18 @@
+# Power module Qt programs and their tests
+#
+#   qmake && make && make check
+
+TEMPLATE = subdirs
+
+SUBDIRS += \
+    pm_gui \
+    pm_daemon \
+    pm_bench \
+    pm_broker \
+    tests/broker_router \
+    tests/record_writer \
+    tests/response_parser \
+    tests/sample_buffer \
+    tests/series_store \
+    tests/session_capture \
+    tests/telemetry_decoder
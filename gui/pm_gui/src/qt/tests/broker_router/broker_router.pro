@@ -0,0 +1,18 @@
+QT       += core testlib
+QT       -= gui
+
+CONFIG += c++11 console testcase
+CONFIG -= app_bundle
+
+TARGET = tst_broker_router
+
+INCLUDEPATH += ../../pm_broker
+
+SOURCES += \
+    tst_broker_router.cpp \
+    ../../pm_broker/broker_router.cpp
+
+HEADERS += \
+    ../../pm_broker/broker_router.h
+
+include(../../pm_core/pm_core.pri)
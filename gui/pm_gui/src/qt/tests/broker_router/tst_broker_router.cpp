@@ -0,0 +1,421 @@
+/***************************************************************************
+tst_broker_router.cpp:  BrokerRouter request and answer routing tests
+
+Written by:
+    Sandra Mercer, P.Eng.
+    Engineer / Software Developer
+    eSonar Inc.
+
+Date:
+    November 2022
+
+Note(s):
+- The router is fed client lines and power module bytes as the Broker
+would, and what it has for the clients is checked Output by Output
+- The frames are built here as pm_telemetry.c sends them, so a log_zdump
+can be answered without a power module
+****************************************************************************/
+
+
+#include <QLoggingCategory>
+#include <QtTest>
+#include "broker_router.h"
+
+
+class TestBrokerRouter : public QObject
+{
+    Q_OBJECT
+
+private slots:
+
+    void initTestCase(void);
+    void baud_data(void);
+    void baud(void);
+    void busy(void);
+    void close(void);
+    void events(void);
+    void noSequence(void);
+    void removeClient(void);
+    void sequence(void);
+    void timeout(void);
+    void unreadable(void);
+    void zdump(void);
+
+private:
+
+    static QByteArray frame(quint32);
+    static QByteArray send(BrokerRouter &);
+    static void compare(BrokerRouter &, const QList<BrokerRouter::Output> &);
+
+};
+
+
+/***************************************************************************
+Function to compare the router outputs with the expected ones
+****************************************************************************/
+void TestBrokerRouter::compare(BrokerRouter &router, const QList<BrokerRouter::Output> &expected)
+{
+    QList<BrokerRouter::Output> outputs = router.takeOutputs();
+
+    QCOMPARE(outputs.size(), expected.size());
+    for (int i = 0; i < outputs.size(); i++)
+    {
+        QCOMPARE(outputs.at(i).clientId, expected.at(i).clientId);
+        QCOMPARE(outputs.at(i).data, expected.at(i).data);
+    }
+
+}   // End of TestBrokerRouter::compare
+
+
+/***************************************************************************
+Function to return a keyframe for record sequence, as pm_telemetry.c sends
+it: 0xa5, 'K', payload length, 13 zig-zag varints, CRC-8 (polynomial 0x07)
+****************************************************************************/
+QByteArray TestBrokerRouter::frame(quint32 sequence)
+{
+    const qint32 values[13] = {qint32(sequence), 60000, 12, 3700, -150, 21, 1800, 1013, 19, -3, 0x0155, 0x21, 0};
+    QByteArray payload;
+
+    for (qint32 value : values)
+    {
+        quint32 zigzag = (quint32(value) << 1) ^ quint32(value >> 31);
+        while (zigzag >= 0x80)
+        {
+            payload.append(char((zigzag & 0x7f) | 0x80));
+            zigzag >>= 7;
+        }
+        payload.append(char(zigzag));
+    }
+
+    QByteArray data;
+    data.append(TelemetryDecoder::Sync);
+    data.append('K');
+    data.append(char(payload.size()));
+    data.append(payload);
+
+    quint8 crc = 0x00;
+    for (int i = 1; i < data.size(); i++)
+    {
+        crc ^= quint8(data.at(i));
+        for (int j = 0; j < 8; j++)
+            crc = (crc & 0x80) ? quint8((crc << 1) ^ 0x07) : quint8(crc << 1);
+    }
+    data.append(char(crc));
+
+    return (data);
+
+}   // End of TestBrokerRouter::frame
+
+
+/***************************************************************************
+Function to return the next request line for the port, or an empty one
+****************************************************************************/
+QByteArray TestBrokerRouter::send(BrokerRouter &router)
+{
+    QByteArray data;
+    if (!router.next(data))
+        return (QByteArray());
+
+    return (data);
+
+}   // End of TestBrokerRouter::send
+
+
+/***************************************************************************
+Function to quieten the router's tracing
+****************************************************************************/
+void TestBrokerRouter::initTestCase(void)
+{
+    QLoggingCategory::setFilterRules("*.debug=false");
+
+}   // End of TestBrokerRouter::initTestCase
+
+
+/***************************************************************************
+Requests that would change the port rate, alone or in a batch
+****************************************************************************/
+void TestBrokerRouter::baud_data(void)
+{
+    QTest::addColumn<QByteArray>("line");
+    QTest::addColumn<QByteArray>("answer");
+
+    QTest::newRow("set_baud") << QByteArray("set_baud 115200") << QByteArray("ERROR BROKER\r\n");
+    QTest::newRow("baud_ping") << QByteArray("#4 baud_ping") << QByteArray("@4 ERROR BROKER\r\n");
+    QTest::newRow("batch, second") << QByteArray("#5 read_leak;set_baud 9600") << QByteArray("@5 ERROR BROKER\r\n");
+    QTest::newRow("batch, spaces") << QByteArray("read_leak ; read_ms5637;  baud_ping") << QByteArray("ERROR BROKER\r\n");
+
+}   // End of TestBrokerRouter::baud_data
+
+
+/***************************************************************************
+Function to check that set_baud and baud_ping are refused anywhere in a line
+****************************************************************************/
+void TestBrokerRouter::baud(void)
+{
+    QFETCH(QByteArray, line);
+    QFETCH(QByteArray, answer);
+
+    BrokerRouter router;
+    router.open();
+
+    QVERIFY(router.addRequest(1, line));
+    compare(router, {{1, answer}});
+    QCOMPARE(router.queued(), 0);
+    QCOMPARE(router.rejected(), quint32(1));
+    QVERIFY(send(router).isEmpty());
+
+    // Only the start of each command counts
+    QVERIFY(router.addRequest(1, "read_leak;read_baud"));
+    compare(router, {});
+    QCOMPARE(send(router), QByteArray("#1 read_leak;read_baud\r\n"));
+
+}   // End of TestBrokerRouter::baud
+
+
+/***************************************************************************
+Function to check that a request past a full queue is refused
+****************************************************************************/
+void TestBrokerRouter::busy(void)
+{
+    BrokerRouter router;
+    router.open();
+
+    for (int i = 0; i < BrokerRouter::MaxQueuedRequests; i++)
+        QVERIFY(router.addRequest(1, "read_leak"));
+    QVERIFY(router.addRequest(2, "#9 read_leak"));
+    compare(router, {{2, "@9 ERROR BUSY\r\n"}});
+    QCOMPARE(router.queued(), int(BrokerRouter::MaxQueuedRequests));
+
+    // One sent makes room for one more
+    QCOMPARE(send(router), QByteArray("#1 read_leak\r\n"));
+    QVERIFY(router.addRequest(2, "#10 read_leak"));
+    compare(router, {});
+
+}   // End of TestBrokerRouter::busy
+
+
+/***************************************************************************
+Function to check that closing the port fails the outstanding and the
+waiting requests, and that nothing is taken while it is closed
+****************************************************************************/
+void TestBrokerRouter::close(void)
+{
+    BrokerRouter router;
+
+    QVERIFY(router.addRequest(1, "#1 read_leak"));
+    compare(router, {{1, "@1 ERROR CLOSED\r\n"}});
+
+    router.open();
+    QVERIFY(router.addRequest(1, "#2 read_leak"));
+    QVERIFY(router.addRequest(2, "read_ms5637"));
+    QCOMPARE(send(router), QByteArray("#1 read_leak\r\n"));
+    router.received("@1 LEA");
+
+    router.close();
+    compare(router, {{1, "@2 ERROR CLOSED\r\n"}, {2, "ERROR CLOSED\r\n"}});
+    QVERIFY(!router.isActive());
+    QCOMPARE(router.queued(), 0);
+
+    router.received("K 12\r\nLEAK_EVENT\r\n");
+    compare(router, {});
+
+    // The part line from before the close is gone
+    router.open();
+    router.received("LEAK_EVENT\r\n");
+    compare(router, {{BrokerRouter::Broadcast, "LEAK_EVENT\r\n"}});
+
+}   // End of TestBrokerRouter::close
+
+
+/***************************************************************************
+Function to check that lines without a sequence go to every client and that
+answers to an earlier request are dropped
+****************************************************************************/
+void TestBrokerRouter::events(void)
+{
+    BrokerRouter router;
+    router.open();
+
+    router.received("LEAK_EVENT\r\n@1 LEAK 12\r\n");
+    compare(router, {{BrokerRouter::Broadcast, "LEAK_EVENT\r\n"}});
+
+    QVERIFY(router.addRequest(3, "#1 read_leak"));
+    QCOMPARE(send(router), QByteArray("#1 read_leak\r\n"));
+    router.received("@7 LEAK 12\r\n@1 LEAK 13\r");
+    compare(router, {});
+    router.received("\nLEAK_EVENT\r\n@1 END\r\n");
+    compare(router, {{3, "@1 LEAK 13\r\n"}, {BrokerRouter::Broadcast, "LEAK_EVENT\r\n"}, {3, "@1 END\r\n"}});
+    QCOMPARE(router.events(), quint32(2));
+    QVERIFY(!router.isActive());
+
+}   // End of TestBrokerRouter::events
+
+
+/***************************************************************************
+Function to check that a request sent without a sequence is answered
+without one, and without its END line
+****************************************************************************/
+void TestBrokerRouter::noSequence(void)
+{
+    BrokerRouter router;
+    router.open();
+
+    QVERIFY(router.addRequest(2, "  read_leak\r"));
+    QVERIFY(!router.addRequest(2, "   "));
+    QVERIFY(!router.addRequest(2, "#5"));
+    QCOMPARE(send(router), QByteArray("#1 read_leak\r\n"));
+
+    router.received("@1 LEAK 12\r\n@1 END\r\n");
+    compare(router, {{2, "LEAK 12\r\n"}});
+    QVERIFY(!router.isActive());
+
+}   // End of TestBrokerRouter::noSequence
+
+
+/***************************************************************************
+Function to check that a client that has gone gets nothing more and its
+waiting requests are not sent
+****************************************************************************/
+void TestBrokerRouter::removeClient(void)
+{
+    BrokerRouter router;
+    router.open();
+
+    QVERIFY(router.addRequest(1, "#1 read_leak"));
+    QVERIFY(router.addRequest(1, "#2 read_leak"));
+    QVERIFY(router.addRequest(2, "#1 read_ms5637"));
+    QCOMPARE(send(router), QByteArray("#1 read_leak\r\n"));
+    router.received("LEAK_EVENT\r\n@1 LEAK 12\r\n");
+
+    router.removeClient(1);
+    compare(router, {{BrokerRouter::Broadcast, "LEAK_EVENT\r\n"}});
+    QCOMPARE(router.queued(), 1);
+
+    // The outstanding request still ends with its END
+    router.received("@1 END\r\n");
+    compare(router, {});
+    QCOMPARE(send(router), QByteArray("#2 read_ms5637\r\n"));
+    router.received("@2 PRESSURE 1013\r\n@2 END\r\n");
+    compare(router, {{2, "@1 PRESSURE 1013\r\n"}, {2, "@1 END\r\n"}});
+
+}   // End of TestBrokerRouter::removeClient
+
+
+/***************************************************************************
+Function to check that requests are sent one at a time with the router's
+sequence and answered with the client's
+****************************************************************************/
+void TestBrokerRouter::sequence(void)
+{
+    BrokerRouter router;
+    router.open();
+
+    QVERIFY(router.addRequest(1, "#7 read_leak"));
+    QVERIFY(router.addRequest(2, "#7 read_ms5637;read_ltc2944"));
+    QCOMPARE(router.queued(), 2);
+
+    QCOMPARE(send(router), QByteArray("#1 read_leak\r\n"));
+    QVERIFY(send(router).isEmpty());
+    QVERIFY(router.isActive());
+
+    router.received("@1 LEAK 12\r\n@1 END\r\n");
+    compare(router, {{1, "@7 LEAK 12\r\n"}, {1, "@7 END\r\n"}});
+
+    QCOMPARE(send(router), QByteArray("#2 read_ms5637;read_ltc2944\r\n"));
+    router.received("@2 PRESSURE 1013\r\n@2 VOLTAGE 3700\r\n@2 END\r\n");
+    compare(router, {{2, "@7 PRESSURE 1013\r\n"}, {2, "@7 VOLTAGE 3700\r\n"}, {2, "@7 END\r\n"}});
+    QCOMPARE(router.requests(), quint32(2));
+
+}   // End of TestBrokerRouter::sequence
+
+
+/***************************************************************************
+Function to check that an unanswered request times out and the next one is
+sent
+****************************************************************************/
+void TestBrokerRouter::timeout(void)
+{
+    BrokerRouter router;
+    router.open();
+
+    router.timeout();
+    compare(router, {});
+
+    QVERIFY(router.addRequest(1, "#3 read_leak"));
+    QVERIFY(router.addRequest(1, "read_leak"));
+    QCOMPARE(send(router), QByteArray("#1 read_leak\r\n"));
+    router.timeout();
+    compare(router, {{1, "@3 ERROR TIMEOUT\r\n"}});
+    QCOMPARE(router.timeouts(), quint32(1));
+
+    // A late answer is not taken for the next request's
+    QCOMPARE(send(router), QByteArray("#2 read_leak\r\n"));
+    router.received("@1 LEAK 12\r\n@1 END\r\n");
+    compare(router, {});
+    router.timeout();
+    compare(router, {{1, "ERROR TIMEOUT\r\n"}});
+
+}   // End of TestBrokerRouter::timeout
+
+
+/***************************************************************************
+Function to check that "@-", the answer to a frame the power module could
+not read, ends the outstanding request
+****************************************************************************/
+void TestBrokerRouter::unreadable(void)
+{
+    BrokerRouter router;
+    router.open();
+
+    router.received("@- ERROR FRAME\r\n");
+    compare(router, {});
+
+    QVERIFY(router.addRequest(4, "#3 read_leak"));
+    QCOMPARE(send(router), QByteArray("#1 read_leak\r\n"));
+    router.received("@- ERROR FRAME\r\n");
+    compare(router, {{4, "@3 ERROR FRAME\r\n"}});
+    QVERIFY(!router.isActive());
+
+}   // End of TestBrokerRouter::unreadable
+
+
+/***************************************************************************
+Function to check that frames go to the client that asked for a log_zdump,
+and to every client otherwise, and that bad frames go to no one
+****************************************************************************/
+void TestBrokerRouter::zdump(void)
+{
+    BrokerRouter router;
+    router.open();
+
+    QByteArray first = frame(100);
+    QByteArray second = frame(101);
+
+    router.received(first);
+    compare(router, {{BrokerRouter::Broadcast, first}});
+
+    QVERIFY(router.addRequest(1, "#8 read_leak;log_zdump 0 2"));
+    QVERIFY(router.addRequest(2, "#8 read_leak"));
+    QCOMPARE(send(router), QByteArray("#1 read_leak;log_zdump 0 2\r\n"));
+
+    // A frame split across chunks, between two answer lines
+    router.received("@1 LEAK 12\r\n@1 LOG_ZDUMP 0 2\r\n" + first.left(5));
+    compare(router, {{1, "@8 LEAK 12\r\n"}, {1, "@8 LOG_ZDUMP 0 2\r\n"}});
+    router.received(first.mid(5) + second + "@1 END\r\n");
+    compare(router, {{1, first}, {1, second}, {1, "@8 END\r\n"}});
+
+    // A frame with a bad CRC goes to no one, the rest of it is skipped up to
+    // the next sync byte
+    QByteArray bad = second;
+    bad[bad.size() - 1] = char(bad.at(bad.size() - 1) ^ 0x01);
+    QCOMPARE(send(router), QByteArray("#2 read_leak\r\n"));
+    router.received(bad + second + "@2 END\r\n");
+    compare(router, {{BrokerRouter::Broadcast, second}, {2, "@8 END\r\n"}});
+    QCOMPARE(router.frames(), quint32(4));
+
+}   // End of TestBrokerRouter::zdump
+
+
+QTEST_GUILESS_MAIN(TestBrokerRouter)
+
+#include "tst_broker_router.moc"
@@ -0,0 +1,18 @@
+QT       += core testlib
+QT       -= gui
+
+CONFIG += c++11 console testcase
+CONFIG -= app_bundle
+
+TARGET = tst_record_writer
+
+INCLUDEPATH += ../../pm_daemon
+
+SOURCES += \
+    tst_record_writer.cpp \
+    ../../pm_daemon/record_writer.cpp
+
+HEADERS += \
+    ../../pm_daemon/record_writer.h
+
+include(../../pm_core/pm_core.pri)
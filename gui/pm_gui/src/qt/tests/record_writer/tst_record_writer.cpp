@@ -0,0 +1,253 @@
+/***************************************************************************
+tst_record_writer.cpp:  pm_daemon RecordWriter CSV, binary and store
+format tests
+
+Written by:
+    Sandra Mercer, P.Eng.
+    Engineer / Software Developer
+    eSonar Inc.
+
+Date:
+    November 2022
+
+Note(s):
+- Writes the same three telemetry records in each format to a temporary
+directory and reads the files back: the CSV text, the binary layout in
+record_writer.h and the store through SeriesReader
+- The second record has the LTC2944 failed flag, the store must leave out
+the readings of that sensor rather than store them as 0
+****************************************************************************/
+
+
+#include <cstring>
+#include <QFile>
+#include <QFileInfo>
+#include <QLoggingCategory>
+#include <QTemporaryDir>
+#include <QtEndian>
+#include <QtTest>
+#include "record_writer.h"
+#include "series_reader.h"
+
+
+class TestRecordWriter : public QObject
+{
+    Q_OBJECT
+
+private slots:
+
+    void initTestCase(void);
+    void binary(void);
+    void csv(void);
+    void openError(void);
+    void store(void);
+
+private:
+
+    static const qint64 StartMs = 1666180800000;    // 2022-10-19 12:00 UTC
+    static const qint64 PeriodMs = 1000;
+    static const int Records = 3;
+
+    // LOG_FLAG_LTC2944_FAILED in pm_logger.h
+    static const quint8 Ltc2944Failed = 0x02;
+
+    static TelemetryRecord record(int);
+    static void writeAll(const QString &, RecordWriter::formatEnum);
+
+    QTemporaryDir dir;
+
+};
+
+
+/***************************************************************************
+Function to return record i of the ones written in each format
+****************************************************************************/
+TelemetryRecord TestRecordWriter::record(int i)
+{
+    TelemetryRecord telemetry;
+
+    telemetry.sequence = quint32(100 + i);
+    telemetry.timestampMs = quint32(60000 + i * 1000);
+    telemetry.leakMv = quint16(250 + i);
+    telemetry.batteryMv = quint16(3700 - i);
+    telemetry.batteryMa = qint16(-150 + i * 10);
+    telemetry.ltc2944Temperature = qint16(2150);
+    telemetry.chargeMah = quint16(1800 - i);
+    telemetry.pressure = quint16(10132 + i);
+    telemetry.ms5637Temperature = qint16(1925);
+    telemetry.tilt = qint16(-300 + i);
+    telemetry.powerBits = quint16((i == 0) ? 0x0155 : 0x0005);
+    telemetry.statusBits = quint8((i == 0) ? 0x21 : 0x01);
+    telemetry.flags = (i == 1) ? Ltc2944Failed : 0;
+
+    return (telemetry);
+
+}   // End of TestRecordWriter::record
+
+
+/***************************************************************************
+Function to write the records, one a second from StartMs
+****************************************************************************/
+void TestRecordWriter::writeAll(const QString &fileName, RecordWriter::formatEnum format)
+{
+    RecordWriter writer;
+
+    QString error = writer.open(fileName, format);
+    QVERIFY2(error.isEmpty(), qPrintable(error));
+    QCOMPARE(writer.fileName(), fileName);
+
+    for (int i = 0; i < Records; i++)
+        writer.write(StartMs + i * PeriodMs, record(i));
+    QCOMPARE(writer.records(), qint64(Records));
+
+    writer.close();
+
+}   // End of TestRecordWriter::writeAll
+
+
+/***************************************************************************
+Function to set up the temporary directory
+****************************************************************************/
+void TestRecordWriter::initTestCase(void)
+{
+    QLoggingCategory::setFilterRules("*.debug=false");
+    QVERIFY(dir.isValid());
+
+}   // End of TestRecordWriter::initTestCase
+
+
+/***************************************************************************
+Function to check the binary header and every field of the records
+against the layout in record_writer.h
+****************************************************************************/
+void TestRecordWriter::binary(void)
+{
+    QString fileName = dir.filePath("records.pmrec");
+    writeAll(fileName, RecordWriter::BINARY);
+
+    QFile file(fileName);
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    QByteArray data = file.readAll();
+    QCOMPARE(data.size(), RecordFile::HeaderLength + Records * RecordFile::RecordLength);
+
+    const uchar *header = reinterpret_cast<const uchar *>(data.constData());
+    QVERIFY(memcmp(header, RecordFile::Magic, sizeof(RecordFile::Magic)) == 0);
+    QCOMPARE(qFromLittleEndian<quint32>(header + 8), RecordFile::Version);
+    QCOMPARE(qFromLittleEndian<quint32>(header + 12), quint32(0));
+
+    for (int i = 0; i < Records; i++)
+    {
+        const uchar *buffer = header + RecordFile::HeaderLength + i * RecordFile::RecordLength;
+        TelemetryRecord expected = record(i);
+
+        QCOMPARE(qFromLittleEndian<qint64>(buffer), StartMs + i * PeriodMs);
+        QCOMPARE(qFromLittleEndian<quint32>(buffer + 8), expected.sequence);
+        QCOMPARE(qFromLittleEndian<quint32>(buffer + 12), expected.timestampMs);
+        QCOMPARE(qFromLittleEndian<quint16>(buffer + 16), expected.leakMv);
+        QCOMPARE(qFromLittleEndian<quint16>(buffer + 18), expected.batteryMv);
+        QCOMPARE(qFromLittleEndian<qint16>(buffer + 20), expected.batteryMa);
+        QCOMPARE(qFromLittleEndian<qint16>(buffer + 22), expected.ltc2944Temperature);
+        QCOMPARE(qFromLittleEndian<quint16>(buffer + 24), expected.chargeMah);
+        QCOMPARE(qFromLittleEndian<quint16>(buffer + 26), expected.pressure);
+        QCOMPARE(qFromLittleEndian<qint16>(buffer + 28), expected.ms5637Temperature);
+        QCOMPARE(qFromLittleEndian<qint16>(buffer + 30), expected.tilt);
+        QCOMPARE(qFromLittleEndian<quint16>(buffer + 32), expected.powerBits);
+        QCOMPARE(buffer[34], expected.statusBits);
+        QCOMPARE(buffer[35], expected.flags);
+        QCOMPARE(qFromLittleEndian<quint32>(buffer + 36), quint32(0));
+    }
+
+}   // End of TestRecordWriter::binary
+
+
+/***************************************************************************
+Function to check the CSV header and rows, scaled as in the GUI's log
+download with the host time in front
+****************************************************************************/
+void TestRecordWriter::csv(void)
+{
+    QString fileName = dir.filePath("records.csv");
+    writeAll(fileName, RecordWriter::CSV);
+
+    QFile file(fileName);
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    QList<QByteArray> lines = file.readAll().split('\n');
+
+    QCOMPARE(lines.size(), Records + 2);
+    QCOMPARE(lines.at(0), QByteArray("host_time,sequence,timestamp_ms,leak_v,battery_v,battery_a,ltc2944_temperature,"
+                                     "charge_mah,pressure_mbar,ms5637_temperature,tilt,power_bits,status_bits,flags"));
+    QCOMPARE(lines.at(1), QByteArray("2022-10-19T12:00:00.000Z,100,60000,0.250,3.700,-0.150,21.50,1800,1013.2,19.25,"
+                                     "-3.00,0x155,0x21,0"));
+    QCOMPARE(lines.at(2), QByteArray("2022-10-19T12:00:01.000Z,101,61000,0.251,3.699,-0.140,21.50,1799,1013.3,19.25,"
+                                     "-2.99,0x005,0x01,2"));
+    QVERIFY(lines.at(3).startsWith("2022-10-19T12:00:02.000Z,102,62000,"));
+    QVERIFY(lines.at(4).isEmpty());
+
+}   // End of TestRecordWriter::csv
+
+
+/***************************************************************************
+Function to check that a file that cannot be created is reported, and that
+nothing is written after it
+****************************************************************************/
+void TestRecordWriter::openError(void)
+{
+    RecordWriter writer;
+    QString fileName = dir.filePath("missing/records.csv");
+
+    QVERIFY(writer.open(fileName, RecordWriter::CSV).startsWith("Could not create"));
+    writer.write(StartMs, record(0));
+    QCOMPARE(writer.records(), qint64(0));
+    QVERIFY(!QFileInfo::exists(fileName));
+
+}   // End of TestRecordWriter::openError
+
+
+/***************************************************************************
+Function to check that the store has one series per reading, with the
+readings of a failed sensor left out
+****************************************************************************/
+void TestRecordWriter::store(void)
+{
+    QString directory = dir.filePath("store");
+    writeAll(directory, RecordWriter::STORE);
+
+    SeriesReader reader;
+    QString error = reader.open(directory);
+    QVERIFY2(error.isEmpty(), qPrintable(error));
+
+    QStringList names = reader.channels();
+    names.sort();
+    QCOMPARE(names, QStringList() << "battery_a" << "battery_v" << "charge_mah" << "leak_v" << "ltc2944_temperature"
+                                  << "ms5637_temperature" << "pressure_mbar" << "tilt");
+
+    QVector<SeriesReader::Point> points;
+    QVERIFY(reader.query("leak_v", StartMs, StartMs + Records * PeriodMs, 10, points));
+    QCOMPARE(points.size(), int(Records));
+    for (int i = 0; i < Records; i++)
+    {
+        QCOMPARE(points.at(i).timeMs, StartMs + i * PeriodMs);
+        QCOMPARE(points.at(i).min, record(i).leakMv / 1000.0f);
+    }
+
+    QVERIFY(reader.query("pressure_mbar", StartMs, StartMs + Records * PeriodMs, 10, points));
+    QCOMPARE(points.size(), int(Records));
+    QCOMPARE(points.at(2).min, record(2).pressure / 10.0f);
+
+    // The LTC2944 readings of the second record are not stored
+    QVERIFY(reader.query("battery_v", StartMs, StartMs + Records * PeriodMs, 10, points));
+    QCOMPARE(points.size(), Records - 1);
+    QCOMPARE(points.at(0).timeMs, qint64(StartMs));
+    QCOMPARE(points.at(0).min, record(0).batteryMv / 1000.0f);
+    QCOMPARE(points.at(1).timeMs, StartMs + 2 * PeriodMs);
+    QCOMPARE(points.at(1).min, record(2).batteryMv / 1000.0f);
+
+    QVERIFY(reader.query("charge_mah", StartMs, StartMs + Records * PeriodMs, 10, points));
+    QCOMPARE(points.size(), Records - 1);
+
+}   // End of TestRecordWriter::store
+
+
+QTEST_GUILESS_MAIN(TestRecordWriter)
+
+#include "tst_record_writer.moc"
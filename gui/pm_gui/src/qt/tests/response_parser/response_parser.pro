@@ -0,0 +1,12 @@
+QT       += core testlib
+QT       -= gui
+
+CONFIG += c++11 console testcase
+CONFIG -= app_bundle
+
+TARGET = tst_response_parser
+
+SOURCES += \
+    tst_response_parser.cpp
+
+include(../../pm_core/pm_core.pri)
@@ -0,0 +1,316 @@
+/***************************************************************************
+tst_response_parser.cpp:  ResponseStream and ResponseParser tests and
+throughput benchmark
+
+Written by:
+    Sandra Mercer, P.Eng.
+    Engineer / Software Developer
+    eSonar Inc.
+
+Date:
+    November 2022
+
+Note(s):
+- Replays the received records of a session capture (see SessionRecorder)
+through a ResponseStream and a ResponseParser with the same handlers as
+pm_daemon, in the chunks they were read from the port
+- data/poll_session.pmcap is synthetic: it was written in the capture
+format for this test, not recorded from a power module. It holds the
+answers to the pm_daemon poll (read_leak, read_ltc2944, read_ms5637,
+read_power_bits, read_status_bits, read_mc3416) in chunks the size of a
+port read. It is fed Passes times, a few megabytes, and the throughput is
+printed. A recorded session can be given with PM_CAPTURE=<file>
+- Debug output, such as the CommandQueue note of a failed request, is
+turned off so that it is not part of what is timed
+- frames and tokens check the telemetry frames between responses and the
+MaxTokens limit, which the poll does not reach
+****************************************************************************/
+
+
+#include <cstring>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QLoggingCategory>
+#include <QtEndian>
+#include <QtTest>
+#include "command_queue.h"
+#include "response_parser.h"
+#include "response_stream.h"
+#include "session_recorder.h"
+
+
+class TestResponseParser : public QObject
+{
+    Q_OBJECT
+
+private slots:
+
+    void initTestCase(void);
+    void dispatch(void);
+    void frames(void);
+    void throughput(void);
+    void tokens(void);
+
+private:
+
+    static const int Passes = 64;
+
+    static QByteArray frame(quint32);
+    void addHandlers(ResponseParser &);
+
+    QList<QByteArray> received;
+    qint64 receivedBytes = 0;
+    int values = 0;
+
+};
+
+
+/***************************************************************************
+Function to return a keyframe for record sequence, as pm_telemetry.c sends
+it: 0xa5, 'K', payload length, 13 zig-zag varints, CRC-8 (polynomial 0x07)
+****************************************************************************/
+QByteArray TestResponseParser::frame(quint32 sequence)
+{
+    const qint32 values[13] = {qint32(sequence), 60000, 12, 3700, -150, 21, 1800, 1013, 19, -3, 0x0155, 0x21, 0};
+    QByteArray payload;
+
+    for (qint32 value : values)
+    {
+        quint32 zigzag = (quint32(value) << 1) ^ quint32(value >> 31);
+        while (zigzag >= 0x80)
+        {
+            payload.append(char((zigzag & 0x7f) | 0x80));
+            zigzag >>= 7;
+        }
+        payload.append(char(zigzag));
+    }
+
+    QByteArray data;
+    data.append(TelemetryDecoder::Sync);
+    data.append('K');
+    data.append(char(payload.size()));
+    data.append(payload);
+
+    quint8 crc = 0x00;
+    for (int i = 1; i < data.size(); i++)
+    {
+        crc ^= quint8(data.at(i));
+        for (int j = 0; j < 8; j++)
+            crc = (crc & 0x80) ? quint8((crc << 1) ^ 0x07) : quint8(crc << 1);
+    }
+    data.append(char(crc));
+
+    return (data);
+
+}   // End of TestResponseParser::frame
+
+
+/***************************************************************************
+Function to load the received records of the capture
+****************************************************************************/
+void TestResponseParser::initTestCase(void)
+{
+    QLoggingCategory::setFilterRules("*.debug=false");
+
+    QString fileName = qEnvironmentVariable("PM_CAPTURE", QFINDTESTDATA("data/poll_session.pmcap"));
+    QFile file(fileName);
+    QVERIFY2(file.open(QIODevice::ReadOnly), qPrintable(fileName + ": " + file.errorString()));
+
+    QByteArray capture = file.readAll();
+    QVERIFY(capture.size() >= SessionCapture::HeaderLength);
+    QVERIFY(memcmp(capture.constData(), SessionCapture::Magic, sizeof(SessionCapture::Magic)) == 0);
+
+    const uchar *data = reinterpret_cast<const uchar *>(capture.constData());
+    int position = SessionCapture::HeaderLength;
+    while (capture.size() - position >= SessionCapture::RecordHeaderLength)
+    {
+        quint32 length = qFromLittleEndian<quint32>(data + position + 8);
+        if (quint32(capture.size() - position - SessionCapture::RecordHeaderLength) < length)
+            break;
+
+        if (data[position + 12] == SessionCapture::RECEIVED)
+        {
+            received.append(capture.mid(position + SessionCapture::RecordHeaderLength, int(length)));
+            receivedBytes += length;
+        }
+        position += SessionCapture::RecordHeaderLength + int(length);
+    }
+
+    QVERIFY(!received.isEmpty());
+
+}   // End of TestResponseParser::initTestCase
+
+
+/***************************************************************************
+Function to register the pm_daemon handlers, counting the values read
+****************************************************************************/
+void TestResponseParser::addHandlers(ResponseParser &parser)
+{
+    typedef ResponseParser::Tokens Tokens;
+
+    auto number = [this](int index) {
+        return [this, index](const Tokens &tokens) {
+            double value;
+            if (tokens.toDouble(index, value))
+                values++;
+        };
+    };
+    auto bits = [this](const Tokens &tokens) {
+        int value;
+        if (tokens.toInt(1, value))
+            values++;
+    };
+
+    parser.addHandler("LEAK", number(1));
+    parser.addHandler("VOLTAGE", number(1));
+    parser.addHandler("CURRENT", number(1));
+    parser.addHandler("CHARGE", number(1));
+    parser.addHandler("LTC2944", number(2));
+    parser.addHandler("PRESSURE", number(1));
+    parser.addHandler("TEMPERATURE", number(1));
+    parser.addHandler("ACCEL", number(3));
+    parser.addHandler("POWER", bits);
+    parser.addHandler("STATUS_BITS", bits);
+
+    // "<command> VALID"
+    for (const char *command : {"read_leak", "read_ltc2944", "read_ms5637", "read_power_bits",
+                                "read_status_bits", "read_mc3416"})
+        parser.addHandler(command, [](const Tokens &) {});
+
+}   // End of TestResponseParser::addHandlers
+
+
+/***************************************************************************
+Test that every response line of the capture reaches a handler
+****************************************************************************/
+void TestResponseParser::dispatch(void)
+{
+    CommandQueue commandQueue;
+    ResponseParser parser;
+    ResponseStream stream(&commandQueue, &parser);
+
+    addHandlers(parser);
+    values = 0;
+
+    for (const QByteArray &chunk : received)
+        stream.append(chunk);
+
+    QVERIFY(values > 0);
+    QCOMPARE(parser.unhandled(), 0);
+
+}   // End of TestResponseParser::dispatch
+
+
+/***************************************************************************
+Test that frames between responses reach the record handler, whole or a
+byte at a time, and that a bad frame loses neither side
+****************************************************************************/
+void TestResponseParser::frames(void)
+{
+    CommandQueue commandQueue;
+    ResponseParser parser;
+    ResponseStream stream(&commandQueue, &parser);
+    QList<quint32> sequences;
+    int leaks = 0;
+
+    parser.addHandler("LEAK", [&leaks](const ResponseParser::Tokens &) {leaks++;});
+    stream.setRecordHandler([&sequences](const TelemetryRecord &record) {sequences.append(record.sequence);});
+
+    QByteArray bad = frame(2);
+    bad[bad.size() - 1] = char(bad.at(bad.size() - 1) ^ 0x01);
+    QByteArray data = "LEAK 12\r\n" + frame(1) + "LEAK 13\r\n" + bad + frame(3) + frame(4) + "LEAK 14\r\n";
+
+    stream.append(data);
+    for (int i = 0; i < data.size(); i++)
+        stream.append(data.mid(i, 1));
+
+    QCOMPARE(leaks, 6);
+    QCOMPARE(sequences, QList<quint32>() << 1 << 3 << 4 << 1 << 3 << 4);
+    QCOMPARE(stream.decoder().invalidFrames(), 2);
+    QCOMPARE(parser.unhandled(), 0);
+
+}   // End of TestResponseParser::frames
+
+
+/***************************************************************************
+Benchmark of the capture fed Passes times, with the throughput printed
+****************************************************************************/
+void TestResponseParser::throughput(void)
+{
+    CommandQueue commandQueue;
+    ResponseParser parser;
+    ResponseStream stream(&commandQueue, &parser);
+    QElapsedTimer timer;
+    qint64 elapsedNs = 0;
+    qint64 bytes = 0;
+
+    addHandlers(parser);
+    values = 0;
+
+    QBENCHMARK
+    {
+        timer.start();
+        for (int i = 0; i < Passes; i++)
+        {
+            for (const QByteArray &chunk : received)
+                stream.append(chunk);
+        }
+        elapsedNs += timer.nsecsElapsed();
+        bytes += Passes * receivedBytes;
+    }
+
+    QCOMPARE(parser.unhandled(), 0);
+    QVERIFY(elapsedNs > 0);
+
+    qInfo("%.1f MB in %.1f ms, %.1f MB/s, %.0f values/s", bytes / 1e6, elapsedNs / 1e6,
+          bytes * 1e3 / elapsedNs, values * 1e9 / elapsedNs);
+
+}   // End of TestResponseParser::throughput
+
+
+/***************************************************************************
+Test the number tokens and a line with more than MaxTokens tokens
+****************************************************************************/
+void TestResponseParser::tokens(void)
+{
+    ResponseParser parser;
+    QList<bool> valid;
+    QList<double> numbers;
+    int count = 0;
+    int last = 0;
+
+    parser.addHandler("T", [&](const ResponseParser::Tokens &tokens) {
+        count = tokens.count();
+        valid.clear();
+        numbers.clear();
+        for (int i = 1; i < 4; i++)
+        {
+            double value = 0.0;
+            valid.append(tokens.toDouble(i, value));
+            numbers.append(value);
+        }
+        tokens.toInt(count - 1, last);
+    });
+
+    QByteArray line("T -12.5 +7 1.5x 5 6 7 8 9 10 11 0x0c  ");
+    QVERIFY(parser.dispatch(line.data(), line.size()));
+    QCOMPARE(count, int(ResponseParser::Tokens::MaxTokens));
+    QCOMPARE(valid, QList<bool>() << true << true << false);
+    QCOMPARE(numbers.at(0), -12.5);
+    QCOMPARE(numbers.at(1), 7.0);
+    QCOMPARE(last, 12);
+
+    // One more token is refused, not handled without it
+    count = 0;
+    line = "T -12.5 +7 1.5x 5 6 7 8 9 10 11 0x0c 13";
+    QVERIFY(!parser.dispatch(line.data(), line.size()));
+    QCOMPARE(count, 0);
+    QCOMPARE(parser.truncated(), 1);
+    QCOMPARE(parser.unhandled(), 0);
+
+}   // End of TestResponseParser::tokens
+
+
+QTEST_GUILESS_MAIN(TestResponseParser)
+
+#include "tst_response_parser.moc"
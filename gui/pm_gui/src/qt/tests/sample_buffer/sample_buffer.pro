@@ -0,0 +1,22 @@
+QT       += core testlib
+QT       -= gui
+
+CONFIG += c++11 console testcase
+CONFIG -= app_bundle
+
+TARGET = tst_sample_buffer
+
+# The following define makes your compiler emit warnings if you use
+# any Qt feature that has been marked deprecated (the exact warnings
+# depend on your compiler). Please consult the documentation of the
+# deprecated API in order to know how to port your code away from it.
+DEFINES += QT_DEPRECATED_WARNINGS
+
+INCLUDEPATH += ../../pm_gui
+
+SOURCES += \
+    tst_sample_buffer.cpp \
+    ../../pm_gui/sample_buffer.cpp
+
+HEADERS += \
+    ../../pm_gui/sample_buffer.h
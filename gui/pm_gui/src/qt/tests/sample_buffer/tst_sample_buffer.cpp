@@ -0,0 +1,229 @@
+/***************************************************************************
+tst_sample_buffer.cpp:  SampleBuffer ring and decimation tests
+
+Written by:
+    Sandra Mercer, P.Eng.
+    Engineer / Software Developer
+    eSonar Inc.
+
+Date:
+    November 2022
+
+Note(s):
+- decimate() is checked against the minimum and maximum of the samples in
+each column worked out one sample at a time, for views that are cut part
+way through blocks and superblocks and for a buffer that has wrapped
+- A spike of one sample in a full buffer must show in the column it falls
+in, which is what drawing every nth sample would lose
+****************************************************************************/
+
+
+#include <algorithm>
+#include <QtTest>
+#include "sample_buffer.h"
+
+
+class TestSampleBuffer : public QObject
+{
+    Q_OBJECT
+
+private slots:
+
+    void decimate_data(void);
+    void decimate(void);
+    void empty(void);
+    void spike(void);
+    void wrap(void);
+
+private:
+
+    static const int Capacity = 4096;
+    static const int Samples = 10000;
+    static const qint64 PeriodMs = 100;
+
+    static float value(int);
+    void fill(SampleBuffer &);
+
+};
+
+
+/***************************************************************************
+Function to return sample n, a repeatable noisy signal
+****************************************************************************/
+float TestSampleBuffer::value(int n)
+{
+    quint32 state = quint32(n) * 1103515245u + 12345u;
+    return (float((state >> 8) % 20001) / 100.0f - 100.0f);
+
+}   // End of TestSampleBuffer::value
+
+
+/***************************************************************************
+Function to fill a buffer past its capacity, sample n is at n * PeriodMs
+****************************************************************************/
+void TestSampleBuffer::fill(SampleBuffer &buffer)
+{
+    for (int n = 0; n < Samples; n++)
+        buffer.append(n * PeriodMs, value(n));
+
+}   // End of TestSampleBuffer::fill
+
+
+/***************************************************************************
+Decimation views: the range in ms and the number of columns
+****************************************************************************/
+void TestSampleBuffer::decimate_data(void)
+{
+    QTest::addColumn<qint64>("startMs");
+    QTest::addColumn<qint64>("endMs");
+    QTest::addColumn<int>("width");
+
+    const qint64 firstMs = (Samples - Capacity) * PeriodMs;
+    const qint64 endMs = Samples * PeriodMs;
+
+    QTest::newRow("all, 1 column") << firstMs << endMs << 1;
+    QTest::newRow("all, 7 columns") << firstMs << endMs << 7;
+    QTest::newRow("all, 640 columns") << firstMs << endMs << 640;
+    QTest::newRow("all, more columns than samples") << firstMs << endMs << 5000;
+    QTest::newRow("cut blocks") << firstMs + 1750 << endMs - 3350 << 13;
+    QTest::newRow("before the oldest") << qint64(0) << firstMs + 40000 << 100;
+    QTest::newRow("after the newest") << endMs - 30000 << endMs + 30000 << 60;
+    QTest::newRow("between samples") << firstMs + 50 << firstMs + 90 << 10;
+
+}   // End of TestSampleBuffer::decimate_data
+
+
+/***************************************************************************
+Function to check a view against the samples one at a time
+****************************************************************************/
+void TestSampleBuffer::decimate(void)
+{
+    QFETCH(qint64, startMs);
+    QFETCH(qint64, endMs);
+    QFETCH(int, width);
+
+    SampleBuffer buffer(Capacity);
+    fill(buffer);
+
+    QVector<SampleBuffer::Column> expected(width);
+    for (SampleBuffer::Column &column : expected)
+        column.bValid = false;
+
+    for (int n = Samples - Capacity; n < Samples; n++)
+    {
+        qint64 timeMs = n * PeriodMs;
+        if (timeMs < startMs || timeMs >= endMs)
+            continue;
+
+        int x = std::min(int((timeMs - startMs) * width / (endMs - startMs)), width - 1);
+        SampleBuffer::Column &column = expected[x];
+        column.min = column.bValid ? std::min(column.min, value(n)) : value(n);
+        column.max = column.bValid ? std::max(column.max, value(n)) : value(n);
+        column.bValid = true;
+    }
+
+    QVector<SampleBuffer::Column> columns(width);
+    buffer.decimate(startMs, endMs, columns);
+
+    for (int x = 0; x < width; x++)
+    {
+        QCOMPARE(columns.at(x).bValid, expected.at(x).bValid);
+        if (expected.at(x).bValid)
+        {
+            QCOMPARE(columns.at(x).min, expected.at(x).min);
+            QCOMPARE(columns.at(x).max, expected.at(x).max);
+        }
+    }
+
+}   // End of TestSampleBuffer::decimate
+
+
+/***************************************************************************
+Function to check the views that have no samples
+****************************************************************************/
+void TestSampleBuffer::empty(void)
+{
+    SampleBuffer buffer(Capacity);
+    QVector<SampleBuffer::Column> columns(4);
+
+    buffer.decimate(0, 1000, columns);
+    for (const SampleBuffer::Column &column : columns)
+        QVERIFY(!column.bValid);
+
+    fill(buffer);
+    buffer.decimate(Samples * PeriodMs, (Samples + 10) * PeriodMs, columns);
+    for (const SampleBuffer::Column &column : columns)
+        QVERIFY(!column.bValid);
+
+    buffer.decimate(1000, 1000, columns);
+    for (const SampleBuffer::Column &column : columns)
+        QVERIFY(!column.bValid);
+
+    buffer.clear();
+    QCOMPARE(buffer.size(), qint64(0));
+    buffer.decimate(0, Samples * PeriodMs, columns);
+    for (const SampleBuffer::Column &column : columns)
+        QVERIFY(!column.bValid);
+
+}   // End of TestSampleBuffer::empty
+
+
+/***************************************************************************
+Function to check that one sample out of a full buffer is not lost
+****************************************************************************/
+void TestSampleBuffer::spike(void)
+{
+    SampleBuffer buffer;
+    const int spikeAt = 123457;
+
+    for (int n = 0; n < SampleBuffer::DefaultCapacity; n++)
+        buffer.append(n * PeriodMs, (n == spikeAt) ? 5.0f : 0.0f);
+
+    const int width = 800;
+    QVector<SampleBuffer::Column> columns(width);
+    buffer.decimate(buffer.firstTimeMs(), buffer.lastTimeMs() + 1, columns);
+
+    int spikes = 0;
+    for (int x = 0; x < width; x++)
+    {
+        QVERIFY(columns.at(x).bValid);
+        QCOMPARE(columns.at(x).min, 0.0f);
+        if (columns.at(x).max == 5.0f)
+        {
+            QCOMPARE(x, int(spikeAt * PeriodMs * width / (buffer.lastTimeMs() + 1 - buffer.firstTimeMs())));
+            spikes++;
+        }
+    }
+    QCOMPARE(spikes, 1);
+
+}   // End of TestSampleBuffer::spike
+
+
+/***************************************************************************
+Function to check that the oldest samples are overwritten
+****************************************************************************/
+void TestSampleBuffer::wrap(void)
+{
+    SampleBuffer buffer(Capacity);
+    QCOMPARE(buffer.size(), qint64(0));
+    QCOMPARE(buffer.lastValue(), 0.0f);
+
+    fill(buffer);
+    QCOMPARE(buffer.size(), qint64(Capacity));
+    QCOMPARE(buffer.firstTimeMs(), (Samples - Capacity) * PeriodMs);
+    QCOMPARE(buffer.lastTimeMs(), (Samples - 1) * PeriodMs);
+    QCOMPARE(buffer.lastValue(), value(Samples - 1));
+
+    // The capacity is rounded up to whole superblocks of 256 samples
+    QCOMPARE(SampleBuffer(1000).size(), qint64(0));
+    SampleBuffer rounded(1000);
+    for (int n = 0; n < 2000; n++)
+        rounded.append(n, 0.0f);
+    QCOMPARE(rounded.size(), qint64(1024));
+
+}   // End of TestSampleBuffer::wrap
+
+
+QTEST_GUILESS_MAIN(TestSampleBuffer)
+
+#include "tst_sample_buffer.moc"
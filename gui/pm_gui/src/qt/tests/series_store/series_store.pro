@@ -0,0 +1,12 @@
+QT       += core testlib
+QT       -= gui
+
+CONFIG += c++11 console testcase
+CONFIG -= app_bundle
+
+TARGET = tst_series_store
+
+SOURCES += \
+    tst_series_store.cpp
+
+include(../../pm_core/pm_core.pri)
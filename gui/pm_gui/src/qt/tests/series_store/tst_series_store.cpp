@@ -0,0 +1,228 @@
+/***************************************************************************
+tst_series_store.cpp:  SeriesWriter and SeriesReader round trip and query
+tests
+
+Written by:
+    Sandra Mercer, P.Eng.
+    Engineer / Software Developer
+    eSonar Inc.
+
+Date:
+    November 2022
+
+Note(s):
+- Writes two days of a 1 Hz channel, the rate pm_daemon logs at, to a
+store in a temporary directory and reads it back with SeriesReader
+- The samples come back bit for bit, a zoom decodes only the blocks that
+overlap it, and a query of the whole log is answered from the rollups
+without decoding any block
+****************************************************************************/
+
+
+#include <algorithm>
+#include <cmath>
+#include <QLoggingCategory>
+#include <QTemporaryDir>
+#include <QtTest>
+#include "series_reader.h"
+#include "series_writer.h"
+
+
+class TestSeriesStore : public QObject
+{
+    Q_OBJECT
+
+private slots:
+
+    void initTestCase(void);
+    void dropped(void);
+    void roundTrip(void);
+    void wholeLog(void);
+    void zoom(void);
+
+private:
+
+    static const qint64 StartMs = 1666180800000;    // 2022-10-19 12:00 UTC
+    static const qint64 PeriodMs = 1000;
+    static const int Samples = 2 * 24 * 3600;
+    static const qint64 BlockMs = SeriesWriter::BlockSpanMs;
+
+    QTemporaryDir dir;
+    QVector<float> values;
+    float minimum = 0.0f;
+    float maximum = 0.0f;
+    double sum = 0.0;
+
+};
+
+
+/***************************************************************************
+Function to write the store
+****************************************************************************/
+void TestSeriesStore::initTestCase(void)
+{
+    QLoggingCategory::setFilterRules("*.debug=false");
+    QVERIFY(dir.isValid());
+
+    SeriesWriter writer;
+    QString error = writer.open(dir.path());
+    QVERIFY2(error.isEmpty(), qPrintable(error));
+    error = writer.addChannel("current_ma");
+    QVERIFY2(error.isEmpty(), qPrintable(error));
+
+    // A slow swing with a little noise in the low bits, like a battery current
+    values.resize(Samples);
+    for (int i = 0; i < Samples; i++)
+    {
+        values[i] = float(120.0 + 40.0 * std::sin(i / 5400.0) + (i % 7) * 0.01);
+        writer.append(0, StartMs + i * PeriodMs, values.at(i));
+    }
+    QCOMPARE(writer.samples(), qint64(Samples));
+    QCOMPARE(writer.dropped(), qint64(0));
+    writer.close();
+
+    minimum = *std::min_element(values.constBegin(), values.constEnd());
+    maximum = *std::max_element(values.constBegin(), values.constEnd());
+    for (float value : values)
+        sum += value;
+
+}   // End of TestSeriesStore::initTestCase
+
+
+/***************************************************************************
+Function to check that a sample older than the last one is dropped and the
+store can be appended to
+****************************************************************************/
+void TestSeriesStore::dropped(void)
+{
+    QTemporaryDir other;
+    QVERIFY(other.isValid());
+
+    SeriesWriter writer;
+    QVERIFY(writer.open(other.path()).isEmpty());
+    QVERIFY(writer.addChannel("pressure_mbar").isEmpty());
+    writer.append(0, StartMs + 2000, 1013.25f);
+    writer.append(0, StartMs + 1000, 1013.5f);
+    writer.append(1, StartMs + 3000, 1013.5f);
+    QCOMPARE(writer.samples(), qint64(1));
+    QCOMPARE(writer.dropped(), qint64(1));
+    writer.close();
+
+    QVERIFY(writer.open(other.path()).isEmpty());
+    QVERIFY(writer.addChannel("pressure_mbar").isEmpty());
+    writer.append(0, StartMs + 3000, 1012.75f);
+    writer.close();
+
+    SeriesReader reader;
+    QVector<SeriesReader::Point> points;
+    QVERIFY(reader.open(other.path()).isEmpty());
+    QVERIFY(reader.query("pressure_mbar", StartMs, StartMs + 4000, 10, points));
+    QCOMPARE(points.size(), 2);
+    QCOMPARE(points.at(0).timeMs, StartMs + 2000);
+    QCOMPARE(points.at(0).min, 1013.25f);
+    QCOMPARE(points.at(1).timeMs, StartMs + 3000);
+    QCOMPARE(points.at(1).min, 1012.75f);
+
+}   // End of TestSeriesStore::dropped
+
+
+/***************************************************************************
+Function to check that an hour of samples comes back as it was written
+****************************************************************************/
+void TestSeriesStore::roundTrip(void)
+{
+    SeriesReader reader;
+    QString error = reader.open(dir.path());
+    QVERIFY2(error.isEmpty(), qPrintable(error));
+    QCOMPARE(reader.channels(), QStringList() << "current_ma");
+
+    qint64 firstMs = 0;
+    qint64 lastMs = 0;
+    QVERIFY(!reader.range("pressure_mbar", firstMs, lastMs));
+    QVERIFY(reader.range("current_ma", firstMs, lastMs));
+    QCOMPARE(firstMs, StartMs);
+    QCOMPARE(lastMs, StartMs + (Samples - 1) * PeriodMs);
+
+    const int first = 30 * 3600;
+    QVector<SeriesReader::Point> points;
+    QVERIFY(reader.query("current_ma", StartMs + first * PeriodMs, StartMs + (first + 3600) * PeriodMs, 4000, points));
+    QCOMPARE(points.size(), 3600);
+    QCOMPARE(reader.blocksDecoded(), qint64(3600 * PeriodMs / BlockMs));
+
+    for (int i = 0; i < points.size(); i++)
+    {
+        QCOMPARE(points.at(i).timeMs, StartMs + (first + i) * PeriodMs);
+        QCOMPARE(points.at(i).min, values.at(first + i));
+        QCOMPARE(points.at(i).max, values.at(first + i));
+    }
+
+}   // End of TestSeriesStore::roundTrip
+
+
+/***************************************************************************
+Function to check that a query of the whole log is answered from the
+rollups, with the same extremes and mean as the samples
+****************************************************************************/
+void TestSeriesStore::wholeLog(void)
+{
+    SeriesReader reader;
+    QVERIFY(reader.open(dir.path()).isEmpty());
+
+    const int maxPoints = 500;
+    QVector<SeriesReader::Point> points;
+    QVERIFY(reader.query("current_ma", StartMs, StartMs + Samples * PeriodMs, maxPoints, points));
+    QVERIFY(!points.isEmpty());
+    QVERIFY(points.size() <= maxPoints);
+    QCOMPARE(reader.blocksDecoded(), qint64(0));
+
+    // Every point is a whole hour, so the mean of the means is the mean
+    float low = points.at(0).min;
+    float high = points.at(0).max;
+    double means = 0.0;
+    for (int i = 0; i < points.size(); i++)
+    {
+        if (i > 0)
+            QVERIFY(points.at(i).timeMs > points.at(i - 1).timeMs);
+        QVERIFY(points.at(i).min <= points.at(i).mean && points.at(i).mean <= points.at(i).max);
+        low = qMin(low, points.at(i).min);
+        high = qMax(high, points.at(i).max);
+        means += points.at(i).mean;
+    }
+    QCOMPARE(low, minimum);
+    QCOMPARE(high, maximum);
+    QVERIFY(qAbs(means / points.size() - sum / Samples) < 0.001);
+
+}   // End of TestSeriesStore::wholeLog
+
+
+/***************************************************************************
+Function to check that a zoom only decodes the blocks it overlaps
+****************************************************************************/
+void TestSeriesStore::zoom(void)
+{
+    SeriesReader reader;
+    QVERIFY(reader.open(dir.path()).isEmpty());
+
+    // Ten minutes starting part way through a block and a second
+    const qint64 startMs = StartMs + 12345500;
+    const qint64 endMs = startMs + 600000;
+    QVector<SeriesReader::Point> points;
+    QVERIFY(reader.query("current_ma", startMs, endMs, 1000, points));
+    QCOMPARE(points.size(), 600);
+    QCOMPARE(points.first().timeMs, StartMs + 12346000);
+    QCOMPARE(points.first().min, values.at(12346));
+    QCOMPARE(points.last().timeMs, StartMs + 12945000);
+    QCOMPARE(reader.blocksDecoded(), (endMs - StartMs) / BlockMs - (startMs - StartMs) / BlockMs + 1);
+
+    // Too many samples for the points asked for, from the 10 s rollup
+    QVERIFY(reader.query("current_ma", startMs, endMs, 100, points));
+    QVERIFY(!points.isEmpty());
+    QVERIFY(points.size() <= 100);
+    QCOMPARE(reader.blocksDecoded(), qint64(11));
+
+}   // End of TestSeriesStore::zoom
+
+
+QTEST_GUILESS_MAIN(TestSeriesStore)
+
+#include "tst_series_store.moc"
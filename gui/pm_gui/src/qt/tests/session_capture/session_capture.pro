@@ -0,0 +1,12 @@
+QT       += core testlib
+QT       -= gui
+
+CONFIG += c++11 console testcase
+CONFIG -= app_bundle
+
+TARGET = tst_session_capture
+
+SOURCES += \
+    tst_session_capture.cpp
+
+include(../../pm_core/pm_core.pri)
@@ -0,0 +1,409 @@
+/***************************************************************************
+tst_session_capture.cpp:  SessionRecorder and SessionReplay round trip
+tests
+
+Written by:
+    Sandra Mercer, P.Eng.
+    Engineer / Software Developer
+    eSonar Inc.
+
+Date:
+    November 2022
+
+Note(s):
+- The chunks are recorded to captures in a temporary directory and
+replayed back, they must come back in order, byte for byte, with their
+directions
+- The replay passes on data pointing into the mapped capture, so the test
+copies it while the signal is being handled
+- A capture cut short, as by a crash, is replayed up to its last whole
+record. A file that is not a capture is refused
+****************************************************************************/
+
+
+#include <cstring>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QLoggingCategory>
+#include <QTemporaryDir>
+#include <QtEndian>
+#include <QtTest>
+#include "session_recorder.h"
+#include "session_replay.h"
+
+
+class TestSessionCapture : public QObject
+{
+    Q_OBJECT
+
+private slots:
+
+    void initTestCase(void);
+    void badCapture(void);
+    void flush(void);
+    void header(void);
+    void realTime(void);
+    void roundTrip(void);
+    void truncated(void);
+
+private:
+
+    struct Chunk
+    {
+        SessionCapture::directionEnum direction;
+        QByteArray data;
+    };
+
+    static Chunk chunk(SessionCapture::directionEnum, const QByteArray &);
+    static QList<Chunk> chunks(void);
+    static qint64 captureSize(const QList<Chunk> &);
+    static void compare(const QList<Chunk> &, const QList<Chunk> &);
+    static void record(const QString &, const QList<Chunk> &);
+    static QString replay(const QString &, bool, QList<Chunk> &);
+
+    QTemporaryDir dir;
+
+};
+
+
+/***************************************************************************
+Function to return the size of a capture of the chunks
+****************************************************************************/
+qint64 TestSessionCapture::captureSize(const QList<Chunk> &list)
+{
+    qint64 size = SessionCapture::HeaderLength;
+
+    for (const Chunk &item : list)
+        size += SessionCapture::RecordHeaderLength + item.data.size();
+
+    return (size);
+
+}   // End of TestSessionCapture::captureSize
+
+
+/***************************************************************************
+Function to return one chunk
+****************************************************************************/
+TestSessionCapture::Chunk TestSessionCapture::chunk(SessionCapture::directionEnum direction, const QByteArray &data)
+{
+    Chunk item;
+    item.direction = direction;
+    item.data = data;
+
+    return (item);
+
+}   // End of TestSessionCapture::chunk
+
+
+/***************************************************************************
+Function to return the chunks of a short session: commands, their answers,
+a telemetry frame with zero bytes in it and a dump larger than 64 kB
+****************************************************************************/
+QList<TestSessionCapture::Chunk> TestSessionCapture::chunks(void)
+{
+    QList<Chunk> list;
+
+    list << chunk(SessionCapture::SENT, "read_status\r\n");
+    list << chunk(SessionCapture::RECEIVED, "STATUS 0x0155 0x21\r\n");
+    list << chunk(SessionCapture::RECEIVED, QByteArray("\xa5K\x03\x00\x02\x00\x07", 7));
+    list << chunk(SessionCapture::SENT, "log_zdump\r\n");
+    list << chunk(SessionCapture::RECEIVED, QByteArray(70000, 'z'));
+
+    return (list);
+
+}   // End of TestSessionCapture::chunks
+
+
+/***************************************************************************
+Function to compare the replayed chunks with the recorded ones
+****************************************************************************/
+void TestSessionCapture::compare(const QList<Chunk> &replayed, const QList<Chunk> &expected)
+{
+    QCOMPARE(replayed.size(), expected.size());
+
+    for (int i = 0; i < expected.size(); i++)
+    {
+        QCOMPARE(int(replayed.at(i).direction), int(expected.at(i).direction));
+        QCOMPARE(replayed.at(i).data, expected.at(i).data);
+    }
+
+}   // End of TestSessionCapture::compare
+
+
+/***************************************************************************
+Function to record the chunks to a new capture, an empty chunk is not
+recorded
+****************************************************************************/
+void TestSessionCapture::record(const QString &fileName, const QList<Chunk> &list)
+{
+    SessionRecorder recorder;
+
+    QString error = recorder.open(fileName);
+    QVERIFY2(error.isEmpty(), qPrintable(error));
+
+    for (const Chunk &item : list)
+    {
+        recorder.record(item.direction, item.data);
+        recorder.record(SessionCapture::RECEIVED, QByteArray());
+    }
+    recorder.close();
+
+    QCOMPARE(QFileInfo(fileName).size(), captureSize(list));
+
+}   // End of TestSessionCapture::record
+
+
+/***************************************************************************
+Function to replay a capture into a list of chunks
+
+Returns the error from open(), the summary the replay finished with or
+"timeout"
+****************************************************************************/
+QString TestSessionCapture::replay(const QString &fileName, bool bRealTime, QList<Chunk> &replayed)
+{
+    SessionReplay sessionReplay;
+
+    QString error = sessionReplay.open(fileName);
+    if (!error.isEmpty())
+        return (error);
+
+    connect(&sessionReplay, &SessionReplay::signalReceived, [&replayed](QByteArray data) {
+        replayed << chunk(SessionCapture::RECEIVED, QByteArray(data.constData(), data.size()));
+    });
+    connect(&sessionReplay, &SessionReplay::signalSent, [&replayed](QByteArray data) {
+        replayed << chunk(SessionCapture::SENT, QByteArray(data.constData(), data.size()));
+    });
+
+    QSignalSpy finished(&sessionReplay, &SessionReplay::signalFinished);
+    sessionReplay.start(bRealTime);
+    if (!finished.wait(5000))
+        return ("timeout");
+
+    return (finished.at(0).at(0).toString());
+
+}   // End of TestSessionCapture::replay
+
+
+/***************************************************************************
+Function to set up the temporary directory
+****************************************************************************/
+void TestSessionCapture::initTestCase(void)
+{
+    QLoggingCategory::setFilterRules("*.debug=false");
+    QVERIFY(dir.isValid());
+
+}   // End of TestSessionCapture::initTestCase
+
+
+/***************************************************************************
+Function to check that a file that is not a whole capture header of the
+current version is refused, and that the replay then does not start
+****************************************************************************/
+void TestSessionCapture::badCapture(void)
+{
+    SessionReplay sessionReplay;
+
+    QString error = sessionReplay.open(dir.filePath("missing.pmcap"));
+    QVERIFY(error.startsWith("Could not open"));
+
+    // Shorter than a header
+    QString fileName = dir.filePath("short.pmcap");
+    QFile file(fileName);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.write("PMCAPTUR");
+    file.close();
+    QVERIFY(sessionReplay.open(fileName).startsWith("Could not map"));
+
+    // Another file
+    QVERIFY(file.open(QIODevice::WriteOnly | QIODevice::Truncate));
+    file.write(QByteArray(SessionCapture::HeaderLength + SessionCapture::RecordHeaderLength, 'x'));
+    file.close();
+    QVERIFY(sessionReplay.open(fileName).endsWith("is not a power module capture"));
+
+    // A capture of another version
+    record(fileName, chunks());
+    QVERIFY(file.open(QIODevice::ReadWrite));
+    file.seek(8);
+    uchar version[4];
+    qToLittleEndian<quint32>(SessionCapture::Version + 1, version);
+    file.write(reinterpret_cast<const char *>(version), sizeof(version));
+    file.close();
+    QVERIFY(sessionReplay.open(fileName).endsWith("is not a power module capture"));
+
+    sessionReplay.start(false);
+    QVERIFY(!sessionReplay.isActive());
+
+}   // End of TestSessionCapture::badCapture
+
+
+/***************************************************************************
+Function to check that the records are written through when flushed, and
+by the first record after FlushIntervalMs
+****************************************************************************/
+void TestSessionCapture::flush(void)
+{
+    QString fileName = dir.filePath("flush.pmcap");
+    QList<Chunk> list = chunks().mid(0, 2);
+    SessionRecorder recorder;
+
+    // Nothing is recorded while closed
+    recorder.record(SessionCapture::SENT, "read_status\r\n");
+    QVERIFY(!recorder.isOpen());
+    QVERIFY(!recorder.isBuffered());
+
+    QVERIFY(recorder.open(fileName).isEmpty());
+    QVERIFY(recorder.isOpen());
+
+    recorder.record(list.at(0).direction, list.at(0).data);
+    QVERIFY(recorder.isBuffered());
+    recorder.flush();
+    QVERIFY(!recorder.isBuffered());
+    QCOMPARE(QFileInfo(fileName).size(), captureSize(list.mid(0, 1)));
+
+    QTest::qWait(SessionRecorder::FlushIntervalMs + 10);
+    recorder.record(list.at(1).direction, list.at(1).data);
+    QVERIFY(!recorder.isBuffered());
+    QCOMPARE(QFileInfo(fileName).size(), captureSize(list));
+
+    recorder.close();
+    QVERIFY(!recorder.isOpen());
+
+}   // End of TestSessionCapture::flush
+
+
+/***************************************************************************
+Function to check the header and record headers of a capture against the
+layout in session_recorder.h
+****************************************************************************/
+void TestSessionCapture::header(void)
+{
+    QString fileName = dir.filePath("header.pmcap");
+    QList<Chunk> list = chunks();
+
+    qint64 beforeMs = QDateTime::currentMSecsSinceEpoch();
+    record(fileName, list);
+    qint64 afterMs = QDateTime::currentMSecsSinceEpoch();
+
+    QFile file(fileName);
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    QByteArray data = file.readAll();
+    const uchar *capture = reinterpret_cast<const uchar *>(data.constData());
+
+    QVERIFY(memcmp(capture, SessionCapture::Magic, sizeof(SessionCapture::Magic)) == 0);
+    QCOMPARE(qFromLittleEndian<quint32>(capture + 8), SessionCapture::Version);
+    QCOMPARE(qFromLittleEndian<quint32>(capture + 12), quint32(0));
+    QVERIFY(qFromLittleEndian<qint64>(capture + 16) >= beforeMs);
+    QVERIFY(qFromLittleEndian<qint64>(capture + 16) <= afterMs);
+
+    int position = SessionCapture::HeaderLength;
+    quint64 lastUs = 0;
+    for (const Chunk &item : list)
+    {
+        const uchar *recordHeader = capture + position;
+
+        QVERIFY(qFromLittleEndian<quint64>(recordHeader) >= lastUs);
+        lastUs = qFromLittleEndian<quint64>(recordHeader);
+        QCOMPARE(qFromLittleEndian<quint32>(recordHeader + 8), quint32(item.data.size()));
+        QCOMPARE(int(recordHeader[12]), int(item.direction));
+        QCOMPARE(int(recordHeader[13] | recordHeader[14] | recordHeader[15]), 0);
+        QCOMPARE(data.mid(position + SessionCapture::RecordHeaderLength, item.data.size()), item.data);
+
+        position += SessionCapture::RecordHeaderLength + item.data.size();
+    }
+    QCOMPARE(position, data.size());
+
+}   // End of TestSessionCapture::header
+
+
+/***************************************************************************
+Function to check that at 1x a record is passed on no earlier than its
+recorded time, and that as fast as possible the gap is not waited for
+****************************************************************************/
+void TestSessionCapture::realTime(void)
+{
+    const int GapMs = 200;
+    QString fileName = dir.filePath("real_time.pmcap");
+    SessionRecorder recorder;
+
+    QVERIFY(recorder.open(fileName).isEmpty());
+    recorder.record(SessionCapture::SENT, "read_status\r\n");
+    QTest::qSleep(GapMs);
+    recorder.record(SessionCapture::RECEIVED, "STATUS 0x0155 0x21\r\n");
+    recorder.close();
+
+    SessionReplay sessionReplay;
+    QElapsedTimer elapsed;
+    qint64 receivedMs = -1;
+    QVERIFY(sessionReplay.open(fileName).isEmpty());
+    connect(&sessionReplay, &SessionReplay::signalReceived, [&elapsed, &receivedMs](QByteArray) {
+        receivedMs = elapsed.elapsed();
+    });
+
+    QSignalSpy finished(&sessionReplay, &SessionReplay::signalFinished);
+    elapsed.start();
+    sessionReplay.start(true);
+    QVERIFY(finished.wait(5000));
+    QVERIFY(receivedMs >= GapMs);
+
+    QList<Chunk> replayed;
+    elapsed.start();
+    QVERIFY(replay(fileName, false, replayed).startsWith("Replay finished: 2 records"));
+    QVERIFY(elapsed.elapsed() < GapMs);
+
+}   // End of TestSessionCapture::realTime
+
+
+/***************************************************************************
+Function to check that a capture replays as it was recorded
+****************************************************************************/
+void TestSessionCapture::roundTrip(void)
+{
+    QString fileName = dir.filePath("round_trip.pmcap");
+    QList<Chunk> list = chunks();
+    QList<Chunk> replayed;
+
+    record(fileName, list);
+
+    QString summary = replay(fileName, false, replayed);
+    QVERIFY2(summary.startsWith("Replay finished: 5 records, 70027 bytes received, 24 bytes sent"),
+             qPrintable(summary));
+    compare(replayed, list);
+
+}   // End of TestSessionCapture::roundTrip
+
+
+/***************************************************************************
+Function to check that a capture cut short part way through a record, or
+part way through a record header, replays up to its last whole record
+****************************************************************************/
+void TestSessionCapture::truncated(void)
+{
+    QString fileName = dir.filePath("truncated.pmcap");
+    QList<Chunk> list = chunks();
+    QList<Chunk> replayed;
+    qint64 size = captureSize(list);
+
+    record(fileName, list);
+    QVERIFY(QFile::resize(fileName, size - 10));
+
+    QString summary = replay(fileName, false, replayed);
+    QVERIFY2(summary.startsWith("Replay finished, the capture ends part way through a record: 4 records"),
+             qPrintable(summary));
+    compare(replayed, list.mid(0, 4));
+
+    // 5 bytes of the last record header
+    replayed.clear();
+    QVERIFY(QFile::resize(fileName, captureSize(list.mid(0, 4)) + 5));
+
+    summary = replay(fileName, false, replayed);
+    QVERIFY2(summary.startsWith("Replay finished: 4 records"), qPrintable(summary));
+    compare(replayed, list.mid(0, 4));
+
+}   // End of TestSessionCapture::truncated
+
+
+QTEST_GUILESS_MAIN(TestSessionCapture)
+
+#include "tst_session_capture.moc"
@@ -0,0 +1,300 @@
+/***************************************************************************
+tst_telemetry_decoder.cpp:  TelemetryDecoder frame checking and resync
+tests
+
+Written by:
+    Sandra Mercer, P.Eng.
+    Engineer / Software Developer
+    eSonar Inc.
+
+Date:
+    November 2022
+
+Note(s):
+- The frames are built here as pm_telemetry.c sends them: 0xa5, 'K' or
+'D', payload length, one zig-zag varint per record field, CRC-8
+(polynomial 0x07) over the type, length and payload
+- A frame with a bad CRC, or a good CRC over a length that does not match
+its fields, must be dropped without losing the frame after it
+****************************************************************************/
+
+
+#include <QtTest>
+#include "telemetry_decoder.h"
+
+
+class TestTelemetryDecoder : public QObject
+{
+    Q_OBJECT
+
+private slots:
+
+    void badCrc(void);
+    void badLength_data(void);
+    void badLength(void);
+    void delta(void);
+    void incomplete(void);
+    void resync(void);
+
+private:
+
+    static const int Fields = 13;
+
+    static QByteArray frame(char, const qint32 *, int = 0, const QByteArray & = QByteArray());
+    static void keyValues(quint32, qint32 *);
+    static int decodeAll(TelemetryDecoder &, QByteArray, QList<TelemetryRecord> &);
+
+};
+
+
+/***************************************************************************
+Function to decode a stream the way ResponseStream does, skipping to each
+sync byte. Returns the number of frames found invalid
+****************************************************************************/
+int TestTelemetryDecoder::decodeAll(TelemetryDecoder &decoder, QByteArray data, QList<TelemetryRecord> &records)
+{
+    int invalid = 0;
+    int sync;
+
+    while ((sync = data.indexOf(TelemetryDecoder::Sync)) != -1)
+    {
+        TelemetryRecord record;
+
+        data.remove(0, sync);
+        TelemetryDecoder::resultEnum result = decoder.decode(data, record);
+        if (result == TelemetryDecoder::INCOMPLETE)
+            break;
+        if (result == TelemetryDecoder::INVALID)
+            invalid++;
+        else if (result == TelemetryDecoder::DECODED)
+            records.append(record);
+    }
+
+    return (invalid);
+
+}   // End of TestTelemetryDecoder::decodeAll
+
+
+/***************************************************************************
+Function to return a frame of the given field values. lengthChange is added
+to the length byte and extra is put after the fields, the CRC is always
+good
+****************************************************************************/
+QByteArray TestTelemetryDecoder::frame(char type, const qint32 *values, int lengthChange, const QByteArray &extra)
+{
+    QByteArray payload;
+
+    for (int i = 0; i < Fields; i++)
+    {
+        quint32 zigzag = (quint32(values[i]) << 1) ^ quint32(values[i] >> 31);
+        while (zigzag >= 0x80)
+        {
+            payload.append(char((zigzag & 0x7f) | 0x80));
+            zigzag >>= 7;
+        }
+        payload.append(char(zigzag));
+    }
+    payload.append(extra);
+
+    QByteArray data;
+    data.append(TelemetryDecoder::Sync);
+    data.append(type);
+    data.append(char(payload.size() + lengthChange));
+    data.append(payload);
+
+    quint8 crc = 0x00;
+    for (int i = 1; i < data.size(); i++)
+    {
+        crc ^= quint8(data.at(i));
+        for (int j = 0; j < 8; j++)
+            crc = (crc & 0x80) ? quint8((crc << 1) ^ 0x07) : quint8(crc << 1);
+    }
+    data.append(char(crc));
+
+    return (data);
+
+}   // End of TestTelemetryDecoder::frame
+
+
+/***************************************************************************
+Function to fill the field values of a keyframe for record sequence
+****************************************************************************/
+void TestTelemetryDecoder::keyValues(quint32 sequence, qint32 *values)
+{
+    const qint32 fields[Fields] = {qint32(sequence), 60000, 12, 3700, -150, 21, 1800, 1013, 19, -3, 0x0155, 0x21, 0};
+
+    for (int i = 0; i < Fields; i++)
+        values[i] = fields[i];
+
+}   // End of TestTelemetryDecoder::keyValues
+
+
+/***************************************************************************
+Function to check that a frame with a bad CRC is dropped, and that the
+deltas after it wait for a keyframe
+****************************************************************************/
+void TestTelemetryDecoder::badCrc(void)
+{
+    qint32 values[Fields];
+    const qint32 deltas[Fields] = {1, 1000, 0, -2, 5, 0, -1, 0, 0, 1, 0, 0, 0};
+    TelemetryDecoder decoder;
+    TelemetryRecord record;
+
+    keyValues(100, values);
+    QByteArray data = frame('K', values);
+    data[data.size() - 1] = char(data.at(data.size() - 1) ^ 0x80);
+    int size = data.size();
+
+    QCOMPARE(decoder.decode(data, record), TelemetryDecoder::INVALID);
+    QCOMPARE(data.size(), size - 1);
+    QCOMPARE(decoder.invalidFrames(), 1);
+
+    data = frame('D', deltas);
+    QCOMPARE(decoder.decode(data, record), TelemetryDecoder::SKIPPED);
+    QVERIFY(data.isEmpty());
+    QCOMPARE(decoder.skippedFrames(), 1);
+    QCOMPARE(decoder.records(), 0);
+
+}   // End of TestTelemetryDecoder::badCrc
+
+
+/***************************************************************************
+Frames with a good CRC whose length does not match their fields
+****************************************************************************/
+void TestTelemetryDecoder::badLength_data(void)
+{
+    QTest::addColumn<QByteArray>("data");
+
+    qint32 values[Fields];
+    keyValues(100, values);
+
+    QTest::newRow("a byte after the fields") << frame('K', values, 0, QByteArray(1, '\0'));
+    QTest::newRow("a field after the fields") << frame('K', values, 0, QByteArray(1, '\x02'));
+    QTest::newRow("one byte short") << frame('K', values, -1);
+    QTest::newRow("past MaxPayload") << frame('K', values, 100);
+    QTest::newRow("bad type") << frame('X', values);
+
+}   // End of TestTelemetryDecoder::badLength_data
+
+
+/***************************************************************************
+Function to check that a frame whose length is not the size of its fields
+is dropped, and the good frame after it is decoded
+****************************************************************************/
+void TestTelemetryDecoder::badLength(void)
+{
+    QFETCH(QByteArray, data);
+
+    qint32 values[Fields];
+    keyValues(200, values);
+    TelemetryDecoder decoder;
+    TelemetryRecord record;
+
+    QByteArray bad = data;
+    QCOMPARE(decoder.decode(bad, record), TelemetryDecoder::INVALID);
+    QCOMPARE(bad.size(), data.size() - 1);
+
+    QList<TelemetryRecord> records;
+    QCOMPARE(decodeAll(decoder, data + frame('K', values), records), 1);
+    QCOMPARE(records.size(), 1);
+    QCOMPARE(records.at(0).sequence, quint32(200));
+    QCOMPARE(decoder.invalidFrames(), 2);
+
+}   // End of TestTelemetryDecoder::badLength
+
+
+/***************************************************************************
+Function to check a keyframe and the delta frames after it
+****************************************************************************/
+void TestTelemetryDecoder::delta(void)
+{
+    qint32 values[Fields];
+    const qint32 deltas[Fields] = {1, 1000, 0, -2, 5, 0, -1, 0, 0, 1, 0, 0, 0};
+    TelemetryDecoder decoder;
+    TelemetryRecord record;
+
+    keyValues(100, values);
+    QByteArray data = frame('K', values) + frame('D', deltas) + frame('D', deltas);
+
+    QCOMPARE(decoder.decode(data, record), TelemetryDecoder::DECODED);
+    QCOMPARE(record.sequence, quint32(100));
+    QCOMPARE(record.timestampMs, quint32(60000));
+    QCOMPARE(record.batteryMa, qint16(-150));
+    QCOMPARE(record.tilt, qint16(-3));
+    QCOMPARE(record.powerBits, quint16(0x0155));
+    QCOMPARE(record.statusBits, quint8(0x21));
+
+    QCOMPARE(decoder.decode(data, record), TelemetryDecoder::DECODED);
+    QCOMPARE(decoder.decode(data, record), TelemetryDecoder::DECODED);
+    QVERIFY(data.isEmpty());
+    QCOMPARE(record.sequence, quint32(102));
+    QCOMPARE(record.timestampMs, quint32(62000));
+    QCOMPARE(record.batteryMv, quint16(3696));
+    QCOMPARE(record.batteryMa, qint16(-140));
+    QCOMPARE(record.chargeMah, quint16(1798));
+    QCOMPARE(record.tilt, qint16(-1));
+
+    QCOMPARE(decoder.records(), 3);
+    QVERIFY(decoder.compressionRatio() > 1.0);
+
+}   // End of TestTelemetryDecoder::delta
+
+
+/***************************************************************************
+Function to check that part of a frame is left for more bytes
+****************************************************************************/
+void TestTelemetryDecoder::incomplete(void)
+{
+    qint32 values[Fields];
+    TelemetryDecoder decoder;
+    TelemetryRecord record;
+
+    keyValues(100, values);
+    QByteArray whole = frame('K', values);
+
+    for (int size = 1; size < whole.size(); size++)
+    {
+        QByteArray data = whole.left(size);
+        QCOMPARE(decoder.decode(data, record), TelemetryDecoder::INCOMPLETE);
+        QCOMPARE(data.size(), size);
+    }
+    QCOMPARE(decoder.invalidFrames(), 0);
+
+}   // End of TestTelemetryDecoder::incomplete
+
+
+/***************************************************************************
+Function to check that the decoder finds the frames again after garbage,
+including garbage with sync bytes in it
+****************************************************************************/
+void TestTelemetryDecoder::resync(void)
+{
+    qint32 values[Fields];
+    const qint32 deltas[Fields] = {1, 1000, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+    TelemetryDecoder decoder;
+
+    keyValues(300, values);
+    QByteArray garbage("\xa5\xa5K\x01\x02\x03LEAK_EVENT\r\n\xa5\x44\xff\xa5");
+    QByteArray truncated = frame('K', values).left(10);
+
+    QByteArray data = garbage + frame('K', values) + frame('D', deltas) + truncated + garbage
+            + frame('D', deltas) + frame('K', values) + frame('D', deltas);
+
+    QList<TelemetryRecord> records;
+    QVERIFY(decodeAll(decoder, data, records) > 0);
+
+    // The delta after the garbage has lost its keyframe and is skipped
+    QCOMPARE(records.size(), 4);
+    QCOMPARE(records.at(0).sequence, quint32(300));
+    QCOMPARE(records.at(1).sequence, quint32(301));
+    QCOMPARE(records.at(2).sequence, quint32(300));
+    QCOMPARE(records.at(3).sequence, quint32(301));
+    QCOMPARE(records.at(3).timestampMs, quint32(61000));
+    QCOMPARE(decoder.skippedFrames(), 1);
+
+}   // End of TestTelemetryDecoder::resync
+
+
+QTEST_GUILESS_MAIN(TestTelemetryDecoder)
+
+#include "tst_telemetry_decoder.moc"